@@ -0,0 +1,265 @@
+#include "ELF_x64_backend.hpp"
+
+#include "globals.hpp" // report_error
+
+#include "x64/code_generator.hpp"
+
+#include <fstd/system/file.hpp>
+
+#include <fstd/core/assert.hpp>
+#include <fstd/core/string_builder.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+using namespace fstd;
+using namespace fstd::core;
+using namespace fstd::system;
+
+using namespace f;
+
+constexpr uint64_t  page_size = 4096;
+constexpr uint64_t  image_base = 0x400000;  // Default of ld for x86-64 executables
+
+// Linux x86-64 syscall numbers (arch/x86/entry/syscalls/syscall_64.tbl)
+constexpr int64_t   syscall_exit_group = 231;   // Ends all threads of the process, exit only ends the calling one
+
+static uint64_t align_to_page(uint64_t value)
+{
+    return (value + page_size - 1) & ~(page_size - 1);
+}
+
+// Entry point of the process, RSP is 16 bytes aligned at this point (System V ABI).
+// main is called with the x64 calling convention of Microsoft as every function of the program: the shadow space of
+// its arguments is reserved, so RSP stays 16 bytes aligned before the call.
+// Syscall convention: number in RAX, arguments in RDI, RSI, RDX, R10, R8, R9, RCX and R11 are clobbered.
+// Return the offset of the displacement of the call to main in the code.
+static uint32_t generate_entry_point(const IR& ir, memory::Array<uint8_t>& code, uint32_t& call_end)
+{
+    using namespace x64;
+
+    encode_instruction(code, Mnemonic::SUB, make_register(Physical_Register::RSP), make_immediate(32));
+
+    size_t              instruction_start = memory::get_array_size(code);
+    Encoded_Instruction encoded_instruction = encode_instruction(code, Mnemonic::CALL, make_relative(0, 4));
+
+    call_end = (uint32_t)(instruction_start + encoded_instruction.size);
+
+    if (ir.functions[ir.entry_point_function].has_return_value) {
+        encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RDI, 4), make_register(Physical_Register::RAX, 4));
+    }
+    else {
+        encode_instruction(code, Mnemonic::XOR, make_register(Physical_Register::RDI, 4), make_register(Physical_Register::RDI, 4));
+    }
+    encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RAX, 4), make_immediate(syscall_exit_group));
+    encode_instruction(code, Mnemonic::SYSCALL);
+
+    return (uint32_t)(instruction_start + encoded_instruction.immediate_offset);
+}
+
+void f::ELF_x64_backend::initialize_backend()
+{
+    x64::initialize_encoder();
+}
+
+void f::ELF_x64_backend::build_image(IR& ir, memory::Array<uint8_t>& image)
+{
+    ZoneScopedN("f::ELF_x64_backend::build_image");
+
+    if (ir.entry_point_function == invalid_function) {
+        report_error(Compiler_Error::error, "The program doesn't have a main function.");
+    }
+
+    memory::Array<uint8_t>      entry_point_code;
+    x64::Function_Code          program_code;
+    memory::Array<uint32_t>     function_offsets;
+    uint32_t                    call_displacement_offset;
+    uint32_t                    call_end;
+
+    defer {
+        memory::release(entry_point_code);
+        x64::release(program_code);
+        memory::release(function_offsets);
+    };
+
+    {
+        ZoneScopedN("Code generation");
+
+        // Linux keeps the 128 bytes below RSP for the current function (signal handlers skip them)
+        x64::generate_program_code(ir, program_code, function_offsets, 0, true);
+        call_displacement_offset = generate_entry_point(ir, entry_point_code, call_end);
+    }
+
+    // Layout
+    //   - text segment (R X): ELF header, program headers, the entry point then the code of functions (16 bytes
+    //     aligned), mapped from the beginning of the file
+    //   - rodata segment (R): literals then jump tables of switches (8 bytes aligned), on the next page
+    constexpr uint64_t  nb_program_headers = 2;
+
+    uint64_t    entry_point_offset = sizeof(ELF64_Header) + nb_program_headers * sizeof(ELF64_Program_Header);
+    uint64_t    code_offset = (entry_point_offset + memory::get_array_size(entry_point_code) + 15) & ~15ull;
+    uint64_t    code_size = memory::get_array_size(program_code.code);
+    uint64_t    text_segment_size = code_offset + code_size;
+    uint64_t    code_address = image_base + code_offset;
+    uint64_t    rodata_offset = align_to_page(text_segment_size);
+    uint64_t    rodata_address = image_base + rodata_offset;
+    uint64_t    jump_tables_address = rodata_address + ((ir.read_only_data.current_RVA + 7) & ~7ull);
+    uint64_t    rodata_size = jump_tables_address - rodata_address + memory::get_array_size(program_code.jump_table_entries) * sizeof(int64_t);
+
+    memory::resize_array(image, rodata_offset + rodata_size);
+    zero_memory(memory::get_array_data(image), memory::get_array_size(image)); // Paddings are zeros
+
+    // ELF header
+    {
+        ELF64_Header	header;
+
+        zero_memory(&header, sizeof(header));
+        header.ident[0] = 0x7f;
+        header.ident[1] = 'E';
+        header.ident[2] = 'L';
+        header.ident[3] = 'F';
+        header.ident[4] = ELF_CLASS_64;
+        header.ident[5] = ELF_DATA_LITTLE_ENDIAN;
+        header.ident[6] = ELF_VERSION_CURRENT;
+        header.ident[7] = ELF_OS_ABI_SYSV;
+        header.type = ELF_TYPE_EXECUTABLE;
+        header.machine = ELF_MACHINE_X86_64;
+        header.version = ELF_VERSION_CURRENT;
+        header.entry = image_base + entry_point_offset;
+        header.program_header_offset = sizeof(ELF64_Header);
+        header.section_header_offset = 0;   // No section headers, they are only used by linkers and debuggers
+        header.flags = 0;
+        header.header_size = sizeof(ELF64_Header);
+        header.program_header_entry_size = sizeof(ELF64_Program_Header);
+        header.program_header_count = (uint16_t)nb_program_headers;
+        header.section_header_entry_size = 0;
+        header.section_header_count = 0;
+        header.section_names_index = 0;
+
+        memory_copy(memory::get_array_data(image), &header, sizeof(header));
+    }
+
+    // Program headers, offsets and addresses are congruent modulo the page size as required by the loader
+    {
+        ELF64_Program_Header	program_headers[nb_program_headers];
+
+        program_headers[0].type = PROGRAM_HEADER_LOAD;
+        program_headers[0].flags = SEGMENT_FLAG_READ | SEGMENT_FLAG_EXECUTE;
+        program_headers[0].offset = 0;
+        program_headers[0].virtual_address = image_base;
+        program_headers[0].physical_address = image_base;
+        program_headers[0].file_size = text_segment_size;
+        program_headers[0].memory_size = text_segment_size;
+        program_headers[0].alignment = page_size;
+
+        program_headers[1].type = PROGRAM_HEADER_LOAD;
+        program_headers[1].flags = SEGMENT_FLAG_READ;
+        program_headers[1].offset = rodata_offset;
+        program_headers[1].virtual_address = rodata_address;
+        program_headers[1].physical_address = rodata_address;
+        program_headers[1].file_size = rodata_size;
+        program_headers[1].memory_size = rodata_size;
+        program_headers[1].alignment = page_size;
+
+        memory_copy(memory::get_array_data(image) + sizeof(ELF64_Header), program_headers, sizeof(program_headers));
+    }
+
+    // Code
+    {
+        ZoneScopedN("Write code");
+
+        uint8_t*    entry_point = memory::get_array_data(image) + entry_point_offset;
+        uint8_t*    code = memory::get_array_data(image) + code_offset;
+        int32_t     displacement;
+
+        memory_copy(entry_point, memory::get_array_data(entry_point_code), memory::get_array_size(entry_point_code));
+        displacement = (int32_t)((int64_t)(code_offset + function_offsets[ir.entry_point_function]) - (int64_t)(entry_point_offset + call_end));
+        memory_copy(entry_point + call_displacement_offset, &displacement, sizeof(displacement));
+
+        // Calls between functions are already resolved by the code generator
+        memory_copy(code, memory::get_array_data(program_code.code), code_size);
+        for (size_t i = 0; i < memory::get_array_size(program_code.fixups); i++) {
+            const x64::Code_Fixup&  fixup = program_code.fixups[i];
+            uint64_t                target_address = 0;
+
+            if (fixup.kind == x64::Code_Fixup::Kind::LITERAL) {
+                target_address = rodata_address + ir.read_only_data.literals[fixup.index].RVA;
+            }
+            else if (fixup.kind == x64::Code_Fixup::Kind::JUMP_TABLE) {
+                target_address = jump_tables_address + fixup.index * sizeof(int64_t);
+            }
+            else if (fixup.kind == x64::Code_Fixup::Kind::IMPORTED_FUNCTION) {
+                report_error(Compiler_Error::error, ir.functions[fixup.index].imported_function->function->name, "Functions imported from a dll can't be called by a Linux executable.");
+            }
+            else {
+                report_error(Compiler_Error::internal_error, "ELF x64 backend: unsupported fixup.");
+            }
+            displacement = (int32_t)((int64_t)target_address - (int64_t)(code_address + fixup.instruction_end));
+            memory_copy(code + fixup.displacement_offset, &displacement, sizeof(displacement));
+        }
+    }
+
+    // Read only data
+    {
+        ZoneScopedN("Write read only data");
+
+        memory_copy(memory::get_array_data(image) + rodata_offset, memory::get_array_data(ir.read_only_data.section), memory::get_array_bytes_size(ir.read_only_data.section));
+
+        // Entries are offsets of their target from the beginning of their table, so they don't need relocations
+        uint8_t* jump_tables = memory::get_array_data(image) + rodata_offset + (jump_tables_address - rodata_address);
+        for (size_t i = 0; i < memory::get_array_size(program_code.jump_table_entries); i++) {
+            const x64::Jump_Table_Entry&    entry = program_code.jump_table_entries[i];
+            int64_t                         offset = (int64_t)(code_address + entry.target) - (int64_t)(jump_tables_address + entry.first_entry * sizeof(int64_t));
+
+            memory_copy(jump_tables + i * sizeof(int64_t), &offset, sizeof(offset));
+        }
+    }
+}
+
+void f::ELF_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_path)
+{
+    ZoneScopedN("f::ELF_x64_backend::compile");
+
+    File    output_file;
+    bool    open;
+
+    // @TODO the executable permission has to be set on the output file (this isn't possible from Windows)
+    open = open_file(output_file, output_file_path, (File::Opening_Flag)(
+        (uint32_t)File::Opening_Flag::WRITE |
+        (uint32_t)File::Opening_Flag::CREATE));
+
+    if (open == false) {
+        String_Builder		string_builder;
+        language::string	message;
+
+        defer {
+            free_buffers(string_builder);
+            release(message);
+        };
+
+        print_to_builder(string_builder, "Failed to open file: \"%v\"\n", to_string(output_file_path));
+
+        message = to_string(string_builder);
+        report_error(Compiler_Error::error, (char*)to_utf8(message));
+    }
+
+    defer {
+        close_file(output_file);
+    };
+
+    memory::Array<uint8_t>	image;
+
+    defer {
+        memory::release(image);
+    };
+
+    build_image(ir, image);
+
+    // Write the file at once
+    {
+        ZoneScopedN("Write file");
+
+        write_file(output_file, memory::get_array_data(image), (uint32_t)memory::get_array_size(image));
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "IR_generator.hpp"
+
+#include <fstd/system/path.hpp>
+
+// Backend for Linux x86-64
+//
+// Produces static executables without any dependency (not even the libc), the program talks to the kernel with
+// syscalls. The image only has the ELF header and the program headers (no section headers), each segment is
+// page aligned in the file and in memory.
+//
+// The code of functions is the same as on Windows (x64 calling convention of Microsoft), only the entry point is
+// specific: it calls main, then gives its returned value to the exit_group syscall. Functions imported from dlls
+// can't be called.
+
+namespace f
+{
+	// https://refspecs.linuxfoundation.org/elf/elf.pdf
+	// https://refspecs.linuxfoundation.org/elf/x86_64-abi-0.99.pdf
+	//
+	// Structures are declared here as elf.h isn't available on every host (the compiler can run on Windows).
+
+	struct ELF64_Header
+	{
+		uint8_t		ident[16];
+		uint16_t	type;
+		uint16_t	machine;
+		uint32_t	version;
+		uint64_t	entry;
+		uint64_t	program_header_offset;
+		uint64_t	section_header_offset;
+		uint32_t	flags;
+		uint16_t	header_size;
+		uint16_t	program_header_entry_size;
+		uint16_t	program_header_count;
+		uint16_t	section_header_entry_size;
+		uint16_t	section_header_count;
+		uint16_t	section_names_index;
+	};
+
+	struct ELF64_Program_Header
+	{
+		uint32_t	type;
+		uint32_t	flags;
+		uint64_t	offset;
+		uint64_t	virtual_address;
+		uint64_t	physical_address;
+		uint64_t	file_size;
+		uint64_t	memory_size;
+		uint64_t	alignment;
+	};
+
+	static_assert(sizeof(ELF64_Header) == 64, "ELF64_Header doesn't match the specification");
+	static_assert(sizeof(ELF64_Program_Header) == 56, "ELF64_Program_Header doesn't match the specification");
+
+	constexpr uint8_t	ELF_CLASS_64 = 2;
+	constexpr uint8_t	ELF_DATA_LITTLE_ENDIAN = 1;
+	constexpr uint8_t	ELF_VERSION_CURRENT = 1;
+	constexpr uint8_t	ELF_OS_ABI_SYSV = 0;
+	constexpr uint16_t	ELF_TYPE_EXECUTABLE = 2;
+	constexpr uint16_t	ELF_MACHINE_X86_64 = 62;
+	constexpr uint32_t	PROGRAM_HEADER_LOAD = 1;
+	constexpr uint32_t	SEGMENT_FLAG_EXECUTE = 0x1;
+	constexpr uint32_t	SEGMENT_FLAG_WRITE = 0x2;
+	constexpr uint32_t	SEGMENT_FLAG_READ = 0x4;
+
+	namespace ELF_x64_backend
+	{
+		void initialize_backend();
+		// Build the whole executable in image, compile writes it in a file
+		void build_image(IR& ir, fstd::memory::Array<uint8_t>& image);
+		void compile(IR& ir, const fstd::system::Path& output_file_path);
+	}
+}
@@ -4,8 +4,13 @@
 
 #include "parser/parser.hpp"
 #include "parser/symbol_solver.hpp"
+#include "parser/type_table.hpp"
+#include "parser/constant_folder.hpp"
+
+#include <fstd/language/defer.hpp>
 
 #include <third-party/SpookyV2.h>
+#undef INLINE // Defined by SpookyV2, it hides Keyword::INLINE
 
 #include <tracy/Tracy.hpp>
 
@@ -21,36 +26,40 @@ using namespace f;
 
 inline Imported_Library* allocate_imported_library()
 {
-	// Ensure that no reallocation could happen during the resize
-	core::Assert(memory::get_array_size(globals.ir_data.imported_libraries) < memory::get_array_reserved(globals.ir_data.imported_libraries));
-
-	memory::resize_array(globals.ir_data.imported_libraries, memory::get_array_size(globals.ir_data.imported_libraries) + 1);
-
-	Imported_Library* new_imported_library = memory::get_array_last_element(globals.ir_data.imported_libraries);
-	return new_imported_library;
+	// The buffer is preallocated, so no reallocation could happen and pointers on libraries stay valid
+	return memory::array_emplace_back_unchecked(globals.ir_data.imported_libraries);
 }
 
 inline Imported_Function* allocate_imported_function()
 {
-	// Ensure that no reallocation could happen during the resize
-	core::Assert(memory::get_array_size(globals.ir_data.imported_functions) < memory::get_array_reserved(globals.ir_data.imported_functions));
-
-	memory::resize_array(globals.ir_data.imported_functions, memory::get_array_size(globals.ir_data.imported_functions) + 1);
-
-	Imported_Function* new_imported_function = memory::get_array_last_element(globals.ir_data.imported_functions);
-	return new_imported_function;
+	// The buffer is preallocated, so no reallocation could happen and pointers on functions stay valid
+	return memory::array_emplace_back_unchecked(globals.ir_data.imported_functions);
 }
 
 // =============================================================================
 
+// Lowering of the AST to the linear IR
+//
+// Local variables have their own virtual register that is written by a COPY (variables are mutable), the SSA
+// construction is responsible to remove those copies. Temporaries are new virtual registers for each
+// instruction, so the lowering doesn't have to track their life time.
 
-static void parse_ast(Parsing_Result& parsing_result, IR& ir, AST_Node* node);
-static void parse_function_declaration(IR& ir, AST_Statement_Function* function_node);
-static size_t get_list_size(AST_Node* node);
+struct IR_Local
+{
+	AST_Statement_Variable*	variable;
+	uint32_t				register_id;
+};
 
-// @TODO actually Parsing_Result isn't really used by parse_ast because the AST_Node can already contains a
-// pointer to the right symbol table node.
-// But it might be useful to check shadowing and some other errors.
+struct IR_Function_Generator
+{
+	IR*							ir;
+	uint32_t					function_index;	// @Warning functions of imported modules are registered while generating, so we can't keep a pointer on the IR_Function
+	memory::Array<IR_Local>		locals;
+};
+
+static uint32_t register_function(IR& ir, AST_Statement_Function* function_node);
+static Imported_Function* parse_function_declaration(IR& ir, AST_Statement_Function* function_node, IR_Function& function);
+static size_t get_list_size(AST_Node* node);
 
 static size_t get_list_size(AST_Node* node)
 {
@@ -60,377 +69,967 @@ static size_t get_list_size(AST_Node* node)
 	return result;
 }
 
-static void parse_ast(Parsing_Result& parsing_result, IR& ir, AST_Node* node)
+inline IR_Function& get_current_function(IR_Function_Generator& generator)
 {
-	if (!node) {
-		return;
+	return generator.ir->functions[generator.function_index];
+}
+
+static Register::Type get_register_type(Type_Info* type_info, const Token<Keyword>& token)
+{
+	if (type_info->kind == Type_Info::Kind::POINTER) {
+		return Register::Type::QWORD | Register::Type::POINTER;
+	}
+	else if (type_info->kind == Type_Info::Kind::BASIC) {
+		switch (type_info->keyword)
+		{
+		case Keyword::BOOL:
+		case Keyword::UI8:
+			return Register::Type::BYTE | Register::Type::UNSIGNED;
+		case Keyword::I8:
+			return Register::Type::BYTE;
+		case Keyword::I16:
+			return Register::Type::WORD;
+		case Keyword::UI16:
+			return Register::Type::WORD | Register::Type::UNSIGNED;
+		case Keyword::I32:
+			return Register::Type::DWORD;
+		case Keyword::UI32:
+			return Register::Type::DWORD | Register::Type::UNSIGNED;
+		case Keyword::I64:
+			return Register::Type::QWORD;
+		case Keyword::UI64:
+			return Register::Type::QWORD | Register::Type::UNSIGNED;
+		case Keyword::F32:
+			return Register::Type::FLOAT;
+		case Keyword::F64:
+			return Register::Type::DOUBLE;
+		case Keyword::F32X4:
+			return Register::Type::VECTOR | Register::Type::FLOAT;
+		case Keyword::F64X2:
+			return Register::Type::VECTOR | Register::Type::DOUBLE;
+		case Keyword::I8X16:
+			return Register::Type::VECTOR | Register::Type::BYTE;
+		case Keyword::I16X8:
+			return Register::Type::VECTOR | Register::Type::WORD;
+		case Keyword::I32X4:
+			return Register::Type::VECTOR | Register::Type::DWORD;
+		case Keyword::I64X2:
+			return Register::Type::VECTOR | Register::Type::QWORD;
+		default:
+			break;
+		}
+	}
+
+	// @TODO structs, arrays and strings should be lowered to stack slots and memory accesses
+	report_error(Compiler_Error::internal_error, token, "Only numeric types and pointers are supported by the IR generator for the moment.");
+	return Register::Type::QWORD;
+}
+
+static uint32_t allocate_register(IR_Function_Generator& generator, Register::Type type)
+{
+	IR_Function& function = get_current_function(generator);
+
+	memory::array_push_back(function.registers, type);
+	return (uint32_t)memory::get_array_size(function.registers) - 1;
+}
+
+static uint32_t begin_block(IR_Function_Generator& generator)
+{
+	IR_Function&	function = get_current_function(generator);
+	IR_Basic_Block	block;
+
+	core::Assert(memory::is_array_empty(function.blocks)
+		|| memory::get_array_last_element(function.blocks)->nb_instructions > 0); // The previous block should be terminated
+
+	block.first_instruction = (uint32_t)memory::get_array_size(function.instructions);
+	block.nb_instructions = 0;
+	block.first_predecessor = 0;
+	block.nb_predecessors = 0;
+	block.immediate_dominator = invalid_block;
+	block.first_dominated = invalid_block;
+	block.next_dominated = invalid_block;
+	block.count = 0;
+	block.taken_count = 0;
+	block.is_cold = false;
+	memory::array_push_back(function.blocks, block);
+	return (uint32_t)memory::get_array_size(function.blocks) - 1;
+}
+
+static bool is_block_terminated(IR_Function_Generator& generator)
+{
+	IR_Function&	function = get_current_function(generator);
+	IR_Basic_Block*	block = memory::get_array_last_element(function.blocks);
+
+	return block->nb_instructions > 0
+		&& is_terminator(function.instructions[block->first_instruction + block->nb_instructions - 1].opcode);
+}
+
+static IR_Instruction* emit(IR_Function_Generator& generator, IR_Opcode opcode, Register::Type type, uint32_t destination, uint32_t a = invalid_register, uint32_t b = invalid_register)
+{
+	IR_Function& function = get_current_function(generator);
+
+	// Code after a return is unreachable, but it still has to be in a block
+	if (is_block_terminated(generator)) {
+		begin_block(generator);
 	}
 
-	bool	recurse_sibling = true;
+	IR_Instruction* instruction = memory::array_emplace_back(function.instructions);
 
-	if (node->ast_type == Node_Type::TYPE_ALIAS) {
-		// @Warning we do nothing here because the types were already stored in the symbol table
-		// We may eventually want to replace the type base is underlying one if our aliases are links,
-		// but if they acts like new types (like typedef in C++) then we should store all information to be able to
-		// check type conversions (aka cast)
+	memory::get_array_last_element(function.blocks)->nb_instructions++;
 
+	instruction->opcode = opcode;
+	instruction->type = type;
+	instruction->destination = destination;
+	instruction->operands[0] = a;
+	instruction->operands[1] = b;
+	instruction->immediate.integer = 0;
+	return instruction;
+}
 
-		//AST_Alias* alias_node = (AST_Alias*)node;
+static uint32_t convert(IR_Function_Generator& generator, uint32_t register_id, Register::Type type)
+{
+	Register::Type source_type = get_current_function(generator).registers[register_id];
 
-		////print_to_builder(file_string_builder, "typedef ");
-		//parse_ast(parsing_result, ir, alias_node->type);
-		////print_to_builder(file_string_builder, " %v;\n", alias_node->name.text);
+	if (source_type == type) {
+		return register_id;
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_BASIC_TYPE) {
-		AST_Statement_Basic_Type* basic_type_node = (AST_Statement_Basic_Type*)node;
 
-		//indented_print_to_builder(file_string_builder, "%v", basic_type_node->token.text);
+	if (is_vector(source_type)) {
+		report_error(Compiler_Error::error, get_current_function(generator).declaration->name, "A vector can't be converted to another type, lanes have to be extracted.");
+	}
+	else if (is_vector(type)) {
+		// The scalar is converted to the type of lanes before being put in all of them
+		register_id = convert(generator, register_id, get_lane_type(type));
 	}
-	else if (node->ast_type == Node_Type::USER_TYPE_IDENTIFIER) {
-		AST_User_Type_Identifier* user_type_node = (AST_User_Type_Identifier*)node;
 
-		AST_Node* underlying_type = get_user_type(user_type_node);
+	uint32_t result = allocate_register(generator, type);
+	emit(generator, IR_Opcode::CONVERT, type, result, register_id);
+	return result;
+}
 
-		//indented_print_to_builder(file_string_builder, "/*%v*/", user_type_node->identifier.text);
-		if (underlying_type)
-			parse_ast(parsing_result, ir, resolve_type(underlying_type));
+// Usual arithmetic conversions: vectors win (a scalar operand is put in all lanes), then floating points, then the
+// biggest size, then unsigned. Like in the constant folder, an integer is converted to the floating point type of the
+// other operand.
+static Register::Type get_common_type(Register::Type a, Register::Type b)
+{
+	if (is_vector(a) || is_vector(b)) {
+		return is_vector(a) ? a : b;
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_TYPE_POINTER) {
-		AST_Statement_Type_Pointer* basic_type_node = (AST_Statement_Type_Pointer*)node;
 
-		parse_ast(parsing_result, ir, basic_type_node->sibling);
-		//print_to_builder(file_string_builder, "*");
-		recurse_sibling = false;
+	if (is_floating_point(a) || is_floating_point(b)) {
+		return (has_flag(a, Register::Type::DOUBLE) || has_flag(b, Register::Type::DOUBLE)) ? Register::Type::DOUBLE : Register::Type::FLOAT;
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_FUNCTION) {
-		AST_Statement_Function* function_node = (AST_Statement_Function*)node;
 
-		// @TODO generate C function declaration that should be done in the correct order (after declaration types)
-		// Be careful of function pointers
+	if (get_register_size(a) != get_register_size(b)) {
+		return get_register_size(a) > get_register_size(b) ? a : b;
+	}
+	return has_flag(a, Register::Type::UNSIGNED) ? a : b;
+}
 
-		parse_function_declaration(ir, function_node);
-		//write_function_declaration(file_string_builder, ir, function_node);
+static uint32_t add_string_literal(IR& ir, AST_Literal* literal_node)
+{
+	// @TODO use the *literal_node->value.value.string instead of the token's text
+	return f::add_string_literal(ir.read_only_data, literal_node->value.text.ptr, (uint32_t)literal_node->value.text.size);
+}
 
-		if (function_node->scope) {
-			// @TODO make it static
-			fstd::language::string_view	main_string;
-			fstd::language::assign(main_string, (uint8_t*)"main");
+static uint32_t generate_expression(IR_Function_Generator& generator, AST_Node* node);
 
-			if (language::are_equals(function_node->name.text, main_string)) {
-				log(*globals.logger, Log_Level::info, "[IR] Found entry point\n");
-				// @TODO register the RVA for the backend
-			}
+static uint32_t generate_literal(IR_Function_Generator& generator, AST_Literal* literal_node)
+{
+	const Token<Keyword>&	token = literal_node->value;
+	Register::Type			type;
+	IR_Immediate			value;
 
-			
+	switch (token.type)
+	{
+	case Token_Type::STRING_LITERAL:
+	{
+		uint32_t result = allocate_register(generator, Register::Type::QWORD | Register::Type::POINTER);
 
+		emit(generator, IR_Opcode::ADDRESS, Register::Type::QWORD | Register::Type::POINTER, result)->immediate.index = add_string_literal(*generator.ir, literal_node);
+		return result;
+	}
+	case Token_Type::NUMERIC_LITERAL_I32:
+		type = Register::Type::DWORD;
+		value.integer = token.value.integer;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+		type = Register::Type::DWORD | Register::Type::UNSIGNED;
+		value.integer = (int64_t)token.value.unsigned_integer;
+		break;
+	case Token_Type::NUMERIC_LITERAL_I64:
+		type = Register::Type::QWORD;
+		value.integer = token.value.integer;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI64:
+		type = Register::Type::QWORD | Register::Type::UNSIGNED;
+		value.integer = (int64_t)token.value.unsigned_integer;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F32:
+		type = Register::Type::FLOAT;
+		value.real = token.value.real_32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F64:
+		type = Register::Type::DOUBLE;
+		value.real = token.value.real_64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_REAL:
+		type = Register::Type::DOUBLE;
+		value.real = (double)token.value.real_max;
+		break;
+	default:
+		report_error(Compiler_Error::internal_error, token, "This literal isn't supported by the IR generator for the moment.");
+		return invalid_register;
+	}
 
+	uint32_t result = allocate_register(generator, type);
+	emit(generator, IR_Opcode::CONSTANT, type, result)->immediate = value;
+	return result;
+}
+
+static uint32_t generate_identifier(IR_Function_Generator& generator, AST_Identifier* identifier_node)
+{
+	AST_Statement_Variable* variable_node = get_variable(identifier_node);
 
-			//print_to_builder(file_string_builder, "\n");
-			parse_ast(parsing_result, ir, function_node->return_type);
-			//print_to_builder(file_string_builder, " %v(", function_node->name.text);
-			//write_argument_list(file_string_builder, ir, (AST_Node*)function_node->arguments);
-			//print_to_builder(file_string_builder, ")%Cs\n", function_node->scope ? "" : ";");
-			parse_ast(parsing_result, ir, (AST_Node*)function_node->scope);
+	// @SpeedUp linear search, but there is generally few variables in a function
+	for (size_t i = memory::get_array_size(generator.locals); i > 0; i--) {
+		if (generator.locals[i - 1].variable == variable_node) {
+			return generator.locals[i - 1].register_id;
 		}
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_VARIABLE) {
-		// For array take a look at STATEMENT_TYPE_ARRAY
-		// Flamaros - 30 october 2020
 
-		AST_Statement_Variable* variable_node = (AST_Statement_Variable*)node;
-		AST_Node* type = variable_node->type;
+	// Global constants are used as immediate values
+	if (variable_node->is_function_parameter == false
+		&& fold_constant_expression(&variable_node->expression)
+		&& variable_node->expression->ast_type == Node_Type::STATEMENT_LITERAL) {
+		uint32_t value = generate_literal(generator, (AST_Literal*)variable_node->expression);
 
-		if (variable_node->is_function_parameter) {
-			// @TODO copy the value to an allocated register (from reserverd register or stack, depending of the calling convention)
-			core::Assert(false);
+		return convert(generator, value, get_register_type(variable_node->type_info, variable_node->name));
+	}
+
+	// @TODO global variables should be stored in the .data section
+	report_error(Compiler_Error::internal_error, identifier_node->value, "Only local variables and global constants are supported by the IR generator for the moment.");
+	return invalid_register;
+}
+
+static uint32_t generate_call(IR_Function_Generator& generator, AST_Function_Call* function_call_node)
+{
+	AST_Statement_Function*	callee_node = get_function(function_call_node);
+	uint32_t				callee_index = register_function(*generator.ir, callee_node);
+
+	if (function_call_node->nb_arguments != callee_node->nb_arguments) {
+		report_error(Compiler_Error::error, function_call_node->name, "Wrong number of arguments.");
+	}
+
+	// Arguments are generated before the operand list is filled, as they can contain calls too
+	memory::Array<uint32_t>	arguments;
+	AST_Statement_Variable*	argument_declaration = callee_node->arguments;
+
+	defer{ memory::release(arguments); };
+
+	memory::reserve_array(arguments, (size_t)function_call_node->nb_arguments);
+	for (AST_Node* parameter = function_call_node->parameters; parameter; parameter = parameter->sibling) {
+		uint32_t value = generate_expression(generator, parameter);
+
+		memory::array_push_back(arguments, convert(generator, value, get_register_type(argument_declaration->type_info, argument_declaration->name)));
+		argument_declaration = (AST_Statement_Variable*)argument_declaration->sibling;
+	}
+
+	IR_Function&	function = get_current_function(generator);
+	IR_Function&	callee = generator.ir->functions[callee_index];
+	uint32_t		result = callee.has_return_value ? allocate_register(generator, callee.return_type) : invalid_register;
+	uint32_t		first_operand = (uint32_t)memory::get_array_size(function.operand_lists);
+
+	memory::array_copy(function.operand_lists, first_operand, arguments);
+	emit(generator, IR_Opcode::CALL, callee.return_type, result, first_operand, (uint32_t)memory::get_array_size(arguments))->immediate.index = callee_index;
+	return result;
+}
+
+// Lanes are named x, y, z and w, v.z is the third lane and v.wzyx reverses the vector. Swizzles that return a vector
+// use all lanes, they are only available on vectors of 2 or 4 lanes.
+static uint32_t generate_swizzle(IR_Function_Generator& generator, uint32_t value, const Token<Keyword>& swizzle)
+{
+	Register::Type	type = get_current_function(generator).registers[value];
+	uint32_t		nb_lanes = get_nb_lanes(type);
+	size_t			size = language::get_string_size(swizzle.text);
+	int64_t			lanes = 0;
+
+	if (size != 1 && (size != nb_lanes || nb_lanes > 4)) {
+		report_error(Compiler_Error::error, swizzle, "A swizzle should select a single lane, or all lanes of a vector of 2 or 4 lanes.");
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		uint8_t		character = language::to_utf8(swizzle.text)[i];
+		int64_t		lane = character == 'x' ? 0 : character == 'y' ? 1 : character == 'z' ? 2 : character == 'w' ? 3 : 4;
+
+		if (lane >= nb_lanes) {
+			report_error(Compiler_Error::error, swizzle, "Unknown lane, lanes are x, y, z and w.");
 		}
-		else {
-			if (variable_node->expression) {
-				// @TODO init the variable with the result of the expression
-				// 1. Generate code for the expression
-				// 2. Get the return value register to be able to asign this register or a copy to the variable
-				// 3. Do the cast if return type and variable type didn't directly match (can be done by the copy) (check if this implicite cast is allowed)
-				//    - Explicit cast should already have generated an instruction from the instruction parsing
-				core::Assert(false);
+		lanes |= lane << (4 * i);
+	}
+
+	if (size == 1) {
+		uint32_t result = allocate_register(generator, get_lane_type(type));
+
+		emit(generator, IR_Opcode::EXTRACT, type, result, value)->immediate.index = (uint32_t)lanes;
+		return result;
+	}
+
+	uint32_t result = allocate_register(generator, type);
+
+	emit(generator, IR_Opcode::SHUFFLE, type, result, value)->immediate.integer = lanes;
+	return result;
+}
+
+static uint32_t generate_expression(IR_Function_Generator& generator, AST_Node* node)
+{
+	if (node->ast_type == Node_Type::STATEMENT_LITERAL) {
+		return generate_literal(generator, (AST_Literal*)node);
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_IDENTIFIER) {
+		return generate_identifier(generator, (AST_Identifier*)node);
+	}
+	else if (node->ast_type == Node_Type::UNARY_OPERATOR_NEGATIVE) {
+		uint32_t		value = generate_expression(generator, ((AST_Unary_operator*)node)->right);
+		Register::Type	type = get_current_function(generator).registers[value];
+		uint32_t		result = allocate_register(generator, type);
+
+		emit(generator, IR_Opcode::NEG, type, result, value);
+		return result;
+	}
+	else if (is_binary_operator(node) && node->ast_type != Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
+		AST_Binary_Operator*	binary_operator_node = (AST_Binary_Operator*)node;
+		uint32_t				left = generate_expression(generator, binary_operator_node->left);
+		uint32_t				right = generate_expression(generator, binary_operator_node->right);
+		Register::Type			left_type = get_current_function(generator).registers[left];
+		Register::Type			right_type = get_current_function(generator).registers[right];
+		Register::Type			type = get_common_type(left_type, right_type);
+
+		if (is_vector(left_type) && is_vector(right_type) && left_type != right_type) {
+			report_error(Compiler_Error::error, binary_operator_node->token, "Operands are vectors of different types.");
+		}
+
+		left = convert(generator, left, type);
+		right = convert(generator, right, type);
+
+		IR_Opcode opcode;
+		switch (node->ast_type)
+		{
+		case Node_Type::BINARY_OPERATOR_ADDITION:
+			opcode = IR_Opcode::ADD;
+			break;
+		case Node_Type::BINARY_OPERATOR_SUBSTRACTION:
+			opcode = IR_Opcode::SUB;
+			break;
+		case Node_Type::BINARY_OPERATOR_MULTIPLICATION:
+			if (type == (Register::Type::VECTOR | Register::Type::BYTE) || type == (Register::Type::VECTOR | Register::Type::QWORD)) {
+				report_error(Compiler_Error::error, binary_operator_node->token, "Vectors of i8 and i64 can't be multiplied, SSE doesn't have these instructions.");
 			}
-			else {
-				// @TODO generate the value, for basic type it is an immediate value, for a struct the code to generate is a bit more complicated
-				// I should iterate over all members
+			opcode = IR_Opcode::MUL;
+			break;
+		case Node_Type::BINARY_OPERATOR_DIVISION:
+			if (is_vector(type) && !is_floating_point(get_lane_type(type))) {
+				report_error(Compiler_Error::error, binary_operator_node->token, "Vectors of integers can't be divided.");
+			}
+			opcode = IR_Opcode::DIV;
+			break;
+		case Node_Type::BINARY_OPERATOR_REMINDER:
+			if (is_vector(type)) {
+				report_error(Compiler_Error::error, binary_operator_node->token, "The operator '%' can't be used with vectors.");
+			}
+			if (is_floating_point(type)) {
+				report_error(Compiler_Error::error, binary_operator_node->token, "The operator '%' can't be used with floating point values.");
 			}
+			opcode = IR_Opcode::REM;
+			break;
+		default:
+			core::Assert(false);
+			opcode = IR_Opcode::NOP;
 		}
 
+		uint32_t result = allocate_register(generator, type);
+		emit(generator, opcode, type, result, left, right);
+		return result;
+	}
+	else if (node->ast_type == Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
+		AST_Binary_Operator*	binary_operator_node = (AST_Binary_Operator*)node;
+		uint32_t				value = generate_expression(generator, binary_operator_node->left);
 
-		// Write type
-		if (type->ast_type == Node_Type::STATEMENT_TYPE_ARRAY && ((AST_Statement_Type_Array*)type)->array_size != nullptr) {
-			// In this case we have to jump the array modifier
-			parse_ast(parsing_result, ir, variable_node->type->sibling);
+		if (!is_vector(get_current_function(generator).registers[value]) || binary_operator_node->right->ast_type != Node_Type::STATEMENT_IDENTIFIER) {
+			report_error(Compiler_Error::internal_error, binary_operator_node->token, "Only swizzles of vectors are supported by the IR generator for the moment.");
 		}
-		else {
-			parse_ast(parsing_result, ir, variable_node->type);
+		return generate_swizzle(generator, value, ((AST_Identifier*)binary_operator_node->right)->value);
+	}
+	else if (node->ast_type == Node_Type::FUNCTION_CALL) {
+		uint32_t result = generate_call(generator, (AST_Function_Call*)node);
+
+		if (result == invalid_register) {
+			report_error(Compiler_Error::error, ((AST_Function_Call*)node)->name, "A function without return value can't be used in an expression.");
 		}
+		return result;
+	}
 
-		// Write variable name
-		//print_to_builder(file_string_builder, " %v", variable_node->name.text);
+	// #run directives are already replaced by their result by the constant folder
+	report_error(Compiler_Error::internal_error, get_current_function(generator).declaration->name, "This function uses an expression that isn't supported by the IR generator for the moment.");
+	return invalid_register;
+}
 
-		// Write array
-		if (type->ast_type == Node_Type::STATEMENT_TYPE_ARRAY && ((AST_Statement_Type_Array*)type)->array_size != nullptr) {
-			parse_ast(parsing_result, ir, variable_node->type);
-		}
+// Lowering of switch statements
+//
+// Values of cases are sorted, then the range of values is lowered recursively:
+//   - up to max_compare_chain_cases values are compared one after the other,
+//   - a dense range (at least min_jump_table_density percent of its values are cases) is bounds checked then
+//     dispatched by a SWITCH, the code generator puts its jump table in the read only data,
+//   - otherwise the range is split at its median value by a comparison, so sparse values give a balanced binary
+//     decision tree and dense clusters of values still get their own jump table.
+// An indirect jump is badly predicted when the value is random, so a table is only used when it replaces a few
+// levels of the tree.
+//
+// Cases don't have a block until their body is generated, the dispatch code targets them with switch_case_flag
+// then targets are patched.
+
+static const size_t		max_compare_chain_cases = 3;
+static const size_t		min_jump_table_cases = 4;
+static const uint64_t	min_jump_table_density = 40;	// In percent
+static const uint64_t	max_jump_table_entries = 4096;
+static const uint32_t	switch_case_flag = 0x80000000;	// Target that is the index of a case (nb_cases for the end of the switch)
+
+struct IR_Switch_Value
+{
+	int64_t			value;
+	uint32_t		target;	// switch_case_flag | case index
+	AST_Literal*	literal;
+};
 
-		// End the declaration
-		if (variable_node->is_function_parameter == false) {
-			// @TODO
-			// Write the initialization code if necessary (don't have an expression)
-			if (variable_node->expression == nullptr) { // @TODO Later we should do something clever (the back-end optimizer should be able to detect double initializations (taking only last write before first read))
-				//if (globals.cpp_backend_data.union_declaration_depth == 0) {
-					//write_default_initialization(file_string_builder, variable_node, variable_node->type);
-				//}
-			}
-			else {
-				//print_to_builder(file_string_builder, " = ");
-				//write_expression(file_string_builder, ir, variable_node->expression);
-			}
+struct IR_Switch_Generator
+{
+	uint32_t						value;	// QWORD register
+	Register::Type					type;
+	uint32_t						default_target;
+	memory::Array<IR_Switch_Value>	values;	// Sorted
+};
 
-			//print_to_builder(file_string_builder, ";\n");
-		}
+static void generate_statements(IR_Function_Generator& generator, AST_Node* node);
 
-		// @TODO write the generated_code for expression
-		// Get the register that contains the result
-		//
-		// We certainly have to implement the type checker here that create the register of sub-expression with the good type
-		// then check types compatibilities when descending the in tree.
-		// There is also the case of string type that should be declared (as struct) before getting assignement of his members.
-		// For a string we have to allocate 2 (one for the data pointer, and an other for the size) registers and copy them.
-		//parse_ast();
+static bool is_switch_value_before(const IR_Switch_Generator& switch_generator, const IR_Switch_Value& a, const IR_Switch_Value& b)
+{
+	if (has_flag(switch_generator.type, Register::Type::UNSIGNED)) {
+		return (uint64_t)a.value < (uint64_t)b.value;
+	}
+	return a.value < b.value;
+}
 
-		if (variable_node->expression) {
-			// @TODO
-			// Est-ce que je dois dclencher un parsing particulier ici afin de pouvoir binder le rsultat si l'expression est compiletime
-			// ou rcuprer un pointeur sur une section de code  executer?
+static uint32_t emit_switch_constant(IR_Function_Generator& generator, Register::Type type, int64_t value)
+{
+	uint32_t result = allocate_register(generator, type);
 
-			parse_ast(parsing_result, ir, variable_node->expression);
-		}
+	emit(generator, IR_Opcode::CONSTANT, type, result)->immediate.integer = value;
+	return result;
+}
+
+// The next emitted instruction begins a new block, because the current one is terminated
+inline uint32_t get_next_block(IR_Function_Generator& generator)
+{
+	return (uint32_t)memory::get_array_size(get_current_function(generator).blocks);
+}
+
+static void emit_switch_branch(IR_Function_Generator& generator, uint32_t condition, uint32_t target_true, uint32_t target_false)
+{
+	IR_Instruction* branch = emit(generator, IR_Opcode::BRANCH, Register::Type::BYTE, invalid_register, condition);
+
+	branch->immediate.targets[0] = target_true;
+	branch->immediate.targets[1] = target_false;
+}
+
+static bool is_switch_range_dense(const IR_Switch_Generator& switch_generator, size_t first, size_t last)
+{
+	uint64_t nb_values = last - first;
+	uint64_t span = (uint64_t)switch_generator.values[last - 1].value - (uint64_t)switch_generator.values[first].value; // Minus one
+
+	return nb_values >= min_jump_table_cases
+		&& span < max_jump_table_entries
+		&& nb_values * 100 >= (span + 1) * min_jump_table_density;
+}
 
+static void generate_switch_jump_table(IR_Function_Generator& generator, IR_Switch_Generator& switch_generator, size_t first, size_t last)
+{
+	Register::Type	index_type = Register::Type::QWORD | Register::Type::UNSIGNED;
+	int64_t			min_value = switch_generator.values[first].value;
+	uint64_t		nb_entries = (uint64_t)switch_generator.values[last - 1].value - (uint64_t)min_value + 1;
+	uint32_t		index = convert(generator, switch_generator.value, index_type);
+
+	// A single unsigned comparison checks both bounds, values lower than the min wrap around
+	if (min_value != 0) {
+		uint32_t offset = index;
+
+		index = allocate_register(generator, index_type);
+		emit(generator, IR_Opcode::SUB, index_type, index, offset, emit_switch_constant(generator, index_type, min_value));
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_TYPE_ARRAY) {
-		// In cpp with can't declare dynamic arrays on the stack so for simplicity we convert them as pointers.
-		// Flamaros - 30 october 2020
-		AST_Statement_Type_Array* array_node = (AST_Statement_Type_Array*)node;
 
-		if (array_node->array_size) {
-			// It is the variable statement that is responsible to write the siblings of the array (the type and other modifiers)
-			// Because the array modifier appears after the variable name in this case.
-			//print_to_builder(file_string_builder, "[");
-			if (array_node->array_size) {
-				parse_ast(parsing_result, ir, (AST_Node*)array_node->array_size);
-			}
-			//print_to_builder(file_string_builder, "]");
+	uint32_t is_in_range = allocate_register(generator, Register::Type::BYTE);
+
+	emit(generator, IR_Opcode::LESS, index_type, is_in_range, index, emit_switch_constant(generator, index_type, (int64_t)nb_entries));
+	emit_switch_branch(generator, is_in_range, get_next_block(generator), switch_generator.default_target);
+
+	// Successors are distinct, the table references them by their position in the list
+	IR_Function&	function = get_current_function(generator);
+	uint32_t		first_operand = (uint32_t)memory::get_array_size(function.operand_lists);
+	uint32_t		nb_successors = 0;
+	size_t			value_index = first;
+
+	memory::resize_array(function.operand_lists, first_operand + nb_entries);	// Successors can't be more than entries
+	for (uint64_t entry = 0; entry < nb_entries; entry++) {
+		uint32_t target = switch_generator.default_target;
+
+		if (value_index < last && (uint64_t)(switch_generator.values[value_index].value - min_value) == entry) {
+			target = switch_generator.values[value_index++].target;
 		}
-		else {
-			parse_ast(parsing_result, ir, array_node->sibling);
-			//print_to_builder(file_string_builder, "*");
+
+		uint32_t successor = 0;
+		while (successor < nb_successors && function.operand_lists[first_operand + successor] != target) {
+			successor++;
+		}
+		if (successor == nb_successors) {
+			function.operand_lists[first_operand + nb_successors++] = target;
 		}
-		recurse_sibling = false;
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_SCOPE) {
-		AST_Statement_Scope* scope_node = (AST_Statement_Scope*)node;
 
-		if (node != ir.parsing_result->ast_root) {
-			//indented_print_to_builder(file_string_builder, "{\n");
+	// Consecutive values of a same case without hole
+	if (nb_successors == 1) {
+		uint32_t target = function.operand_lists[first_operand];
+
+		memory::resize_array(function.operand_lists, first_operand);
+		emit(generator, IR_Opcode::JUMP, Register::Type::QWORD, invalid_register)->immediate.targets[0] = target;
+		return;
+	}
+
+	memory::resize_array(function.operand_lists, first_operand + nb_successors);
+	memory::array_push_back(function.operand_lists, (uint32_t)nb_entries);
+
+	value_index = first;
+	for (uint64_t entry = 0; entry < nb_entries; entry++) {
+		uint32_t target = switch_generator.default_target;
+
+		if (value_index < last && (uint64_t)(switch_generator.values[value_index].value - min_value) == entry) {
+			target = switch_generator.values[value_index++].target;
 		}
-		parse_ast(parsing_result, ir, (AST_Node*)scope_node->first_child);
-		if (node != ir.parsing_result->ast_root) {
-			//indented_print_to_builder(file_string_builder, "}\n");
+
+		uint32_t successor = 0;
+		while (function.operand_lists[first_operand + successor] != target) {
+			successor++;
 		}
+		memory::array_push_back(function.operand_lists, successor);
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_LITERAL) {
-		AST_Literal* literal_node = (AST_Literal*)node;
 
-		if (literal_node->value.type == Token_Type::STRING_LITERAL) {
-			Literal literal;
+	IR_Instruction* instruction = emit(generator, IR_Opcode::SWITCH, index_type, invalid_register, index);
 
-			// @TODO use the *literal_node->value.value.string instead of the token's text
-			memory::reserve_array(literal.data, literal_node->value.text.size + 1);
-			memory::array_copy(literal.data, 0, literal_node->value.text.ptr, literal_node->value.text.size);
-			memory::array_push_back(literal.data, (uint8_t)'\0');
-			literal.RVA = ir.read_only_data.current_RVA;
+	instruction->immediate.targets[0] = first_operand;
+	instruction->immediate.targets[1] = nb_successors;
+}
 
-			// @TODO @SpeedUp see how this bufer can be pre-allocated
-			memory::array_push_back(ir.read_only_data.literals, literal);
-			ir.read_only_data.current_RVA += memory::get_array_size(literal.data);
-		}
-		else if (literal_node->value.type == Token_Type::NUMERIC_LITERAL_I32
-			|| literal_node->value.type == Token_Type::NUMERIC_LITERAL_I64) {
-			//print_to_builder(file_string_builder, "%ld", literal_node->value.value.integer);
+// Values of the range [first, last[ are the only ones that can still match
+static void generate_switch_range(IR_Function_Generator& generator, IR_Switch_Generator& switch_generator, size_t first, size_t last)
+{
+	size_t nb_values = last - first;
+
+	if (nb_values <= max_compare_chain_cases) {
+		for (size_t i = first; i < last; i++) {
+			uint32_t is_equal = allocate_register(generator, Register::Type::BYTE);
+
+			emit(generator, IR_Opcode::EQUAL, switch_generator.type, is_equal, switch_generator.value, emit_switch_constant(generator, switch_generator.type, switch_generator.values[i].value));
+			emit_switch_branch(generator, is_equal, switch_generator.values[i].target, i + 1 < last ? get_next_block(generator) : switch_generator.default_target);
 		}
-		else {
-			core::Assert(false);
-			// @TODO implement it
-			// Actually the string builder doesn't support floats and unsigned intergers
+		if (nb_values == 0) {
+			emit(generator, IR_Opcode::JUMP, Register::Type::QWORD, invalid_register)->immediate.targets[0] = switch_generator.default_target;
 		}
-		recurse_sibling = false;
+		return;
 	}
-	else if (is_binary_operator(node)) {
-		AST_Binary_Operator* binary_operator_node = (AST_Binary_Operator*)node;
 
-		//indented_print_to_builder(file_string_builder, "tmp_register = \n");
-		//print_to_builder(file_string_builder, "");
-		//		//indented_print_to_builder(file_string_builder, "%v", basic_type_node->token.text);
-	}
-	else if (node->ast_type == Node_Type::STATEMENT_IDENTIFIER) {
-		AST_Identifier* identifier_node = (AST_Identifier*)node;
-		AST_Node* resolved_node = resolve_type(node);
-
-		// parse_ast is suceptible to generate type declaration of resolved type.
-		// Instead we want to generate a type reference, this is really different for struct, enum and unions
-		// for which write_type will use there identifiers.
-		//write_type(ir, resolved_node);
-
-		// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-		// @TODO
-		// Ici on atteint la limite de la fonction parse_ast qui est trop gnrique et tentante de faire une traduction
-		// 1:1 du f vers le C++.
-		// On a besoin du contexte, pour la dclaration d'un alias un type et attendu et doit tre rsolut avec symbol_solver,
-		// mais si on est au milieu d'instructions on cherche certainement une variable.
-		// Ceci  un impacte sur les symbol tables  tester et aussi sur les messages d'erreurs (comprendre l'analyse du code f).
-
-		////print_to_builder(file_string_builder,
-		//	"%Cv"
-		//	"\n%v", magic_enum::enum_name(node->ast_type), identifier_node->value.text);
-	}
-	//else if (node->ast_type == Node_Type::FUNCTION_CALL) {
-	//	AST_Function_Call* function_call_node = (AST_Function_Call*)node;
-
-	//	//print_to_builder(file_string_builder,
-	//		"%Cv"
-	//		"\nname: %v (nb_arguments: %d)", magic_enum::enum_name(node->ast_type), function_call_node->name.text, function_call_node->nb_arguments);
-	//}
-	else if (node->ast_type == Node_Type::UNARY_OPERATOR_ADDRESS_OF) {
-		AST_Unary_operator* address_of_node = (AST_Unary_operator*)node;
-
-		parse_ast(parsing_result, ir, address_of_node->right); // @TODO should be write_type?
-		//print_to_builder(file_string_builder, "*");
+	if (is_switch_range_dense(switch_generator, first, last)) {
+		generate_switch_jump_table(generator, switch_generator, first, last);
+		return;
 	}
-	else if (node->ast_type == Node_Type::UNARY_OPERATOR_NEGATIVE) {
-		AST_Unary_operator* negative_operator = (AST_Unary_operator*)node;
 
-		report_error(Compiler_Error::warning, "UNARY_OPERATOR_NEGATIVE: TODO implement it\n");
-		// @TODO I should try to evaluate the expression at compile time else generate the runtime code
-		// Depending of kind of compile time expression I may get a "literal" value
-		// Number literal can be inlined in the code as immediate value
-		// String literals and other complexe literals (arrays, structs,...) should go in .rdata section
-	}
-	//else if (node->ast_type == Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
-	//	AST_MEMBER_ACCESS* member_access_node = (AST_MEMBER_ACCESS*)node;
+	// Values lower than the median go to the next block, the block of the others is known after the left subtree
+	size_t		middle = first + nb_values / 2;
+	uint32_t	is_less = allocate_register(generator, Register::Type::BYTE);
 
-	//	//print_to_builder(file_string_builder,
-	//		"%Cv", magic_enum::enum_name(node->ast_type));
-	//}
-	else if (node->ast_type == Node_Type::STATEMENT_TYPE_STRUCT) {
-		// @TODO
-		// We do nothing here, because declaration of structs must be ordered in C unlike in f.
-		// Putting the declaration here may not generate a valid C code if one of his dependencies isn't declared before.
-		//
-		// I need to find a better way to do the C code generation to be able to reorder declarations (types and functions).
+	emit(generator, IR_Opcode::LESS, switch_generator.type, is_less, switch_generator.value, emit_switch_constant(generator, switch_generator.type, switch_generator.values[middle].value));
+	emit_switch_branch(generator, is_less, get_next_block(generator), invalid_block);
 
-		AST_Statement_Struct_Type* struct_node = (AST_Statement_Struct_Type*)node;
+	uint32_t branch = (uint32_t)memory::get_array_size(get_current_function(generator).instructions) - 1;
+
+	generate_switch_range(generator, switch_generator, first, middle);
+	get_current_function(generator).instructions[branch].immediate.targets[1] = get_next_block(generator);
+	generate_switch_range(generator, switch_generator, middle, last);
+}
 
-		if (struct_node->anonymous) {
-			//indented_print_to_builder(file_string_builder, "struct\n");
+static void generate_switch(IR_Function_Generator& generator, AST_Statement_Switch* switch_node)
+{
+	IR_Switch_Generator	switch_generator;
+	uint32_t			value = generate_expression(generator, switch_node->expression);
+	Register::Type		value_type = get_current_function(generator).registers[value];
+	uint32_t			nb_cases = 0;
+
+	memory::init(switch_generator.values);
+
+	defer{ memory::release(switch_generator.values); };
+
+	if (is_vector(value_type) || is_floating_point(value_type) || has_flag(value_type, Register::Type::POINTER)) {
+		report_error(Compiler_Error::error, switch_node->token, "The value of a switch should be an integer.");
+	}
+
+	// Comparisons and the index of the table are on 64 bits, the signedness of the value is kept
+	switch_generator.type = has_flag(value_type, Register::Type::UNSIGNED) ? Register::Type::QWORD | Register::Type::UNSIGNED : Register::Type::QWORD;
+	switch_generator.value = convert(generator, value, switch_generator.type);
+	switch_generator.default_target = invalid_block;
+
+	for (AST_Switch_Case* case_node = switch_node->cases; case_node; case_node = (AST_Switch_Case*)case_node->sibling, nb_cases++) {
+		if (case_node->values == nullptr) {
+			if (switch_generator.default_target != invalid_block) {
+				report_error(Compiler_Error::error, case_node->token, "A switch can only have one default case.");
+			}
+			switch_generator.default_target = switch_case_flag | nb_cases;
 		}
-		else {
-			//indented_print_to_builder(file_string_builder, "struct %v\n", struct_node->name.text);
+
+		for (AST_Node* value_node = case_node->values; value_node; value_node = value_node->sibling) {
+			AST_Literal* literal_node = (AST_Literal*)value_node;
+
+			// Values are already folded by the constant folder
+			if (value_node->ast_type != Node_Type::STATEMENT_LITERAL
+				|| !(literal_node->value.type == Token_Type::NUMERIC_LITERAL_I32 || literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI32
+					|| literal_node->value.type == Token_Type::NUMERIC_LITERAL_I64 || literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI64)) {
+				report_error(Compiler_Error::error, case_node->token, "Values of cases should be constant integers.");
+			}
+
+			bool is_unsigned_literal = literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI32 || literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI64;
+
+			// Both signedness share the 64 bits, but the value has to be representable in the type of the switch
+			if (has_flag(switch_generator.type, Register::Type::UNSIGNED) ? (!is_unsigned_literal && literal_node->value.value.integer < 0)
+				: (is_unsigned_literal && literal_node->value.value.unsigned_integer > (uint64_t)INT64_MAX)) {
+				report_error(Compiler_Error::error, literal_node->value, "This value of case can't be matched by the type of the switch.");
+			}
+
+			IR_Switch_Value switch_value;
+			switch_value.value = literal_node->value.value.integer;
+			switch_value.target = switch_case_flag | nb_cases;
+			switch_value.literal = literal_node;
+
+			// Insertion sort, switches generally have few values
+			size_t position = memory::get_array_size(switch_generator.values);
+			memory::array_push_back(switch_generator.values, switch_value);
+			while (position > 0 && is_switch_value_before(switch_generator, switch_value, switch_generator.values[position - 1])) {
+				switch_generator.values[position] = switch_generator.values[position - 1];
+				position--;
+			}
+			switch_generator.values[position] = switch_value;
+
+			if ((position > 0 && switch_generator.values[position - 1].value == switch_value.value)
+				|| (position + 1 < memory::get_array_size(switch_generator.values) && switch_generator.values[position + 1].value == switch_value.value)) {
+				report_error(Compiler_Error::error, literal_node->value, "This value is already used by another case of the switch.");
+			}
 		}
-		//indented_print_to_builder(file_string_builder, "{\n");
-		parse_ast(parsing_result, ir, struct_node->first_child);
+	}
+
+	// Without default case, other values go to the end of the switch
+	if (switch_generator.default_target == invalid_block) {
+		switch_generator.default_target = switch_case_flag | nb_cases;
+	}
+
+	uint32_t first_dispatch_instruction = (uint32_t)memory::get_array_size(get_current_function(generator).instructions);
+
+	generate_switch_range(generator, switch_generator, 0, memory::get_array_size(switch_generator.values));
+
+	uint32_t				end_target = switch_case_flag | nb_cases;
+	bool					is_end_used = switch_generator.default_target == end_target;
+	size_t					nb_locals = memory::get_array_size(generator.locals);
+	uint32_t				case_index = 0;
+	memory::Array<uint32_t>	case_blocks;
+
+	defer{ memory::release(case_blocks); };
+
+	// There is no fall through, each case jumps to the end of the switch
+	memory::resize_array(case_blocks, nb_cases + 1);
+	for (AST_Switch_Case* case_node = switch_node->cases; case_node; case_node = (AST_Switch_Case*)case_node->sibling, case_index++) {
+		case_blocks[case_index] = get_next_block(generator);
 
-		if (struct_node->anonymous) {
-			//indented_print_to_builder(file_string_builder, "} "); // @Warning if struct is anonymous then the declaration is made at the same type as a variable declaration.
+		generate_statements(generator, case_node->scope->first_child);
+		memory::resize_array(generator.locals, nb_locals);
+
+		// An empty case still needs its block
+		if (get_next_block(generator) == case_blocks[case_index] || !is_block_terminated(generator)) {
+			emit(generator, IR_Opcode::JUMP, Register::Type::QWORD, invalid_register)->immediate.targets[0] = end_target;
+			is_end_used = true;
 		}
-		else {
-			//indented_print_to_builder(file_string_builder, "};\n");
+	}
+
+	IR_Function& function = get_current_function(generator);
+
+	// The end of the switch is an empty block that receives the following statements
+	case_blocks[nb_cases] = get_next_block(generator);
+	if (is_end_used) {
+		begin_block(generator);
+	}
+
+	// Nested switches are already patched, remaining flags are targets of this switch
+	for (uint32_t i = first_dispatch_instruction; i < (uint32_t)memory::get_array_size(function.instructions); i++) {
+		IR_Instruction&	instruction = function.instructions[i];
+		uint32_t*		targets;
+		uint32_t		nb_targets = is_terminator(instruction.opcode) ? get_targets(function, instruction, targets) : 0;
+
+		for (uint32_t target = 0; target < nb_targets; target++) {
+			if (targets[target] & switch_case_flag) {
+				targets[target] = case_blocks[targets[target] & ~switch_case_flag];
+			}
 		}
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_TYPE_UNION) {
-		// @TODO
-		// We do nothing here, because declaration of structs must be ordered in C unlike in f.
-		// Putting the declaration here may not generate a valid C code if one of his dependencies isn't declared before.
-		//
-		// I need to find a better way to do the C code generation to be able to reorder declarations (types and functions).
+}
+
+static void generate_statements(IR_Function_Generator& generator, AST_Node* node)
+{
+	for (AST_Node* current_node = node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_VARIABLE) {
+			AST_Statement_Variable*	variable_node = (AST_Statement_Variable*)current_node;
+			Type_Info*				type_info = variable_node->type_info; // Size and alignment are already computed by the type deduction pass
+
+			core::Assert(type_info != nullptr);
+
+			Register::Type	type = get_register_type(type_info, variable_node->name);
+			uint32_t		variable_register = allocate_register(generator, type);
 
-		AST_Statement_Union_Type* union_node = (AST_Statement_Union_Type*)node;
+			if (variable_node->expression) {
+				uint32_t value = convert(generator, generate_expression(generator, variable_node->expression), type);
+
+				emit(generator, IR_Opcode::COPY, type, variable_register, value);
+			}
+			else {
+				// Default initialization, 0 is also 0.0 and nullptr
+				emit(generator, IR_Opcode::CONSTANT, type, variable_register);
+			}
 
-		if (union_node->anonymous) {
-			//indented_print_to_builder(file_string_builder, "union\n", union_node->name.text);
+			// Registered after its expression, a variable can't be used in its own initialization
+			IR_Local local;
+			local.variable = variable_node;
+			local.register_id = variable_register;
+			memory::array_push_back(generator.locals, local);
 		}
-		else {
-			//indented_print_to_builder(file_string_builder, "union %v\n", union_node->name.text);
+		else if (current_node->ast_type == Node_Type::STATEMENT_RETURN) {
+			AST_Statement_Return*	return_node = (AST_Statement_Return*)current_node;
+			IR_Function&			function = get_current_function(generator);
+
+			if (return_node->expression) {
+				if (function.has_return_value == false) {
+					report_error(Compiler_Error::error, return_node->token, "This function can't return a value.");
+				}
+
+				uint32_t value = convert(generator, generate_expression(generator, return_node->expression), function.return_type);
+				emit(generator, IR_Opcode::RETURN, function.return_type, invalid_register, value);
+			}
+			else {
+				if (function.has_return_value) {
+					report_error(Compiler_Error::error, return_node->token, "This function should return a value.");
+				}
+				emit(generator, IR_Opcode::RETURN, function.return_type, invalid_register);
+			}
 		}
-		//indented_print_to_builder(file_string_builder, "{\n");
-		//globals.cpp_backend_data.union_declaration_depth++;
-		parse_ast(parsing_result, ir, union_node->first_child);
-		//globals.cpp_backend_data.union_declaration_depth--;
-		if (union_node->anonymous) {
-			//indented_print_to_builder(file_string_builder, "} "); // @Warning if union is anonymous then the declaration is made at the same type as a variable declaration.
+		else if (current_node->ast_type == Node_Type::FUNCTION_CALL) {
+			generate_call(generator, (AST_Function_Call*)current_node);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SWITCH) {
+			generate_switch(generator, (AST_Statement_Switch*)current_node);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SCOPE) {
+			size_t nb_locals = memory::get_array_size(generator.locals);
+
+			generate_statements(generator, ((AST_Statement_Scope*)current_node)->first_child);
+			memory::resize_array(generator.locals, nb_locals);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_FUNCTION
+			|| current_node->ast_type == Node_Type::TYPE_ALIAS
+			|| current_node->ast_type == Node_Type::STATEMENT_TYPE_STRUCT
+			|| current_node->ast_type == Node_Type::STATEMENT_TYPE_UNION
+			|| current_node->ast_type == Node_Type::STATEMENT_TYPE_ENUM) {
+			// Nested declarations are generated on their own, types are already in the type table
 		}
 		else {
-			//indented_print_to_builder(file_string_builder, "};\n");
+			report_error(Compiler_Error::internal_error, get_current_function(generator).declaration->name, "This function uses a statement that isn't supported by the IR generator for the moment.");
 		}
 	}
-	else if (node->ast_type == Node_Type::STATEMENT_TYPE_ENUM) {
-		// @TODO
-		// We do nothing here, because declaration of structs must be ordered in C unlike in f.
-		// Putting the declaration here may not generate a valid C code if one of his dependencies isn't declared before.
-		//
-		// I need to find a better way to do the C code generation to be able to reorder declarations (types and functions).
+}
+
+static void generate_function(IR& ir, uint32_t function_index)
+{
+	ZoneScopedN("generate_function");
+
+	IR_Function_Generator	generator;
+	AST_Statement_Function*	function_node = ir.functions[function_index].declaration;
+
+	generator.ir = &ir;
+	generator.function_index = function_index;
+	memory::init(generator.locals);
+
+	defer{ memory::release(generator.locals); };
+
+	begin_block(generator);
 
-		core::Assert(false); // Fix enum parsing before, actually they don't have a name!!!
+	// Arguments are the first registers
+	for (AST_Node* argument = (AST_Node*)function_node->arguments; argument; argument = argument->sibling) {
+		AST_Statement_Variable* argument_node = (AST_Statement_Variable*)argument;
+		IR_Local				local;
 
-		//AST_Statement_Enum_Type* enum_node = (AST_Statement_Enum_Type*)node;
+		local.variable = argument_node;
+		local.register_id = allocate_register(generator, get_register_type(argument_node->type_info, argument_node->name));
 
-		////indented_print_to_builder(file_string_builder, "enum %v\n", enum_node->name.text);
-		////indented_print_to_builder(file_string_builder, "{\n");
-		//parse_ast(parsing_result, ir, enum_node->first_child);
-		////indented_print_to_builder(file_string_builder, "};\n");
+		// Vectors are passed in XMM registers like floating points, stack slots of arguments are too small for them
+		if (is_vector(get_current_function(generator).registers[local.register_id]) && local.register_id >= 4) {
+			report_error(Compiler_Error::error, argument_node->name, "A vector can only be one of the first 4 arguments of a function.");
+		}
+		memory::array_push_back(generator.locals, local);
 	}
-	else if (node->ast_type == Node_Type::FUNCTION_CALL) {
-		//write_function_call(ir, (AST_Function_Call*)node);
 
-		//print_to_builder(file_string_builder, ";\n");
+	generate_statements(generator, function_node->scope->first_child);
+
+	// Implicit return at the end of functions without return value
+	if (!is_block_terminated(generator)) {
+		if (get_current_function(generator).has_return_value) {
+			report_error(Compiler_Error::error, function_node->name, "This function should end with a return statement.");
+		}
+		emit(generator, IR_Opcode::RETURN, get_current_function(generator).return_type, invalid_register);
 	}
-	else {
-		core::Assert(false);
-		// @TODO report error here?
+}
+
+// Return the index of the function in ir.functions, functions are registered on their first use because
+// declarations of imported modules aren't walked.
+static uint32_t register_function(IR& ir, AST_Statement_Function* function_node)
+{
+	// @SpeedUp linear search
+	for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+		if (ir.functions[i].declaration == function_node) {
+			return (uint32_t)i;
+		}
+	}
+
+	IR_Function function;
+
+	function.declaration = function_node;
+	function.imported_function = parse_function_declaration(ir, function_node, function);
+	memory::init(function.instructions);
+	memory::init(function.blocks);
+	memory::init(function.registers);
+	memory::init(function.operand_lists);
+	memory::init(function.predecessors);
+	function.is_ssa = false;
+	function.nb_arguments = (uint32_t)function_node->nb_arguments;
+	function.has_return_value = false;
+	function.return_type = Register::Type::QWORD;
+	function.has_profile = false;
+
+	if (function_node->return_type) {
+		Type_Info* return_type = get_type_info(function_node->return_type);
+
+		if (return_type->kind != Type_Info::Kind::BASIC || return_type->keyword != Keyword::VOID) {
+			function.has_return_value = true;
+			function.return_type = get_register_type(return_type, function_node->name);
+		}
 	}
 
-	// Sibling iteration
-	if (recurse_sibling && node->sibling) {
-		parse_ast(parsing_result, ir, node->sibling);
+	memory::array_push_back(ir.functions, function);
+	return (uint32_t)memory::get_array_size(ir.functions) - 1;
+}
+
+// Walk declarations of the module, bodies of functions are generated after so calls can target functions declared later
+static void parse_declarations(IR& ir, AST_Node* node)
+{
+	for (AST_Node* current_node = node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_FUNCTION) {
+			AST_Statement_Function* function_node = (AST_Statement_Function*)current_node;
+			uint32_t				function_index = register_function(ir, function_node);
+
+			if (function_node->scope) {
+				// @TODO make it static
+				fstd::language::string_view	main_string;
+				fstd::language::assign(main_string, (uint8_t*)"main");
+
+				if (language::are_equals(function_node->name.text, main_string)) {
+					log(*globals.logger, Log_Level::info, "[IR] Found entry point\n");
+					ir.entry_point_function = function_index;
+				}
+
+				parse_declarations(ir, function_node->scope->first_child);
+			}
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SCOPE) {
+			parse_declarations(ir, ((AST_Statement_Scope*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_MODULE) {
+			parse_declarations(ir, ((AST_Statement_Module*)current_node)->first_child);
+		}
+		// @TODO global variables should be stored in the .data section, actually only constants are supported
+		// and they are used as immediate values by functions.
+		// Type declarations are already stored in the type table and imported modules are walked on demand.
 	}
 }
 
-static void parse_function_declaration(IR& ir, AST_Statement_Function* function_node)
+static Imported_Function* parse_function_declaration(IR& ir, AST_Statement_Function* function_node, IR_Function& function)
 {
 	fstd::language::string_view	win32_string;
 	fstd::language::assign(win32_string, (uint8_t*)"win32");
 	fstd::language::string_view	dll_import_string;
 	fstd::language::assign(dll_import_string, (uint8_t*)"dll_import");
+	fstd::language::string_view	no_inline_string;
+	fstd::language::assign(no_inline_string, (uint8_t*)"no_inline");
+	fstd::language::string_view	no_return_string;
+	fstd::language::assign(no_return_string, (uint8_t*)"no_return");
+	fstd::language::string_view	cold_string;
+	fstd::language::assign(cold_string, (uint8_t*)"cold");
 	bool win32_system_call = false;
 	bool is_a_dll_import = false;
 	Token<Keyword>* dll_token = nullptr;
 
+	Inlining& inlining = function.inlining;
+
+	inlining = Inlining::DEFAULT;
+	function.is_no_return = false;
+	function.is_cold = false;
+
 	// win32 means:
 	//   * __stdcall calling convention
 	//   * it's a C function (should not have overloads)
 	//
 	// dll_import means:
 	//   * function can't have implementation: the implementation is in the dll!!!
+	//
+	// inline (it is a keyword) and no_inline force the decision of the inliner
+	//
+	// no_return and cold are hints for the code layout, blocks that call such functions are moved out of the hot code
 
 	// modifiers analysis
 	for (AST_Function_Modifier* current_modifier = function_node->modifiers;
 		current_modifier != nullptr; current_modifier = (AST_Function_Modifier*)current_modifier->sibling)
 	{
-		if (fstd::language::are_equals(current_modifier->value.text, win32_string)) {
+		if (current_modifier->value.type == Token_Type::KEYWORD && current_modifier->value.value.keyword == Keyword::INLINE) {
+			if (inlining != Inlining::DEFAULT)
+				report_error(Compiler_Error::error, current_modifier->value, "inline and no_inline modifiers can be used only once per function declaration.");
+			inlining = Inlining::ALWAYS;
+		}
+		else if (fstd::language::are_equals(current_modifier->value.text, no_inline_string)) {
+			if (inlining != Inlining::DEFAULT)
+				report_error(Compiler_Error::error, current_modifier->value, "inline and no_inline modifiers can be used only once per function declaration.");
+			inlining = Inlining::NEVER;
+		}
+		else if (fstd::language::are_equals(current_modifier->value.text, no_return_string)) {
+			if (function.is_no_return)
+				report_error(Compiler_Error::error, current_modifier->value, "no_return modifier can be used only once per function declaration.");
+			function.is_no_return = true;
+		}
+		else if (fstd::language::are_equals(current_modifier->value.text, cold_string)) {
+			if (function.is_cold)
+				report_error(Compiler_Error::error, current_modifier->value, "cold modifier can be used only once per function declaration.");
+			function.is_cold = true;
+		}
+		else if (fstd::language::are_equals(current_modifier->value.text, win32_string)) {
 			if (win32_system_call)
 				report_error(Compiler_Error::error, current_modifier->value, "win32 modifier was already specified for the current function declaration.");
 			win32_system_call = true;
@@ -455,6 +1054,10 @@ static void parse_function_declaration(IR& ir, AST_Statement_Function* function_
 		}
 	}
 
+	if (is_a_dll_import && inlining == Inlining::ALWAYS) {
+		report_error(Compiler_Error::error, function_node->name, "Functions with dll_import modifier can't be inlined.");
+	}
+
 	if (is_a_dll_import)
 	{
 		Imported_Library** found_imported_lib;
@@ -477,7 +1080,7 @@ static void parse_function_declaration(IR& ir, AST_Statement_Function* function_
 		uint64_t func_hash = SpookyHash::Hash64((const void*)fstd::language::to_utf8(function_node->name.text), fstd::language::get_string_size(function_node->name.text), 0);
 		uint16_t func_short_hash = func_hash & 0xffff;
 
-		found_imported_func = fstd::memory::hash_table_get((*found_imported_lib)->functions, func_short_hash, dll_token->text);
+		found_imported_func = fstd::memory::hash_table_get((*found_imported_lib)->functions, func_short_hash, function_node->name.text);
 
 		if (found_imported_func) {
 			if (win32_system_call) {
@@ -491,25 +1094,14 @@ static void parse_function_declaration(IR& ir, AST_Statement_Function* function_
 		Imported_Function* new_imported_func = allocate_imported_function();
 
 		new_imported_func->function = function_node;
+		new_imported_func->library = *found_imported_lib;
 		new_imported_func->name_RVA = 0;
+		new_imported_func->IAT_RVA = 0;
 
-		fstd::memory::hash_table_insert((*found_imported_lib)->functions, func_short_hash, dll_token->text, new_imported_func);
-	}
-	else
-	{
-		// @TODO
-		//
-		// f-lang code
+		fstd::memory::hash_table_insert((*found_imported_lib)->functions, func_short_hash, function_node->name.text, new_imported_func);
+		return new_imported_func;
 	}
-
-	// @TODO do we need to count arguments,... to ease function call code generation?
-	// We certainly should use a new struct to store IR specific members
-	// struct IR_Function_Decl
-	// {
-	//     AST_Statement_Function* ast_node;
-	//     uint32_t                IAT_addr;
-	//     ...
-	// }
+	return nullptr;
 }
 
 void f::generate_ir(Parsing_Result& parsing_result, IR& ir)
@@ -521,6 +1113,10 @@ void f::generate_ir(Parsing_Result& parsing_result, IR& ir)
 		memory::hash_table_init(ir.imported_libraries, &language::are_equals);
 		memory::init(ir.code_data.code);
 		memory::reserve_array(ir.code_data.code, 4096); // @TODO I really should do something cleaver
+		memory::init(ir.functions);
+		ir.entry_point_function = invalid_function;
+
+		initialize_read_only_data(ir.read_only_data);
 
 		memory::init(globals.ir_data.imported_libraries);
 		memory::reserve_array(globals.ir_data.imported_libraries, NB_PREALLOCATED_IMPORTED_LIBRARIES);
@@ -531,5 +1127,235 @@ void f::generate_ir(Parsing_Result& parsing_result, IR& ir)
 
 	ir.parsing_result = &parsing_result;
 
-	parse_ast(parsing_result, ir, parsing_result.ast_root);
+	parse_declarations(ir, parsing_result.ast_root);
+
+	// Functions of imported modules are appended while generating the ones that call them
+	for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+		if (ir.functions[i].declaration->scope) {
+			generate_function(ir, (uint32_t)i);
+		}
+	}
+
+	layout_read_only_data(ir.read_only_data);
+}
+
+// =============================================================================
+
+// Read only data
+
+static bool are_equals(const Literal_Key& a, const Literal_Key& b)
+{
+	return a.kind == b.kind
+		&& a.size == b.size
+		&& system::memory_compare(memory::get_array_data(*a.pool) + a.offset, memory::get_array_data(*b.pool) + b.offset, a.size);
+}
+
+static uint32_t get_alignment(const Literal& literal)
+{
+	if (literal.kind == Literal::Kind::STRING) {
+		return 1;
+	}
+
+	uint32_t alignment = 1;
+
+	while (alignment < literal.size && alignment < 32) {
+		alignment *= 2;
+	}
+	return alignment;
+}
+
+// Strings are sorted by their reversed content in decreasing order, so a string follows the longer ones that end by it
+static bool is_string_before(const ReadOnlyData& read_only_data, uint32_t a, uint32_t b)
+{
+	const Literal&	literal_a = read_only_data.literals[a];
+	const Literal&	literal_b = read_only_data.literals[b];
+	const uint8_t*	end_a = memory::get_array_data(read_only_data.pool) + literal_a.offset + literal_a.size;
+	const uint8_t*	end_b = memory::get_array_data(read_only_data.pool) + literal_b.offset + literal_b.size;
+	uint32_t		size = literal_a.size < literal_b.size ? literal_a.size : literal_b.size;
+
+	for (uint32_t i = 1; i <= size; i++) {
+		if (end_a[-(int64_t)i] != end_b[-(int64_t)i]) {
+			return end_a[-(int64_t)i] > end_b[-(int64_t)i];
+		}
+	}
+	return literal_a.size > literal_b.size;
+}
+
+// Constants with the biggest alignment first, to reduce the padding
+static bool is_constant_before(const ReadOnlyData& read_only_data, uint32_t a, uint32_t b)
+{
+	return get_alignment(read_only_data.literals[a]) > get_alignment(read_only_data.literals[b]);
+}
+
+// Stable merge sort of literal indices
+static void sort_literals(const ReadOnlyData& read_only_data, memory::Array<uint32_t>& indices, bool (*is_before)(const ReadOnlyData&, uint32_t, uint32_t))
+{
+	memory::Array<uint32_t>	buffer;
+	size_t					nb_indices = memory::get_array_size(indices);
+
+	defer {
+		memory::release(buffer);
+	};
+
+	memory::resize_array(buffer, nb_indices);
+
+	uint32_t* source = memory::get_array_data(indices);
+	uint32_t* destination = memory::get_array_data(buffer);
+
+	for (size_t width = 1; width < nb_indices; width *= 2) {
+		for (size_t first = 0; first < nb_indices; first += 2 * width) {
+			size_t middle = first + width < nb_indices ? first + width : nb_indices;
+			size_t last = first + 2 * width < nb_indices ? first + 2 * width : nb_indices;
+			size_t i = first;
+			size_t j = middle;
+
+			for (size_t k = first; k < last; k++) {
+				if (i < middle && (j >= last || is_before(read_only_data, source[j], source[i]) == false)) {
+					destination[k] = source[i++];
+				}
+				else {
+					destination[k] = source[j++];
+				}
+			}
+		}
+
+		uint32_t* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	if (source != memory::get_array_data(indices)) {
+		system::memory_copy(memory::get_array_data(indices), source, nb_indices * sizeof(uint32_t));
+	}
+}
+
+void f::initialize_read_only_data(ReadOnlyData& read_only_data)
+{
+	memory::init(read_only_data.pool);
+	memory::init(read_only_data.literals);
+	memory::hash_table_init(read_only_data.literal_indices, &are_equals);
+	memory::init(read_only_data.section);
+	read_only_data.current_RVA = 0;
+}
+
+uint32_t f::add_literal(ReadOnlyData& read_only_data, Literal::Kind kind, const uint8_t* data, uint32_t size)
+{
+	ZoneScopedN("f::add_literal");
+
+	uint32_t offset = (uint32_t)memory::get_array_size(read_only_data.pool);
+
+	const uint8_t* pool_data = memory::get_array_data(read_only_data.pool);
+
+	// The data may already be at the end of the pool
+	if (data + size == pool_data + offset && size <= offset) {
+		offset -= size;
+	}
+	else {
+		// The resize can reallocate the pool, data can point in it
+		bool		is_in_pool = pool_data && data >= pool_data && data < pool_data + offset;
+		uint32_t	data_offset = is_in_pool ? (uint32_t)(data - pool_data) : 0;
+
+		memory::resize_array(read_only_data.pool, offset + size);
+		if (is_in_pool) {
+			data = memory::get_array_data(read_only_data.pool) + data_offset;
+		}
+		system::memory_copy(memory::get_array_data(read_only_data.pool) + offset, data, size);
+	}
+
+	Literal_Key	key;
+	uint64_t	hash = SpookyHash::Hash64((const void*)(memory::get_array_data(read_only_data.pool) + offset), size, (uint64_t)kind);
+	uint16_t	short_hash = hash & 0xffff;
+
+	key.pool = &read_only_data.pool;
+	key.kind = kind;
+	key.offset = offset;
+	key.size = size;
+
+	uint32_t* found_index = memory::hash_table_get(read_only_data.literal_indices, short_hash, key);
+
+	if (found_index) {
+		memory::resize_array(read_only_data.pool, offset);
+		return *found_index;
+	}
+
+	Literal		literal;
+	uint32_t	index = (uint32_t)memory::get_array_size(read_only_data.literals);
+
+	literal.kind = kind;
+	literal.offset = offset;
+	literal.size = size;
+	literal.RVA = 0;
+	memory::array_push_back(read_only_data.literals, literal);
+	memory::hash_table_insert(read_only_data.literal_indices, short_hash, key, index);
+	return index;
+}
+
+uint32_t f::add_string_literal(ReadOnlyData& read_only_data, const uint8_t* string, uint32_t size)
+{
+	ZoneScopedN("f::add_string_literal");
+
+	uint32_t offset = (uint32_t)memory::get_array_size(read_only_data.pool);
+
+	// The string and its '\0' are put at the end of the pool, add_literal finds them there and doesn't copy them again
+	memory::resize_array(read_only_data.pool, offset + size + 1);
+	system::memory_copy(memory::get_array_data(read_only_data.pool) + offset, string, size);
+	read_only_data.pool[offset + size] = (uint8_t)'\0';
+
+	return add_literal(read_only_data, Literal::Kind::STRING, memory::get_array_data(read_only_data.pool) + offset, size + 1);
+}
+
+void f::layout_read_only_data(ReadOnlyData& read_only_data)
+{
+	ZoneScopedN("f::layout_read_only_data");
+
+	memory::Array<uint32_t>	constants;
+	memory::Array<uint32_t>	strings;
+	size_t					size = 0;
+
+	defer {
+		memory::release(constants);
+		memory::release(strings);
+	};
+
+	for (uint32_t i = 0; i < memory::get_array_size(read_only_data.literals); i++) {
+		memory::array_push_back(read_only_data.literals[i].kind == Literal::Kind::STRING ? strings : constants, i);
+	}
+
+	sort_literals(read_only_data, constants, &is_constant_before);
+	for (size_t i = 0; i < memory::get_array_size(constants); i++) {
+		Literal&	literal = read_only_data.literals[constants[i]];
+		uint32_t	alignment = get_alignment(literal);
+
+		size = (size + alignment - 1) & ~((size_t)alignment - 1);
+		literal.RVA = size;
+		size += literal.size;
+	}
+
+	sort_literals(read_only_data, strings, &is_string_before);
+	for (size_t i = 0; i < memory::get_array_size(strings); i++) {
+		Literal& literal = read_only_data.literals[strings[i]];
+
+		if (i > 0) {
+			const Literal& previous = read_only_data.literals[strings[i - 1]];
+
+			if (previous.size >= literal.size
+				&& system::memory_compare(memory::get_array_data(read_only_data.pool) + previous.offset + previous.size - literal.size,
+					memory::get_array_data(read_only_data.pool) + literal.offset, literal.size)) {
+				literal.RVA = previous.RVA + previous.size - literal.size;
+				continue;
+			}
+		}
+
+		literal.RVA = size;
+		size += literal.size;
+	}
+
+	memory::resize_array(read_only_data.section, size);
+	system::zero_memory(memory::get_array_data(read_only_data.section), size);
+	for (size_t i = 0; i < memory::get_array_size(read_only_data.literals); i++) {
+		const Literal& literal = read_only_data.literals[i];
+
+		system::memory_copy(memory::get_array_data(read_only_data.section) + literal.RVA, memory::get_array_data(read_only_data.pool) + literal.offset, literal.size);
+	}
+	read_only_data.current_RVA = size;
 }
@@ -17,17 +17,61 @@ namespace f
 			FLOAT		= 0x10,
 			DOUBLE		= 0x20,
 			UNSIGNED	= 0x40,
-			POINTER		= 0x80
+			POINTER		= 0x80,
+			VECTOR		= 0x100	// 16 bytes filled with lanes of the other flags (VECTOR | FLOAT is 4 floats)
 		};
 
 		Type		type;
 		uint32_t	id;
 	};
 
+	inline Register::Type operator|(Register::Type a, Register::Type b) {
+		return (Register::Type)((uint32_t)a | (uint32_t)b);
+	}
+
+	inline bool has_flag(Register::Type type, Register::Type flag) {
+		return ((uint32_t)type & (uint32_t)flag) != 0;
+	}
+
+	inline bool is_vector(Register::Type type) {
+		return has_flag(type, Register::Type::VECTOR);
+	}
+
+	// Scalars only, use is_floating_point(get_lane_type(type)) for lanes of vectors
+	inline bool is_floating_point(Register::Type type) {
+		return !is_vector(type) && (has_flag(type, Register::Type::FLOAT) || has_flag(type, Register::Type::DOUBLE));
+	}
+
+	// The type itself for scalars
+	inline Register::Type get_lane_type(Register::Type type) {
+		return (Register::Type)((uint32_t)type & ~(uint32_t)Register::Type::VECTOR);
+	}
+
+	inline uint32_t get_register_size(Register::Type type) { // In bytes
+		if (is_vector(type)) {
+			return 16;
+		}
+		else if (has_flag(type, Register::Type::FLOAT)) {
+			return 4;
+		}
+		else if (has_flag(type, Register::Type::DOUBLE)) {
+			return 8;
+		}
+		return (uint32_t)type & 0x0f; // BYTE, WORD, DWORD and QWORD values are their size
+	}
+
+	inline uint32_t get_nb_lanes(Register::Type type) {
+		return 16 / get_register_size(get_lane_type(type));
+	}
+
+	struct Imported_Library;
+
 	struct Imported_Function
 	{
 		AST_Statement_Function* function;
-		uint32_t				name_RVA;
+		Imported_Library*		library;
+		uint32_t				name_RVA;	// Of the hint/name entry
+		uint32_t				IAT_RVA;	// Of the entry that receives the address of the function
 	};
 
 	struct Imported_Library
@@ -41,14 +85,39 @@ namespace f
 
 	struct Literal // Things that go in rdata section like string literals
 	{
-		fstd::memory::Array<uint8_t>	data;
-		size_t							RVA;
+		enum class Kind : uint8_t
+		{
+			STRING,		// Null terminated, not aligned
+			CONSTANT,	// Numbers and masks read by instructions, aligned on their size (up to 32 bytes)
+		};
+
+		Kind		kind;
+		uint32_t	offset;	// In ReadOnlyData::pool
+		uint32_t	size;
+		size_t		RVA;	// Offset in the section, computed by layout_read_only_data
 	};
 
+	// Identical literals are stored once, the key is a range of the pool (it can grow)
+	struct Literal_Key
+	{
+		const fstd::memory::Array<uint8_t>*	pool;
+		Literal::Kind						kind;
+		uint32_t							offset;
+		uint32_t							size;
+	};
+
+	// Read only data are stored in a single pool while generating the IR. The layout puts constants first with
+	// their alignment, then strings; a string that is the end of another one ("world" and "hello world") is merged
+	// in it.
 	struct ReadOnlyData
 	{
+		typedef fstd::memory::Hash_Table<uint16_t, Literal_Key, uint32_t, 32> Literal_Hash_Table;
+
+		fstd::memory::Array<uint8_t>	pool;		// Unique literals in the order they are added
 		fstd::memory::Array<Literal>	literals;
-		size_t							current_RVA = 0;
+		Literal_Hash_Table				literal_indices;
+		fstd::memory::Array<uint8_t>	section;	// Content of the section, written as is by backends
+		size_t							current_RVA = 0; // Size of the section
 	};
 
 	struct CodeData
@@ -64,16 +133,235 @@ namespace f
 		uint32_t						entry_point_RVA = 0x00;
 	};
 
+	// Linear IR
+	//
+	// Functions are lowered to basic blocks of three-address instructions. All instructions of a function are
+	// stored contiguously in a single array (the arena), a basic block is a range of this array that ends with
+	// a terminator (JUMP, BRANCH, SWITCH or RETURN). Blocks and instructions reference each other by index, so
+	// passes can rebuild the arena without patching pointers.
+	//
+	// Operands are virtual registers typed with Register::Type, their number isn't limited. The backend is
+	// responsible to map them to physical registers or stack slots.
+	// Arguments of a function are its first virtual registers.
+	//
+	// The IR is target independent, the only assumption is that pointers are QWORD.
+
+	constexpr uint32_t	invalid_register = 0xffffffff;
+	constexpr uint32_t	invalid_function = 0xffffffff;
+	constexpr uint32_t	invalid_block = 0xffffffff;
+
+	enum class IR_Opcode : uint8_t
+	{
+		NOP,			//				Removed instruction, ignored by passes and backends
+		CONSTANT,		// D			D = immediate
+		ADDRESS,		// D			D = address of the read only literal immediate.index
+		COPY,			// D A			D = A
+		CONVERT,		// D A			D = (type)A, a scalar converted to a vector (of its type) is put in all lanes
+
+		ADD,			// D A B		D = A + B
+		SUB,
+		MUL,
+		DIV,
+		REM,
+		NEG,			// D A			D = -A
+
+		// Vectors, arithmetic operators work lane by lane on them and CONSTANT puts its value in all lanes
+		INSERT,			// D A B		D = A with the lane immediate.index replaced by the scalar B
+		EXTRACT,		// D A			D = lane immediate.index of A, type is the type of A
+		SHUFFLE,		// D A			lane i of D = lane (immediate.integer >> 4 * i) & 0xf of A
+
+		EQUAL,			// D A B		D = A == B, D is a BYTE and type is the type of operands
+		NOT_EQUAL,
+		LESS,
+		LESS_EQUAL,
+		GREATER,
+		GREATER_EQUAL,
+
+		CALL,			// D			D = call of the function immediate.index, arguments are in the operand list [A, A + B[
+						//				D is invalid_register if the function doesn't return a value
+		CALL_INDIRECT,	// D			Same as CALL, but the address of the function is the first value of the operand list
+						//				(from FUNCTION_ADDRESS), arguments are in [A + 1, A + B[
+		FUNCTION_ADDRESS,	// D		D = address of the function immediate.index (read from the IAT for imported functions)
+		COUNTER,		//				Increment the profile counter immediate.index (-profile-generate)
+		PHI,			// D			D = value coming from the executed predecessor, the operand list [A, A + 2 * B[ contains
+						//				B pairs (predecessor block, value), phis are always at the beginning of their block
+
+		// Terminators
+		JUMP,			//				goto block immediate.targets[0]
+		BRANCH,			// A			if A goto block immediate.targets[0] else goto block immediate.targets[1]
+		RETURN,			// A			return A, A is invalid_register if the function doesn't return a value
+		SWITCH,			// A			goto the successor table[A], the operand list at immediate.targets[0] contains the
+						//				immediate.targets[1] successors (distinct blocks), the number of entries of the table
+						//				then the table (indices of successors). A is a QWORD lower than the number of entries,
+						//				the bounds are checked before
+
+		COUNT
+	};
+
+	inline bool is_terminator(IR_Opcode opcode) {
+		return opcode == IR_Opcode::JUMP || opcode == IR_Opcode::BRANCH || opcode == IR_Opcode::RETURN || opcode == IR_Opcode::SWITCH;
+	}
+
+	inline bool is_call(IR_Opcode opcode) {
+		return opcode == IR_Opcode::CALL || opcode == IR_Opcode::CALL_INDIRECT;
+	}
+
+	union IR_Immediate
+	{
+		int64_t		integer;	// Also used for unsigned values
+		double		real;		// FLOAT constants are stored as double
+		uint32_t	index;		// Function index, literal index
+		uint32_t	targets[2];	// Basic block indices
+	};
+
+	// Every instruction has the same size, so the arena stays dense and is walked linearly by passes
+	struct IR_Instruction
+	{
+		IR_Opcode		opcode;
+		Register::Type	type;			// Type of the operation
+		uint32_t		destination;	// Virtual register or invalid_register
+		uint32_t		operands[2];	// Virtual registers (or a range of the operand list for CALL)
+		IR_Immediate	immediate;
+	};
+
+	static_assert(sizeof(IR_Instruction) == 32, "IR_Instruction should stay small to keep the arena cache friendly.");
+
+	struct IR_Basic_Block
+	{
+		uint32_t	first_instruction;
+		uint32_t	nb_instructions;	// The last one is the terminator
+
+		// Computed by compute_control_flow
+		uint32_t	first_predecessor;		// In IR_Function::predecessors
+		uint32_t	nb_predecessors;
+		uint32_t	immediate_dominator;	// invalid_block for the entry block
+		uint32_t	first_dominated;		// Children in the dominator tree, linked by next_dominated
+		uint32_t	next_dominated;
+
+		// Read from the profile (-profile-use), estimated for blocks created by passes
+		uint64_t	count;			// Number of executions
+		uint64_t	taken_count;	// Number of times the branch of the block went to immediate.targets[0]
+
+		bool		is_cold;		// Set by find_cold_blocks, the code of cold blocks is placed after the code of all functions
+	};
+
+	// Set by the function modifiers inline and no_inline
+	enum class Inlining : uint8_t
+	{
+		DEFAULT,	// Decided by the cost model of the inliner
+		ALWAYS,		// Inlined whatever its size, unless it is recursive
+		NEVER,
+	};
+
+	struct IR_Function
+	{
+		AST_Statement_Function*					declaration;
+		Imported_Function*						imported_function;	// Not null for functions implemented in a dll, they don't have blocks
+		fstd::memory::Array<IR_Instruction>		instructions;		// The arena
+		fstd::memory::Array<IR_Basic_Block>		blocks;				// The first block is the entry of the function
+		fstd::memory::Array<Register::Type>		registers;			// Type of virtual registers, indexed by their id
+		fstd::memory::Array<uint32_t>			operand_lists;		// Variable length operands (arguments of calls, incoming values of phis)
+		fstd::memory::Array<uint32_t>			predecessors;		// Computed by compute_control_flow
+		bool									is_ssa;
+		uint32_t								nb_arguments;
+		bool									has_return_value;
+		Register::Type							return_type;
+		Inlining								inlining;
+		bool									has_profile;		// Counts of blocks come from a profile
+		bool									is_no_return;		// no_return modifier, calls of the function never return (exit, abort)
+		bool									is_cold;			// cold modifier, calls of the function are unlikely (error handling)
+	};
+
+	// Return the number of successors of the terminator, they can be modified through targets. A BRANCH can have twice
+	// the same target, successors of a SWITCH are distinct.
+	inline uint32_t get_targets(IR_Function& function, IR_Instruction& terminator, uint32_t*& targets)
+	{
+		if (terminator.opcode == IR_Opcode::JUMP || terminator.opcode == IR_Opcode::BRANCH) {
+			targets = terminator.immediate.targets;
+			return terminator.opcode == IR_Opcode::JUMP ? 1 : 2;
+		}
+		else if (terminator.opcode == IR_Opcode::SWITCH) {
+			targets = &function.operand_lists[terminator.immediate.targets[0]];
+			return terminator.immediate.targets[1];
+		}
+		targets = nullptr;
+		return 0;
+	}
+
+	// Return the number of successors of the block, successors points in the instruction or in the operand lists of the
+	// function, so it is invalidated when they grow
+	inline uint32_t get_successors(const IR_Function& function, const IR_Basic_Block& block, const uint32_t*& successors)
+	{
+		const IR_Instruction& terminator = function.instructions[block.first_instruction + block.nb_instructions - 1];
+
+		if (terminator.opcode == IR_Opcode::JUMP || terminator.opcode == IR_Opcode::BRANCH) {
+			successors = terminator.immediate.targets;
+			return terminator.opcode == IR_Opcode::JUMP ? 1 : 2;
+		}
+		else if (terminator.opcode == IR_Opcode::SWITCH) {
+			successors = &function.operand_lists[terminator.immediate.targets[0]];
+			return terminator.immediate.targets[1];
+		}
+		successors = nullptr;
+		return 0;
+	}
+
+	// Number of values in the operand list of a SWITCH (successors, number of entries then the table)
+	inline uint32_t get_switch_operand_list_size(const IR_Function& function, const IR_Instruction& instruction)
+	{
+		uint32_t nb_successors = instruction.immediate.targets[1];
+
+		return nb_successors + 1 + function.operand_lists[instruction.immediate.targets[0] + nb_successors];
+	}
+
+	// Call callback(uint32_t& register_id) for each virtual register read by the instruction
+	template<typename Callback>
+	inline void for_each_use(IR_Function& function, IR_Instruction& instruction, Callback callback)
+	{
+		switch (instruction.opcode)
+		{
+		case IR_Opcode::NOP:
+		case IR_Opcode::CONSTANT:
+		case IR_Opcode::ADDRESS:
+		case IR_Opcode::FUNCTION_ADDRESS:
+		case IR_Opcode::COUNTER:
+		case IR_Opcode::JUMP:
+			break;
+		case IR_Opcode::CALL:
+		case IR_Opcode::CALL_INDIRECT:
+			for (uint32_t i = 0; i < instruction.operands[1]; i++) {
+				callback(function.operand_lists[instruction.operands[0] + i]);
+			}
+			break;
+		case IR_Opcode::PHI:
+			for (uint32_t i = 0; i < instruction.operands[1]; i++) {
+				callback(function.operand_lists[instruction.operands[0] + 2 * i + 1]);
+			}
+			break;
+		case IR_Opcode::SWITCH:
+			callback(instruction.operands[0]);
+			break;
+		default:
+			for (uint32_t i = 0; i < 2; i++) {
+				if (instruction.operands[i] != invalid_register) {
+					callback(instruction.operands[i]);
+				}
+			}
+		}
+	}
+
 	struct IR
 	{
 		typedef fstd::memory::Hash_Table<uint16_t, fstd::language::string_view, Imported_Library*, 32> Imported_Library_Hash_Table;
 
-		Parsing_Result*					parsing_result;
-		Imported_Library_Hash_Table		imported_libraries;
-		ReadOnlyData					read_only_data;
-		CodeData						code_data;
-
-//		fstd::memory::Stack<Register>	registers; // Need to have one stack per scope (global scope, function scope,...)?
+		Parsing_Result*						parsing_result;
+		Imported_Library_Hash_Table			imported_libraries;
+		ReadOnlyData						read_only_data;
+		CodeData							code_data;
+		fstd::memory::Array<IR_Function>	functions;
+		uint32_t							entry_point_function = invalid_function; // Index of main
+		fstd::memory::Array<uint32_t>		profile_counters;	// With -profile-generate, first counter of each function then the number of counters
+		fstd::memory::Array<uint32_t>		code_order;			// Order of the functions in the code, the order of functions if empty
 	};
 
 	struct IR_Data
@@ -83,4 +371,13 @@ namespace f
 	};
 
 	void generate_ir(Parsing_Result& parsing_result, IR& ir);
+
+	void		initialize_read_only_data(ReadOnlyData& read_only_data);
+	// Return the index of the literal, the index of the identical literal if there is one
+	uint32_t	add_literal(ReadOnlyData& read_only_data, Literal::Kind kind, const uint8_t* data, uint32_t size);
+	// Add a string and its terminal '\0', size doesn't count it
+	uint32_t	add_string_literal(ReadOnlyData& read_only_data, const uint8_t* string, uint32_t size);
+	// Compute the RVA of literals and the section, generate_ir does it, but it has to be done again if literals are
+	// added later
+	void		layout_read_only_data(ReadOnlyData& read_only_data);
 }
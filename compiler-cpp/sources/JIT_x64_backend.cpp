@@ -0,0 +1,401 @@
+#include "JIT_x64_backend.hpp"
+
+#include "globals.hpp" // report_error
+
+#include "x64/code_generator.hpp"
+
+#include "optimizer/optimizer.hpp"
+
+#include <fstd/platform.hpp>
+
+#include <fstd/core/assert.hpp>
+#include <fstd/core/string_builder.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <fstd/system/allocator.hpp>
+#include <fstd/system/file.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#if defined(FSTD_OS_WINDOWS)
+#   include <Windows.h>
+#else
+#   include <sys/mman.h>
+#   include <dlfcn.h>
+#   include <unistd.h>
+#endif
+
+using namespace fstd;
+using namespace fstd::core;
+using namespace fstd::system;
+
+using namespace f;
+
+// On other systems than Windows the call has to follow the calling convention of the generated code
+#if defined(FSTD_OS_WINDOWS)
+typedef int32_t (*Entry_Point)();
+#else
+typedef int32_t (__attribute__((ms_abi)) *Entry_Point)();
+#endif
+
+// The red zone of the System V ABI is kept by the system for any code, even if the generated code uses the Windows
+// calling convention
+#if defined(FSTD_OS_WINDOWS)
+constexpr bool  use_red_zone = false;
+#else
+constexpr bool  use_red_zone = true;
+#endif
+
+static size_t get_page_size()
+{
+#if defined(FSTD_OS_WINDOWS)
+    SYSTEM_INFO system_info;
+
+    GetSystemInfo(&system_info);
+    return (size_t)system_info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static size_t align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Pages are readable and writable
+static uint8_t* allocate_pages(size_t size)
+{
+#if defined(FSTD_OS_WINDOWS)
+    void* address = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+    }
+#endif
+
+    if (address == nullptr) {
+        report_error(Compiler_Error::error, "JIT: Failed to allocate the memory of the program.");
+    }
+    return (uint8_t*)address;
+}
+
+// Pages become read only, and executable if executable is true
+static void protect_pages(uint8_t* address, size_t size, bool executable)
+{
+    bool succeeded;
+
+#if defined(FSTD_OS_WINDOWS)
+    DWORD previous_protection;
+
+    succeeded = VirtualProtect(address, size, executable ? PAGE_EXECUTE_READ : PAGE_READONLY, &previous_protection) != FALSE;
+    if (succeeded && executable) {
+        FlushInstructionCache(GetCurrentProcess(), address, size);
+    }
+#else
+    succeeded = mprotect(address, size, executable ? PROT_READ | PROT_EXEC : PROT_READ) == 0;
+#endif
+
+    if (succeeded == false) {
+        report_error(Compiler_Error::error, "JIT: Failed to change the protection of the memory of the program.");
+    }
+}
+
+static void free_pages(uint8_t* address, size_t size)
+{
+#if defined(FSTD_OS_WINDOWS)
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+
+// Names of the IR are string_view on the source, they aren't null terminated
+static void to_c_string(const language::string_view& text, char* buffer, size_t buffer_size)
+{
+    size_t size = language::get_string_size(text);
+
+    if (size >= buffer_size) {
+        report_error(Compiler_Error::error, "JIT: The name of an imported symbol is too long.");
+    }
+    memory_copy(buffer, language::to_utf8(text), size);
+    buffer[size] = '\0';
+}
+
+static void* resolve_imported_function(const Imported_Function& imported_function, memory::Array<void*>& loaded_libraries)
+{
+    char    library_name[256];
+    char    function_name[256];
+    void*   address;
+
+    to_c_string(imported_function.library->name, library_name, sizeof(library_name));
+    to_c_string(imported_function.function->name.text, function_name, sizeof(function_name));
+
+#if defined(FSTD_OS_WINDOWS)
+    HMODULE library = LoadLibraryA(library_name);
+
+    address = nullptr;
+    if (library) {
+        memory::array_push_back(loaded_libraries, (void*)library);
+        address = (void*)GetProcAddress(library, function_name);
+    }
+#else
+    // @Warning functions declared with dll_import target Windows, symbols are searched in the process (the compiler
+    // and its libraries) and they have to follow the Windows x64 calling convention.
+    (void)loaded_libraries;
+    address = dlsym(RTLD_DEFAULT, function_name);
+#endif
+
+    if (address == nullptr) {
+        String_Builder		string_builder;
+        language::string	message;
+
+        defer {
+            free_buffers(string_builder);
+            release(message);
+        };
+
+        print_to_builder(string_builder, "JIT: Failed to resolve the imported function \"%v\" of \"%v\".\n",
+            imported_function.function->name.text, imported_function.library->name);
+
+        message = to_string(string_builder);
+        report_error(Compiler_Error::error, (char*)to_utf8(message));
+    }
+    return address;
+}
+
+// Counters of the instrumented program are written in the profile file (-profile-generate)
+static void write_profile_file(const IR& ir, const uint64_t* counters)
+{
+    system::Path            path;
+    File                    file;
+    memory::Array<uint8_t>  data;
+    bool                    open;
+
+    defer {
+        system::reset_path(path);
+        memory::release(data);
+    };
+
+    system::from_native(path, (const uint8_t*)globals.configuration.profile_generate);
+    write_profile(ir, counters, data);
+
+    open = open_file(file, path, (File::Opening_Flag)(
+        (uint32_t)File::Opening_Flag::WRITE |
+        (uint32_t)File::Opening_Flag::CREATE));
+
+    if (open == false) {
+        String_Builder		string_builder;
+        language::string	message;
+
+        defer {
+            free_buffers(string_builder);
+            release(message);
+        };
+
+        print_to_builder(string_builder, "JIT: Failed to open the profile file: \"%v\"\n", to_string(path));
+
+        message = to_string(string_builder);
+        report_error(Compiler_Error::error, (char*)to_utf8(message));
+    }
+
+    defer {
+        close_file(file);
+    };
+
+    write_file(file, memory::get_array_data(data), (uint32_t)memory::get_array_size(data));
+}
+
+#if defined(FSTD_OS_WINDOWS)
+// The program can exit with ExitProcess instead of returning from main, it also ends the compiler. The instrumented
+// program calls this function instead, so the profile is written before.
+struct Running_Profile
+{
+    const IR*       ir;
+    const uint64_t* counters;
+};
+
+static Running_Profile running_profile;
+
+static void WINAPI exit_process_with_profile(UINT exit_code)
+{
+    write_profile_file(*running_profile.ir, running_profile.counters);
+    ExitProcess(exit_code);
+}
+#endif
+
+void f::JIT_x64_backend::initialize_backend()
+{
+    x64::initialize_encoder();
+}
+
+int32_t f::JIT_x64_backend::run(IR& ir)
+{
+    ZoneScopedN("f::JIT_x64_backend::run");
+
+    if (ir.entry_point_function == invalid_function) {
+        report_error(Compiler_Error::error, "JIT: The program doesn't have a main function.");
+    }
+
+    x64::Function_Code		program_code;
+    memory::Array<uint32_t>	function_offsets;
+    memory::Array<uint32_t>	import_slots;		// Per function, index of the slot of its address for imported functions
+    memory::Array<void*>	loaded_libraries;
+
+    defer {
+        x64::release(program_code);
+        memory::release(function_offsets);
+        memory::release(import_slots);
+#if defined(FSTD_OS_WINDOWS)
+        for (size_t i = 0; i < memory::get_array_size(loaded_libraries); i++) {
+            FreeLibrary((HMODULE)loaded_libraries[i]);
+        }
+#endif
+        memory::release(loaded_libraries);
+    };
+
+    {
+        ZoneScopedN("Code generation");
+
+        x64::generate_program_code(ir, program_code, function_offsets, 0, use_red_zone);
+    }
+
+    uint32_t nb_imports = 0;
+
+    memory::resize_array(import_slots, memory::get_array_size(ir.functions));
+    for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+        import_slots[i] = ir.functions[i].imported_function ? nb_imports++ : 0;
+    }
+
+    // Layout
+    //   - code, read and execute
+    //   - addresses of imported functions, literals, jump tables then unwind information, read only (on the next page)
+    //   - profile counters, read and write (on the next page, only with -profile-generate)
+    size_t  nb_counters = memory::is_array_empty(ir.profile_counters) ? 0 : *memory::get_array_last_element(ir.profile_counters);
+    size_t  page_size = get_page_size();
+    size_t  code_size = memory::get_array_size(program_code.code);
+    size_t  nb_unwind_entries = memory::get_array_size(program_code.unwind_entries);
+    size_t  nb_jump_table_entries = memory::get_array_size(program_code.jump_table_entries);
+    size_t  imports_offset = align(code_size, page_size);
+    size_t  read_only_data_offset = align(imports_offset + nb_imports * sizeof(void*), 16);
+    size_t  jump_tables_offset = align(read_only_data_offset + ir.read_only_data.current_RVA, sizeof(int64_t));
+    size_t  unwind_entries_offset = align(jump_tables_offset + nb_jump_table_entries * sizeof(int64_t), 4);
+    size_t  unwind_info_offset = unwind_entries_offset + nb_unwind_entries * 3 * sizeof(uint32_t);
+    size_t  data_size = unwind_info_offset + memory::get_array_size(program_code.unwind_info) - imports_offset;
+    size_t  counters_offset = imports_offset + align(data_size, page_size);
+    size_t  size = counters_offset + align(nb_counters * sizeof(uint64_t), page_size);
+
+    uint8_t* program = allocate_pages(size);
+
+    defer {
+        free_pages(program, size);
+    };
+
+    {
+        ZoneScopedN("Write program");
+
+        memory_copy(program, memory::get_array_data(program_code.code), code_size);
+
+        for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+            if (ir.functions[i].imported_function) {
+                void* address = resolve_imported_function(*ir.functions[i].imported_function, loaded_libraries);
+
+#if defined(FSTD_OS_WINDOWS)
+                language::string_view   exit_process_name;
+
+                language::assign(exit_process_name, (uint8_t*)"ExitProcess");
+                if (nb_counters && language::are_equals(ir.functions[i].imported_function->function->name.text, exit_process_name)) {
+                    address = (void*)&exit_process_with_profile;
+                }
+#endif
+
+                memory_copy(program + imports_offset + import_slots[i] * sizeof(void*), &address, sizeof(address));
+            }
+        }
+
+        memory_copy(program + read_only_data_offset, memory::get_array_data(ir.read_only_data.section), memory::get_array_size(ir.read_only_data.section));
+
+        // Entries are offsets of their target from the beginning of their table
+        for (size_t i = 0; i < nb_jump_table_entries; i++) {
+            const x64::Jump_Table_Entry&    entry = program_code.jump_table_entries[i];
+            int64_t                         offset = (int64_t)entry.target - (int64_t)(jump_tables_offset + entry.first_entry * sizeof(int64_t));
+
+            memory_copy(program + jump_tables_offset + i * sizeof(int64_t), &offset, sizeof(offset));
+        }
+
+        // RUNTIME_FUNCTION entries, offsets are relative to the start of the program
+        for (size_t i = 0; i < nb_unwind_entries; i++) {
+            const x64::Unwind_Entry&    unwind_entry = program_code.unwind_entries[i];
+            uint32_t                    runtime_function[3];
+
+            runtime_function[0] = unwind_entry.function_start;
+            runtime_function[1] = unwind_entry.function_end;
+            runtime_function[2] = (uint32_t)unwind_info_offset + unwind_entry.unwind_info_offset;
+            memory_copy(program + unwind_entries_offset + i * sizeof(runtime_function), runtime_function, sizeof(runtime_function));
+        }
+        memory_copy(program + unwind_info_offset, memory::get_array_data(program_code.unwind_info), memory::get_array_size(program_code.unwind_info));
+
+        for (size_t i = 0; i < memory::get_array_size(program_code.fixups); i++) {
+            const x64::Code_Fixup&	fixup = program_code.fixups[i];
+            size_t					target;
+            int32_t					displacement;
+
+            if (fixup.kind == x64::Code_Fixup::Kind::IMPORTED_FUNCTION) {
+                target = imports_offset + import_slots[fixup.index] * sizeof(void*);
+            }
+            else if (fixup.kind == x64::Code_Fixup::Kind::PROFILE_COUNTER) {
+                target = counters_offset + fixup.index * sizeof(uint64_t);
+            }
+            else if (fixup.kind == x64::Code_Fixup::Kind::JUMP_TABLE) {
+                target = jump_tables_offset + fixup.index * sizeof(int64_t);
+            }
+            else {
+                target = read_only_data_offset + ir.read_only_data.literals[fixup.index].RVA;
+            }
+
+            displacement = (int32_t)((int64_t)target - (int64_t)fixup.instruction_end);
+            memory_copy(program + fixup.displacement_offset, &displacement, sizeof(displacement));
+        }
+    }
+
+    // Counters stay writable, pages are allocated filled by zeros
+    protect_pages(program, imports_offset, true);
+    if (counters_offset > imports_offset) {
+        protect_pages(program + imports_offset, counters_offset - imports_offset, false);
+    }
+
+#if defined(FSTD_OS_WINDOWS)
+    // Functions don't have a frame pointer, exceptions and debuggers walk the stack with the unwind information
+    RUNTIME_FUNCTION* function_table = (RUNTIME_FUNCTION*)(program + unwind_entries_offset);
+    bool function_table_added = nb_unwind_entries && RtlAddFunctionTable(function_table, (DWORD)nb_unwind_entries, (DWORD64)program);
+
+    defer {
+        if (function_table_added) {
+            RtlDeleteFunctionTable(function_table);
+        }
+    };
+#endif
+
+    Entry_Point	entry_point = (Entry_Point)(program + function_offsets[ir.entry_point_function]);
+    int32_t		result;
+    uint64_t*   counters = (uint64_t*)(program + counters_offset);
+
+#if defined(FSTD_OS_WINDOWS)
+    running_profile.ir = &ir;
+    running_profile.counters = counters;
+#endif
+
+    {
+        ZoneScopedN("Execution");
+
+        result = entry_point();
+    }
+
+    if (nb_counters) {
+        write_profile_file(ir, counters);
+    }
+
+    return ir.functions[ir.entry_point_function].has_return_value ? result : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "IR_generator.hpp"
+
+// In-process execution of the program
+//
+// The code is generated directly in executable memory of the compiler and main is called like a function of the
+// compiler, so there is no file to write, no loader and no process creation. It makes the edit-run loop and tests
+// faster.
+//
+// Memory pages are never writable and executable at the same time: the program is written in read-write pages,
+// then the code pages become read-execute and the data pages (addresses of imported functions and literals)
+// become read only before the call. Only the counters of an instrumented program (-profile-generate) stay writable,
+// they are written in the profile file when main returns or when the program calls ExitProcess.
+//
+// Imported functions are resolved in the compiler process (LoadLibrary/GetProcAddress on Windows, dlsym on other
+// systems). The generated code follows the Windows x64 calling convention.
+
+namespace f
+{
+	namespace JIT_x64_backend
+	{
+		void initialize_backend();
+
+		// Return the value returned by main, 0 if main doesn't return a value
+		int32_t run(IR& ir);
+	}
+}
@@ -2,6 +2,8 @@
 
 #include "globals.hpp" // report_error
 
+#include "x64/code_generator.hpp"
+
 #include <fstd/system/file.hpp>
 
 #include <fstd/core/assert.hpp>
@@ -55,43 +57,25 @@ DWORD	size_of_image = 0;			// @Warning must be a multiple of section_alignment,
 DWORD	size_of_headers = 0;		// IMAGE_DOS_HEADER.e_lfanew + 4 byte signature + size of IMAGE_FILE_HEADER + size of optional header + size of all section headers : and rounded at a multiple of file_alignment
 DWORD	image_check_sum = 0;		// Only for drivers, DLL loaded at boot time, DLL loaded in critical system process
 WORD	subsystem = IMAGE_SUBSYSTEM_WINDOWS_CUI;	// @Warning IMAGE_SUBSYSTEM_WINDOWS_CUI == console application (with a main) - IMAGE_SUBSYSTEM_WINDOWS_GUI == GUI application (with a WinMain)
-DWORD	text_image_section_virtual_address = 0;
 DWORD	text_image_section_pointer_to_raw_data = 0;
-DWORD	rdata_image_section_virtual_address = 0;
 DWORD	rdata_image_section_pointer_to_raw_data = 0;
-DWORD	reloc_image_section_virtual_address = 0;
 DWORD	reloc_image_section_pointer_to_raw_data = 0;
-DWORD	idata_image_section_virtual_address = 0;
 DWORD	idata_image_section_pointer_to_raw_data = 0;
+DWORD	pdata_image_section_pointer_to_raw_data = 0;
 
-// Addresses where there is a value to patch, or necessary to compute other ones
+// Addresses necessary to compute other ones
 DWORD	image_base_address = 0;
-DWORD	image_dos_header_address;
-DWORD	image_nt_header_address;
-DWORD	text_image_section_header_address;
 DWORD	text_section_address;
-DWORD	rdata_image_section_header_address;
 DWORD	rdata_section_address;
+DWORD	jump_tables_address;		// In the .rdata section, after the literals
 #if DLL_MODE == 1
-DWORD	reloc_image_section_header_address;
 DWORD	reloc_section_address;
 #endif
-DWORD	idata_image_section_header_address;
 DWORD	idata_section_address;
+DWORD	pdata_section_address;
 
 
 
-struct Encoded_Instruction
-{
-    // Maximum instruction size:
-    // https://stackoverflow.com/questions/14698350/x86-64-asm-maximum-bytes-for-an-instruction#:~:text=The%20x86%20instruction%20set%20(16,0x67%20prefixes%2C%20for%20example).
-    // Intel say 15, but Quantitative Approach has said 17 and now in the 6th edition says 18 bytes
-    uint8_t data[18];
-    uint8_t size;
-
-    // @TODO I should certainly have an enum to tell if I have relocation to do
-};
-
 // Struct for input ASM (used to convert IR to ASM)
 struct ASM
 {
@@ -123,72 +107,12 @@ struct ASM
     Operand             operands[3];
 };
 
-// For explanation of "mov ebp, esp"
-// https://stackoverflow.com/questions/21718397/what-are-the-esp-and-the-ebp-registers
-// Ease the compiler debugging
-// @TODO I may want implement option "omit frame pointers" to increase performances by using ebp as general purpose register
-
-
-// @TODO should be generated not hard-coded
-uint8_t	hello_world_instructions[] = {
-    0x89, 0xE5,										   // mov    ebp, esp           // initialize new call frame (put current stack pointer into base point of current stack)
-    0x83, 0xEC, 0x04,								   // sub    esp, 0x4
-    0x6A, 0xF5,										   // push   0xfffffff5         // STD_OUTPUT_HANDLE == (DWORD)-11 => 0xfffffff5 en hexa
-#if DLL_MODE == 1
-    0xFF, 0x15, 0x38, 0x40, 0x00, 0x10,				   // call   GetStdHandle       // ImageBase 0x10000000 + .idata virtual addr 0x4000 + 0x38 (offset in IAT)
-#else
-    0xFF, 0x15, 0x3B, 0x20, 0x00, 0x00,				   // call   GetStdHandle       // ImageBase 0x400000 + .idata virtual addr 0x3000 + 0x48 (offset in IAT) - ((RIP) 0x400000 + 0x1000 + 0x08) 
-#endif
-    0x89, 0xC3,										   // mov    ebx, eax
-    0x6A, 0x00,										   // push   0x0
-    0x8D, 0x45, 0xFC,								   // lea    eax, [ebp-0x4]
-    0x50,											   // push   eax
-    0x6A, 0x0B,										   // push   0xb				@Warning nNumberOfBytesToWrite
-#if DLL_MODE == 1
-    0x68, 0x00, 0x20, 0x00, 0x10,				       // push   DWORD PTR ds:0x0	@Warning address of message string (first value in .rdata section)
-#else
-    0x68, 0x00, 0x20, 0x40, 0x00,				       // push   DWORD PTR ds:0x0	@Warning address of message string (first value in .rdata section)
-#endif
-    0x53,											   // push   ebx
-#if DLL_MODE == 1
-    0xFF, 0x15, 0x3C, 0x40, 0x00, 0x10,				   // call   WriteFile          // ImageBase 0x10000000 + .idata virtual addr 0x4000 + 0x3C (offset in IAT)
-#else
-    0xFF, 0x15, 0x2D, 0x20, 0x00, 0x00,				   // call   WriteFile          // ImageBase 0x400000 + .idata virtual addr 0x3000 + 0x3C (offset in IAT) - ((RIP) 0x400000 + 0x1000 + 0x1D) 
-#endif
-    0x6A, 0x00,										   // push   0x0
-#if DLL_MODE == 1
-    0xFF, 0x15, 0x40, 0x40, 0x00, 0x10,				   // call   ExitProcess        // ImageBase 0x10000000 + .idata virtual addr 0x4000 + 0x40 (offset in IAT)
-#else
-    0xFF, 0x15, 0x2D, 0x20, 0x00, 0x00,				   // call   ExitProcess        // ImageBase 0x400000 + .idata virtual addr 0x3000 + 0x40 (offset in IAT) - ((RIP) 0x400000 + 0x1000 + 0x25) 
-#endif
-    0xF4											   // hlt
-};
-
-// @TODO les call prennent un offset par rapport  la position de l'instruction courante (RIP - Register instruction pointer)
-
-
-
 // @TODO get memory page size dynamically:
 // https://stackoverflow.com/questions/3351940/detecting-the-memory-page-size
 // Page size under Windows (depending on CPU arch)
 // https://devblogs.microsoft.com/oldnewthing/20210510-00/?p=105200
 
 
-// @TODO should be generated not hard-coded
-uint8_t* dll_names[] = {
-    (uint8_t*)"kernel32.dll",
-};
-
-uint8_t* message[] = {
-    (uint8_t*)"Hello World",
-};
-
-uint8_t* kernel32_function_names[] = {
-    (uint8_t*)"GetStdHandle",
-    (uint8_t*)"WriteFile",
-    (uint8_t*)"ExitProcess",
-};
-
 // @Warning 4 first bits are a flag (https://docs.microsoft.com/fr-fr/windows/win32/debug/pe-format#base-relocation-types):
 // IMAGE_REL_BASED_DIR64 for x64 code?
 WORD text_relocation_offsets[] = {
@@ -212,78 +136,337 @@ static DWORD	align_address(DWORD address, DWORD alignement)
     return address + (address % alignement);
 }
 
-static void	write_zeros(HANDLE file, uint32_t count) // @TODO remove it
+// Image being built in memory
+static void write_to_image(memory::Array<uint8_t>& image, DWORD& position, const void* data, size_t size)
+{
+    core::Assert(position + size <= memory::get_array_size(image));
+
+    system::memory_copy(memory::get_array_data(image) + position, data, size);
+    position += (DWORD)size;
+}
+
+// Import directory
+//
+// The .idata section is generated from IR::imported_libraries:
+//   - import descriptors, one per library then a null one,
+//   - ILT (Import Lookup Table), for each library the RVA of the hint/name entry of its functions then a null entry,
+//   - IAT (Import Address Table), same content than the ILT in the file, the loader replaces entries by addresses,
+//   - hint/name table, the hint followed by the null terminated name, entries are 2 bytes aligned,
+//   - names of libraries.
+//
+// Libraries and functions are sorted by name, so the image doesn't depend on the order of hash tables.
+// The hint is the index of the name in the export name table of the library, when it is right the loader finds the
+// function without searching its name. Hints are read from the libraries of the system that runs the compiler, the
+// loader falls back on a binary search of the name when a library changed.
+
+struct Import_Library
+{
+    Imported_Library*                   library;
+    memory::Array<Imported_Function*>   functions;      // Sorted by name
+    memory::Array<WORD>                 hints;          // Per function
+    DWORD                               first_thunk;    // Index of the entry of the first function in the ILT and the IAT
+};
+
+struct Import_Directory
+{
+    memory::Array<Import_Library>   libraries;          // Sorted by name
+    DWORD                           nb_thunks;          // Entries of the ILT (and of the IAT), null ones included
+    DWORD                           ILT_offset;         // Offsets in the section
+    DWORD                           IAT_offset;
+    DWORD                           hint_name_table_offset;
+    DWORD                           library_names_offset;
+    DWORD                           size;
+};
+
+// Same order than strcmp, names of export tables are sorted in this order
+static int compare_names(const language::string_view& a, const uint8_t* b, size_t b_size)
+{
+    size_t          a_size = language::get_string_size(a);
+    const uint8_t*  a_data = language::to_utf8(a);
+
+    for (size_t i = 0; i < a_size && i < b_size; i++) {
+        if (a_data[i] != b[i]) {
+            return a_data[i] < b[i] ? -1 : 1;
+        }
+    }
+    if (a_size == b_size) {
+        return 0;
+    }
+    return a_size < b_size ? -1 : 1;
+}
+
+static int compare_names(const language::string_view& a, const language::string_view& b)
+{
+    return compare_names(a, language::to_utf8(b), language::get_string_size(b));
+}
+
+static DWORD get_hint_name_entry_size(const Imported_Function* imported_function)
+{
+    DWORD size = sizeof(WORD) + (DWORD)language::get_string_size(imported_function->function->name.text) + 1; // +1 for the ending '\0'
+
+    return size + (size & 1);
+}
+
+static void compute_hints(Import_Library& import_library)
 {
-    constexpr uint32_t	buffer_size = 512;
-    static bool			initialized = false;
-    static char			zeros_buffer[buffer_size];
-    uint32_t			nb_iterations = count / buffer_size;
-    uint32_t			modulo = count % buffer_size;
-    DWORD				bytes_written;
-
-    if (initialized == false) {
-        ZeroMemory(zeros_buffer, buffer_size);
-        initialized = true;
+    ZoneScopedN("compute_hints");
+
+    size_t  nb_functions = memory::get_array_size(import_library.functions);
+    char    library_name[MAX_PATH];
+    size_t  library_name_size = language::get_string_size(import_library.library->name);
+
+    memory::resize_array(import_library.hints, nb_functions);
+    system::zero_memory(memory::get_array_data(import_library.hints), nb_functions * sizeof(WORD));
+
+    if (library_name_size >= sizeof(library_name)) {
+        return;
     }
+    system::memory_copy(library_name, language::to_utf8(import_library.library->name), library_name_size);
+    library_name[library_name_size] = '\0';
 
-    for (uint32_t i = 0; i < nb_iterations; i++) {
-        WriteFile(file, (const void*)zeros_buffer, buffer_size, &bytes_written, NULL);
+    // The library is mapped as an image without being initialized, so RVAs of its headers can be followed
+    HMODULE module = LoadLibraryExA(library_name, nullptr, LOAD_LIBRARY_AS_DATAFILE | LOAD_LIBRARY_AS_IMAGE_RESOURCE);
+
+    if (module == nullptr) {
+        return; // Hints stay to 0
+    }
+
+    defer {
+        FreeLibrary(module);
+    };
+
+    // Handles of modules loaded as data files have flags in their low bits
+    const uint8_t*              base = (const uint8_t*)((ULONG_PTR)module & ~(ULONG_PTR)3);
+    const IMAGE_DOS_HEADER*     dos_header = (const IMAGE_DOS_HEADER*)base;
+    const IMAGE_NT_HEADERS64*   nt_header = (const IMAGE_NT_HEADERS64*)(base + dos_header->e_lfanew);
+
+    if (nt_header->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR64_MAGIC
+        || nt_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size == 0) {
+        return;
+    }
+
+    const IMAGE_EXPORT_DIRECTORY*   export_directory = (const IMAGE_EXPORT_DIRECTORY*)(base + nt_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
+    const DWORD*                    names = (const DWORD*)(base + export_directory->AddressOfNames);
+
+    for (size_t i = 0; i < nb_functions; i++) {
+        const language::string_view&    name = import_library.functions[i]->function->name.text;
+        DWORD                           first = 0;
+        DWORD                           last = export_directory->NumberOfNames;
+
+        while (first < last) {
+            DWORD           middle = first + (last - first) / 2;
+            const uint8_t*  export_name = base + names[middle];
+            int             comparison = compare_names(name, export_name, strlen((const char*)export_name));
+
+            if (comparison == 0) {
+                import_library.hints[i] = middle <= 0xffff ? (WORD)middle : 0;
+                break;
+            }
+            else if (comparison < 0) {
+                last = middle;
+            }
+            else {
+                first = middle + 1;
+            }
+        }
     }
-    WriteFile(file, (const void*)zeros_buffer, modulo, &bytes_written, NULL);
 }
 
-static void	write_zeros(File file, uint32_t count)
+static void build_import_directory(IR& ir, Import_Directory& import_directory)
 {
-    constexpr uint32_t	buffer_size = 512;
-    static bool			initialized = false;
-    static char			zeros_buffer[buffer_size];
-    uint32_t			nb_iterations = count / buffer_size;
-    uint32_t			modulo = count % buffer_size;
-    uint32_t			bytes_written;
-
-    if (initialized == false) {
-        ZeroMemory(zeros_buffer, buffer_size);
-        initialized = true;
+    ZoneScopedN("build_import_directory");
+
+    typedef IR::Imported_Library_Hash_Table             Library_Hash_Table;
+    typedef Imported_Library::Function_Hash_Table       Function_Hash_Table;
+
+    memory::init(import_directory.libraries);
+
+    // @SpeedUp insertion sorts, programs import few functions
+    auto library_it = memory::hash_table_begin(ir.imported_libraries);
+    auto library_it_end = memory::hash_table_end(ir.imported_libraries);
+    for (; !memory::equals<uint16_t, language::string_view, Imported_Library*, 32>(library_it, library_it_end); memory::hash_table_next<uint16_t, language::string_view, Imported_Library*, 32>(library_it))
+    {
+        Import_Library import_library;
+
+        import_library.library = *memory::hash_table_get<uint16_t, language::string_view, Imported_Library*, 32>(library_it);
+        memory::init(import_library.functions);
+        memory::init(import_library.hints);
+
+        auto function_it = memory::hash_table_begin(import_library.library->functions);
+        auto function_it_end = memory::hash_table_end(import_library.library->functions);
+        for (; !memory::equals<uint16_t, language::string_view, Imported_Function*, 32>(function_it, function_it_end); memory::hash_table_next<uint16_t, language::string_view, Imported_Function*, 32>(function_it))
+        {
+            Imported_Function*  imported_function = *memory::hash_table_get<uint16_t, language::string_view, Imported_Function*, 32>(function_it);
+            size_t              position = memory::get_array_size(import_library.functions);
+
+            memory::array_push_back(import_library.functions, imported_function);
+            for (; position > 0 && compare_names(imported_function->function->name.text, import_library.functions[position - 1]->function->name.text) < 0; position--) {
+                import_library.functions[position] = import_library.functions[position - 1];
+            }
+            import_library.functions[position] = imported_function;
+        }
+
+        compute_hints(import_library);
+
+        size_t position = memory::get_array_size(import_directory.libraries);
+
+        memory::array_push_back(import_directory.libraries, import_library);
+        for (; position > 0 && compare_names(import_library.library->name, import_directory.libraries[position - 1].library->name) < 0; position--) {
+            import_directory.libraries[position] = import_directory.libraries[position - 1];
+        }
+        import_directory.libraries[position] = import_library;
     }
 
-    for (uint32_t i = 0; i < nb_iterations; i++) {
-        write_file(file, (uint8_t*)zeros_buffer, buffer_size, &bytes_written);
+    // Layout
+    DWORD nb_libraries = (DWORD)memory::get_array_size(import_directory.libraries);
+    DWORD hint_name_table_size = 0;
+    DWORD library_names_size = 0;
+
+    import_directory.nb_thunks = 0;
+    for (DWORD i = 0; i < nb_libraries; i++) {
+        Import_Library& import_library = import_directory.libraries[i];
+
+        import_library.first_thunk = import_directory.nb_thunks;
+        import_directory.nb_thunks += (DWORD)memory::get_array_size(import_library.functions) + 1; // +1 for the null entry
+
+        for (size_t j = 0; j < memory::get_array_size(import_library.functions); j++) {
+            hint_name_table_size += get_hint_name_entry_size(import_library.functions[j]);
+        }
+        library_names_size += (DWORD)language::get_string_size(import_library.library->name) + 1; // +1 for the ending '\0'
+    }
+
+    import_directory.ILT_offset = ((nb_libraries + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR) + 7) & ~7; // Thunks are 8 bytes aligned
+    import_directory.IAT_offset = import_directory.ILT_offset + import_directory.nb_thunks * sizeof(ULONGLONG);
+    import_directory.hint_name_table_offset = import_directory.IAT_offset + import_directory.nb_thunks * sizeof(ULONGLONG);
+    import_directory.library_names_offset = import_directory.hint_name_table_offset + hint_name_table_size;
+    import_directory.size = import_directory.library_names_offset + library_names_size;
+}
+
+// RVAs of functions are known once the address of the section is
+static void set_imported_functions_RVA(Import_Directory& import_directory, DWORD section_address)
+{
+    DWORD hint_name_RVA = section_address + import_directory.hint_name_table_offset;
+    DWORD library_name_RVA = section_address + import_directory.library_names_offset;
+
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        Import_Library& import_library = import_directory.libraries[i];
+
+        import_library.library->name_RVA = library_name_RVA;
+        library_name_RVA += (DWORD)language::get_string_size(import_library.library->name) + 1;
+
+        for (size_t j = 0; j < memory::get_array_size(import_library.functions); j++) {
+            Imported_Function* imported_function = import_library.functions[j];
+
+            imported_function->name_RVA = hint_name_RVA;
+            imported_function->IAT_RVA = section_address + import_directory.IAT_offset + (import_library.first_thunk + (DWORD)j) * sizeof(ULONGLONG);
+            hint_name_RVA += get_hint_name_entry_size(imported_function);
+        }
     }
-    write_file(file, (uint8_t*)zeros_buffer, modulo, &bytes_written);
+}
+
+static void write_import_directory(memory::Array<uint8_t>& image, DWORD section_position, const Import_Directory& import_directory, DWORD section_address)
+{
+    ZoneScopedN("write_import_directory");
+
+    DWORD position = section_position;
+
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        const Import_Library&   import_library = import_directory.libraries[i];
+        IMAGE_IMPORT_DESCRIPTOR import_descriptor;
+
+        import_descriptor.OriginalFirstThunk = section_address + import_directory.ILT_offset + import_library.first_thunk * sizeof(ULONGLONG);
+        import_descriptor.TimeDateStamp = 0;
+        import_descriptor.ForwarderChain = 0;
+        import_descriptor.Name = import_library.library->name_RVA;
+        import_descriptor.FirstThunk = section_address + import_directory.IAT_offset + import_library.first_thunk * sizeof(ULONGLONG);
+
+        write_to_image(image, position, &import_descriptor, sizeof(import_descriptor));
+    }
+    // The null descriptor and paddings are already zeros
+
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        const Import_Library& import_library = import_directory.libraries[i];
+
+        for (size_t j = 0; j < memory::get_array_size(import_library.functions); j++) {
+            ULONGLONG   hint_name_RVA = import_library.functions[j]->name_RVA;
+            DWORD       thunk_offset = (import_library.first_thunk + (DWORD)j) * sizeof(ULONGLONG);
+
+            position = section_position + import_directory.ILT_offset + thunk_offset;
+            write_to_image(image, position, &hint_name_RVA, sizeof(hint_name_RVA));
+            position = section_position + import_directory.IAT_offset + thunk_offset;
+            write_to_image(image, position, &hint_name_RVA, sizeof(hint_name_RVA));
+        }
+    }
+
+    position = section_position + import_directory.hint_name_table_offset;
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        const Import_Library& import_library = import_directory.libraries[i];
+
+        for (size_t j = 0; j < memory::get_array_size(import_library.functions); j++) {
+            const Imported_Function*    imported_function = import_library.functions[j];
+            DWORD                       entry_position = position;
+
+            write_to_image(image, position, &import_library.hints[j], sizeof(WORD));
+            write_to_image(image, position, language::to_utf8(imported_function->function->name.text), language::get_string_size(imported_function->function->name.text));
+            position = entry_position + get_hint_name_entry_size(imported_function); // '\0' and padding
+        }
+    }
+
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        const Import_Library& import_library = import_directory.libraries[i];
+
+        write_to_image(image, position, language::to_utf8(import_library.library->name), language::get_string_size(import_library.library->name));
+        position += 1; // '\0'
+    }
+
+    core::Assert(position - section_position == import_directory.size);
+}
+
+static void release(Import_Directory& import_directory)
+{
+    for (size_t i = 0; i < memory::get_array_size(import_directory.libraries); i++) {
+        memory::release(import_directory.libraries[i].functions);
+        memory::release(import_directory.libraries[i].hints);
+    }
+    memory::release(import_directory.libraries);
 }
 
 void f::PE_x64_backend::initialize_backend()
 {
     //ZoneScopedN("f::PE_x64_backend::initialize_backend");
+
+    x64::initialize_encoder();
 }
 
-void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_path)
+void f::PE_x64_backend::build_image(IR& ir, memory::Array<uint8_t>& image)
 {
-    ZoneScopedN("f::PE_x64_backend::compile");
+    ZoneScopedN("f::PE_x64_backend::build_image");
 
-    uint32_t	bytes_written;
+    if (ir.entry_point_function == invalid_function) {
+        report_error(Compiler_Error::error, "The program doesn't have a main function.");
+    }
 
-    File    output_file;
-    bool    open;
+    x64::Function_Code		program_code;
+    memory::Array<uint32_t>	function_offsets;
 
-    open = open_file(output_file, output_file_path, (File::Opening_Flag)(
-        (uint32_t)File::Opening_Flag:: WRITE |
-        (uint32_t)File::Opening_Flag::CREATE));
+    defer {
+        x64::release(program_code);
+        memory::release(function_offsets);
+    };
 
-    if (open == false) {
-        String_Builder		string_builder;
-        language::string	message;
+    {
+        ZoneScopedN("Code generation");
 
-        defer {
-            free_buffers(string_builder);
-            release(message);
-        };
+        x64::generate_program_code(ir, program_code, function_offsets);
+    }
 
-        print_to_builder(string_builder, "Failed to open file: \"%v\"\n", to_string(output_file_path));
+    Import_Directory	import_directory;
 
-        message = to_string(string_builder);
-        report_error(Compiler_Error::error, (char*)to_utf8(message));
-    }
+    defer {
+        release(import_directory);
+    };
+
+    build_import_directory(ir, import_directory);
 
 
     // https://en.wikipedia.org/wiki/Portable_Executable
@@ -295,8 +478,12 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     //
     // .text section contains the code (ASM)
     // .data section contains memory values
-    // import address table (IAT) is used to link against symbols into a different module (dll), but call functions in that way cost an extra indirection made by a jump
+    // .rdata section contains literals then jump tables of switches
+    // import address table (IAT) is used to link against symbols into a different module (dll), imported functions are called with call [rip + IAT slot], so there
+    // is no jump thunk, with -hoist-imports their addresses are read once before loops and calls are done through a register
     //
+    // The whole image is built in memory, sizes and addresses are computed before filling headers, so nothing has to be
+    // patched and the file is written at once.
 
 
     // Information about Windows system APIs and libraries
@@ -313,6 +500,92 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     IMAGE_SECTION_HEADER	reloc_image_section_header;
 #endif
     IMAGE_SECTION_HEADER	idata_image_section_header;
+    IMAGE_SECTION_HEADER	pdata_image_section_header;
+
+#if DLL_MODE == 1
+    constexpr WORD  number_of_sections = 5;
+#else
+    constexpr WORD  number_of_sections = 4;
+#endif
+
+    // .pdata has the RUNTIME_FUNCTION entries followed by the UNWIND_INFO structures they reference (.xdata)
+    DWORD   unwind_entries_size = (DWORD)memory::get_array_size(program_code.unwind_entries) * sizeof(RUNTIME_FUNCTION);
+
+    // Layout of the image
+    {
+        ZoneScopedN("Layout");
+
+        RtlSecureZeroMemory(&text_image_section_header, sizeof(text_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
+        RtlSecureZeroMemory(&rdata_image_section_header, sizeof(rdata_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
+#if DLL_MODE == 1
+        RtlSecureZeroMemory(&reloc_image_section_header, sizeof(reloc_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
+#endif
+        RtlSecureZeroMemory(&idata_image_section_header, sizeof(idata_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
+        RtlSecureZeroMemory(&pdata_image_section_header, sizeof(pdata_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
+
+        size_of_headers = compute_aligned_size(PE_header_start_address + sizeof(IMAGE_NT_HEADERS64) + number_of_sections * sizeof(IMAGE_SECTION_HEADER), file_alignment);
+
+        text_section_address = compute_aligned_size(size_of_headers, section_alignment);
+        text_image_section_pointer_to_raw_data = size_of_headers;
+        text_image_section_header.Misc.VirtualSize = (DWORD)memory::get_array_size(program_code.code);
+        text_image_section_header.SizeOfRawData = compute_aligned_size(text_image_section_header.Misc.VirtualSize, file_alignment);
+
+        rdata_section_address = compute_aligned_size(text_section_address + text_image_section_header.SizeOfRawData, section_alignment);
+        rdata_image_section_pointer_to_raw_data = align_address(text_image_section_pointer_to_raw_data + text_image_section_header.SizeOfRawData, file_alignment);
+        jump_tables_address = rdata_section_address + (((DWORD)ir.read_only_data.current_RVA + 7) & ~7);	// 8 bytes aligned
+        rdata_image_section_header.Misc.VirtualSize = jump_tables_address - rdata_section_address + (DWORD)(memory::get_array_size(program_code.jump_table_entries) * sizeof(int64_t));
+        rdata_image_section_header.SizeOfRawData = compute_aligned_size(rdata_image_section_header.Misc.VirtualSize, file_alignment);
+
+#if DLL_MODE == 1
+        reloc_section_address = compute_aligned_size(rdata_section_address + rdata_image_section_header.SizeOfRawData, section_alignment);
+        reloc_image_section_pointer_to_raw_data = align_address(rdata_image_section_pointer_to_raw_data + rdata_image_section_header.SizeOfRawData, file_alignment);
+        reloc_image_section_header.Misc.VirtualSize = sizeof(IMAGE_BASE_RELOCATION) + sizeof(text_relocation_offsets)
+            + (sizeof(IMAGE_BASE_RELOCATION) + sizeof(text_relocation_offsets)) % 4 // padding of previous block
+            + sizeof(IMAGE_BASE_RELOCATION) + sizeof(rdata_relocation_offsets);
+        reloc_image_section_header.SizeOfRawData = compute_aligned_size(reloc_image_section_header.Misc.VirtualSize, file_alignment);
+
+        idata_section_address = compute_aligned_size(reloc_section_address + reloc_image_section_header.SizeOfRawData, section_alignment);
+        idata_image_section_pointer_to_raw_data = align_address(reloc_image_section_pointer_to_raw_data + reloc_image_section_header.SizeOfRawData, file_alignment);
+#else
+        idata_section_address = compute_aligned_size(rdata_section_address + rdata_image_section_header.SizeOfRawData, section_alignment);
+        idata_image_section_pointer_to_raw_data = align_address(rdata_image_section_pointer_to_raw_data + rdata_image_section_header.SizeOfRawData, file_alignment);
+#endif
+
+        idata_image_section_header.Misc.VirtualSize = import_directory.size;
+        idata_image_section_header.SizeOfRawData = compute_aligned_size(idata_image_section_header.Misc.VirtualSize, file_alignment);
+        set_imported_functions_RVA(import_directory, idata_section_address);
+
+        pdata_section_address = compute_aligned_size(idata_section_address + idata_image_section_header.SizeOfRawData, section_alignment);
+        pdata_image_section_pointer_to_raw_data = align_address(idata_image_section_pointer_to_raw_data + idata_image_section_header.SizeOfRawData, file_alignment);
+        pdata_image_section_header.Misc.VirtualSize = unwind_entries_size + (DWORD)memory::get_array_size(program_code.unwind_info);
+        pdata_image_section_header.SizeOfRawData = compute_aligned_size(pdata_image_section_header.Misc.VirtualSize, file_alignment);
+
+        // Size_Of_Image as it is the size of the image + headers, it means that it is the full size of the file
+        size_of_image = compute_aligned_size(size_of_headers, section_alignment)
+            + compute_aligned_size(text_image_section_header.SizeOfRawData, section_alignment)
+            + compute_aligned_size(rdata_image_section_header.SizeOfRawData, section_alignment)
+#if DLL_MODE == 1
+            + compute_aligned_size(reloc_image_section_header.SizeOfRawData, section_alignment)
+#endif
+            + compute_aligned_size(idata_image_section_header.SizeOfRawData, section_alignment)
+            + compute_aligned_size(pdata_image_section_header.SizeOfRawData, section_alignment);
+
+        size_of_code = text_image_section_header.SizeOfRawData;	 // @Warning size of the sum of all .text sections
+        size_of_initialized_data = rdata_image_section_header.SizeOfRawData
+#if DLL_MODE == 1
+            + reloc_image_section_header.SizeOfRawData
+#endif
+            + idata_image_section_header.SizeOfRawData
+            + pdata_image_section_header.SizeOfRawData;
+        size_of_uninitialized_data = 0;	 // @Warning size unitialized data in all sections
+        address_of_entry_point = text_section_address + function_offsets[ir.entry_point_function];	// main, its returned value is the exit code of the main thread
+        base_of_code = text_section_address;
+    }
+
+    DWORD   position;
+
+    memory::resize_array(image, pdata_image_section_pointer_to_raw_data + pdata_image_section_header.SizeOfRawData);
+    system::zero_memory(memory::get_array_data(image), memory::get_array_size(image)); // Paddings are zeros
 
     RtlSecureZeroMemory(&image_dos_header, sizeof(image_dos_header));
 
@@ -322,17 +595,13 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     image_dos_header.e_lfanew = PE_header_start_address;	// Offset to the image_nt_header
     // @TODO complete the MS-DOS stub program, we should print an ERROR message ("This program cannot be run in DOS mode") and exit with code: 1
 
-    image_dos_header_address = (DWORD)get_file_position(output_file);;
-    write_file(output_file, (uint8_t*)&image_dos_header, sizeof(image_dos_header), &bytes_written);
-    write_zeros(output_file, PE_header_start_address - sizeof(image_dos_header)); // Move to current position (jumping implementation of the DOS_STUB) to PE_header_start_address
+    position = 0;
+    write_to_image(image, position, &image_dos_header, sizeof(image_dos_header));
+    position = PE_header_start_address; // Jumping implementation of the DOS_STUB
 
     image_nt_header.Signature = (WORD)'P' | ((WORD)'E' << 8);	// 'PE\0\0' @Warning take care of the endianness / 0x50450000
     image_nt_header.FileHeader.Machine = IMAGE_FILE_MACHINE_AMD64;
-#if DLL_MODE == 1
-    image_nt_header.FileHeader.NumberOfSections = 4;
-#else
-    image_nt_header.FileHeader.NumberOfSections = 3;
-#endif
+    image_nt_header.FileHeader.NumberOfSections = number_of_sections;
     image_nt_header.FileHeader.TimeDateStamp = (DWORD)(current_time_in_seconds_since_1970);	// @Warning UTC time
     image_nt_header.FileHeader.PointerToSymbolTable = 0;	// This value should be zero for an image because COFF debugging information is deprecated.
     image_nt_header.FileHeader.NumberOfSymbols = 0;			// This value should be zero for an image because COFF debugging information is deprecated.
@@ -379,28 +648,23 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
 
         RtlSecureZeroMemory(image_nt_header.OptionalHeader.DataDirectory, sizeof(image_nt_header.OptionalHeader.DataDirectory));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
 
-#if DLL_MODE == 1
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = 0x4000; // @TODO need to be computed and patched
-#else
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = 0x3000; // @TODO need to be computed and patched
-#endif
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = (hash_table_get_size(ir.imported_libraries) + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR); // + 1 for the null entry
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = idata_section_address;
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = ((DWORD)memory::get_array_size(import_directory.libraries) + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR); // + 1 for the null entry
 
 #if DLL_MODE == 1
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = 0x3000; // @TODO need to be computed and patched
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = sizeof(IMAGE_BASE_RELOCATION) + sizeof(text_relocation_offsets)
-            + (sizeof(IMAGE_BASE_RELOCATION) + sizeof(text_relocation_offsets)) % 4 // padding of previous block
-            + sizeof(IMAGE_BASE_RELOCATION) + sizeof(rdata_relocation_offsets); // relocation of first memory page of .text section
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = reloc_section_address;
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = reloc_image_section_header.Misc.VirtualSize; // relocation of first memory page of .text section
 #endif
 
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].VirtualAddress = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-            + (hash_table_get_size(ir.imported_libraries) + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR) // Import table + null terminated entry
-            + sizeof(LONGLONG) * (3 + 1); // ILT (3 entries + 1 null)
-        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].Size = (3 + 1) * sizeof(LONGLONG); // @TODO take care of 64bit binaries // null entry count
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].VirtualAddress = idata_section_address + import_directory.IAT_offset;
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].Size = import_directory.nb_thunks * sizeof(ULONGLONG);
+
+        // Functions don't have a frame pointer, the stack is walked with the unwind information
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress = pdata_section_address;
+        image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION].Size = unwind_entries_size;
     }
 
-    image_nt_header_address = (DWORD)get_file_position(output_file);
-    write_file(output_file, (uint8_t*)&image_nt_header, sizeof(image_nt_header), & bytes_written);
+    write_to_image(image, position, &image_nt_header, sizeof(image_nt_header));
 
 
     core::Assert(image_nt_header.FileHeader.NumberOfSections <= 96);
@@ -409,12 +673,8 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     {
         ZoneScopedN(".text section");
 
-        RtlSecureZeroMemory(&text_image_section_header, sizeof(text_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
-
         RtlCopyMemory(text_image_section_header.Name, ".text", 6);	// @Warning there is a '\0' ending character as it doesn't fill the 8 characters
-        text_image_section_header.Misc.VirtualSize = sizeof(hello_world_instructions);
-        text_image_section_header.VirtualAddress = text_image_section_virtual_address;
-        text_image_section_header.SizeOfRawData = compute_aligned_size(text_image_section_header.Misc.VirtualSize, file_alignment);
+        text_image_section_header.VirtualAddress = text_section_address;
         text_image_section_header.PointerToRawData = text_image_section_pointer_to_raw_data;
         text_image_section_header.PointerToRelocations = 0x00;
         text_image_section_header.PointerToLinenumbers = 0x00;
@@ -422,20 +682,15 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
         text_image_section_header.NumberOfLinenumbers = 0;
         text_image_section_header.Characteristics = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
 
-        text_image_section_header_address = (DWORD)get_file_position(output_file);
-        write_file(output_file, (uint8_t*)&text_image_section_header, sizeof(text_image_section_header), &bytes_written);
+        write_to_image(image, position, &text_image_section_header, sizeof(text_image_section_header));
     }
 
     // .rdata section
     {
         ZoneScopedN(".rdata section");
 
-        RtlSecureZeroMemory(&rdata_image_section_header, sizeof(rdata_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
-
         RtlCopyMemory(rdata_image_section_header.Name, ".rdata", 7);	// @Warning there is a '\0' ending character as it doesn't fill the 8 characters
-        rdata_image_section_header.Misc.VirtualSize = (DWORD)ir.read_only_data.current_RVA; // fstd::language::string_literal_size(message[0]) + 1;
-        rdata_image_section_header.VirtualAddress = rdata_image_section_virtual_address;
-        rdata_image_section_header.SizeOfRawData = compute_aligned_size(rdata_image_section_header.Misc.VirtualSize, file_alignment);
+        rdata_image_section_header.VirtualAddress = rdata_section_address;
         rdata_image_section_header.PointerToRawData = rdata_image_section_pointer_to_raw_data;
         rdata_image_section_header.PointerToRelocations = 0x00;
         rdata_image_section_header.PointerToLinenumbers = 0x00;
@@ -443,8 +698,7 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
         rdata_image_section_header.NumberOfLinenumbers = 0;
         rdata_image_section_header.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
 
-        rdata_image_section_header_address = (DWORD)get_file_position(output_file);
-        write_file(output_file, (uint8_t*)&rdata_image_section_header, sizeof(rdata_image_section_header), &bytes_written);
+        write_to_image(image, position, &rdata_image_section_header, sizeof(rdata_image_section_header));
     }
 
 #if DLL_MODE == 1
@@ -452,12 +706,8 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     {
         ZoneScopedN(".reloc section");
 
-        RtlSecureZeroMemory(&reloc_image_section_header, sizeof(reloc_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
-
         RtlCopyMemory(reloc_image_section_header.Name, ".reloc", 7);	// @Warning there is a '\0' ending character as it doesn't fill the 8 characters
-        reloc_image_section_header.Misc.VirtualSize = 0; // @TODO fix it // @TODO compute it
-        reloc_image_section_header.VirtualAddress = reloc_image_section_virtual_address;
-        reloc_image_section_header.SizeOfRawData = compute_aligned_size(reloc_image_section_header.Misc.VirtualSize, file_alignment);
+        reloc_image_section_header.VirtualAddress = reloc_section_address;
         reloc_image_section_header.PointerToRawData = reloc_image_section_pointer_to_raw_data;
         reloc_image_section_header.PointerToRelocations = 0x00;
         reloc_image_section_header.PointerToLinenumbers = 0x00;
@@ -465,8 +715,7 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
         reloc_image_section_header.NumberOfLinenumbers = 0;
         reloc_image_section_header.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_DISCARDABLE | IMAGE_SCN_MEM_READ;
 
-        reloc_image_section_header_address = (DWORD)get_file_position(output_file);
-        write_file(output_file, (uint8_t*)&reloc_image_section_header, sizeof(reloc_image_section_header), &bytes_written);
+        write_to_image(image, position, &reloc_image_section_header, sizeof(reloc_image_section_header));
     }
 #endif
 
@@ -474,12 +723,8 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     {
         ZoneScopedN(".idata section");
 
-        RtlSecureZeroMemory(&idata_image_section_header, sizeof(idata_image_section_header));	// @TODO replace it by the corresponding intrasect while translating this code in f-lang
-
         RtlCopyMemory(idata_image_section_header.Name, ".idata", 7);	// @Warning there is a '\0' ending character as it doesn't fill the 8 characters
-        idata_image_section_header.Misc.VirtualSize = 126; // @TODO compute it
-        idata_image_section_header.VirtualAddress = idata_image_section_virtual_address;
-        idata_image_section_header.SizeOfRawData = compute_aligned_size(idata_image_section_header.Misc.VirtualSize, file_alignment);
+        idata_image_section_header.VirtualAddress = idata_section_address;
         idata_image_section_header.PointerToRawData = idata_image_section_pointer_to_raw_data;
         idata_image_section_header.PointerToRelocations = 0x00;
         idata_image_section_header.PointerToLinenumbers = 0x00;
@@ -487,44 +732,68 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
         idata_image_section_header.NumberOfLinenumbers = 0;
         idata_image_section_header.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_DISCARDABLE | IMAGE_SCN_MEM_READ;
 
-        idata_image_section_header_address = (DWORD)get_file_position(output_file);
-        write_file(output_file, (uint8_t*)&idata_image_section_header, sizeof(idata_image_section_header), &bytes_written);
+        write_to_image(image, position, &idata_image_section_header, sizeof(idata_image_section_header));
     }
 
-    // Move to next aligned position before writing code (text_section)
-    size_of_headers = (DWORD)get_file_position(output_file);
-    text_section_address = compute_aligned_size(size_of_headers, section_alignment);
-    text_image_section_pointer_to_raw_data = compute_aligned_size(size_of_headers, file_alignment);
-    set_file_position(output_file, text_image_section_pointer_to_raw_data);
-
-    size_of_image = (DWORD)get_file_position(output_file);
-    size_of_image = compute_aligned_size(size_of_image, section_alignment);
+    // .pdata section
+    {
+        ZoneScopedN(".pdata section");
+
+        RtlCopyMemory(pdata_image_section_header.Name, ".pdata", 7);	// @Warning there is a '\0' ending character as it doesn't fill the 8 characters
+        pdata_image_section_header.VirtualAddress = pdata_section_address;
+        pdata_image_section_header.PointerToRawData = pdata_image_section_pointer_to_raw_data;
+        pdata_image_section_header.PointerToRelocations = 0x00;
+        pdata_image_section_header.PointerToLinenumbers = 0x00;
+        pdata_image_section_header.NumberOfRelocations = 0;
+        pdata_image_section_header.NumberOfLinenumbers = 0;
+        pdata_image_section_header.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+
+        write_to_image(image, position, &pdata_image_section_header, sizeof(pdata_image_section_header));
+    }
 
     // Write code (.text section data)
     {
         ZoneScopedN("Write code (.text section data)");
 
-        write_file(output_file, (uint8_t*)hello_world_instructions, sizeof(hello_world_instructions), &bytes_written);
-        write_zeros(output_file, text_image_section_header.SizeOfRawData - sizeof(hello_world_instructions));
-        size_of_image += compute_aligned_size(text_image_section_header.SizeOfRawData, section_alignment);
+        position = text_image_section_pointer_to_raw_data;
+        write_to_image(image, position, memory::get_array_data(program_code.code), memory::get_array_size(program_code.code));
+
+        // Calls between functions are already resolved by the code generator
+        uint8_t* code = memory::get_array_data(image) + text_image_section_pointer_to_raw_data;
+        for (size_t i = 0; i < memory::get_array_size(program_code.fixups); i++) {
+            const x64::Code_Fixup&  fixup = program_code.fixups[i];
+            DWORD                   target_RVA;
+            int32_t                 displacement;
+
+            if (fixup.kind == x64::Code_Fixup::Kind::IMPORTED_FUNCTION) {
+                target_RVA = ir.functions[fixup.index].imported_function->IAT_RVA;
+            }
+            else if (fixup.kind == x64::Code_Fixup::Kind::JUMP_TABLE) {
+                target_RVA = jump_tables_address + fixup.index * sizeof(int64_t);
+            }
+            else {
+                target_RVA = rdata_section_address + (DWORD)ir.read_only_data.literals[fixup.index].RVA;
+            }
+            displacement = (int32_t)(target_RVA - (text_section_address + fixup.instruction_end));
+            RtlCopyMemory(code + fixup.displacement_offset, &displacement, sizeof(displacement));
+        }
     }
 
     // Write read only data (.rdata section data)
     {
         ZoneScopedN("Write read only data (.rdata section data)");
 
-        DWORD rdata_section_size = 0;
+        position = rdata_image_section_pointer_to_raw_data;
+        write_to_image(image, position, memory::get_array_data(ir.read_only_data.section), memory::get_array_bytes_size(ir.read_only_data.section));
 
-        for (size_t i = 0; i < memory::get_array_size(ir.read_only_data.literals); i++) {
-            write_file(output_file, memory::get_array_data(ir.read_only_data.literals[i].data), (uint32_t)memory::get_array_bytes_size(ir.read_only_data.literals[i].data), &bytes_written);
-            rdata_section_size += bytes_written;
-        }
+        // Entries are offsets of their target from the beginning of their table, so they don't need relocations
+        position = rdata_image_section_pointer_to_raw_data + (jump_tables_address - rdata_section_address);
+        for (size_t i = 0; i < memory::get_array_size(program_code.jump_table_entries); i++) {
+            const x64::Jump_Table_Entry&    entry = program_code.jump_table_entries[i];
+            int64_t                         offset = (int64_t)(text_section_address + entry.target) - (int64_t)(jump_tables_address + entry.first_entry * sizeof(int64_t));
 
-        //write_file(output_file, (uint8_t*)message[0], (DWORD)fstd::language::string_literal_size(message[0]) + 1, &bytes_written); // +1 to write the ending '\0'
-        //rdata_section_size += bytes_written;
-
-        write_zeros(output_file, rdata_image_section_header.SizeOfRawData - rdata_section_size);
-        size_of_image += compute_aligned_size(rdata_image_section_header.SizeOfRawData, section_alignment);
+            write_to_image(image, position, &offset, sizeof(offset));
+        }
     }
 
 #if DLL_MODE == 1
@@ -536,43 +805,29 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
 
         IMAGE_BASE_RELOCATION image_base_relocation;
 
-        DWORD reloc_section_size = 0;
-
         // @Warning IMAGE_BASE_RELOCATION headers have to be aligned on 32bits, but because I start to the begining of the .reloc section the first is aligned correctly.
+        position = reloc_image_section_pointer_to_raw_data;
 
         // for .text section
         {
-            image_base_relocation.VirtualAddress = 0x1000; // @TODO compute it, RVA of first memory page of .text section
+            image_base_relocation.VirtualAddress = text_section_address; // RVA of first memory page of .text section
             image_base_relocation.SizeOfBlock = sizeof(IMAGE_BASE_RELOCATION) + 3 * sizeof(WORD); // @TODO compute it: (3 external function call)
 
-            write_file(output_file, (uint8_t*)&image_base_relocation, sizeof(image_base_relocation), &bytes_written);
-            reloc_section_size += bytes_written;
-
-            write_file(output_file, (uint8_t*)&text_relocation_offsets, sizeof(text_relocation_offsets), &bytes_written);
-            reloc_section_size += bytes_written;
+            write_to_image(image, position, &image_base_relocation, sizeof(image_base_relocation));
+            write_to_image(image, position, &text_relocation_offsets, sizeof(text_relocation_offsets));
         }
 
         // @Warning @WTF PE-bear don't see correct size of blocks after the padding
-        DWORD padding = reloc_section_size % 4;
-        if (padding) {
-            write_zeros(output_file, padding);
-            reloc_section_size += padding;
-        }
+        position += (position - reloc_image_section_pointer_to_raw_data) % 4; // Paddings are already zeros
 
         // for .rdata section
         {
-            image_base_relocation.VirtualAddress = 0x2000; // @TODO compute it, RVA of first memory page of .rdata section
+            image_base_relocation.VirtualAddress = rdata_section_address; // RVA of first memory page of .rdata section
             image_base_relocation.SizeOfBlock = sizeof(IMAGE_BASE_RELOCATION) + 1 * sizeof(WORD); // @TODO compute it: (3 external function call)
 
-            write_file(output_file, (uint8_t*)&image_base_relocation, sizeof(image_base_relocation), &bytes_written);
-            reloc_section_size += bytes_written;
-
-            write_file(output_file, (uint8_t*)&rdata_relocation_offsets, sizeof(rdata_relocation_offsets), &bytes_written);
-            reloc_section_size += bytes_written;
+            write_to_image(image, position, &image_base_relocation, sizeof(image_base_relocation));
+            write_to_image(image, position, &rdata_relocation_offsets, sizeof(rdata_relocation_offsets));
         }
-
-        write_zeros(output_file, reloc_image_section_header.SizeOfRawData - reloc_section_size);
-        size_of_image += compute_aligned_size(rdata_image_section_header.SizeOfRawData, section_alignment);
     }
 #endif
 
@@ -580,317 +835,68 @@ void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_pa
     {
         ZoneScopedN("Write import data (.idata section data)");
 
-        // @TODO Make it generic (actually hard coded)
-        // @TODO check the section size in the header (idata_image_section_header.SizeOfRawData)
-
-
-        DWORD HNT_size = 0;
-        for (DWORD i = 0; i < 3; i++) {
-            HNT_size += sizeof(WORD);
-            HNT_size += (DWORD)fstd::language::string_literal_size(kernel32_function_names[i]) + 1;
-        }
-
-        DWORD idata_section_size = 0;
-        {
-            IMAGE_IMPORT_DESCRIPTOR import_descriptor;
-
-            // RVA to original unbound IAT (PIMAGE_THUNK_DATA)
-            import_descriptor.OriginalFirstThunk = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2;
-            import_descriptor.TimeDateStamp = 0;
-            import_descriptor.ForwarderChain = 0; // -1 if no forwarders
-
-            // RVA to DLL name
-            import_descriptor.Name = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2
-                + sizeof(LONGLONG) * (3 + 1) * 2 // IAT + ILT
-                + HNT_size; // HNT
-
-            // RVA to IAT (if bound this IAT has actual addresses)
-            import_descriptor.FirstThunk = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2
-                + sizeof(LONGLONG) * (3 + 1);
-
-            write_file(output_file, (uint8_t*)&import_descriptor, sizeof(import_descriptor), &bytes_written);
-            idata_section_size += bytes_written;
-        }
-        // Write zeros to terminate import_descriptor table
-        write_zeros(output_file, sizeof(IMAGE_IMPORT_DESCRIPTOR));
-        idata_section_size += sizeof(IMAGE_IMPORT_DESCRIPTOR);
-
-        // ILT (Import Lookup Table). A simple LONGLONG per entry that contains RVA to function names
-        // IAT (Import Address Table). A simple LONGLONG per entry that contains RVA to function address.
-        //
-        // ILT and IAT are exactly the same in file, but the loader will resolve addresses for the IAT when loading the binary
-
-        for (size_t i = 0; i < 2; i++)
-        {
-            {
-                LONGLONG RVA;
-
-                // GetStdHandle
-                RVA = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                    + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2
-                    + sizeof(LONGLONG) * (3 + 1) * 2 // ILT + IAT
-                    + 0;
-                write_file(output_file, (uint8_t*)&RVA, sizeof(RVA), &bytes_written);
-                DWORD pos = (DWORD)get_file_position(output_file);
-
-                idata_section_size += bytes_written;
-
-                // WriteFile
-                RVA = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                    + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2
-                    + sizeof(LONGLONG) * (3 + 1) * 2 // ILT + IAT;
-                    + (DWORD)fstd::language::string_literal_size(kernel32_function_names[0]) + 1 + sizeof(WORD);
-                write_file(output_file, (uint8_t*)&RVA, sizeof(RVA), &bytes_written);
-                idata_section_size += bytes_written;
-
-                // ExitProcess
-                RVA = image_nt_header.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress
-                    + sizeof(IMAGE_IMPORT_DESCRIPTOR) * 2
-                    + sizeof(LONGLONG) * (3 + 1) * 2 // ILT + IAT;
-                    + (DWORD)fstd::language::string_literal_size(kernel32_function_names[0]) + 1 + (DWORD)fstd::language::string_literal_size(kernel32_function_names[1]) + 1 + sizeof(WORD) * 2;
-                write_file(output_file, (uint8_t*)&RVA, sizeof(RVA), &bytes_written);
-                idata_section_size += bytes_written;
-            }
-            write_zeros(output_file, sizeof(LONGLONG));
-            idata_section_size += bytes_written;
-        }
-
-        // HNT (Hint/Name Table)
-        {
-            IMAGE_IMPORT_BY_NAME name;
-
-            name.Hint = 0; // @TODO @Optimize a proper linker will certainly try to get a good hint to help the loader.
-
-            for (size_t i = 0; i < 3; i++)
-            {
-                write_file(output_file, (uint8_t*)&name.Hint, sizeof(name.Hint), &bytes_written);
-                idata_section_size += bytes_written;
-
-                write_file(output_file, (uint8_t*)kernel32_function_names[i], (DWORD)fstd::language::string_literal_size(kernel32_function_names[i]) + 1, &bytes_written); // +1 to write the ending '\0'
-                idata_section_size += bytes_written;
-            }
-        }
-
-        // Dll names
-        auto it = hash_table_begin(ir.imported_libraries);
-        auto it_end = hash_table_end(ir.imported_libraries);
-        for (; !equals<uint16_t, fstd::language::string_view, Imported_Library*, 32>(it, it_end); hash_table_next<uint16_t, fstd::language::string_view, Imported_Library*, 32>(it))
-        {
-            Imported_Library* imported_library = *hash_table_get<uint16_t, fstd::language::string_view, Imported_Library*, 32>(it);
-
-            write_file(output_file, to_utf8(imported_library->name), (uint32_t)get_string_size(imported_library->name), &bytes_written);
-            write_zeros(output_file, 1); // add '\0'
-            idata_section_size += bytes_written + 1;
-        }
-
-        // @TODO write zeros??? to terminate the import_descriptors table
-
-        write_zeros(output_file, idata_image_section_header.SizeOfRawData - idata_section_size);
-        size_of_image += compute_aligned_size(idata_image_section_header.SizeOfRawData, section_alignment);
-    }
-
-    // Size_Of_Image as it is the size of the image + headers, it means that it is the full size of the file
-    // and here we are at the end of file
-
-    // Patching address and sizes
-
-    // size_of_code
-    {
-        ZoneScopedN("size_of_code");
-
-        DWORD size_of_code_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.SizeOfCode);
-        size_of_code = text_image_section_header.SizeOfRawData;	 // @Warning size of the sum of all .text sections
-
-        set_file_position(output_file, size_of_code_address);
-        write_file(output_file, (uint8_t*)&size_of_code, sizeof(size_of_code), &bytes_written);
-    }
-
-    // size_of_initialized_data
-    {
-        ZoneScopedN("size_of_initialized_data");
-
-        DWORD size_of_initialized_data_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.SizeOfInitializedData);
-        size_of_initialized_data = text_image_section_header.SizeOfRawData;	 // @Warning size of the sum of all .text sections
-        // 1024
-        set_file_position(output_file, size_of_initialized_data_address);
-        write_file(output_file, (uint8_t*)&size_of_initialized_data, sizeof(size_of_initialized_data), &bytes_written);
-    }
-
-    // size_of_uninitialized_data
-    {
-        ZoneScopedN("size_of_uninitialized_data");
-
-        DWORD size_of_uninitialized_data_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.SizeOfUninitializedData);
-        size_of_uninitialized_data = 0;	 // @Warning size unitialized data in all .text sections
-
-        set_file_position(output_file, size_of_uninitialized_data_address);
-        write_file(output_file, (uint8_t*)&size_of_uninitialized_data, sizeof(size_of_uninitialized_data), &bytes_written);
+        write_import_directory(image, idata_image_section_pointer_to_raw_data, import_directory, idata_section_address);
     }
 
-    // address_of_entry_point
+    // Write exception data (.pdata section data)
     {
-        ZoneScopedN("address_of_entry_point");
-
-        DWORD address_of_entry_point_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.AddressOfEntryPoint);
-        address_of_entry_point = text_section_address;
-        // 4096
-        set_file_position(output_file, address_of_entry_point_address);
-        write_file(output_file, (uint8_t*)&address_of_entry_point, sizeof(address_of_entry_point), &bytes_written);
-    }
+        ZoneScopedN("Write exception data (.pdata section data)");
 
-    // base_of_code
-    {
-        ZoneScopedN("base_of_code");
-
-        DWORD base_of_code_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.BaseOfCode);
-        base_of_code = text_section_address;
-        // 4096
-        set_file_position(output_file, base_of_code_address);
-        write_file(output_file, (uint8_t*)&base_of_code, sizeof(base_of_code), &bytes_written);
-    }
-
-    // base_of_data
-    {
-        ZoneScopedN("base_of_data");
-
-        DWORD base_of_data_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.BaseOfData);
-        rdata_section_address = compute_aligned_size(text_section_address + text_image_section_header.SizeOfRawData, section_alignment);
-        rdata_image_section_pointer_to_raw_data = align_address(text_image_section_pointer_to_raw_data + text_image_section_header.SizeOfRawData, file_alignment);
-#if DLL_MODE == 1
-        reloc_section_address = compute_aligned_size(rdata_section_address + rdata_image_section_header.SizeOfRawData, section_alignment);
-        reloc_image_section_pointer_to_raw_data = align_address(rdata_image_section_pointer_to_raw_data + rdata_image_section_header.SizeOfRawData, file_alignment);
-#endif
-
-#if DLL_MODE == 1
-        idata_section_address = compute_aligned_size(reloc_section_address + reloc_image_section_header.SizeOfRawData, section_alignment);
-        idata_image_section_pointer_to_raw_data = align_address(reloc_image_section_pointer_to_raw_data + reloc_image_section_header.SizeOfRawData, file_alignment);
-#else
-        idata_section_address = compute_aligned_size(rdata_section_address + rdata_image_section_header.SizeOfRawData, section_alignment);
-        idata_image_section_pointer_to_raw_data = align_address(rdata_image_section_pointer_to_raw_data + rdata_image_section_header.SizeOfRawData, file_alignment);
-#endif
-
-        // 8192
-        /* Inexistant in x64 only in x86
-        set_file_position(output_file, base_of_data_address);
-        write_file(output_file, (uint8_t*)&base_of_data, sizeof(base_of_data), &bytes_written);
-        */
-    }
-
-    // size_of_image
-    // Gets the size (in bytes) of the image, including all headers, as the image is loaded in memory.
-    // The size (in bytes) of the image, which is a multiple of SectionAlignment.
-    {
-        ZoneScopedN("size_of_image");
-
-        DWORD size_of_image_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.SizeOfImage);
-        //        size_of_image = compute_aligned_size(size_of_image, section_alignment);
-                // 
-        set_file_position(output_file, size_of_image_address);
-        write_file(output_file, (uint8_t*)&size_of_image, sizeof(size_of_image), &bytes_written);
-    }
-
-    // size_of_headers (The combined size of an MS DOS stub, PE header, and section headers rounded up to a multiple of FileAlignment.)
-    {
-        ZoneScopedN("size_of_headers");
-
-        DWORD size_of_header_address = image_nt_header_address + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.SizeOfHeaders);
-        size_of_headers = compute_aligned_size(size_of_headers, file_alignment);
-        // 
-        set_file_position(output_file, size_of_header_address);
-        write_file(output_file, (uint8_t*)&size_of_headers, sizeof(size_of_headers), &bytes_written);
-    }
-
-    // text_image_section_virtual_address
-    {
-        ZoneScopedN("text_image_section_virtual_address");
+        position = pdata_image_section_pointer_to_raw_data;
+        for (size_t i = 0; i < memory::get_array_size(program_code.unwind_entries); i++) {
+            const x64::Unwind_Entry&    unwind_entry = program_code.unwind_entries[i];
+            RUNTIME_FUNCTION            runtime_function;
 
-        DWORD text_image_section_virtual_address_address = text_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, VirtualAddress);
-        text_image_section_virtual_address = text_section_address;
-
-        set_file_position(output_file, text_image_section_virtual_address_address);
-        write_file(output_file, (uint8_t*)&text_image_section_virtual_address, sizeof(text_image_section_virtual_address), &bytes_written);
-    }
-
-    // text_image_section_pointer_to_raw_data
-    {
-        ZoneScopedN("text_image_section_pointer_to_raw_data");
-
-        DWORD text_image_section_pointer_to_raw_data_address = text_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, PointerToRawData);
-        // text_image_section_pointer_to_raw_data is already computed
-
-        set_file_position(output_file, text_image_section_pointer_to_raw_data_address);
-        write_file(output_file, (uint8_t*)&text_image_section_pointer_to_raw_data, sizeof(text_image_section_pointer_to_raw_data), &bytes_written);
-    }
-
-    // rdata_image_section_virtual_address
-    {
-        ZoneScopedN("rdata_image_section_virtual_address");
-
-        DWORD rdata_image_section_virtual_address_address = rdata_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, VirtualAddress);
-        rdata_image_section_virtual_address = rdata_section_address;
-
-        set_file_position(output_file, rdata_image_section_virtual_address_address);
-        write_file(output_file, (uint8_t*)&rdata_image_section_virtual_address, sizeof(rdata_image_section_virtual_address), &bytes_written);
+            runtime_function.BeginAddress = text_section_address + unwind_entry.function_start;
+            runtime_function.EndAddress = text_section_address + unwind_entry.function_end;
+            runtime_function.UnwindData = pdata_section_address + unwind_entries_size + unwind_entry.unwind_info_offset;
+            write_to_image(image, position, &runtime_function, sizeof(runtime_function));
+        }
+        write_to_image(image, position, memory::get_array_data(program_code.unwind_info), memory::get_array_size(program_code.unwind_info));
     }
+}
 
-    // rdata_image_section_pointer_to_raw_data
-    {
-        ZoneScopedN("rdata_image_section_pointer_to_raw_data");
-
-        DWORD rdata_image_section_pointer_to_raw_data_address = rdata_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, PointerToRawData);
-        // rdata_image_section_pointer_to_raw_data is already computed
+void f::PE_x64_backend::compile(IR& ir, const fstd::system::Path& output_file_path)
+{
+    ZoneScopedN("f::PE_x64_backend::compile");
 
-        set_file_position(output_file, rdata_image_section_pointer_to_raw_data_address);
-        write_file(output_file, (uint8_t*)&rdata_image_section_pointer_to_raw_data, sizeof(rdata_image_section_pointer_to_raw_data), &bytes_written);
-    }
+    uint32_t	bytes_written;
 
-#if DLL_MODE == 1
-    // reloc_image_section_virtual_address
-    {
-        ZoneScopedN("reloc_image_section_virtual_address");
+    File    output_file;
+    bool    open;
 
-        DWORD reloc_image_section_virtual_address_address = reloc_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, VirtualAddress);
-        reloc_image_section_virtual_address = reloc_section_address;
+    open = open_file(output_file, output_file_path, (File::Opening_Flag)(
+        (uint32_t)File::Opening_Flag:: WRITE |
+        (uint32_t)File::Opening_Flag::CREATE));
 
-        set_file_position(output_file, reloc_image_section_virtual_address_address);
-        write_file(output_file, (uint8_t*)&reloc_image_section_virtual_address, sizeof(reloc_image_section_virtual_address), &bytes_written);
-    }
+    if (open == false) {
+        String_Builder		string_builder;
+        language::string	message;
 
-    // reloc_image_section_pointer_to_raw_data
-    {
-        ZoneScopedN("reloc_image_section_pointer_to_raw_data");
+        defer {
+            free_buffers(string_builder);
+            release(message);
+        };
 
-        DWORD reloc_image_section_pointer_to_raw_data_address = reloc_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, PointerToRawData);
-        // reloc_image_section_pointer_to_raw_data is already computed
+        print_to_builder(string_builder, "Failed to open file: \"%v\"\n", to_string(output_file_path));
 
-        set_file_position(output_file, reloc_image_section_pointer_to_raw_data_address);
-        write_file(output_file, (uint8_t*)&reloc_image_section_pointer_to_raw_data, sizeof(reloc_image_section_pointer_to_raw_data), &bytes_written);
+        message = to_string(string_builder);
+        report_error(Compiler_Error::error, (char*)to_utf8(message));
     }
-#endif
 
-    // idata_image_section_virtual_address
-    {
-        ZoneScopedN("idata_image_section_virtual_address");
+    memory::Array<uint8_t>	image;
 
-        DWORD idata_image_section_virtual_address_address = idata_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, VirtualAddress);
-        idata_image_section_virtual_address = idata_section_address;
+    defer {
+        memory::release(image);
+    };
 
-        set_file_position(output_file, idata_image_section_virtual_address_address);
-        write_file(output_file, (uint8_t*)&idata_image_section_virtual_address, sizeof(idata_image_section_virtual_address), &bytes_written);
-    }
+    build_image(ir, image);
 
-    // idata_image_section_pointer_to_raw_data
+    // Write the file at once
     {
-        ZoneScopedN("idata_image_section_pointer_to_raw_data");
-
-        DWORD idata_image_section_pointer_to_raw_data_address = idata_image_section_header_address + offsetof(IMAGE_SECTION_HEADER, PointerToRawData);
-        // idata_image_section_pointer_to_raw_data is already computed
+        ZoneScopedN("Write file");
 
-        set_file_position(output_file, idata_image_section_pointer_to_raw_data_address);
-        write_file(output_file, (uint8_t*)&idata_image_section_pointer_to_raw_data, sizeof(idata_image_section_pointer_to_raw_data), &bytes_written);
+        write_file(output_file, memory::get_array_data(image), (uint32_t)memory::get_array_size(image), &bytes_written);
     }
 
     close_file(output_file);
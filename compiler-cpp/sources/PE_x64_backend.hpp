@@ -57,6 +57,8 @@ namespace f
 		bool generate_hello_world(); // @TODO remove it
 
 		void initialize_backend();
+		// Build the whole executable in image, compile writes it in a file
+		void build_image(IR& ir, fstd::memory::Array<uint8_t>& image);
 		void compile(IR& ir, const fstd::system::Path& output_file_path);
 	}
 }
@@ -0,0 +1,386 @@
+#include "VM.hpp"
+
+#include "globals.hpp"
+
+#include "parser/parser.hpp"
+#include "parser/symbol_solver.hpp"
+#include "parser/constant_folder.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <tracy/Tracy.hpp>
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::VM;
+
+static const size_t nb_registers = 64 * 1024;
+static const size_t max_call_depth = 4 * 1024;
+
+// The dispatch use a computed goto when it is supported by the compiler (GCC and clang), an indirect jump per
+// instruction is better predicted than the single one of a switch.
+// MSVC doesn't support it, so it fallback on a switch in a loop.
+#if defined(__GNUC__) || defined(__clang__)
+#	define VM_USE_COMPUTED_GOTO
+#endif
+
+#if defined(VM_USE_COMPUTED_GOTO)
+#	define VM_DISPATCH()		instruction = *pc++; goto *dispatch_table[(size_t)get_opcode(instruction)];
+#	define VM_CASE(opcode)		label_##opcode:
+#	define VM_NEXT()			VM_DISPATCH()
+#else
+#	define VM_DISPATCH()		instruction = *pc++; switch (get_opcode(instruction))
+#	define VM_CASE(opcode)		case Opcode::opcode:
+#	define VM_NEXT()			continue
+#endif
+
+// Signed overflows are undefined in C++ but not in f-lang, the computation is done with unsigned integers, then
+// the result is sign or zero extended from the width of its type
+static inline int64_t wrap(uint64_t value, Value_Type type)
+{
+	switch (type)
+	{
+	case Value_Type::I8:	return (int8_t)value;
+	case Value_Type::I16:	return (int16_t)value;
+	case Value_Type::I32:	return (int32_t)value;
+	case Value_Type::UI8:	return (uint8_t)value;
+	case Value_Type::UI16:	return (uint16_t)value;
+	case Value_Type::UI32:	return (uint32_t)value;
+	default:				return (int64_t)value;
+	}
+}
+
+static inline Value convert(Value value, Value_Type from, Value_Type to)
+{
+	Value result;
+
+	if (is_real(from) && is_real(to)) {
+		result.real = to == Value_Type::F32 ? (double)(float)value.real : value.real;
+	}
+	else if (is_real(from)) {
+		// Negative values are converted through int64, so unsigned types wrap them instead of the undefined behavior
+		uint64_t integer = value.real < 0.0 ? (uint64_t)(int64_t)value.real : (uint64_t)value.real;
+
+		result.integer = wrap(integer, to);
+	}
+	else if (is_real(to)) {
+		if (to == Value_Type::F32) {
+			result.real = is_unsigned(from) ? (double)(float)(uint64_t)value.integer : (double)(float)value.integer;
+		}
+		else {
+			result.real = is_unsigned(from) ? (double)(uint64_t)value.integer : (double)value.integer;
+		}
+	}
+	else {
+		result.integer = wrap((uint64_t)value.integer, to);
+	}
+	return result;
+}
+
+Value VM::execute(uint32_t function_index, const Value* arguments)
+{
+	ZoneScopedN("VM::execute");
+
+	VM_Data& vm_data = globals.vm_data;
+
+	if (memory::get_array_size(vm_data.registers) < nb_registers) {
+		memory::resize_array(vm_data.registers, nb_registers);
+	}
+	memory::reserve_array(vm_data.frames, max_call_depth);
+	memory::resize_array(vm_data.frames, 0);
+
+	const Function*	function = memory::get_array_element(vm_data.functions, function_index);
+	size_t			base = 0;
+	Value*			R = memory::get_array_data(vm_data.registers);
+	const Value*	K = memory::get_array_data(function->constants);
+	const uint32_t*	pc = memory::get_array_data(function->code);
+	uint32_t		instruction;
+
+	for (uint32_t i = 0; i < function->nb_arguments; i++) {
+		R[i] = arguments[i];
+	}
+
+#if defined(VM_USE_COMPUTED_GOTO)
+	// @Warning should follow the order of the Opcode enum
+	static void* dispatch_table[] = {
+		&&label_LOAD_CONSTANT,
+		&&label_MOVE,
+		&&label_ADD_I,
+		&&label_SUB_I,
+		&&label_MUL_I,
+		&&label_DIV_I,
+		&&label_REM_I,
+		&&label_NEG_I,
+		&&label_ADD_F,
+		&&label_SUB_F,
+		&&label_MUL_F,
+		&&label_DIV_F,
+		&&label_NEG_F,
+		&&label_CONVERT,
+		&&label_CALL,
+		&&label_RETURN,
+	};
+	static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) == (size_t)Opcode::COUNT, "The dispatch table is out of sync with the Opcode enum");
+#else
+	for (;;)
+#endif
+	{
+		VM_DISPATCH()
+		{
+			VM_CASE(LOAD_CONSTANT)
+				R[get_a(instruction)] = K[get_bx(instruction)];
+				VM_NEXT();
+			VM_CASE(MOVE)
+				R[get_a(instruction)] = R[get_b(instruction)];
+				VM_NEXT();
+
+			VM_CASE(ADD_I)
+				R[get_a(instruction)].integer = wrap((uint64_t)R[get_a(instruction)].integer + (uint64_t)R[get_b(instruction)].integer, get_type(instruction));
+				VM_NEXT();
+			VM_CASE(SUB_I)
+				R[get_a(instruction)].integer = wrap((uint64_t)R[get_a(instruction)].integer - (uint64_t)R[get_b(instruction)].integer, get_type(instruction));
+				VM_NEXT();
+			VM_CASE(MUL_I)
+				R[get_a(instruction)].integer = wrap((uint64_t)R[get_a(instruction)].integer * (uint64_t)R[get_b(instruction)].integer, get_type(instruction));
+				VM_NEXT();
+			VM_CASE(DIV_I)
+			{
+				int64_t		left = R[get_a(instruction)].integer;
+				int64_t		right = R[get_b(instruction)].integer;
+				Value_Type	type = get_type(instruction);
+
+				if (right == 0) {
+					report_error(Compiler_Error::error, function->declaration->name, "Division by zero during the compile-time execution of this function.");
+				}
+				if (is_unsigned(type)) {
+					R[get_a(instruction)].integer = (int64_t)((uint64_t)left / (uint64_t)right); // Operands are zero extended
+				}
+				else {
+					R[get_a(instruction)].integer = wrap((right == -1) ? 0 - (uint64_t)left : (uint64_t)(left / right), type); // INT64_MIN / -1 overflows
+				}
+				VM_NEXT();
+			}
+			VM_CASE(REM_I)
+			{
+				int64_t		left = R[get_a(instruction)].integer;
+				int64_t		right = R[get_b(instruction)].integer;
+				Value_Type	type = get_type(instruction);
+
+				if (right == 0) {
+					report_error(Compiler_Error::error, function->declaration->name, "Division by zero during the compile-time execution of this function.");
+				}
+				if (is_unsigned(type)) {
+					R[get_a(instruction)].integer = (int64_t)((uint64_t)left % (uint64_t)right);
+				}
+				else {
+					R[get_a(instruction)].integer = (right == -1) ? 0 : left % right;
+				}
+				VM_NEXT();
+			}
+			VM_CASE(NEG_I)
+				R[get_a(instruction)].integer = wrap(0 - (uint64_t)R[get_b(instruction)].integer, get_type(instruction));
+				VM_NEXT();
+
+			// f32 operands are exactly representable as floats, so the operation is done with floats
+			VM_CASE(ADD_F)
+				if (get_type(instruction) == Value_Type::F32)
+					R[get_a(instruction)].real = (float)R[get_a(instruction)].real + (float)R[get_b(instruction)].real;
+				else
+					R[get_a(instruction)].real = R[get_a(instruction)].real + R[get_b(instruction)].real;
+				VM_NEXT();
+			VM_CASE(SUB_F)
+				if (get_type(instruction) == Value_Type::F32)
+					R[get_a(instruction)].real = (float)R[get_a(instruction)].real - (float)R[get_b(instruction)].real;
+				else
+					R[get_a(instruction)].real = R[get_a(instruction)].real - R[get_b(instruction)].real;
+				VM_NEXT();
+			VM_CASE(MUL_F)
+				if (get_type(instruction) == Value_Type::F32)
+					R[get_a(instruction)].real = (float)R[get_a(instruction)].real * (float)R[get_b(instruction)].real;
+				else
+					R[get_a(instruction)].real = R[get_a(instruction)].real * R[get_b(instruction)].real;
+				VM_NEXT();
+			VM_CASE(DIV_F)
+				if (get_type(instruction) == Value_Type::F32)
+					R[get_a(instruction)].real = (float)R[get_a(instruction)].real / (float)R[get_b(instruction)].real;
+				else
+					R[get_a(instruction)].real = R[get_a(instruction)].real / R[get_b(instruction)].real;
+				VM_NEXT();
+			VM_CASE(NEG_F)
+				R[get_a(instruction)].real = -R[get_b(instruction)].real;
+				VM_NEXT();
+
+			VM_CASE(CONVERT)
+				R[get_a(instruction)] = convert(R[get_a(instruction)], (Value_Type)get_b(instruction), (Value_Type)get_c(instruction));
+				VM_NEXT();
+
+			VM_CASE(CALL)
+			{
+				if (memory::get_array_size(vm_data.frames) >= max_call_depth) {
+					report_error(Compiler_Error::error, function->declaration->name, "Too many recursive calls during the compile-time execution of this function.");
+				}
+
+				VM_Frame frame;
+				frame.function_index = function_index;
+				frame.return_address = pc;
+				frame.base = base;
+				memory::array_push_back(vm_data.frames, frame); // Doesn't reallocate, the array is reserved
+
+				function_index = get_bx(instruction);
+				function = memory::get_array_element(vm_data.functions, function_index);
+				base += get_a(instruction);
+
+				if (base + function->nb_registers > nb_registers) {
+					report_error(Compiler_Error::error, function->declaration->name, "Stack overflow during the compile-time execution of this function.");
+				}
+
+				R = memory::get_array_element(vm_data.registers, base);
+				K = memory::get_array_data(function->constants);
+				pc = memory::get_array_data(function->code);
+				VM_NEXT();
+			}
+			VM_CASE(RETURN)
+			{
+				Value result = R[get_a(instruction)];
+
+				if (memory::is_array_empty(vm_data.frames)) {
+					return result;
+				}
+
+				R[0] = result; // The first register of the callee is the base register of the CALL
+
+				VM_Frame* frame = memory::get_array_last_element(vm_data.frames);
+				function_index = frame->function_index;
+				function = memory::get_array_element(vm_data.functions, function_index);
+				pc = frame->return_address;
+				base = frame->base;
+				memory::resize_array(vm_data.frames, memory::get_array_size(vm_data.frames) - 1);
+
+				R = memory::get_array_element(vm_data.registers, base);
+				K = memory::get_array_data(function->constants);
+				VM_NEXT();
+			}
+
+#if !defined(VM_USE_COMPUTED_GOTO)
+			default:
+				core::Assert(false);
+				return Value();
+#endif
+		}
+	}
+}
+
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_NEXT
+
+static Value get_literal_value(const Token<Keyword>& token, Value_Type type)
+{
+	Value		value;
+	Value_Type	literal_type;
+
+	switch (token.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+		value.integer = token.value.integer;
+		literal_type = Value_Type::I32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_I64:
+		value.integer = token.value.integer;
+		literal_type = Value_Type::I64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+		value.integer = (int64_t)token.value.unsigned_integer;
+		literal_type = Value_Type::UI32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI64:
+		value.integer = (int64_t)token.value.unsigned_integer;
+		literal_type = Value_Type::UI64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F32:
+		value.real = token.value.real_32;
+		literal_type = Value_Type::F32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F64:
+		value.real = token.value.real_64;
+		literal_type = Value_Type::F64;
+		break;
+	default:
+		value.real = (double)token.value.real_max;
+		literal_type = Value_Type::F64;
+		break;
+	}
+	return convert(value, literal_type, type);
+}
+
+void VM::execute_run_directive(AST_Directive_Run* run_node, Token<Keyword>& result)
+{
+	ZoneScopedN("VM::execute_run_directive");
+
+	AST_Function_Call*		function_call_node = run_node->function_call;
+	AST_Statement_Function*	function_node = get_function(function_call_node);
+	uint32_t				function_index = get_function(function_node);
+	const Function&			function = globals.vm_data.functions[function_index];
+
+	if ((uint32_t)function_call_node->nb_arguments != function.nb_arguments) {
+		report_error(Compiler_Error::error, function_call_node->name, "Wrong number of arguments.");
+	}
+	if (function.return_type == Value_Type::VOID) {
+		report_error(Compiler_Error::error, run_node->token, "#run can only be used on a function that returns a value.");
+	}
+
+	// @TODO support arguments that aren't constants (by generating a function that wrap the call)
+	Value		arguments[256];
+	uint32_t	argument_index = 0;
+
+	for (AST_Node** parameter = &function_call_node->parameters; *parameter; parameter = &(*parameter)->sibling, argument_index++)
+	{
+		if (fold_constant_expression(parameter) == false
+			|| (*parameter)->ast_type != Node_Type::STATEMENT_LITERAL
+			|| ((AST_Literal*)*parameter)->value.type < Token_Type::NUMERIC_LITERAL_I32
+			|| ((AST_Literal*)*parameter)->value.type > Token_Type::NUMERIC_LITERAL_REAL) {
+			report_error(Compiler_Error::error, run_node->token, "Arguments of #run should be numeric constants.");
+		}
+
+		arguments[argument_index] = get_literal_value(((AST_Literal*)*parameter)->value, function.argument_types[argument_index]);
+	}
+
+	Value value = execute(function_index, arguments);
+
+	// The result is converted to a literal of the return type of the function, it is already wrapped to its width
+	result = run_node->token;
+	switch (function.return_type)
+	{
+	case Value_Type::I8:
+	case Value_Type::I16:
+	case Value_Type::I32:
+		result.type = Token_Type::NUMERIC_LITERAL_I32;
+		result.value.integer = value.integer;
+		break;
+	case Value_Type::I64:
+		result.type = Token_Type::NUMERIC_LITERAL_I64;
+		result.value.integer = value.integer;
+		break;
+	case Value_Type::UI8:
+	case Value_Type::UI16:
+	case Value_Type::UI32:
+		result.type = Token_Type::NUMERIC_LITERAL_UI32;
+		result.value.unsigned_integer = (uint64_t)value.integer;
+		break;
+	case Value_Type::UI64:
+		result.type = Token_Type::NUMERIC_LITERAL_UI64;
+		result.value.unsigned_integer = (uint64_t)value.integer;
+		break;
+	case Value_Type::F32:
+		result.type = Token_Type::NUMERIC_LITERAL_F32;
+		result.value.real_32 = (float)value.real;
+		break;
+	case Value_Type::F64:
+		result.type = Token_Type::NUMERIC_LITERAL_F64;
+		result.value.real_64 = value.real;
+		break;
+	default:
+		report_error(Compiler_Error::internal_error, run_node->token, "The return type of this function isn't supported by #run.");
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// Virtual machine used to execute f-lang functions at compile time (#run directive).
+//
+// The bytecode is register-based, every instruction is encoded on 32 bits:
+//   | opcode (8 bits) | A (8 bits) | B (8 bits) | C (8 bits) |
+//   | opcode (8 bits) | A (8 bits) | Bx (16 bits)           |
+// A is always the destination register, registers are relative to the frame of the function
+// and the arguments of a function are its first registers.
+//
+// Values are 64 bits slots, arithmetic instructions carry the type of their operands in C (a Value_Type).
+// Integers are kept sign or zero extended from their width, so results are wrapped to the width of their type
+// after each operation. f32 values are stored as doubles but they are computed with floats.
+
+#include "../lexer/lexer.hpp"
+
+#include <fstd/memory/array.hpp>
+
+namespace f
+{
+	struct AST_Statement_Function;
+	struct AST_Directive_Run;
+
+	namespace VM
+	{
+		enum class Opcode : uint8_t
+		{
+			// @Warning the dispatch table of the interpreter rely on this order
+			LOAD_CONSTANT,	// A Bx		R[A] = K[Bx]
+			MOVE,			// A B		R[A] = R[B]
+
+			ADD_I,			// A B T	R[A] = R[A] + R[B], computed with the type T
+			SUB_I,
+			MUL_I,
+			DIV_I,			// Signed or unsigned depending on T
+			REM_I,
+			NEG_I,			// A B T	R[A] = -R[B]
+
+			ADD_F,
+			SUB_F,
+			MUL_F,
+			DIV_F,
+			NEG_F,
+
+			CONVERT,		// A B C	R[A] = R[A] converted from the type B to the type C
+
+			CALL,			// A Bx		Call the function Bx with arguments in R[A]...R[A + n - 1], the result is written in R[A]
+			RETURN,			// A		Return R[A]
+
+			COUNT
+		};
+
+		union Value
+		{
+			int64_t	integer;
+			double	real;
+		};
+
+		enum class Value_Type : uint8_t
+		{
+			VOID,
+			I8,
+			I16,
+			I32,
+			I64,
+			UI8,	// Also bool
+			UI16,
+			UI32,
+			UI64,
+			F32,
+			F64,
+		};
+
+		inline bool is_real(Value_Type type)		{ return type == Value_Type::F32 || type == Value_Type::F64; }
+		inline bool is_unsigned(Value_Type type)	{ return type >= Value_Type::UI8 && type <= Value_Type::UI64; }
+
+		// In bytes, 0 for void
+		inline uint32_t get_size(Value_Type type) {
+			static const uint8_t sizes[] = { 0, 1, 2, 4, 8, 1, 2, 4, 8, 4, 8 };
+			return sizes[(size_t)type];
+		}
+
+		struct Function
+		{
+			AST_Statement_Function*			declaration;
+			fstd::memory::Array<uint32_t>	code;
+			fstd::memory::Array<Value>		constants;
+			uint32_t						nb_registers;
+			uint32_t						nb_arguments;
+			Value_Type						return_type;
+			fstd::memory::Array<Value_Type>	argument_types;
+		};
+
+		inline uint32_t encode(Opcode opcode, uint8_t a, uint8_t b = 0, uint8_t c = 0) {
+			return (uint32_t)opcode | ((uint32_t)a << 8) | ((uint32_t)b << 16) | ((uint32_t)c << 24);
+		}
+
+		inline uint32_t encode_bx(Opcode opcode, uint8_t a, uint16_t bx) {
+			return (uint32_t)opcode | ((uint32_t)a << 8) | ((uint32_t)bx << 16);
+		}
+
+		inline Opcode get_opcode(uint32_t instruction)	{ return (Opcode)(instruction & 0xff); }
+		inline uint8_t get_a(uint32_t instruction)		{ return (uint8_t)(instruction >> 8); }
+		inline uint8_t get_b(uint32_t instruction)		{ return (uint8_t)(instruction >> 16); }
+		inline uint8_t get_c(uint32_t instruction)		{ return (uint8_t)(instruction >> 24); }
+		inline uint16_t get_bx(uint32_t instruction)	{ return (uint16_t)(instruction >> 16); }
+		inline Value_Type get_type(uint32_t instruction)	{ return (Value_Type)(instruction >> 24); }
+
+		// Generate the bytecode of the function (and functions it calls) on the first request, return the index of the function.
+		uint32_t	get_function(AST_Statement_Function* function_node);
+		Value		execute(uint32_t function_index, const Value* arguments);
+
+		// Execute the function called by the directive, and write its result as a literal in the result token.
+		void		execute_run_directive(AST_Directive_Run* run_node, Token<Keyword>& result);
+	}
+
+	struct VM_Frame
+	{
+		uint32_t		function_index;
+		const uint32_t*	return_address;
+		size_t			base;
+	};
+
+	struct VM_Data
+	{
+		fstd::memory::Array<VM::Function>	functions;
+		fstd::memory::Array<VM::Value>		registers;
+		fstd::memory::Array<VM_Frame>		frames;
+	};
+}
@@ -0,0 +1,476 @@
+#include "VM.hpp"
+
+#include "globals.hpp"
+
+#include "parser/parser.hpp"
+#include "parser/symbol_solver.hpp"
+#include "parser/constant_folder.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// The bytecode is generated directly from the AST, only the subset of the language that can't have side effects
+// on the compiler is supported (numeric types, local variables, constants and calls).
+//
+// Registers are allocated like a stack: locals stay alive until the end of their scope and temporaries are freed
+// just after the expression that use them. So when a CALL is emitted all registers after its base register are free
+// and can be used by the frame of the callee.
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::VM;
+
+static const uint32_t max_nb_registers = 255;
+static const uint32_t max_nb_constants = 0xffff;
+
+struct Bytecode_Local
+{
+	AST_Statement_Variable*	variable;
+	uint8_t					register_index;
+	Value_Type				type;
+};
+
+struct Bytecode_Generator
+{
+	AST_Statement_Function*		function_node;
+	Function					function;
+	memory::Array<Bytecode_Local>	locals;
+	uint32_t					nb_used_registers;
+};
+
+static Value_Type generate_expression(Bytecode_Generator& generator, AST_Node* node, uint8_t target_register);
+
+static uint8_t allocate_register(Bytecode_Generator& generator)
+{
+	if (generator.nb_used_registers >= max_nb_registers) {
+		report_error(Compiler_Error::internal_error, generator.function_node->name, "This function uses too many registers to be executed at compile time.");
+	}
+
+	uint8_t register_index = (uint8_t)generator.nb_used_registers++;
+	if (generator.nb_used_registers > generator.function.nb_registers) {
+		generator.function.nb_registers = generator.nb_used_registers;
+	}
+	return register_index;
+}
+
+static void emit(Bytecode_Generator& generator, uint32_t instruction)
+{
+	memory::array_push_back(generator.function.code, instruction);
+}
+
+static uint16_t add_constant(Bytecode_Generator& generator, Value value)
+{
+	// @SpeedUp linear search, but functions executed at compile time are generally small
+	// Values are compared bitwise to not merge 0.0 and -0.0
+	for (size_t i = 0; i < memory::get_array_size(generator.function.constants); i++) {
+		if (generator.function.constants[i].integer == value.integer) {
+			return (uint16_t)i;
+		}
+	}
+
+	if (memory::get_array_size(generator.function.constants) >= max_nb_constants) {
+		report_error(Compiler_Error::internal_error, generator.function_node->name, "This function uses too many constants to be executed at compile time.");
+	}
+
+	memory::array_push_back(generator.function.constants, value);
+	return (uint16_t)(memory::get_array_size(generator.function.constants) - 1);
+}
+
+static Value_Type get_value_type(AST_Node* type_node, const Token<Keyword>& token)
+{
+	if (type_node == nullptr) {
+		return Value_Type::VOID;
+	}
+
+	if (type_node->ast_type == Node_Type::STATEMENT_BASIC_TYPE || type_node->ast_type == Node_Type::USER_TYPE_IDENTIFIER) {
+		AST_Node* resolved_type = resolve_type(type_node);
+
+		if (resolved_type->ast_type == Node_Type::STATEMENT_BASIC_TYPE) {
+			Keyword keyword = ((AST_Statement_Basic_Type*)resolved_type)->keyword;
+
+			switch (keyword)
+			{
+			case Keyword::VOID:	return Value_Type::VOID;
+			case Keyword::I8:	return Value_Type::I8;
+			case Keyword::I16:	return Value_Type::I16;
+			case Keyword::I32:	return Value_Type::I32;
+			case Keyword::I64:	return Value_Type::I64;
+			case Keyword::BOOL:
+			case Keyword::UI8:	return Value_Type::UI8;
+			case Keyword::UI16:	return Value_Type::UI16;
+			case Keyword::UI32:	return Value_Type::UI32;
+			case Keyword::UI64:	return Value_Type::UI64;
+			case Keyword::F32:	return Value_Type::F32;
+			case Keyword::F64:	return Value_Type::F64;
+			default:			break;
+			}
+		}
+	}
+
+	report_error(Compiler_Error::error, token, "Only numeric types are supported by the compile-time execution.");
+	return Value_Type::VOID;
+}
+
+static void convert(Bytecode_Generator& generator, uint8_t register_index, Value_Type from, Value_Type to, const Token<Keyword>& token)
+{
+	if (from == to) {
+		return;
+	}
+
+	if (from == Value_Type::VOID || to == Value_Type::VOID) {
+		report_error(Compiler_Error::error, token, "A function without return value can't be used in an expression.");
+	}
+	emit(generator, encode(Opcode::CONVERT, register_index, (uint8_t)from, (uint8_t)to));
+}
+
+// Same rules as the IR generator: an integer takes the real type of the other operand, else the largest type, and
+// unsigned for the same size
+static Value_Type get_common_type(Value_Type a, Value_Type b)
+{
+	if (is_real(a) || is_real(b)) {
+		return (a == Value_Type::F64 || b == Value_Type::F64) ? Value_Type::F64 : Value_Type::F32;
+	}
+
+	if (get_size(a) != get_size(b)) {
+		return get_size(a) > get_size(b) ? a : b;
+	}
+	return is_unsigned(a) ? a : b;
+}
+
+static Bytecode_Local* find_local(Bytecode_Generator& generator, AST_Statement_Variable* variable)
+{
+	for (size_t i = 0; i < memory::get_array_size(generator.locals); i++) {
+		if (generator.locals[i].variable == variable) {
+			return memory::get_array_element(generator.locals, i);
+		}
+	}
+	return nullptr;
+}
+
+static Value_Type generate_literal(Bytecode_Generator& generator, AST_Literal* literal_node, uint8_t target_register)
+{
+	const Token<Keyword>& token = literal_node->value;
+	Value		value;
+	Value_Type	type;
+
+	switch (token.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+		value.integer = token.value.integer;
+		type = Value_Type::I32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_I64:
+		value.integer = token.value.integer;
+		type = Value_Type::I64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+		value.integer = (int64_t)token.value.unsigned_integer;
+		type = Value_Type::UI32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI64:
+		value.integer = (int64_t)token.value.unsigned_integer;
+		type = Value_Type::UI64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F32:
+		value.real = token.value.real_32;
+		type = Value_Type::F32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F64:
+		value.real = token.value.real_64;
+		type = Value_Type::F64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_REAL:
+		value.real = (double)token.value.real_max;
+		type = Value_Type::F64;
+		break;
+	default:
+		report_error(Compiler_Error::error, token, "Only numeric literals are supported by the compile-time execution.");
+		return Value_Type::VOID;
+	}
+
+	emit(generator, encode_bx(Opcode::LOAD_CONSTANT, target_register, add_constant(generator, value)));
+	return type;
+}
+
+static Value_Type generate_identifier(Bytecode_Generator& generator, AST_Identifier* identifier_node, uint8_t target_register)
+{
+	AST_Statement_Variable* variable_node = get_variable(identifier_node);
+	Bytecode_Local* local = find_local(generator, variable_node);
+
+	if (local) {
+		if (local->register_index != target_register) {
+			emit(generator, encode(Opcode::MOVE, target_register, local->register_index));
+		}
+		return local->type;
+	}
+
+	// Variables declared outside of the function are only usable if they are constants
+	if (variable_node->is_function_parameter == false
+		&& fold_constant_expression(&variable_node->expression)
+		&& variable_node->expression->ast_type == Node_Type::STATEMENT_LITERAL) {
+		Value_Type expression_type = generate_expression(generator, variable_node->expression, target_register);
+		Value_Type variable_type = variable_node->type ? get_value_type(variable_node->type, variable_node->name) : expression_type;
+
+		convert(generator, target_register, expression_type, variable_type, identifier_node->value);
+		return variable_type;
+	}
+
+	report_error(Compiler_Error::error, identifier_node->value, "Only local variables and constants can be used by a function executed at compile time.");
+	return Value_Type::VOID;
+}
+
+static Value_Type generate_call(Bytecode_Generator& generator, AST_Function_Call* function_call_node, uint8_t target_register)
+{
+	AST_Statement_Function*	callee_node = get_function(function_call_node);
+	uint32_t				callee_index = get_function(callee_node); // Can be the function currently generated
+
+	// @Warning the callee is accessed by index, as generating the bytecode of arguments can reallocate the function array
+	uint32_t	nb_arguments = globals.vm_data.functions[callee_index].nb_arguments;
+	Value_Type	return_type = globals.vm_data.functions[callee_index].return_type;
+
+	if ((uint32_t)function_call_node->nb_arguments != nb_arguments) {
+		report_error(Compiler_Error::error, function_call_node->name, "Wrong number of arguments.");
+	}
+
+	uint32_t	nb_used_registers = generator.nb_used_registers;
+	uint8_t		base_register = allocate_register(generator); // Also receive the result
+	uint32_t	argument_index = 0;
+
+	for (AST_Node* parameter = function_call_node->parameters; parameter; parameter = parameter->sibling, argument_index++)
+	{
+		uint8_t argument_register = argument_index == 0 ? base_register : allocate_register(generator);
+
+		Value_Type type = generate_expression(generator, parameter, argument_register);
+		convert(generator, argument_register, type, globals.vm_data.functions[callee_index].argument_types[argument_index], function_call_node->name);
+		generator.nb_used_registers = argument_register + 1; // Free temporaries of the argument, arguments have to be consecutive
+	}
+
+	emit(generator, encode_bx(Opcode::CALL, base_register, (uint16_t)callee_index));
+	if (base_register != target_register) {
+		emit(generator, encode(Opcode::MOVE, target_register, base_register));
+	}
+
+	generator.nb_used_registers = nb_used_registers;
+	return return_type;
+}
+
+static Value_Type generate_expression(Bytecode_Generator& generator, AST_Node* node, uint8_t target_register)
+{
+	if (node->ast_type == Node_Type::STATEMENT_LITERAL) {
+		return generate_literal(generator, (AST_Literal*)node, target_register);
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_IDENTIFIER) {
+		return generate_identifier(generator, (AST_Identifier*)node, target_register);
+	}
+	else if (node->ast_type == Node_Type::UNARY_OPERATOR_NEGATIVE) {
+		Value_Type type = generate_expression(generator, ((AST_Unary_operator*)node)->right, target_register);
+
+		if (type == Value_Type::VOID) {
+			report_error(Compiler_Error::error, generator.function_node->name, "A function without return value can't be used in an expression.");
+		}
+		emit(generator, encode(is_real(type) ? Opcode::NEG_F : Opcode::NEG_I, target_register, target_register, (uint8_t)type));
+		return type;
+	}
+	else if (is_binary_operator(node) && node->ast_type != Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
+		AST_Binary_Operator*	binary_operator_node = (AST_Binary_Operator*)node;
+		uint32_t				nb_used_registers = generator.nb_used_registers;
+
+		Value_Type	left_type = generate_expression(generator, binary_operator_node->left, target_register);
+		uint8_t		right_register = allocate_register(generator);
+		Value_Type	right_type = generate_expression(generator, binary_operator_node->right, right_register);
+		Value_Type	type = get_common_type(left_type, right_type);
+
+		convert(generator, target_register, left_type, type, binary_operator_node->token);
+		convert(generator, right_register, right_type, type, binary_operator_node->token);
+
+		Opcode opcode;
+		switch (node->ast_type)
+		{
+		case Node_Type::BINARY_OPERATOR_ADDITION:
+			opcode = is_real(type) ? Opcode::ADD_F : Opcode::ADD_I;
+			break;
+		case Node_Type::BINARY_OPERATOR_SUBSTRACTION:
+			opcode = is_real(type) ? Opcode::SUB_F : Opcode::SUB_I;
+			break;
+		case Node_Type::BINARY_OPERATOR_MULTIPLICATION:
+			opcode = is_real(type) ? Opcode::MUL_F : Opcode::MUL_I;
+			break;
+		case Node_Type::BINARY_OPERATOR_DIVISION:
+			opcode = is_real(type) ? Opcode::DIV_F : Opcode::DIV_I;
+			break;
+		case Node_Type::BINARY_OPERATOR_REMINDER:
+			if (is_real(type)) {
+				report_error(Compiler_Error::error, binary_operator_node->token, "The operator '%' can't be used with floating point values.");
+			}
+			opcode = Opcode::REM_I;
+			break;
+		default:
+			core::Assert(false);
+			opcode = Opcode::COUNT;
+		}
+
+		emit(generator, encode(opcode, target_register, right_register, (uint8_t)type));
+		generator.nb_used_registers = nb_used_registers;
+		return type;
+	}
+	else if (node->ast_type == Node_Type::FUNCTION_CALL) {
+		return generate_call(generator, (AST_Function_Call*)node, target_register);
+	}
+	else if (node->ast_type == Node_Type::DIRECTIVE_RUN) {
+		// Nested #run are simply calls, the whole function is already executed at compile time
+		return generate_call(generator, ((AST_Directive_Run*)node)->function_call, target_register);
+	}
+
+	report_error(Compiler_Error::error, generator.function_node->name, "This function uses an expression that can't be executed at compile time.");
+	return Value_Type::VOID;
+}
+
+static void generate_statements(Bytecode_Generator& generator, AST_Node* node)
+{
+	for (AST_Node* current_node = node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_VARIABLE) {
+			AST_Statement_Variable* variable_node = (AST_Statement_Variable*)current_node;
+
+			Value_Type	type = get_value_type(variable_node->type, variable_node->name);
+			uint8_t		register_index = allocate_register(generator);
+
+			if (variable_node->expression) {
+				Value_Type expression_type = generate_expression(generator, variable_node->expression, register_index);
+				convert(generator, register_index, expression_type, type, variable_node->name);
+			}
+			else {
+				Value zero;
+				zero.integer = 0; // Also 0.0
+				emit(generator, encode_bx(Opcode::LOAD_CONSTANT, register_index, add_constant(generator, zero)));
+			}
+
+			// Registered after its expression, a variable can't be used in its own initialization
+			Bytecode_Local local;
+			local.variable = variable_node;
+			local.register_index = register_index;
+			local.type = type;
+			memory::array_push_back(generator.locals, local);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_RETURN) {
+			AST_Statement_Return* return_node = (AST_Statement_Return*)current_node;
+
+			if (return_node->expression) {
+				if (generator.function.return_type == Value_Type::VOID) {
+					report_error(Compiler_Error::error, return_node->token, "This function can't return a value.");
+				}
+
+				uint32_t	nb_used_registers = generator.nb_used_registers;
+				uint8_t		register_index = allocate_register(generator);
+				Value_Type	type = generate_expression(generator, return_node->expression, register_index);
+
+				convert(generator, register_index, type, generator.function.return_type, return_node->token);
+				emit(generator, encode(Opcode::RETURN, register_index));
+				generator.nb_used_registers = nb_used_registers;
+			}
+			else {
+				if (generator.function.return_type != Value_Type::VOID) {
+					report_error(Compiler_Error::error, return_node->token, "This function should return a value.");
+				}
+				emit(generator, encode(Opcode::RETURN, 0));
+			}
+		}
+		else if (current_node->ast_type == Node_Type::FUNCTION_CALL) {
+			uint32_t	nb_used_registers = generator.nb_used_registers;
+			uint8_t		register_index = allocate_register(generator);
+
+			generate_call(generator, (AST_Function_Call*)current_node, register_index);
+			generator.nb_used_registers = nb_used_registers;
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SCOPE) {
+			uint32_t	nb_used_registers = generator.nb_used_registers;
+			size_t		nb_locals = memory::get_array_size(generator.locals);
+
+			generate_statements(generator, ((AST_Statement_Scope*)current_node)->first_child);
+
+			generator.nb_used_registers = nb_used_registers;
+			memory::resize_array(generator.locals, nb_locals);
+		}
+		else {
+			report_error(Compiler_Error::error, generator.function_node->name, "This function uses a statement that can't be executed at compile time.");
+		}
+	}
+}
+
+uint32_t VM::get_function(AST_Statement_Function* function_node)
+{
+	ZoneScopedN("VM::get_function");
+
+	// @SpeedUp linear search
+	for (size_t i = 0; i < memory::get_array_size(globals.vm_data.functions); i++) {
+		if (globals.vm_data.functions[i].declaration == function_node) {
+			return (uint32_t)i;
+		}
+	}
+
+	if (function_node->scope == nullptr) {
+		report_error(Compiler_Error::error, function_node->name, "Imported functions can't be executed at compile time.");
+	}
+	if (function_node->nb_arguments > (int)max_nb_registers - 1) {
+		report_error(Compiler_Error::internal_error, function_node->name, "This function has too many arguments to be executed at compile time.");
+	}
+	if (memory::get_array_size(globals.vm_data.functions) > 0xffff) {
+		report_error(Compiler_Error::internal_error, function_node->name, "Too many functions are executed at compile time.");
+	}
+
+	// The function is registered with its signature before the generation of its body, so recursive calls can find it
+	Function function;
+
+	function.declaration = function_node;
+	memory::init(function.code);
+	memory::init(function.constants);
+	memory::init(function.argument_types);
+	function.nb_registers = 0;
+	function.nb_arguments = (uint32_t)function_node->nb_arguments;
+	function.return_type = get_value_type(function_node->return_type, function_node->name);
+
+	for (AST_Node* argument = (AST_Node*)function_node->arguments; argument; argument = argument->sibling) {
+		AST_Statement_Variable* argument_node = (AST_Statement_Variable*)argument;
+		memory::array_push_back(function.argument_types, get_value_type(argument_node->type, argument_node->name));
+	}
+
+	uint32_t function_index = (uint32_t)memory::get_array_size(globals.vm_data.functions);
+	memory::array_push_back(globals.vm_data.functions, function);
+
+	Bytecode_Generator generator;
+
+	generator.function_node = function_node;
+	generator.function = function;
+	generator.nb_used_registers = 0;
+	memory::init(generator.locals);
+
+	// Arguments are the first registers of the frame
+	uint32_t argument_index = 0;
+	for (AST_Node* argument = (AST_Node*)function_node->arguments; argument; argument = argument->sibling, argument_index++) {
+		Bytecode_Local local;
+		local.variable = (AST_Statement_Variable*)argument;
+		local.register_index = allocate_register(generator);
+		local.type = function.argument_types[argument_index];
+		memory::array_push_back(generator.locals, local);
+	}
+	if (generator.function.nb_registers == 0) {
+		generator.function.nb_registers = 1; // The first register receive the result
+	}
+
+	generate_statements(generator, function_node->scope->first_child);
+
+	// There is no control flow yet, so checking the last instruction is enough
+	size_t nb_instructions = memory::get_array_size(generator.function.code);
+	if (nb_instructions == 0 || get_opcode(generator.function.code[nb_instructions - 1]) != Opcode::RETURN) {
+		if (generator.function.return_type != Value_Type::VOID) {
+			report_error(Compiler_Error::error, function_node->name, "This function should end with a return statement to be executed at compile time.");
+		}
+		emit(generator, encode(Opcode::RETURN, 0));
+	}
+
+	globals.vm_data.functions[function_index] = generator.function;
+	memory::release(generator.locals);
+	return function_index;
+}
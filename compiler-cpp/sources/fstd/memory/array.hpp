@@ -6,6 +6,20 @@
 
 #include <tracy/Tracy.hpp>
 
+// Appending functions (array_push_back, array_append, array_emplace_back and array_copy) grow the reserved size
+// geometrically, so appending n elements does O(log(n)) reallocations instead of n. The growth factor is in percent
+// of the reserved size, 200 doubles it, 150 wastes less memory but reallocates more often.
+// reserve_array and resize_array still allocate exactly what they are asked for.
+#if !defined(FSTD_ARRAY_GROWTH_FACTOR)
+#	define FSTD_ARRAY_GROWTH_FACTOR	200
+#endif
+
+#if !defined(FSTD_ARRAY_MIN_RESERVED)
+#	define FSTD_ARRAY_MIN_RESERVED	8	// In elements, for the first allocation
+#endif
+
+static_assert(FSTD_ARRAY_GROWTH_FACTOR > 100, "FSTD_ARRAY_GROWTH_FACTOR should be greater than 100 percent.");
+
 namespace fstd
 {
 	namespace memory
@@ -65,6 +79,20 @@ namespace fstd
 			}
 		}
 
+		// Reserve at least size elements, with the growth factor to amortize reallocations of appends
+		template<typename Type>
+		void grow_array(Array<Type>& array, size_t size)
+		{
+			if (array.reserved < size) {
+				size_t reserved = array.reserved * FSTD_ARRAY_GROWTH_FACTOR / 100;
+
+				if (reserved < FSTD_ARRAY_MIN_RESERVED) {
+					reserved = FSTD_ARRAY_MIN_RESERVED;
+				}
+				reserve_array(array, reserved < size ? size : reserved);
+			}
+		}
+
 		template<typename Type>
 		void release(Array<Type>& array)
 		{
@@ -99,17 +127,71 @@ namespace fstd
 		{
 			ZoneScopedN("array_push_back");
 
-			reserve_array(array, array.size + 1);
+			grow_array(array, array.size + 1);
 			array.ptr[array.size] = value;
 			array.size++;
 		}
 
+		// For preallocated buffers that shouldn't move, the caller already checked the reserved size
+		template<typename Type>
+		void array_push_back_unchecked(Array<Type>& array, Type value)
+		{
+			fstd::core::Assert(array.size < array.reserved);
+
+			array.ptr[array.size] = value;
+			array.size++;
+		}
+
+		// Append nb_elements uninitialized elements and return the first one, to build them in place instead of copying them
+		template<typename Type>
+		Type* array_emplace_back(Array<Type>& array, size_t nb_elements = 1)
+		{
+			ZoneScopedN("array_emplace_back");
+
+			grow_array(array, array.size + nb_elements);
+			array.size += nb_elements;
+			return &array.ptr[array.size - nb_elements];
+		}
+
+		template<typename Type>
+		Type* array_emplace_back_unchecked(Array<Type>& array, size_t nb_elements = 1)
+		{
+			fstd::core::Assert(array.size + nb_elements <= array.reserved);
+
+			array.size += nb_elements;
+			return &array.ptr[array.size - nb_elements];
+		}
+
+		// raw_array can point in the array, it is found again after the reallocation
+		template<typename Type>
+		void array_append(Array<Type>& array, const Type* raw_array, size_t size)
+		{
+			ZoneScopedN("array_append");
+
+			bool	is_in_array = array.ptr && raw_array >= array.ptr && raw_array < array.ptr + array.size;
+			size_t	offset = is_in_array ? raw_array - array.ptr : 0;
+
+			grow_array(array, array.size + size);
+			if (is_in_array) {
+				raw_array = &array.ptr[offset];
+			}
+			system::memory_copy(&array.ptr[array.size], raw_array, size * sizeof(Type));
+			array.size += size;
+		}
+
+		template<typename Type>
+		void array_append(Array<Type>& array, const Array<Type>& source)
+		{
+			array_append(array, source.ptr, source.size);
+		}
+
 		template<typename Type>
 		void array_copy(Array<Type>& array, size_t index, const Type* raw_array, size_t size)
 		{
 			ZoneScopedN("array_copy");
 
-			resize_array(array, index + size);
+			grow_array(array, index + size);
+			array.size = index + size;
 			system::memory_copy(&array.ptr[index], raw_array, size * sizeof(Type));
 		}
 
@@ -118,7 +200,8 @@ namespace fstd
 		{
 			ZoneScopedN("array_copy");
 
-			resize_array(array, index + source.size);
+			grow_array(array, index + source.size);
+			array.size = index + source.size;
 			system::memory_copy(&array.ptr[index], source.ptr, source.size * sizeof(Type));
 		}
 
@@ -0,0 +1,145 @@
+#include "thread.hpp"
+
+#include <fstd/system/allocator.hpp>
+
+#include <fstd/core/assert.hpp>
+
+#if defined(FSTD_OS_WINDOWS)
+#	include <win32/threads.h>
+#	include <win32/sysinfo.h> // GetSystemInfo
+#	include <win32/io.h> // CloseHandle
+#endif
+
+#include <tracy/Tracy.hpp>
+
+namespace fstd
+{
+	namespace system
+	{
+		struct Thread_Startup
+		{
+			Thread_Procedure	procedure;
+			void*				parameter;
+		};
+
+#if defined(FSTD_OS_WINDOWS)
+		static_assert(sizeof(SRWLOCK) == sizeof(Mutex), "Mutex should be able to hold a SRWLOCK");
+		static_assert(sizeof(CONDITION_VARIABLE) == sizeof(Condition_Variable), "Condition_Variable should be able to hold a CONDITION_VARIABLE");
+
+		static DWORD WINAPI thread_entry_point(LPVOID parameter)
+		{
+			Thread_Startup startup = *(Thread_Startup*)parameter;
+
+			free(parameter);
+			startup.procedure(startup.parameter);
+			return 0;
+		}
+#endif
+
+		void create_thread(Thread& thread, Thread_Procedure procedure, void* parameter)
+		{
+			ZoneScopedN("create_thread");
+
+			// The startup data is freed by the new thread
+			Thread_Startup* startup = (Thread_Startup*)allocate(sizeof(Thread_Startup));
+
+			startup->procedure = procedure;
+			startup->parameter = parameter;
+
+#if defined(FSTD_OS_WINDOWS)
+			thread.handle = CreateThread(nullptr, 0, &thread_entry_point, startup, 0, nullptr);
+			core::Assert(thread.handle != nullptr);
+#else
+#	error
+#endif
+		}
+
+		void join_thread(Thread& thread)
+		{
+			ZoneScopedN("join_thread");
+
+#if defined(FSTD_OS_WINDOWS)
+			WaitForSingleObject(thread.handle, INFINITE);
+			CloseHandle(thread.handle);
+#else
+#	error
+#endif
+			thread.handle = nullptr;
+		}
+
+		uint32_t get_nb_hardware_threads()
+		{
+#if defined(FSTD_OS_WINDOWS)
+			SYSTEM_INFO system_info;
+
+			GetSystemInfo(&system_info);
+			return (uint32_t)system_info.dwNumberOfProcessors;
+#else
+#	error
+#endif
+		}
+
+		void init(Mutex& mutex)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			InitializeSRWLock((PSRWLOCK)&mutex.lock);
+#else
+#	error
+#endif
+		}
+
+		void lock(Mutex& mutex)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			AcquireSRWLockExclusive((PSRWLOCK)&mutex.lock);
+#else
+#	error
+#endif
+		}
+
+		void unlock(Mutex& mutex)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			ReleaseSRWLockExclusive((PSRWLOCK)&mutex.lock);
+#else
+#	error
+#endif
+		}
+
+		void init(Condition_Variable& condition_variable)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			InitializeConditionVariable((PCONDITION_VARIABLE)&condition_variable.variable);
+#else
+#	error
+#endif
+		}
+
+		void wait(Condition_Variable& condition_variable, Mutex& mutex)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			SleepConditionVariableSRW((PCONDITION_VARIABLE)&condition_variable.variable, (PSRWLOCK)&mutex.lock, INFINITE, 0);
+#else
+#	error
+#endif
+		}
+
+		void wake_one(Condition_Variable& condition_variable)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			WakeConditionVariable((PCONDITION_VARIABLE)&condition_variable.variable);
+#else
+#	error
+#endif
+		}
+
+		void wake_all(Condition_Variable& condition_variable)
+		{
+#if defined(FSTD_OS_WINDOWS)
+			WakeAllConditionVariable((PCONDITION_VARIABLE)&condition_variable.variable);
+#else
+#	error
+#endif
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <fstd/platform.hpp>
+#include <fstd/language/types.hpp>
+
+// Minimal threading primitives, only what the compiler needs to load modules in parallel.
+//
+// Mutex and Condition_Variable are thin wrappers over SRWLOCK and CONDITION_VARIABLE on Windows, they
+// are pointer-sized, zero initialized and don't need to be released.
+
+namespace fstd
+{
+	namespace system
+	{
+		typedef void (*Thread_Procedure)(void* parameter);
+
+		struct Thread
+		{
+			void*	handle = nullptr;
+		};
+
+		struct Mutex
+		{
+			void*	lock = nullptr;
+		};
+
+		struct Condition_Variable
+		{
+			void*	variable = nullptr;
+		};
+
+		void		create_thread(Thread& thread, Thread_Procedure procedure, void* parameter);
+		void		join_thread(Thread& thread);	// Wait the end of the thread and release it
+		uint32_t	get_nb_hardware_threads();
+
+		void		init(Mutex& mutex);
+		void		lock(Mutex& mutex);
+		void		unlock(Mutex& mutex);
+
+		void		init(Condition_Variable& condition_variable);
+		void		wait(Condition_Variable& condition_variable, Mutex& mutex);	// The mutex should be locked, it is locked again when the function returns
+		void		wake_one(Condition_Variable& condition_variable);
+		void		wake_all(Condition_Variable& condition_variable);
+	}
+}
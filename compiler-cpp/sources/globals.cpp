@@ -23,6 +23,12 @@ void initialize_globals()
 	globals.logger = new fstd::core::Logger();
 }
 
+void release_globals()
+{
+	delete globals.logger;
+	globals.logger = nullptr;
+}
+
 void report_error(Compiler_Error error, const char* error_message)
 {
 	core::String_Builder	string_builder;
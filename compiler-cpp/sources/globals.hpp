@@ -2,8 +2,11 @@
 
 #include "lexer/lexer.hpp"
 #include "parser/parser.hpp"
+#include "parser/type_table.hpp"
 #include "IR_generator.hpp"
 #include "PE_x64_backend.hpp"
+#include "VM/VM.hpp"
+#include "instruction_db_loader.hpp"
 
 #include "lexer/lexer_base.hpp"
 
@@ -21,7 +24,14 @@ namespace fstd
 
 struct Configuration
 {
-	bool	generate_debug_info = false;
+	bool		generate_debug_info = false;
+	bool		hoist_imported_function_addresses = false;	// -hoist-imports, calls of imported functions in loops use a register
+	bool		inline_functions = true;					// -no-inline disables the inliner, even for functions with the inline modifier
+	uint32_t	inline_budget = 32;							// -inline-budget=N, maximum number of instructions of an inlined function
+	uint32_t	inline_growth = 100;						// -inline-growth=N, maximum growth of a function by inlining, in percent
+	const char*	profile_generate = nullptr;					// -profile-generate=file, counters of blocks are written in the file when the program exits
+	const char*	profile_use = nullptr;						// -profile-use=file, counts of blocks drive the inliner and the layout of the code
+	bool		split_cold_code = true;						// -no-cold-splitting, cold blocks stay in the code of their function
 };
 
 struct Globals
@@ -30,11 +40,16 @@ struct Globals
 	Configuration						configuration;
 	fstd::memory::Array<f::Lexer_Data>	lexer_data;
 	f::Parser_Data						parser_data;
+	f::Type_Table_Data					type_table_data;
+	f::VM_Data							vm_data;
 	f::IR_Data							ir_data;
 	f::PE_X64_Backend_Data				x64_backend_data;
+	f::x86_DB::x86_DB_Data				x86_db_data;
 };
 
 void initialize_globals();
+// @Warning only release what the thread own alone, AST nodes allocated by the parser of a worker are still used after its end
+void release_globals();
 
 extern thread_local Globals    globals;
 
@@ -10,10 +10,13 @@
 #include <fstd/memory/array.hpp>
 #include <fstd/memory/hash_table.hpp>
 
+#include <fstd/system/allocator.hpp>
 #include <fstd/system/file.hpp>
 
 #include <fstd/language/defer.hpp>
 
+#include <tracy/Tracy.hpp>
+
 using namespace fstd;
 using namespace fstd::core;
 using namespace fstd::stream;
@@ -64,15 +67,25 @@ namespace f
             INSERT_KEYWORD("reg32", REG32);
             INSERT_KEYWORD("reg64", REG64);
             INSERT_KEYWORD("reg_al", REG_AL);
-            INSERT_KEYWORD("reg_ax", reg_ax);
-            INSERT_KEYWORD("reg_eax", reg_eax);
-            INSERT_KEYWORD("reg_rax", reg_rax);
-            INSERT_KEYWORD("reg_dx", reg_dx);
+            INSERT_KEYWORD("reg_ax", REG_AX);
+            INSERT_KEYWORD("reg_eax", REG_EAX);
+            INSERT_KEYWORD("reg_rax", REG_RAX);
+            INSERT_KEYWORD("reg_cl", REG_CL);
+            INSERT_KEYWORD("reg_ecx", REG_ECX);
+            INSERT_KEYWORD("reg_rcx", REG_RCX);
+            INSERT_KEYWORD("reg_dx", REG_DX);
+            INSERT_KEYWORD("reg_edx", REG_EDX);
+            INSERT_KEYWORD("rm8", RM8);
+            INSERT_KEYWORD("rm16", RM16);
+            INSERT_KEYWORD("rm32", RM32);
+            INSERT_KEYWORD("rm64", RM64);
             INSERT_KEYWORD("mem", MEM);
+            INSERT_KEYWORD("mem8", MEM8);
             INSERT_KEYWORD("mem16", MEM16);
             INSERT_KEYWORD("mem32", MEM32);
             INSERT_KEYWORD("mem64", MEM64);
-            INSERT_KEYWORD("mem80", mem80);
+            INSERT_KEYWORD("mem80", MEM80);
+            INSERT_KEYWORD("mem128", MEM128);
             INSERT_KEYWORD("imm", IMM);
             INSERT_KEYWORD("imm8", IMM8);
             INSERT_KEYWORD("imm16", IMM16);
@@ -81,18 +94,70 @@ namespace f
             INSERT_KEYWORD("sbyteword", SBYTEWORD);
             INSERT_KEYWORD("sbyteword16", SBYTEWORD16);
             INSERT_KEYWORD("sbyteword32", SBYTEWORD32);
-            INSERT_KEYWORD("fpureg", fpureg);
-            INSERT_KEYWORD("fpu0", fpu0);
+            INSERT_KEYWORD("sbytedword", SBYTEDWORD);
+            INSERT_KEYWORD("sbytedword32", SBYTEDWORD32);
+            INSERT_KEYWORD("sbytedword64", SBYTEDWORD64);
+            INSERT_KEYWORD("udword", UDWORD);
+            INSERT_KEYWORD("sdword", SDWORD);
+            INSERT_KEYWORD("unity", UNITY);
+            INSERT_KEYWORD("xmmreg", XMMREG);
+            INSERT_KEYWORD("xmmrm", XMMRM);
+            INSERT_KEYWORD("xmmrm32", XMMRM32);
+            INSERT_KEYWORD("xmmrm64", XMMRM64);
+            INSERT_KEYWORD("xmmrm128", XMMRM128);
+            INSERT_KEYWORD("xmm0", XMM0);
+            INSERT_KEYWORD("fpureg", FPUREG);
+            INSERT_KEYWORD("fpu0", FPU0);
 
             INSERT_KEYWORD("near", _NEAR);
             INSERT_KEYWORD("far", _FAR);
+            INSERT_KEYWORD("short", _SHORT);
             INSERT_KEYWORD("to", TO);
 
+            INSERT_KEYWORD("o16", O16);
+            INSERT_KEYWORD("o32", O32);
+            INSERT_KEYWORD("o64", O64);
+            INSERT_KEYWORD("o64nw", O64NW);
+            INSERT_KEYWORD("odf", ODF);
+            INSERT_KEYWORD("np", NP);
+            INSERT_KEYWORD("hle", HLE);
+            INSERT_KEYWORD("hlexr", HLEXR);
+            INSERT_KEYWORD("hlenl", HLENL);
+            INSERT_KEYWORD("norexb", NOREXB);
+            INSERT_KEYWORD("norexw", NOREXW);
+            INSERT_KEYWORD("nof3", NOF3);
+            INSERT_KEYWORD("norep", NOREP);
+            INSERT_KEYWORD("a64", A64);
+            INSERT_KEYWORD("adf", ADF);
+            INSERT_KEYWORD("f2i", F2I);
+            INSERT_KEYWORD("f3i", F3I);
+            INSERT_KEYWORD("ib", IB);
+            INSERT_KEYWORD("iw", IW);
+            INSERT_KEYWORD("id", ID);
+            INSERT_KEYWORD("iq", IQ);
+            INSERT_KEYWORD("rel", REL);
+            INSERT_KEYWORD("rel8", REL8);
+            INSERT_KEYWORD("s", SIGNED);
+            INSERT_KEYWORD("u", UNSIGNED);
+
             INSERT_KEYWORD("8086", ARCH_8086);
             INSERT_KEYWORD("386", ARCH_386);
             INSERT_KEYWORD("X64", ARCH_X64);
             INSERT_KEYWORD("NOLONG", ARCH_NOLONG);
+            INSERT_KEYWORD("IA64", ARCH_IA64);
+            INSERT_KEYWORD("UNDOC", ARCH_UNDOC);
+            INSERT_KEYWORD("OBSOLETE", ARCH_OBSOLETE);
             INSERT_KEYWORD("SM", ARCH_SM);
+            INSERT_KEYWORD("SM2", ARCH_SM2);
+            INSERT_KEYWORD("SB", ARCH_SB);
+            INSERT_KEYWORD("SW", ARCH_SW);
+            INSERT_KEYWORD("SD", ARCH_SD);
+            INSERT_KEYWORD("SQ", ARCH_SQ);
+            INSERT_KEYWORD("SO", ARCH_SO);
+            INSERT_KEYWORD("AR0", ARCH_AR0);
+            INSERT_KEYWORD("AR1", ARCH_AR1);
+            INSERT_KEYWORD("AR2", ARCH_AR2);
+            INSERT_KEYWORD("ANYSIZE", ARCH_ANYSIZE);
             INSERT_KEYWORD("LOCK", ARCH_LOCK);
             INSERT_KEYWORD("ND", ARCH_ND);
 
@@ -101,25 +166,6 @@ namespace f
 #endif
         }
 
-        static inline Instruction* allocate_instruction()
-        {
-            ZoneScopedN("allocate_instruction");
-
-            // Ensure that no reallocation could happen during the resize
-            bool overflow_preallocated_buffer = memory::get_array_size(globals.x86_db_data.instructions) >= memory::get_array_reserved(globals.x86_db_data.instructions) * sizeof(Instruction);
-
-            core::Assert(overflow_preallocated_buffer == false);
-            if (overflow_preallocated_buffer) {
-                report_error(Compiler_Error::internal_error, "The compiler did not allocate enough memory to store Instruction!");
-            }
-
-            // @TODO use a version that didn't check the array size, because we just did it and we don't want to trigger unplanned allocations
-            memory::resize_array(globals.x86_db_data.instructions, memory::get_array_size(globals.x86_db_data.instructions) + sizeof(Instruction));
-
-            Instruction* new_instruction = (Instruction*)(memory::get_array_last_element(globals.x86_db_data.instructions) - sizeof(Instruction));
-            return new_instruction;
-        }
-
         static void lex_instructions_DB()
         {
             ZoneScopedN("lex_instructions_DB");
@@ -151,7 +197,7 @@ namespace f
 
             defer{ close_file(instructions_file); };
 
-            fstd::memory::Array<uint8_t> instructions_buffer = system::get_file_content(instructions_file);
+            globals.x86_db_data.file_content = system::get_file_content(instructions_file);
 
             Array_Stream<uint8_t>   ins_stream;
             size_t	                nb_tokens_prediction = 0;
@@ -159,7 +205,7 @@ namespace f
             int					    current_line = 1;
             int					    current_column = 1;
 
-            stream::initialize_memory_stream<uint8_t>(ins_stream, instructions_buffer);
+            stream::initialize_memory_stream<uint8_t>(ins_stream, globals.x86_db_data.file_content);
 
             if (stream::is_eof(ins_stream) == true) {
                 return;
@@ -265,135 +311,541 @@ namespace f
             }
         }
 
-        static void parse_instructions_DB()
+        static inline bool is_punctuation(const Token<x86_Keyword>& token, Punctuation punctuation)
         {
-            ZoneScopedN("parse_instructions_DB");
+            return token.type == Token_Type::SYNTAXE_OPERATOR && token.value.punctuation == punctuation;
+        }
+
+        static inline bool is_keyword(const Token<x86_Keyword>& token, x86_Keyword keyword)
+        {
+            return token.type == Token_Type::KEYWORD && token.value.keyword == keyword;
+        }
+
+        static inline bool is_character(const Token<x86_Keyword>& token, uint8_t character)
+        {
+            return language::get_string_size(token.text) == 1 && token.text.ptr[0] == character;
+        }
 
-            enum class ParsingState
+        static bool parse_hexadecimal_byte(const Token<x86_Keyword>& token, uint8_t& value)
+        {
+            if (token.type != Token_Type::IDENTIFIER || language::get_string_size(token.text) != 2) {
+                return false;
+            }
+
+            value = 0;
+            for (size_t i = 0; i < 2; i++) {
+                uint8_t character = token.text.ptr[i];
+
+                value <<= 4;
+                if (character >= '0' && character <= '9') {
+                    value |= character - '0';
+                }
+                else if (character >= 'a' && character <= 'f') {
+                    value |= character - 'a' + 10;
+                }
+                else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool parse_operand_type(x86_Keyword keyword, Instruction::Operand& operand)
+        {
+            using Type = Instruction::Operand::Type;
+            using Register_Class = Instruction::Operand::Register_Class;
+
+            struct Operand_Type
             {
-                NAME,
-                OPERANDS,
-                TRANSLATION_INSTRUCTIONS,
-                ARCHITECTURES
+                x86_Keyword     keyword;
+                Type            type;
+                uint8_t         size;
+                Register_Class  register_class;
+                uint8_t         fixed_register;
             };
 
-            Token<x86_Keyword>  current_token;
-            int                 current_line;
-            int                 previous_line = 0;
-            Instruction*        current_instruction = nullptr;
-            ParsingState        parsing_state = ParsingState::NAME;
+            static const Operand_Type operand_types[] = {
+                { x86_Keyword::REG8,            Type::REGISTER,             1,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::REG16,           Type::REGISTER,             2,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::REG32,           Type::REGISTER,             4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::REG64,           Type::REGISTER,             8,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::REG_AL,          Type::REGISTER,             1,  Register_Class::GENERAL_PURPOSE,    0 },
+                { x86_Keyword::REG_AX,          Type::REGISTER,             2,  Register_Class::GENERAL_PURPOSE,    0 },
+                { x86_Keyword::REG_EAX,         Type::REGISTER,             4,  Register_Class::GENERAL_PURPOSE,    0 },
+                { x86_Keyword::REG_RAX,         Type::REGISTER,             8,  Register_Class::GENERAL_PURPOSE,    0 },
+                { x86_Keyword::REG_CL,          Type::REGISTER,             1,  Register_Class::GENERAL_PURPOSE,    1 },
+                { x86_Keyword::REG_ECX,         Type::REGISTER,             4,  Register_Class::GENERAL_PURPOSE,    1 },
+                { x86_Keyword::REG_RCX,         Type::REGISTER,             8,  Register_Class::GENERAL_PURPOSE,    1 },
+                { x86_Keyword::REG_DX,          Type::REGISTER,             2,  Register_Class::GENERAL_PURPOSE,    2 },
+                { x86_Keyword::REG_EDX,         Type::REGISTER,             4,  Register_Class::GENERAL_PURPOSE,    2 },
+                { x86_Keyword::RM8,             Type::REGISTER_OR_MEMORY,   1,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::RM16,            Type::REGISTER_OR_MEMORY,   2,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::RM32,            Type::REGISTER_OR_MEMORY,   4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::RM64,            Type::REGISTER_OR_MEMORY,   8,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM,             Type::MEMORY_ADDRESS,       0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM8,            Type::MEMORY_ADDRESS,       1,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM16,           Type::MEMORY_ADDRESS,       2,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM32,           Type::MEMORY_ADDRESS,       4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM64,           Type::MEMORY_ADDRESS,       8,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::MEM128,          Type::MEMORY_ADDRESS,       16, Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::IMM,             Type::IMMEDIATE_VALUE,      0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::IMM8,            Type::IMMEDIATE_VALUE,      1,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::IMM16,           Type::IMMEDIATE_VALUE,      2,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::IMM32,           Type::IMMEDIATE_VALUE,      4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::IMM64,           Type::IMMEDIATE_VALUE,      8,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEWORD,       Type::IMMEDIATE_VALUE,      0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEWORD16,     Type::IMMEDIATE_VALUE,      2,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEWORD32,     Type::IMMEDIATE_VALUE,      4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEDWORD,      Type::IMMEDIATE_VALUE,      0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEDWORD32,    Type::IMMEDIATE_VALUE,      4,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SBYTEDWORD64,    Type::IMMEDIATE_VALUE,      8,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::UDWORD,          Type::IMMEDIATE_VALUE,      0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::SDWORD,          Type::IMMEDIATE_VALUE,      0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::UNITY,           Type::UNITY,                0,  Register_Class::GENERAL_PURPOSE,    Instruction::any_register },
+                { x86_Keyword::XMMREG,          Type::REGISTER,             16, Register_Class::XMM,                Instruction::any_register },
+                { x86_Keyword::XMMRM,           Type::REGISTER_OR_MEMORY,   0,  Register_Class::XMM,                Instruction::any_register },
+                { x86_Keyword::XMMRM32,         Type::REGISTER_OR_MEMORY,   4,  Register_Class::XMM,                Instruction::any_register },
+                { x86_Keyword::XMMRM64,         Type::REGISTER_OR_MEMORY,   8,  Register_Class::XMM,                Instruction::any_register },
+                { x86_Keyword::XMMRM128,        Type::REGISTER_OR_MEMORY,   16, Register_Class::XMM,                Instruction::any_register },
+                { x86_Keyword::XMM0,            Type::REGISTER,             16, Register_Class::XMM,                0 },
+            };
 
-            stream::Array_Stream<Token<x86_Keyword>>	stream;
+            for (const Operand_Type& operand_type : operand_types) {
+                if (operand_type.keyword == keyword) {
+                    operand.type = operand_type.type;
+                    operand.size = operand_type.size;
+                    operand.register_class = operand_type.register_class;
+                    operand.fixed_register = operand_type.fixed_register;
+                    return true;
+                }
+            }
+            return false; // mmx, fpu, segment registers,...
+        }
 
-            stream::initialize_memory_stream<Token<x86_Keyword>>(stream, globals.x86_db_data.tokens);
+        // Return false if the form isn't supported in 64 bit mode by the encoder, the line is then skipped
+        static bool parse_line(const Token<x86_Keyword>* tokens, size_t nb_tokens, Instruction& instruction)
+        {
+            using Type = Instruction::Operand::Type;
+
+            Instruction::Translation_Instructions& translation = instruction.translation_instructions;
+
+            size_t  i = 1;
+            uint8_t bytes[5];
+            uint8_t nb_bytes = 0;
+            uint8_t default_size = 0;       // Operation size given by o16, o32 or o64
+            uint8_t size_flag = 0;          // Size of unsized memory operands given by SB, SW,...
+            uint8_t size_flag_operand = 3;  // Operand concerned by the size flag (AR0, AR1 or AR2), 3 for all
+            bool    size_match = false;
+            bool    any_size = false;
+
+            system::zero_memory(&instruction, sizeof(Instruction));
+            instruction.name = tokens[0].text;
+            translation.extra_data = Instruction::no_modrm;
+
+            // Operands
+            if (i < nb_tokens && is_keyword(tokens[i], x86_Keyword::_VOID)) {
+                i++;
+            }
+            else {
+                while (i < nb_tokens && tokens[i].type == Token_Type::KEYWORD) {
+                    if (instruction.nb_operands == 3
+                        || parse_operand_type(tokens[i].value.keyword, instruction.operands[instruction.nb_operands]) == false) {
+                        return false;
+                    }
+                    instruction.nb_operands++;
+                    i++;
+
+                    // Modifiers, near and short are the only ones possible in 64 bit mode, * marks the relaxed
+                    // forms of VEX instructions
+                    while (i < nb_tokens && (is_punctuation(tokens[i], Punctuation::PIPE) || is_punctuation(tokens[i], Punctuation::STAR))) {
+                        if (is_punctuation(tokens[i], Punctuation::PIPE)) {
+                            i++;
+                            if (i == nb_tokens || (is_keyword(tokens[i], x86_Keyword::_NEAR) == false && is_keyword(tokens[i], x86_Keyword::_SHORT) == false)) {
+                                return false;
+                            }
+                        }
+                        i++;
+                    }
 
-            memory::reserve_array(globals.x86_db_data.instructions, NB_INSTRUCTIONS * sizeof(Instruction));
+                    if (i == nb_tokens || is_punctuation(tokens[i], Punctuation::COMMA) == false) {
+                        break;
+                    }
+                    i++; // ,
+                }
+            }
 
-            while (stream::is_eof(stream) == false)
-            {
-                current_token = stream::get(stream);
+            if (i == nb_tokens || is_punctuation(tokens[i], Punctuation::OPEN_BRACKET) == false) {
+                return false;
+            }
+            i++; // [
 
-                current_line = (int)current_token.line;
+            // Encoding letters of operands, they are omitted when all operands are implicit
+            size_t colon = i;
+            while (colon < nb_tokens && is_punctuation(tokens[colon], Punctuation::COLON) == false && is_punctuation(tokens[colon], Punctuation::CLOSE_BRACKET) == false) {
+                colon++;
+            }
+            if (colon == nb_tokens) {
+                return false;
+            }
+            if (is_punctuation(tokens[colon], Punctuation::COLON)) {
+                uint8_t operand_index = 0;
 
-                if (previous_line != current_line) { // We have to start a new instruction
-                    if (current_token.type == Token_Type::SYNTAXE_OPERATOR) {
-                        // Skip until we reach the next line, because it's a comment
-                        while (stream::get(stream).line == current_line) {
-                            stream::skip<Token<x86_Keyword>>(stream, 1);
+                for (; i < colon; i++) {
+                    if (is_punctuation(tokens[i], Punctuation::DASH)) { // Implicit operand
+                        operand_index++;
+                        continue;
+                    }
+                    if (is_punctuation(tokens[i], Punctuation::PLUS)) { // The next letter is for the same operand (r+m)
+                        if (operand_index == 0) {
+                            return false;
                         }
+                        operand_index--;
+                        continue;
                     }
-                    else {
-                        current_instruction = allocate_instruction();
+                    if (tokens[i].type == Token_Type::SYNTAXE_OPERATOR) {
+                        return false;
+                    }
+
+                    for (size_t c = 0; c < language::get_string_size(tokens[i].text); c++) {
+                        uint8_t role;
 
-                        current_instruction->name = current_token.text;
+                        switch (tokens[i].text.ptr[c])
+                        {
+                        case 'r':
+                            role = Instruction::ROLE_REGISTER;
+                            break;
+                        case 'm':
+                            role = Instruction::ROLE_RM;
+                            break;
+                        case 'i':
+                            role = Instruction::ROLE_IMMEDIATE;
+                            break;
+                        default:
+                            return false; // VEX register, second immediate,...
+                        }
 
-                        parsing_state = ParsingState::OPERANDS;
-                        stream::peek<Token<x86_Keyword>>(stream);
+                        if (operand_index >= instruction.nb_operands) {
+                            return false;
+                        }
+                        translation.operand_roles[operand_index++] |= role;
                     }
                 }
-                else {
-                    if (parsing_state == ParsingState::OPERANDS) {
-                        size_t  operand_index = 0;
-
-                        if (current_token.type == Token_Type::KEYWORD) {
-                            if (current_token.value.keyword == x86_Keyword::_IGNORE) {
-                                // We can simply completely ignore this instruction, so we skip tokens directly to the next line
-                                parsing_state = ParsingState::NAME;
-                                while (stream::get(stream).line == current_line) {
-                                    stream::skip<Token<x86_Keyword>>(stream, 1);
-                                }
-                            }
-                            else if (current_token.value.keyword == x86_Keyword::IMM) {
-                                current_instruction->operands[operand_index].type = Instruction::Operand::Type::ImmediateValue;
-                                current_instruction->operands[operand_index].size = -1; // @TODO
-                                stream::peek<Token<x86_Keyword>>(stream); // imm
-                            }
-                            else if (current_token.value.keyword == x86_Keyword::_VOID) {
-                                current_instruction->operands[operand_index].type = Instruction::Operand::Type::Unused;
-                                current_instruction->operands[operand_index].size = 0;
-                                stream::peek<Token<x86_Keyword>>(stream); // void
-                            }
-                            else {
-                                report_error(Compiler_Error::internal_error, current_token, "x86 backend: [DB instructions parsing] Unknown operand type!");
-                            }
+                i = colon + 1;
+            }
+
+            // Codes
+            while (i < nb_tokens && is_punctuation(tokens[i], Punctuation::CLOSE_BRACKET) == false) {
+                const Token<x86_Keyword>&   token = tokens[i];
+                uint8_t                     byte;
+
+                if (parse_hexadecimal_byte(token, byte)) {
+                    if (nb_bytes == sizeof(bytes)) {
+                        return false;
+                    }
+                    bytes[nb_bytes++] = byte;
+
+                    if (i + 2 < nb_tokens && is_punctuation(tokens[i + 1], Punctuation::PLUS)) {
+                        if (is_character(tokens[i + 2], 'r')) {
+                            translation.register_in_opcode = true;
                         }
-                        else if (current_token.type == Token_Type::SYNTAXE_OPERATOR) {
-                            if (current_token.value.punctuation == Punctuation::COMMA) {
-                                operand_index++;
-                                stream::peek<Token<x86_Keyword>>(stream); // ,
-                            }
-                            else if (current_token.value.punctuation == Punctuation::OPEN_BRACKET) {
-                                stream::peek<Token<x86_Keyword>>(stream); // [
-                                parsing_state = ParsingState::TRANSLATION_INSTRUCTIONS;
-                            }
+                        else if (is_character(tokens[i + 2], 'c')) {
+                            translation.condition_in_opcode = true;
                         }
                         else {
-                            report_error(Compiler_Error::internal_error, current_token, "x86 backend: [DB instructions parsing] Syntax error, expecting an operand name or a comma");
+                            return false;
                         }
+                        i += 2;
                     }
-                    else if (parsing_state == ParsingState::TRANSLATION_INSTRUCTIONS) {
-                        if (current_token.type == Token_Type::KEYWORD) {
-                            if (current_token.value.keyword == x86_Keyword::RESB) {
-                                stream::peek<Token<x86_Keyword>>(stream); // resb
-                            }
+                }
+                else if (is_punctuation(token, Punctuation::SLASH)) {
+                    i++;
+                    if (i == nb_tokens) {
+                        return false;
+                    }
+
+                    if (is_character(tokens[i], 'r')) {
+                        translation.extra_data = Instruction::modrm_register;
+                    }
+                    else if (language::get_string_size(tokens[i].text) == 1 && tokens[i].text.ptr[0] >= '0' && tokens[i].text.ptr[0] <= '7') {
+                        translation.extra_data = tokens[i].text.ptr[0] - '0';
+                    }
+                    else {
+                        return false; // /is4
+                    }
+                }
+                else if (token.type == Token_Type::KEYWORD) {
+                    switch (token.value.keyword)
+                    {
+                    case x86_Keyword::O16:
+                        translation.operand_size_prefix = true;
+                        default_size = 2;
+                        break;
+                    case x86_Keyword::O32:
+                        default_size = 4;
+                        break;
+                    case x86_Keyword::O64:
+                        translation.rex_w = true;
+                        default_size = 8;
+                        break;
+                    case x86_Keyword::O64NW:
+                        default_size = 8;
+                        break;
+                    case x86_Keyword::ODF:
+                    case x86_Keyword::NP:
+                    case x86_Keyword::HLE:
+                    case x86_Keyword::HLEXR:
+                    case x86_Keyword::HLENL:
+                    case x86_Keyword::NOREXB:
+                    case x86_Keyword::NOREXW:
+                    case x86_Keyword::NOF3:
+                    case x86_Keyword::NOREP:
+                    case x86_Keyword::A64:
+                    case x86_Keyword::ADF:
+                        break; // Hints for nasm
+                    case x86_Keyword::F2I:
+                    case x86_Keyword::F3I:
+                        if (translation.nb_prefixes == sizeof(translation.prefixes)) {
+                            return false;
+                        }
+                        translation.prefixes[translation.nb_prefixes++] = token.value.keyword == x86_Keyword::F2I ? 0xf2 : 0xf3;
+                        break;
+                    case x86_Keyword::IB:
+                    case x86_Keyword::IW:
+                    case x86_Keyword::ID:
+                    case x86_Keyword::IQ:
+                        if (translation.immediate_size) {
+                            return false;
                         }
-                        else if (current_token.type == Token_Type::SYNTAXE_OPERATOR) {
-                            if (current_token.value.punctuation == Punctuation::CLOSE_BRACKET) {
-                                stream::peek<Token<x86_Keyword>>(stream); // ]
-                                parsing_state = ParsingState::ARCHITECTURES;
+                        translation.immediate_size = token.value.keyword == x86_Keyword::IB ? 1
+                            : token.value.keyword == x86_Keyword::IW ? 2
+                            : token.value.keyword == x86_Keyword::ID ? 4 : 8;
+                        translation.immediate_kind = Instruction::Immediate_Kind::ANY;
+
+                        if (i + 2 < nb_tokens && is_punctuation(tokens[i + 1], Punctuation::COMMA)) {
+                            if (is_keyword(tokens[i + 2], x86_Keyword::SIGNED)) {
+                                translation.immediate_kind = Instruction::Immediate_Kind::SIGNED;
+                            }
+                            else if (is_keyword(tokens[i + 2], x86_Keyword::UNSIGNED)) {
+                                translation.immediate_kind = Instruction::Immediate_Kind::UNSIGNED;
+                            }
+                            else {
+                                return false;
                             }
+                            i += 2;
                         }
-                        else {
-                            report_error(Compiler_Error::internal_error, current_token, "x86 backend: [DB instructions parsing] Syntax error, translation instructions parsing failed!!!");
+                        break;
+                    case x86_Keyword::REL:
+                    case x86_Keyword::REL8:
+                        if (translation.immediate_size) {
+                            return false;
                         }
+                        translation.immediate_size = token.value.keyword == x86_Keyword::REL8 ? 1 : 4;
+                        translation.immediate_kind = Instruction::Immediate_Kind::RELATIVE;
+                        break;
+                    default:
+                        return false; // resb,...
                     }
-                    else if (parsing_state == ParsingState::ARCHITECTURES) {
-                        if (current_token.type == Token_Type::KEYWORD) {
-                            if (current_token.value.keyword == x86_Keyword::ARCH_8086) {
-                                // @TODO push the instruction if valid (resb is not valid)
+                }
+                else {
+                    return false; // vex, evex, xop, jmp8, wait, iwdq,...
+                }
+                i++;
+            }
+            if (i == nb_tokens) {
+                return false;
+            }
+            i++; // ]
 
-                                stream::peek<Token<x86_Keyword>>(stream); // resb
-                            }
-                        }
-                        else if (current_token.type == Token_Type::SYNTAXE_OPERATOR) {
-                            if (current_token.value.punctuation == Punctuation::COMMA) {
-                                stream::peek<Token<x86_Keyword>>(stream); // ,
-                            }
+            // Flags
+            for (; i < nb_tokens; i++) {
+                if (tokens[i].type != Token_Type::KEYWORD) {
+                    continue;
+                }
+
+                switch (tokens[i].value.keyword)
+                {
+                case x86_Keyword::ARCH_NOLONG:
+                case x86_Keyword::ARCH_IA64:
+                case x86_Keyword::ARCH_UNDOC:
+                case x86_Keyword::ARCH_OBSOLETE:
+                    return false;
+                case x86_Keyword::ARCH_SM:
+                case x86_Keyword::ARCH_SM2:
+                    size_match = true;
+                    break;
+                case x86_Keyword::ARCH_SB:
+                    size_flag = 1;
+                    break;
+                case x86_Keyword::ARCH_SW:
+                    size_flag = 2;
+                    break;
+                case x86_Keyword::ARCH_SD:
+                    size_flag = 4;
+                    break;
+                case x86_Keyword::ARCH_SQ:
+                    size_flag = 8;
+                    break;
+                case x86_Keyword::ARCH_SO:
+                    size_flag = 16;
+                    break;
+                case x86_Keyword::ARCH_AR0:
+                    size_flag_operand = 0;
+                    break;
+                case x86_Keyword::ARCH_AR1:
+                    size_flag_operand = 1;
+                    break;
+                case x86_Keyword::ARCH_AR2:
+                    size_flag_operand = 2;
+                    break;
+                case x86_Keyword::ARCH_ANYSIZE:
+                    any_size = true;
+                    break;
+                case x86_Keyword::ARCH_LOCK:
+                    translation.lock_prefix = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            // Leading 66, f2 and f3 bytes are mandatory prefixes
+            uint8_t first_opcode_byte = 0;
+            while (nb_bytes - first_opcode_byte > 1 && translation.nb_prefixes < sizeof(translation.prefixes)
+                && (bytes[first_opcode_byte] == 0x66 || bytes[first_opcode_byte] == 0xf2 || bytes[first_opcode_byte] == 0xf3)) {
+                translation.prefixes[translation.nb_prefixes++] = bytes[first_opcode_byte++];
+            }
+
+            translation.opcode_size = nb_bytes - first_opcode_byte;
+            if (translation.opcode_size == 0 || translation.opcode_size > sizeof(translation.opcode)) {
+                return false;
+            }
+            system::memory_copy(translation.opcode, &bytes[first_opcode_byte], translation.opcode_size);
+
+            // Operands have to be consistent with their roles and the ModR/M byte
+            int8_t  register_operand = -1;
+            int8_t  rm_operand = -1;
+            uint8_t nb_immediates = 0;
+
+            for (uint8_t operand_index = 0; operand_index < instruction.nb_operands; operand_index++) {
+                const Instruction::Operand& operand = instruction.operands[operand_index];
+                uint8_t                     role = translation.operand_roles[operand_index];
+
+                if (operand.type == Type::IMMEDIATE_VALUE) {
+                    if (role != Instruction::ROLE_IMMEDIATE) {
+                        return false; // lea reg64,imm
+                    }
+                    nb_immediates++;
+                }
+                else if (role & Instruction::ROLE_IMMEDIATE) {
+                    return false; // mem_offs
+                }
+                else if (role == Instruction::IMPLICIT) {
+                    if (operand.type != Type::UNITY && operand.fixed_register == Instruction::any_register) {
+                        return false;
+                    }
+                }
+
+                if ((role & Instruction::ROLE_REGISTER) && register_operand == -1) {
+                    register_operand = operand_index;
+                }
+                if ((role & Instruction::ROLE_RM) && rm_operand == -1) {
+                    rm_operand = operand_index;
+                }
+            }
+
+            if (nb_immediates > 1 || (nb_immediates == 1) != (translation.immediate_size != 0)) {
+                return false;
+            }
+
+            if (translation.extra_data == Instruction::modrm_register) {
+                if (register_operand == -1 || rm_operand == -1 || translation.register_in_opcode) {
+                    return false;
+                }
+            }
+            else if (translation.extra_data != Instruction::no_modrm) {
+                if (rm_operand == -1 || register_operand != -1) {
+                    return false;
+                }
+            }
+            else if (rm_operand != -1 || (register_operand != -1) != translation.register_in_opcode) {
+                return false;
+            }
+
+            // Size of unsized memory operands
+            for (uint8_t operand_index = 0; operand_index < instruction.nb_operands; operand_index++) {
+                Instruction::Operand& operand = instruction.operands[operand_index];
+
+                if (((uint8_t)operand.type & (uint8_t)Type::MEMORY_ADDRESS) == 0 || operand.size != 0 || any_size) {
+                    continue;
+                }
+
+                if (size_flag && (size_flag_operand == 3 || size_flag_operand == operand_index)) {
+                    operand.size = size_flag;
+                }
+                else if (size_match) {
+                    // Size of the first sized general purpose register, then of the sized immediate value
+                    for (uint8_t other_index = 0; other_index < instruction.nb_operands && operand.size == 0; other_index++) {
+                        const Instruction::Operand& other = instruction.operands[other_index];
+
+                        if (other.type == Type::REGISTER && other.register_class == Instruction::Operand::Register_Class::GENERAL_PURPOSE) {
+                            operand.size = other.size;
                         }
-                        else {
-                            report_error(Compiler_Error::internal_error, current_token, "x86 backend: [DB instructions parsing] Syntax error, expecting an architecture keyword.");
+                    }
+                    for (uint8_t other_index = 0; other_index < instruction.nb_operands && operand.size == 0; other_index++) {
+                        if (instruction.operands[other_index].type == Type::IMMEDIATE_VALUE) {
+                            operand.size = instruction.operands[other_index].size;
                         }
                     }
+                    if (operand.size == 0) {
+                        operand.size = default_size;
+                    }
                 }
+                // Otherwise the memory operand accepts any size (call [rax],...)
+            }
 
-                previous_line = current_line;
+            return true;
+        }
+
+        static void parse_instructions_DB()
+        {
+            ZoneScopedN("parse_instructions_DB");
+
+            Token<x86_Keyword>* tokens = memory::get_array_data(globals.x86_db_data.tokens);
+            size_t              nb_tokens = memory::get_array_size(globals.x86_db_data.tokens);
+            size_t              line_start = 0;
+
+            memory::reserve_array(globals.x86_db_data.instructions, NB_INSTRUCTIONS);
+
+            while (line_start < nb_tokens)
+            {
+                size_t line_end = line_start + 1;
+
+                while (line_end < nb_tokens && tokens[line_end].line == tokens[line_start].line) {
+                    line_end++;
+                }
+
+                // Lines that start with a punctuation are comments
+                if (tokens[line_start].type != Token_Type::SYNTAXE_OPERATOR) {
+                    Instruction instruction;
+
+                    if (parse_line(&tokens[line_start], line_end - line_start, instruction)) {
+                        memory::array_push_back(globals.x86_db_data.instructions, instruction);
+                    }
+                }
+
+                line_start = line_end;
             }
         }
 
         void load_x86_instruction_DB()
         {
+            ZoneScopedN("f::x86_DB::load_x86_instruction_DB");
+
             lex_instructions_DB();
             parse_instructions_DB();
+
+            // Tokens are only needed by the parsing
+            memory::release(globals.x86_db_data.tokens);
         }
 	}
 }
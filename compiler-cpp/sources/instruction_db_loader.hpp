@@ -6,6 +6,12 @@
 
 #include <fstd/language/types.hpp>
 
+// Loader of the instruction database of nasm (data/insns.dat)
+//
+// Each line describes an encoding form: "NAME operand_types [letters: codes] flags". Only forms that are valid in
+// 64 bit mode and that use legacy encodings (no VEX, EVEX, XOP) are kept, other ones are silently skipped.
+// https://github.com/netwide-assembler/nasm/blob/master/x86/insns.dat
+
 namespace f
 {
     namespace x86_DB
@@ -26,15 +32,25 @@ namespace f
             REG32,
             REG64,
             REG_AL,
-            reg_ax,
-            reg_eax,
-            reg_rax,
-            reg_dx,
+            REG_AX,
+            REG_EAX,
+            REG_RAX,
+            REG_CL,
+            REG_ECX,
+            REG_RCX,
+            REG_DX,
+            REG_EDX,
+            RM8,
+            RM16,
+            RM32,
+            RM64,
             MEM,
+            MEM8,
             MEM16,
             MEM32,
             MEM64,
-            mem80,
+            MEM80,
+            MEM128,
             IMM,
             IMM8,
             IMM16,
@@ -43,81 +59,163 @@ namespace f
             SBYTEWORD,
             SBYTEWORD16,
             SBYTEWORD32,
-            fpureg,
-            fpu0,
+            SBYTEDWORD,
+            SBYTEDWORD32,
+            SBYTEDWORD64,
+            UDWORD,
+            SDWORD,
+            UNITY,
+            XMMREG,
+            XMMRM,
+            XMMRM32,
+            XMMRM64,
+            XMMRM128,
+            XMM0,
+            FPUREG,
+            FPU0,
 
             // Operand modifier
             _NEAR,
             _FAR,
+            _SHORT,
             TO,
 
+            // Translation instructions
+            O16,            // Operand size prefix
+            O32,
+            O64,            // REX.W
+            O64NW,          // 64 bit operand size without REX.W
+            ODF,
+            NP,
+            HLE,
+            HLEXR,
+            HLENL,
+            NOREXB,
+            NOREXW,
+            NOF3,
+            NOREP,
+            A64,
+            ADF,
+            F2I,            // Mandatory prefixes
+            F3I,
+            IB,             // Immediates
+            IW,
+            ID,
+            IQ,
+            REL,            // Relative address (32 bits in 64 bit mode)
+            REL8,
+            SIGNED,         // ib,s
+            UNSIGNED,       // ib,u
+
             // Architectures
             ARCH_8086,
             ARCH_386,
             ARCH_X64,
             ARCH_NOLONG,
-            ARCH_SM,
+            ARCH_IA64,
+            ARCH_UNDOC,
+            ARCH_OBSOLETE,
+            ARCH_SM,        // Size of unsized memory operands is the one of other operands
+            ARCH_SM2,
+            ARCH_SB,        // Size of unsized memory operands
+            ARCH_SW,
+            ARCH_SD,
+            ARCH_SQ,
+            ARCH_SO,
+            ARCH_AR0,       // Operand concerned by the SB, SW,... size
+            ARCH_AR1,
+            ARCH_AR2,
+            ARCH_ANYSIZE,
             ARCH_LOCK,
             ARCH_ND,
         };
 
-        struct x86_DB_Data
-        {
-            fstd::memory::Array<Token<x86_Keyword>>	tokens;
-            fstd::memory::Array<uint8_t>			instructions;
-        };
-
         // Struct for database entries (used for machine generation)
         struct Instruction
         {
             struct Operand
             {
-                enum class Type : uint8_t // @TODO UPPER_CASE
+                enum class Type : uint8_t
                 {
-                    Unused = 0x00,
-                    Register = 0x01,
-                    MemoryAddress = 0x02,
-                    ImmediateValue = 0x04,
+                    UNUSED = 0x00,
+                    REGISTER = 0x01,
+                    MEMORY_ADDRESS = 0x02,
+                    REGISTER_OR_MEMORY = 0x03,
+                    IMMEDIATE_VALUE = 0x04,
+                    UNITY = 0x08,   // Immediate value 1 that isn't encoded
                 };
-                Type    type;
-                uint8_t size; // size of Register or ImmediateValue, 0 for MemoryAddress and Unused types, -1 for not specified (all sizes accepted?)
+
+                enum class Register_Class : uint8_t
+                {
+                    GENERAL_PURPOSE,
+                    XMM,
+                };
+
+                Type            type;
+                uint8_t         size;           // In bytes, 0 for memory addresses and immediate values of any size
+                Register_Class  register_class;
+                uint8_t         fixed_register; // Encoding of the register of implicit operands (reg_al, reg_cl,...), any_register otherwise
             };
 
-            struct Translation_Instructions
+            enum class Immediate_Kind : uint8_t
+            {
+                ANY,        // Sign or zero extended
+                SIGNED,
+                UNSIGNED,
+                RELATIVE,   // Distance from the end of the instruction
+            };
+
+            // Where the operand is encoded, mask of Operand_Role (an operand can be in the reg and rm fields: r+m)
+            enum Operand_Role : uint8_t
             {
-                // [mi:    hle o32 83 /0 ib,s] 
+                IMPLICIT = 0x00,
+                ROLE_REGISTER = 0x01,   // reg field of ModR/M, or in the opcode (+r)
+                ROLE_RM = 0x02,         // rm field of ModR/M
+                ROLE_IMMEDIATE = 0x04,
+            };
 
-                // continue to add flags, also check the nb bits per value,...
+            static constexpr uint8_t any_register = 0xff;
+            static constexpr uint8_t modrm_register = 0xfe;  // extra_data of /r
+            static constexpr uint8_t no_modrm = 0xff;
+
+            struct Translation_Instructions
+            {
+                // [mi:    hle o64 83 /0 ib,s]
                 // https://softwareengineering.stackexchange.com/questions/227983/how-do-we-go-from-assembly-to-machine-codecode-generation/320297#320297?newreg=a4771182c1c240d1afbbc58d28b90574
-                //
 
-                bool lock_prefix;
-                // bool output32_prefix; // we don't care about o32 because it's for 16bit output format, we'll only support 32 and 64 bit formats 
+                bool            lock_prefix;            // The LOCK prefix can be used
+                bool            operand_size_prefix;    // o16
+                bool            rex_w;                  // o64
 
-                uint32_t opcode : 8;
+                uint8_t         nb_prefixes;
+                uint8_t         prefixes[2];            // Mandatory prefixes (66, f2, f3) that are before REX
 
-                // modr/m byte
-                //uint8_t mod        : 2; // 00 => indirect, e.g. [eax]
-                //                        // 01 = > indirect plus byte offset
-                //                        // 10 = > indirect plus word offset
-                //                        // 11 = > register
-                //uint8_t reg        : 3; // identifies register
-                //uint8_t rm         : 3; // identifies second register or additional data
+                uint8_t         opcode_size;
+                uint8_t         opcode[3];
+                bool            register_in_opcode;     // +r, the register operand is added to the last opcode byte
+                bool            condition_in_opcode;    // +c, the condition code is added to the last opcode byte
 
-                uint8_t extra_data; // decimal value to put in rm when it is not used. The value is in a range of 0-7.
+                uint8_t         extra_data;             // Value of the reg field of ModR/M (/0 to /7), modrm_register for /r or no_modrm
 
-                union
-                {
-                    uint8_t _unsigned;
-                    int8_t  _signed;
-                }   immediate_byte;
+                uint8_t         immediate_size;         // In bytes, 0 if there is no immediate value
+                Immediate_Kind  immediate_kind;
+
+                uint8_t         operand_roles[3];
             };
 
             fstd::language::string_view name;
+            uint8_t                     nb_operands;
             Operand                     operands[3];    // x86 instructions can have 0 to 3 operands
             Translation_Instructions    translation_instructions;
         };
 
+        struct x86_DB_Data
+        {
+            fstd::memory::Array<uint8_t>            file_content;   // Names of instructions are views on it
+            fstd::memory::Array<Token<x86_Keyword>> tokens;
+            fstd::memory::Array<Instruction>        instructions;
+        };
+
         void load_x86_instruction_DB();
     }
 }
@@ -139,6 +139,12 @@ void f::initialize_lexer()
     INSERT_KEYWORD("ui64", UI64);
     INSERT_KEYWORD("f32", F32);
     INSERT_KEYWORD("f64", F64);
+    INSERT_KEYWORD("f32x4", F32X4);
+    INSERT_KEYWORD("f64x2", F64X2);
+    INSERT_KEYWORD("i8x16", I8X16);
+    INSERT_KEYWORD("i16x8", I16X8);
+    INSERT_KEYWORD("i32x4", I32X4);
+    INSERT_KEYWORD("i64x2", I64X2);
     INSERT_KEYWORD("string", STRING);
     INSERT_KEYWORD("string_view", STRING_VIEW);
     INSERT_KEYWORD("Type", TYPE);
@@ -537,7 +543,7 @@ void f::lex(const system::Path& path, fstd::memory::Array<uint8_t>& file_buffer,
                             current_character = stream::get(stream);
 
                             if (current_character >= '0' && current_character <= '9') {
-                                token.value.real_max += (current_character - '0') / divider;
+                                token.value.real_max += (long double)(current_character - '0') / divider;
                                 divider *= 10;
                                 peek(stream, current_column);
                             }
@@ -75,6 +75,12 @@ namespace f
         UI64,
         F32,
         F64,
+        F32X4,  // SIMD vectors of 16 bytes
+        F64X2,
+        I8X16,
+        I16X8,
+        I32X4,
+        I64X2,
         STRING,
         STRING_VIEW,
         TYPE,   // For variables that store a Type (function, ui32, f32,...)
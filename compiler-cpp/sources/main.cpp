@@ -1,11 +1,17 @@
 ﻿#include "PE_x64_backend.hpp"
+#include "ELF_x64_backend.hpp"
+#include "JIT_x64_backend.hpp"
 
 #include "globals.hpp"
 
 #include "IR_generator.hpp"
+#include "optimizer/optimizer.hpp"
 
 #include "lexer/lexer.hpp"
 #include "parser/parser.hpp"
+#include "parser/modules.hpp"
+#include "parser/constant_folder.hpp"
+#include "parser/type_table.hpp"
 
 #include "ASM/ASM.hpp"
 
@@ -55,6 +61,51 @@ void convert_dot_file_to_png(const system::Path& dot_file_path, const system::Pa
 	}
 }
 
+// Options with a value are written -name=value, return false if the argument isn't the option
+static bool parse_integer_option(const char* argument, const char* option, uint32_t& value)
+{
+	size_t i = 0;
+
+	for (; option[i] != '\0'; i++) {
+		if (argument[i] != option[i]) {
+			return false;
+		}
+	}
+
+	if (argument[i] < '0' || argument[i] > '9') {
+		report_error(Compiler_Error::error, "The value of an option should be a positive integer.");
+	}
+
+	value = 0;
+	for (; argument[i] >= '0' && argument[i] <= '9'; i++) {
+		value = value * 10 + (uint32_t)(argument[i] - '0');
+	}
+
+	if (argument[i] != '\0') {
+		report_error(Compiler_Error::error, "The value of an option should be a positive integer.");
+	}
+	return true;
+}
+
+// Return false if the argument isn't the option, the value is the rest of the argument
+static bool parse_string_option(const char* argument, const char* option, const char*& value)
+{
+	size_t i = 0;
+
+	for (; option[i] != '\0'; i++) {
+		if (argument[i] != option[i]) {
+			return false;
+		}
+	}
+
+	if (argument[i] == '\0') {
+		report_error(Compiler_Error::error, "The value of an option can't be empty.");
+	}
+
+	value = argument + i;
+	return true;
+}
+
 int main(int ac, char** av)
 {
 	// Begin Initialization ================================================
@@ -81,15 +132,80 @@ int main(int ac, char** av)
 	FrameMark;
 	// End Initialization ================================================
 
-	memory::Array<f::Token<f::Keyword>>	tokens;
-	f::Parsing_Result					parsing_result;
 	f::IR								ir;
 	int									result = 0;
+	bool								linux_target = false;
+	bool								jit_target = false;
 
-	if (ac != 3) {
+	if (ac < 3) {
 		report_error(Compiler_Error::error, "Wrong argument number, you should specify file paths of input and output files.");
 	}
 
+	// Options follow the file paths:
+	//   -target=windows (default), -target=linux or -target=jit, with the jit target the program is executed by
+	//   the compiler, no output file is written.
+	//   -hoist-imports, addresses of imported functions called in loops are read once before the loop.
+	//   -no-inline, -inline-budget=N and -inline-growth=N configure the inliner.
+	//   -profile-generate=file, the program counts the executions of its blocks and writes them in the file when it exits
+	//   (jit target only). -profile-use=file, the counts of the file drive the inliner and the layout of the code.
+	//   -no-cold-splitting, unlikely blocks aren't moved after the hot code.
+	for (int i = 3; i < ac; i++) {
+		language::string_view	argument;
+		language::string_view	linux_argument;
+		language::string_view	windows_argument;
+		language::string_view	jit_argument;
+		language::string_view	hoist_imports_argument;
+		language::string_view	no_inline_argument;
+		language::string_view	no_cold_splitting_argument;
+
+		language::assign(argument, (uint8_t*)av[i]);
+		language::assign(linux_argument, (uint8_t*)"-target=linux");
+		language::assign(windows_argument, (uint8_t*)"-target=windows");
+		language::assign(jit_argument, (uint8_t*)"-target=jit");
+		language::assign(hoist_imports_argument, (uint8_t*)"-hoist-imports");
+		language::assign(no_inline_argument, (uint8_t*)"-no-inline");
+		language::assign(no_cold_splitting_argument, (uint8_t*)"-no-cold-splitting");
+
+		if (language::are_equals(argument, windows_argument)) {
+			linux_target = false;
+			jit_target = false;
+		}
+		else if (language::are_equals(argument, linux_argument)) {
+			linux_target = true;
+			jit_target = false;
+		}
+		else if (language::are_equals(argument, jit_argument)) {
+			linux_target = false;
+			jit_target = true;
+		}
+		else if (language::are_equals(argument, hoist_imports_argument)) {
+			globals.configuration.hoist_imported_function_addresses = true;
+		}
+		else if (language::are_equals(argument, no_inline_argument)) {
+			globals.configuration.inline_functions = false;
+		}
+		else if (language::are_equals(argument, no_cold_splitting_argument)) {
+			globals.configuration.split_cold_code = false;
+		}
+		else if (parse_integer_option(av[i], "-inline-budget=", globals.configuration.inline_budget)) {
+		}
+		else if (parse_integer_option(av[i], "-inline-growth=", globals.configuration.inline_growth)) {
+		}
+		else if (parse_string_option(av[i], "-profile-generate=", globals.configuration.profile_generate)) {
+		}
+		else if (parse_string_option(av[i], "-profile-use=", globals.configuration.profile_use)) {
+		}
+		else {
+			report_error(Compiler_Error::error, "Unknown option, it should be -target=windows, -target=linux, -target=jit, -hoist-imports, -no-inline, -inline-budget=N, -inline-growth=N, -no-cold-splitting, -profile-generate=file or -profile-use=file.");
+		}
+	}
+
+	// Counters are written by the JIT when the program exits, executables don't have a writable section or an exit
+	// hook for them
+	if (globals.configuration.profile_generate && !jit_target) {
+		report_error(Compiler_Error::error, "-profile-generate is only supported with -target=jit.");
+	}
+
 	// Log compiled file
 	{
 		String_Builder		string_builder;
@@ -131,14 +247,34 @@ int main(int ac, char** av)
 
 		system::from_native(path, (const uint8_t*)av[1]);
 
-		f::initialize_lexer();
-		f::lex(path, tokens);
+		// Lex and parse the main file and all modules it imports, imported modules are loaded in parallel.
+		f::Module*							main_module = f::load_modules(path);
+		f::Parsing_Result&					parsing_result = main_module->parsing_result;
+		const memory::Array<f::Module*>&	modules = f::get_modules();
+
+		defer { f::release_modules(); };
 
 #if !defined(TRACY_ENABLE) && ENABLE_TOKENS_PRINT == 1
-		f::print(tokens);	// Optionnal
+		f::print(main_module->tokens);	// Optionnal
 #endif
 
-		f::parse(tokens, parsing_result);
+		// Evaluate all constant expressions before the type deduction pass, to be able to check
+		// sign mismatches and type sizes. Array sizes and enum values are also computed here.
+		for (size_t i = 0; i < memory::get_array_size(modules); i++) {
+			f::fold_constant_expressions(modules[i]->parsing_result);
+		}
+
+		// Intern all types and compute their layouts, the IR generator and backends only do queries on the type table.
+		{
+			memory::Array<f::Parsing_Result*>	parsing_results;
+
+			defer { memory::release(parsing_results); };
+
+			for (size_t i = 0; i < memory::get_array_size(modules); i++) {
+				memory::array_push_back(parsing_results, &modules[i]->parsing_result);
+			}
+			f::deduce_types(parsing_results);
+		}
 
 		// Optionnal Dot graph output
 #if !defined(TRACY_ENABLE) && ENABLE_DOT_OUTPUT == 1
@@ -172,6 +308,11 @@ int main(int ac, char** av)
 			f::generate_ir(parsing_result, ir);
 		}
 
+		// Optimize the IR
+		{
+			f::optimize(ir);
+		}
+
 		// Optionnal C++ backend
 #if ENABLE_CPP_BACKEND == 1
 		{
@@ -185,29 +326,10 @@ int main(int ac, char** av)
 		}
 #endif
 
-		// @TODO Evaluate all constant expressions.
-		//
-		// We need to evaluate all constant expressions before the type deduction pass. This is necessary to have a proper
-		// type deduction with a good error checking (sign mismatch, type size,...).
-		// All operations on numeric literals should be processed as cast operations.
-		// This also impact the array that have a fixed size. this is important for function parameters,...
-		// There is also values of enums to compute.
-		//
-		// Check if it should be done for string literals too.
-		// My_Enum::names[enum_value] is also a string literal.
-		// With string literals is seems a little harder without operators like '+', as for consitancy between compile-time and runtime
-		// code evaluation it certainly should works with String_Builder, but it doesn't seems really pratical and easy to implement. Maybe
-		// having the '+' operator that works only at compile time with string literals is OK.
-		// Here with string literals it seems to be only an optimization pass more than something really useful for type deduction and error
-		// reporting.
-		//
-		// Flamaros - 07 may 2020
-
 		// @TODO Type deduction pass
 		//
-		// Compute size of structs,...
 		// Check that enum values are in the expected range,...
-		// Infer variable types.
+		// Infer variable types (with the := operator).
 		//
 		// Flamaros - 07 may 2020
 
@@ -219,8 +341,18 @@ int main(int ac, char** av)
 
 			system::from_native(output_file_path, (uint8_t*)av[2]);
 
-			f::PE_x64_backend::initialize_backend(); // @TODO see to do it asynchronously (are event better at compile-time to generate C++ code with tables)
-			f::PE_x64_backend::compile(ir, output_file_path);
+			if (jit_target) {
+				f::JIT_x64_backend::initialize_backend();
+				result = f::JIT_x64_backend::run(ir);
+			}
+			else if (linux_target) {
+				f::ELF_x64_backend::initialize_backend();
+				f::ELF_x64_backend::compile(ir, output_file_path);
+			}
+			else {
+				f::PE_x64_backend::initialize_backend(); // @TODO see to do it asynchronously (are event better at compile-time to generate C++ code with tables)
+				f::PE_x64_backend::compile(ir, output_file_path);
+			}
 		}
 	}
 
@@ -244,5 +376,5 @@ int main(int ac, char** av)
 
 	FrameMark;
 
-	return 0;
+	return result;
 }
@@ -0,0 +1,82 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Dead code elimination
+//
+// Instructions with side effects (calls, terminators and profile counters) are alive, then definitions of registers
+// used by alive instructions are marked alive. All other instructions are removed, including cycles of phis.
+
+using namespace fstd;
+
+using namespace f;
+
+bool f::eliminate_dead_code(IR_Function& function)
+{
+	ZoneScopedN("f::eliminate_dead_code");
+
+	core::Assert(function.is_ssa);
+
+	size_t					nb_registers = memory::get_array_size(function.registers);
+	size_t					nb_instructions = memory::get_array_size(function.instructions);
+	memory::Array<uint32_t>	definitions;	// Instruction that defines each register, invalid_register for arguments
+	memory::Array<bool>		alive;
+	memory::Array<uint32_t>	worklist;
+
+	defer{
+		memory::release(definitions);
+		memory::release(alive);
+		memory::release(worklist);
+	};
+
+	memory::resize_array(definitions, nb_registers);
+	for (size_t i = 0; i < nb_registers; i++) {
+		definitions[i] = invalid_register;
+	}
+
+	memory::resize_array(alive, nb_instructions);
+	memory::reserve_array(worklist, nb_instructions);	// An instruction is pushed once, when it becomes alive
+	for (size_t i = 0; i < nb_instructions; i++) {
+		IR_Instruction& instruction = function.instructions[i];
+
+		if (instruction.destination != invalid_register) {
+			definitions[instruction.destination] = (uint32_t)i;
+		}
+
+		alive[i] = is_call(instruction.opcode) || is_terminator(instruction.opcode) || instruction.opcode == IR_Opcode::COUNTER;
+		if (alive[i]) {
+			memory::array_push_back_unchecked(worklist, (uint32_t)i);
+		}
+	}
+
+	while (!memory::is_array_empty(worklist)) {
+		uint32_t instruction_index = *memory::get_array_last_element(worklist);
+		memory::resize_array(worklist, memory::get_array_size(worklist) - 1);
+
+		for_each_use(function, function.instructions[instruction_index], [&](uint32_t& register_id) {
+			uint32_t definition = definitions[register_id];
+
+			if (definition != invalid_register && !alive[definition]) {
+				alive[definition] = true;
+				memory::array_push_back_unchecked(worklist, definition);
+			}
+		});
+	}
+
+	bool modified = false;
+	for (size_t i = 0; i < nb_instructions; i++) {
+		if (!alive[i] && function.instructions[i].opcode != IR_Opcode::NOP) {
+			function.instructions[i].opcode = IR_Opcode::NOP;
+			modified = true;
+		}
+	}
+
+	if (modified) {
+		compact_function(function);
+	}
+	return modified;
+}
@@ -0,0 +1,223 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Dominator based global value numbering
+//
+// The dominator tree is walked in pre order with a scoped hash table of pure instructions, an instruction is
+// redundant if an identical one (after the replacement of its operands) dominates it. Entries are removed in the
+// reverse order of their insertion when leaving a block, this keeps probing sequences of the open addressing valid.
+//
+// Copies and phis that always get the same value are also removed here.
+
+using namespace fstd;
+
+using namespace f;
+
+struct GVN_Data
+{
+	IR_Function*				function;
+	memory::Array<uint32_t>		replacements;	// Leader of each register (itself if not replaced)
+	memory::Array<uint32_t>		table;			// Instruction indices, invalid_register for empty slots
+	memory::Array<uint32_t>		inserted_slots;	// Undo log of the table
+	uint32_t					mask;
+	bool						modified;
+};
+
+static bool is_pure(IR_Opcode opcode)
+{
+	switch (opcode)
+	{
+	case IR_Opcode::CONSTANT:
+	case IR_Opcode::ADDRESS:
+	case IR_Opcode::FUNCTION_ADDRESS:
+	case IR_Opcode::CONVERT:
+	case IR_Opcode::ADD:
+	case IR_Opcode::SUB:
+	case IR_Opcode::MUL:
+	case IR_Opcode::DIV:	// A trap of a redundant division already happened in its leader
+	case IR_Opcode::REM:
+	case IR_Opcode::NEG:
+	case IR_Opcode::INSERT:
+	case IR_Opcode::EXTRACT:
+	case IR_Opcode::SHUFFLE:
+	case IR_Opcode::EQUAL:
+	case IR_Opcode::NOT_EQUAL:
+	case IR_Opcode::LESS:
+	case IR_Opcode::LESS_EQUAL:
+	case IR_Opcode::GREATER:
+	case IR_Opcode::GREATER_EQUAL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool is_commutative(IR_Opcode opcode)
+{
+	return opcode == IR_Opcode::ADD || opcode == IR_Opcode::MUL || opcode == IR_Opcode::EQUAL || opcode == IR_Opcode::NOT_EQUAL;
+}
+
+static uint32_t hash_instruction(const IR_Instruction& instruction)
+{
+	constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+
+	uint64_t hash = (uint64_t)instruction.opcode | ((uint64_t)instruction.type << 8);
+	hash = (hash * multiplier) ^ instruction.operands[0];
+	hash = (hash * multiplier) ^ instruction.operands[1];
+	hash = (hash * multiplier) ^ (uint64_t)instruction.immediate.integer;
+	hash *= multiplier;
+	return (uint32_t)(hash >> 32);
+}
+
+static bool are_equivalent(const IR_Instruction& a, const IR_Instruction& b)
+{
+	return a.opcode == b.opcode
+		&& a.type == b.type
+		&& a.operands[0] == b.operands[0]
+		&& a.operands[1] == b.operands[1]
+		&& a.immediate.integer == b.immediate.integer; // Bitwise for reals
+}
+
+inline uint32_t get_leader(GVN_Data& data, uint32_t register_id)
+{
+	while (data.replacements[register_id] != register_id) {
+		register_id = data.replacements[register_id];
+	}
+	return register_id;
+}
+
+static void replace(GVN_Data& data, IR_Instruction& instruction, uint32_t leader)
+{
+	data.replacements[instruction.destination] = leader;
+	instruction.opcode = IR_Opcode::NOP;
+	data.modified = true;
+}
+
+static void number_block(GVN_Data& data, uint32_t block_index)
+{
+	IR_Function&	function = *data.function;
+	IR_Basic_Block&	block = function.blocks[block_index];
+	size_t			nb_inserted_slots = memory::get_array_size(data.inserted_slots);
+
+	for (uint32_t i = 0; i < block.nb_instructions; i++) {
+		uint32_t		instruction_index = block.first_instruction + i;
+		IR_Instruction&	instruction = function.instructions[instruction_index];
+
+		for_each_use(function, instruction, [&](uint32_t& register_id) {
+			register_id = get_leader(data, register_id);
+		});
+
+		if (instruction.opcode == IR_Opcode::COPY) {
+			replace(data, instruction, instruction.operands[0]);
+		}
+		else if (instruction.opcode == IR_Opcode::PHI) {
+			// Values coming from back edges aren't replaced yet, so some trivial phis of loops are missed
+			uint32_t value = invalid_register;
+			bool	 is_trivial = true;
+
+			for (uint32_t j = 0; j < instruction.operands[1] && is_trivial; j++) {
+				uint32_t incoming = function.operand_lists[instruction.operands[0] + 2 * j + 1];
+
+				if (incoming == instruction.destination || incoming == value) {
+					continue;
+				}
+				is_trivial = value == invalid_register;
+				value = incoming;
+			}
+
+			if (is_trivial && value != invalid_register) {
+				replace(data, instruction, value);
+			}
+		}
+		else if (is_pure(instruction.opcode)) {
+			if (is_commutative(instruction.opcode) && instruction.operands[0] > instruction.operands[1]) {
+				uint32_t operand = instruction.operands[0];
+				instruction.operands[0] = instruction.operands[1];
+				instruction.operands[1] = operand;
+			}
+
+			uint32_t slot = hash_instruction(instruction) & data.mask;
+
+			while (data.table[slot] != invalid_register) {
+				IR_Instruction& candidate = function.instructions[data.table[slot]];
+
+				if (are_equivalent(candidate, instruction)) {
+					break;
+				}
+				slot = (slot + 1) & data.mask;
+			}
+
+			if (data.table[slot] != invalid_register) {
+				replace(data, instruction, function.instructions[data.table[slot]].destination);
+			}
+			else {
+				data.table[slot] = instruction_index;
+				memory::array_push_back(data.inserted_slots, slot);
+			}
+		}
+	}
+
+	// @TODO use an explicit stack if the dominator tree can be deep enough to overflow the call stack
+	for (uint32_t child = block.first_dominated; child != invalid_block; child = function.blocks[child].next_dominated) {
+		number_block(data, child);
+	}
+
+	for (size_t i = memory::get_array_size(data.inserted_slots); i > nb_inserted_slots; i--) {
+		data.table[data.inserted_slots[i - 1]] = invalid_register;
+	}
+	memory::resize_array(data.inserted_slots, nb_inserted_slots);
+}
+
+bool f::number_values(IR_Function& function)
+{
+	ZoneScopedN("f::number_values");
+
+	core::Assert(function.is_ssa);
+
+	GVN_Data	data;
+	size_t		nb_registers = memory::get_array_size(function.registers);
+	size_t		nb_instructions = memory::get_array_size(function.instructions);
+	size_t		table_size = 16;
+
+	defer{
+		memory::release(data.replacements);
+		memory::release(data.table);
+		memory::release(data.inserted_slots);
+	};
+
+	while (table_size < 2 * nb_instructions) {
+		table_size *= 2;
+	}
+
+	data.function = &function;
+	data.mask = (uint32_t)table_size - 1;
+	data.modified = false;
+
+	memory::resize_array(data.replacements, nb_registers);
+	for (size_t i = 0; i < nb_registers; i++) {
+		data.replacements[i] = (uint32_t)i;
+	}
+	memory::resize_array(data.table, table_size);
+	for (size_t i = 0; i < table_size; i++) {
+		data.table[i] = invalid_register;
+	}
+
+	number_block(data, 0);
+
+	if (data.modified) {
+		// Uses that aren't dominated by the replaced instruction (values of phis coming from back edges)
+		for (size_t i = 0; i < nb_instructions; i++) {
+			for_each_use(function, function.instructions[i], [&](uint32_t& register_id) {
+				register_id = get_leader(data, register_id);
+			});
+		}
+
+		compact_function(function);
+	}
+	return data.modified;
+}
@@ -0,0 +1,561 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Sparse conditional constant propagation
+//
+// Registers start at TOP (no value seen yet) and can only go down to a constant then to BOTTOM (not a constant).
+// Blocks are visited only once one of their incoming edges becomes executable, so values coming from branches
+// that are never taken are ignored by phis.
+//
+// Integer constants are stored sign or zero extended to 64 bits depending of their type, FLOAT constants are stored
+// as double rounded to float. Operations are evaluated with the wrap around of their size, division by zero is
+// left to the runtime. Constant vectors have the same value in all lanes, they are stored and evaluated as a lane.
+
+using namespace fstd;
+
+using namespace f;
+
+enum class Lattice : uint8_t
+{
+	TOP,
+	CONSTANT,
+	BOTTOM
+};
+
+struct Lattice_Value
+{
+	Lattice			state;
+	IR_Immediate	value;
+};
+
+struct SCCP_Data
+{
+	IR_Function*					function;
+	memory::Array<Lattice_Value>	values;
+	memory::Array<uint32_t>			first_use;		// Instructions that use each register, indexed by first_use
+	memory::Array<uint32_t>			uses;
+	memory::Array<uint32_t>			instruction_block;
+	memory::Array<bool>				executable_blocks;
+	memory::Array<uint32_t>			first_edge;		// Edges of the block b are [first_edge[b], first_edge[b + 1][
+	memory::Array<bool>				executable_edges;	// Per edge, in the order of successors
+	memory::Array<uint32_t>			block_worklist;
+	memory::Array<uint32_t>			instruction_worklist;
+};
+
+static int64_t normalize_integer(int64_t value, Register::Type type)
+{
+	switch (get_register_size(type))
+	{
+	case 1:
+		return has_flag(type, Register::Type::UNSIGNED) ? (int64_t)(uint8_t)value : (int64_t)(int8_t)value;
+	case 2:
+		return has_flag(type, Register::Type::UNSIGNED) ? (int64_t)(uint16_t)value : (int64_t)(int16_t)value;
+	case 4:
+		return has_flag(type, Register::Type::UNSIGNED) ? (int64_t)(uint32_t)value : (int64_t)(int32_t)value;
+	default:
+		return value;
+	}
+}
+
+static double normalize_real(double value, Register::Type type)
+{
+	return has_flag(type, Register::Type::FLOAT) ? (double)(float)value : value;
+}
+
+// Return false if the operation can't be evaluated at compile time
+static bool evaluate(IR_Opcode opcode, Register::Type type, IR_Immediate a, IR_Immediate b, IR_Immediate& result)
+{
+	if (is_floating_point(type)) {
+		bool comparison = true;
+
+		switch (opcode)
+		{
+		case IR_Opcode::ADD:			result.real = a.real + b.real; comparison = false; break;
+		case IR_Opcode::SUB:			result.real = a.real - b.real; comparison = false; break;
+		case IR_Opcode::MUL:			result.real = a.real * b.real; comparison = false; break;
+		case IR_Opcode::DIV:			result.real = a.real / b.real; comparison = false; break; // IEEE 754 defines the division by zero
+		case IR_Opcode::NEG:			result.real = -a.real; comparison = false; break;
+		case IR_Opcode::EQUAL:			result.integer = a.real == b.real; break;
+		case IR_Opcode::NOT_EQUAL:		result.integer = a.real != b.real; break;
+		case IR_Opcode::LESS:			result.integer = a.real < b.real; break;
+		case IR_Opcode::LESS_EQUAL:		result.integer = a.real <= b.real; break;
+		case IR_Opcode::GREATER:		result.integer = a.real > b.real; break;
+		case IR_Opcode::GREATER_EQUAL:	result.integer = a.real >= b.real; break;
+		default:
+			return false;
+		}
+
+		if (!comparison) {
+			result.real = normalize_real(result.real, type);
+		}
+		return true;
+	}
+
+	bool is_unsigned = has_flag(type, Register::Type::UNSIGNED) || has_flag(type, Register::Type::POINTER);
+	bool comparison = false;
+
+	switch (opcode)
+	{
+	case IR_Opcode::ADD:	result.integer = (int64_t)((uint64_t)a.integer + (uint64_t)b.integer); break;
+	case IR_Opcode::SUB:	result.integer = (int64_t)((uint64_t)a.integer - (uint64_t)b.integer); break;
+	case IR_Opcode::MUL:	result.integer = (int64_t)((uint64_t)a.integer * (uint64_t)b.integer); break;
+	case IR_Opcode::NEG:	result.integer = (int64_t)(0 - (uint64_t)a.integer); break;
+	case IR_Opcode::DIV:
+	case IR_Opcode::REM:
+		if (b.integer == 0 || (!is_unsigned && b.integer == -1 && a.integer == INT64_MIN)) {
+			return false;
+		}
+		if (is_unsigned) {
+			result.integer = (int64_t)(opcode == IR_Opcode::DIV ? (uint64_t)a.integer / (uint64_t)b.integer : (uint64_t)a.integer % (uint64_t)b.integer);
+		}
+		else {
+			result.integer = opcode == IR_Opcode::DIV ? a.integer / b.integer : a.integer % b.integer;
+		}
+		break;
+	case IR_Opcode::EQUAL:			result.integer = a.integer == b.integer; comparison = true; break;
+	case IR_Opcode::NOT_EQUAL:		result.integer = a.integer != b.integer; comparison = true; break;
+	case IR_Opcode::LESS:			result.integer = is_unsigned ? (uint64_t)a.integer < (uint64_t)b.integer : a.integer < b.integer; comparison = true; break;
+	case IR_Opcode::LESS_EQUAL:		result.integer = is_unsigned ? (uint64_t)a.integer <= (uint64_t)b.integer : a.integer <= b.integer; comparison = true; break;
+	case IR_Opcode::GREATER:		result.integer = is_unsigned ? (uint64_t)a.integer > (uint64_t)b.integer : a.integer > b.integer; comparison = true; break;
+	case IR_Opcode::GREATER_EQUAL:	result.integer = is_unsigned ? (uint64_t)a.integer >= (uint64_t)b.integer : a.integer >= b.integer; comparison = true; break;
+	default:
+		return false;
+	}
+
+	if (!comparison) {
+		result.integer = normalize_integer(result.integer, type);
+	}
+	return true;
+}
+
+static IR_Immediate convert_constant(IR_Immediate value, Register::Type from, Register::Type to)
+{
+	IR_Immediate result;
+
+	if (is_floating_point(from) && is_floating_point(to)) {
+		result.real = normalize_real(value.real, to);
+	}
+	else if (is_floating_point(from)) {
+		// @Warning out of range conversions are undefined in C++, x64 returns the "integer indefinite" value
+		if (value.real != value.real || value.real >= 9223372036854775808.0 || value.real < -9223372036854775808.0) {
+			result.integer = INT64_MIN;
+		}
+		else if (has_flag(to, Register::Type::UNSIGNED) && value.real >= 0) {
+			result.integer = (int64_t)(uint64_t)value.real;
+		}
+		else {
+			result.integer = (int64_t)value.real;
+		}
+		result.integer = normalize_integer(result.integer, to);
+	}
+	else if (is_floating_point(to)) {
+		result.real = normalize_real(has_flag(from, Register::Type::UNSIGNED) ? (double)(uint64_t)value.integer : (double)value.integer, to);
+	}
+	else {
+		result.integer = normalize_integer(value.integer, to);
+	}
+	return result;
+}
+
+inline bool are_identical(const IR_Immediate& a, const IR_Immediate& b)
+{
+	return a.integer == b.integer; // Bitwise, so 0.0 and -0.0 aren't merged
+}
+
+static void set_value(SCCP_Data& data, uint32_t register_id, Lattice state, IR_Immediate value)
+{
+	Lattice_Value& current = data.values[register_id];
+
+	if (current.state == Lattice::BOTTOM || (current.state == state && (state != Lattice::CONSTANT || are_identical(current.value, value)))) {
+		return;
+	}
+
+	if (current.state == Lattice::CONSTANT && state == Lattice::CONSTANT) {
+		state = Lattice::BOTTOM; // Two different constants
+	}
+	if (state == Lattice::TOP) {
+		return;
+	}
+
+	current.state = state;
+	current.value = value;
+
+	for (uint32_t i = data.first_use[register_id]; i < data.first_use[register_id + 1]; i++) {
+		memory::array_push_back(data.instruction_worklist, data.uses[i]);
+	}
+}
+
+static bool is_edge_executable(SCCP_Data& data, uint32_t from, uint32_t to)
+{
+	const uint32_t* successors;
+	uint32_t nb_successors = get_successors(*data.function, data.function->blocks[from], successors);
+
+	for (uint32_t i = 0; i < nb_successors; i++) {
+		if (successors[i] == to && data.executable_edges[data.first_edge[from] + i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void mark_edge_executable(SCCP_Data& data, uint32_t from, uint32_t successor_index)
+{
+	const uint32_t* successors;
+	get_successors(*data.function, data.function->blocks[from], successors);
+
+	uint32_t	to = successors[successor_index];
+	bool&		is_executable = data.executable_edges[data.first_edge[from] + successor_index];
+
+	if (is_executable) {
+		return;
+	}
+	is_executable = true;
+
+	if (!data.executable_blocks[to]) {
+		data.executable_blocks[to] = true;
+		memory::array_push_back(data.block_worklist, to);
+	}
+	else {
+		// Only phis can change when a new edge reaches an already visited block
+		IR_Basic_Block& block = data.function->blocks[to];
+		for (uint32_t i = 0; i < block.nb_instructions && data.function->instructions[block.first_instruction + i].opcode == IR_Opcode::PHI; i++) {
+			memory::array_push_back(data.instruction_worklist, block.first_instruction + i);
+		}
+	}
+}
+
+static void visit_instruction(SCCP_Data& data, uint32_t instruction_index)
+{
+	IR_Function&	function = *data.function;
+	IR_Instruction&	instruction = function.instructions[instruction_index];
+	uint32_t		block_index = data.instruction_block[instruction_index];
+	IR_Immediate	result;
+
+	if (!data.executable_blocks[block_index]) {
+		return;
+	}
+
+	result.integer = 0;
+
+	switch (instruction.opcode)
+	{
+	case IR_Opcode::NOP:
+	case IR_Opcode::COUNTER:
+	case IR_Opcode::RETURN:
+		break;
+	case IR_Opcode::CONSTANT:
+		set_value(data, instruction.destination, Lattice::CONSTANT, instruction.immediate);
+		break;
+	case IR_Opcode::ADDRESS:
+	case IR_Opcode::FUNCTION_ADDRESS:
+		set_value(data, instruction.destination, Lattice::BOTTOM, result);
+		break;
+	case IR_Opcode::CALL:
+	case IR_Opcode::CALL_INDIRECT:
+		if (instruction.destination != invalid_register) {
+			set_value(data, instruction.destination, Lattice::BOTTOM, result);
+		}
+		break;
+	case IR_Opcode::PHI:
+	{
+		Lattice state = Lattice::TOP;
+
+		for (uint32_t i = 0; i < instruction.operands[1] && state != Lattice::BOTTOM; i++) {
+			uint32_t predecessor = function.operand_lists[instruction.operands[0] + 2 * i];
+			uint32_t value = function.operand_lists[instruction.operands[0] + 2 * i + 1];
+
+			if (!is_edge_executable(data, predecessor, block_index) || data.values[value].state == Lattice::TOP) {
+				continue;
+			}
+
+			if (data.values[value].state == Lattice::BOTTOM
+				|| (state == Lattice::CONSTANT && !are_identical(result, data.values[value].value))) {
+				state = Lattice::BOTTOM;
+			}
+			else {
+				state = Lattice::CONSTANT;
+				result = data.values[value].value;
+			}
+		}
+		set_value(data, instruction.destination, state, result);
+		break;
+	}
+	case IR_Opcode::JUMP:
+		mark_edge_executable(data, block_index, 0);
+		break;
+	case IR_Opcode::BRANCH:
+	{
+		Lattice_Value& condition = data.values[instruction.operands[0]];
+
+		if (condition.state == Lattice::CONSTANT) {
+			mark_edge_executable(data, block_index, condition.value.integer != 0 ? 0 : 1);
+		}
+		else if (condition.state == Lattice::BOTTOM) {
+			mark_edge_executable(data, block_index, 0);
+			mark_edge_executable(data, block_index, 1);
+		}
+		break;
+	}
+	case IR_Opcode::SWITCH:
+	{
+		Lattice_Value&	index = data.values[instruction.operands[0]];
+		uint32_t		nb_successors = instruction.immediate.targets[1];
+		const uint32_t*	table = memory::get_array_element(function.operand_lists, instruction.immediate.targets[0] + nb_successors);
+
+		// The index is checked before, an index out of the table comes from a path that isn't executable yet
+		if (index.state == Lattice::CONSTANT && (uint64_t)index.value.integer < table[0]) {
+			mark_edge_executable(data, block_index, table[1 + index.value.integer]);
+		}
+		else if (index.state == Lattice::BOTTOM) {
+			for (uint32_t i = 0; i < nb_successors; i++) {
+				mark_edge_executable(data, block_index, i);
+			}
+		}
+		break;
+	}
+	case IR_Opcode::COPY:
+		set_value(data, instruction.destination, data.values[instruction.operands[0]].state, data.values[instruction.operands[0]].value);
+		break;
+	case IR_Opcode::CONVERT:
+	{
+		Lattice_Value& source = data.values[instruction.operands[0]];
+
+		if (source.state == Lattice::CONSTANT) {
+			result = convert_constant(source.value, function.registers[instruction.operands[0]], get_lane_type(instruction.type));
+		}
+		set_value(data, instruction.destination, source.state, result);
+		break;
+	}
+	case IR_Opcode::EXTRACT:
+	case IR_Opcode::SHUFFLE:
+		set_value(data, instruction.destination, data.values[instruction.operands[0]].state, data.values[instruction.operands[0]].value);
+		break;
+	case IR_Opcode::INSERT:
+	{
+		Lattice_Value& a = data.values[instruction.operands[0]];
+		Lattice_Value& b = data.values[instruction.operands[1]];
+
+		if (a.state == Lattice::BOTTOM || b.state == Lattice::BOTTOM
+			|| (a.state == Lattice::CONSTANT && b.state == Lattice::CONSTANT && !are_identical(a.value, b.value))) {
+			set_value(data, instruction.destination, Lattice::BOTTOM, result);
+		}
+		else if (a.state == Lattice::CONSTANT && b.state == Lattice::CONSTANT) {
+			set_value(data, instruction.destination, Lattice::CONSTANT, a.value);
+		}
+		break;
+	}
+	default: // Arithmetic and comparisons
+	{
+		Lattice_Value&	a = data.values[instruction.operands[0]];
+		Lattice_Value	b;
+
+		if (instruction.operands[1] != invalid_register) {
+			b = data.values[instruction.operands[1]];
+		}
+		else {
+			b.state = Lattice::CONSTANT; // Unary operators
+			b.value.integer = 0;
+		}
+
+		if (a.state == Lattice::BOTTOM || b.state == Lattice::BOTTOM) {
+			set_value(data, instruction.destination, Lattice::BOTTOM, result);
+		}
+		else if (a.state == Lattice::CONSTANT && b.state == Lattice::CONSTANT) {
+			if (evaluate(instruction.opcode, get_lane_type(instruction.type), a.value, b.value, result)) {
+				set_value(data, instruction.destination, Lattice::CONSTANT, result);
+			}
+			else {
+				set_value(data, instruction.destination, Lattice::BOTTOM, result);
+			}
+		}
+		break;
+	}
+	}
+}
+
+bool f::propagate_constants(IR_Function& function)
+{
+	ZoneScopedN("f::propagate_constants");
+
+	core::Assert(function.is_ssa);
+
+	SCCP_Data	data;
+	size_t		nb_registers = memory::get_array_size(function.registers);
+	size_t		nb_instructions = memory::get_array_size(function.instructions);
+	size_t		nb_blocks = memory::get_array_size(function.blocks);
+
+	defer{
+		memory::release(data.values);
+		memory::release(data.first_use);
+		memory::release(data.uses);
+		memory::release(data.instruction_block);
+		memory::release(data.executable_blocks);
+		memory::release(data.first_edge);
+		memory::release(data.executable_edges);
+		memory::release(data.block_worklist);
+		memory::release(data.instruction_worklist);
+	};
+
+	data.function = &function;
+
+	// Initialization
+	{
+		memory::resize_array(data.values, nb_registers);
+		for (size_t i = 0; i < nb_registers; i++) {
+			data.values[i].state = i < function.nb_arguments ? Lattice::BOTTOM : Lattice::TOP;
+			data.values[i].value.integer = 0;
+		}
+
+		memory::resize_array(data.instruction_block, nb_instructions);
+		for (size_t i = 0; i < nb_blocks; i++) {
+			for (uint32_t j = 0; j < function.blocks[i].nb_instructions; j++) {
+				data.instruction_block[function.blocks[i].first_instruction + j] = (uint32_t)i;
+			}
+		}
+
+		memory::resize_array(data.executable_blocks, nb_blocks);
+		memory::resize_array(data.first_edge, nb_blocks + 1);
+		data.first_edge[0] = 0;
+		for (size_t i = 0; i < nb_blocks; i++) {
+			const uint32_t* successors;
+
+			data.executable_blocks[i] = false;
+			data.first_edge[i + 1] = data.first_edge[i] + get_successors(function, function.blocks[i], successors);
+		}
+
+		memory::resize_array(data.executable_edges, data.first_edge[nb_blocks]);
+		for (uint32_t i = 0; i < data.first_edge[nb_blocks]; i++) {
+			data.executable_edges[i] = false;
+		}
+
+		// Def-use chains
+		memory::resize_array(data.first_use, nb_registers + 1);
+		for (size_t i = 0; i <= nb_registers; i++) {
+			data.first_use[i] = 0;
+		}
+		for (size_t i = 0; i < nb_instructions; i++) {
+			for_each_use(function, function.instructions[i], [&](uint32_t& register_id) {
+				data.first_use[register_id + 1]++;
+			});
+		}
+		for (size_t i = 0; i < nb_registers; i++) {
+			data.first_use[i + 1] += data.first_use[i];
+		}
+		memory::resize_array(data.uses, data.first_use[nb_registers]);
+		for (size_t i = 0; i < nb_instructions; i++) {
+			for_each_use(function, function.instructions[i], [&](uint32_t& register_id) {
+				data.uses[data.first_use[register_id]++] = (uint32_t)i;
+			});
+		}
+		for (size_t i = nb_registers; i > 0; i--) {
+			data.first_use[i] = data.first_use[i - 1];
+		}
+		data.first_use[0] = 0;
+	}
+
+	data.executable_blocks[0] = true;
+	memory::array_push_back(data.block_worklist, (uint32_t)0);
+
+	while (!memory::is_array_empty(data.block_worklist) || !memory::is_array_empty(data.instruction_worklist)) {
+		while (!memory::is_array_empty(data.instruction_worklist)) {
+			uint32_t instruction_index = *memory::get_array_last_element(data.instruction_worklist);
+
+			memory::resize_array(data.instruction_worklist, memory::get_array_size(data.instruction_worklist) - 1);
+			visit_instruction(data, instruction_index);
+		}
+
+		if (!memory::is_array_empty(data.block_worklist)) {
+			uint32_t block_index = *memory::get_array_last_element(data.block_worklist);
+
+			memory::resize_array(data.block_worklist, memory::get_array_size(data.block_worklist) - 1);
+
+			IR_Basic_Block& block = function.blocks[block_index];
+			for (uint32_t i = 0; i < block.nb_instructions; i++) {
+				visit_instruction(data, block.first_instruction + i);
+			}
+		}
+	}
+
+	// Rewrite
+	bool modified = false;
+
+	for (size_t block_index = 0; block_index < nb_blocks; block_index++) {
+		IR_Basic_Block& block = function.blocks[block_index];
+
+		if (!data.executable_blocks[block_index]) {
+			// Never executed, it will be removed by the compaction
+			modified = true;
+			continue;
+		}
+
+		for (uint32_t i = 0; i < block.nb_instructions; i++) {
+			IR_Instruction& instruction = function.instructions[block.first_instruction + i];
+
+			if (instruction.opcode == IR_Opcode::PHI) {
+				// Values coming from edges that are never taken are removed
+				uint32_t nb_values = 0;
+
+				for (uint32_t j = 0; j < instruction.operands[1]; j++) {
+					uint32_t predecessor = function.operand_lists[instruction.operands[0] + 2 * j];
+
+					if (is_edge_executable(data, predecessor, (uint32_t)block_index)) {
+						function.operand_lists[instruction.operands[0] + 2 * nb_values] = predecessor;
+						function.operand_lists[instruction.operands[0] + 2 * nb_values + 1] = function.operand_lists[instruction.operands[0] + 2 * j + 1];
+						nb_values++;
+					}
+				}
+				modified |= nb_values != instruction.operands[1];
+				instruction.operands[1] = nb_values;
+			}
+
+			if (instruction.opcode != IR_Opcode::CONSTANT && !is_call(instruction.opcode)
+				&& instruction.destination != invalid_register && data.values[instruction.destination].state == Lattice::CONSTANT) {
+				// The compaction moves phis back to the beginning of their block
+				instruction.opcode = IR_Opcode::CONSTANT;
+				instruction.type = function.registers[instruction.destination]; // Comparisons are typed by their operands
+				instruction.immediate = data.values[instruction.destination].value;
+				instruction.operands[0] = invalid_register;
+				instruction.operands[1] = invalid_register;
+				modified = true;
+			}
+		}
+	}
+
+	// Branches are rewritten after phis, as is_edge_executable relies on successors of blocks
+	for (size_t block_index = 0; block_index < nb_blocks; block_index++) {
+		IR_Basic_Block& block = function.blocks[block_index];
+		IR_Instruction& terminator = function.instructions[block.first_instruction + block.nb_instructions - 1];
+
+		if (data.executable_blocks[block_index] && terminator.opcode == IR_Opcode::BRANCH
+			&& data.values[terminator.operands[0]].state == Lattice::CONSTANT) {
+			terminator.immediate.targets[0] = terminator.immediate.targets[data.values[terminator.operands[0]].value.integer != 0 ? 0 : 1];
+			terminator.opcode = IR_Opcode::JUMP;
+			terminator.operands[0] = invalid_register;
+			modified = true;
+		}
+		else if (data.executable_blocks[block_index] && terminator.opcode == IR_Opcode::SWITCH
+			&& data.values[terminator.operands[0]].state == Lattice::CONSTANT) {
+			uint32_t	first_operand = terminator.immediate.targets[0];
+			uint32_t	nb_successors = terminator.immediate.targets[1];
+			uint64_t	index = (uint64_t)data.values[terminator.operands[0]].value.integer;
+
+			if (index < function.operand_lists[first_operand + nb_successors]) {
+				terminator.immediate.targets[0] = function.operand_lists[first_operand + function.operand_lists[first_operand + nb_successors + 1 + index]];
+				terminator.immediate.targets[1] = 0;
+				terminator.opcode = IR_Opcode::JUMP;
+				terminator.operands[0] = invalid_register;
+				modified = true;
+			}
+		}
+	}
+
+	if (modified) {
+		compact_function(function);
+	}
+	return modified;
+}
@@ -0,0 +1,418 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Registers written only once (temporaries) are already in SSA form, only registers of variables are renamed.
+//
+// Variables are initialized with 0 at the entry of the function, so phis always have a value even on paths where
+// the variable isn't defined yet. The language initializes all variables, so those values are never observed and
+// dead code elimination removes them.
+
+using namespace fstd;
+
+using namespace f;
+
+struct Phi_Request
+{
+	uint32_t	block;
+	uint32_t	variable;
+};
+
+struct Renaming_Undo
+{
+	uint32_t	variable;
+	uint32_t	previous_definition;
+};
+
+struct SSA_Builder
+{
+	IR_Function*					function;
+	uint32_t						nb_variables_registers;	// Number of registers before the renaming
+	memory::Array<bool>				is_variable;
+	memory::Array<uint32_t>			current_definition;
+	memory::Array<Renaming_Undo>	undo_log;
+};
+
+inline bool is_variable(SSA_Builder& builder, uint32_t register_id)
+{
+	return register_id < builder.nb_variables_registers && builder.is_variable[register_id];
+}
+
+static void define(SSA_Builder& builder, uint32_t& register_id)
+{
+	IR_Function&	function = *builder.function;
+	Renaming_Undo	undo;
+
+	undo.variable = register_id;
+	undo.previous_definition = builder.current_definition[register_id];
+	memory::array_push_back(builder.undo_log, undo);
+
+	memory::array_push_back(function.registers, function.registers[register_id]);
+	builder.current_definition[register_id] = (uint32_t)memory::get_array_size(function.registers) - 1;
+	register_id = builder.current_definition[register_id];
+}
+
+static void rename_block(SSA_Builder& builder, uint32_t block_index)
+{
+	IR_Function&	function = *builder.function;
+	IR_Basic_Block&	block = function.blocks[block_index];
+	size_t			undo_log_size = memory::get_array_size(builder.undo_log);
+
+	for (uint32_t i = 0; i < block.nb_instructions; i++) {
+		IR_Instruction& instruction = function.instructions[block.first_instruction + i];
+
+		// Values of phis are renamed by their predecessors
+		if (instruction.opcode != IR_Opcode::PHI) {
+			for_each_use(function, instruction, [&](uint32_t& register_id) {
+				if (is_variable(builder, register_id)) {
+					core::Assert(builder.current_definition[register_id] != invalid_register);
+					register_id = builder.current_definition[register_id];
+				}
+			});
+		}
+
+		if (instruction.destination != invalid_register && is_variable(builder, instruction.destination)) {
+			define(builder, instruction.destination);
+		}
+	}
+
+	const uint32_t* successors;
+	uint32_t nb_successors = get_successors(function, block, successors);
+
+	for (uint32_t i = 0; i < nb_successors; i++) {
+		IR_Basic_Block& successor = function.blocks[successors[i]];
+
+		for (uint32_t j = 0; j < successor.nb_instructions; j++) {
+			IR_Instruction& phi = function.instructions[successor.first_instruction + j];
+
+			if (phi.opcode != IR_Opcode::PHI) {
+				break;
+			}
+
+			for (uint32_t k = 0; k < phi.operands[1]; k++) {
+				uint32_t& value = function.operand_lists[phi.operands[0] + 2 * k + 1];
+
+				if (function.operand_lists[phi.operands[0] + 2 * k] == block_index && is_variable(builder, value)) {
+					value = builder.current_definition[value];
+				}
+			}
+		}
+	}
+
+	// @TODO use an explicit stack if the dominator tree can be deep enough to overflow the call stack
+	for (uint32_t child = block.first_dominated; child != invalid_block; child = function.blocks[child].next_dominated) {
+		rename_block(builder, child);
+	}
+
+	for (size_t i = memory::get_array_size(builder.undo_log); i > undo_log_size; i--) {
+		Renaming_Undo& undo = builder.undo_log[i - 1];
+		builder.current_definition[undo.variable] = undo.previous_definition;
+	}
+	memory::resize_array(builder.undo_log, undo_log_size);
+}
+
+void f::build_ssa(IR_Function& function)
+{
+	ZoneScopedN("f::build_ssa");
+
+	if (function.is_ssa) {
+		return;
+	}
+
+	compact_function(function); // Unreachable blocks don't have dominators
+
+	core::Assert(function.blocks[0].nb_predecessors == 0); // The entry can't have phis
+
+	uint32_t						nb_registers = (uint32_t)memory::get_array_size(function.registers);
+	uint32_t						nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	SSA_Builder						builder;
+	memory::Array<uint32_t>			nb_definitions;
+	memory::Array<uint32_t>			definition_blocks;		// Blocks that define each variable, indexed by first_definition_block
+	memory::Array<uint32_t>			first_definition_block;
+	memory::Array<uint32_t>			frontiers;				// Dominance frontiers, indexed by first_frontier
+	memory::Array<uint32_t>			first_frontier;
+	memory::Array<uint32_t>			marks;
+	memory::Array<uint32_t>			worklist;
+	memory::Array<Phi_Request>		phis;
+
+	defer{
+		memory::release(builder.is_variable);
+		memory::release(builder.current_definition);
+		memory::release(builder.undo_log);
+		memory::release(nb_definitions);
+		memory::release(definition_blocks);
+		memory::release(first_definition_block);
+		memory::release(frontiers);
+		memory::release(first_frontier);
+		memory::release(marks);
+		memory::release(worklist);
+		memory::release(phis);
+	};
+
+	builder.function = &function;
+	builder.nb_variables_registers = nb_registers;
+
+	// Variables are registers written more than once, arguments are written by the caller
+	bool has_variables = false;
+	{
+		memory::resize_array(nb_definitions, nb_registers);
+		for (uint32_t i = 0; i < nb_registers; i++) {
+			nb_definitions[i] = i < function.nb_arguments ? 1 : 0;
+		}
+		for (size_t i = 0; i < memory::get_array_size(function.instructions); i++) {
+			if (function.instructions[i].destination != invalid_register) {
+				nb_definitions[function.instructions[i].destination]++;
+			}
+		}
+
+		memory::resize_array(builder.is_variable, nb_registers);
+		for (uint32_t i = 0; i < nb_registers; i++) {
+			builder.is_variable[i] = nb_definitions[i] > 1;
+			has_variables |= builder.is_variable[i];
+		}
+	}
+
+	if (!has_variables) {
+		function.is_ssa = true;
+		return;
+	}
+
+	memory::resize_array(marks, nb_registers > nb_blocks ? nb_registers : nb_blocks);
+
+	// Blocks that define each variable (without duplicates)
+	{
+		memory::resize_array(first_definition_block, nb_registers + 1);
+		for (uint32_t i = 0; i < nb_registers; i++) {
+			first_definition_block[i] = 0;
+			marks[i] = invalid_block;
+		}
+
+		for (int pass = 0; pass < 2; pass++) { // Count then fill
+			for (uint32_t i = 0; i < nb_registers; i++) {
+				marks[i] = invalid_block;
+			}
+			for (uint32_t i = 0; i < function.nb_arguments; i++) {
+				if (builder.is_variable[i]) {
+					if (pass == 0) first_definition_block[i]++;
+					else definition_blocks[first_definition_block[i]++] = 0;
+					marks[i] = 0;
+				}
+			}
+			for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+				IR_Basic_Block& block = function.blocks[block_index];
+
+				for (uint32_t i = 0; i < block.nb_instructions; i++) {
+					uint32_t destination = function.instructions[block.first_instruction + i].destination;
+
+					if (destination != invalid_register && builder.is_variable[destination] && marks[destination] != block_index) {
+						if (pass == 0) first_definition_block[destination]++;
+						else definition_blocks[first_definition_block[destination]++] = block_index;
+						marks[destination] = block_index;
+					}
+				}
+			}
+
+			if (pass == 0) {
+				// Counts to start positions
+				uint32_t position = 0;
+				for (uint32_t i = 0; i < nb_registers; i++) {
+					uint32_t count = first_definition_block[i];
+					first_definition_block[i] = position;
+					position += count;
+				}
+				first_definition_block[nb_registers] = position;
+				memory::resize_array(definition_blocks, position);
+			}
+			else {
+				// The fill moved start positions to the end of each range
+				for (uint32_t i = nb_registers; i > 0; i--) {
+					first_definition_block[i] = first_definition_block[i - 1];
+				}
+				first_definition_block[0] = 0;
+			}
+		}
+	}
+
+	// Dominance frontiers: a join block is in the frontier of its predecessors and their dominators
+	// until its immediate dominator
+	{
+		memory::resize_array(first_frontier, nb_blocks + 1);
+
+		for (int pass = 0; pass < 2; pass++) { // Count then fill
+			for (uint32_t i = 0; i < nb_blocks; i++) {
+				marks[i] = invalid_block;
+				if (pass == 0) first_frontier[i] = 0;
+			}
+
+			for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+				IR_Basic_Block& block = function.blocks[block_index];
+
+				if (block.nb_predecessors < 2) {
+					continue;
+				}
+
+				for (uint32_t i = 0; i < block.nb_predecessors; i++) {
+					for (uint32_t runner = function.predecessors[block.first_predecessor + i];
+						runner != block.immediate_dominator && marks[runner] != block_index;
+						runner = function.blocks[runner].immediate_dominator) {
+						if (pass == 0) first_frontier[runner]++;
+						else frontiers[first_frontier[runner]++] = block_index;
+						marks[runner] = block_index;
+					}
+				}
+			}
+
+			if (pass == 0) {
+				uint32_t position = 0;
+				for (uint32_t i = 0; i < nb_blocks; i++) {
+					uint32_t count = first_frontier[i];
+					first_frontier[i] = position;
+					position += count;
+				}
+				first_frontier[nb_blocks] = position;
+				memory::resize_array(frontiers, position);
+			}
+			else {
+				for (uint32_t i = nb_blocks; i > 0; i--) {
+					first_frontier[i] = first_frontier[i - 1];
+				}
+				first_frontier[0] = 0;
+			}
+		}
+	}
+
+	// Phi insertion on the iterated dominance frontier of definitions
+	{
+		memory::Array<uint32_t> in_worklist;
+
+		defer{ memory::release(in_worklist); };
+
+		memory::resize_array(in_worklist, nb_blocks);
+		for (uint32_t i = 0; i < nb_blocks; i++) {
+			marks[i] = invalid_register;	// Last variable that got a phi in the block
+			in_worklist[i] = invalid_register;
+		}
+
+		for (uint32_t variable = 0; variable < nb_registers; variable++) {
+			if (!builder.is_variable[variable]) {
+				continue;
+			}
+
+			memory::resize_array(worklist, 0);
+			for (uint32_t i = first_definition_block[variable]; i < first_definition_block[variable + 1]; i++) {
+				memory::array_push_back(worklist, definition_blocks[i]);
+				in_worklist[definition_blocks[i]] = variable;
+			}
+
+			while (!memory::is_array_empty(worklist)) {
+				uint32_t block_index = *memory::get_array_last_element(worklist);
+				memory::resize_array(worklist, memory::get_array_size(worklist) - 1);
+
+				for (uint32_t i = first_frontier[block_index]; i < first_frontier[block_index + 1]; i++) {
+					uint32_t frontier = frontiers[i];
+
+					if (marks[frontier] != variable) {
+						Phi_Request phi;
+						phi.block = frontier;
+						phi.variable = variable;
+						memory::array_push_back(phis, phi);
+						marks[frontier] = variable;
+
+						if (in_worklist[frontier] != variable) {
+							in_worklist[frontier] = variable;
+							memory::array_push_back(worklist, frontier);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Rebuild the arena with phis at the beginning of blocks, and the initialization of variables at the entry
+	{
+		memory::Array<IR_Instruction>	instructions;
+		memory::Array<uint32_t>			nb_phis;
+
+		defer{ memory::release(nb_phis); };
+
+		memory::resize_array(builder.current_definition, nb_registers);
+		memory::resize_array(nb_phis, nb_blocks);
+		for (uint32_t i = 0; i < nb_blocks; i++) {
+			nb_phis[i] = 0;
+		}
+		for (size_t i = 0; i < memory::get_array_size(phis); i++) {
+			nb_phis[phis[i].block]++;
+		}
+
+		memory::reserve_array(instructions, memory::get_array_size(function.instructions) + memory::get_array_size(phis) + nb_registers);
+
+		for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+			IR_Basic_Block&	block = function.blocks[block_index];
+			uint32_t		first_instruction = (uint32_t)memory::get_array_size(instructions);
+
+			if (block_index == 0) {
+				for (uint32_t variable = 0; variable < nb_registers; variable++) {
+					builder.current_definition[variable] = variable < function.nb_arguments ? variable : invalid_register;
+
+					if (builder.is_variable[variable] && variable >= function.nb_arguments) {
+						IR_Instruction initialization;
+
+						memory::array_push_back(function.registers, function.registers[variable]);
+						initialization.opcode = IR_Opcode::CONSTANT;
+						initialization.type = function.registers[variable];
+						initialization.destination = (uint32_t)memory::get_array_size(function.registers) - 1;
+						initialization.operands[0] = invalid_register;
+						initialization.operands[1] = invalid_register;
+						initialization.immediate.integer = 0;
+						memory::array_push_back(instructions, initialization);
+
+						builder.current_definition[variable] = initialization.destination;
+					}
+				}
+			}
+
+			// @SpeedUp phis are grouped by variable, not by block
+			if (nb_phis[block_index]) {
+				for (size_t i = 0; i < memory::get_array_size(phis); i++) {
+					if (phis[i].block != block_index) {
+						continue;
+					}
+
+					IR_Instruction	phi;
+					uint32_t		first_operand = (uint32_t)memory::get_array_size(function.operand_lists);
+
+					memory::resize_array(function.operand_lists, first_operand + 2 * block.nb_predecessors);
+					for (uint32_t j = 0; j < block.nb_predecessors; j++) {
+						function.operand_lists[first_operand + 2 * j] = function.predecessors[block.first_predecessor + j];
+						function.operand_lists[first_operand + 2 * j + 1] = phis[i].variable;
+					}
+
+					phi.opcode = IR_Opcode::PHI;
+					phi.type = function.registers[phis[i].variable];
+					phi.destination = phis[i].variable;
+					phi.operands[0] = first_operand;
+					phi.operands[1] = block.nb_predecessors;
+					phi.immediate.integer = 0;
+					memory::array_push_back(instructions, phi);
+				}
+			}
+
+			memory::array_copy(instructions, memory::get_array_size(instructions), memory::get_array_element(function.instructions, block.first_instruction), block.nb_instructions);
+
+			block.first_instruction = first_instruction;
+			block.nb_instructions = (uint32_t)memory::get_array_size(instructions) - first_instruction;
+		}
+
+		memory::release(function.instructions);
+		function.instructions = instructions;
+	}
+
+	memory::resize_array(builder.current_definition, nb_registers);
+	rename_block(builder, 0);
+
+	function.is_ssa = true;
+}
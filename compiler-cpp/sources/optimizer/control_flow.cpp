@@ -0,0 +1,389 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+using namespace fstd;
+
+using namespace f;
+
+// Write reachable blocks in post order, the first one is the last of the post order
+static void compute_post_order(IR_Function& function, memory::Array<uint32_t>& post_order)
+{
+	struct DFS_Entry
+	{
+		uint32_t	block;
+		uint32_t	next_successor;
+	};
+
+	size_t						nb_blocks = memory::get_array_size(function.blocks);
+	memory::Array<DFS_Entry>	stack;
+	memory::Array<bool>			visited;
+
+	defer{
+		memory::release(stack);
+		memory::release(visited);
+	};
+
+	memory::resize_array(post_order, 0);
+	memory::reserve_array(post_order, nb_blocks);	// A block is visited once
+	memory::reserve_array(stack, nb_blocks);
+	memory::resize_array(visited, nb_blocks);
+	for (size_t i = 0; i < nb_blocks; i++) {
+		visited[i] = false;
+	}
+
+	DFS_Entry entry;
+	entry.block = 0;
+	entry.next_successor = 0;
+	memory::array_push_back_unchecked(stack, entry);
+	visited[0] = true;
+
+	while (!memory::is_array_empty(stack)) {
+		DFS_Entry*		top = memory::get_array_last_element(stack);
+		const uint32_t*	successors;
+		uint32_t		nb_successors = get_successors(function, function.blocks[top->block], successors);
+
+		if (top->next_successor < nb_successors) {
+			uint32_t successor = successors[top->next_successor++];
+
+			if (!visited[successor]) {
+				DFS_Entry new_entry;
+				new_entry.block = successor;
+				new_entry.next_successor = 0;
+				visited[successor] = true;
+				memory::array_push_back_unchecked(stack, new_entry);
+			}
+		}
+		else {
+			memory::array_push_back_unchecked(post_order, top->block);
+			memory::resize_array(stack, memory::get_array_size(stack) - 1);
+		}
+	}
+}
+
+void f::compute_control_flow(IR_Function& function, memory::Array<uint32_t>* reverse_post_order)
+{
+	ZoneScopedN("f::compute_control_flow");
+
+	size_t					nb_blocks = memory::get_array_size(function.blocks);
+	memory::Array<uint32_t>	post_order;
+	memory::Array<uint32_t>	post_order_index;	// invalid_block for unreachable blocks
+
+	defer{
+		memory::release(post_order);
+		memory::release(post_order_index);
+	};
+
+	compute_post_order(function, post_order);
+
+	memory::resize_array(post_order_index, nb_blocks);
+	for (size_t i = 0; i < nb_blocks; i++) {
+		post_order_index[i] = invalid_block;
+	}
+	for (size_t i = 0; i < memory::get_array_size(post_order); i++) {
+		post_order_index[post_order[i]] = (uint32_t)i;
+	}
+
+	// Predecessors, only edges coming from reachable blocks are kept
+	{
+		for (size_t i = 0; i < nb_blocks; i++) {
+			function.blocks[i].nb_predecessors = 0;
+			function.blocks[i].immediate_dominator = invalid_block;
+			function.blocks[i].first_dominated = invalid_block;
+			function.blocks[i].next_dominated = invalid_block;
+		}
+
+		uint32_t nb_edges = 0;
+		for (size_t i = 0; i < nb_blocks; i++) {
+			const uint32_t* successors;
+			uint32_t nb_successors = post_order_index[i] == invalid_block ? 0 : get_successors(function, function.blocks[i], successors);
+
+			for (uint32_t j = 0; j < nb_successors; j++) {
+				function.blocks[successors[j]].nb_predecessors++;
+			}
+			nb_edges += nb_successors;
+		}
+
+		uint32_t first_predecessor = 0;
+		for (size_t i = 0; i < nb_blocks; i++) {
+			function.blocks[i].first_predecessor = first_predecessor;
+			first_predecessor += function.blocks[i].nb_predecessors;
+			function.blocks[i].nb_predecessors = 0; // Used as insertion position below
+		}
+
+		memory::resize_array(function.predecessors, nb_edges);
+		for (size_t i = 0; i < nb_blocks; i++) {
+			const uint32_t* successors;
+			uint32_t nb_successors = post_order_index[i] == invalid_block ? 0 : get_successors(function, function.blocks[i], successors);
+
+			for (uint32_t j = 0; j < nb_successors; j++) {
+				IR_Basic_Block& successor = function.blocks[successors[j]];
+				function.predecessors[successor.first_predecessor + successor.nb_predecessors++] = (uint32_t)i;
+			}
+		}
+	}
+
+	// Dominator tree, blocks are processed in reverse post order until a fixed point is reached
+	{
+		size_t	nb_reachable_blocks = memory::get_array_size(post_order);
+		bool	changed = true;
+
+		function.blocks[0].immediate_dominator = 0; // Temporary, to mark the entry as processed
+
+		while (changed) {
+			changed = false;
+
+			for (size_t i = nb_reachable_blocks - 1; i-- > 0;) { // Skip the entry that is the last of the post order
+				IR_Basic_Block&	block = function.blocks[post_order[i]];
+				uint32_t		new_dominator = invalid_block;
+
+				for (uint32_t j = 0; j < block.nb_predecessors; j++) {
+					uint32_t predecessor = function.predecessors[block.first_predecessor + j];
+
+					if (function.blocks[predecessor].immediate_dominator == invalid_block) {
+						continue; // Not processed yet
+					}
+
+					if (new_dominator == invalid_block) {
+						new_dominator = predecessor;
+						continue;
+					}
+
+					// Intersection, walk up the tree from the block with the lowest post order index
+					uint32_t a = predecessor;
+					uint32_t b = new_dominator;
+					while (a != b) {
+						while (post_order_index[a] < post_order_index[b]) {
+							a = function.blocks[a].immediate_dominator;
+						}
+						while (post_order_index[b] < post_order_index[a]) {
+							b = function.blocks[b].immediate_dominator;
+						}
+					}
+					new_dominator = a;
+				}
+
+				if (block.immediate_dominator != new_dominator) {
+					block.immediate_dominator = new_dominator;
+					changed = true;
+				}
+			}
+		}
+
+		function.blocks[0].immediate_dominator = invalid_block;
+
+		// Children are linked in reverse post order
+		for (size_t i = 0; i + 1 < nb_reachable_blocks; i++) {
+			uint32_t		block_index = post_order[i];
+			IR_Basic_Block&	dominator = function.blocks[function.blocks[block_index].immediate_dominator];
+
+			function.blocks[block_index].next_dominated = dominator.first_dominated;
+			dominator.first_dominated = block_index;
+		}
+	}
+
+	if (reverse_post_order) {
+		size_t nb_reachable_blocks = memory::get_array_size(post_order);
+
+		memory::resize_array(*reverse_post_order, nb_reachable_blocks);
+		for (size_t i = 0; i < nb_reachable_blocks; i++) {
+			(*reverse_post_order)[i] = post_order[nb_reachable_blocks - 1 - i];
+		}
+	}
+}
+
+bool f::dominates(const IR_Function& function, uint32_t dominator, uint32_t block)
+{
+	while (block != invalid_block) {
+		if (block == dominator) {
+			return true;
+		}
+		block = function.blocks[block].immediate_dominator;
+	}
+	return false;
+}
+
+// Natural loops, headers are visited in reverse post order so inner loops overwrite the blocks of outer ones
+void f::find_loops(const IR_Function& function, const memory::Array<uint32_t>& reverse_post_order,
+	memory::Array<uint32_t>& loop_header, memory::Array<uint32_t>& parent_loop_header)
+{
+	ZoneScopedN("f::find_loops");
+
+	size_t					nb_blocks = memory::get_array_size(function.blocks);
+	memory::Array<uint32_t>	visited_by;	// Header that visited the block last
+	memory::Array<uint32_t>	worklist;
+
+	defer{
+		memory::release(visited_by);
+		memory::release(worklist);
+	};
+
+	memory::resize_array(loop_header, nb_blocks);
+	memory::resize_array(parent_loop_header, nb_blocks);
+	memory::resize_array(visited_by, nb_blocks);
+	for (size_t i = 0; i < nb_blocks; i++) {
+		loop_header[i] = invalid_block;
+		parent_loop_header[i] = invalid_block;
+		visited_by[i] = invalid_block;
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(reverse_post_order); i++) {
+		uint32_t				header = reverse_post_order[i];
+		const IR_Basic_Block&	header_block = function.blocks[header];
+
+		memory::resize_array(worklist, 0);
+		for (uint32_t j = 0; j < header_block.nb_predecessors; j++) {
+			uint32_t predecessor = function.predecessors[header_block.first_predecessor + j];
+
+			if (dominates(function, header, predecessor) && predecessor != header) {
+				memory::array_push_back(worklist, predecessor);
+			}
+			else if (predecessor == header) {
+				visited_by[header] = header; // Self loop
+			}
+		}
+
+		if (memory::is_array_empty(worklist) && visited_by[header] != header) {
+			continue;
+		}
+
+		parent_loop_header[header] = loop_header[header];
+		loop_header[header] = header;
+		visited_by[header] = header;
+
+		while (!memory::is_array_empty(worklist)) {
+			uint32_t block_index = *memory::get_array_last_element(worklist);
+			memory::resize_array(worklist, memory::get_array_size(worklist) - 1);
+
+			if (visited_by[block_index] == header) {
+				continue;
+			}
+			visited_by[block_index] = header;
+			loop_header[block_index] = header;
+
+			const IR_Basic_Block& block = function.blocks[block_index];
+			for (uint32_t j = 0; j < block.nb_predecessors; j++) {
+				memory::array_push_back(worklist, function.predecessors[block.first_predecessor + j]);
+			}
+		}
+	}
+}
+
+void f::compact_function(IR_Function& function)
+{
+	ZoneScopedN("f::compact_function");
+
+	size_t							nb_blocks = memory::get_array_size(function.blocks);
+	memory::Array<uint32_t>			post_order;
+	memory::Array<uint32_t>			new_block_index;	// invalid_block for removed blocks
+	memory::Array<IR_Instruction>	instructions;
+	memory::Array<IR_Basic_Block>	blocks;
+	memory::Array<uint32_t>			operand_lists;
+
+	defer{
+		memory::release(post_order);
+		memory::release(new_block_index);
+	};
+
+	compute_post_order(function, post_order);
+
+	memory::resize_array(new_block_index, nb_blocks);
+	for (size_t i = 0; i < nb_blocks; i++) {
+		new_block_index[i] = invalid_block;
+	}
+	for (size_t i = 0; i < memory::get_array_size(post_order); i++) {
+		new_block_index[post_order[i]] = 0;
+	}
+
+	// The order of blocks is kept
+	uint32_t nb_new_blocks = 0;
+	for (size_t i = 0; i < nb_blocks; i++) {
+		if (new_block_index[i] != invalid_block) {
+			new_block_index[i] = nb_new_blocks++;
+		}
+	}
+
+	memory::reserve_array(instructions, memory::get_array_size(function.instructions));
+	memory::reserve_array(blocks, nb_new_blocks);
+	memory::reserve_array(operand_lists, memory::get_array_size(function.operand_lists));
+
+	for (size_t i = 0; i < nb_blocks; i++) {
+		if (new_block_index[i] == invalid_block) {
+			continue;
+		}
+
+		IR_Basic_Block& old_block = function.blocks[i];
+		IR_Basic_Block	block = old_block;
+
+		block.first_instruction = (uint32_t)memory::get_array_size(instructions);
+		block.nb_instructions = 0;
+
+		// Phis are moved first, passes can replace a phi by an other instruction
+		for (uint32_t j = 0; j < 2 * old_block.nb_instructions; j++) {
+			bool			phi_pass = j < old_block.nb_instructions;
+			IR_Instruction	instruction = function.instructions[old_block.first_instruction + j % old_block.nb_instructions];
+
+			if (instruction.opcode == IR_Opcode::NOP || (instruction.opcode == IR_Opcode::PHI) != phi_pass) {
+				continue;
+			}
+			else if (instruction.opcode == IR_Opcode::JUMP) {
+				instruction.immediate.targets[0] = new_block_index[instruction.immediate.targets[0]];
+			}
+			else if (instruction.opcode == IR_Opcode::BRANCH) {
+				instruction.immediate.targets[0] = new_block_index[instruction.immediate.targets[0]];
+				instruction.immediate.targets[1] = new_block_index[instruction.immediate.targets[1]];
+			}
+			else if (instruction.opcode == IR_Opcode::SWITCH) {
+				uint32_t first_operand = (uint32_t)memory::get_array_size(operand_lists);
+
+				memory::array_copy(operand_lists, first_operand, memory::get_array_data(function.operand_lists) + instruction.immediate.targets[0], get_switch_operand_list_size(function, instruction));
+				for (uint32_t k = 0; k < instruction.immediate.targets[1]; k++) {
+					operand_lists[first_operand + k] = new_block_index[operand_lists[first_operand + k]];
+				}
+				instruction.immediate.targets[0] = first_operand;
+			}
+			else if (is_call(instruction.opcode)) {
+				uint32_t first_operand = (uint32_t)memory::get_array_size(operand_lists);
+
+				memory::array_copy(operand_lists, first_operand, memory::get_array_data(function.operand_lists) + instruction.operands[0], instruction.operands[1]);
+				instruction.operands[0] = first_operand;
+			}
+			else if (instruction.opcode == IR_Opcode::PHI) {
+				// Values coming from removed blocks are dropped
+				uint32_t first_operand = (uint32_t)memory::get_array_size(operand_lists);
+				uint32_t nb_values = 0;
+
+				for (uint32_t k = 0; k < instruction.operands[1]; k++) {
+					uint32_t predecessor = function.operand_lists[instruction.operands[0] + 2 * k];
+
+					if (new_block_index[predecessor] != invalid_block) {
+						memory::array_push_back(operand_lists, new_block_index[predecessor]);
+						memory::array_push_back(operand_lists, function.operand_lists[instruction.operands[0] + 2 * k + 1]);
+						nb_values++;
+					}
+				}
+				instruction.operands[0] = first_operand;
+				instruction.operands[1] = nb_values;
+			}
+
+			memory::array_push_back(instructions, instruction);
+			block.nb_instructions++;
+		}
+
+		core::Assert(block.nb_instructions > 0 && is_terminator(memory::get_array_last_element(instructions)->opcode));
+		memory::array_push_back(blocks, block);
+	}
+
+	memory::release(function.instructions);
+	memory::release(function.blocks);
+	memory::release(function.operand_lists);
+	function.instructions = instructions;
+	function.blocks = blocks;
+	function.operand_lists = operand_lists;
+
+	compute_control_flow(function);
+}
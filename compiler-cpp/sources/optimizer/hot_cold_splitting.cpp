@@ -0,0 +1,100 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Hot/cold splitting
+//
+// Blocks that are unlikely to be executed are marked cold, the code generator moves them out of the function and
+// places them after the code of all functions, so the hot code is denser (fewer cache lines and pages). Blocks are
+// cold by static heuristics:
+//   - they call a function with the no_return modifier (exit, abort) or the cold modifier (error reporting),
+//   - with a profile, they were never executed,
+// then coldness is propagated: a block whose successors are all cold only leads to cold code, a block whose
+// predecessors are all cold is only reached from cold code. The entry block is always hot.
+//
+// Functions with the no_return or cold modifier are entirely placed with the cold code, their blocks aren't marked.
+
+using namespace fstd;
+
+using namespace f;
+
+static bool calls_cold_function(const IR& ir, const IR_Function& function, const IR_Basic_Block& block)
+{
+	for (uint32_t i = 0; i < block.nb_instructions; i++) {
+		const IR_Instruction& instruction = function.instructions[block.first_instruction + i];
+
+		if (instruction.opcode != IR_Opcode::CALL) {
+			continue;
+		}
+
+		const IR_Function& callee = ir.functions[instruction.immediate.index];
+
+		if (callee.is_no_return || callee.is_cold) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool f::find_cold_blocks(const IR& ir, IR_Function& function)
+{
+	ZoneScopedN("f::find_cold_blocks");
+
+	uint32_t	nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	bool		has_cold_blocks = false;
+
+	for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+		function.blocks[block_index].is_cold = false;
+	}
+
+	if (nb_blocks < 2 || function.is_no_return || function.is_cold) {
+		return false;
+	}
+
+	compute_control_flow(function);
+
+	for (uint32_t block_index = 1; block_index < nb_blocks; block_index++) {
+		IR_Basic_Block& block = function.blocks[block_index];
+
+		block.is_cold = (function.has_profile && block.count == 0) || calls_cold_function(ir, function, block);
+		has_cold_blocks |= block.is_cold;
+	}
+
+	if (!has_cold_blocks) {
+		return false;
+	}
+
+	// Blocks only become cold, so it terminates
+	bool modified = true;
+	while (modified) {
+		modified = false;
+
+		for (uint32_t block_index = 1; block_index < nb_blocks; block_index++) {
+			IR_Basic_Block& block = function.blocks[block_index];
+
+			if (block.is_cold) {
+				continue;
+			}
+
+			const uint32_t*	successors;
+			uint32_t		nb_successors = get_successors(function, block, successors);
+			bool			are_successors_cold = nb_successors > 0;
+			bool			are_predecessors_cold = block.nb_predecessors > 0;
+
+			for (uint32_t i = 0; i < nb_successors; i++) {
+				are_successors_cold &= function.blocks[successors[i]].is_cold;
+			}
+			for (uint32_t i = 0; i < block.nb_predecessors; i++) {
+				are_predecessors_cold &= function.blocks[function.predecessors[block.first_predecessor + i]].is_cold;
+			}
+
+			if (are_successors_cold || are_predecessors_cold) {
+				block.is_cold = true;
+				modified = true;
+			}
+		}
+	}
+	return true;
+}
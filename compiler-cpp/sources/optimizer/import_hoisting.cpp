@@ -0,0 +1,149 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Hoisting of the addresses of imported functions out of loops
+//
+// Imported functions are called with call [rip + IAT], so each call reads the address of the function in memory.
+// For calls done in loops the address is read once before the outermost loop (in the immediate dominator of its
+// header, that isn't in the loop), and calls become indirect calls through the register. The register allocator
+// keeps such a value in a non volatile register, so the loop doesn't read the IAT anymore.
+
+using namespace fstd;
+
+using namespace f;
+
+struct Hoisted_Address
+{
+	uint32_t	block;		// Where the address is read
+	uint32_t	callee;
+	uint32_t	address;	// Register
+};
+
+bool f::hoist_imported_function_addresses(const IR& ir, IR_Function& function)
+{
+	ZoneScopedN("f::hoist_imported_function_addresses");
+
+	core::Assert(function.is_ssa);
+
+	uint32_t						nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<uint32_t>			reverse_post_order;
+	memory::Array<uint32_t>			loop_header;
+	memory::Array<uint32_t>			parent_loop_header;
+	memory::Array<Hoisted_Address>	hoisted_addresses;
+
+	defer{
+		memory::release(reverse_post_order);
+		memory::release(loop_header);
+		memory::release(parent_loop_header);
+		memory::release(hoisted_addresses);
+	};
+
+	compute_control_flow(function, &reverse_post_order);
+	find_loops(function, reverse_post_order, loop_header, parent_loop_header);
+
+	for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+		uint32_t header = loop_header[block_index];
+
+		if (header == invalid_block) {
+			continue;
+		}
+		while (parent_loop_header[header] != invalid_block) {
+			header = parent_loop_header[header];
+		}
+
+		uint32_t		preheader = function.blocks[header].immediate_dominator;
+		IR_Basic_Block&	block = function.blocks[block_index];
+
+		if (preheader == invalid_block) {
+			continue; // The entry block is the header, there is nothing before the loop
+		}
+
+		for (uint32_t i = 0; i < block.nb_instructions; i++) {
+			IR_Instruction& instruction = function.instructions[block.first_instruction + i];
+
+			if (instruction.opcode != IR_Opcode::CALL || ir.functions[instruction.immediate.index].imported_function == nullptr) {
+				continue;
+			}
+
+			// @SpeedUp there are only a few imported functions called in loops
+			uint32_t address = invalid_register;
+			for (size_t j = 0; j < memory::get_array_size(hoisted_addresses); j++) {
+				if (hoisted_addresses[j].block == preheader && hoisted_addresses[j].callee == instruction.immediate.index) {
+					address = hoisted_addresses[j].address;
+					break;
+				}
+			}
+
+			if (address == invalid_register) {
+				Hoisted_Address hoisted_address;
+
+				memory::array_push_back(function.registers, Register::Type::QWORD | Register::Type::POINTER);
+				address = (uint32_t)memory::get_array_size(function.registers) - 1;
+
+				hoisted_address.block = preheader;
+				hoisted_address.callee = instruction.immediate.index;
+				hoisted_address.address = address;
+				memory::array_push_back(hoisted_addresses, hoisted_address);
+			}
+
+			// The address is put before the arguments, the old list is left unused
+			uint32_t first_operand = (uint32_t)memory::get_array_size(function.operand_lists);
+
+			memory::resize_array(function.operand_lists, first_operand + 1 + instruction.operands[1]);
+			function.operand_lists[first_operand] = address;
+			for (uint32_t j = 0; j < instruction.operands[1]; j++) {
+				function.operand_lists[first_operand + 1 + j] = function.operand_lists[instruction.operands[0] + j];
+			}
+
+			instruction.opcode = IR_Opcode::CALL_INDIRECT;
+			instruction.operands[0] = first_operand;
+			instruction.operands[1]++;
+		}
+	}
+
+	if (memory::is_array_empty(hoisted_addresses)) {
+		return false;
+	}
+
+	// Addresses are read before the terminator of their block
+	memory::Array<IR_Instruction> instructions;
+
+	memory::reserve_array(instructions, memory::get_array_size(function.instructions) + memory::get_array_size(hoisted_addresses));
+	for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+		IR_Basic_Block&	block = function.blocks[block_index];
+		uint32_t		first_instruction = (uint32_t)memory::get_array_size(instructions);
+
+		memory::array_copy(instructions, first_instruction, memory::get_array_element(function.instructions, block.first_instruction), block.nb_instructions - 1);
+
+		for (size_t i = 0; i < memory::get_array_size(hoisted_addresses); i++) {
+			if (hoisted_addresses[i].block != block_index) {
+				continue;
+			}
+
+			IR_Instruction function_address;
+
+			function_address.opcode = IR_Opcode::FUNCTION_ADDRESS;
+			function_address.type = Register::Type::QWORD | Register::Type::POINTER;
+			function_address.destination = hoisted_addresses[i].address;
+			function_address.operands[0] = invalid_register;
+			function_address.operands[1] = invalid_register;
+			function_address.immediate.integer = 0;
+			function_address.immediate.index = hoisted_addresses[i].callee;
+			memory::array_push_back(instructions, function_address);
+		}
+
+		memory::array_push_back(instructions, function.instructions[block.first_instruction + block.nb_instructions - 1]);
+
+		block.first_instruction = first_instruction;
+		block.nb_instructions = (uint32_t)memory::get_array_size(instructions) - first_instruction;
+	}
+
+	memory::release(function.instructions);
+	function.instructions = instructions;
+	return true;
+}
@@ -0,0 +1,512 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Inlining
+//
+// Functions are optimized bottom-up in the call graph (callees before their callers), so a callee is already
+// optimized, with its own calls inlined, when the inliner looks at its call sites. The order comes from the strongly
+// connected components of the call graph (Tarjan), functions of a component of more than one function or that call
+// themselves are recursive and never inlined.
+//
+// Cost model, the size of a function is its number of instructions (phis excluded):
+//   - a callee that isn't bigger than the call sequence (moves of arguments, call and move of the result) is always
+//     inlined, the code shrinks,
+//   - functions with the inline modifier are always inlined, functions with the no_inline modifier never,
+//   - other callees are inlined if their size is under the budget and the caller doesn't grow more than the
+//     growth limit (in percent of its size before inlining),
+//   - with a profile, call sites never executed have no budget and call sites executed at least as often as the
+//     caller (in loops) have twice the budget,
+//   - functions with the no_return or cold modifier are only inlined if they also have the inline modifier.
+//
+// The block of the call is split in two, the head continues with the entry of the callee and its returns jump to the
+// tail. Arguments are copied to the registers of the callee parameters, the result is a copy or a phi of the
+// returned values. Counts of the blocks of the callee are scaled to the number of executions of the call.
+
+using namespace fstd;
+
+using namespace f;
+
+struct Call_Graph_Frame
+{
+	uint32_t	function;
+	uint32_t	next_callee;	// In callees
+};
+
+void f::order_functions_bottom_up(const IR& ir, memory::Array<uint32_t>& order, memory::Array<bool>& is_recursive)
+{
+	ZoneScopedN("f::order_functions_bottom_up");
+
+	uint32_t						nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+	memory::Array<uint32_t>			first_callee;	// Edges of the call graph, the callees of f are [first_callee[f], first_callee[f + 1][
+	memory::Array<uint32_t>			callees;
+	memory::Array<uint32_t>			visit_index;
+	memory::Array<uint32_t>			lowlink;
+	memory::Array<bool>				on_stack;
+	memory::Array<uint32_t>			stack;
+	memory::Array<Call_Graph_Frame>	frames;
+
+	defer{
+		memory::release(first_callee);
+		memory::release(callees);
+		memory::release(visit_index);
+		memory::release(lowlink);
+		memory::release(on_stack);
+		memory::release(stack);
+		memory::release(frames);
+	};
+
+	memory::resize_array(order, 0);
+	memory::resize_array(is_recursive, nb_functions);
+	memory::resize_array(first_callee, nb_functions + 1);
+	memory::resize_array(visit_index, nb_functions);
+	memory::resize_array(lowlink, nb_functions);
+	memory::resize_array(on_stack, nb_functions);
+
+	for (uint32_t function_index = 0; function_index < nb_functions; function_index++) {
+		const IR_Function& function = ir.functions[function_index];
+
+		is_recursive[function_index] = false;
+		visit_index[function_index] = invalid_function;
+		on_stack[function_index] = false;
+		first_callee[function_index] = (uint32_t)memory::get_array_size(callees);
+
+		for (size_t i = 0; i < memory::get_array_size(function.instructions); i++) {
+			const IR_Instruction& instruction = function.instructions[i];
+
+			if (instruction.opcode != IR_Opcode::CALL || memory::is_array_empty(ir.functions[instruction.immediate.index].blocks)) {
+				continue;
+			}
+
+			memory::array_push_back(callees, instruction.immediate.index);
+			if (instruction.immediate.index == function_index) {
+				is_recursive[function_index] = true;
+			}
+		}
+	}
+	first_callee[nb_functions] = (uint32_t)memory::get_array_size(callees);
+
+	// Iterative version of Tarjan's algorithm, components are found callees first
+	uint32_t nb_visited_functions = 0;
+
+	auto visit = [&](uint32_t function_index) {
+		Call_Graph_Frame frame;
+
+		visit_index[function_index] = nb_visited_functions;
+		lowlink[function_index] = nb_visited_functions;
+		nb_visited_functions++;
+		on_stack[function_index] = true;
+		memory::array_push_back(stack, function_index);
+
+		frame.function = function_index;
+		frame.next_callee = first_callee[function_index];
+		memory::array_push_back(frames, frame);
+	};
+
+	for (uint32_t root = 0; root < nb_functions; root++) {
+		if (visit_index[root] != invalid_function || memory::is_array_empty(ir.functions[root].blocks)) {
+			continue;
+		}
+
+		visit(root);
+		while (!memory::is_array_empty(frames)) {
+			Call_Graph_Frame&	frame = *memory::get_array_last_element(frames);
+			uint32_t			function_index = frame.function;
+
+			if (frame.next_callee < first_callee[function_index + 1]) {
+				uint32_t callee = callees[frame.next_callee++];
+
+				if (visit_index[callee] == invalid_function) {
+					visit(callee);
+				}
+				else if (on_stack[callee] && visit_index[callee] < lowlink[function_index]) {
+					lowlink[function_index] = visit_index[callee];
+				}
+				continue;
+			}
+
+			memory::resize_array(frames, memory::get_array_size(frames) - 1);
+			if (!memory::is_array_empty(frames)) {
+				uint32_t caller = memory::get_array_last_element(frames)->function;
+
+				if (lowlink[function_index] < lowlink[caller]) {
+					lowlink[caller] = lowlink[function_index];
+				}
+			}
+
+			if (lowlink[function_index] != visit_index[function_index]) {
+				continue;
+			}
+
+			// function_index is the root of a component, its functions are on the top of the stack
+			size_t first_function = memory::get_array_size(order);
+
+			for (uint32_t member = invalid_function; member != function_index; ) {
+				member = *memory::get_array_last_element(stack);
+				memory::resize_array(stack, memory::get_array_size(stack) - 1);
+				on_stack[member] = false;
+				memory::array_push_back(order, member);
+			}
+
+			bool is_cycle = memory::get_array_size(order) - first_function > 1;
+			for (size_t i = first_function; is_cycle && i < memory::get_array_size(order); i++) {
+				is_recursive[order[i]] = true;
+			}
+		}
+	}
+}
+
+// Size used by the cost model
+static uint32_t get_function_size(const IR_Function& function)
+{
+	uint32_t size = 0;
+
+	for (size_t i = 0; i < memory::get_array_size(function.instructions); i++) {
+		IR_Opcode opcode = function.instructions[i].opcode;
+
+		if (opcode != IR_Opcode::NOP && opcode != IR_Opcode::PHI) {
+			size++;
+		}
+	}
+	return size;
+}
+
+static bool can_be_inlined(const IR_Function& callee, bool is_recursive)
+{
+	if (callee.inlining == Inlining::NEVER || is_recursive
+		|| callee.imported_function != nullptr || memory::is_array_empty(callee.blocks) || !callee.is_ssa) {
+		return false;
+	}
+
+	// The entry block becomes the successor of the head of the call, it can't have other predecessors.
+	// Functions that never return (infinite loops) are kept as calls.
+	bool has_return = false;
+
+	for (size_t block_index = 0; block_index < memory::get_array_size(callee.blocks); block_index++) {
+		const IR_Basic_Block&	block = callee.blocks[block_index];
+		const uint32_t*			successors;
+		uint32_t				nb_successors = get_successors(callee, block, successors);
+
+		for (uint32_t i = 0; i < nb_successors; i++) {
+			if (successors[i] == 0) {
+				return false;
+			}
+		}
+
+		if (callee.instructions[block.first_instruction + block.nb_instructions - 1].opcode == IR_Opcode::RETURN) {
+			has_return = true;
+		}
+	}
+	return has_return;
+}
+
+// The arena of the caller is rebuilt with the blocks: [0, block_index[, the blocks of the callee (the head is merged
+// with the entry of the callee), the tail, then the blocks after block_index. When the callee has only one return, the
+// tail is merged with the block of the return. The position of the first instruction after the call is returned.
+static void inline_call(IR_Function& caller, uint32_t block_index, uint32_t call_position, const IR_Function& callee,
+	uint32_t& tail_block, uint32_t& tail_position)
+{
+	IR_Instruction					call = caller.instructions[caller.blocks[block_index].first_instruction + call_position];
+	uint32_t						nb_caller_blocks = (uint32_t)memory::get_array_size(caller.blocks);
+	uint32_t						nb_callee_blocks = (uint32_t)memory::get_array_size(callee.blocks);
+	uint32_t						register_offset = (uint32_t)memory::get_array_size(caller.registers);
+	uint32_t						nb_returns = 0;
+	memory::Array<IR_Instruction>	instructions;
+	memory::Array<IR_Basic_Block>	blocks;
+	memory::Array<uint32_t>			returned_values;	// Pairs (block, value) of the phi of the result
+	uint64_t						nb_calls = caller.blocks[block_index].count;
+	uint64_t						nb_callee_calls = callee.blocks[0].count;
+
+	defer{ memory::release(returned_values); };
+
+	for (uint32_t callee_block = 0; callee_block < nb_callee_blocks; callee_block++) {
+		const IR_Basic_Block& block = callee.blocks[callee_block];
+
+		if (callee.instructions[block.first_instruction + block.nb_instructions - 1].opcode == IR_Opcode::RETURN) {
+			tail_block = block_index + callee_block;
+			nb_returns++;
+		}
+	}
+
+	bool		has_tail_block = nb_returns > 1;
+	uint32_t	block_shift = nb_callee_blocks - 1 + (has_tail_block ? 1 : 0);
+
+	if (has_tail_block) {
+		tail_block = block_index + nb_callee_blocks;
+	}
+
+	memory::reserve_array(instructions, memory::get_array_size(caller.instructions) + memory::get_array_size(callee.instructions) + callee.nb_arguments + 1);
+	memory::reserve_array(blocks, nb_caller_blocks + block_shift);
+
+	for (size_t i = 0; i < memory::get_array_size(callee.registers); i++) {
+		memory::array_push_back(caller.registers, callee.registers[i]);
+	}
+
+	auto map_block = [&](uint32_t block) -> uint32_t {
+		return block <= block_index ? block : block + block_shift;
+	};
+
+	auto begin_block = [&](uint64_t count, uint64_t taken_count) {
+		IR_Basic_Block block = IR_Basic_Block();
+
+		block.first_instruction = (uint32_t)memory::get_array_size(instructions);
+		block.immediate_dominator = invalid_block;
+		block.count = count;
+		block.taken_count = taken_count;
+		memory::array_push_back(blocks, block);
+	};
+
+	auto scale_count = [&](uint64_t count) -> uint64_t {
+		return nb_callee_calls ? (uint64_t)((double)count * (double)nb_calls / (double)nb_callee_calls) : 0;
+	};
+
+	auto end_block = [&]() {
+		IR_Basic_Block& block = *memory::get_array_last_element(blocks);
+
+		block.nb_instructions = (uint32_t)memory::get_array_size(instructions) - block.first_instruction;
+	};
+
+	auto emit = [&](IR_Opcode opcode, Register::Type type, uint32_t destination, uint32_t operand, uint32_t target) {
+		IR_Instruction instruction;
+
+		instruction.opcode = opcode;
+		instruction.type = type;
+		instruction.destination = destination;
+		instruction.operands[0] = operand;
+		instruction.operands[1] = invalid_register;
+		instruction.immediate.integer = 0;
+		instruction.immediate.targets[0] = target;
+		memory::array_push_back(instructions, instruction);
+	};
+
+	// Instructions of the caller keep their registers, only blocks are renumbered
+	auto copy_caller_instructions = [&](const IR_Basic_Block& block, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			IR_Instruction instruction = caller.instructions[block.first_instruction + i];
+
+			if (instruction.opcode == IR_Opcode::JUMP) {
+				instruction.immediate.targets[0] = map_block(instruction.immediate.targets[0]);
+			}
+			else if (instruction.opcode == IR_Opcode::BRANCH) {
+				instruction.immediate.targets[0] = map_block(instruction.immediate.targets[0]);
+				instruction.immediate.targets[1] = map_block(instruction.immediate.targets[1]);
+			}
+			else if (instruction.opcode == IR_Opcode::SWITCH) {
+				for (uint32_t j = 0; j < instruction.immediate.targets[1]; j++) {
+					uint32_t& successor = caller.operand_lists[instruction.immediate.targets[0] + j];
+
+					successor = map_block(successor);
+				}
+			}
+			else if (instruction.opcode == IR_Opcode::PHI) {
+				for (uint32_t j = 0; j < instruction.operands[1]; j++) {
+					uint32_t& predecessor = caller.operand_lists[instruction.operands[0] + 2 * j];
+
+					// The terminator of the block of the call is now in the tail
+					predecessor = predecessor == block_index ? tail_block : map_block(predecessor);
+				}
+			}
+			memory::array_push_back(instructions, instruction);
+		}
+	};
+
+	for (uint32_t caller_block = 0; caller_block < nb_caller_blocks; caller_block++) {
+		IR_Basic_Block block = caller.blocks[caller_block];
+
+		begin_block(block.count, block.taken_count);
+		if (caller_block != block_index) {
+			copy_caller_instructions(block, 0, block.nb_instructions);
+			end_block();
+			continue;
+		}
+
+		// Head, arguments are copied to the parameters of the callee
+		copy_caller_instructions(block, 0, call_position);
+		for (uint32_t i = 0; i < callee.nb_arguments; i++) {
+			emit(IR_Opcode::COPY, callee.registers[i], register_offset + i, caller.operand_lists[call.operands[0] + i], 0);
+		}
+
+		// Body of the callee
+		for (uint32_t callee_block = 0; callee_block < nb_callee_blocks; callee_block++) {
+			const IR_Basic_Block& source_block = callee.blocks[callee_block];
+
+			if (callee_block > 0) {
+				begin_block(scale_count(source_block.count), scale_count(source_block.taken_count));
+			}
+			else {
+				memory::get_array_last_element(blocks)->taken_count = scale_count(source_block.taken_count);
+			}
+
+			for (uint32_t i = 0; i < source_block.nb_instructions; i++) {
+				IR_Instruction instruction = callee.instructions[source_block.first_instruction + i];
+
+				if (instruction.opcode == IR_Opcode::RETURN) {
+					uint32_t returned_value = instruction.operands[0] == invalid_register ? invalid_register : instruction.operands[0] + register_offset;
+
+					if (has_tail_block) {
+						if (call.destination != invalid_register && returned_value != invalid_register) {
+							memory::array_push_back(returned_values, block_index + callee_block);
+							memory::array_push_back(returned_values, returned_value);
+						}
+						emit(IR_Opcode::JUMP, instruction.type, invalid_register, invalid_register, tail_block);
+					}
+					else {
+						if (call.destination != invalid_register && returned_value != invalid_register) {
+							emit(IR_Opcode::COPY, call.type, call.destination, returned_value, 0);
+						}
+						tail_position = (uint32_t)memory::get_array_size(instructions) - memory::get_array_last_element(blocks)->first_instruction;
+						copy_caller_instructions(block, call_position + 1, block.nb_instructions);
+						memory::get_array_last_element(blocks)->taken_count = block.taken_count; // Of the terminator of the caller
+					}
+					continue;
+				}
+
+				if (instruction.destination != invalid_register) {
+					instruction.destination += register_offset;
+				}
+
+				if (is_call(instruction.opcode) || instruction.opcode == IR_Opcode::PHI) {
+					uint32_t first_operand = (uint32_t)memory::get_array_size(caller.operand_lists);
+					uint32_t nb_operands = instruction.opcode == IR_Opcode::PHI ? 2 * instruction.operands[1] : instruction.operands[1];
+
+					memory::resize_array(caller.operand_lists, first_operand + nb_operands);
+					for (uint32_t j = 0; j < nb_operands; j++) {
+						uint32_t operand = callee.operand_lists[instruction.operands[0] + j];
+
+						if (instruction.opcode == IR_Opcode::PHI && j % 2 == 0) {
+							caller.operand_lists[first_operand + j] = operand + block_index;
+						}
+						else {
+							caller.operand_lists[first_operand + j] = operand + register_offset;
+						}
+					}
+					instruction.operands[0] = first_operand;
+				}
+				else if (instruction.opcode == IR_Opcode::SWITCH) {
+					uint32_t first_operand = (uint32_t)memory::get_array_size(caller.operand_lists);
+					uint32_t nb_operands = get_switch_operand_list_size(callee, instruction);
+
+					memory::array_copy(caller.operand_lists, first_operand, memory::get_array_data(callee.operand_lists) + instruction.immediate.targets[0], nb_operands);
+					for (uint32_t j = 0; j < instruction.immediate.targets[1]; j++) {
+						caller.operand_lists[first_operand + j] += block_index;
+					}
+					instruction.operands[0] += register_offset;
+					instruction.immediate.targets[0] = first_operand;
+				}
+				else {
+					for (uint32_t j = 0; j < 2; j++) {
+						if (instruction.operands[j] != invalid_register) {
+							instruction.operands[j] += register_offset;
+						}
+					}
+				}
+
+				if (instruction.opcode == IR_Opcode::JUMP) {
+					instruction.immediate.targets[0] += block_index;
+				}
+				else if (instruction.opcode == IR_Opcode::BRANCH) {
+					instruction.immediate.targets[0] += block_index;
+					instruction.immediate.targets[1] += block_index;
+				}
+				memory::array_push_back(instructions, instruction);
+			}
+			end_block();
+		}
+
+		if (!has_tail_block) {
+			continue;
+		}
+
+		// Tail, the result is a phi of the returned values
+		begin_block(block.count, block.taken_count);
+		if (!memory::is_array_empty(returned_values)) {
+			IR_Instruction	phi;
+			uint32_t		first_operand = (uint32_t)memory::get_array_size(caller.operand_lists);
+
+			memory::array_copy(caller.operand_lists, first_operand, memory::get_array_data(returned_values), memory::get_array_size(returned_values));
+
+			phi.opcode = IR_Opcode::PHI;
+			phi.type = call.type;
+			phi.destination = call.destination;
+			phi.operands[0] = first_operand;
+			phi.operands[1] = (uint32_t)memory::get_array_size(returned_values) / 2;
+			phi.immediate.integer = 0;
+			memory::array_push_back(instructions, phi);
+		}
+		tail_position = (uint32_t)memory::get_array_size(instructions) - memory::get_array_last_element(blocks)->first_instruction;
+		copy_caller_instructions(block, call_position + 1, block.nb_instructions);
+		end_block();
+	}
+
+	memory::release(caller.instructions);
+	memory::release(caller.blocks);
+	caller.instructions = instructions;
+	caller.blocks = blocks;
+}
+
+bool f::inline_calls(const IR& ir, IR_Function& caller, const memory::Array<bool>& is_recursive, uint32_t budget, uint32_t growth)
+{
+	ZoneScopedN("f::inline_calls");
+
+	core::Assert(caller.is_ssa);
+
+	uint32_t	size = get_function_size(caller);
+	uint64_t	max_size = (uint64_t)size * (100 + growth) / 100;
+	bool		modified = false;
+	uint32_t	block_index = 0;
+	uint32_t	position = 0;
+
+	while (block_index < memory::get_array_size(caller.blocks)) {
+		const IR_Basic_Block& block = caller.blocks[block_index];
+
+		if (position >= block.nb_instructions) {
+			block_index++;
+			position = 0;
+			continue;
+		}
+
+		const IR_Instruction& instruction = caller.instructions[block.first_instruction + position];
+
+		if (instruction.opcode != IR_Opcode::CALL
+			|| !can_be_inlined(ir.functions[instruction.immediate.index], is_recursive[instruction.immediate.index])) {
+			position++;
+			continue;
+		}
+
+		const IR_Function&	callee = ir.functions[instruction.immediate.index];
+		uint32_t			callee_size = get_function_size(callee);
+		bool				shrinks = callee_size <= callee.nb_arguments + 2;
+		uint32_t			call_budget = budget;
+
+		if (caller.has_profile && block.count == 0) {
+			call_budget = 0;
+		}
+		else if (caller.has_profile && block.count >= caller.blocks[0].count) {
+			call_budget = 2 * budget;
+		}
+
+		// Calls of unlikely functions stay calls, find_cold_blocks moves their blocks out of the hot code
+		bool is_unlikely = callee.is_no_return || callee.is_cold;
+
+		if (callee.inlining != Inlining::ALWAYS
+			&& (is_unlikely || (!shrinks && (callee_size > call_budget || size + callee_size > max_size)))) {
+			position++;
+			continue;
+		}
+
+		// Calls of the inlined code were already considered when the callee was optimized, the scan continues
+		// after the call
+		inline_call(caller, block_index, position, callee, block_index, position);
+		size += callee_size;
+		modified = true;
+	}
+
+	if (modified) {
+		compact_function(caller);
+	}
+	return modified;
+}
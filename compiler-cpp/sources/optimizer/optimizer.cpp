@@ -0,0 +1,218 @@
+#include "optimizer.hpp"
+
+#include "../globals.hpp"
+
+#include <fstd/core/logger.hpp>
+#include <fstd/core/string_builder.hpp>
+
+#include <fstd/language/defer.hpp>
+#include <fstd/language/string.hpp>
+
+#include <fstd/system/file.hpp>
+#include <fstd/system/timer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+using namespace fstd;
+using namespace fstd::core;
+
+using namespace f;
+
+struct Optimization_Pass
+{
+	const char*	name;
+	bool		(*run)(IR_Function& function); // Return true if the function was modified
+};
+
+// Passes are run in this order until none of them modify the function, or max_nb_iterations is reached.
+static const Optimization_Pass passes[] = {
+	{ "SCCP",	&propagate_constants },
+	{ "GVN",	&number_values },
+	{ "DCE",	&eliminate_dead_code },
+};
+
+static const uint32_t nb_passes = sizeof(passes) / sizeof(Optimization_Pass);
+static const uint32_t max_nb_iterations = 4;
+
+static void run_passes(IR_Function& function, uint64_t pass_times[nb_passes], uint32_t pass_nb_modifications[nb_passes])
+{
+	bool modified = true;
+	for (uint32_t iteration = 0; iteration < max_nb_iterations && modified; iteration++) {
+		modified = false;
+
+		for (uint32_t pass_index = 0; pass_index < nb_passes; pass_index++) {
+			ZoneScoped;
+			ZoneName(passes[pass_index].name, language::string_literal_size((uint8_t*)passes[pass_index].name));
+
+			uint64_t	start_time = system::get_time_in_nanoseconds();
+			bool		pass_modified = passes[pass_index].run(function);
+
+			pass_times[pass_index] += system::get_time_in_nanoseconds() - start_time;
+			if (pass_modified) {
+				pass_nb_modifications[pass_index]++;
+				modified = true;
+			}
+		}
+	}
+}
+
+// A profile that can't be read or that doesn't match the program is ignored
+static void load_profile(IR& ir, const char* profile_path)
+{
+	system::Path			path;
+	system::File			file;
+	memory::Array<uint8_t>	data;
+
+	defer{
+		system::reset_path(path);
+		memory::release(data);
+	};
+
+	system::from_native(path, (const uint8_t*)profile_path);
+
+	if (system::open_file(file, path, system::File::Opening_Flag::READ) == false) {
+		String_Builder		string_builder;
+		language::string	message;
+
+		defer{
+			free_buffers(string_builder);
+			release(message);
+		};
+
+		print_to_builder(string_builder, "Failed to open the profile: \"%v\", it is ignored.\n", to_string(path));
+
+		message = to_string(string_builder);
+		report_error(Compiler_Error::warning, (char*)to_utf8(message));
+		return;
+	}
+
+	data = system::get_file_content(file);
+	system::close_file(file);
+
+	if (apply_profile(ir, data) == false) {
+		report_error(Compiler_Error::warning, "The profile doesn't match the program (the source changed since it was generated), it is ignored.\n");
+	}
+}
+
+void f::optimize(IR& ir)
+{
+	ZoneScopedN("f::optimize");
+
+	uint64_t				ssa_construction_time = 0;
+	uint64_t				inlining_time = 0;
+	uint32_t				inlining_nb_modifications = 0;
+	uint64_t				import_hoisting_time = 0;
+	uint32_t				import_hoisting_nb_modifications = 0;
+	uint64_t				layout_time = 0;
+	uint32_t				layout_nb_modifications = 0;
+	uint64_t				splitting_time = 0;
+	uint32_t				splitting_nb_modifications = 0;
+	uint64_t				pass_times[nb_passes] = {};
+	uint32_t				pass_nb_modifications[nb_passes] = {};
+	memory::Array<uint32_t>	order;
+	memory::Array<bool>		is_recursive;
+
+	defer{
+		memory::release(order);
+		memory::release(is_recursive);
+	};
+
+	// All functions are in SSA form before inlining
+	{
+		ZoneScopedN("SSA construction");
+
+		uint64_t start_time = system::get_time_in_nanoseconds();
+		for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+			if (!memory::is_array_empty(ir.functions[i].blocks)) { // Imported functions don't have blocks
+				build_ssa(ir.functions[i]);
+			}
+		}
+		ssa_construction_time += system::get_time_in_nanoseconds() - start_time;
+	}
+
+	// Counters and counts are attached to the blocks of the SSA form, before optimizations change them
+	if (globals.configuration.profile_generate) {
+		instrument_functions(ir);
+	}
+	else if (globals.configuration.profile_use) {
+		load_profile(ir, globals.configuration.profile_use);
+	}
+
+	// Callees are optimized before their callers, so inlined code is already optimized
+	order_functions_bottom_up(ir, order, is_recursive);
+
+	for (size_t i = 0; i < memory::get_array_size(order); i++) {
+		IR_Function& function = ir.functions[order[i]];
+
+		if (globals.configuration.inline_functions) {
+			ZoneScopedN("Inlining");
+
+			uint64_t start_time = system::get_time_in_nanoseconds();
+			if (inline_calls(ir, function, is_recursive, globals.configuration.inline_budget, globals.configuration.inline_growth)) {
+				inlining_nb_modifications++;
+			}
+			inlining_time += system::get_time_in_nanoseconds() - start_time;
+		}
+
+		run_passes(function, pass_times, pass_nb_modifications);
+
+		if (globals.configuration.hoist_imported_function_addresses) {
+			ZoneScopedN("Import hoisting");
+
+			uint64_t start_time = system::get_time_in_nanoseconds();
+			if (hoist_imported_function_addresses(ir, function)) {
+				import_hoisting_nb_modifications++;
+			}
+			import_hoisting_time += system::get_time_in_nanoseconds() - start_time;
+		}
+	}
+
+	// The layout is the last transformation, blocks of the most frequent path follow each other
+	if (globals.configuration.profile_use) {
+		ZoneScopedN("Block layout");
+
+		uint64_t start_time = system::get_time_in_nanoseconds();
+		for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+			if (layout_blocks(ir.functions[i])) {
+				layout_nb_modifications++;
+			}
+		}
+		order_functions_by_profile(ir);
+		layout_time += system::get_time_in_nanoseconds() - start_time;
+	}
+
+	// Cold blocks are found once the layout is done, the code generator moves them after the hot code
+	if (globals.configuration.split_cold_code) {
+		ZoneScopedN("Hot/cold splitting");
+
+		uint64_t start_time = system::get_time_in_nanoseconds();
+		for (size_t i = 0; i < memory::get_array_size(ir.functions); i++) {
+			if (find_cold_blocks(ir, ir.functions[i])) {
+				splitting_nb_modifications++;
+			}
+		}
+		splitting_time += system::get_time_in_nanoseconds() - start_time;
+	}
+
+	log(*globals.logger, Log_Level::verbose, "[Optimizer] SSA construction: %lu us\n", ssa_construction_time / 1000);
+	if (globals.configuration.inline_functions) {
+		log(*globals.logger, Log_Level::verbose, "[Optimizer] Inlining: %lu us (%d modifications)\n",
+			inlining_time / 1000, inlining_nb_modifications);
+	}
+	for (uint32_t pass_index = 0; pass_index < nb_passes; pass_index++) {
+		log(*globals.logger, Log_Level::verbose, "[Optimizer] %Cs: %lu us (%d modifications)\n",
+			passes[pass_index].name, pass_times[pass_index] / 1000, pass_nb_modifications[pass_index]);
+	}
+	if (globals.configuration.hoist_imported_function_addresses) {
+		log(*globals.logger, Log_Level::verbose, "[Optimizer] Import hoisting: %lu us (%d modifications)\n",
+			import_hoisting_time / 1000, import_hoisting_nb_modifications);
+	}
+	if (globals.configuration.profile_use) {
+		log(*globals.logger, Log_Level::verbose, "[Optimizer] Block layout: %lu us (%d modifications)\n",
+			layout_time / 1000, layout_nb_modifications);
+	}
+	if (globals.configuration.split_cold_code) {
+		log(*globals.logger, Log_Level::verbose, "[Optimizer] Hot/cold splitting: %lu us (%d modifications)\n",
+			splitting_time / 1000, splitting_nb_modifications);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../IR_generator.hpp"
+
+// Optimizations of the IR
+//
+// Functions are converted to SSA form, then the pass manager runs the optimization passes until
+// none of them change the function. Passes work on one function at a time and return true if they
+// modified it.
+
+namespace f
+{
+	// Control flow analysis
+	//   - predecessors of blocks,
+	//   - dominator tree (Cooper, Harvey and Kennedy: "A Simple, Fast Dominance Algorithm").
+	// The reverse post order of reachable blocks is written in reverse_post_order if not null.
+	void compute_control_flow(IR_Function& function, fstd::memory::Array<uint32_t>* reverse_post_order = nullptr);
+
+	// Use the dominator tree computed by compute_control_flow
+	bool dominates(const IR_Function& function, uint32_t dominator, uint32_t block);
+
+	// Natural loops, found from the back edges of the dominator tree. loop_header[b] is the header of the innermost
+	// loop that contains the block b (invalid_block outside of loops), parent_loop_header[h] is the header of the loop
+	// that contains the loop of the header h.
+	void find_loops(const IR_Function& function, const fstd::memory::Array<uint32_t>& reverse_post_order,
+		fstd::memory::Array<uint32_t>& loop_header, fstd::memory::Array<uint32_t>& parent_loop_header);
+
+	// Rebuild the arena of the function without NOP instructions and unreachable blocks, phis are moved
+	// at the beginning of their block
+	void compact_function(IR_Function& function);
+
+	// Minimal SSA construction (Cytron et al.), phis are inserted on the iterated dominance frontier of
+	// registers written more than once, then registers are renamed with a walk of the dominator tree.
+	void build_ssa(IR_Function& function);
+
+	// Passes, they require the SSA form
+	bool propagate_constants(IR_Function& function);	// Sparse conditional constant propagation (Wegman and Zadeck)
+	bool number_values(IR_Function& function);			// Dominator based global value numbering, also propagate copies
+	bool eliminate_dead_code(IR_Function& function);
+
+	// Calls of imported functions in loops become indirect calls through a register, their address is read before
+	// the loop (globals.configuration.hoist_imported_function_addresses, run after the other passes)
+	bool hoist_imported_function_addresses(const IR& ir, IR_Function& function);
+
+	// Order of the functions for the optimization, callees before their callers. Functions of a cycle of the call graph,
+	// or that call themselves, are marked recursive. Imported functions aren't in the order.
+	void order_functions_bottom_up(const IR& ir, fstd::memory::Array<uint32_t>& order, fstd::memory::Array<bool>& is_recursive);
+
+	// Inline the calls of the function, with the cost model driven by budget (maximum size of an inlined function) and
+	// growth (maximum growth of the caller in percent), and by counts of blocks with a profile. Callees should be
+	// optimized before.
+	bool inline_calls(const IR& ir, IR_Function& caller, const fstd::memory::Array<bool>& is_recursive, uint32_t budget, uint32_t growth);
+
+	// Profile guided optimization, done just after the SSA construction so the blocks of both builds are the same.
+	// instrument_functions adds a counter per block and per taken branch (IR::profile_counters), write_profile converts
+	// the counters of the executed program to the profile file. apply_profile returns false if the profile doesn't
+	// match the program, nothing is changed then.
+	void instrument_functions(IR& ir);
+	void write_profile(const IR& ir, const uint64_t* counters, fstd::memory::Array<uint8_t>& data);
+	bool apply_profile(IR& ir, const fstd::memory::Array<uint8_t>& data);
+
+	// With a profile, blocks are ordered so the most frequent successor of a block follows it, blocks never executed
+	// are moved at the end (run last, the entry block stays the first)
+	bool layout_blocks(IR_Function& function);
+
+	// With a profile, IR::code_order puts the most called functions first
+	void order_functions_by_profile(IR& ir);
+
+	// Mark the blocks that are unlikely to be executed (calls of no_return or cold functions, never executed with a
+	// profile), the code generator places them after the code of all functions (globals.configuration.split_cold_code,
+	// run last). Return true if the function has cold blocks.
+	bool find_cold_blocks(const IR& ir, IR_Function& function);
+
+	// Convert functions to SSA form and run all passes
+	void optimize(IR& ir);
+}
@@ -0,0 +1,401 @@
+#include "optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <fstd/system/allocator.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Profile guided optimization
+//
+// The instrumented program counts the executions of each block and of the taken edge of each branch (the edge to
+// immediate.targets[0], the other one is the difference). A block starts with its counter (after its phis), the taken
+// edge is split by a block that only increments its counter. Counters are indexed by the blocks of the functions just
+// after the SSA construction, the profile is read at the same point, so both builds see the same blocks as long as
+// the source doesn't change.
+//
+// Profile file, little endian:
+//   uint32	magic, version, number of functions
+//   per function: uint32 number of blocks, then per block: uint64 number of executions, uint64 number of taken branches
+//
+// Counts drive the cost model of the inliner, the layout of blocks (a chain of the most frequent successors, blocks
+// never executed at the end) and the order of functions in the code (the most called first).
+
+using namespace fstd;
+
+using namespace f;
+
+static const uint32_t	profile_magic = 0x66727066;	// "fprf"
+static const uint32_t	profile_version = 1;
+
+static void emit_counter(memory::Array<IR_Instruction>& instructions, uint32_t counter)
+{
+	IR_Instruction instruction;
+
+	instruction.opcode = IR_Opcode::COUNTER;
+	instruction.type = Register::Type::QWORD;
+	instruction.destination = invalid_register;
+	instruction.operands[0] = invalid_register;
+	instruction.operands[1] = invalid_register;
+	instruction.immediate.integer = 0;
+	instruction.immediate.index = counter;
+	memory::array_push_back(instructions, instruction);
+}
+
+// The counters of the block b are first_counter + 2b (executions) and first_counter + 2b + 1 (taken branches)
+static void instrument_function(IR_Function& function, uint32_t first_counter)
+{
+	uint32_t						nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<IR_Instruction>	instructions;
+
+	memory::reserve_array(instructions, memory::get_array_size(function.instructions) + 3 * nb_blocks);
+
+	for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+		IR_Basic_Block&	block = function.blocks[block_index];
+		uint32_t		first_instruction = (uint32_t)memory::get_array_size(instructions);
+		bool			is_counted = false;
+
+		for (uint32_t i = 0; i < block.nb_instructions; i++) {
+			const IR_Instruction& instruction = function.instructions[block.first_instruction + i];
+
+			if (instruction.opcode != IR_Opcode::PHI && is_counted == false) {
+				emit_counter(instructions, first_counter + 2 * block_index);
+				is_counted = true;
+			}
+			memory::array_push_back(instructions, instruction);
+		}
+
+		block.first_instruction = first_instruction;
+		block.nb_instructions = (uint32_t)memory::get_array_size(instructions) - first_instruction;
+	}
+
+	// Taken edges are split by a block appended to the function, phis of the target now come from this block
+	for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+		IR_Instruction& terminator = instructions[function.blocks[block_index].first_instruction + function.blocks[block_index].nb_instructions - 1];
+
+		if (terminator.opcode != IR_Opcode::BRANCH || terminator.immediate.targets[0] == terminator.immediate.targets[1]) {
+			continue;
+		}
+
+		IR_Basic_Block	edge_block = IR_Basic_Block();
+		IR_Instruction	jump = terminator;
+		uint32_t		target = terminator.immediate.targets[0];
+		uint32_t		edge_block_index = (uint32_t)memory::get_array_size(function.blocks);
+
+		terminator.immediate.targets[0] = edge_block_index;
+
+		jump.opcode = IR_Opcode::JUMP;
+		jump.operands[0] = invalid_register;
+		jump.immediate.targets[0] = target;
+		jump.immediate.targets[1] = 0;
+
+		edge_block.first_instruction = (uint32_t)memory::get_array_size(instructions);
+		edge_block.nb_instructions = 2;
+		edge_block.immediate_dominator = invalid_block;
+		emit_counter(instructions, first_counter + 2 * block_index + 1);
+		memory::array_push_back(instructions, jump);
+		memory::array_push_back(function.blocks, edge_block);
+
+		const IR_Basic_Block& target_block = function.blocks[target];
+		for (uint32_t i = 0; i < target_block.nb_instructions; i++) {
+			IR_Instruction& phi = instructions[target_block.first_instruction + i];
+
+			if (phi.opcode != IR_Opcode::PHI) {
+				break;
+			}
+
+			for (uint32_t j = 0; j < phi.operands[1]; j++) {
+				if (function.operand_lists[phi.operands[0] + 2 * j] == block_index) {
+					function.operand_lists[phi.operands[0] + 2 * j] = edge_block_index;
+					break;
+				}
+			}
+		}
+	}
+
+	memory::release(function.instructions);
+	function.instructions = instructions;
+
+	compute_control_flow(function);
+}
+
+void f::instrument_functions(IR& ir)
+{
+	ZoneScopedN("f::instrument_functions");
+
+	uint32_t nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+	uint32_t nb_counters = 0;
+
+	memory::resize_array(ir.profile_counters, nb_functions + 1);
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		IR_Function& function = ir.functions[i];
+
+		ir.profile_counters[i] = nb_counters;
+		if (memory::is_array_empty(function.blocks)) { // Imported functions
+			continue;
+		}
+
+		uint32_t nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+
+		instrument_function(function, nb_counters);
+		nb_counters += 2 * nb_blocks;
+	}
+	ir.profile_counters[nb_functions] = nb_counters;
+}
+
+void f::write_profile(const IR& ir, const uint64_t* counters, memory::Array<uint8_t>& data)
+{
+	ZoneScopedN("f::write_profile");
+
+	uint32_t nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+
+	core::Assert(memory::get_array_size(ir.profile_counters) == nb_functions + 1);
+
+	auto write = [&](const void* value, size_t size) {
+		memory::array_copy(data, memory::get_array_size(data), (const uint8_t*)value, size);
+	};
+
+	memory::resize_array(data, 0);
+	memory::reserve_array(data, 3 * sizeof(uint32_t) + nb_functions * sizeof(uint32_t) + ir.profile_counters[nb_functions] * sizeof(uint64_t));
+
+	write(&profile_magic, sizeof(profile_magic));
+	write(&profile_version, sizeof(profile_version));
+	write(&nb_functions, sizeof(nb_functions));
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		uint32_t nb_counters = ir.profile_counters[i + 1] - ir.profile_counters[i];
+		uint32_t nb_blocks = nb_counters / 2;
+
+		write(&nb_blocks, sizeof(nb_blocks));
+		write(counters + ir.profile_counters[i], nb_counters * sizeof(uint64_t));
+	}
+}
+
+bool f::apply_profile(IR& ir, const memory::Array<uint8_t>& data)
+{
+	ZoneScopedN("f::apply_profile");
+
+	uint32_t	nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+	size_t		position = 0;
+
+	auto read = [&](void* value, size_t size) -> bool {
+		if (position + size > memory::get_array_size(data)) {
+			return false;
+		}
+		system::memory_copy(value, memory::get_array_data(data) + position, size);
+		position += size;
+		return true;
+	};
+
+	// The whole file is checked before any count is changed
+	// @TODO a hash of the instructions of functions would also detect changes that keep the number of blocks
+	uint32_t header[3];
+
+	if (!read(header, sizeof(header)) || header[0] != profile_magic || header[1] != profile_version || header[2] != nb_functions) {
+		return false;
+	}
+
+	size_t counts_position = position;
+
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		uint32_t nb_blocks;
+
+		if (!read(&nb_blocks, sizeof(nb_blocks)) || nb_blocks != memory::get_array_size(ir.functions[i].blocks)) {
+			return false;
+		}
+		position += 2 * (size_t)nb_blocks * sizeof(uint64_t);
+	}
+	if (position != memory::get_array_size(data)) {
+		return false;
+	}
+
+	position = counts_position;
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		IR_Function&	function = ir.functions[i];
+		uint32_t		nb_blocks;
+
+		read(&nb_blocks, sizeof(nb_blocks));
+		for (uint32_t block_index = 0; block_index < nb_blocks; block_index++) {
+			read(&function.blocks[block_index].count, sizeof(uint64_t));
+			read(&function.blocks[block_index].taken_count, sizeof(uint64_t));
+		}
+		function.has_profile = nb_blocks > 0;
+	}
+	return true;
+}
+
+// Count of the edge from the block to its successor successor_index (0 or 1 for branches). Edges of switches aren't
+// counted, the count of the successor is an upper bound.
+static uint64_t get_edge_count(const IR_Function& function, const IR_Basic_Block& block, uint32_t successor_index)
+{
+	const IR_Instruction& terminator = function.instructions[block.first_instruction + block.nb_instructions - 1];
+
+	if (terminator.opcode == IR_Opcode::SWITCH) {
+		uint64_t successor_count = function.blocks[function.operand_lists[terminator.immediate.targets[0] + successor_index]].count;
+
+		return successor_count < block.count ? successor_count : block.count;
+	}
+	else if (terminator.opcode != IR_Opcode::BRANCH) {
+		return block.count;
+	}
+	else if (successor_index == 0) {
+		return block.taken_count;
+	}
+	return block.count > block.taken_count ? block.count - block.taken_count : 0;
+}
+
+bool f::layout_blocks(IR_Function& function)
+{
+	ZoneScopedN("f::layout_blocks");
+
+	if (!function.has_profile) {
+		return false;
+	}
+
+	uint32_t						nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<bool>				is_placed;
+	memory::Array<uint32_t>			order;
+	memory::Array<uint32_t>			new_block_index;
+	memory::Array<IR_Instruction>	instructions;
+	memory::Array<IR_Basic_Block>	blocks;
+
+	defer{
+		memory::release(is_placed);
+		memory::release(order);
+		memory::release(new_block_index);
+	};
+
+	memory::resize_array(is_placed, nb_blocks);
+	memory::reserve_array(order, nb_blocks);
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		is_placed[i] = false;
+	}
+
+	// Chains start with the entry, then with the first executed block that isn't placed. A chain continues with the
+	// most frequent successor that isn't placed.
+	uint32_t next_chain = 1;
+
+	for (uint32_t current = 0; current != invalid_block; ) {
+		const IR_Basic_Block&	block = function.blocks[current];
+		const uint32_t*			successors;
+		uint32_t				nb_successors = get_successors(function, block, successors);
+		uint64_t				best_count = 0;
+
+		is_placed[current] = true;
+		memory::array_push_back(order, current);
+
+		current = invalid_block;
+		for (uint32_t i = 0; i < nb_successors; i++) {
+			uint64_t count = get_edge_count(function, block, i);
+
+			if (!is_placed[successors[i]] && count > best_count) {
+				current = successors[i];
+				best_count = count;
+			}
+		}
+
+		for (; current == invalid_block && next_chain < nb_blocks; next_chain++) {
+			if (!is_placed[next_chain] && function.blocks[next_chain].count > 0) {
+				current = next_chain;
+			}
+		}
+	}
+
+	// Blocks never executed keep their order at the end
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		if (!is_placed[i]) {
+			memory::array_push_back(order, i);
+		}
+	}
+
+	bool is_modified = false;
+
+	memory::resize_array(new_block_index, nb_blocks);
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		new_block_index[order[i]] = i;
+		is_modified |= order[i] != i;
+	}
+
+	if (!is_modified) {
+		return false;
+	}
+
+	memory::reserve_array(instructions, memory::get_array_size(function.instructions));
+	memory::reserve_array(blocks, nb_blocks);
+
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		IR_Basic_Block block = function.blocks[order[i]];
+
+		memory::array_copy(instructions, memory::get_array_size(instructions), memory::get_array_element(function.instructions, block.first_instruction), block.nb_instructions);
+		block.first_instruction = (uint32_t)memory::get_array_size(instructions) - block.nb_instructions;
+		memory::array_push_back(blocks, block);
+
+		for (uint32_t j = 0; j < block.nb_instructions; j++) {
+			IR_Instruction& instruction = instructions[block.first_instruction + j];
+
+			if (instruction.opcode == IR_Opcode::JUMP) {
+				instruction.immediate.targets[0] = new_block_index[instruction.immediate.targets[0]];
+			}
+			else if (instruction.opcode == IR_Opcode::BRANCH) {
+				instruction.immediate.targets[0] = new_block_index[instruction.immediate.targets[0]];
+				instruction.immediate.targets[1] = new_block_index[instruction.immediate.targets[1]];
+			}
+			else if (instruction.opcode == IR_Opcode::SWITCH) {
+				for (uint32_t k = 0; k < instruction.immediate.targets[1]; k++) {
+					uint32_t& successor = function.operand_lists[instruction.immediate.targets[0] + k];
+
+					successor = new_block_index[successor];
+				}
+			}
+			else if (instruction.opcode == IR_Opcode::PHI) {
+				for (uint32_t k = 0; k < instruction.operands[1]; k++) {
+					uint32_t& predecessor = function.operand_lists[instruction.operands[0] + 2 * k];
+
+					predecessor = new_block_index[predecessor];
+				}
+			}
+		}
+	}
+
+	memory::release(function.instructions);
+	memory::release(function.blocks);
+	function.instructions = instructions;
+	function.blocks = blocks;
+
+	compute_control_flow(function);
+	return true;
+}
+
+void f::order_functions_by_profile(IR& ir)
+{
+	ZoneScopedN("f::order_functions_by_profile");
+
+	uint32_t	nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+	bool		has_profile = false;
+
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		has_profile |= ir.functions[i].has_profile;
+	}
+	if (!has_profile) {
+		return;
+	}
+
+	auto get_nb_calls = [&](uint32_t function_index) -> uint64_t {
+		const IR_Function& function = ir.functions[function_index];
+
+		return memory::is_array_empty(function.blocks) ? 0 : function.blocks[0].count;
+	};
+
+	// Insertion sort, stable so functions with the same number of calls (functions never called) keep their order
+	memory::resize_array(ir.code_order, nb_functions);
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		uint64_t	nb_calls = get_nb_calls(i);
+		uint32_t	j = i;
+
+		for (; j > 0 && get_nb_calls(ir.code_order[j - 1]) < nb_calls; j--) {
+			ir.code_order[j] = ir.code_order[j - 1];
+		}
+		ir.code_order[j] = i;
+	}
+}
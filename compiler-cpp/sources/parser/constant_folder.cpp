@@ -0,0 +1,463 @@
+#include "constant_folder.hpp"
+
+#include "globals.hpp"
+#include "parser.hpp"
+
+#include "lexer/lexer.hpp"
+
+#include "VM/VM.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <limits> // @TODO remove it
+#include <cstddef>
+
+// @TODO String literals
+//
+// My_Enum::names[enum_value] is also a string literal, but without operators like '+' on them it seems to only
+// be an optimization more than something really useful for type deduction and error reporting.
+// For consistency between compile-time and runtime code evaluation it certainly should works with String_Builder,
+// but having the '+' operator that works only at compile time with string literals may be OK.
+
+using namespace fstd;
+
+using namespace f;
+
+static void fold_node(AST_Node* node);
+static void fold_type(AST_Node* type_node);
+
+// =============================================================================
+
+// @Warning rely on the order of Token_Type values: I32 < UI32 < I64 < UI64 and F32 < F64 < REAL.
+// The widest type of a family is simply the greatest value.
+
+static inline bool is_integer_literal(Token_Type type)
+{
+	return type >= Token_Type::NUMERIC_LITERAL_I32 && type <= Token_Type::NUMERIC_LITERAL_UI64;
+}
+
+static inline bool is_unsigned_literal(Token_Type type)
+{
+	return type == Token_Type::NUMERIC_LITERAL_UI32 || type == Token_Type::NUMERIC_LITERAL_UI64;
+}
+
+static inline bool is_floating_point_literal(Token_Type type)
+{
+	return type >= Token_Type::NUMERIC_LITERAL_F32 && type <= Token_Type::NUMERIC_LITERAL_REAL;
+}
+
+static inline bool is_numeric_literal(const AST_Node* node)
+{
+	if (node == nullptr || node->ast_type != Node_Type::STATEMENT_LITERAL)
+		return false;
+
+	Token_Type type = ((AST_Literal*)node)->value.type;
+	return is_integer_literal(type) || is_floating_point_literal(type);
+}
+
+// Conversions are done directly from the source type to the targeted one to avoid double rounding.
+static float get_f32_value(const Token<Keyword>& token)
+{
+	switch (token.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+	case Token_Type::NUMERIC_LITERAL_I64:	return (float)token.value.integer;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+	case Token_Type::NUMERIC_LITERAL_UI64:	return (float)token.value.unsigned_integer;
+	case Token_Type::NUMERIC_LITERAL_F32:	return token.value.real_32;
+	case Token_Type::NUMERIC_LITERAL_F64:	return (float)token.value.real_64;
+	case Token_Type::NUMERIC_LITERAL_REAL:	return (float)token.value.real_max;
+	default:								core::Assert(false); return 0.0f;
+	}
+}
+
+static double get_f64_value(const Token<Keyword>& token)
+{
+	switch (token.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+	case Token_Type::NUMERIC_LITERAL_I64:	return (double)token.value.integer;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+	case Token_Type::NUMERIC_LITERAL_UI64:	return (double)token.value.unsigned_integer;
+	case Token_Type::NUMERIC_LITERAL_F32:	return (double)token.value.real_32;
+	case Token_Type::NUMERIC_LITERAL_F64:	return token.value.real_64;
+	case Token_Type::NUMERIC_LITERAL_REAL:	return (double)token.value.real_max;
+	default:								core::Assert(false); return 0.0;
+	}
+}
+
+static long double get_real_value(const Token<Keyword>& token)
+{
+	switch (token.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+	case Token_Type::NUMERIC_LITERAL_I64:	return (long double)token.value.integer;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+	case Token_Type::NUMERIC_LITERAL_UI64:	return (long double)token.value.unsigned_integer;
+	case Token_Type::NUMERIC_LITERAL_F32:	return (long double)token.value.real_32;
+	case Token_Type::NUMERIC_LITERAL_F64:	return (long double)token.value.real_64;
+	case Token_Type::NUMERIC_LITERAL_REAL:	return token.value.real_max;
+	default:								core::Assert(false); return 0.0;
+	}
+}
+
+template<typename Real>
+static Real compute_floating_point_operation(Node_Type operation, Real left, Real right)
+{
+	switch (operation)
+	{
+	case Node_Type::BINARY_OPERATOR_ADDITION:		return left + right;
+	case Node_Type::BINARY_OPERATOR_SUBSTRACTION:	return left - right;
+	case Node_Type::BINARY_OPERATOR_MULTIPLICATION:	return left * right;
+	case Node_Type::BINARY_OPERATOR_DIVISION:		return left / right;	// IEEE 754 semantic, a division by zero gives an infinity or a NaN
+	default:										core::Assert(false); return 0;
+	}
+}
+
+// Return false on overflow
+static bool compute_signed_operation(Node_Type operation, int64_t left, int64_t right, int64_t& result)
+{
+	constexpr int64_t min = std::numeric_limits<int64_t>::min();
+	constexpr int64_t max = std::numeric_limits<int64_t>::max();
+
+	switch (operation)
+	{
+	case Node_Type::BINARY_OPERATOR_ADDITION:
+		if ((right > 0 && left > max - right) || (right < 0 && left < min - right))
+			return false;
+		result = left + right;
+		return true;
+	case Node_Type::BINARY_OPERATOR_SUBSTRACTION:
+		if ((right < 0 && left > max + right) || (right > 0 && left < min + right))
+			return false;
+		result = left - right;
+		return true;
+	case Node_Type::BINARY_OPERATOR_MULTIPLICATION:
+		if (left == 0 || right == 0) {
+			result = 0;
+			return true;
+		}
+		if ((left == -1 && right == min) || (right == -1 && left == min))
+			return false;
+		result = (int64_t)((uint64_t)left * (uint64_t)right);
+		return result / right == left;
+	case Node_Type::BINARY_OPERATOR_DIVISION:
+		if (left == min && right == -1)
+			return false;
+		result = left / right;
+		return true;
+	case Node_Type::BINARY_OPERATOR_REMINDER:
+		result = (right == -1) ? 0 : left % right;	// min % -1 is undefined in C++, but mathematically it is 0
+		return true;
+	default:
+		core::Assert(false);
+		return false;
+	}
+}
+
+// Return false on overflow
+static bool compute_unsigned_operation(Node_Type operation, uint64_t left, uint64_t right, uint64_t& result)
+{
+	switch (operation)
+	{
+	case Node_Type::BINARY_OPERATOR_ADDITION:
+		result = left + right;
+		return result >= left;
+	case Node_Type::BINARY_OPERATOR_SUBSTRACTION:
+		result = left - right;
+		return right <= left;
+	case Node_Type::BINARY_OPERATOR_MULTIPLICATION:
+		result = left * right;
+		return left == 0 || result / left == right;
+	case Node_Type::BINARY_OPERATOR_DIVISION:
+		result = left / right;
+		return true;
+	case Node_Type::BINARY_OPERATOR_REMINDER:
+		result = left % right;
+		return true;
+	default:
+		core::Assert(false);
+		return false;
+	}
+}
+
+// Promote 32 bits results to their 64 bits version if they don't fit anymore.
+static void polish_integer_literal(Token<Keyword>& token)
+{
+	if (token.type == Token_Type::NUMERIC_LITERAL_I32
+		&& (token.value.integer < std::numeric_limits<int32_t>::min() || token.value.integer > std::numeric_limits<int32_t>::max())) {
+		token.type = Token_Type::NUMERIC_LITERAL_I64;
+	}
+	else if (token.type == Token_Type::NUMERIC_LITERAL_UI32
+		&& token.value.unsigned_integer > std::numeric_limits<uint32_t>::max()) {
+		token.type = Token_Type::NUMERIC_LITERAL_UI64;
+	}
+}
+
+// The result is written in left
+static void fold_binary_operation(Node_Type operation, const Token<Keyword>& operator_token, Token<Keyword>& left, const Token<Keyword>& right)
+{
+	Token_Type	result_type;
+
+	if (is_floating_point_literal(left.type) || is_floating_point_literal(right.type)) {
+		if (operation == Node_Type::BINARY_OPERATOR_REMINDER) {
+			report_error(Compiler_Error::error, operator_token, "The '%' operator can't be used with floating point values.");
+		}
+
+		// An integer operand is converted to the floating point type of the other one
+		if (is_floating_point_literal(left.type) == false)
+			result_type = right.type;
+		else if (is_floating_point_literal(right.type) == false)
+			result_type = left.type;
+		else
+			result_type = left.type > right.type ? left.type : right.type;
+
+		if (result_type == Token_Type::NUMERIC_LITERAL_F32) {
+			left.value.real_32 = compute_floating_point_operation<float>(operation, get_f32_value(left), get_f32_value(right));
+		}
+		else if (result_type == Token_Type::NUMERIC_LITERAL_F64) {
+			left.value.real_64 = compute_floating_point_operation<double>(operation, get_f64_value(left), get_f64_value(right));
+		}
+		else {
+			left.value.real_max = compute_floating_point_operation<long double>(operation, get_real_value(left), get_real_value(right));
+		}
+		left.type = result_type;
+		return;
+	}
+
+	result_type = left.type > right.type ? left.type : right.type;
+
+	if ((operation == Node_Type::BINARY_OPERATOR_DIVISION || operation == Node_Type::BINARY_OPERATOR_REMINDER)
+		&& right.value.unsigned_integer == 0) {
+		report_error(Compiler_Error::error, operator_token, "Division by zero in a constant expression.");
+	}
+
+	if (is_unsigned_literal(result_type)) {
+		// Literals are never negative, but a folded expression can be
+		if ((is_unsigned_literal(left.type) == false && left.value.integer < 0)
+			|| (is_unsigned_literal(right.type) == false && right.value.integer < 0)) {
+			report_error(Compiler_Error::error, operator_token, "Sign mismatch: a negative constant is used with an unsigned one.");
+		}
+
+		if (compute_unsigned_operation(operation, left.value.unsigned_integer, right.value.unsigned_integer, left.value.unsigned_integer) == false) {
+			report_error(Compiler_Error::error, operator_token, "The constant expression overflows its unsigned type.");
+		}
+	}
+	else {
+		if (compute_signed_operation(operation, left.value.integer, right.value.integer, left.value.integer) == false) {
+			report_error(Compiler_Error::error, operator_token, "The constant expression overflows a 64 bits signed integer.");
+		}
+	}
+
+	left.type = result_type;
+	polish_integer_literal(left);
+}
+
+static void fold_negation(Token<Keyword>& value)
+{
+	switch (value.type)
+	{
+	case Token_Type::NUMERIC_LITERAL_I32:
+	case Token_Type::NUMERIC_LITERAL_I64:
+		// Lexer give positive numbers only, but 9'223'372'036'854'775'808 doesn't fit in an int64_t
+		// so the parsing of the min value of i64 relies on the overflow of the lexer.
+		if (value.value.integer == std::numeric_limits<int64_t>::min() && value.type == Token_Type::NUMERIC_LITERAL_I64) {
+			break;
+		}
+		value.value.integer = -value.value.integer;
+		polish_integer_literal(value);
+		break;
+	case Token_Type::NUMERIC_LITERAL_UI32:
+	case Token_Type::NUMERIC_LITERAL_UI64:
+		report_error(Compiler_Error::error, value, "Unary '-' can't be applied on an unsigned constant.");
+		break;
+	case Token_Type::NUMERIC_LITERAL_F32:
+		value.value.real_32 = -value.value.real_32;
+		break;
+	case Token_Type::NUMERIC_LITERAL_F64:
+		value.value.real_64 = -value.value.real_64;
+		break;
+	case Token_Type::NUMERIC_LITERAL_REAL:
+		value.value.real_max = -value.value.real_max;
+		break;
+	default:
+		core::Assert(false);
+	}
+}
+
+bool f::fold_constant_expression(AST_Node** node_address)
+{
+	AST_Node* node = *node_address;
+
+	if (node == nullptr) {
+		return false;
+	}
+
+	if (node->ast_type == Node_Type::STATEMENT_LITERAL) {
+		return true;
+	}
+	else if (node->ast_type == Node_Type::UNARY_OPERATOR_NEGATIVE) {
+		AST_Unary_operator* unary_operator_node = (AST_Unary_operator*)node;
+
+		if (fold_constant_expression(&unary_operator_node->right) == false
+			|| is_numeric_literal(unary_operator_node->right) == false) {
+			return false;
+		}
+
+		// The literal node is reused, it takes the place of the operator in the tree
+		AST_Literal* literal_node = (AST_Literal*)unary_operator_node->right;
+
+		fold_negation(literal_node->value);
+		literal_node->sibling = unary_operator_node->sibling;
+		*node_address = (AST_Node*)literal_node;
+		return true;
+	}
+	else if (is_binary_operator(node) && node->ast_type != Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
+		AST_Binary_Operator* binary_operator_node = (AST_Binary_Operator*)node;
+
+		// Both sides have to be folded even if the left one isn't a constant
+		bool left_folded = fold_constant_expression(&binary_operator_node->left);
+		bool right_folded = fold_constant_expression(&binary_operator_node->right);
+
+		if (left_folded == false || right_folded == false
+			|| is_numeric_literal(binary_operator_node->left) == false
+			|| is_numeric_literal(binary_operator_node->right) == false) {
+			return false;
+		}
+
+		AST_Literal* left_node = (AST_Literal*)binary_operator_node->left;
+		AST_Literal* right_node = (AST_Literal*)binary_operator_node->right;
+
+		fold_binary_operation(binary_operator_node->ast_type, binary_operator_node->token, left_node->value, right_node->value);
+
+		// The text of the literal covers the whole expression when it is possible
+		if (left_node->value.file_path.ptr == right_node->value.file_path.ptr
+			&& right_node->value.text.ptr > left_node->value.text.ptr) {
+			language::assign(left_node->value.text, left_node->value.text.ptr, (right_node->value.text.ptr + right_node->value.text.size) - left_node->value.text.ptr);
+		}
+
+		left_node->sibling = binary_operator_node->sibling;
+		*node_address = (AST_Node*)left_node;
+		return true;
+	}
+	else if (node->ast_type == Node_Type::FUNCTION_CALL) {
+		AST_Function_Call* function_call_node = (AST_Function_Call*)node;
+
+		// Parameters are linked by their sibling, folding a parameter keep it
+		for (AST_Node** parameter = &function_call_node->parameters; *parameter; parameter = &(*parameter)->sibling) {
+			fold_constant_expression(parameter);
+		}
+	}
+	else if (node->ast_type == Node_Type::UNARY_OPERATOR_ADDRESS_OF) {
+		AST_Unary_operator* unary_operator_node = (AST_Unary_operator*)node;
+
+		fold_constant_expression(&unary_operator_node->right);
+	}
+	else if (node->ast_type == Node_Type::DIRECTIVE_RUN) {
+		static_assert(offsetof(AST_Directive_Run, token) == offsetof(AST_Literal, value), "AST_Directive_Run should be convertible in place to an AST_Literal");
+
+		Token<Keyword> result;
+
+		VM::execute_run_directive((AST_Directive_Run*)node, result);
+
+		// The directive node becomes the literal, its sibling is kept
+		AST_Literal* literal_node = (AST_Literal*)node;
+
+		literal_node->ast_type = Node_Type::STATEMENT_LITERAL;
+		literal_node->value = result;
+		return true;
+	}
+
+	return false;
+}
+
+// The type is a chain of modifiers (pointer, array,...) linked by siblings that ends with the type itself
+static void fold_type(AST_Node* type_node)
+{
+	for (AST_Node* current_node = type_node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_TYPE_ARRAY) {
+			AST_Statement_Type_Array* array_node = (AST_Statement_Type_Array*)current_node;
+
+			fold_constant_expression(&array_node->array_size);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_TYPE_STRUCT) {
+			fold_node(((AST_Statement_Struct_Type*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_TYPE_UNION) {
+			fold_node(((AST_Statement_Union_Type*)current_node)->first_child);
+		}
+	}
+}
+
+// Iterate over a list of statements
+static void fold_node(AST_Node* node)
+{
+	for (AST_Node* current_node = node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_VARIABLE) {
+			AST_Statement_Variable* variable_node = (AST_Statement_Variable*)current_node;
+
+			fold_type(variable_node->type);
+			fold_constant_expression(&variable_node->expression);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_FUNCTION) {
+			AST_Statement_Function* function_node = (AST_Statement_Function*)current_node;
+
+			fold_node((AST_Node*)function_node->arguments);
+			fold_type(function_node->return_type);
+			fold_node((AST_Node*)function_node->scope);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_MODULE) {
+			fold_node(((AST_Statement_Module*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SCOPE) {
+			fold_node(((AST_Statement_Scope*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_TYPE_STRUCT) {
+			fold_node(((AST_Statement_Struct_Type*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_TYPE_UNION) {
+			fold_node(((AST_Statement_Union_Type*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::TYPE_ENUM) {
+			AST_Enum* enum_node = (AST_Enum*)current_node;
+
+			for (AST_Enum_Value* value = enum_node->values; value; value = (AST_Enum_Value*)value->sibling) {
+				fold_constant_expression(&value->value);
+			}
+		}
+		else if (current_node->ast_type == Node_Type::FUNCTION_CALL) {
+			// The call is the statement itself, the node can't be replaced
+			fold_constant_expression(&current_node);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_RETURN) {
+			fold_constant_expression(&((AST_Statement_Return*)current_node)->expression);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SWITCH) {
+			AST_Statement_Switch* switch_node = (AST_Statement_Switch*)current_node;
+
+			fold_constant_expression(&switch_node->expression);
+			for (AST_Switch_Case* case_node = switch_node->cases; case_node; case_node = (AST_Switch_Case*)case_node->sibling) {
+				// Values of cases have to be folded to literals before the lowering of the switch
+				for (AST_Node** value = &case_node->values; *value; value = &(*value)->sibling) {
+					fold_constant_expression(value);
+				}
+				fold_node((AST_Node*)case_node->scope);
+			}
+		}
+	}
+}
+
+void f::fold_constant_expressions(Parsing_Result& parsing_result)
+{
+	ZoneScopedN("f::fold_constant_expressions");
+
+	if (parsing_result.ast_root == nullptr) {
+		return;
+	}
+
+	fold_node(parsing_result.ast_root);
+}
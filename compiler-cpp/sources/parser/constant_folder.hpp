@@ -0,0 +1,26 @@
+#pragma once
+
+// Methods of this file are suceptible to report compilition errors
+
+namespace f
+{
+	struct AST_Node;
+	struct Parsing_Result;
+
+	// Evaluate all constant expressions of the AST before the type deduction pass.
+	//
+	// Numeric literal arithmetic (binary operators +, -, *, /, % and the unary -) is computed at compile time
+	// and the foldable sub-trees are replaced by a single AST_Literal. Array sizes and enum values get
+	// evaluated the same way, so the type deduction pass can directly read their values.
+	//
+	// Integer operations are done with the widest type of operands (i32 < ui32 < i64 < ui64), a 32 bits result
+	// that doesn't fit anymore is promoted to its 64 bits version (exactly like the lexer does for literals).
+	// Overflows of 64 bits types, sign mismatches and divisions by zero are reported as errors.
+	// Floating point operations are done with the precision of the widest operand (f32 < f64 < real),
+	// so the result is exactly the same than the one computed at runtime.
+	void fold_constant_expressions(Parsing_Result& parsing_result);
+
+	// Can be used on any expression, the node pointed by node_address is replaced by a literal if the expression is a constant.
+	// Return true if the expression was completely folded.
+	bool fold_constant_expression(AST_Node** node_address);
+}
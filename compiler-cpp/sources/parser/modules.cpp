@@ -0,0 +1,266 @@
+#include "modules.hpp"
+
+#include "globals.hpp"
+#include "parser.hpp"
+
+#include "lexer/lexer.hpp"
+
+#include <fstd/core/assert.hpp>
+#include <fstd/core/string_builder.hpp>
+
+#include <fstd/language/defer.hpp>
+#include <fstd/language/string.hpp>
+#include <fstd/language/string_view.hpp>
+
+#include <fstd/memory/hash_table.hpp>
+
+#include <fstd/system/allocator.hpp>
+#include <fstd/system/thread.hpp>
+
+#include <third-party/SpookyV2.h>
+
+#include <tracy/Tracy.hpp>
+
+// @TODO
+// Workers only load modules for the moment, but the type deduction and the code generation of a module could also
+// start as soon as the modules it imports are loaded.
+
+using namespace fstd;
+
+using namespace f;
+
+// @Warning modules are shared by all threads, so they can't be stored in globals that are thread local.
+// Everything here is protected by the mutex, except the content of a Module that is only written by the thread that loads it.
+struct Modules_Data
+{
+	system::Mutex				mutex;
+	system::Condition_Variable	condition_variable;	// Signaled when a module is queued and when all modules are loaded
+
+	memory::Array<Module*>		modules;
+	memory::Hash_Table<uint16_t, language::string_view, Module*, 32>	path_cache; // Keys are paths of modules (interned in Module::path)
+
+	memory::Array<Module*>		pending_modules;
+	uint32_t					nb_unloaded_modules; // Pending modules and modules that are loading
+};
+
+static Modules_Data		modules_data;
+static const uint32_t	max_nb_workers = 16;
+
+// The module name is resolved relatively to the directory of the importing file: "import foo;" in "dir\main.f" is "dir\foo.f"
+static void resolve_module_path(const Token<Keyword>& module_name, language::string& path)
+{
+	core::String_Builder	string_builder;
+	language::string_view	directory;
+	size_t					directory_size = language::get_string_size(module_name.file_path);
+	uint8_t*				importer_path = language::to_utf8(module_name.file_path);
+
+	defer{ core::free_buffers(string_builder); };
+
+	while (directory_size > 0 && importer_path[directory_size - 1] != '\\' && importer_path[directory_size - 1] != '/') {
+		directory_size--;
+	}
+	language::assign(directory, importer_path, directory_size);
+
+	core::print_to_builder(string_builder, "%v%v.f", directory, module_name.text);
+	path = core::to_string(string_builder);
+
+	// Paths are interned, so separators are normalized to not load the same module twice
+	// @TODO resolve '.' and '..', and ignore the case on Windows
+	for (size_t i = 0; i < language::get_string_size(path); i++) {
+		if (path[i] == '/') {
+			path[i] = '\\';
+		}
+	}
+}
+
+// Return the module of this path, a new module is queued for loading if the path wasn't already in the cache
+static Module* get_module(const language::string& path)
+{
+	language::string_view	path_view;
+
+	language::assign(path_view, path);
+
+	uint64_t hash = SpookyHash::Hash64((const void*)language::to_utf8(path_view), language::get_string_size(path_view), 0);
+	uint16_t short_hash = hash & 0xffff;
+
+	system::lock(modules_data.mutex);
+	defer{ system::unlock(modules_data.mutex); };
+
+	Module** module_ptr = memory::hash_table_get(modules_data.path_cache, short_hash, path_view);
+	if (module_ptr) {
+		return *module_ptr;
+	}
+
+	// Modules are allocated one by one, because their addresses have to stay valid
+	Module* module = (Module*)system::allocate(sizeof(Module));
+
+	language::init(module->path.string);
+	module->path.is_absolute = false;
+	system::from_native(module->path, path);
+	memory::init(module->tokens);
+	module->parsing_result.ast_root = nullptr;
+	module->parsing_result.symbol_table_root = nullptr;
+	memory::init(module->imports);
+
+	language::string_view interned_path = system::to_string(module->path);
+	memory::hash_table_insert(modules_data.path_cache, short_hash, interned_path, module);
+	memory::array_push_back(modules_data.modules, module);
+
+	memory::array_push_back(modules_data.pending_modules, module);
+	modules_data.nb_unloaded_modules++;
+	system::wake_one(modules_data.condition_variable);
+
+	return module;
+}
+
+static void load_module(Module* module)
+{
+	ZoneScopedN("load_module");
+
+	globals.parser_data.current_module = module;
+
+	lex(module->path, module->tokens);
+	parse(module->tokens, module->parsing_result);
+
+	globals.parser_data.current_module = nullptr;
+}
+
+// Executed by the main thread and all workers, until there is no more module to load
+static void process_modules()
+{
+	system::lock(modules_data.mutex);
+
+	for (;;)
+	{
+		if (memory::is_array_empty(modules_data.pending_modules) == false) {
+			Module* module = *memory::get_array_last_element(modules_data.pending_modules);
+
+			memory::resize_array(modules_data.pending_modules, memory::get_array_size(modules_data.pending_modules) - 1);
+
+			system::unlock(modules_data.mutex);
+			load_module(module); // Imports found here are queued and will wake up a worker
+			system::lock(modules_data.mutex);
+
+			modules_data.nb_unloaded_modules--;
+			if (modules_data.nb_unloaded_modules == 0) {
+				system::wake_all(modules_data.condition_variable); // Waiting threads can exit
+			}
+		}
+		else if (modules_data.nb_unloaded_modules == 0) {
+			break;
+		}
+		else {
+			system::wait(modules_data.condition_variable, modules_data.mutex);
+		}
+	}
+
+	system::unlock(modules_data.mutex);
+}
+
+static void module_loader_worker(void* /*parameter*/)
+{
+#if defined(TRACY_ENABLE)
+	tracy::SetThreadName("Module loader");
+#endif
+
+	initialize_globals();
+	process_modules();
+	release_globals();
+}
+
+Module* f::load_modules(const system::Path& main_file_path)
+{
+	ZoneScopedNC("f::load_modules", 0x1b5e20);
+
+	memory::Array<system::Thread>	workers;
+
+	defer{ memory::release(workers); };
+
+	system::init(modules_data.mutex);
+	system::init(modules_data.condition_variable);
+	memory::init(modules_data.modules);
+	memory::init(modules_data.pending_modules);
+	memory::hash_table_init(modules_data.path_cache, &language::are_equals);
+	modules_data.nb_unloaded_modules = 0;
+
+	// Tables of the lexer are shared by all threads, they have to be ready before starting workers
+	initialize_lexer();
+
+	// The main module is queued before starting workers, else they may exit before having something to do
+	Module* main_module = get_module(main_file_path.string);
+
+	uint32_t nb_hardware_threads = system::get_nb_hardware_threads();
+	uint32_t nb_workers = nb_hardware_threads > 1 ? nb_hardware_threads - 1 : 0; // The main thread also loads modules
+
+	if (nb_workers > max_nb_workers) {
+		nb_workers = max_nb_workers;
+	}
+
+	memory::resize_array(workers, nb_workers);
+	for (uint32_t i = 0; i < nb_workers; i++) {
+		system::create_thread(workers[i], &module_loader_worker, nullptr);
+	}
+
+	process_modules();
+
+	for (uint32_t i = 0; i < nb_workers; i++) {
+		system::join_thread(workers[i]);
+	}
+
+	// All imports are resolved, only modules are kept until release_modules
+	memory::release(modules_data.pending_modules);
+	memory::hash_table_release(modules_data.path_cache);
+
+	return main_module;
+}
+
+Module* f::import_module(const Token<Keyword>& module_name)
+{
+	ZoneScopedN("f::import_module");
+
+	Module* current_module = globals.parser_data.current_module;
+
+	if (current_module == nullptr) {
+		report_error(Compiler_Error::error, module_name, "Imports are only supported in files loaded as modules.");
+	}
+
+	language::string path;
+
+	defer{ language::release(path); };
+
+	resolve_module_path(module_name, path);
+
+	Module* module = get_module(path);
+
+	if (module == current_module) {
+		report_error(Compiler_Error::error, module_name, "A module can't import itself.");
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(current_module->imports); i++) {
+		if (current_module->imports[i] == module) {
+			return module;
+		}
+	}
+	memory::array_push_back(current_module->imports, module);
+	return module;
+}
+
+const memory::Array<Module*>& f::get_modules()
+{
+	return modules_data.modules;
+}
+
+void f::release_modules()
+{
+	ZoneScopedN("f::release_modules");
+
+	for (size_t i = 0; i < memory::get_array_size(modules_data.modules); i++) {
+		Module* module = modules_data.modules[i];
+
+		system::reset_path(module->path);
+		memory::release(module->tokens);
+		memory::release(module->imports);
+		system::free(module);
+	}
+	memory::release(modules_data.modules);
+}
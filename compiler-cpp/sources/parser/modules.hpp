@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../lexer/lexer.hpp"
+#include "parser.hpp"
+
+#include <fstd/memory/array.hpp>
+
+#include <fstd/system/path.hpp>
+
+// Methods of this file are suceptible to report compilition errors
+
+namespace f
+{
+	// A source file is a module, it is lexed and parsed only once even if it is imported from many places.
+	struct Module
+	{
+		fstd::system::Path					path;			// Resolved path, interned in the path cache
+		fstd::memory::Array<Token<Keyword>>	tokens;
+		Parsing_Result						parsing_result;	// parsing_result.symbol_table_root is the global scope of the module
+		fstd::memory::Array<Module*>		imports;		// Modules directly imported, the symbol lookup continue in their global scope
+	};
+
+	// Load the main module and recursively all modules it imports. Each module is loaded (lexed and parsed) on a worker
+	// thread as soon as its import is parsed, so wide dependency graphs are loaded in parallel.
+	// Return when all modules are loaded.
+	Module*	load_modules(const fstd::system::Path& main_file_path);
+
+	// Called by the parser when it reaches an import, the module is queued if it isn't already known
+	// and immediately returned (it may not be loaded yet).
+	Module*	import_module(const Token<Keyword>& module_name);
+
+	// All modules, in discovery order (the main module is the first one)
+	const fstd::memory::Array<Module*>& get_modules();
+
+	// Free all modules, their tokens and ASTs can't be used after
+	void	release_modules();
+
+	inline Symbol_Table* get_symbol_table(const Module* module) {
+		return module->parsing_result.symbol_table_root;
+	}
+}
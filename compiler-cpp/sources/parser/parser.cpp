@@ -1,6 +1,7 @@
 #include "parser.hpp"
 
 #include "globals.hpp"
+#include "modules.hpp"
 
 #include <fstd/core/logger.hpp>
 #include <fstd/core/string_builder.hpp>
@@ -19,6 +20,7 @@
 #include <fstd/language/string_view.hpp>
 
 #include <third-party/SpookyV2.h>
+#undef INLINE // Defined by SpookyV2, it hides Keyword::INLINE
 
 #include <tracy/Tracy.hpp>
 
@@ -48,17 +50,14 @@ inline Node_Type* allocate_AST_node(AST_Node** emplace_node)
 	ZoneScopedN("allocate_AST_node");
 
 	// Ensure that no reallocation could happen during the resize
-	bool overflow_preallocated_buffer = memory::get_array_size(globals.parser_data.ast_nodes) >= memory::get_array_reserved(globals.parser_data.ast_nodes) * sizeof(AST_Statement_Variable);
+	bool overflow_preallocated_buffer = memory::get_array_size(globals.parser_data.ast_nodes) + sizeof(Node_Type) > memory::get_array_reserved(globals.parser_data.ast_nodes);
 
 	core::Assert(overflow_preallocated_buffer == false);
 	if (overflow_preallocated_buffer) {
 		report_error(Compiler_Error::internal_error, "The compiler did not allocate enough memory to store AST_Node!");
 	}
 
-	// @TODO use a version that didn't check the array size, because we just did it and we don't want to trigger unplanned allocations
-	memory::resize_array(globals.parser_data.ast_nodes, memory::get_array_size(globals.parser_data.ast_nodes) + sizeof(Node_Type));
-
-	Node_Type* new_node = (Node_Type*)(memory::get_array_last_element(globals.parser_data.ast_nodes) - sizeof(Node_Type));
+	Node_Type* new_node = (Node_Type*)memory::array_emplace_back_unchecked(globals.parser_data.ast_nodes, sizeof(Node_Type));
 	if (emplace_node) {
 		*emplace_node = (AST_Node*)new_node;
 	}
@@ -70,17 +69,14 @@ inline Symbol_Table* allocate_symbol_table()
 	ZoneScopedN("allocate_symbol_table");
 
 	// Ensure that no reallocation could happen during the resize
-	bool overflow_preallocated_buffer = memory::get_array_size(globals.parser_data.symbol_tables) >= memory::get_array_reserved(globals.parser_data.symbol_tables) * sizeof(Symbol_Table);
+	bool overflow_preallocated_buffer = memory::get_array_size(globals.parser_data.symbol_tables) + sizeof(Symbol_Table) > memory::get_array_reserved(globals.parser_data.symbol_tables);
 
 	core::Assert(overflow_preallocated_buffer == false);
 	if (overflow_preallocated_buffer) {
 		report_error(Compiler_Error::internal_error, "The compiler did not allocate enough memory to store Symbol_Table!");
 	}
 
-	// @TODO use a version that didn't check the array size, because we just did it and we don't want to trigger unplanned allocations
-	memory::resize_array(globals.parser_data.symbol_tables, memory::get_array_size(globals.parser_data.symbol_tables) + sizeof(Symbol_Table));
-
-	Symbol_Table* new_node = (Symbol_Table*)(memory::get_array_last_element(globals.parser_data.symbol_tables) - sizeof(Symbol_Table));
+	Symbol_Table* new_node = (Symbol_Table*)memory::array_emplace_back_unchecked(globals.parser_data.symbol_tables, sizeof(Symbol_Table));
 	return new_node;
 }
 
@@ -92,6 +88,10 @@ static void parse_variable(stream::Array_Stream<Token<Keyword>>& stream, Token<K
 static inline void parse_alias(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>& identifier, AST_Node** previous_sibling_addr);
 static void parse_function(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>& identifier, AST_Node** previous_sibling_addr);
 static void parse_function_call(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>& identifier, AST_Function_Call** emplace_node);
+static void parse_return(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr);
+static void parse_switch(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr);
+static void parse_import(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr);
+static void parse_directive(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** emplace_node, AST_Node** previous_child);
 static void parse_struct(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>* identifier, AST_Node** previous_sibling_addr); /// @param identifier If null the union is anonymous
 static void parse_enum(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>& identifier, AST_Node** previous_sibling_addr);
 static void parse_union(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>* identifier, AST_Node** previous_sibling_addr); /// @param identifier If null the union is anonymous
@@ -276,6 +276,7 @@ void parse_variable(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>
 	variable->is_function_parameter = is_function_parameter;
 	variable->is_optional = false;
 	variable->expression = nullptr;
+	variable->type_info = nullptr;
 
 	*variable_ = variable;
 
@@ -328,6 +329,7 @@ void parse_alias(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>& i
 	alias_node->ast_type = Node_Type::TYPE_ALIAS;
 	alias_node->sibling = nullptr;
 	alias_node->name = identifier;
+	alias_node->type_info = nullptr;
 
 	parse_expression(stream, &alias_node->type, Punctuation::SEMICOLON);
 	stream::peek(stream); // ;
@@ -356,6 +358,7 @@ void parse_function(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>
 	function_node->arguments = nullptr;
 	function_node->return_type = nullptr;
 	function_node->scope = nullptr;
+	function_node->modifiers = nullptr;
 
 	current_token = stream::get(stream);
 
@@ -446,11 +449,14 @@ void parse_function(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>
 				current_token = stream::get(stream);
 
 				AST_Function_Modifier** current_modifier = &function_node->modifiers;
+
 				while (!(current_token.type == Token_Type::SYNTAXE_OPERATOR
 					&& (current_token.value.punctuation == Punctuation::SEMICOLON
 						|| current_token.value.punctuation == Punctuation::OPEN_BRACE)))
 				{
-					if (current_token.type == Token_Type::IDENTIFIER)
+					// inline is a keyword, other modifiers are identifiers
+					if (current_token.type == Token_Type::IDENTIFIER
+						|| (current_token.type == Token_Type::KEYWORD && current_token.value.keyword == Keyword::INLINE))
 					{
 						AST_Function_Modifier* modifier_node = allocate_AST_node<AST_Function_Modifier>((AST_Node**)current_modifier);
 
@@ -529,17 +535,27 @@ void parse_function_call(stream::Array_Stream<Token<Keyword>>& stream, Token<Key
 	function_call->sibling = nullptr;
 	function_call->name = identifier;
 	function_call->nb_arguments = 0;
+	function_call->parameters = nullptr;
+	function_call->symbol_table = globals.parser_data.current_symbol_table;
+
+	stream::peek(stream); // (
+	current_token = stream::get(stream);
 
 	// @TODO add the check of eof with the error message
 	current_expression_node = &function_call->parameters;
 	while (!(current_token.type == Token_Type::SYNTAXE_OPERATOR
 		&& current_token.value.punctuation == Punctuation::CLOSE_PARENTHESIS))
 	{
-		stream::peek(stream); // ( or ,
 		parse_expression(stream, (AST_Node**)current_expression_node, Punctuation::COMMA, Punctuation::CLOSE_PARENTHESIS);
 		current_token = stream::get(stream);
 		function_call->nb_arguments++;
 		current_expression_node = (AST_Node**)&(*current_expression_node)->sibling;
+
+		if (current_token.type == Token_Type::SYNTAXE_OPERATOR
+			&& current_token.value.punctuation == Punctuation::COMMA) {
+			stream::peek(stream); // ,
+			current_token = stream::get(stream);
+		}
 	}
 	stream::peek(stream); // )
 
@@ -553,6 +569,8 @@ void parse_struct(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>*
 	Token<Keyword>						current_token;
 	AST_Statement_Struct_Type*	struct_node = allocate_AST_node<AST_Statement_Struct_Type>(previous_sibling_addr);
 
+	struct_node->type_info = nullptr;
+
 	current_token = stream::get(stream); // {
 
 	if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::OPEN_BRACE)) {
@@ -600,6 +618,8 @@ void parse_union(stream::Array_Stream<Token<Keyword>>& stream, Token<Keyword>* i
 	Token<Keyword>						current_token;
 	AST_Statement_Union_Type*	union_node = allocate_AST_node<AST_Statement_Union_Type>(previous_sibling_addr);
 
+	union_node->type_info = nullptr;
+
 	current_token = stream::get(stream); // {
 
 	if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::OPEN_BRACE)) {
@@ -643,18 +663,17 @@ void parse_binary_operator(stream::Array_Stream<Token<Keyword>>& stream, AST_Nod
 	binary_operator_node->token = stream::get(stream);
 	binary_operator_node->left = *previous_child;
 	binary_operator_node->right = nullptr;
+	binary_operator_node->is_scoped_by_parenthesis = false;
 
 	*previous_child = (AST_Node*)binary_operator_node;
 	stream::peek(stream); // the binary operator
 
-	bool scoped_by_parenthesis = parse_expression(stream, &binary_operator_node->right, delimiter_1, delimiter_2);
+	parse_expression(stream, &binary_operator_node->right, delimiter_1, delimiter_2);
 
 	// @TODO may want to take a look at precedence climbing:
 	// https://eli.thegreenplace.net/2012/08/02/parsing-expressions-by-precedence-climbing
 	// Is it already what I do???
-	if (scoped_by_parenthesis == false) {
-		fix_operations_order(binary_operator_node);
-	}
+	fix_operations_order(binary_operator_node);
 }
 
 void fix_operations_order(AST_Binary_Operator* binary_operator_node)
@@ -667,11 +686,10 @@ void fix_operations_order(AST_Binary_Operator* binary_operator_node)
 
 	AST_Binary_Operator* right_node = (AST_Binary_Operator*)binary_operator_node->right;
 
-	if (does_left_operator_precedeed_right(binary_operator_node->ast_type, right_node->ast_type) == false)
+	if (right_node->is_scoped_by_parenthesis
+		|| does_left_operator_precedeed_right(binary_operator_node->ast_type, right_node->ast_type) == false)
 		return;
 
-	// @TODO Handle parenthesis by starting a new sub-expression? but we want to simplify it, so maybe by setting a flag on the node
-
 	// Step 1: Swap operator types
 	{
 		Node_Type right_operator_node_type = right_node->ast_type;
@@ -700,6 +718,10 @@ void fix_operations_order(AST_Binary_Operator* binary_operator_node)
 		binary_operator_node->left = (AST_Node*)right_node;
 		binary_operator_node->right = temp_node;
 	}
+
+	// The right side was already ordered, but the operator that went down can precede the left operator of the
+	// operand it took: a + b * c + d * e is a + (b * (c + (d * e))) before the first rotation
+	fix_operations_order(right_node);
 }
 
 void parse_unary_operator(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** emplace_node, Node_Type node_type, AST_Node** previous_child, Punctuation delimiter_1, Punctuation delimiter_2)
@@ -717,6 +739,201 @@ void parse_unary_operator(stream::Array_Stream<Token<Keyword>>& stream, AST_Node
 	stream::peek(stream); // the unary operator
 
 	parse_expression(stream, &unary_operator_node->right, delimiter_1, delimiter_2);
+
+	// Unary operators precede binary ones, except the member access: the operand is the leftmost one of the
+	// expression on the right, -a + b is (-a) + b
+	if (is_binary_operator(unary_operator_node->right) == false
+		|| ((AST_Binary_Operator*)unary_operator_node->right)->is_scoped_by_parenthesis
+		|| unary_operator_node->right->ast_type == Node_Type::BINARY_OPERATOR_MEMBER_ACCESS)
+		return;
+
+	AST_Binary_Operator* expression_node = (AST_Binary_Operator*)unary_operator_node->right;
+	AST_Binary_Operator* leftmost_node = expression_node;
+
+	while (is_binary_operator(leftmost_node->left)
+		&& ((AST_Binary_Operator*)leftmost_node->left)->is_scoped_by_parenthesis == false
+		&& leftmost_node->left->ast_type != Node_Type::BINARY_OPERATOR_MEMBER_ACCESS) {
+		leftmost_node = (AST_Binary_Operator*)leftmost_node->left;
+	}
+
+	unary_operator_node->right = leftmost_node->left;
+	leftmost_node->left = (AST_Node*)unary_operator_node;
+	*emplace_node = (AST_Node*)expression_node;
+	*previous_child = (AST_Node*)expression_node;
+}
+
+void parse_return(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr)
+{
+	ZoneScopedN("parse_return");
+
+	Token<Keyword>			current_token;
+	AST_Statement_Return*	return_node = allocate_AST_node<AST_Statement_Return>(previous_sibling_addr);
+
+	return_node->ast_type = Node_Type::STATEMENT_RETURN;
+	return_node->sibling = nullptr;
+	return_node->token = stream::get(stream);
+	return_node->expression = nullptr;
+
+	stream::peek(stream); // return
+
+	current_token = stream::get(stream);
+	if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::SEMICOLON)) {
+		parse_expression(stream, &return_node->expression, Punctuation::SEMICOLON);
+	}
+
+	stream::peek(stream); // ;
+}
+
+void parse_switch(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr)
+{
+	ZoneScopedN("parse_switch");
+
+	Token<Keyword>			current_token;
+	AST_Statement_Switch*	switch_node = allocate_AST_node<AST_Statement_Switch>(previous_sibling_addr);
+	AST_Switch_Case**		current_case = &switch_node->cases;
+
+	switch_node->ast_type = Node_Type::STATEMENT_SWITCH;
+	switch_node->sibling = nullptr;
+	switch_node->token = stream::get(stream);
+	switch_node->expression = nullptr;
+	switch_node->cases = nullptr;
+
+	stream::peek(stream); // switch
+
+	parse_expression(stream, &switch_node->expression, Punctuation::OPEN_BRACE);
+	if (switch_node->expression == nullptr) {
+		report_error(Compiler_Error::error, switch_node->token, "Expecting an expression after switch.");
+	}
+
+	stream::peek(stream); // {
+
+	while (stream::is_eof(stream) == false)
+	{
+		current_token = stream::get(stream);
+
+		if (current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::CLOSE_BRACE) {
+			stream::peek(stream); // }
+			return;
+		}
+
+		if (!(current_token.type == Token_Type::KEYWORD
+			&& (current_token.value.keyword == Keyword::CASE || current_token.value.keyword == Keyword::DEFAULT))) {
+			report_error(Compiler_Error::error, current_token, "Expecting a case or default in the switch.");
+		}
+
+		AST_Switch_Case*	case_node = allocate_AST_node<AST_Switch_Case>((AST_Node**)current_case);
+		AST_Node**			current_value = &case_node->values;
+
+		case_node->ast_type = Node_Type::STATEMENT_CASE;
+		case_node->sibling = nullptr;
+		case_node->token = current_token;
+		case_node->values = nullptr;
+		case_node->scope = nullptr;
+		current_case = (AST_Switch_Case**)&case_node->sibling;
+
+		stream::peek(stream); // case or default
+
+		// Values are separated by comma: case 1, 2, 3 { ... }
+		while (case_node->token.value.keyword == Keyword::CASE) {
+			parse_expression(stream, current_value, Punctuation::COMMA, Punctuation::OPEN_BRACE);
+			if (*current_value == nullptr) {
+				report_error(Compiler_Error::error, case_node->token, "Expecting a value after case.");
+			}
+			current_value = &(*current_value)->sibling;
+
+			current_token = stream::get(stream);
+			if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::COMMA)) {
+				break;
+			}
+			stream::peek(stream); // ,
+		}
+
+		current_token = stream::get(stream);
+		if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::OPEN_BRACE)) {
+			report_error(Compiler_Error::error, current_token, "Expecting '{' after the values of the case.");
+		}
+
+		push_new_symbol_table(Scope_Type::SCOPE, nullptr);
+		parse_scope(stream, &case_node->scope);
+		pop_symbol_table();
+	}
+
+	report_error(Compiler_Error::error, switch_node->token, "Unexpected end of file in the switch.");
+}
+
+void parse_import(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** previous_sibling_addr)
+{
+	ZoneScopedN("parse_import");
+
+	Token<Keyword>			current_token;
+	AST_Statement_Import*	import_node = allocate_AST_node<AST_Statement_Import>(previous_sibling_addr);
+
+	stream::peek(stream); // import
+	current_token = stream::get(stream);
+
+	if (current_token.type != Token_Type::IDENTIFIER) {
+		report_error(Compiler_Error::error, current_token, "Expecting a module name after import.");
+	}
+
+	import_node->ast_type = Node_Type::STATEMENT_IMPORT;
+	import_node->sibling = nullptr;
+	import_node->name = current_token;
+
+	// The module is loaded asynchronously, the parsing continue while it is lexed and parsed by a worker
+	import_node->module = import_module(current_token);
+
+	stream::peek(stream); // identifier
+	current_token = stream::get(stream);
+
+	if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::SEMICOLON)) {
+		report_error(Compiler_Error::error, current_token, "Expecting ';' after the module name.");
+	}
+
+	stream::peek(stream); // ;
+}
+
+void parse_directive(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** emplace_node, AST_Node** previous_child)
+{
+	ZoneScopedN("parse_directive");
+
+	Token<Keyword>	current_token;
+
+	fstd::language::string_view	run_string;
+	fstd::language::assign(run_string, (uint8_t*)"run");
+
+	stream::peek(stream); // #
+	current_token = stream::get(stream);
+
+	if (current_token.type != Token_Type::IDENTIFIER
+		|| fstd::language::are_equals(current_token.text, run_string) == false) {
+		report_error(Compiler_Error::error, current_token, "Unknown directive.");
+	}
+
+	AST_Directive_Run*	run_node = allocate_AST_node<AST_Directive_Run>(emplace_node);
+
+	run_node->ast_type = Node_Type::DIRECTIVE_RUN;
+	run_node->sibling = nullptr;
+	run_node->token = current_token;
+	run_node->function_call = nullptr;
+
+	*previous_child = (AST_Node*)run_node;
+	stream::peek(stream); // run
+
+	// @TODO support any expression, for the moment only a function call can be executed at compile time
+	Token<Keyword>	identifier = stream::get(stream);
+
+	if (identifier.type != Token_Type::IDENTIFIER) {
+		report_error(Compiler_Error::error, identifier, "#run expects a function call.");
+	}
+
+	stream::peek(stream); // identifier
+	current_token = stream::get(stream);
+
+	if (!(current_token.type == Token_Type::SYNTAXE_OPERATOR && current_token.value.punctuation == Punctuation::OPEN_PARENTHESIS)) {
+		report_error(Compiler_Error::error, current_token, "#run expects a function call.");
+	}
+
+	parse_function_call(stream, identifier, &run_node->function_call);
 }
 
 bool parse_expression(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** emplace_node, Punctuation delimiter_1, Punctuation delimiter_2 /* = Punctuation::UNKNOWN */)
@@ -746,7 +963,13 @@ bool parse_expression(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** e
 			else if (current_token.value.punctuation == Punctuation::OPEN_PARENTHESIS)
 			{
 				stream::peek(stream); // (
-				parse_expression(stream, emplace_node, delimiter_1, delimiter_1);
+				parse_expression(stream, emplace_node, Punctuation::CLOSE_PARENTHESIS);
+				stream::peek(stream); // )
+
+				if (is_binary_operator(*emplace_node)) {
+					((AST_Binary_Operator*)*emplace_node)->is_scoped_by_parenthesis = true;
+				}
+				previous_child = *emplace_node;
 				scoped_by_parenthesis = true;
 			}
 			else if (current_token.value.punctuation == Punctuation::CLOSE_PARENTHESIS)
@@ -778,6 +1001,9 @@ bool parse_expression(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** e
 			else if (current_token.value.punctuation == Punctuation::DOT) {
 				parse_binary_operator(stream, emplace_node, Node_Type::BINARY_OPERATOR_MEMBER_ACCESS, &previous_child, delimiter_1, delimiter_2);
 			}
+			else if (current_token.value.punctuation == Punctuation::HASH) {
+				parse_directive(stream, emplace_node, &previous_child);
+			}
 			// @TODO add other arithmetic operators (bits operations,...)
 
 			// @TODO handle pointer symbol  for alias
@@ -803,6 +1029,7 @@ bool parse_expression(stream::Array_Stream<Token<Keyword>>& stream, AST_Node** e
 			if (current_token.type == Token_Type::SYNTAXE_OPERATOR
 				&& current_token.value.punctuation == Punctuation::OPEN_PARENTHESIS) {
 				parse_function_call(stream, identifier, (AST_Function_Call**)emplace_node);
+				previous_child = *emplace_node;
 			}
 			else {
 				// A variable name
@@ -883,9 +1110,19 @@ void parse_scope(stream::Array_Stream<Token<Keyword>>& stream, AST_Statement_Sco
 
 		if (current_token.type == Token_Type::KEYWORD) {
 			if (current_token.value.keyword == Keyword::IMPORT) {
-				stream::peek<Token<Keyword>>(stream);
-				// @TODO implement
-				core::Assert(false);
+				if (is_root_node == false) {
+					report_error(Compiler_Error::error, current_token, "Modules can only be imported at global scope.");
+				}
+				parse_import(stream, current_child);
+				current_child = &(*current_child)->sibling;
+			}
+			else if (current_token.value.keyword == Keyword::RETURN && is_root_node == false) {
+				parse_return(stream, current_child);
+				current_child = &(*current_child)->sibling;
+			}
+			else if (current_token.value.keyword == Keyword::SWITCH && is_root_node == false) {
+				parse_switch(stream, current_child);
+				current_child = &(*current_child)->sibling;
 			}
 			else
 			{
@@ -1208,6 +1445,7 @@ void initialize_symbol_table(Symbol_Table* symbol_table, Symbol_Table* parent, S
 	symbol_table->parent = parent;
 	symbol_table->sibling = sibling;
 	symbol_table->first_child = nullptr;
+	symbol_table->module = nullptr;
 }
 
 void f::parse(fstd::memory::Array<Token<Keyword>>& tokens, Parsing_Result& parsing_result)
@@ -1223,18 +1461,30 @@ void f::parse(fstd::memory::Array<Token<Keyword>>& tokens, Parsing_Result& parsi
 	// We expect to be able to determine with the meta-programmation which AST_Node type is the largest one.
 	//
 	// Flamaros - 13 april 2020
+	//
+	// @Warning each parse use new buffers, nodes of modules parsed before by this thread have to keep their addresses.
+	memory::init(globals.parser_data.ast_nodes);
+	memory::init(globals.parser_data.symbol_tables);
+	globals.parser_data.current_symbol_table = nullptr;
+
 	memory::reserve_array(globals.parser_data.ast_nodes, memory::get_array_size(tokens) * sizeof(AST_Statement_Variable));
 	memory::reserve_array(globals.parser_data.symbol_tables, memory::get_array_size(tokens) * sizeof(Symbol_Table));
 
 	stream::initialize_memory_stream<Token<Keyword>>(stream, tokens);
 
+	parsing_result.ast_root = nullptr;
+	parsing_result.symbol_table_root = nullptr;
+	parsing_result.ast_nodes_size = 0;
+
 	if (stream::is_eof(stream) == true) {
 		return;
 	}
 
 	push_new_symbol_table(Scope_Type::MODULE, nullptr);
 	parsing_result.symbol_table_root = globals.parser_data.current_symbol_table;
+	parsing_result.symbol_table_root->module = globals.parser_data.current_module;
 	parse_scope(stream, (AST_Statement_Scope**)&parsing_result.ast_root, true);
+	parsing_result.ast_nodes_size = memory::get_array_size(globals.parser_data.ast_nodes);
 }
 
 static void write_dot_node(String_Builder& file_string_builder, const AST_Node* node, int64_t parent_index = -1, int64_t left_node_index = -1)
@@ -1339,10 +1589,26 @@ static void write_dot_node(String_Builder& file_string_builder, const AST_Node*
 				"%Cv"
 				"\n%ld", magic_enum::enum_name(node->ast_type), literal_node->value.value.integer);
 		}
+		else if (literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI32
+			|| literal_node->value.type == Token_Type::NUMERIC_LITERAL_UI64) {
+			print_to_builder(file_string_builder,
+				"%Cv"
+				"\n%lu", magic_enum::enum_name(node->ast_type), literal_node->value.value.unsigned_integer);
+		}
+		else if (literal_node->value.type >= Token_Type::NUMERIC_LITERAL_F32
+			&& literal_node->value.type <= Token_Type::NUMERIC_LITERAL_REAL) {
+			// float arguments are promoted to double by variadic calls
+			double value = literal_node->value.type == Token_Type::NUMERIC_LITERAL_F32 ? (double)literal_node->value.value.real_32
+				: literal_node->value.type == Token_Type::NUMERIC_LITERAL_F64 ? literal_node->value.value.real_64
+				: (double)literal_node->value.value.real_max;
+
+			print_to_builder(file_string_builder,
+				"%Cv"
+				"\n%lf", magic_enum::enum_name(node->ast_type), value);
+		}
 		else {
 			core::Assert(false);
 			// @TODO implement it
-			// Actually the string builder doesn't support floats and unsigned intergers
 		}
 	}
 	else if (node->ast_type == Node_Type::STATEMENT_IDENTIFIER) {
@@ -1359,6 +1625,32 @@ static void write_dot_node(String_Builder& file_string_builder, const AST_Node*
 			"%Cv"
 			"\nname: %v (nb_arguments: %d)", magic_enum::enum_name(node->ast_type), function_call_node->name.text, function_call_node->nb_arguments);
 	}
+	else if (node->ast_type == Node_Type::STATEMENT_RETURN) {
+		print_to_builder(file_string_builder,
+			"%Cv", magic_enum::enum_name(node->ast_type));
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_SWITCH) {
+		print_to_builder(file_string_builder,
+			"%Cv", magic_enum::enum_name(node->ast_type));
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_CASE) {
+		AST_Switch_Case* case_node = (AST_Switch_Case*)node;
+
+		print_to_builder(file_string_builder,
+			"%Cv"
+			"\n%v", magic_enum::enum_name(node->ast_type), case_node->token.text);
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_IMPORT) {
+		AST_Statement_Import* import_node = (AST_Statement_Import*)node;
+
+		print_to_builder(file_string_builder,
+			"%Cv"
+			"\n%v", magic_enum::enum_name(node->ast_type), import_node->name.text);
+	}
+	else if (node->ast_type == Node_Type::DIRECTIVE_RUN) {
+		print_to_builder(file_string_builder,
+			"%Cv", magic_enum::enum_name(node->ast_type));
+	}
 	else if (is_unary_operator(node)) {
 		AST_Unary_operator* address_of_node = (AST_Unary_operator*)node;
 
@@ -1450,6 +1742,28 @@ static void write_dot_node(String_Builder& file_string_builder, const AST_Node*
 
 		write_dot_node(file_string_builder, (AST_Node*)function_call_node->parameters, node_index);
 	}
+	else if (node->ast_type == Node_Type::STATEMENT_RETURN) {
+		AST_Statement_Return* return_node = (AST_Statement_Return*)node;
+
+		write_dot_node(file_string_builder, return_node->expression, node_index);
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_SWITCH) {
+		AST_Statement_Switch* switch_node = (AST_Statement_Switch*)node;
+
+		write_dot_node(file_string_builder, switch_node->expression, node_index);
+		write_dot_node(file_string_builder, (AST_Node*)switch_node->cases, node_index);
+	}
+	else if (node->ast_type == Node_Type::STATEMENT_CASE) {
+		AST_Switch_Case* case_node = (AST_Switch_Case*)node;
+
+		write_dot_node(file_string_builder, case_node->values, node_index);
+		write_dot_node(file_string_builder, (AST_Node*)case_node->scope, node_index);
+	}
+	else if (node->ast_type == Node_Type::DIRECTIVE_RUN) {
+		AST_Directive_Run* run_node = (AST_Directive_Run*)node;
+
+		write_dot_node(file_string_builder, (AST_Node*)run_node->function_call, node_index);
+	}
 	else if (is_unary_operator(node)) {
 		AST_Unary_operator* address_of_node = (AST_Unary_operator*)node;
 
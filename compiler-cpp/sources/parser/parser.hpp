@@ -22,8 +22,12 @@ namespace f
 	struct AST_Statement_Scope;
 	struct AST_Literal;
 	struct AST_Identifier;
+	struct AST_Function_Call;
+	struct AST_Switch_Case;
+	struct Type_Info;
 
 	struct Symbol_Table;
+	struct Module;
 
 	//=============================================================================
 
@@ -48,6 +52,7 @@ namespace f
 		TYPE_STRUCT,
 
 		STATEMENT_MODULE,
+		STATEMENT_IMPORT,
 		STATEMENT_BASIC_TYPE,
 		USER_TYPE_IDENTIFIER,
 		STATEMENT_TYPE_STRUCT,
@@ -60,10 +65,16 @@ namespace f
 		STATEMENT_SCOPE,
 		STATEMENT_LITERAL,
 		STATEMENT_IDENTIFIER,
+		STATEMENT_RETURN,
+		STATEMENT_SWITCH,
+		STATEMENT_CASE,
 
 		ASSIGNMENT,
 		FUNCTION_CALL,
 
+		// Directives
+		DIRECTIVE_RUN,
+
 		// Unary operators
 		UNARY_OPERATOR_NEGATIVE,
 		UNARY_OPERATOR_ADDRESS_OF,
@@ -117,6 +128,7 @@ namespace f
 		Token<Keyword>	token;
 		AST_Node*		left;
 		AST_Node*		right;
+		bool			is_scoped_by_parenthesis;	// The precedence of operators can't move its operands
 	};
 
 	struct AST_Alias
@@ -125,6 +137,7 @@ namespace f
 		AST_Node*		sibling;
 		Token<Keyword>	name; // Should be a pointer to avoid the copy?
 		AST_Node*		type; // Is an expression that have to be evaluable at compile-time and return a Type (basic or struct or enum, Type, function,...)
+		Type_Info*		type_info; // Set by the type deduction pass
 	};
 
 	struct AST_Enum_Value
@@ -150,6 +163,14 @@ namespace f
 		AST_Node*	first_child;
 	};
 
+	struct AST_Statement_Import
+	{
+		Node_Type		ast_type;
+		AST_Node*		sibling;
+		Token<Keyword>	name;
+		Module*			module;
+	};
+
 	struct AST_Statement_Basic_Type
 	{
 		Node_Type		ast_type;
@@ -165,6 +186,7 @@ namespace f
 		bool			anonymous;
 		Token<Keyword>	name; // @Warning is uninitialized if anonymous is true
 		AST_Node*		first_child;
+		Type_Info*		type_info; // Set by the type deduction pass
 	};
 
 	struct AST_Statement_Union_Type
@@ -174,6 +196,7 @@ namespace f
 		bool			anonymous;
 		Token<Keyword>	name; // @Warning is uninitialized if anonymous is true
 		AST_Node*		first_child;
+		Type_Info*		type_info; // Set by the type deduction pass
 	};
 
 	struct AST_Statement_Enum_Type
@@ -216,6 +239,7 @@ namespace f
 		bool			is_function_parameter;
 		bool			is_optional;
 		AST_Node*		expression; // not null if is_optional is true
+		Type_Info*		type_info; // Set by the type deduction pass
 	};
 
 	struct AST_Statement_Function
@@ -245,6 +269,7 @@ namespace f
 		Token<Keyword>	name;
 		int				nb_arguments;
 		AST_Node*		parameters;
+		Symbol_Table*	symbol_table; // To be able to find the function declaration
 	};
 
 	struct AST_Statement_Scope
@@ -286,6 +311,44 @@ namespace f
 		AST_Node*	right;
 	};
 
+	struct AST_Statement_Return
+	{
+		Node_Type		ast_type;
+		AST_Node*		sibling;
+		Token<Keyword>	token;
+		AST_Node*		expression; // nullptr if the function return nothing
+	};
+
+	// switch value { case 1 { ... } case 2, 3 { ... } default { ... } }
+	// Values of cases are constant integers, there is no fall through from a case to the next one.
+	struct AST_Statement_Switch
+	{
+		Node_Type			ast_type;
+		AST_Node*			sibling;
+		Token<Keyword>		token;
+		AST_Node*			expression;
+		AST_Switch_Case*	cases;	// Linked by sibling, in the order of the source
+	};
+
+	struct AST_Switch_Case
+	{
+		Node_Type				ast_type;
+		AST_Node*				sibling;
+		Token<Keyword>			token;	// case or default
+		AST_Node*				values;	// Linked by sibling, nullptr for the default case
+		AST_Statement_Scope*	scope;
+	};
+
+	struct AST_Directive_Run
+	{
+		// @Warning the beginning of this struct should stay the same than AST_Literal, because
+		// the node is replaced by the literal of the result after the compile-time execution.
+		Node_Type			ast_type;
+		AST_Node*			sibling;
+		Token<Keyword>		token;
+		AST_Function_Call*	function_call;
+	};
+
 	//=============================================================================
 
 	enum class Scope_Type
@@ -311,6 +374,8 @@ namespace f
 		Symbol_Table* parent;
 		Symbol_Table* sibling;
 		Symbol_Table* first_child;
+
+		Module*	module; // Only set on the root symbol table of a module, the lookup continue in its imports
 	};
 
 	//=============================================================================
@@ -319,6 +384,7 @@ namespace f
 	{
 		AST_Node*		ast_root; // Should point on the first module
 		Symbol_Table*	symbol_table_root;
+		size_t			ast_nodes_size; // Size in bytes of the nodes allocated by this parsing
 	};
 
 	struct Parser_Data
@@ -341,6 +407,7 @@ namespace f
 		fstd::memory::Array<uint8_t>	symbol_tables;
 
 		Symbol_Table* current_symbol_table;
+		Module*		current_module; // Module parsed by this thread, nullptr when the file is parsed outside of the module loader
 	};
 
     void parse(fstd::memory::Array<Token<Keyword>>& tokens, Parsing_Result& ast);
@@ -2,6 +2,7 @@
 
 #include "globals.hpp"
 #include "parser.hpp"
+#include "modules.hpp"
 
 #include "lexer/lexer.hpp"
 
@@ -11,31 +12,66 @@
 
 using namespace f;
 
-static AST_Node* get_user_type(Token<Keyword>* identifier, Symbol_Table* symbol_table)
+typedef fstd::memory::Hash_Table<uint16_t, fstd::language::string_view, AST_Node*, 32> Symbol_Hash_Table;
+
+// Search the symbol in the symbol table and its parents, then in the global scope of modules imported by the module
+// that contains them (imports aren't transitive).
+// Return nullptr if the symbol isn't found.
+static AST_Node* find_symbol(Symbol_Table* symbol_table, Symbol_Hash_Table Symbol_Table::* symbols, Token<Keyword>& identifier)
 {
-	uint64_t hash = SpookyHash::Hash64((const void*)fstd::language::to_utf8(identifier->text), fstd::language::get_string_size(identifier->text), 0);
+	uint64_t hash = SpookyHash::Hash64((const void*)fstd::language::to_utf8(identifier.text), fstd::language::get_string_size(identifier.text), 0);
 	uint16_t short_hash = hash & 0xffff;
 
 	// @TODO do we need check shadowing here?
-	// Declaration of the same type in upper scope?
+	// Declaration of the same symbol in upper scope?
 
-	while (symbol_table)
+	Symbol_Table* module_symbol_table = nullptr;
+
+	for (; symbol_table; symbol_table = symbol_table->parent)
 	{
-		AST_Node** type_ptr = fstd::memory::hash_table_get(symbol_table->user_types, short_hash, identifier->text);
+		AST_Node** symbol_ptr = fstd::memory::hash_table_get(symbol_table->*symbols, short_hash, identifier.text);
 
-		if (type_ptr) {
-			AST_Node* type = *type_ptr;
-			return type;
+		if (symbol_ptr) {
+			return *symbol_ptr;
 		}
-		symbol_table = symbol_table->parent;
+		module_symbol_table = symbol_table;
 	}
 
-	report_error(Compiler_Error::error, *identifier, "Unknown type.");
+	if (module_symbol_table && module_symbol_table->module) {
+		Module* module = module_symbol_table->module;
+
+		// @TODO report an error when the symbol is ambiguous (declared by many imported modules)
+		for (size_t i = 0; i < fstd::memory::get_array_size(module->imports); i++)
+		{
+			Symbol_Table* imported_symbol_table = get_symbol_table(module->imports[i]);
+
+			if (imported_symbol_table == nullptr) { // Empty module
+				continue;
+			}
+
+			AST_Node** symbol_ptr = fstd::memory::hash_table_get(imported_symbol_table->*symbols, short_hash, identifier.text);
+
+			if (symbol_ptr) {
+				return *symbol_ptr;
+			}
+		}
+	}
 
-	// Just because the compiler request it, but we already exited the program with the error report.
 	return nullptr;
 }
 
+static AST_Node* get_user_type(Token<Keyword>* identifier, Symbol_Table* symbol_table)
+{
+	AST_Node* type = find_symbol(symbol_table, &Symbol_Table::user_types, *identifier);
+
+	if (type == nullptr) {
+		report_error(Compiler_Error::error, *identifier, "Unknown type.");
+	}
+
+	// Just because the compiler request it, but we already exited the program with the error report.
+	return type;
+}
+
 AST_Node* f::get_user_type(AST_User_Type_Identifier* user_type)
 {
 	return ::get_user_type(&user_type->identifier, user_type->symbol_table);
@@ -46,6 +82,26 @@ AST_Node* f::get_user_type(AST_Identifier* user_type)
 	return ::get_user_type(&user_type->value, user_type->symbol_table);
 }
 
+AST_Statement_Function* f::get_function(AST_Function_Call* function_call)
+{
+	AST_Node* function = find_symbol(function_call->symbol_table, &Symbol_Table::functions, function_call->name);
+
+	if (function == nullptr) {
+		report_error(Compiler_Error::error, function_call->name, "Unknown function.");
+	}
+	return (AST_Statement_Function*)function;
+}
+
+AST_Statement_Variable* f::get_variable(AST_Identifier* identifier)
+{
+	AST_Node* variable = find_symbol(identifier->symbol_table, &Symbol_Table::variables, identifier->value);
+
+	if (variable == nullptr) {
+		report_error(Compiler_Error::error, identifier->value, "Unknown variable.");
+	}
+	return (AST_Statement_Variable*)variable;
+}
+
 AST_Node* f::resolve_type(AST_Node* user_type)
 {
 	if (user_type->ast_type == Node_Type::TYPE_ALIAS) {
@@ -7,8 +7,13 @@ namespace f
 	struct AST_Node;
 	struct AST_Identifier;
 	struct AST_User_Type_Identifier;
+	struct AST_Function_Call;
+	struct AST_Statement_Function;
+	struct AST_Statement_Variable;
 
 	AST_Node* get_user_type(AST_User_Type_Identifier* user_type);
 	AST_Node* get_user_type(AST_Identifier* user_type);
 	AST_Node* resolve_type(AST_Node* user_type); // Return the underlying type if user_type is an alias (can be called with any AST_Node type)
+	AST_Statement_Function* get_function(AST_Function_Call* function_call);
+	AST_Statement_Variable* get_variable(AST_Identifier* identifier);
 }
@@ -0,0 +1,506 @@
+#include "type_table.hpp"
+
+#include "globals.hpp"
+#include "parser.hpp"
+#include "symbol_solver.hpp"
+
+#include "lexer/lexer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <limits> // @TODO remove it
+
+using namespace fstd;
+
+using namespace f;
+
+// =============================================================================
+
+inline Type_Info* allocate_type(Type_Info::Kind kind)
+{
+	// Ensure that no reallocation could happen during the resize
+	bool overflow_preallocated_buffer = memory::get_array_size(globals.type_table_data.types) >= memory::get_array_reserved(globals.type_table_data.types);
+
+	core::Assert(overflow_preallocated_buffer == false);
+	if (overflow_preallocated_buffer) {
+		report_error(Compiler_Error::internal_error, "The compiler did not allocate enough memory to store Type_Info!");
+	}
+
+	Type_Info* new_type = memory::array_emplace_back_unchecked(globals.type_table_data.types);
+
+	new_type->kind = kind;
+	new_type->keyword = Keyword::UNKNOWN;
+	new_type->layout_in_progress = false;
+	new_type->size = 0;
+	new_type->alignment = 1;
+	new_type->element_type = nullptr;
+	new_type->array_count = 0;
+	new_type->declaration = nullptr;
+	new_type->fields = nullptr;
+	new_type->nb_fields = 0;
+	new_type->pointer_type = nullptr;
+	new_type->first_array_type = nullptr;
+	new_type->next_array_type = nullptr;
+	return new_type;
+}
+
+// Fields of a type are contiguous
+inline Type_Field* allocate_fields(size_t nb_fields)
+{
+	// Ensure that no reallocation could happen during the resize
+	bool overflow_preallocated_buffer = memory::get_array_size(globals.type_table_data.fields) + nb_fields > memory::get_array_reserved(globals.type_table_data.fields);
+
+	core::Assert(overflow_preallocated_buffer == false);
+	if (overflow_preallocated_buffer) {
+		report_error(Compiler_Error::internal_error, "The compiler did not allocate enough memory to store Type_Field!");
+	}
+
+	return memory::array_emplace_back_unchecked(globals.type_table_data.fields, nb_fields);
+}
+
+inline size_t align_offset(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// =============================================================================
+
+static void initialize_basic_types()
+{
+	struct Basic_Type_Layout
+	{
+		Keyword	keyword;
+		size_t	size;
+		size_t	alignment;
+	};
+
+	// x64 sizes, bool is stored on a byte like in C
+	static const Basic_Type_Layout layouts[] = {
+		{Keyword::VOID,			0,	1},
+		{Keyword::BOOL,			1,	1},
+		{Keyword::I8,			1,	1},
+		{Keyword::UI8,			1,	1},
+		{Keyword::I16,			2,	2},
+		{Keyword::UI16,			2,	2},
+		{Keyword::I32,			4,	4},
+		{Keyword::UI32,			4,	4},
+		{Keyword::I64,			8,	8},
+		{Keyword::UI64,			8,	8},
+		{Keyword::F32,			4,	4},
+		{Keyword::F64,			8,	8},
+		{Keyword::F32X4,		16,	16},
+		{Keyword::F64X2,		16,	16},
+		{Keyword::I8X16,		16,	16},
+		{Keyword::I16X8,		16,	16},
+		{Keyword::I32X4,		16,	16},
+		{Keyword::I64X2,		16,	16},
+		{Keyword::STRING,		16,	8},	// data and size
+		{Keyword::STRING_VIEW,	16,	8},	// data and size
+		{Keyword::TYPE,			8,	8},	// Pointer on the type description
+	};
+	static_assert(sizeof(layouts) / sizeof(layouts[0]) == sizeof(Type_Table_Data::basic_types) / sizeof(Type_Table_Data::basic_types[0]), "All basic types should have a layout.");
+
+	for (const Basic_Type_Layout& layout : layouts)
+	{
+		Type_Info* type = allocate_type(Type_Info::Kind::BASIC);
+
+		type->keyword = layout.keyword;
+		type->size = layout.size;
+		type->alignment = layout.alignment;
+
+		globals.type_table_data.basic_types[(size_t)layout.keyword - (size_t)Keyword::VOID] = type;
+	}
+
+	// Strings are built-in structs, giving them fields allow the member access to work like on user structs.
+	static fstd::language::string_view	data_string;
+	static fstd::language::string_view	size_string;
+
+	language::assign(data_string, (uint8_t*)"data");
+	language::assign(size_string, (uint8_t*)"size");
+
+	Type_Info* data_type = get_pointer_type(globals.type_table_data.basic_types[(size_t)Keyword::UI8 - (size_t)Keyword::VOID]);
+	Type_Info* size_type = globals.type_table_data.basic_types[(size_t)Keyword::UI64 - (size_t)Keyword::VOID];
+
+	for (Keyword keyword : {Keyword::STRING, Keyword::STRING_VIEW})
+	{
+		Type_Info* type = globals.type_table_data.basic_types[(size_t)keyword - (size_t)Keyword::VOID];
+
+		type->fields = allocate_fields(2);
+		type->nb_fields = 2;
+		type->fields[0] = {data_string, data_type, 0};
+		type->fields[1] = {size_string, size_type, 8};
+	}
+}
+
+static void compute_array_layout(Type_Info* array_type)
+{
+	Type_Info* element_type = array_type->element_type;
+
+	if (array_type->array_count == 0) {
+		array_type->size = 16;
+		array_type->alignment = 8;
+	}
+	else {
+		array_type->size = element_type->size * array_type->array_count;
+		array_type->alignment = element_type->alignment;
+		// Will be fixed when the layout of the element type will be done.
+		// If it is the struct that contains this array, an error will be reported.
+		array_type->layout_in_progress = element_type->layout_in_progress;
+	}
+}
+
+static void compute_struct_layout(Type_Info* type, AST_Node* first_child, bool is_union)
+{
+	ZoneScopedN("compute_struct_layout");
+
+	size_t	nb_fields = 0;
+	size_t	offset = 0;
+	size_t	size = 0;
+	size_t	alignment = 1;
+
+	// Only variables are fields, a struct can also contains declarations of other types
+	for (AST_Node* child = first_child; child; child = child->sibling) {
+		if (child->ast_type == Node_Type::STATEMENT_VARIABLE)
+			nb_fields++;
+	}
+
+	type->layout_in_progress = true;
+	type->fields = nb_fields ? allocate_fields(nb_fields) : nullptr;
+	type->nb_fields = (uint32_t)nb_fields;
+
+	Type_Field* field = type->fields;
+	for (AST_Node* child = first_child; child; child = child->sibling)
+	{
+		if (child->ast_type != Node_Type::STATEMENT_VARIABLE) {
+			// Nested declarations of types
+			if (child->ast_type == Node_Type::STATEMENT_TYPE_STRUCT
+				|| child->ast_type == Node_Type::STATEMENT_TYPE_UNION
+				|| child->ast_type == Node_Type::TYPE_ALIAS) {
+				get_type_info(child);
+			}
+			continue;
+		}
+
+		AST_Statement_Variable* variable_node = (AST_Statement_Variable*)child;
+		Type_Info* field_type = get_type_info(variable_node->type);
+
+		variable_node->type_info = field_type;
+
+		if (field_type->layout_in_progress) {
+			report_error(Compiler_Error::error, variable_node->name, "A struct or an union can't contain itself by value, use a pointer instead.");
+		}
+		if (field_type->kind == Type_Info::Kind::BASIC && field_type->keyword == Keyword::VOID) {
+			report_error(Compiler_Error::error, variable_node->name, "A field can't be of type void.");
+		}
+
+		if (is_union) {
+			offset = 0;
+			size = field_type->size > size ? field_type->size : size;
+		}
+		else {
+			offset = align_offset(offset, field_type->alignment);
+			size = offset + field_type->size;
+		}
+		alignment = field_type->alignment > alignment ? field_type->alignment : alignment;
+
+		field->name = variable_node->name.text;
+		field->type = field_type;
+		field->offset = offset;
+		field++;
+
+		offset += field_type->size;
+	}
+
+	type->size = align_offset(size, alignment);
+	type->alignment = alignment;
+	type->layout_in_progress = false;
+
+	// Arrays created through a pointer while the layout was in progress
+	for (Type_Info* array_type = type->first_array_type; array_type; array_type = array_type->next_array_type) {
+		compute_array_layout(array_type);
+	}
+}
+
+static Type_Info* get_struct_type(AST_Node* declaration)
+{
+	Type_Info**	type_info;
+	AST_Node*	first_child;
+	bool		is_union = declaration->ast_type == Node_Type::STATEMENT_TYPE_UNION;
+
+	if (is_union) {
+		type_info = &((AST_Statement_Union_Type*)declaration)->type_info;
+		first_child = ((AST_Statement_Union_Type*)declaration)->first_child;
+	}
+	else {
+		type_info = &((AST_Statement_Struct_Type*)declaration)->type_info;
+		first_child = ((AST_Statement_Struct_Type*)declaration)->first_child;
+	}
+
+	if (*type_info) {
+		return *type_info;
+	}
+
+	// The type is registered before computing the layout, so fields can be pointers on it
+	*type_info = allocate_type(is_union ? Type_Info::Kind::UNION : Type_Info::Kind::STRUCT);
+	(*type_info)->declaration = declaration;
+
+	compute_struct_layout(*type_info, first_child, is_union);
+	return *type_info;
+}
+
+Type_Info* f::get_pointer_type(Type_Info* element_type)
+{
+	if (element_type->pointer_type) {
+		return element_type->pointer_type;
+	}
+
+	Type_Info* pointer_type = allocate_type(Type_Info::Kind::POINTER);
+
+	pointer_type->size = 8;
+	pointer_type->alignment = 8;
+	pointer_type->element_type = element_type;
+
+	element_type->pointer_type = pointer_type;
+	return pointer_type;
+}
+
+Type_Info* f::get_array_type(Type_Info* element_type, size_t array_count)
+{
+	// @SpeedUp a linked list should be good enough as a type is rarely used in arrays of many different sizes
+	for (Type_Info* array_type = element_type->first_array_type; array_type; array_type = array_type->next_array_type) {
+		if (array_type->array_count == array_count) {
+			return array_type;
+		}
+	}
+
+	Type_Info* array_type = allocate_type(Type_Info::Kind::ARRAY);
+
+	array_type->element_type = element_type;
+	array_type->array_count = array_count;
+	compute_array_layout(array_type);
+
+	if (array_count == 0) {
+		// Dynamic arrays are a pointer and a size, exactly like strings
+		static fstd::language::string_view	data_string;
+		static fstd::language::string_view	size_string;
+
+		language::assign(data_string, (uint8_t*)"data");
+		language::assign(size_string, (uint8_t*)"size");
+
+		array_type->fields = allocate_fields(2);
+		array_type->nb_fields = 2;
+		array_type->fields[0] = {data_string, get_pointer_type(element_type), 0};
+		array_type->fields[1] = {size_string, globals.type_table_data.basic_types[(size_t)Keyword::UI64 - (size_t)Keyword::VOID], 8};
+	}
+
+	array_type->next_array_type = element_type->first_array_type;
+	element_type->first_array_type = array_type;
+	return array_type;
+}
+
+Type_Info* f::get_type_info(AST_Node* type_node)
+{
+	core::Assert(type_node != nullptr);
+
+	switch (type_node->ast_type)
+	{
+	case Node_Type::STATEMENT_BASIC_TYPE:
+		return globals.type_table_data.basic_types[(size_t)((AST_Statement_Basic_Type*)type_node)->keyword - (size_t)Keyword::VOID];
+	case Node_Type::TYPE_ALIAS:
+	{
+		AST_Alias* alias_node = (AST_Alias*)type_node;
+
+		if (alias_node->type_info == nullptr) {
+			alias_node->type_info = get_type_info(alias_node->type);
+		}
+		return alias_node->type_info;
+	}
+	case Node_Type::USER_TYPE_IDENTIFIER:
+		return get_type_info(get_user_type((AST_User_Type_Identifier*)type_node));
+	case Node_Type::STATEMENT_IDENTIFIER: // Aliases are parsed as expressions
+		return get_type_info(get_user_type((AST_Identifier*)type_node));
+	case Node_Type::STATEMENT_TYPE_POINTER:
+		return get_pointer_type(get_type_info(type_node->sibling));
+	case Node_Type::UNARY_OPERATOR_ADDRESS_OF: // Aliases are parsed as expressions
+		return get_pointer_type(get_type_info(((AST_Unary_operator*)type_node)->right));
+	case Node_Type::STATEMENT_TYPE_ARRAY:
+	{
+		AST_Statement_Type_Array*	array_node = (AST_Statement_Type_Array*)type_node;
+		Type_Info*					element_type = get_type_info(array_node->sibling);
+		size_t						array_count = 0;
+
+		if (array_node->array_size) {
+			if (array_node->array_size->ast_type != Node_Type::STATEMENT_LITERAL) {
+				// @TODO support arrays that are sized at runtime
+				report_error(Compiler_Error::error, "The size of an array should be a compile-time constant.");
+			}
+
+			AST_Literal* size_node = (AST_Literal*)array_node->array_size;
+
+			if (size_node->value.type < Token_Type::NUMERIC_LITERAL_I32 || size_node->value.type > Token_Type::NUMERIC_LITERAL_UI64
+				|| ((size_node->value.type == Token_Type::NUMERIC_LITERAL_I32 || size_node->value.type == Token_Type::NUMERIC_LITERAL_I64) && size_node->value.value.integer <= 0)
+				|| size_node->value.value.unsigned_integer == 0) {
+				report_error(Compiler_Error::error, size_node->value, "The size of an array should be a positive integer.");
+			}
+			array_count = (size_t)size_node->value.value.unsigned_integer;
+		}
+		return get_array_type(element_type, array_count);
+	}
+	case Node_Type::STATEMENT_TYPE_STRUCT:
+	case Node_Type::STATEMENT_TYPE_UNION:
+		return get_struct_type(type_node);
+	default:
+		// Enums aren't parsed yet
+		report_error(Compiler_Error::internal_error, "This kind of type isn't supported by the type table.");
+		return nullptr;
+	}
+}
+
+const Type_Field* f::get_field(const Type_Info* type, const fstd::language::string_view& name)
+{
+	for (uint32_t i = 0; i < type->nb_fields; i++) {
+		if (language::are_equals(type->fields[i].name, name)) {
+			return &type->fields[i];
+		}
+	}
+	return nullptr;
+}
+
+// =============================================================================
+
+// Check that the initialization literal can be stored in the variable.
+// Other expressions will be checked by the type checker of the IR generator.
+static void check_literal_initialization(AST_Statement_Variable* variable_node)
+{
+	if (variable_node->expression == nullptr || variable_node->expression->ast_type != Node_Type::STATEMENT_LITERAL) {
+		return;
+	}
+
+	Type_Info*				type = variable_node->type_info;
+	const Token<Keyword>&	literal = ((AST_Literal*)variable_node->expression)->value;
+
+	if (is_integer_type(type) == false && is_floating_point_type(type) == false) {
+		return;
+	}
+
+	if (literal.type == Token_Type::STRING_LITERAL) {
+		report_error(Compiler_Error::error, literal, "A string literal can't be used to initialize a numeric variable.");
+	}
+	if (is_floating_point_type(type)) {
+		return; // All numeric literals can be converted to floating point
+	}
+	if (literal.type >= Token_Type::NUMERIC_LITERAL_F32 && literal.type <= Token_Type::NUMERIC_LITERAL_REAL) {
+		report_error(Compiler_Error::error, literal, "A floating point literal can't be implicitly converted to an integer.");
+	}
+	if (literal.type < Token_Type::NUMERIC_LITERAL_I32 || literal.type > Token_Type::NUMERIC_LITERAL_UI64) {
+		return;
+	}
+
+	size_t		nb_bits = type->size * 8;
+	int64_t		signed_min = nb_bits == 64 ? std::numeric_limits<int64_t>::min() : -((int64_t)1 << (nb_bits - 1));
+	int64_t		signed_max = nb_bits == 64 ? std::numeric_limits<int64_t>::max() : ((int64_t)1 << (nb_bits - 1)) - 1;
+	uint64_t	unsigned_max = nb_bits == 64 ? std::numeric_limits<uint64_t>::max() : ((uint64_t)1 << nb_bits) - 1;
+	bool		is_negative = (literal.type == Token_Type::NUMERIC_LITERAL_I32 || literal.type == Token_Type::NUMERIC_LITERAL_I64) && literal.value.integer < 0;
+
+	if (is_negative) {
+		if (literal.value.integer < signed_min) {
+			report_error(Compiler_Error::error, literal, "The literal value doesn't fit in the type of the variable.");
+		}
+		if (is_unsigned_type(type)) {
+			// Win32 constants like STD_OUTPUT_HANDLE rely on this conversion, so it isn't an error
+			report_error(Compiler_Error::warning, literal, "Sign mismatch: a negative literal is assigned to an unsigned variable, the value will wrap.");
+		}
+	}
+	else if (literal.value.unsigned_integer > (is_unsigned_type(type) ? unsigned_max : (uint64_t)signed_max)) {
+		report_error(Compiler_Error::error, literal, "The literal value doesn't fit in the type of the variable.");
+	}
+}
+
+// Iterate over a list of statements
+static void deduce_node_types(AST_Node* node)
+{
+	for (AST_Node* current_node = node; current_node; current_node = current_node->sibling)
+	{
+		if (current_node->ast_type == Node_Type::STATEMENT_VARIABLE) {
+			AST_Statement_Variable* variable_node = (AST_Statement_Variable*)current_node;
+
+			if (variable_node->type_info == nullptr) {
+				variable_node->type_info = get_type_info(variable_node->type);
+			}
+
+			if (variable_node->type_info->kind == Type_Info::Kind::BASIC && variable_node->type_info->keyword == Keyword::VOID) {
+				report_error(Compiler_Error::error, variable_node->name, "A variable can't be of type void.");
+			}
+			check_literal_initialization(variable_node);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_FUNCTION) {
+			AST_Statement_Function* function_node = (AST_Statement_Function*)current_node;
+
+			deduce_node_types((AST_Node*)function_node->arguments);
+			if (function_node->return_type) {
+				get_type_info(function_node->return_type);
+			}
+			deduce_node_types((AST_Node*)function_node->scope);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_MODULE) {
+			deduce_node_types(((AST_Statement_Module*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SCOPE) {
+			deduce_node_types(((AST_Statement_Scope*)current_node)->first_child);
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_SWITCH) {
+			for (AST_Switch_Case* case_node = ((AST_Statement_Switch*)current_node)->cases; case_node; case_node = (AST_Switch_Case*)case_node->sibling) {
+				deduce_node_types((AST_Node*)case_node->scope);
+			}
+		}
+		else if (current_node->ast_type == Node_Type::STATEMENT_TYPE_STRUCT
+			|| current_node->ast_type == Node_Type::STATEMENT_TYPE_UNION
+			|| current_node->ast_type == Node_Type::TYPE_ALIAS) {
+			get_type_info(current_node);
+		}
+	}
+}
+
+void f::deduce_types(Parsing_Result& parsing_result)
+{
+	memory::Array<Parsing_Result*>	parsing_results;
+
+	defer{ memory::release(parsing_results); };
+
+	memory::array_push_back(parsing_results, &parsing_result);
+	deduce_types(parsing_results);
+}
+
+void f::deduce_types(const memory::Array<Parsing_Result*>& parsing_results)
+{
+	ZoneScopedN("f::deduce_types");
+
+	// Initialize data
+	{
+		size_t ast_nodes_size = 0;
+
+		for (size_t i = 0; i < memory::get_array_size(parsing_results); i++) {
+			ast_nodes_size += parsing_results[i]->ast_nodes_size;
+		}
+
+		// There is at most one type per AST node, the smallest node is the pointer modifier.
+		// Strings and dynamic arrays have 2 fields, others have at most one field per node.
+		size_t nb_max_types = ast_nodes_size / sizeof(AST_Statement_Type_Pointer) + sizeof(Type_Table_Data::basic_types) / sizeof(Type_Info*) + 1;
+
+		memory::reserve_array(globals.type_table_data.types, nb_max_types);
+		memory::resize_array(globals.type_table_data.types, 0);
+		memory::reserve_array(globals.type_table_data.fields, nb_max_types * 2);
+		memory::resize_array(globals.type_table_data.fields, 0);
+
+		initialize_basic_types();
+	}
+
+	// Types declared in other modules are interned on their first use, whatever the order of modules
+	for (size_t i = 0; i < memory::get_array_size(parsing_results); i++) {
+		deduce_node_types(parsing_results[i]->ast_root);
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../lexer/lexer.hpp"
+
+#include <fstd/memory/array.hpp>
+
+#include <fstd/language/string_view.hpp>
+
+// Methods of this file are suceptible to report compilition errors
+
+namespace f
+{
+	struct AST_Node;
+	struct Parsing_Result;
+	struct Type_Field;
+
+	// Every type used by the program is interned once in the type table, so two Type_Info pointers
+	// are equals if and only if the types are the same (aliases are resolved to their underlying type).
+	//
+	// The size, the alignment and the offset of fields are computed only once, then queries
+	// made by the IR generator and backends are simple memory reads.
+	struct Type_Info
+	{
+		enum class Kind : uint8_t
+		{
+			BASIC,
+			POINTER,
+			ARRAY,
+			STRUCT,
+			UNION
+		};
+
+		Kind		kind;
+		Keyword		keyword;			// BASIC only
+		bool		layout_in_progress;	// Used to detect structs that contains themselves by value
+		size_t		size;
+		size_t		alignment;
+
+		Type_Info*	element_type;		// POINTER and ARRAY
+		size_t		array_count;		// ARRAY only, 0 means a dynamic array (a pointer and a size)
+
+		AST_Node*	declaration;		// STRUCT and UNION
+		Type_Field*	fields;				// STRUCT, UNION, and string BASIC types (data and size)
+		uint32_t	nb_fields;
+
+		// Interning caches, types built on top of this one are found from here
+		Type_Info*	pointer_type;
+		Type_Info*	first_array_type;
+		Type_Info*	next_array_type;	// Next array type of the same element_type
+	};
+
+	struct Type_Field
+	{
+		fstd::language::string_view	name;
+		Type_Info*					type;
+		size_t						offset;
+	};
+
+	struct Type_Table_Data
+	{
+		// @Warning the AST keep pointers on Type_Info, so those arrays are allocated once and never reallocated.
+		fstd::memory::Array<Type_Info>	types;
+		fstd::memory::Array<Type_Field>	fields;
+
+		Type_Info*	basic_types[(size_t)Keyword::TYPE - (size_t)Keyword::VOID + 1];
+	};
+
+	// Type deduction pass:
+	//   - intern the type of all variables, function arguments and type declarations,
+	//   - compute sizes, alignments and offsets of fields (with the C layout rules, to stay compatible with C APIs),
+	//   - check that literals used to initialize variables fit in their type.
+	//
+	// Constant expressions should already have been folded (array sizes have to be literals).
+	void deduce_types(Parsing_Result& parsing_result);
+	void deduce_types(const fstd::memory::Array<Parsing_Result*>& parsing_results); // All modules share the same type table
+
+	// Return the interned type of any type node (a type modifier chain, a basic type, a user type identifier, an alias,...)
+	Type_Info* get_type_info(AST_Node* type_node);
+	Type_Info* get_pointer_type(Type_Info* element_type);
+	Type_Info* get_array_type(Type_Info* element_type, size_t array_count);
+
+	const Type_Field* get_field(const Type_Info* type, const fstd::language::string_view& name); // Return nullptr if the type doesn't have this field
+
+	inline bool is_integer_type(const Type_Info* type) {
+		return type->kind == Type_Info::Kind::BASIC && type->keyword >= Keyword::I8 && type->keyword <= Keyword::UI64;
+	}
+
+	inline bool is_unsigned_type(const Type_Info* type) {
+		return is_integer_type(type) && (type->keyword == Keyword::UI8 || type->keyword == Keyword::UI16 || type->keyword == Keyword::UI32 || type->keyword == Keyword::UI64);
+	}
+
+	inline bool is_floating_point_type(const Type_Info* type) {
+		return type->kind == Type_Info::Kind::BASIC && (type->keyword == Keyword::F32 || type->keyword == Keyword::F64);
+	}
+
+	inline bool is_vector_type(const Type_Info* type) {
+		return type->kind == Type_Info::Kind::BASIC && type->keyword >= Keyword::F32X4 && type->keyword <= Keyword::I64X2;
+	}
+}
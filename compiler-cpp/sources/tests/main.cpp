@@ -4,7 +4,18 @@
 
 #include <lexer/lexer.hpp>
 #include <parser/parser.hpp>
+#include <parser/constant_folder.hpp>
+#include <parser/type_table.hpp>
+#include <parser/modules.hpp>
 #include <IR_generator.hpp>
+#include <JIT_x64_backend.hpp>
+#include <PE_x64_backend.hpp>
+#include <ELF_x64_backend.hpp>
+#include <optimizer/optimizer.hpp>
+#include <x64/register_allocator.hpp>
+#include <x64/encoder.hpp>
+#include <x64/assembler.hpp>
+#include <x64/code_generator.hpp>
 
 #include <fstd/system/timer.hpp>
 #include <fstd/system/path.hpp>
@@ -26,10 +37,109 @@
 #include <string>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <time.h>       /* time */
 
+#if defined(FSTD_OS_WINDOWS)
+#	include <Windows.h>
+#endif
+
 #include <tracy/Tracy.hpp>
 
+// Helpers to build the IR by hand, for the features that the front end can't generate yet (loops, vectors,...)
+
+// Append an instruction to the function
+static f::IR_Instruction& emit(f::IR_Function& function, f::IR_Opcode opcode, f::Register::Type type, uint32_t destination, uint32_t a, uint32_t b, int64_t immediate)
+{
+	f::IR_Instruction instruction;
+
+	instruction.opcode = opcode;
+	instruction.type = type;
+	instruction.destination = destination;
+	instruction.operands[0] = a;
+	instruction.operands[1] = b;
+	instruction.immediate.integer = immediate;
+	fstd::memory::array_push_back(function.instructions, instruction);
+	return *fstd::memory::get_array_last_element(function.instructions);
+}
+
+// JUMP and BRANCH, not_taken is ignored by JUMP
+static void emit_branch(f::IR_Function& function, f::IR_Opcode opcode, uint32_t condition, uint32_t taken, uint32_t not_taken)
+{
+	f::IR_Instruction& instruction = emit(function, opcode, f::Register::Type::BYTE, f::invalid_register, condition, f::invalid_register, 0);
+
+	instruction.immediate.targets[0] = taken;
+	instruction.immediate.targets[1] = not_taken;
+}
+
+// The destination is a new register of destination_type, it is returned
+static uint32_t emit_value(f::IR_Function& function, f::IR_Opcode opcode, f::Register::Type type, f::Register::Type destination_type, uint32_t a, uint32_t b, int64_t immediate)
+{
+	uint32_t destination = (uint32_t)fstd::memory::get_array_size(function.registers);
+
+	fstd::memory::array_push_back(function.registers, destination_type);
+	emit(function, opcode, type, destination, a, b, immediate);
+	return destination;
+}
+
+static uint32_t emit_real(f::IR_Function& function, f::Register::Type type, double value)
+{
+	uint32_t destination = emit_value(function, f::IR_Opcode::CONSTANT, type, type, f::invalid_register, f::invalid_register, 0);
+
+	fstd::memory::get_array_last_element(function.instructions)->immediate.real = value;
+	return destination;
+}
+
+// The new block contains all instructions emitted since the end of the previous one
+static void end_block(f::IR_Function& function)
+{
+	f::IR_Basic_Block	block = f::IR_Basic_Block();
+	uint32_t			first_instruction = fstd::memory::is_array_empty(function.blocks) ? 0
+		: fstd::memory::get_array_last_element(function.blocks)->first_instruction + fstd::memory::get_array_last_element(function.blocks)->nb_instructions;
+
+	block.first_instruction = first_instruction;
+	block.nb_instructions = (uint32_t)fstd::memory::get_array_size(function.instructions) - first_instruction;
+	fstd::memory::array_push_back(function.blocks, block);
+}
+
+// Arguments are the first registers, all registers and the return value have the same type.
+// @Warning the returned reference is invalidated by the next call if ir.functions isn't reserved
+static f::IR_Function& add_function(f::IR& ir, uint32_t nb_arguments, uint32_t nb_registers, f::Register::Type type)
+{
+	f::IR_Function function = f::IR_Function();
+
+	function.nb_arguments = nb_arguments;
+	function.has_return_value = true;
+	function.return_type = type;
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		fstd::memory::array_push_back(function.registers, type);
+	}
+	fstd::memory::array_push_back(ir.functions, function);
+	return *fstd::memory::get_array_last_element(ir.functions);
+}
+
+// The front end from the lexer to the IR generator, for the tests that start from the IR of a source file
+static f::IR generate_ir_of_file(const uint8_t* file_path)
+{
+	fstd::memory::Array<f::Token<f::Keyword>>	tokens;
+	f::Parsing_Result							parsing_result;
+	fstd::system::Path							path;
+	f::IR										ir;
+
+	defer{ fstd::system::reset_path(path); };
+
+	fstd::system::from_native(path, file_path);
+
+	f::initialize_lexer();
+	f::lex(path, tokens);
+
+	f::parse(tokens, parsing_result);
+	f::fold_constant_expressions(parsing_result);
+	f::deduce_types(parsing_result);
+	f::generate_ir(parsing_result, ir);
+	return ir;
+}
+
 void test_integer_to_string_performances()
 {
 	ZoneScopedNC("test_integer_to_string_performances", 0xf05545);
@@ -184,6 +294,32 @@ void test_unicode_string_convversions()
 	fstd::core::Assert(are_equals(to_utf8_string, utf8_string));
 }
 
+// Evaluate an expression of integer literals from the AST, to check the order of the operations
+static int64_t evaluate_literal_expression(f::AST_Node* node)
+{
+	if (node->ast_type == f::Node_Type::STATEMENT_LITERAL) {
+		return ((f::AST_Literal*)node)->value.value.integer;
+	}
+	else if (node->ast_type == f::Node_Type::UNARY_OPERATOR_NEGATIVE) {
+		return -evaluate_literal_expression(((f::AST_Unary_operator*)node)->right);
+	}
+
+	f::AST_Binary_Operator* binary_operator = (f::AST_Binary_Operator*)node;
+	int64_t left = evaluate_literal_expression(binary_operator->left);
+	int64_t right = evaluate_literal_expression(binary_operator->right);
+
+	switch (node->ast_type)
+	{
+	case f::Node_Type::BINARY_OPERATOR_ADDITION:		return left + right;
+	case f::Node_Type::BINARY_OPERATOR_SUBSTRACTION:	return left - right;
+	case f::Node_Type::BINARY_OPERATOR_MULTIPLICATION:	return left * right;
+	case f::Node_Type::BINARY_OPERATOR_DIVISION:		return left / right;
+	default:
+		fstd::core::Assert(false);
+		return 0;
+	}
+}
+
 void test_AST_operator_precedence()
 {
 	using namespace f;
@@ -290,142 +426,2110 @@ void test_AST_operator_precedence()
 		fstd::core::Assert(second_op_right->ast_type == f::Node_Type::STATEMENT_LITERAL);
 		fstd::core::Assert(second_op_right->value.value.integer == 4);
 	}
+
+	// Longer chains need more than one rotation of the tree, and the parenthesis must keep their operations grouped
+	AST_Statement_Variable* chain_var = (AST_Statement_Variable*)z_var->sibling;
+	fstd::core::Assert(evaluate_literal_expression(chain_var->expression) == 33);
+
+	AST_Statement_Variable* grouped_var = (AST_Statement_Variable*)chain_var->sibling;
+	fstd::core::Assert(evaluate_literal_expression(grouped_var->expression) == 13);
+
+	AST_Statement_Variable* grouped_right_var = (AST_Statement_Variable*)grouped_var->sibling;
+	fstd::core::Assert(evaluate_literal_expression(grouped_right_var->expression) == 36);
+
+	AST_Statement_Variable* negative_var = (AST_Statement_Variable*)grouped_right_var->sibling;
+	fstd::core::Assert(negative_var->expression->ast_type == f::Node_Type::BINARY_OPERATOR_ADDITION);
+	fstd::core::Assert(evaluate_literal_expression(negative_var->expression) == 1);
+
+	AST_Statement_Variable* substractions_var = (AST_Statement_Variable*)negative_var->sibling;
+	fstd::core::Assert(evaluate_literal_expression(substractions_var->expression) == 1);
 }
 
-void test_hash_table()
+void test_constant_folding()
 {
-	fstd::memory::Hash_Table<uint16_t, fstd::language::string, void*>	hash_table;
-	uint64_t	hash;
-	uint16_t	short_hash;
+	using namespace f;
 
-	fstd::memory::hash_table_init(hash_table, &fstd::language::are_equals);
+	fstd::memory::Array<f::Token<f::Keyword>>	tokens;
+	Parsing_Result								parsing_result;
+	fstd::system::Path							path;
 
-	fstd::language::string		string_type;
-	fstd::language::string		user_type_with_hash_of_string; // We will use the same hash than for the string_type to create a collision
+	defer{ fstd::system::reset_path(path); };
 
-	defer{
-		release(string_type);
-		release(user_type_with_hash_of_string);
-		fstd::memory::hash_table_release(hash_table);
-	};
+	fstd::system::from_native(path, (uint8_t*)u8R"(.\tests\operators\constant_folding.f)");
 
-	fstd::language::assign(string_type, (uint8_t*)u8"fstd::language::string");
-	fstd::language::assign(user_type_with_hash_of_string, (uint8_t*)u8"User_Type_With_Hash_Of_String");
+	initialize_lexer();
+	lex(path, tokens);
 
-	hash = SpookyHash::Hash64((const void*)fstd::language::to_utf8(string_type), fstd::language::get_string_size(string_type), 0);
-	short_hash = hash & 0xffff;
-	void* value;
+	parse(tokens, parsing_result);
+	fold_constant_expressions(parsing_result);
 
-	value = (void*)0x01;
-	fstd::memory::hash_table_insert(hash_table, short_hash, string_type, value);
-	value = (void*)0x02;
-	fstd::memory::hash_table_insert(hash_table, short_hash, user_type_with_hash_of_string, value);
+	AST_Statement_Scope* global_scope = (AST_Statement_Scope*)parsing_result.ast_root;
+	fstd::core::Assert(global_scope->ast_type == f::Node_Type::STATEMENT_SCOPE);
 
-	// Check if we can correctly get back both value even with the hash collision
-	fstd::core::Assert((void*)*fstd::memory::hash_table_get(hash_table, short_hash, string_type) == (void*)0x01);
-	fstd::core::Assert((void*)*fstd::memory::hash_table_get(hash_table, short_hash, user_type_with_hash_of_string) == (void*)0x02);
+	// a: i32 = 5 * 3 + 4;
+	AST_Statement_Variable* a_var = (AST_Statement_Variable*)global_scope->first_child;
+	{
+		AST_Literal* literal = (AST_Literal*)a_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I32);
+		fstd::core::Assert(literal->value.value.integer == 19);
+		fstd::core::Assert(literal->sibling == nullptr);
+	}
 
-	// Test if we iterate the right number of times with iterators
-	size_t count = 0;
-	auto it = fstd::memory::hash_table_begin(hash_table);
-	auto it_end = fstd::memory::hash_table_end(hash_table);
-	for (; !fstd::memory::equals<uint16_t, fstd::language::string, void*, 512>(it, it_end); fstd::memory::hash_table_next<uint16_t, fstd::language::string, void*, 512>(it))
+	// b: i32 = 2 - 7;
+	AST_Statement_Variable* b_var = (AST_Statement_Variable*)a_var->sibling;
 	{
-		count++;
-		void** value = fstd::memory::hash_table_get<uint16_t, fstd::language::string, void*, 512>(it);
-		fstd::core::Assert(*value != nullptr);
+		AST_Literal* literal = (AST_Literal*)b_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I32);
+		fstd::core::Assert(literal->value.value.integer == -5);
+	}
+
+	// c: f64 = 1.5 * 2.0;
+	AST_Statement_Variable* c_var = (AST_Statement_Variable*)b_var->sibling;
+	{
+		AST_Literal* literal = (AST_Literal*)c_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_F64);
+		fstd::core::Assert(literal->value.value.real_64 == 3.0);
+	}
+
+	// d: i64 = 3000000000 * 2;
+	AST_Statement_Variable* d_var = (AST_Statement_Variable*)c_var->sibling;
+	{
+		AST_Literal* literal = (AST_Literal*)d_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I64);
+		fstd::core::Assert(literal->value.value.integer == 6'000'000'000);
+	}
+
+	// e: i64 = 2147483647 + 1;	// The i32 result is promoted to i64
+	AST_Statement_Variable* e_var = (AST_Statement_Variable*)d_var->sibling;
+	{
+		AST_Literal* literal = (AST_Literal*)e_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I64);
+		fstd::core::Assert(literal->value.value.integer == 2'147'483'648);
+	}
+
+	// f: ui32 = 10u / 3;
+	AST_Statement_Variable* f_var = (AST_Statement_Variable*)e_var->sibling;
+	{
+		AST_Literal* literal = (AST_Literal*)f_var->expression;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_UI32);
+		fstd::core::Assert(literal->value.value.unsigned_integer == 3);
+	}
+
+	// g: [2 * 8] ui8;
+	AST_Statement_Variable* g_var = (AST_Statement_Variable*)f_var->sibling;
+	{
+		AST_Statement_Type_Array* array_type = (AST_Statement_Type_Array*)g_var->type;
+		fstd::core::Assert(array_type->ast_type == f::Node_Type::STATEMENT_TYPE_ARRAY);
+
+		AST_Literal* literal = (AST_Literal*)array_type->array_size;
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.value.integer == 16);
 	}
-	fstd::core::Assert(count == 2);
 }
 
-void test_number_to_string()
+void test_type_table()
 {
-	fstd::language::string f_string;
-	fstd::language::string result_string;
+	using namespace f;
 
-	// Decimal
-	fstd::language::to_string(5'624'978'429, f_string); // 64 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"5624978429");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	fstd::memory::Array<f::Token<f::Keyword>>	tokens;
+	Parsing_Result								parsing_result;
+	fstd::system::Path							path;
 
-	fstd::language::to_string(-5'624'978'429, f_string); // 64 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"-5624978429");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	defer{ fstd::system::reset_path(path); };
 
-	fstd::language::to_string(2'147'483'647, f_string); // 32 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"2147483647");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	fstd::system::from_native(path, (uint8_t*)u8R"(.\tests\types\struct_layout.f)");
 
-	fstd::language::to_string(-2'147'483'647, f_string); // 32 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"-2147483647");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	initialize_lexer();
+	lex(path, tokens);
 
-	// Hexadecimal
-	fstd::language::to_string((uint64_t)5'624'978'429, 16, f_string); // 64 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"000000014F465BFD");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	parse(tokens, parsing_result);
+	fold_constant_expressions(parsing_result);
+	deduce_types(parsing_result);
 
-	fstd::language::to_string((uint64_t)-5'624'978'429, 16, f_string); // 64 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"FFFFFFFEB0B9A403");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	AST_Statement_Scope* global_scope = (AST_Statement_Scope*)parsing_result.ast_root;
+	fstd::core::Assert(global_scope->ast_type == f::Node_Type::STATEMENT_SCOPE);
 
-	fstd::language::to_string((uint32_t)2'147'483'647, 16, f_string); // 32 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"7FFFFFFF");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	AST_Statement_Struct_Type* vector3_struct = (AST_Statement_Struct_Type*)global_scope->first_child;
+	AST_Statement_Struct_Type* node_struct = (AST_Statement_Struct_Type*)vector3_struct->sibling;
+	AST_Statement_Union_Type* value_union = (AST_Statement_Union_Type*)node_struct->sibling;
+	fstd::core::Assert(vector3_struct->ast_type == f::Node_Type::STATEMENT_TYPE_STRUCT);
+	fstd::core::Assert(node_struct->ast_type == f::Node_Type::STATEMENT_TYPE_STRUCT);
+	fstd::core::Assert(value_union->ast_type == f::Node_Type::STATEMENT_TYPE_UNION);
 
-	fstd::language::to_string((uint32_t)-2'147'483'647, 16, f_string); // 32 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"80000001");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	// Vector3 :: struct { x : f32; y : f32; z : f32; }
+	Type_Info* vector3_type = vector3_struct->type_info;
+	{
+		fstd::core::Assert(vector3_type->kind == Type_Info::Kind::STRUCT);
+		fstd::core::Assert(vector3_type->size == 12);
+		fstd::core::Assert(vector3_type->alignment == 4);
+		fstd::core::Assert(vector3_type->nb_fields == 3);
+		fstd::core::Assert(vector3_type->fields[2].offset == 8);
+	}
 
-	fstd::language::to_string((uint32_t)-1, 16, f_string); // 32 bits
-	fstd::language::assign(result_string, (uint8_t*)u8"FFFFFFFF");
-	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
-	release(f_string);
+	// Node :: struct { id : ui8; next : §Node; value : i32; name : string; }
+	Type_Info* node_type = node_struct->type_info;
+	{
+		fstd::core::Assert(node_type->kind == Type_Info::Kind::STRUCT);
+		fstd::core::Assert(node_type->size == 40);
+		fstd::core::Assert(node_type->alignment == 8);
+		fstd::core::Assert(node_type->fields[0].offset == 0);
+		fstd::core::Assert(node_type->fields[1].offset == 8);
+		fstd::core::Assert(node_type->fields[1].type->kind == Type_Info::Kind::POINTER);
+		fstd::core::Assert(node_type->fields[1].type->element_type == node_type);
+		fstd::core::Assert(node_type->fields[2].offset == 16);
+		fstd::core::Assert(node_type->fields[3].offset == 24);
+	}
 
-	// Tester également avec des nombres signé aux limites
-	// Egalement avec des doubles
+	// Value :: union { integer : i64; bytes : [4] ui8; }
+	Type_Info* value_type = value_union->type_info;
+	{
+		fstd::core::Assert(value_type->kind == Type_Info::Kind::UNION);
+		fstd::core::Assert(value_type->size == 8);
+		fstd::core::Assert(value_type->fields[1].offset == 0);
+		fstd::core::Assert(value_type->fields[1].type->size == 4);
+	}
+
+	// Variables share the interned types of their declarations
+	AST_Statement_Variable* a_var = (AST_Statement_Variable*)value_union->sibling;
+	AST_Statement_Variable* b_var = (AST_Statement_Variable*)a_var->sibling;
+	AST_Statement_Variable* c_var = (AST_Statement_Variable*)b_var->sibling;
+	AST_Statement_Variable* d_var = (AST_Statement_Variable*)c_var->sibling;
+	AST_Statement_Variable* e_var = (AST_Statement_Variable*)d_var->sibling;
+
+	fstd::core::Assert(a_var->type_info == vector3_type);
+	fstd::core::Assert(b_var->type_info == node_type);
+	fstd::core::Assert(c_var->type_info->kind == Type_Info::Kind::ARRAY);
+	fstd::core::Assert(c_var->type_info->size == 3 * 40);
+	fstd::core::Assert(d_var->type_info->element_type == vector3_type);
+	fstd::core::Assert(d_var->type_info == e_var->type_info);
 }
 
-int main(int ac, char** av)
+void test_compile_time_execution()
 {
-	// Begin Initialization ================================================
+	using namespace f;
 
-	fstd::system::allocator_initialize();
+	fstd::memory::Array<f::Token<f::Keyword>>	tokens;
+	Parsing_Result								parsing_result;
+	fstd::system::Path							path;
 
-#if defined(FSTD_OS_WINDOWS)
-	fstd::os::windows::enable_default_console_configuration();
-	defer{ fstd::os::windows::close_console(); };
-#endif
+	defer{ fstd::system::reset_path(path); };
 
-#if defined(TRACY_ENABLE)
-	tracy::SetThreadName("Main thread");
-#endif
+	fstd::system::from_native(path, (uint8_t*)u8R"(.\tests\vm\run.f)");
 
-	initialize_globals();
+	initialize_lexer();
+	lex(path, tokens);
 
-#if defined(FSTD_DEBUG)
-	fstd::core::set_log_level(*globals.logger, fstd::core::Log_Level::verbose);
-#endif
+	parse(tokens, parsing_result);
+	fold_constant_expressions(parsing_result);
 
-	FrameMark;
-	// End Initialization ================================================
+	AST_Statement_Scope* global_scope = (AST_Statement_Scope*)parsing_result.ast_root;
+	fstd::core::Assert(global_scope->ast_type == f::Node_Type::STATEMENT_SCOPE);
 
-#if 1
-#	if !defined(_DEBUG)
-	test_integer_to_string_performances();
-#	endif
-#endif
-	test_unicode_code_point_convversions();
-	test_unicode_string_convversions();
-	test_AST_operator_precedence();
+	AST_Node* node = global_scope->first_child;
+	while (node->ast_type != f::Node_Type::STATEMENT_VARIABLE) {
+		node = node->sibling;
+	}
+
+	// #run directives are replaced by the literal of their result
+	AST_Statement_Variable* x_var = (AST_Statement_Variable*)node;
+	AST_Statement_Variable* y_var = (AST_Statement_Variable*)x_var->sibling;
+	AST_Statement_Variable* z_var = (AST_Statement_Variable*)y_var->sibling;
+
+	// x : i32 = #run sum_of_squares(3, 4);
+	{
+		fstd::core::Assert(x_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)x_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I32);
+		fstd::core::Assert(literal->value.value.integer == 25);
+	}
+
+	// y : f64 = #run half(5.0);
+	{
+		fstd::core::Assert(y_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)y_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_F64);
+		fstd::core::Assert(literal->value.value.real_64 == 2.5);
+	}
+
+	// z : i64 = #run sum_of_squares(2 + 1, -(1 + 1)) * 2;		The result of the directive is folded with the rest of the expression
+	{
+		fstd::core::Assert(z_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)z_var->expression;
+		fstd::core::Assert(literal->value.value.integer == 26);
+	}
+
+	// Operations are computed with the type of their operands
+	AST_Statement_Variable* w_var = (AST_Statement_Variable*)z_var->sibling;
+	AST_Statement_Variable* u_var = (AST_Statement_Variable*)w_var->sibling;
+	AST_Statement_Variable* v_var = (AST_Statement_Variable*)u_var->sibling;
+	AST_Statement_Variable* t_var = (AST_Statement_Variable*)v_var->sibling;
+
+	// w : i32 = #run wrap_i8(100);		100 + 100 wraps to -56 in an i8
+	{
+		fstd::core::Assert(w_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)w_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_I32);
+		fstd::core::Assert(literal->value.value.integer == -28);
+	}
+
+	// u : ui32 = #run unsigned_third(0);		0 - 1 wraps to 0xffffffff, and the division is unsigned
+	{
+		fstd::core::Assert(u_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)u_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_UI32);
+		fstd::core::Assert(literal->value.value.unsigned_integer == 0xffffffff / 3);
+	}
+
+	// v : f32 = #run f32_sum(16777216.0, 1.0);		Each addition is rounded to a f32, 2^24 + 1 isn't representable
+	{
+		fstd::core::Assert(v_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)v_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_F32);
+		fstd::core::Assert(literal->value.value.real_32 == 16777216.0f);
+	}
+
+	// t : f64 = #run f32_plus_one(16777216.0);		The integer is converted to f32, like in the constant folder
+	{
+		fstd::core::Assert(t_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		AST_Literal* literal = (AST_Literal*)t_var->expression;
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_F64);
+		fstd::core::Assert(literal->value.value.real_64 == 16777216.0);
+	}
+}
+
+void test_modules()
+{
+	using namespace f;
+
+	fstd::system::Path	path;
+
+	defer{ fstd::system::reset_path(path); };
+
+	fstd::system::from_native(path, (uint8_t*)u8R"(.\tests\modules\main.f)");
+
+	Module*									main_module = load_modules(path);
+	const fstd::memory::Array<Module*>&		modules = get_modules();
+
+	// main imports a, b and common, a and b also import common that should be loaded only once
+	fstd::core::Assert(fstd::memory::get_array_size(modules) == 4);
+	fstd::core::Assert(modules[0] == main_module);
+	fstd::core::Assert(fstd::memory::get_array_size(main_module->imports) == 3);
+
+	Module* a_module = main_module->imports[0];
+	Module* b_module = main_module->imports[1];
+	Module* common_module = main_module->imports[2];
+
+	fstd::core::Assert(fstd::memory::get_array_size(a_module->imports) == 1);
+	fstd::core::Assert(fstd::memory::get_array_size(b_module->imports) == 1);
+	fstd::core::Assert(a_module->imports[0] == common_module);
+	fstd::core::Assert(b_module->imports[0] == common_module);
+	fstd::core::Assert(get_symbol_table(common_module) != nullptr);
+
+	// Symbols are resolved through imports
+	fstd::memory::Array<Parsing_Result*>	parsing_results;
+
+	defer{ fstd::memory::release(parsing_results); };
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(modules); i++) {
+		fold_constant_expressions(modules[i]->parsing_result);
+		fstd::memory::array_push_back(parsing_results, &modules[i]->parsing_result);
+	}
+	deduce_types(parsing_results);
+
+	AST_Node* node = ((AST_Statement_Scope*)main_module->parsing_result.ast_root)->first_child;
+	while (node->ast_type != f::Node_Type::STATEMENT_VARIABLE) {
+		node = node->sibling;
+	}
+
+	// position : Vector2;
+	AST_Statement_Variable* position_var = (AST_Statement_Variable*)node;
+	{
+		fstd::core::Assert(position_var->type_info->kind == Type_Info::Kind::STRUCT);
+		fstd::core::Assert(position_var->type_info->size == 8);
+	}
+
+	// x : i32 = #run scale(20) + #run offset(1);
+	AST_Statement_Variable* x_var = (AST_Statement_Variable*)position_var->sibling;
+	{
+		fstd::core::Assert(x_var->expression->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(((AST_Literal*)x_var->expression)->value.value.integer == 42);
+	}
+}
+
+void test_ir_generation()
+{
+	using namespace f;
+
+	IR ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\functions.f)");
+
+	fstd::core::Assert(fstd::memory::get_array_size(ir.functions) == 3);
+	fstd::core::Assert(ir.entry_point_function == 2);
+
+	// add :: (a : i32, b : i32) -> i32 { return a + b; }
+	{
+		IR_Function& function = ir.functions[0];
+
+		fstd::core::Assert(function.nb_arguments == 2);
+		fstd::core::Assert(function.return_type == Register::Type::DWORD);
+		fstd::core::Assert(fstd::memory::get_array_size(function.blocks) == 1);
+		fstd::core::Assert(function.blocks[0].nb_instructions == 2);
+		fstd::core::Assert(function.instructions[0].opcode == IR_Opcode::ADD);
+		fstd::core::Assert(function.instructions[0].operands[0] == 0);
+		fstd::core::Assert(function.instructions[0].operands[1] == 1);
+		fstd::core::Assert(function.instructions[1].opcode == IR_Opcode::RETURN);
+		fstd::core::Assert(function.instructions[1].operands[0] == function.instructions[0].destination);
+	}
+
+	// average :: (a : f64, b : i32) -> f64		The integer operands are converted to f64
+	{
+		IR_Function&	function = ir.functions[1];
+		IR_Opcode		expected_opcodes[] = {
+			IR_Opcode::CONVERT, IR_Opcode::ADD, IR_Opcode::COPY,
+			IR_Opcode::CONSTANT, IR_Opcode::CONVERT, IR_Opcode::DIV, IR_Opcode::RETURN };
+
+		fstd::core::Assert(fstd::memory::get_array_size(function.instructions) == sizeof(expected_opcodes) / sizeof(IR_Opcode));
+		for (size_t i = 0; i < sizeof(expected_opcodes) / sizeof(IR_Opcode); i++) {
+			fstd::core::Assert(function.instructions[i].opcode == expected_opcodes[i]);
+		}
+		fstd::core::Assert(function.registers[1] == Register::Type::DWORD);
+		fstd::core::Assert(function.instructions[0].type == Register::Type::DOUBLE);
+		fstd::core::Assert(function.instructions[3].immediate.integer == 2);
+	}
+
+	// main :: () -> i32		Arguments of calls are stored in the operand list
+	{
+		IR_Function&	function = ir.functions[2];
+		IR_Instruction&	first_call = function.instructions[2];
+		IR_Instruction&	second_call = function.instructions[5];
+
+		fstd::core::Assert(first_call.opcode == IR_Opcode::CALL && first_call.immediate.index == 0);
+		fstd::core::Assert(second_call.opcode == IR_Opcode::CALL && second_call.immediate.index == 0);
+		fstd::core::Assert(second_call.operands[1] == 2);
+		fstd::core::Assert(function.operand_lists[second_call.operands[0]] == 0); // value
+		fstd::core::Assert(function.instructions[6].opcode == IR_Opcode::RETURN);
+	}
+}
+
+void test_ir_optimization()
+{
+	using namespace f;
+
+	IR ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\functions.f)");
+
+	// Calls are checked, test_inlining covers the inliner
+	globals.configuration.inline_functions = false;
+	optimize(ir);
+	globals.configuration.inline_functions = true;
+
+	// average :: (a : f64, b : i32) -> f64		The copy of sum is propagated and the conversion of 2 is folded
+	{
+		IR_Function&	function = ir.functions[1];
+		IR_Opcode		expected_opcodes[] = {
+			IR_Opcode::CONVERT, IR_Opcode::ADD, IR_Opcode::CONSTANT, IR_Opcode::DIV, IR_Opcode::RETURN };
+
+		fstd::core::Assert(function.is_ssa);
+		fstd::core::Assert(fstd::memory::get_array_size(function.instructions) == sizeof(expected_opcodes) / sizeof(IR_Opcode));
+		for (size_t i = 0; i < sizeof(expected_opcodes) / sizeof(IR_Opcode); i++) {
+			fstd::core::Assert(function.instructions[i].opcode == expected_opcodes[i]);
+		}
+		fstd::core::Assert(function.instructions[2].type == Register::Type::DOUBLE);
+		fstd::core::Assert(function.instructions[2].immediate.real == 2.0);
+		fstd::core::Assert(function.instructions[3].operands[0] == function.instructions[1].destination);
+	}
+
+	// main :: () -> i32		Calls are kept, the copy of value is propagated to the second call
+	{
+		IR_Function&	function = ir.functions[2];
+		IR_Opcode		expected_opcodes[] = {
+			IR_Opcode::CONSTANT, IR_Opcode::CONSTANT, IR_Opcode::CALL, IR_Opcode::CONSTANT, IR_Opcode::CALL, IR_Opcode::RETURN };
+
+		fstd::core::Assert(fstd::memory::get_array_size(function.instructions) == sizeof(expected_opcodes) / sizeof(IR_Opcode));
+		for (size_t i = 0; i < sizeof(expected_opcodes) / sizeof(IR_Opcode); i++) {
+			fstd::core::Assert(function.instructions[i].opcode == expected_opcodes[i]);
+		}
+		fstd::core::Assert(function.operand_lists[function.instructions[4].operands[0]] == function.instructions[2].destination);
+	}
+}
+
+void test_register_allocation()
+{
+	using namespace f;
+	using namespace f::x64;
+
+	// add :: (a : i32, b : i32) -> i32, average :: (a : f64, b : i32) -> f64
+	{
+		IR					ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\functions.f)");
+		Register_Allocation	add_allocation;
+		Register_Allocation	average_allocation;
+
+		defer{
+			release(add_allocation);
+			release(average_allocation);
+		};
+
+		optimize(ir);
+
+		// Arguments stay in the registers of the calling convention and the result is computed in RAX
+		allocate_registers(ir.functions[0], add_allocation);
+		fstd::core::Assert(add_allocation.nb_stack_slots == 0);
+		fstd::core::Assert(get_location(add_allocation, 0, 0) == Location{ Location::Kind::REGISTER, Physical_Register::RCX, 0 });
+		fstd::core::Assert(get_location(add_allocation, 1, 0) == Location{ Location::Kind::REGISTER, Physical_Register::RDX, 0 });
+		fstd::core::Assert(add_allocation.block_entry[0].count == 0);
+		fstd::core::Assert(add_allocation.before_instruction[1].count == 0);
+
+		allocate_registers(ir.functions[1], average_allocation);
+		fstd::core::Assert(get_location(average_allocation, 0, 0) == Location{ Location::Kind::REGISTER, Physical_Register::XMM0, 0 });
+		fstd::core::Assert(get_location(average_allocation, 1, 0) == Location{ Location::Kind::REGISTER, Physical_Register::RDX, 0 });
+	}
+
+	// pressure :: (x : i32) -> i32		17 values are alive at the same time, some of them are spilled
+	{
+		IR					ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\register_pressure.f)");
+		Register_Allocation	allocation;
+
+		defer{ release(allocation); };
+
+		optimize(ir);
+
+		allocate_registers(ir.functions[0], allocation);
+		fstd::core::Assert(allocation.nb_stack_slots > 0);
+		fstd::core::Assert((allocation.used_registers & get_register_mask(Physical_Register::RSP)) == 0);
+
+		// Values are reloaded before the instructions that need them in a register
+		for (size_t i = 0; i < fstd::memory::get_array_size(allocation.intervals); i++) {
+			Live_Interval& interval = allocation.intervals[i];
+
+			for (uint32_t j = 0; j < interval.nb_uses; j++) {
+				if (allocation.uses[interval.first_use + j].requires_register) {
+					fstd::core::Assert(interval.location.kind == Location::Kind::REGISTER);
+				}
+			}
+		}
+	}
+}
+
+void test_x64_encoder()
+{
+	using namespace f::x64;
+
+	fstd::memory::Array<uint8_t>	code;
+
+	defer{
+		fstd::memory::release(code);
+	};
+
+	auto check_encoding = [&code](std::initializer_list<uint8_t> expected) {
+		fstd::core::Assert(fstd::memory::get_array_size(code) == expected.size());
+		size_t i = 0;
+		for (uint8_t byte : expected) {
+			fstd::core::Assert(code[i++] == byte);
+		}
+		fstd::memory::resize_array(code, 0);
+	};
+
+	initialize_encoder();
+
+	encode_instruction(code, Mnemonic::ADD, make_register(Physical_Register::RAX), make_register(Physical_Register::RBX));
+	check_encoding({ 0x48, 0x01, 0xD8 });
+
+	// Immediate values take the shortest form
+	encode_instruction(code, Mnemonic::ADD, make_register(Physical_Register::RAX), make_immediate(1));
+	check_encoding({ 0x48, 0x83, 0xC0, 0x01 });
+	encode_instruction(code, Mnemonic::ADD, make_register(Physical_Register::RAX), make_immediate(1000));
+	check_encoding({ 0x48, 0x05, 0xE8, 0x03, 0x00, 0x00 });
+	encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RAX, 4), make_immediate(1));
+	check_encoding({ 0xB8, 0x01, 0x00, 0x00, 0x00 });
+
+	// SIB is required for RSP and R12, a displacement for RBP and R13
+	encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RCX), make_memory(Physical_Register::RSP, 8));
+	check_encoding({ 0x48, 0x8B, 0x4C, 0x24, 0x08 });
+	encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RAX), make_memory(Physical_Register::R13, 0));
+	check_encoding({ 0x49, 0x8B, 0x45, 0x00 });
+	encode_instruction(code, Mnemonic::LEA, make_register(Physical_Register::RAX), make_memory(Physical_Register::RBX, Physical_Register::R9, 4, 0x100, 0));
+	check_encoding({ 0x4A, 0x8D, 0x84, 0x8B, 0x00, 0x01, 0x00, 0x00 });
+
+	// REX is needed to access SIL, DIL, SPL and BPL
+	encode_instruction(code, Mnemonic::MOV, make_register(Physical_Register::RSI, 1), make_register(Physical_Register::RAX, 1));
+	check_encoding({ 0x40, 0x88, 0xC6 });
+
+	// Mandatory prefixes are before REX
+	encode_instruction(code, Mnemonic::CVTSI2SD, make_register(Physical_Register::XMM0), make_register(Physical_Register::RAX));
+	check_encoding({ 0xF2, 0x48, 0x0F, 0x2A, 0xC0 });
+
+	// Relative operands are relative to the start of the instruction
+	encode_instruction(code, Mnemonic::JCC, Condition_Code::E, make_relative(16));
+	check_encoding({ 0x74, 0x0E });
+	encode_instruction(code, Mnemonic::JMP, make_relative(130));
+	check_encoding({ 0xE9, 0x7D, 0x00, 0x00, 0x00 });
+}
+
+void test_branch_relaxation()
+{
+	using namespace f::x64;
+
+	Assembler						assembler;
+	fstd::memory::Array<uint8_t>	code;
+
+	defer{
+		release(assembler);
+		fstd::memory::release(code);
+	};
+
+	// The jcc is too far from its target, it grows to rel32 and the jmp has to grow too
+	uint32_t after_jcc = create_label(assembler);
+	uint32_t end = create_label(assembler);
+	uint32_t loop = create_label(assembler);
+
+	bind_label(assembler, loop);
+	emit_branch(assembler, Mnemonic::JMP, after_jcc);
+	for (size_t i = 0; i < 125; i++) {
+		encode_instruction(assembler.code, Mnemonic::NOP);
+	}
+	emit_branch(assembler, Mnemonic::JCC, Condition_Code::E, end);
+	bind_label(assembler, after_jcc);
+	emit_branch(assembler, Mnemonic::JCC, Condition_Code::NE, after_jcc);
+	for (size_t i = 0; i < 200; i++) {
+		encode_instruction(assembler.code, Mnemonic::NOP);
+	}
+	bind_label(assembler, end);
+	emit_branch(assembler, Mnemonic::CALL, loop);
+	encode_instruction(assembler.code, Mnemonic::RET);
+
+	relax_branches(assembler, code);
+
+	fstd::core::Assert(fstd::memory::get_array_size(code) == 5 + 125 + 6 + 2 + 200 + 5 + 1);
+	fstd::core::Assert(code[0] == 0xE9 && code[1] == 131);
+	fstd::core::Assert(code[130] == 0x0F && code[131] == 0x84 && code[132] == 202);
+	fstd::core::Assert(code[136] == 0x75 && code[137] == 0xFE);	// Short backward branch
+	fstd::core::Assert(code[338] == 0xE8 && code[339] == 0xA9);	// call loop (-343)
+	fstd::core::Assert(get_relaxed_label_offset(assembler, after_jcc) == 136);
+	fstd::core::Assert(get_relaxed_label_offset(assembler, end) == 338);
+	fstd::core::Assert(get_relaxed_offset(assembler, 125) == 138);
+}
+
+void test_jit_execution()
+{
+	using namespace f;
+
+	IR ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\functions.f)");
+	optimize(ir);
+
+	// main :: () -> i32 { value : i32 = add(1, 2); return add(value, 3); }
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == 6);
+}
+
+// A f32 mixed with an integer stays a f32, the result has to be the same folded and computed at runtime
+void test_mixed_arithmetic()
+{
+	using namespace f;
+
+	fstd::memory::Array<f::Token<f::Keyword>>	tokens;
+	Parsing_Result								parsing_result;
+	fstd::system::Path							path;
+
+	defer{ fstd::system::reset_path(path); };
+
+	fstd::system::from_native(path, (uint8_t*)u8R"(.\tests\ir\mixed_arithmetic.f)");
+
+	initialize_lexer();
+	lex(path, tokens);
+
+	parse(tokens, parsing_result);
+	fold_constant_expressions(parsing_result);
+
+	// folded : f64 = 16777216f + 1;		2^24 + 1 isn't representable in a f32
+	{
+		AST_Statement_Variable*	folded_var = (AST_Statement_Variable*)((AST_Statement_Scope*)parsing_result.ast_root)->first_child;
+		AST_Literal*			literal = (AST_Literal*)folded_var->expression;
+
+		fstd::core::Assert(literal->ast_type == f::Node_Type::STATEMENT_LITERAL);
+		fstd::core::Assert(literal->value.type == Token_Type::NUMERIC_LITERAL_F32);
+		fstd::core::Assert(literal->value.value.real_32 == 16777216.0f);
+	}
+
+	// main :: () -> i32 { x : f32 = 16777216f; wide : f64 = x + 1; return wide - 16777216; }
+	IR ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\mixed_arithmetic.f)");
+	{
+		IR_Function&	function = ir.functions[ir.entry_point_function];
+		uint32_t		nb_additions = 0;
+
+		for (size_t i = 0; i < fstd::memory::get_array_size(function.instructions); i++) {
+			if (function.instructions[i].opcode == IR_Opcode::ADD) {
+				fstd::core::Assert(function.instructions[i].type == Register::Type::FLOAT);
+				nb_additions++;
+			}
+		}
+		fstd::core::Assert(nb_additions == 1);
+	}
+
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == 0);
+}
+
+void test_parallel_code_generation()
+{
+	using namespace f;
+
+	IR								irs[2];
+	x64::Function_Code				programs_code[2];
+	fstd::memory::Array<uint32_t>	functions_offsets[2];
+	uint32_t						nb_threads[2] = { 1, 4 };
+
+	defer{
+		for (size_t i = 0; i < 2; i++) {
+			x64::release(programs_code[i]);
+			fstd::memory::release(functions_offsets[i]);
+		}
+	};
+
+	// The register allocation modifies the IR, each generation needs its own
+	for (size_t i = 0; i < 2; i++) {
+		irs[i] = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\functions.f)");
+		optimize(irs[i]);
+
+		x64::generate_program_code(irs[i], programs_code[i], functions_offsets[i], nb_threads[i]);
+	}
+
+	// The program doesn't depend on the number of threads
+	fstd::core::Assert(fstd::memory::get_array_size(programs_code[0].code) == fstd::memory::get_array_size(programs_code[1].code));
+	fstd::core::Assert(fstd::system::memory_compare(fstd::memory::get_array_data(programs_code[0].code), fstd::memory::get_array_data(programs_code[1].code), fstd::memory::get_array_size(programs_code[0].code)));
+	fstd::core::Assert(fstd::memory::get_array_size(functions_offsets[0]) == fstd::memory::get_array_size(functions_offsets[1]));
+	for (size_t i = 0; i < fstd::memory::get_array_size(functions_offsets[0]); i++) {
+		fstd::core::Assert(functions_offsets[0][i] == functions_offsets[1][i]);
+	}
+}
+
+void test_read_only_data()
+{
+	using namespace f;
+
+	ReadOnlyData	read_only_data;
+	uint8_t			mask[16] = { 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff, 0x7f };
+
+	initialize_read_only_data(read_only_data);
+
+	uint32_t hello_world = add_literal(read_only_data, Literal::Kind::STRING, (const uint8_t*)"hello world", 12);
+	uint32_t world = add_literal(read_only_data, Literal::Kind::STRING, (const uint8_t*)"world", 6);
+	uint32_t hello = add_literal(read_only_data, Literal::Kind::STRING, (const uint8_t*)"hello", 6);
+	uint32_t hello_world_again = add_literal(read_only_data, Literal::Kind::STRING, (const uint8_t*)"hello world", 12);
+	uint32_t constant = add_literal(read_only_data, Literal::Kind::CONSTANT, mask, sizeof(mask));
+
+	layout_read_only_data(read_only_data);
+
+	// Identical literals are shared, and a string that ends another one is merged in it
+	fstd::core::Assert(hello_world_again == hello_world);
+	fstd::core::Assert(fstd::memory::get_array_size(read_only_data.literals) == 4);
+	fstd::core::Assert(read_only_data.literals[world].RVA == read_only_data.literals[hello_world].RVA + 6);
+	fstd::core::Assert(read_only_data.literals[hello].RVA != read_only_data.literals[hello_world].RVA);
+
+	// Constants come first with their alignment
+	fstd::core::Assert(read_only_data.literals[constant].RVA == 0);
+	fstd::core::Assert(read_only_data.current_RVA == sizeof(mask) + 12 + 6);
+	fstd::core::Assert(fstd::system::memory_compare(fstd::memory::get_array_data(read_only_data.section) + read_only_data.literals[world].RVA, "world", 6));
+
+	// Strings are written once in the pool, even when it is reallocated by each of them
+	ReadOnlyData	strings;
+	uint8_t			text[] = "string_000";
+	uint32_t		text_size = sizeof(text) - 1;
+
+	initialize_read_only_data(strings);
+
+	for (uint32_t i = 0; i < 500; i++) {
+		text[text_size - 3] = (uint8_t)('0' + i / 100);
+		text[text_size - 2] = (uint8_t)('0' + i / 10 % 10);
+		text[text_size - 1] = (uint8_t)('0' + i % 10);
+		fstd::core::Assert(add_string_literal(strings, text, text_size) == i);
+	}
+	fstd::core::Assert(add_string_literal(strings, text, text_size) == 499);
+	fstd::core::Assert(fstd::memory::get_array_size(strings.pool) == 500 * (text_size + 1));
+
+	for (uint32_t i = 0; i < 500; i++) {
+		const Literal& literal = strings.literals[i];
+
+		fstd::core::Assert(literal.offset == i * (text_size + 1) && literal.size == text_size + 1);
+		fstd::core::Assert(strings.pool[literal.offset + text_size - 2] == (uint8_t)('0' + i / 10 % 10));
+		fstd::core::Assert(strings.pool[literal.offset + text_size] == (uint8_t)'\0');
+	}
+}
+
+void test_import_hoisting()
+{
+	using namespace f;
+	using namespace f::x64;
+
+	// The language doesn't have loops yet, the IR is built by hand:
+	//   count :: (n : i32) -> i32 { i := 0; while i < n { imported(i); i = i + 1; } return i; }
+	AST_Statement_Function	imported_declaration;
+	Imported_Function		imported_function;
+	IR						ir;
+	Register_Allocation		allocation;
+
+	defer{ release(allocation); };
+
+	imported_function.function = &imported_declaration;
+	imported_function.library = nullptr;
+
+	IR_Function imported = IR_Function();
+	imported.imported_function = &imported_function;
+	fstd::memory::array_push_back(ir.functions, imported);
+
+	IR_Function count = IR_Function();
+	count.nb_arguments = 1;
+	count.has_return_value = true;
+	count.return_type = Register::Type::DWORD;
+	fstd::memory::array_push_back(ir.functions, count);
+
+	IR_Function&	function = ir.functions[1];
+	uint32_t		n = 0, i = 1, condition = 2, one = 3;
+	Register::Type	types[] = { Register::Type::DWORD, Register::Type::DWORD, Register::Type::BYTE, Register::Type::DWORD };
+
+	for (Register::Type type : types) {
+		fstd::memory::array_push_back(function.registers, type);
+	}
+	fstd::memory::array_push_back(function.operand_lists, i); // Argument of the call
+
+	const Register::Type type = Register::Type::DWORD;
+
+	emit(function, IR_Opcode::CONSTANT, type, i, invalid_register, invalid_register, 0);
+	emit_branch(function, IR_Opcode::JUMP, invalid_register, 1, 0);
+	end_block(function);
+	emit(function, IR_Opcode::LESS, type, condition, i, n, 0);
+	emit_branch(function, IR_Opcode::BRANCH, condition, 2, 3);
+	end_block(function);
+	emit(function, IR_Opcode::CALL, type, invalid_register, 0, 1, 0);
+	emit(function, IR_Opcode::CONSTANT, type, one, invalid_register, invalid_register, 1);
+	emit(function, IR_Opcode::ADD, type, i, i, one, 0);
+	emit_branch(function, IR_Opcode::JUMP, invalid_register, 1, 0);
+	end_block(function);
+	emit(function, IR_Opcode::RETURN, type, invalid_register, i, invalid_register, 0);
+	end_block(function);
+
+	build_ssa(function);
+	fstd::core::Assert(hoist_imported_function_addresses(ir, function));
+
+	// The address is read at the end of the entry block, and the call in the loop uses it
+	IR_Basic_Block&	entry = function.blocks[0];
+	IR_Instruction&	function_address = function.instructions[entry.first_instruction + entry.nb_instructions - 2];
+	uint32_t		nb_indirect_calls = 0;
+
+	fstd::core::Assert(function_address.opcode == IR_Opcode::FUNCTION_ADDRESS && function_address.immediate.index == 0);
+	for (size_t j = 0; j < fstd::memory::get_array_size(function.instructions); j++) {
+		IR_Instruction& instruction = function.instructions[j];
+
+		fstd::core::Assert(instruction.opcode != IR_Opcode::CALL);
+		if (instruction.opcode == IR_Opcode::CALL_INDIRECT) {
+			fstd::core::Assert(instruction.operands[1] == 2);
+			fstd::core::Assert(function.operand_lists[instruction.operands[0]] == function_address.destination);
+			nb_indirect_calls++;
+		}
+	}
+	fstd::core::Assert(nb_indirect_calls == 1);
+
+	// The address stays in a non volatile register during the loop
+	allocate_registers(function, allocation);
+	Location address_location = allocation.intervals[function_address.destination].location;
+
+	fstd::core::Assert(address_location.kind == Location::Kind::REGISTER);
+	fstd::core::Assert(address_location.physical_register == Physical_Register::RBX || address_location.physical_register == Physical_Register::RBP
+		|| address_location.physical_register == Physical_Register::RSI || address_location.physical_register == Physical_Register::RDI
+		|| address_location.physical_register >= Physical_Register::R12);
+}
+
+void test_function_frames()
+{
+	using namespace f;
+
+	// add :: (a : i32, b : i32) -> i32 { return a + b; }
+	// main :: () -> i32 { return add(1, 2); }
+	IR								ir;
+	x64::Function_Code				program_code;
+	fstd::memory::Array<uint32_t>	function_offsets;
+
+	defer{
+		x64::release(program_code);
+		fstd::memory::release(function_offsets);
+	};
+
+	const Register::Type type = Register::Type::DWORD;
+
+	fstd::memory::reserve_array(ir.functions, 2);
+	{
+		IR_Function& add = add_function(ir, 2, 3, type);
+
+		emit(add, IR_Opcode::ADD, type, 2, 0, 1, 0);
+		emit(add, IR_Opcode::RETURN, type, invalid_register, 2, invalid_register, 0);
+		end_block(add);
+	}
+	{
+		IR_Function& main = add_function(ir, 0, 3, type);
+
+		fstd::memory::array_push_back(main.operand_lists, 0u);
+		fstd::memory::array_push_back(main.operand_lists, 1u);
+		emit(main, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, 1);
+		emit(main, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 2);
+		emit(main, IR_Opcode::CALL, type, 2, 0, 2, 0);
+		emit(main, IR_Opcode::RETURN, type, invalid_register, 2, invalid_register, 0);
+		end_block(main);
+	}
+
+	x64::generate_program_code(ir, program_code, function_offsets, 1);
+
+	// add is a leaf function without prologue, it doesn't need unwind information
+	fstd::core::Assert(program_code.code[function_offsets[0]] != 0x55); // push rbp
+	fstd::core::Assert(fstd::memory::get_array_size(program_code.unwind_entries) == 1);
+
+	// main only allocates its outgoing arguments: sub rsp, 40 (shadow space and alignment)
+	const x64::Unwind_Entry&	unwind_entry = program_code.unwind_entries[0];
+	const uint8_t*				unwind_info = fstd::memory::get_array_data(program_code.unwind_info) + unwind_entry.unwind_info_offset;
+	uint8_t						expected_prologue[] = { 0x48, 0x83, 0xec, 0x28 };
+	uint8_t						expected_unwind_info[] = { 0x01, 0x04, 0x01, 0x00, 0x04, 0x42 };
+
+	fstd::core::Assert(unwind_entry.function_start == function_offsets[1]);
+	fstd::core::Assert(fstd::system::memory_compare(fstd::memory::get_array_data(program_code.code) + function_offsets[1], expected_prologue, sizeof(expected_prologue)));
+	fstd::core::Assert(fstd::system::memory_compare(unwind_info, expected_unwind_info, sizeof(expected_unwind_info)));
+}
+
+void test_inlining()
+{
+	using namespace f;
+
+	// add :: (a : i32, b : i32) -> i32 { return a + b; }
+	// sign :: (a : i32) -> i32 { if a < 0 { return -1; } return 1; }	Two returns, the result is a phi
+	// count :: (a : i32) -> i32 { return count(a); }					Recursive
+	// main :: () -> i32 { return add(1, 2) + sign(add(3, 4)) + count(5); }
+	IR								ir;
+	fstd::memory::Array<uint32_t>	order;
+	fstd::memory::Array<bool>		is_recursive;
+
+	defer{
+		fstd::memory::release(order);
+		fstd::memory::release(is_recursive);
+	};
+
+	const Register::Type type = Register::Type::DWORD;
+
+	fstd::memory::reserve_array(ir.functions, 4);
+	{
+		IR_Function& add = add_function(ir, 2, 3, type);
+
+		emit(add, IR_Opcode::ADD, type, 2, 0, 1, 0);
+		emit(add, IR_Opcode::RETURN, type, invalid_register, 2, invalid_register, 0);
+		end_block(add);
+	}
+	{
+		IR_Function& sign = add_function(ir, 1, 4, type);
+
+		emit(sign, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 0);
+		emit(sign, IR_Opcode::LESS, type, 2, 0, 1, 0);
+		emit_branch(sign, IR_Opcode::BRANCH, 2, 1, 2);
+		end_block(sign);
+		emit(sign, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, -1);
+		emit(sign, IR_Opcode::RETURN, type, invalid_register, 3, invalid_register, 0);
+		end_block(sign);
+		emit(sign, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, 1);
+		emit(sign, IR_Opcode::RETURN, type, invalid_register, 3, invalid_register, 0);
+		end_block(sign);
+	}
+	{
+		IR_Function& count = add_function(ir, 1, 2, type);
+
+		fstd::memory::array_push_back(count.operand_lists, 0u);
+		emit(count, IR_Opcode::CALL, type, 1, 0, 1, 2);
+		emit(count, IR_Opcode::RETURN, type, invalid_register, 1, invalid_register, 0);
+		end_block(count);
+	}
+	{
+		IR_Function&	main = add_function(ir, 0, 12, type);
+		uint32_t		arguments[] = { 0, 1, 3, 4, 5, 7 };
+
+		for (uint32_t i = 0; i < sizeof(arguments) / sizeof(uint32_t); i++) {
+			fstd::memory::array_push_back(main.operand_lists, arguments[i]);
+		}
+		emit(main, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, 1);
+		emit(main, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 2);
+		emit(main, IR_Opcode::CALL, type, 2, 0, 2, 0);
+		emit(main, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, 3);
+		emit(main, IR_Opcode::CONSTANT, type, 4, invalid_register, invalid_register, 4);
+		emit(main, IR_Opcode::CALL, type, 5, 2, 2, 0);
+		emit(main, IR_Opcode::CALL, type, 6, 4, 1, 1);
+		emit(main, IR_Opcode::CONSTANT, type, 7, invalid_register, invalid_register, 5);
+		emit(main, IR_Opcode::CALL, type, 8, 5, 1, 2);
+		emit(main, IR_Opcode::ADD, type, 9, 2, 6, 0);
+		emit(main, IR_Opcode::ADD, type, 10, 9, 8, 0);
+		emit(main, IR_Opcode::RETURN, type, invalid_register, 10, invalid_register, 0);
+		end_block(main);
+	}
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(ir.functions); i++) {
+		build_ssa(ir.functions[i]);
+	}
+
+	// Callees come before their callers, count calls itself
+	order_functions_bottom_up(ir, order, is_recursive);
+	fstd::core::Assert(fstd::memory::get_array_size(order) == 4);
+	fstd::core::Assert(order[3] == 3);
+	fstd::core::Assert(is_recursive[2] && !is_recursive[0] && !is_recursive[1] && !is_recursive[3]);
+
+	IR_Function& main = ir.functions[3];
+
+	fstd::core::Assert(inline_calls(ir, main, is_recursive, 32, 100));
+	fstd::core::Assert(!inline_calls(ir, ir.functions[2], is_recursive, 32, 100));
+
+	// Only the call of count is kept, the result of sign is a phi of its two returns
+	uint32_t nb_calls = 0;
+	uint32_t nb_phis = 0;
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(main.instructions); i++) {
+		if (main.instructions[i].opcode == IR_Opcode::CALL) {
+			fstd::core::Assert(main.instructions[i].immediate.index == 2);
+			nb_calls++;
+		}
+		else if (main.instructions[i].opcode == IR_Opcode::PHI) {
+			fstd::core::Assert(main.instructions[i].destination == 6);
+			nb_phis++;
+		}
+	}
+	fstd::core::Assert(nb_calls == 1);
+	fstd::core::Assert(nb_phis == 1);
+	fstd::core::Assert(fstd::memory::get_array_size(main.blocks) == 4);
+
+	// no_inline functions are kept, even small ones
+	ir.functions[0].inlining = Inlining::NEVER;
+	fstd::memory::resize_array(main.instructions, 0);
+	fstd::memory::resize_array(main.blocks, 0);
+	emit(main, IR_Opcode::CALL, type, 2, 0, 2, 0);
+	emit(main, IR_Opcode::RETURN, type, invalid_register, 2, invalid_register, 0);
+	end_block(main);
+	fstd::core::Assert(!inline_calls(ir, main, is_recursive, 32, 100));
+}
+
+// Number of results of dividend / divisor and dividend % divisor that differ between the division by the constant and
+// the generic DIV or IDIV of the same values
+static int32_t count_division_differences(f::Register::Type type, int64_t dividend, int64_t divisor)
+{
+	using namespace f;
+
+	// check :: (x : type, d : type) -> i32 { return (x / divisor != x / d) as i32 + (x % divisor != x % d) as i32; }
+	// main :: () -> i32 { return check(dividend, divisor); }
+	IR ir;
+
+	fstd::memory::reserve_array(ir.functions, 2);
+	{
+		IR_Function& function = add_function(ir, 2, 12, type);
+
+		function.return_type = Register::Type::DWORD;
+		function.registers[5] = Register::Type::BYTE;
+		function.registers[8] = Register::Type::BYTE;
+		function.registers[9] = Register::Type::DWORD;
+		function.registers[10] = Register::Type::DWORD;
+		function.registers[11] = Register::Type::DWORD;
+		emit(function, IR_Opcode::CONSTANT, type, 2, invalid_register, invalid_register, divisor);
+		emit(function, IR_Opcode::DIV, type, 3, 0, 2, 0);
+		emit(function, IR_Opcode::DIV, type, 4, 0, 1, 0);
+		emit(function, IR_Opcode::NOT_EQUAL, type, 5, 3, 4, 0);
+		emit(function, IR_Opcode::REM, type, 6, 0, 2, 0);
+		emit(function, IR_Opcode::REM, type, 7, 0, 1, 0);
+		emit(function, IR_Opcode::NOT_EQUAL, type, 8, 6, 7, 0);
+		emit(function, IR_Opcode::CONVERT, Register::Type::DWORD, 9, 5, invalid_register, 0);
+		emit(function, IR_Opcode::CONVERT, Register::Type::DWORD, 10, 8, invalid_register, 0);
+		emit(function, IR_Opcode::ADD, Register::Type::DWORD, 11, 9, 10, 0);
+		emit(function, IR_Opcode::RETURN, Register::Type::DWORD, invalid_register, 11, invalid_register, 0);
+	}
+	{
+		IR_Function& function = add_function(ir, 0, 3, type);
+
+		function.return_type = Register::Type::DWORD;
+		function.registers[2] = Register::Type::DWORD;
+		fstd::memory::array_push_back(function.operand_lists, 0u);
+		fstd::memory::array_push_back(function.operand_lists, 1u);
+		emit(function, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, dividend);
+		emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, divisor);
+		emit(function, IR_Opcode::CALL, Register::Type::DWORD, 2, 0, 2, 0);
+		emit(function, IR_Opcode::RETURN, Register::Type::DWORD, invalid_register, 2, invalid_register, 0);
+	}
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(ir.functions); i++) {
+		end_block(ir.functions[i]);
+	}
+	ir.entry_point_function = 1;
+
+	return JIT_x64_backend::run(ir); // The backend is already initialized
+}
+
+void test_division_by_constants()
+{
+	using namespace f;
+
+	// signed_division :: (x : i32) -> i32 { return x / 7 + x % -8 * 16; }
+	// unsigned_division :: (x : u64) -> u64 { return x / 10 + x % 1000; }
+	// main :: () -> i32 { return signed_division(-123457) + unsigned_division(0xfedcba9876543210) as i32; }
+	IR ir;
+
+	fstd::memory::reserve_array(ir.functions, 3);
+	{
+		Register::Type	type = Register::Type::DWORD;
+		IR_Function&	function = add_function(ir, 1, 9, type);
+
+		emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 7);
+		emit(function, IR_Opcode::DIV, type, 2, 0, 1, 0);
+		emit(function, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, -8);
+		emit(function, IR_Opcode::REM, type, 4, 0, 3, 0);
+		emit(function, IR_Opcode::CONSTANT, type, 5, invalid_register, invalid_register, 16);
+		emit(function, IR_Opcode::MUL, type, 6, 4, 5, 0);
+		emit(function, IR_Opcode::ADD, type, 7, 2, 6, 0);
+		emit(function, IR_Opcode::RETURN, type, invalid_register, 7, invalid_register, 0);
+	}
+	{
+		Register::Type	type = Register::Type::QWORD | Register::Type::UNSIGNED;
+		IR_Function&	function = add_function(ir, 1, 6, type);
+
+		emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 10);
+		emit(function, IR_Opcode::DIV, type, 2, 0, 1, 0);
+		emit(function, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, 1000);
+		emit(function, IR_Opcode::REM, type, 4, 0, 3, 0);
+		emit(function, IR_Opcode::ADD, type, 5, 2, 4, 0);
+		emit(function, IR_Opcode::RETURN, type, invalid_register, 5, invalid_register, 0);
+	}
+	{
+		Register::Type	type = Register::Type::DWORD;
+		IR_Function&	function = add_function(ir, 0, 6, type);
+
+		function.registers[2] = Register::Type::QWORD | Register::Type::UNSIGNED;
+		function.registers[3] = Register::Type::QWORD | Register::Type::UNSIGNED;
+		fstd::memory::array_push_back(function.operand_lists, 0u);
+		fstd::memory::array_push_back(function.operand_lists, 2u);
+		emit(function, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, -123457);
+		emit(function, IR_Opcode::CALL, type, 1, 0, 1, 0);
+		emit(function, IR_Opcode::CONSTANT, Register::Type::QWORD | Register::Type::UNSIGNED, 2, invalid_register, invalid_register, (int64_t)0xfedcba9876543210);
+		emit(function, IR_Opcode::CALL, Register::Type::QWORD | Register::Type::UNSIGNED, 3, 1, 1, 1);
+		emit(function, IR_Opcode::CONVERT, type, 4, 3, invalid_register, 0);
+		emit(function, IR_Opcode::ADD, type, 5, 1, 4, 0);
+		emit(function, IR_Opcode::RETURN, type, invalid_register, 5, invalid_register, 0);
+	}
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(ir.functions); i++) {
+		end_block(ir.functions[i]);
+	}
+	ir.entry_point_function = 2;
+
+	uint64_t	unsigned_value = 0xfedcba9876543210;
+	int32_t		expected_result = (-123457 / 7 + -123457 % -8 * 16) + (int32_t)(uint32_t)(unsigned_value / 10 + unsigned_value % 1000);
+
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == expected_result);
+
+	// Each sequence gives the same results as the generic DIV or IDIV
+	struct Division_Case
+	{
+		Register::Type	type;
+		int64_t			dividend;
+		int64_t			divisor;
+	};
+
+	const Register::Type	u8 = Register::Type::BYTE | Register::Type::UNSIGNED;
+	const Register::Type	i16 = Register::Type::WORD;
+	const Register::Type	i32 = Register::Type::DWORD;
+	const Register::Type	u32 = Register::Type::DWORD | Register::Type::UNSIGNED;
+	const Register::Type	i64 = Register::Type::QWORD;
+	const Register::Type	u64 = Register::Type::QWORD | Register::Type::UNSIGNED;
+
+	Division_Case cases[] = {
+		{ u32, 0xfffffff9, 7 },							// The multiplier of 7 doesn't fit, it needs the add fixup
+		{ u32, 123456789, 7 },
+		{ u64, (int64_t)0xfffffffffffffff9, 7 },
+		{ u64, (int64_t)0xfedcba9876543210, 7 },
+		{ u8, 251, 7 },
+		{ u8, 200, 10 },
+		{ u8, 255, 16 },
+		{ i16, -30000, 7 },
+		{ i16, 32767, -7 },
+		{ i16, -1001, 4 },
+		{ i32, 123457, -7 },
+		{ i32, -123457, -7 },
+		{ i64, -1234567890123, -7 },
+		{ i32, -123457, 8 },							// Negative dividends are biased before the shift
+		{ i32, -7, 8 },
+		{ i64, -1234567890123, 16 },
+		{ i64, -1234567890123, -16 },
+		{ i32, INT32_MIN, 7 },
+		{ i32, INT32_MIN, -7 },
+		{ i32, INT32_MIN, 8 },
+		{ i64, INT64_MIN, 7 },
+		{ i64, INT64_MIN, -7 },
+		{ i64, INT64_MIN, 16 },
+		{ i32, -123457, 1 },
+		{ i32, -123457, -1 },
+		{ i32, INT32_MIN, 1 },
+		{ i64, INT64_MIN, 1 },
+		{ i16, -5, -1 },
+		{ u32, 0xffffffff, 1 },
+		{ u64, (int64_t)0xffffffffffffffff, 1 },
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		fstd::core::Assert(count_division_differences(cases[i].type, cases[i].dividend, cases[i].divisor) == 0);
+	}
+}
+
+void test_unsigned_conversions()
+{
+	using namespace f;
+
+	// to_f64 :: (x : u64) -> f64 { return x; }	to_f32 :: (x : u64) -> f32 { return x; }
+	// from_f64 :: (x : f64) -> u64 { return x; }	from_f32 :: (x : f32) -> u64 { return x; }
+	// main :: () -> i32, each value is converted back and forth, bit i of the result is set when the value i is right
+	IR ir;
+
+	const Register::Type	u64 = Register::Type::QWORD | Register::Type::UNSIGNED;
+	const Register::Type	f64 = Register::Type::DOUBLE;
+	const Register::Type	f32 = Register::Type::FLOAT;
+	const Register::Type	i32 = Register::Type::DWORD;
+
+	fstd::memory::reserve_array(ir.functions, 5);
+	for (Register::Type type : { f64, f32 }) {
+		IR_Function&	function = add_function(ir, 1, 1, u64);
+		uint32_t		value = emit_value(function, IR_Opcode::CONVERT, type, type, 0, invalid_register, 0);
+
+		function.return_type = type;
+		emit(function, IR_Opcode::RETURN, type, invalid_register, value, invalid_register, 0);
+		end_block(function);
+	}
+	for (Register::Type type : { f64, f32 }) {
+		IR_Function&	function = add_function(ir, 1, 1, type);
+		uint32_t		value = emit_value(function, IR_Opcode::CONVERT, u64, u64, 0, invalid_register, 0);
+
+		function.return_type = u64;
+		emit(function, IR_Opcode::RETURN, u64, invalid_register, value, invalid_register, 0);
+		end_block(function);
+	}
+
+	// Values from 2^63 don't fit in int64, the third one rounds up only if the lowest bit isn't lost when it is halved
+	const uint64_t	values[] = { 12345, 0xfffffffffffff800, 0x8000000000000401, 0x8000000000000001, 15000000000000000000u, 0xffffff0000000000, 0x8000008000000001 };
+	const uint32_t	nb_values = sizeof(values) / sizeof(uint64_t);
+	uint32_t		expected_result = 0;
+	{
+		IR_Function&	function = add_function(ir, 0, 0, i32);
+		uint32_t		sum = emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, 0);
+
+		for (uint32_t i = 0; i < nb_values; i++) {
+			bool			is_double = i < 5;
+			Register::Type	type = is_double ? f64 : f32;
+			uint32_t		value = emit_value(function, IR_Opcode::CONSTANT, u64, u64, invalid_register, invalid_register, (int64_t)values[i]);
+			uint32_t		first_operand = (uint32_t)fstd::memory::get_array_size(function.operand_lists);
+
+			fstd::memory::array_push_back(function.operand_lists, value);
+			uint32_t real = emit_value(function, IR_Opcode::CALL, type, type, first_operand, 1, is_double ? 0 : 1);
+
+			fstd::memory::array_push_back(function.operand_lists, real);
+			uint32_t result = emit_value(function, IR_Opcode::CALL, u64, u64, first_operand + 1, 1, is_double ? 2 : 3);
+
+			uint64_t	expected_value = is_double ? (uint64_t)(double)values[i] : (uint64_t)(float)values[i];
+			uint32_t	expected = emit_value(function, IR_Opcode::CONSTANT, u64, u64, invalid_register, invalid_register, (int64_t)expected_value);
+			uint32_t	is_equal = emit_value(function, IR_Opcode::EQUAL, u64, Register::Type::BYTE, result, expected, 0);
+			uint32_t	bit = emit_value(function, IR_Opcode::CONVERT, i32, i32, is_equal, invalid_register, 0);
+			uint32_t	mask = emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, 1 << i);
+
+			sum = emit_value(function, IR_Opcode::ADD, i32, i32, sum, emit_value(function, IR_Opcode::MUL, i32, i32, bit, mask, 0), 0);
+			expected_result |= 1 << i;
+		}
+		emit(function, IR_Opcode::RETURN, i32, invalid_register, sum, invalid_register, 0);
+		end_block(function);
+	}
+	ir.entry_point_function = 4;
+
+	fstd::core::Assert((uint64_t)(double)values[2] == 0x8000000000000800 && (uint64_t)(float)values[6] == 0x8000010000000000);
+
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == (int32_t)expected_result);
+}
+
+void test_vector_types()
+{
+	using namespace f;
+
+	// scale :: (a : f32x4, b : f32x4) -> f32x4 { return (-(a * b - 0.5) / a).wzyx; }
+	// main :: () -> i32, uses every vector type with broadcasts, lane insertions, extractions and shuffles
+	IR ir;
+
+	const Register::Type	f32 = Register::Type::FLOAT;
+	const Register::Type	f64 = Register::Type::DOUBLE;
+	const Register::Type	i8 = Register::Type::BYTE;
+	const Register::Type	i16 = Register::Type::WORD;
+	const Register::Type	i32 = Register::Type::DWORD;
+	const Register::Type	i64 = Register::Type::QWORD;
+	const Register::Type	f32x4 = Register::Type::VECTOR | f32;
+	const Register::Type	f64x2 = Register::Type::VECTOR | f64;
+	const Register::Type	i8x16 = Register::Type::VECTOR | i8;
+	const Register::Type	i16x8 = Register::Type::VECTOR | i16;
+	const Register::Type	i32x4 = Register::Type::VECTOR | i32;
+	const Register::Type	i64x2 = Register::Type::VECTOR | i64;
+
+	fstd::memory::reserve_array(ir.functions, 2);
+	{
+		IR_Function&	function = add_function(ir, 2, 2, f32x4);
+		uint32_t		product = emit_value(function, IR_Opcode::MUL, f32x4, f32x4, 0, 1, 0);
+		uint32_t		difference = emit_value(function, IR_Opcode::SUB, f32x4, f32x4, product, emit_real(function, f32x4, 0.5), 0);
+		uint32_t		negation = emit_value(function, IR_Opcode::NEG, f32x4, f32x4, difference, invalid_register, 0);
+		uint32_t		quotient = emit_value(function, IR_Opcode::DIV, f32x4, f32x4, negation, 0, 0);
+		uint32_t		shuffle = emit_value(function, IR_Opcode::SHUFFLE, f32x4, f32x4, quotient, invalid_register, 0x0123);
+
+		emit_value(function, IR_Opcode::RETURN, f32x4, f32x4, shuffle, invalid_register, 0);
+	}
+	{
+		IR_Function&	function = add_function(ir, 0, 0, i32);
+		uint32_t		sum = emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, 0);
+
+		auto accumulate = [&](uint32_t value, Register::Type type, double factor) {
+			if (is_floating_point(type)) {
+				value = emit_value(function, IR_Opcode::MUL, type, type, value, emit_real(function, type, factor), 0);
+			}
+			value = emit_value(function, IR_Opcode::CONVERT, i32, i32, value, invalid_register, 0);
+			sum = emit_value(function, IR_Opcode::ADD, i32, i32, sum, value, 0);
+		};
+
+		// f32x4
+		{
+			uint32_t a = emit_value(function, IR_Opcode::CONVERT, f32x4, f32x4, emit_real(function, f32, 1.5), invalid_register, 0);
+
+			a = emit_value(function, IR_Opcode::INSERT, f32x4, f32x4, a, emit_real(function, f32, 2.0), 2);
+			fstd::memory::array_push_back(function.operand_lists, a);
+			fstd::memory::array_push_back(function.operand_lists, emit_real(function, f32x4, 4.0));
+
+			uint32_t result = emit_value(function, IR_Opcode::CALL, f32x4, f32x4, 0, 2, 0);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, f32x4, f32, result, invalid_register, 0), f32, 1000.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, f32x4, f32, result, invalid_register, 1), f32, 100.0);
+		}
+		// f64x2
+		{
+			uint32_t	scalar = emit_real(function, f64, 2.5);
+			uint32_t	a = emit_value(function, IR_Opcode::CONVERT, f64x2, f64x2, scalar, invalid_register, 0);
+
+			a = emit_value(function, IR_Opcode::INSERT, f64x2, f64x2, a, emit_real(function, f64, -1.25), 1);
+
+			uint32_t	product = emit_value(function, IR_Opcode::MUL, f64x2, f64x2, a, emit_real(function, f64x2, 4.0), 0);
+			uint32_t	difference = emit_value(function, IR_Opcode::SUB, f64x2, f64x2, product, a, 0);
+			uint32_t	swap = emit_value(function, IR_Opcode::SHUFFLE, f64x2, f64x2, difference, invalid_register, 0x01);
+			uint32_t	negation = emit_value(function, IR_Opcode::NEG, f64x2, f64x2, swap, invalid_register, 0);
+			uint32_t	insertion = emit_value(function, IR_Opcode::INSERT, f64x2, f64x2, negation, scalar, 0);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, f64x2, f64, negation, invalid_register, 0), f64, 10.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, f64x2, f64, negation, invalid_register, 1), f64, 100.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, f64x2, f64, insertion, invalid_register, 0), f64, 1000.0);
+		}
+		// i32x4
+		{
+			uint32_t	seven = emit_value(function, IR_Opcode::CONSTANT, i32x4, i32x4, invalid_register, invalid_register, 7);
+			uint32_t	a = emit_value(function, IR_Opcode::CONVERT, i32x4, i32x4, emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, 5), invalid_register, 0);
+
+			a = emit_value(function, IR_Opcode::INSERT, i32x4, i32x4, a, emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, 100), 1);
+			a = emit_value(function, IR_Opcode::INSERT, i32x4, i32x4, a, emit_value(function, IR_Opcode::CONSTANT, i32, i32, invalid_register, invalid_register, -3), 3);
+
+			uint32_t	product = emit_value(function, IR_Opcode::MUL, i32x4, i32x4, seven, a, 0);
+			uint32_t	difference = emit_value(function, IR_Opcode::SUB, i32x4, i32x4, product, a, 0);
+			uint32_t	negation = emit_value(function, IR_Opcode::NEG, i32x4, i32x4, difference, invalid_register, 0);
+			uint32_t	shuffle = emit_value(function, IR_Opcode::SHUFFLE, i32x4, i32x4, negation, invalid_register, 0x2301);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i32x4, i32, shuffle, invalid_register, 0), i32, 1.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i32x4, i32, shuffle, invalid_register, 2), i32, 1.0);
+		}
+		// i16x8
+		{
+			uint32_t	a = emit_value(function, IR_Opcode::CONVERT, i16x8, i16x8, emit_value(function, IR_Opcode::CONSTANT, i16, i16, invalid_register, invalid_register, 300), invalid_register, 0);
+
+			a = emit_value(function, IR_Opcode::INSERT, i16x8, i16x8, a, emit_value(function, IR_Opcode::CONSTANT, i16, i16, invalid_register, invalid_register, -7), 5);
+
+			uint32_t	square = emit_value(function, IR_Opcode::MUL, i16x8, i16x8, a, a, 0);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i16x8, i16, square, invalid_register, 0), i16, 1.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i16x8, i16, square, invalid_register, 5), i16, 1.0);
+		}
+		// i8x16
+		{
+			uint32_t	a = emit_value(function, IR_Opcode::CONVERT, i8x16, i8x16, emit_value(function, IR_Opcode::CONSTANT, i8, i8, invalid_register, invalid_register, 127), invalid_register, 0);
+			uint32_t	three = emit_value(function, IR_Opcode::CONSTANT, i8x16, i8x16, invalid_register, invalid_register, 3);
+			uint32_t	sum_of_bytes = emit_value(function, IR_Opcode::ADD, i8x16, i8x16, a, three, 0);
+			uint32_t	insertion = emit_value(function, IR_Opcode::INSERT, i8x16, i8x16, sum_of_bytes, emit_value(function, IR_Opcode::CONSTANT, i8, i8, invalid_register, invalid_register, 1), 9);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i8x16, i8, insertion, invalid_register, 9), i8, 1.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i8x16, i8, insertion, invalid_register, 15), i8, 1.0);
+		}
+		// i64x2
+		{
+			uint32_t	a = emit_value(function, IR_Opcode::CONVERT, i64x2, i64x2, emit_value(function, IR_Opcode::CONSTANT, i64, i64, invalid_register, invalid_register, 0x100000001), invalid_register, 0);
+
+			a = emit_value(function, IR_Opcode::INSERT, i64x2, i64x2, a, emit_value(function, IR_Opcode::CONSTANT, i64, i64, invalid_register, invalid_register, -2), 1);
+
+			uint32_t	sum_of_qwords = emit_value(function, IR_Opcode::ADD, i64x2, i64x2, a, a, 0);
+			uint32_t	negation = emit_value(function, IR_Opcode::NEG, i64x2, i64x2, sum_of_qwords, invalid_register, 0);
+			uint32_t	swap = emit_value(function, IR_Opcode::SHUFFLE, i64x2, i64x2, negation, invalid_register, 0x01);
+
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i64x2, i64, swap, invalid_register, 0), i64, 1.0);
+			accumulate(emit_value(function, IR_Opcode::EXTRACT, i64x2, i64, swap, invalid_register, 1), i64, 1.0);
+		}
+		emit_value(function, IR_Opcode::RETURN, i32, i32, sum, invalid_register, 0);
+	}
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(ir.functions); i++) {
+		end_block(ir.functions[i]);
+	}
+	ir.entry_point_function = 1;
+
+	float		a[4] = { 1.5f, 1.5f, 2.0f, 1.5f };
+	float		scaled[4];
+	double		b[2] = { 2.5, -1.25 };
+	double		swapped[2];
+	int32_t		expected_result = 0;
+
+	for (int i = 0; i < 4; i++) {
+		scaled[3 - i] = -(a[i] * 4.0f - 0.5f) / a[i];
+	}
+	for (int i = 0; i < 2; i++) {
+		swapped[1 - i] = -(b[i] * 4.0 - b[i]);
+	}
+	expected_result += (int32_t)(scaled[0] * 1000.0f) + (int32_t)(scaled[1] * 100.0f);
+	expected_result += (int32_t)(swapped[0] * 10.0) + (int32_t)(swapped[1] * 100.0) + (int32_t)(2.5 * 1000.0);
+	expected_result += -(100 * 7 - 100) + -(-3 * 7 + 3);
+	expected_result += (int16_t)(300 * 300) + (int16_t)(-7 * -7);
+	expected_result += 1 + (int8_t)(127 + 3);
+	expected_result += (int32_t)(4) + (int32_t)(-(int64_t)0x200000002);
+
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == expected_result);
+}
+
+void test_profile_guided_optimization()
+{
+	using namespace f;
+
+	// classify :: (x : i32) -> i32 { if x % 16 == 0 { return x * 3; } return x + 1; }
+	// main :: () -> i32 { s := 0; i := 0; do { s += classify(i); i += 1; } while i < 100; return s; }
+	const char* profile_path = "profile_test.fprof";
+
+	auto build_program = [](IR& ir) {
+		Register::Type type = Register::Type::DWORD;
+
+		fstd::memory::reserve_array(ir.functions, 2);
+		{
+			// x: 0, r: 1, sixteen: 2, zero: 3, c: 4 (BYTE), three: 5, t: 6, one: 7, u: 8
+			IR_Function& function = add_function(ir, 1, 9, type);
+
+			function.registers[4] = Register::Type::BYTE;
+			emit(function, IR_Opcode::CONSTANT, type, 2, invalid_register, invalid_register, 16);
+			emit(function, IR_Opcode::REM, type, 1, 0, 2, 0);
+			emit(function, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, 0);
+			emit(function, IR_Opcode::EQUAL, type, 4, 1, 3, 0);
+			emit_branch(function, IR_Opcode::BRANCH, 4, 1, 2);
+			end_block(function);
+			emit(function, IR_Opcode::CONSTANT, type, 5, invalid_register, invalid_register, 3);
+			emit(function, IR_Opcode::MUL, type, 6, 0, 5, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 6, invalid_register, 0);
+			end_block(function);
+			emit(function, IR_Opcode::CONSTANT, type, 7, invalid_register, invalid_register, 1);
+			emit(function, IR_Opcode::ADD, type, 8, 0, 7, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 8, invalid_register, 0);
+			end_block(function);
+		}
+		{
+			// i: 0, s: 1, one: 2, n: 3, r: 4, c: 5 (BYTE)
+			IR_Function& function = add_function(ir, 0, 6, type);
+
+			function.registers[5] = Register::Type::BYTE;
+			fstd::memory::array_push_back(function.operand_lists, 0u);
+			emit(function, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, 0);
+			emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 0);
+			emit(function, IR_Opcode::CONSTANT, type, 2, invalid_register, invalid_register, 1);
+			emit(function, IR_Opcode::CONSTANT, type, 3, invalid_register, invalid_register, 100);
+			emit_branch(function, IR_Opcode::JUMP, invalid_register, 1, 0);
+			end_block(function);
+			emit(function, IR_Opcode::CALL, type, 4, 0, 1, 0);
+			emit(function, IR_Opcode::ADD, type, 1, 1, 4, 0);
+			emit(function, IR_Opcode::ADD, type, 0, 0, 2, 0);
+			emit(function, IR_Opcode::LESS, type, 5, 0, 3, 0);
+			emit_branch(function, IR_Opcode::BRANCH, 5, 1, 2);
+			end_block(function);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 1, invalid_register, 0);
+			end_block(function);
+		}
+		ir.entry_point_function = 1;
+	};
+
+	int32_t expected_result = 0;
+
+	for (int32_t i = 0; i < 100; i++) {
+		expected_result += i % 16 == 0 ? i * 3 : i + 1;
+	}
+
+	JIT_x64_backend::initialize_backend();
+
+	// Instrumented build, counters are written in the profile when main returns
+	{
+		IR ir;
+
+		build_program(ir);
+		globals.configuration.profile_generate = profile_path;
+		optimize(ir);
+		fstd::core::Assert(fstd::memory::get_array_size(ir.profile_counters) == 3 && ir.profile_counters[2] == 12);
+		fstd::core::Assert(JIT_x64_backend::run(ir) == expected_result);
+		globals.configuration.profile_generate = nullptr;
+	}
+
+	// Build with the profile, x * 3 is executed 7 times out of 100
+	{
+		IR ir;
+
+		build_program(ir);
+		globals.configuration.profile_use = profile_path;
+		optimize(ir);
+		globals.configuration.profile_use = nullptr;
+
+		IR_Function& classify = ir.functions[0];
+
+		fstd::core::Assert(classify.has_profile && ir.functions[1].has_profile);
+		fstd::core::Assert(classify.blocks[0].count == 100 && classify.blocks[0].taken_count == 7);
+
+		// The frequent return follows the test, the other one is moved after it
+		fstd::core::Assert(classify.blocks[1].count == 93 && classify.blocks[2].count == 7);
+		fstd::core::Assert(classify.instructions[classify.blocks[1].first_instruction + classify.blocks[1].nb_instructions - 2].opcode == IR_Opcode::ADD);
+
+		// classify is called 100 times and main once
+		fstd::core::Assert(fstd::memory::get_array_size(ir.code_order) == 2 && ir.code_order[0] == 0 && ir.code_order[1] == 1);
+		fstd::core::Assert(JIT_x64_backend::run(ir) == expected_result);
+	}
+}
+
+void test_hot_cold_splitting()
+{
+	using namespace f;
+
+	// fail :: (code : i32) -> i32 no_return { return code * 2; }	(stands for an exit)
+	// check :: (x : i32) -> i32 no_inline { if x > 100 { return fail(x); } return x + 1; }
+	// main :: () -> i32 { return check(41) + check(200); }
+	auto build_program = [](IR& ir) {
+		Register::Type type = Register::Type::DWORD;
+
+		fstd::memory::reserve_array(ir.functions, 3);
+		{
+			// code: 0, two: 1, r: 2
+			IR_Function& function = add_function(ir, 1, 3, type);
+
+			function.is_no_return = true;
+			emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 2);
+			emit(function, IR_Opcode::MUL, type, 2, 0, 1, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 2, invalid_register, 0);
+			end_block(function);
+		}
+		{
+			// x: 0, hundred: 1, c: 2 (BYTE), r: 3, one: 4, t: 5
+			IR_Function& function = add_function(ir, 1, 6, type);
+
+			function.inlining = Inlining::NEVER;
+			function.registers[2] = Register::Type::BYTE;
+			fstd::memory::array_push_back(function.operand_lists, 0u);
+			emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 100);
+			emit(function, IR_Opcode::LESS, type, 2, 1, 0, 0);
+			emit_branch(function, IR_Opcode::BRANCH, 2, 1, 2);
+			end_block(function);
+			emit(function, IR_Opcode::CALL, type, 3, 0, 1, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 3, invalid_register, 0);
+			end_block(function);
+			emit(function, IR_Opcode::CONSTANT, type, 4, invalid_register, invalid_register, 1);
+			emit(function, IR_Opcode::ADD, type, 5, 0, 4, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 5, invalid_register, 0);
+			end_block(function);
+		}
+		{
+			// a: 0, b: 1, r1: 2, r2: 3, s: 4
+			IR_Function& function = add_function(ir, 0, 5, type);
+
+			fstd::memory::array_push_back(function.operand_lists, 0u);
+			fstd::memory::array_push_back(function.operand_lists, 1u);
+			emit(function, IR_Opcode::CONSTANT, type, 0, invalid_register, invalid_register, 41);
+			emit(function, IR_Opcode::CONSTANT, type, 1, invalid_register, invalid_register, 200);
+			emit(function, IR_Opcode::CALL, type, 2, 0, 1, 1);
+			emit(function, IR_Opcode::CALL, type, 3, 1, 1, 1);
+			emit(function, IR_Opcode::ADD, type, 4, 2, 3, 0);
+			emit(function, IR_Opcode::RETURN, type, invalid_register, 4, invalid_register, 0);
+			end_block(function);
+		}
+		ir.entry_point_function = 2;
+	};
+
+	JIT_x64_backend::initialize_backend();
+
+	// Only the block that calls fail is cold
+	{
+		IR								ir;
+		x64::Function_Code				program_code;
+		fstd::memory::Array<uint32_t>	function_offsets;
+
+		defer{
+			x64::release(program_code);
+			fstd::memory::release(function_offsets);
+		};
+
+		build_program(ir);
+		optimize(ir);
+
+		const IR_Function&	check = ir.functions[1];
+		uint32_t			nb_cold_blocks = 0;
+
+		for (size_t i = 0; i < fstd::memory::get_array_size(check.blocks); i++) {
+			const IR_Basic_Block& block = check.blocks[i];
+
+			nb_cold_blocks += block.is_cold;
+			fstd::core::Assert(block.is_cold == (check.instructions[block.first_instruction].opcode == IR_Opcode::CALL));
+		}
+		fstd::core::Assert(nb_cold_blocks == 1);
+
+		x64::generate_program_code(ir, program_code, function_offsets, 1);
+
+		// fail and the cold block of check are after the hot code of all functions
+		uint32_t cold_part_start = program_code.cold_part_start;
+
+		fstd::core::Assert(cold_part_start < fstd::memory::get_array_size(program_code.code));
+		fstd::core::Assert(function_offsets[0] >= cold_part_start);
+		fstd::core::Assert(function_offsets[1] < cold_part_start && function_offsets[2] < cold_part_start);
+
+		// The cold part of check has its own unwind entry, with the frame of the prologue
+		uint32_t nb_cold_entries = 0;
+
+		for (size_t i = 0; i < fstd::memory::get_array_size(program_code.unwind_entries); i++) {
+			const x64::Unwind_Entry& unwind_entry = program_code.unwind_entries[i];
+
+			fstd::core::Assert(i == 0 || program_code.unwind_entries[i - 1].function_end <= unwind_entry.function_start);
+			if (unwind_entry.function_start >= cold_part_start && unwind_entry.function_start != function_offsets[0]) {
+				fstd::core::Assert(program_code.unwind_info[unwind_entry.unwind_info_offset + 1] == 0); // Size of the prologue
+				nb_cold_entries++;
+			}
+		}
+		fstd::core::Assert(nb_cold_entries == 1);
+	}
+
+	// Branches between the parts are resolved, both paths of check are executed
+	{
+		IR ir;
+
+		build_program(ir);
+		optimize(ir);
+		fstd::core::Assert(JIT_x64_backend::run(ir) == 42 + 400);
+	}
+}
+
+void test_switch_lowering()
+{
+	using namespace f;
+
+	IR							ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\switch.f)");
+	fstd::language::string_view	dense_name;
+
+	fstd::language::assign(dense_name, (uint8_t*)"dense");
+
+	// Only dense has a jump table, sparse is a decision tree of comparisons
+	for (size_t i = 0; i < fstd::memory::get_array_size(ir.functions); i++) {
+		const IR_Function&	function = ir.functions[i];
+		uint32_t			nb_switches = 0;
+
+		for (size_t j = 0; j < fstd::memory::get_array_size(function.instructions); j++) {
+			nb_switches += function.instructions[j].opcode == IR_Opcode::SWITCH;
+		}
+		fstd::core::Assert(nb_switches == (fstd::language::are_equals(function.declaration->name.text, dense_name) ? 1u : 0u));
+	}
+
+	optimize(ir);
+
+	// Holes of the table and values out of its bounds go to the default case
+	JIT_x64_backend::initialize_backend();
+	fstd::core::Assert(JIT_x64_backend::run(ir) == 187 + 54321);
+}
+
+#if defined(FSTD_OS_WINDOWS)
+// Data of the section that contains RVA in an image that isn't loaded
+static const uint8_t* get_image_data(const fstd::memory::Array<uint8_t>& image, uint32_t RVA)
+{
+	const uint8_t*				data = fstd::memory::get_array_data(image);
+	const IMAGE_NT_HEADERS64*	nt_header = (const IMAGE_NT_HEADERS64*)(data + ((const IMAGE_DOS_HEADER*)data)->e_lfanew);
+	const IMAGE_SECTION_HEADER*	sections = IMAGE_FIRST_SECTION(nt_header);
+
+	for (WORD i = 0; i < nt_header->FileHeader.NumberOfSections; i++) {
+		if (RVA >= sections[i].VirtualAddress && RVA < sections[i].VirtualAddress + sections[i].Misc.VirtualSize) {
+			return data + sections[i].PointerToRawData + (RVA - sections[i].VirtualAddress);
+		}
+	}
+	fstd::core::Assert(false);
+	return nullptr;
+}
+
+void test_PE_image()
+{
+	using namespace f;
+
+	IR								ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\pe\imports.f)");
+	fstd::memory::Array<uint8_t>	image;
+	x64::Function_Code				program_code;
+	fstd::memory::Array<uint32_t>	function_offsets;
+
+	defer{
+		fstd::memory::release(image);
+		x64::release(program_code);
+		fstd::memory::release(function_offsets);
+	};
+
+	PE_x64_backend::initialize_backend();
+	PE_x64_backend::build_image(ir, image);
+
+	const uint8_t*					data = fstd::memory::get_array_data(image);
+	const IMAGE_DOS_HEADER*			dos_header = (const IMAGE_DOS_HEADER*)data;
+	const IMAGE_NT_HEADERS64*		nt_header = (const IMAGE_NT_HEADERS64*)(data + dos_header->e_lfanew);
+	const IMAGE_OPTIONAL_HEADER64&	optional_header = nt_header->OptionalHeader;
+	const IMAGE_SECTION_HEADER*		sections = IMAGE_FIRST_SECTION(nt_header);
+	const char*						section_names[] = { ".text", ".rdata", ".idata", ".pdata" };
+
+	fstd::core::Assert(dos_header->e_magic == IMAGE_DOS_SIGNATURE && nt_header->Signature == IMAGE_NT_SIGNATURE);
+	fstd::core::Assert(nt_header->FileHeader.Machine == IMAGE_FILE_MACHINE_AMD64 && optional_header.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC);
+	fstd::core::Assert(nt_header->FileHeader.NumberOfSections == 4);
+	fstd::core::Assert((const uint8_t*)(sections + 4) - data <= (ptrdiff_t)optional_header.SizeOfHeaders);
+	fstd::core::Assert(optional_header.SizeOfHeaders % optional_header.FileAlignment == 0);
+
+	// Sections follow each other in the file and in memory with their alignments, the file ends with the last one
+	uint32_t file_end = optional_header.SizeOfHeaders;
+	uint32_t memory_end = optional_header.SizeOfHeaders;
+
+	for (uint32_t i = 0; i < 4; i++) {
+		const IMAGE_SECTION_HEADER& section = sections[i];
+
+		fstd::core::Assert(strncmp((const char*)section.Name, section_names[i], IMAGE_SIZEOF_SHORT_NAME) == 0);
+		fstd::core::Assert(section.PointerToRawData % optional_header.FileAlignment == 0 && section.SizeOfRawData % optional_header.FileAlignment == 0);
+		fstd::core::Assert(section.VirtualAddress % optional_header.SectionAlignment == 0);
+		fstd::core::Assert(section.PointerToRawData >= file_end && section.VirtualAddress >= memory_end);
+		fstd::core::Assert(section.Misc.VirtualSize <= section.SizeOfRawData);
+		file_end = section.PointerToRawData + section.SizeOfRawData;
+		memory_end = section.VirtualAddress + section.Misc.VirtualSize;
+	}
+	fstd::core::Assert(file_end == fstd::memory::get_array_size(image));
+	fstd::core::Assert(optional_header.SizeOfImage % optional_header.SectionAlignment == 0 && optional_header.SizeOfImage >= memory_end);
+	fstd::core::Assert(optional_header.AddressOfEntryPoint >= sections[0].VirtualAddress
+		&& optional_header.AddressOfEntryPoint < sections[0].VirtualAddress + sections[0].Misc.VirtualSize);
+	fstd::core::Assert(optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress == sections[2].VirtualAddress);
+	fstd::core::Assert(optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress == sections[3].VirtualAddress);
+
+	// Libraries and their functions are sorted by name, hints are the indices of names in the export tables
+	const IMAGE_IMPORT_DESCRIPTOR*	descriptors = (const IMAGE_IMPORT_DESCRIPTOR*)get_image_data(image, optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress);
+	const char*						library_names[] = { "kernel32.dll", "user32.dll" };
+	const char*						function_names[][5] = {
+		{ "Beep", "ExitProcess", "GetCurrentProcessId", "GetTickCount", nullptr },
+		{ "MessageBeep", nullptr },
+	};
+
+	fstd::core::Assert(optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size == 3 * sizeof(IMAGE_IMPORT_DESCRIPTOR));
+	fstd::core::Assert(optional_header.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].VirtualAddress == descriptors[0].FirstThunk);
+	fstd::core::Assert(descriptors[2].OriginalFirstThunk == 0 && descriptors[2].Name == 0 && descriptors[2].FirstThunk == 0);
+
+	for (uint32_t i = 0; i < 2; i++) {
+		const IMAGE_IMPORT_DESCRIPTOR&	descriptor = descriptors[i];
+		const ULONGLONG*				ILT = (const ULONGLONG*)get_image_data(image, descriptor.OriginalFirstThunk);
+		const ULONGLONG*				IAT = (const ULONGLONG*)get_image_data(image, descriptor.FirstThunk);
+		HMODULE							library = LoadLibraryExA(library_names[i], nullptr, LOAD_LIBRARY_AS_DATAFILE | LOAD_LIBRARY_AS_IMAGE_RESOURCE);
+
+		fstd::core::Assert(strcmp((const char*)get_image_data(image, descriptor.Name), library_names[i]) == 0);
+		fstd::core::Assert(library != nullptr);
+
+		defer{ FreeLibrary(library); };
+
+		const uint8_t*					base = (const uint8_t*)((ULONG_PTR)library & ~(ULONG_PTR)3);
+		const IMAGE_NT_HEADERS64*		library_header = (const IMAGE_NT_HEADERS64*)(base + ((const IMAGE_DOS_HEADER*)base)->e_lfanew);
+		const IMAGE_EXPORT_DIRECTORY*	export_directory = (const IMAGE_EXPORT_DIRECTORY*)(base + library_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
+		const DWORD*					export_names = (const DWORD*)(base + export_directory->AddressOfNames);
+		uint32_t						j = 0;
+
+		for (; function_names[i][j] != nullptr; j++) {
+			const IMAGE_IMPORT_BY_NAME* hint_name = (const IMAGE_IMPORT_BY_NAME*)get_image_data(image, (uint32_t)ILT[j]);
+
+			fstd::core::Assert(ILT[j] == IAT[j] && (ILT[j] & IMAGE_ORDINAL_FLAG64) == 0);
+			fstd::core::Assert(strcmp((const char*)hint_name->Name, function_names[i][j]) == 0);
+			fstd::core::Assert(hint_name->Hint < export_directory->NumberOfNames);
+			fstd::core::Assert(strcmp((const char*)(base + export_names[hint_name->Hint]), function_names[i][j]) == 0);
+		}
+		fstd::core::Assert(ILT[j] == 0 && IAT[j] == 0);
+	}
+
+	// Calls of imported functions read the IAT entry of their function
+	x64::generate_program_code(ir, program_code, function_offsets);
+
+	const uint8_t*	code = data + sections[0].PointerToRawData;
+	uint32_t		nb_imported_calls = 0;
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(program_code.fixups); i++) {
+		const x64::Code_Fixup& fixup = program_code.fixups[i];
+
+		if (fixup.kind == x64::Code_Fixup::Kind::IMPORTED_FUNCTION) {
+			const fstd::language::string_view&	name = ir.functions[fixup.index].imported_function->function->name.text;
+			int32_t								displacement;
+			uint32_t							IAT_entry_RVA;
+			const IMAGE_IMPORT_BY_NAME*			hint_name;
+
+			memcpy(&displacement, code + fixup.displacement_offset, sizeof(displacement));
+			IAT_entry_RVA = sections[0].VirtualAddress + fixup.instruction_end + displacement;
+			hint_name = (const IMAGE_IMPORT_BY_NAME*)get_image_data(image, (uint32_t)*(const ULONGLONG*)get_image_data(image, IAT_entry_RVA));
+
+			fstd::core::Assert(strlen((const char*)hint_name->Name) == fstd::language::get_string_size(name));
+			fstd::core::Assert(memcmp(hint_name->Name, fstd::language::to_utf8(name), fstd::language::get_string_size(name)) == 0);
+			nb_imported_calls++;
+		}
+	}
+	fstd::core::Assert(nb_imported_calls == 5);
+}
+#endif
+
+void test_ELF_image()
+{
+	using namespace f;
+
+	// switch.f has jump tables, a function that returns the address of a string is added for literals
+	IR								ir = generate_ir_of_file((uint8_t*)u8R"(.\tests\ir\switch.f)");
+	fstd::memory::Array<uint8_t>	image;
+	x64::Function_Code				program_code;
+	fstd::memory::Array<uint32_t>	function_offsets;
+	fstd::memory::Array<uint8_t>	expected_code;
+
+	defer{
+		fstd::memory::release(image);
+		x64::release(program_code);
+		fstd::memory::release(function_offsets);
+		fstd::memory::release(expected_code);
+	};
+
+	const Register::Type	pointer_type = Register::Type::QWORD | Register::Type::POINTER;
+	uint32_t				message = add_string_literal(ir.read_only_data, (const uint8_t*)"hello", 5);
+	{
+		IR_Function& function = add_function(ir, 0, 1, pointer_type);
+
+		emit(function, IR_Opcode::ADDRESS, pointer_type, 0, invalid_register, invalid_register, 0).immediate.index = message;
+		emit(function, IR_Opcode::RETURN, pointer_type, invalid_register, 0, invalid_register, 0);
+		end_block(function);
+	}
+	layout_read_only_data(ir.read_only_data);
+
+	ELF_x64_backend::initialize_backend();
+	ELF_x64_backend::build_image(ir, image);
+
+	// Same code as in the image, the red zone is used on Linux
+	x64::generate_program_code(ir, program_code, function_offsets, 0, true);
+
+	const uint8_t*				data = fstd::memory::get_array_data(image);
+	const ELF64_Header&			header = *(const ELF64_Header*)data;
+	const ELF64_Program_Header*	program_headers = (const ELF64_Program_Header*)(data + header.program_header_offset);
+	const ELF64_Program_Header&	text = program_headers[0];
+	const ELF64_Program_Header&	rodata = program_headers[1];
+	uint8_t						expected_ident[16] = { 0x7f, 'E', 'L', 'F', ELF_CLASS_64, ELF_DATA_LITTLE_ENDIAN, ELF_VERSION_CURRENT, ELF_OS_ABI_SYSV };
+
+	fstd::core::Assert(fstd::system::memory_compare(header.ident, expected_ident, sizeof(expected_ident)));
+	fstd::core::Assert(header.type == ELF_TYPE_EXECUTABLE && header.machine == ELF_MACHINE_X86_64 && header.version == ELF_VERSION_CURRENT);
+	fstd::core::Assert(header.header_size == sizeof(ELF64_Header) && header.program_header_offset == sizeof(ELF64_Header));
+	fstd::core::Assert(header.program_header_entry_size == sizeof(ELF64_Program_Header) && header.program_header_count == 2);
+	fstd::core::Assert(header.section_header_offset == 0 && header.section_header_count == 0);
+
+	// The text segment is mapped from the beginning of the file, rodata from the next page, the file ends with it
+	fstd::core::Assert(text.type == PROGRAM_HEADER_LOAD && text.flags == (SEGMENT_FLAG_READ | SEGMENT_FLAG_EXECUTE));
+	fstd::core::Assert(text.offset == 0 && text.file_size == text.memory_size && text.alignment == 4096);
+	fstd::core::Assert(rodata.type == PROGRAM_HEADER_LOAD && rodata.flags == SEGMENT_FLAG_READ);
+	fstd::core::Assert(rodata.offset % 4096 == 0 && rodata.offset >= text.file_size && rodata.file_size == rodata.memory_size);
+	fstd::core::Assert(rodata.virtual_address - text.virtual_address == rodata.offset && rodata.alignment == 4096);
+	fstd::core::Assert(rodata.offset + rodata.file_size == fstd::memory::get_array_size(image));
+
+	// Entry point: sub rsp, 32; call main; mov edi, eax; mov eax, 231 (exit_group); syscall
+	uint64_t		entry_point_offset = header.entry - text.virtual_address;
+	const uint8_t*	entry_point = data + entry_point_offset;
+	uint8_t			expected_entry_point[] = { 0x48, 0x83, 0xec, 0x20, 0xe8, 0x00, 0x00, 0x00, 0x00, 0x89, 0xc7, 0xb8, 0xe7, 0x00, 0x00, 0x00, 0x0f, 0x05 };
+	uint64_t		code_offset = (entry_point_offset + sizeof(expected_entry_point) + 15) & ~15ull; // Functions are 16 bytes aligned
+	int32_t			call_displacement;
+
+	fstd::core::Assert(entry_point_offset == sizeof(ELF64_Header) + 2 * sizeof(ELF64_Program_Header));
+	fstd::core::Assert(fstd::system::memory_compare(entry_point, expected_entry_point, 5));
+	fstd::core::Assert(fstd::system::memory_compare(entry_point + 9, expected_entry_point + 9, sizeof(expected_entry_point) - 9));
+	memcpy(&call_displacement, entry_point + 5, sizeof(call_displacement));
+	fstd::core::Assert(entry_point_offset + 9 + call_displacement == code_offset + function_offsets[ir.entry_point_function]);
+	fstd::core::Assert(text.file_size == code_offset + fstd::memory::get_array_size(program_code.code));
+
+	// The code is the one of the code generator, with the displacements of literals and jump tables
+	uint64_t	code_address = text.virtual_address + code_offset;
+	uint32_t	nb_literal_fixups = 0;
+	uint32_t	nb_jump_table_fixups = 0;
+
+	fstd::memory::resize_array(expected_code, fstd::memory::get_array_size(program_code.code));
+	memcpy(fstd::memory::get_array_data(expected_code), fstd::memory::get_array_data(program_code.code), fstd::memory::get_array_size(program_code.code));
+
+	for (size_t i = 0; i < fstd::memory::get_array_size(program_code.fixups); i++) {
+		const x64::Code_Fixup&	fixup = program_code.fixups[i];
+		int32_t					displacement;
+		uint64_t				target_address;
+
+		memcpy(&displacement, data + code_offset + fixup.displacement_offset, sizeof(displacement));
+		memcpy(fstd::memory::get_array_data(expected_code) + fixup.displacement_offset, &displacement, sizeof(displacement));
+		target_address = code_address + fixup.instruction_end + displacement;
+
+		if (fixup.kind == x64::Code_Fixup::Kind::LITERAL) {
+			const Literal& literal = ir.read_only_data.literals[fixup.index];
+
+			fstd::core::Assert(target_address == rodata.virtual_address + literal.RVA);
+			fstd::core::Assert(fstd::system::memory_compare(data + rodata.offset + literal.RVA, fstd::memory::get_array_data(ir.read_only_data.section) + literal.RVA, literal.size));
+			nb_literal_fixups += fixup.index == message;
+		}
+		else {
+			fstd::core::Assert(fixup.kind == x64::Code_Fixup::Kind::JUMP_TABLE);
+
+			// Entries are offsets of the targets from the table, which is after the literals
+			fstd::core::Assert(target_address % 8 == 0 && target_address >= rodata.virtual_address + ir.read_only_data.current_RVA);
+			for (size_t j = 0; j < fstd::memory::get_array_size(program_code.jump_table_entries); j++) {
+				const x64::Jump_Table_Entry&	entry = program_code.jump_table_entries[j];
+				int64_t							offset;
+
+				if (entry.first_entry == fixup.index) {
+					memcpy(&offset, data + rodata.offset + (target_address - rodata.virtual_address) + (j - entry.first_entry) * sizeof(int64_t), sizeof(offset));
+					fstd::core::Assert(target_address + offset == code_address + entry.target);
+				}
+			}
+			nb_jump_table_fixups++;
+		}
+	}
+	fstd::core::Assert(nb_literal_fixups == 1 && nb_jump_table_fixups == 1);
+	fstd::core::Assert(fstd::system::memory_compare(data + code_offset, fstd::memory::get_array_data(expected_code), fstd::memory::get_array_size(expected_code)));
+	fstd::core::Assert(fstd::system::memory_compare(data + rodata.offset + ir.read_only_data.literals[message].RVA, "hello", 6));
+}
+
+void test_array()
+{
+	fstd::memory::Array<uint32_t>	array;
+	fstd::memory::Array<uint32_t>	preallocated;
+	size_t							nb_reallocations = 0;
+
+	defer{
+		fstd::memory::release(array);
+		fstd::memory::release(preallocated);
+	};
+
+	// The reserved size grows geometrically, pushing n elements doesn't reallocate n times
+	for (uint32_t i = 0; i < 10000; i++) {
+		size_t reserved = fstd::memory::get_array_reserved(array);
+
+		fstd::memory::array_push_back(array, i);
+		nb_reallocations += fstd::memory::get_array_reserved(array) != reserved;
+	}
+	fstd::core::Assert(nb_reallocations < 32);
+	fstd::core::Assert(fstd::memory::get_array_size(array) == 10000);
+	for (uint32_t i = 0; i < 10000; i++) {
+		fstd::core::Assert(array[i] == i);
+	}
+
+	// Appended elements follow the existing ones
+	uint32_t values[3] = { 1, 2, 3 };
+
+	fstd::memory::resize_array(array, 2);
+	fstd::memory::array_append(array, values, 3);
+	fstd::core::Assert(fstd::memory::get_array_size(array) == 5);
+	fstd::core::Assert(array[2] == 1 && array[4] == 3);
+
+	// An array can be appended to itself, even when it is reallocated by the append
+	fstd::memory::Array<uint32_t> full;
+
+	defer{ fstd::memory::release(full); };
+
+	fstd::memory::reserve_array(full, 5);
+	fstd::memory::array_append(full, array);
+	fstd::memory::array_append(full, full);
+	fstd::core::Assert(fstd::memory::get_array_reserved(full) > 5);
+	fstd::core::Assert(fstd::memory::get_array_size(full) == 10);
+	fstd::core::Assert(full[2] == 1 && full[4] == 3 && full[5] == 0 && full[9] == 3);
+
+	// Emplaced elements are built in place, at the end of the array
+	uint32_t* emplaced = fstd::memory::array_emplace_back(array, 2);
+
+	emplaced[0] = 42;
+	emplaced[1] = 43;
+	fstd::core::Assert(fstd::memory::get_array_size(array) == 7);
+	fstd::core::Assert(*fstd::memory::get_array_last_element(array) == 43);
+
+	// Unchecked versions don't reallocate, pointers on elements stay valid
+	fstd::memory::reserve_array(preallocated, 4);
+
+	uint32_t* first = fstd::memory::array_emplace_back_unchecked(preallocated);
+
+	*first = 7;
+	fstd::memory::array_push_back_unchecked(preallocated, 8u);
+	fstd::memory::array_emplace_back_unchecked(preallocated, 2);
+	fstd::core::Assert(fstd::memory::get_array_reserved(preallocated) == 4);
+	fstd::core::Assert(fstd::memory::get_array_data(preallocated) == first);
+	fstd::core::Assert(preallocated[0] == 7 && preallocated[1] == 8);
+}
+
+void test_hash_table()
+{
+	fstd::memory::Hash_Table<uint16_t, fstd::language::string, void*>	hash_table;
+	uint64_t	hash;
+	uint16_t	short_hash;
+
+	fstd::memory::hash_table_init(hash_table, &fstd::language::are_equals);
+
+	fstd::language::string		string_type;
+	fstd::language::string		user_type_with_hash_of_string; // We will use the same hash than for the string_type to create a collision
+
+	defer{
+		release(string_type);
+		release(user_type_with_hash_of_string);
+		fstd::memory::hash_table_release(hash_table);
+	};
+
+	fstd::language::assign(string_type, (uint8_t*)u8"fstd::language::string");
+	fstd::language::assign(user_type_with_hash_of_string, (uint8_t*)u8"User_Type_With_Hash_Of_String");
+
+	hash = SpookyHash::Hash64((const void*)fstd::language::to_utf8(string_type), fstd::language::get_string_size(string_type), 0);
+	short_hash = hash & 0xffff;
+	void* value;
+
+	value = (void*)0x01;
+	fstd::memory::hash_table_insert(hash_table, short_hash, string_type, value);
+	value = (void*)0x02;
+	fstd::memory::hash_table_insert(hash_table, short_hash, user_type_with_hash_of_string, value);
+
+	// Check if we can correctly get back both value even with the hash collision
+	fstd::core::Assert((void*)*fstd::memory::hash_table_get(hash_table, short_hash, string_type) == (void*)0x01);
+	fstd::core::Assert((void*)*fstd::memory::hash_table_get(hash_table, short_hash, user_type_with_hash_of_string) == (void*)0x02);
+
+	// Test if we iterate the right number of times with iterators
+	size_t count = 0;
+	auto it = fstd::memory::hash_table_begin(hash_table);
+	auto it_end = fstd::memory::hash_table_end(hash_table);
+	for (; !fstd::memory::equals<uint16_t, fstd::language::string, void*, 512>(it, it_end); fstd::memory::hash_table_next<uint16_t, fstd::language::string, void*, 512>(it))
+	{
+		count++;
+		void** value = fstd::memory::hash_table_get<uint16_t, fstd::language::string, void*, 512>(it);
+		fstd::core::Assert(*value != nullptr);
+	}
+	fstd::core::Assert(count == 2);
+}
+
+void test_number_to_string()
+{
+	fstd::language::string f_string;
+	fstd::language::string result_string;
+
+	// Decimal
+	fstd::language::to_string(5'624'978'429, f_string); // 64 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"5624978429");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string(-5'624'978'429, f_string); // 64 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"-5624978429");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string(2'147'483'647, f_string); // 32 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"2147483647");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string(-2'147'483'647, f_string); // 32 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"-2147483647");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	// Hexadecimal
+	fstd::language::to_string((uint64_t)5'624'978'429, 16, f_string); // 64 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"000000014F465BFD");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string((uint64_t)-5'624'978'429, 16, f_string); // 64 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"FFFFFFFEB0B9A403");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string((uint32_t)2'147'483'647, 16, f_string); // 32 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"7FFFFFFF");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string((uint32_t)-2'147'483'647, 16, f_string); // 32 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"80000001");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	fstd::language::to_string((uint32_t)-1, 16, f_string); // 32 bits
+	fstd::language::assign(result_string, (uint8_t*)u8"FFFFFFFF");
+	fstd::core::Assert(fstd::language::are_equals(f_string, result_string));
+	release(f_string);
+
+	// Tester également avec des nombres signé aux limites
+	// Egalement avec des doubles
+}
+
+int main(int ac, char** av)
+{
+	// Begin Initialization ================================================
+
+	fstd::system::allocator_initialize();
+
+#if defined(FSTD_OS_WINDOWS)
+	fstd::os::windows::enable_default_console_configuration();
+	defer{ fstd::os::windows::close_console(); };
+#endif
+
+#if defined(TRACY_ENABLE)
+	tracy::SetThreadName("Main thread");
+#endif
+
+	initialize_globals();
+
+#if defined(FSTD_DEBUG)
+	fstd::core::set_log_level(*globals.logger, fstd::core::Log_Level::verbose);
+#endif
+
+	FrameMark;
+	// End Initialization ================================================
+
+#if 1
+#	if !defined(_DEBUG)
+	test_integer_to_string_performances();
+#	endif
+#endif
+	test_unicode_code_point_convversions();
+	test_unicode_string_convversions();
+	test_AST_operator_precedence();
+	test_constant_folding();
+	test_type_table();
+	test_compile_time_execution();
+	test_modules();
+	test_ir_generation();
+	test_ir_optimization();
+	test_register_allocation();
+	test_x64_encoder();
+	test_branch_relaxation();
+	test_jit_execution();
+	test_mixed_arithmetic();
+	test_parallel_code_generation();
+	test_read_only_data();
+	test_import_hoisting();
+	test_function_frames();
+	test_inlining();
+	test_division_by_constants();
+	test_unsigned_conversions();
+	test_vector_types();
+	test_profile_guided_optimization();
+	test_hot_cold_splitting();
+	test_switch_lowering();
+#if defined(FSTD_OS_WINDOWS)
+	test_PE_image();
+#endif
+	test_ELF_image();
+	test_array();
 	test_hash_table();
 	test_number_to_string();
 
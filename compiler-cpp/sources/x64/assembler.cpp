@@ -0,0 +1,236 @@
+#include "assembler.hpp"
+
+#include "../globals.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <fstd/system/allocator.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <limits>
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::x64;
+
+static uint8_t compute_branch_size(Mnemonic mnemonic, Condition_Code condition, uint8_t distance_size)
+{
+	memory::Array<uint8_t>	scratch;
+
+	defer {
+		memory::release(scratch);
+	};
+
+	return encode_instruction(scratch, mnemonic, condition, make_relative(0, distance_size)).size;
+}
+
+// Positions at the beginning of the cold part are in the cold part, branches inserted at the same offset before it
+// aren't
+static bool is_in_cold_part(const Assembler& assembler, const Label_Position& position)
+{
+	const Label_Position& cold_part = assembler.cold_part;
+
+	return cold_part.offset != unbound_label
+		&& (position.offset > cold_part.offset
+			|| (position.offset == cold_part.offset && position.nb_branches_before >= cold_part.nb_branches_before));
+}
+
+static uint32_t get_relaxed_position_offset(const Assembler& assembler, const Label_Position& position)
+{
+	// Branches inserted at the same offset than the position but after it are after the position
+	if (position.nb_branches_before == 0) {
+		return position.offset;
+	}
+
+	const Label_Reference& branch = assembler.branches[position.nb_branches_before - 1];
+	return branch.relaxed_offset + branch.instruction_size + (position.offset - branch.offset);
+}
+
+uint32_t f::x64::create_label(Assembler& assembler)
+{
+	memory::array_push_back(assembler.labels, Label_Position{ unbound_label, 0 });
+	return (uint32_t)memory::get_array_size(assembler.labels) - 1;
+}
+
+void f::x64::bind_label(Assembler& assembler, uint32_t label)
+{
+	core::Assert(assembler.labels[label].offset == unbound_label); // A label can only be bound once
+
+	assembler.labels[label].offset = (uint32_t)memory::get_array_size(assembler.code);
+	assembler.labels[label].nb_branches_before = (uint32_t)memory::get_array_size(assembler.branches);
+}
+
+void f::x64::emit_branch(Assembler& assembler, Mnemonic mnemonic, Condition_Code condition, uint32_t label)
+{
+	core::Assert(mnemonic == Mnemonic::JMP || mnemonic == Mnemonic::JCC || mnemonic == Mnemonic::CALL);
+
+	Label_Reference	branch;
+
+	branch.offset = (uint32_t)memory::get_array_size(assembler.code);
+	branch.label = label;
+	branch.mnemonic = mnemonic;
+	branch.condition = condition;
+	branch.distance_size = mnemonic == Mnemonic::CALL ? 4 : 1; // There is no call rel8
+	branch.instruction_size = compute_branch_size(mnemonic, condition, branch.distance_size);
+	branch.relaxed_offset = 0;
+	memory::array_push_back(assembler.branches, branch);
+}
+
+void f::x64::begin_cold_part(Assembler& assembler)
+{
+	core::Assert(assembler.cold_part.offset == unbound_label); // The code has only two parts
+
+	assembler.cold_part.offset = (uint32_t)memory::get_array_size(assembler.code);
+	assembler.cold_part.nb_branches_before = (uint32_t)memory::get_array_size(assembler.branches);
+}
+
+bool f::x64::crosses_parts(const Assembler& assembler, uint32_t branch)
+{
+	if (assembler.cold_part.offset == unbound_label) {
+		return false;
+	}
+
+	bool is_branch_cold = branch >= assembler.cold_part.nb_branches_before;
+	bool is_label_cold = is_in_cold_part(assembler, assembler.labels[assembler.branches[branch].label]);
+
+	return is_branch_cold != is_label_cold;
+}
+
+void f::x64::relax_branches(Assembler& assembler, memory::Array<uint8_t>& output)
+{
+	ZoneScopedN("f::x64::relax_branches");
+
+	size_t					nb_branches = memory::get_array_size(assembler.branches);
+	memory::Array<uint32_t>	inserted_sizes;	// inserted_sizes[i] is the size of branches before the branch i
+
+	defer {
+		memory::release(inserted_sizes);
+	};
+
+	for (size_t i = 0; i < memory::get_array_size(assembler.labels); i++) {
+		if (assembler.labels[i].offset == unbound_label) {
+			report_error(Compiler_Error::internal_error, "x64 assembler: a label is used but never bound.");
+		}
+	}
+
+	// The distance between the parts isn't known yet
+	for (size_t i = 0; i < nb_branches; i++) {
+		Label_Reference& branch = assembler.branches[i];
+
+		if (branch.distance_size != 4 && crosses_parts(assembler, (uint32_t)i)) {
+			branch.distance_size = 4;
+			branch.instruction_size = compute_branch_size(branch.mnemonic, branch.condition, branch.distance_size);
+		}
+	}
+
+	memory::resize_array(inserted_sizes, nb_branches + 1);
+
+	bool grown = true;
+	while (grown) {
+		ZoneScopedN("Relaxation pass");
+
+		grown = false;
+
+		inserted_sizes[0] = 0;
+		for (size_t i = 0; i < nb_branches; i++) {
+			inserted_sizes[i + 1] = inserted_sizes[i] + assembler.branches[i].instruction_size;
+		}
+
+		for (size_t i = 0; i < nb_branches; i++) {
+			Label_Reference&		branch = assembler.branches[i];
+			const Label_Position&	label = assembler.labels[branch.label];
+
+			if (branch.distance_size == 4) {
+				continue;
+			}
+
+			// Branches that grow during this pass are only taken into account by the next one, that checks again
+			// every short branch
+			int64_t branch_address = (int64_t)branch.offset + inserted_sizes[i];
+			int64_t label_address = (int64_t)label.offset + inserted_sizes[label.nb_branches_before];
+			int64_t distance = label_address - (branch_address + branch.instruction_size);
+
+			if (distance < std::numeric_limits<int8_t>::min() || distance > std::numeric_limits<int8_t>::max()) {
+				branch.distance_size = 4;
+				branch.instruction_size = compute_branch_size(branch.mnemonic, branch.condition, branch.distance_size);
+				grown = true;
+			}
+		}
+	}
+
+	// Write the final code
+	{
+		ZoneScopedN("Write relaxed code");
+
+		size_t	output_start = memory::get_array_size(output);
+		size_t	code_size = memory::get_array_size(assembler.code);
+		size_t	copied = 0;
+
+		memory::reserve_array(output, output_start + code_size + inserted_sizes[nb_branches]);
+
+		for (size_t i = 0; i < nb_branches; i++) {
+			Label_Reference&		branch = assembler.branches[i];
+			const Label_Position&	label = assembler.labels[branch.label];
+
+			memory::array_copy(output, memory::get_array_size(output), memory::get_array_data(assembler.code) + copied, branch.offset - copied);
+			copied = branch.offset;
+
+			branch.relaxed_offset = (uint32_t)(memory::get_array_size(output) - output_start);
+
+			int64_t label_address = (int64_t)label.offset + inserted_sizes[label.nb_branches_before];
+			Encoded_Instruction encoded_instruction = encode_instruction(output, branch.mnemonic, branch.condition, make_relative(label_address - branch.relaxed_offset, branch.distance_size));
+
+			core::Assert(encoded_instruction.size == branch.instruction_size);
+		}
+		memory::array_copy(output, memory::get_array_size(output), memory::get_array_data(assembler.code) + copied, code_size - copied);
+	}
+}
+
+uint32_t f::x64::get_relaxed_offset(const Assembler& assembler, uint32_t offset)
+{
+	// Last branch inserted before the offset
+	size_t first = 0;
+	size_t last = memory::get_array_size(assembler.branches);
+	while (first < last) {
+		size_t middle = first + (last - first) / 2;
+
+		if (assembler.branches[middle].offset <= offset) {
+			first = middle + 1;
+		}
+		else {
+			last = middle;
+		}
+	}
+
+	if (first == 0) {
+		return offset;
+	}
+
+	const Label_Reference& branch = assembler.branches[first - 1];
+	return branch.relaxed_offset + branch.instruction_size + (offset - branch.offset);
+}
+
+uint32_t f::x64::get_relaxed_label_offset(const Assembler& assembler, uint32_t label)
+{
+	return get_relaxed_position_offset(assembler, assembler.labels[label]);
+}
+
+uint32_t f::x64::get_relaxed_cold_part_offset(const Assembler& assembler)
+{
+	if (assembler.cold_part.offset == unbound_label) {
+		return unbound_label;
+	}
+	return get_relaxed_position_offset(assembler, assembler.cold_part);
+}
+
+void f::x64::release(Assembler& assembler)
+{
+	memory::release(assembler.code);
+	memory::release(assembler.labels);
+	memory::release(assembler.branches);
+	assembler.cold_part = { unbound_label, 0 };
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "encoder.hpp"
+
+// Labels and branch relaxation
+//
+// Instructions are encoded directly in Assembler::code, but branches to labels (jmp, jcc and call) are only
+// recorded in a list of label references, their position is the offset in code where they will be inserted.
+// Labels can be used before being bound, addresses are only resolved by relax_branches.
+//
+// Branches start optimistic with their rel8 form (calls only have a rel32 form), then the ones whose target is out
+// of range are grown to rel32. Growing a branch moves the code after it, so passes are repeated until no branch
+// changes. Branches only grow, so it terminates.
+//
+// The code can be split in a hot part and a cold part, that are placed apart once relaxed. Branches between both
+// parts are rel32, their displacement is computed as if the parts were contiguous and has to be patched.
+
+namespace f
+{
+	namespace x64
+	{
+		static constexpr uint32_t unbound_label = 0xffffffff;
+
+		struct Label_Position
+		{
+			uint32_t	offset;				// In Assembler::code, unbound_label until the label is bound
+			uint32_t	nb_branches_before;	// Number of branches inserted before the label
+		};
+
+		struct Label_Reference
+		{
+			uint32_t		offset;				// In Assembler::code, the branch is inserted before the instruction at this offset
+			uint32_t		label;
+			Mnemonic		mnemonic;
+			Condition_Code	condition;
+			uint8_t			distance_size;		// 1 (rel8) or 4 (rel32)
+			uint8_t			instruction_size;	// With the current distance_size
+			uint32_t		relaxed_offset;		// In the final code, set by relax_branches
+		};
+
+		struct Assembler
+		{
+			fstd::memory::Array<uint8_t>			code;		// Without branches to labels
+			fstd::memory::Array<Label_Position>		labels;
+			fstd::memory::Array<Label_Reference>	branches;	// Sorted by offset
+			Label_Position							cold_part = { unbound_label, 0 };	// Beginning of the cold part, unbound if the code isn't split
+		};
+
+		uint32_t create_label(Assembler& assembler);
+
+		// The label is at the end of the code emitted so far
+		void bind_label(Assembler& assembler, uint32_t label);
+
+		// mnemonic is JMP, JCC or CALL
+		void emit_branch(Assembler& assembler, Mnemonic mnemonic, Condition_Code condition, uint32_t label);
+
+		inline void emit_branch(Assembler& assembler, Mnemonic mnemonic, uint32_t label) {
+			emit_branch(assembler, mnemonic, Condition_Code::O, label);
+		}
+
+		// The code emitted after this call is the cold part, the code before it is the hot part
+		void begin_cold_part(Assembler& assembler);
+
+		// The branch and its label aren't in the same part
+		bool crosses_parts(const Assembler& assembler, uint32_t branch);
+
+		// Compute the size of branches, then append the final code (with branches) to output.
+		// Every label that is referenced has to be bound.
+		void relax_branches(Assembler& assembler, fstd::memory::Array<uint8_t>& output);
+
+		// Offsets in the final code (from the beginning of the code appended by relax_branches), to patch instructions
+		// and get addresses of functions once branches are relaxed
+		uint32_t get_relaxed_offset(const Assembler& assembler, uint32_t offset);
+		uint32_t get_relaxed_label_offset(const Assembler& assembler, uint32_t label);
+		uint32_t get_relaxed_cold_part_offset(const Assembler& assembler);	// unbound_label if the code isn't split
+
+		void release(Assembler& assembler);
+	}
+}
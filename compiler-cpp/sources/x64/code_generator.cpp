@@ -0,0 +1,2179 @@
+#include "code_generator.hpp"
+
+#include "../globals.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <fstd/system/allocator.hpp>
+#include <fstd/system/thread.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <limits>
+
+// R11 is never allocated, it is used for moves between memory locations, for operands of instructions that
+// have fixed registers (div) and to handle bits of floating points.
+//
+// XMM registers don't have a scratch register, the few cases that need one use a scratch slot of the frame. The
+// scratch slot is 16 bytes aligned when vectors need it, so it can be an operand of SSE instructions.
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::x64;
+
+static constexpr Physical_Register	scratch_register = Physical_Register::R11;
+static constexpr uint32_t			nb_shadow_arguments = 4;	// Space reserved by the caller for the 4 arguments in registers
+static constexpr uint32_t			function_alignment = 16;
+static constexpr uint8_t			padding_byte = 0xcc;		// int3
+static constexpr uint32_t			max_nb_code_generation_workers = 16;
+static constexpr uint32_t			red_zone_size = 128;
+
+static const Physical_Register non_volatile_registers[] = {
+	Physical_Register::RBX, Physical_Register::RBP, Physical_Register::RSI, Physical_Register::RDI,
+	Physical_Register::R12, Physical_Register::R13, Physical_Register::R14, Physical_Register::R15,
+	Physical_Register::XMM6, Physical_Register::XMM7, Physical_Register::XMM8, Physical_Register::XMM9,
+	Physical_Register::XMM10, Physical_Register::XMM11, Physical_Register::XMM12, Physical_Register::XMM13,
+	Physical_Register::XMM14, Physical_Register::XMM15,
+};
+
+struct Generator
+{
+	const IR*					ir;
+	const IR_Function*			function;
+	const Register_Allocation*	allocation;
+	Assembler					assembler;
+	memory::Array<Code_Fixup>	fixups;				// Offsets in assembler.code, until branches are relaxed
+	memory::Array<uint32_t>		block_labels;
+	uint32_t					epilogue_label;
+	memory::Array<Jump_Table_Entry>	jump_table_entries;	// Targets are labels until branches are relaxed
+	bool						use_red_zone;
+	memory::Array<uint32_t>		constant_definitions;	// Per register, the CONSTANT instruction that is its only definition, or invalid_register
+
+	// Frame, offsets are from RSP once the prologue is done
+	uint32_t					nb_pushed_registers;
+	uint32_t					frame_size;			// Substracted to RSP after the pushes, keeps RSP 16 bytes aligned for calls
+	bool						is_in_red_zone;		// The frame is below RSP, frame_size is 0
+	int32_t						first_saved_xmm_offset;
+	int32_t						first_stack_slot_offset;
+	int32_t						scratch_slot_offset;
+	int32_t						incoming_arguments_offset;
+
+	// Unwind codes of the prologue, in the order of its instructions
+	memory::Array<uint16_t>		unwind_codes;
+	uint8_t						prologue_size;
+};
+
+inline uint32_t align(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline bool is_xmm_register(Physical_Register physical_register)
+{
+	return physical_register >= Physical_Register::XMM0;
+}
+
+// Arithmetic on BYTE and WORD values is done on 32 bits, so upper bits of registers are undefined
+inline uint8_t get_operation_size(Register::Type type)
+{
+	return get_register_size(type) == 8 ? 8 : 4;
+}
+
+inline Encoded_Instruction emit(Generator& generator, Mnemonic mnemonic)
+{
+	return encode_instruction(generator.assembler.code, mnemonic);
+}
+
+inline Encoded_Instruction emit(Generator& generator, Mnemonic mnemonic, const Operand& a)
+{
+	return encode_instruction(generator.assembler.code, mnemonic, a);
+}
+
+inline Encoded_Instruction emit(Generator& generator, Mnemonic mnemonic, const Operand& a, const Operand& b)
+{
+	return encode_instruction(generator.assembler.code, mnemonic, a, b);
+}
+
+inline Encoded_Instruction emit(Generator& generator, Mnemonic mnemonic, const Operand& a, const Operand& b, const Operand& c)
+{
+	return encode_instruction(generator.assembler.code, mnemonic, a, b, c);
+}
+
+inline Encoded_Instruction emit(Generator& generator, Mnemonic mnemonic, Condition_Code condition, const Operand& a)
+{
+	return encode_instruction(generator.assembler.code, mnemonic, condition, a);
+}
+
+static void add_fixup(Generator& generator, Code_Fixup::Kind kind, uint32_t instruction_start, uint8_t displacement_offset, uint8_t instruction_size, uint32_t index)
+{
+	Code_Fixup fixup;
+
+	fixup.kind = kind;
+	fixup.displacement_offset = instruction_start + displacement_offset;
+	fixup.instruction_end = instruction_start + instruction_size;
+	fixup.index = index;
+	memory::array_push_back(generator.fixups, fixup);
+}
+
+//=============================================================================
+// Locations
+
+static Operand get_operand(const Generator& generator, const Location& location, uint8_t size)
+{
+	switch (location.kind)
+	{
+	case Location::Kind::REGISTER:
+		return make_register(location.physical_register, size);
+	case Location::Kind::STACK_SLOT:
+		return make_memory(Physical_Register::RSP, generator.first_stack_slot_offset + 8 * (int32_t)location.index, size);
+	case Location::Kind::INCOMING_ARGUMENT:
+		return make_memory(Physical_Register::RSP, generator.incoming_arguments_offset + 8 * (int32_t)location.index, size);
+	case Location::Kind::OUTGOING_ARGUMENT:
+		return make_memory(Physical_Register::RSP, 8 * (int32_t)location.index, size);
+	default:
+		report_error(Compiler_Error::internal_error, "x64 code generator: a value is used without location.");
+		return Operand{};
+	}
+}
+
+// Operands are read after the moves before the instruction, the destination is written after them
+inline Location get_operand_location(const Generator& generator, uint32_t virtual_register, uint32_t instruction_index)
+{
+	return get_location(*generator.allocation, virtual_register, get_use_position(instruction_index) + 1);
+}
+
+inline Location get_destination_location(const Generator& generator, uint32_t virtual_register, uint32_t instruction_index)
+{
+	return get_location(*generator.allocation, virtual_register, get_definition_position(instruction_index));
+}
+
+// Operands and destinations of instructions that require a register always get one from the allocator
+static Physical_Register get_register(const Location& location)
+{
+	if (location.kind != Location::Kind::REGISTER) {
+		report_error(Compiler_Error::internal_error, "x64 code generator: an operand that requires a register is in memory.");
+	}
+	return location.physical_register;
+}
+
+static void emit_move(Generator& generator, const Location& source, const Location& destination, Register::Type type)
+{
+	if (source == destination) {
+		return;
+	}
+
+	if (is_vector(type)) {
+		if (source.kind == Location::Kind::REGISTER && destination.kind == Location::Kind::REGISTER) {
+			emit(generator, Mnemonic::MOVAPS, make_register(destination.physical_register), make_register(source.physical_register));
+		}
+		else if (source.kind == Location::Kind::REGISTER || destination.kind == Location::Kind::REGISTER) {
+			// Stack slots are only 8 bytes aligned
+			emit(generator, Mnemonic::MOVUPS, get_operand(generator, destination, 16), get_operand(generator, source, 16));
+		}
+		else {
+			for (int32_t offset = 0; offset < 16; offset += 8) {
+				Operand source_half = get_operand(generator, source, 8);
+				Operand destination_half = get_operand(generator, destination, 8);
+
+				source_half.displacement += offset;
+				destination_half.displacement += offset;
+				emit(generator, Mnemonic::MOV, make_register(scratch_register), source_half);
+				emit(generator, Mnemonic::MOV, destination_half, make_register(scratch_register));
+			}
+		}
+		return;
+	}
+
+	bool		floating_point = is_floating_point(type);
+	uint8_t		memory_size = floating_point ? (uint8_t)get_register_size(type) : 8;	// Stack slots are 8 bytes
+
+	if (source.kind == Location::Kind::REGISTER && destination.kind == Location::Kind::REGISTER) {
+		emit(generator, floating_point ? Mnemonic::MOVAPS : Mnemonic::MOV, make_register(destination.physical_register), make_register(source.physical_register));
+	}
+	else if (source.kind == Location::Kind::REGISTER || destination.kind == Location::Kind::REGISTER) {
+		Mnemonic mnemonic = floating_point ? (memory_size == 4 ? Mnemonic::MOVSS : Mnemonic::MOVSD) : Mnemonic::MOV;
+
+		emit(generator, mnemonic, get_operand(generator, destination, memory_size), get_operand(generator, source, memory_size));
+	}
+	else {
+		// Bits of floating points are copied as integers
+		emit(generator, Mnemonic::MOV, make_register(scratch_register, memory_size), get_operand(generator, source, memory_size));
+		emit(generator, Mnemonic::MOV, get_operand(generator, destination, memory_size), make_register(scratch_register, memory_size));
+	}
+}
+
+static void emit_moves(Generator& generator, const Move_Range& range)
+{
+	for (uint32_t i = 0; i < range.count; i++) {
+		const Move& move = generator.allocation->moves[range.first + i];
+
+		emit_move(generator, move.source, move.destination, move.type);
+	}
+}
+
+//=============================================================================
+// Frame
+
+// Windows x64 unwind codes (https://learn.microsoft.com/en-us/cpp/build/exception-handling-x64)
+enum class Unwind_Operation : uint8_t
+{
+	PUSH_NONVOL = 0,
+	ALLOC_LARGE = 1,
+	ALLOC_SMALL = 2,
+	SAVE_XMM128 = 8,
+	SAVE_XMM128_FAR = 9,
+};
+
+static constexpr uint8_t	unwind_info_version = 1;
+static constexpr uint32_t	max_small_allocation = 128;
+static constexpr uint32_t	max_large_allocation = 512 * 1024 - 8;	// Scaled by 8 in a 16 bits slot
+
+static void compute_frame(Generator& generator)
+{
+	const IR_Function&	function = *generator.function;
+	uint32_t			nb_saved_xmm_registers = 0;
+	bool				has_calls = false;
+	uint32_t			max_nb_arguments = 0;
+	bool				needs_scratch_slot = false;
+	bool				needs_vector_scratch_slot = false;
+	bool				has_pushes = false;
+
+	generator.nb_pushed_registers = 0;
+	for (Physical_Register physical_register : non_volatile_registers) {
+		if (generator.allocation->used_registers & get_register_mask(physical_register)) {
+			if (is_xmm_register(physical_register)) {
+				nb_saved_xmm_registers++;
+			}
+			else {
+				generator.nb_pushed_registers++;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(function.instructions); i++) {
+		const IR_Instruction& instruction = function.instructions[i];
+
+		if (is_call(instruction.opcode)) {
+			uint32_t nb_arguments = instruction.opcode == IR_Opcode::CALL_INDIRECT ? instruction.operands[1] - 1 : instruction.operands[1];
+
+			has_calls = true;
+			max_nb_arguments = nb_arguments > max_nb_arguments ? nb_arguments : max_nb_arguments;
+		}
+		else if (is_vector(instruction.type)) {
+			needs_vector_scratch_slot |= instruction.opcode == IR_Opcode::SUB || instruction.opcode == IR_Opcode::DIV
+				|| instruction.opcode == IR_Opcode::NEG || instruction.opcode == IR_Opcode::INSERT;
+		}
+		else if ((instruction.opcode == IR_Opcode::SUB || instruction.opcode == IR_Opcode::DIV) && is_floating_point(instruction.type)) {
+			needs_scratch_slot = true;
+		}
+		else if (instruction.opcode == IR_Opcode::CONVERT && is_floating_point(function.registers[instruction.operands[0]])
+			&& get_register_size(instruction.type) == 8 && has_flag(instruction.type, Register::Type::UNSIGNED)) {
+			needs_scratch_slot = true; // Holds 2^63
+		}
+		else if (instruction.opcode == IR_Opcode::DIV || instruction.opcode == IR_Opcode::REM) {
+			has_pushes = true; // RAX and RDX are saved on the stack
+		}
+	}
+
+	uint32_t outgoing_arguments_size = 0;
+	if (has_calls) {
+		outgoing_arguments_size = 8 * (max_nb_arguments > nb_shadow_arguments ? max_nb_arguments : nb_shadow_arguments);
+	}
+
+	uint32_t saved_xmm_registers_start = align(outgoing_arguments_size, 16);
+	uint32_t stack_slots_start = saved_xmm_registers_start + 16 * nb_saved_xmm_registers;
+	uint32_t locals_end = stack_slots_start + 8 * generator.allocation->nb_stack_slots;
+
+	generator.first_saved_xmm_offset = (int32_t)saved_xmm_registers_start;
+	generator.first_stack_slot_offset = (int32_t)stack_slots_start;
+	generator.scratch_slot_offset = 0;
+	if (needs_vector_scratch_slot) {
+		locals_end = align(locals_end, 16);
+		generator.scratch_slot_offset = (int32_t)locals_end;
+		locals_end += 16;
+	}
+	else if (needs_scratch_slot) {
+		generator.scratch_slot_offset = (int32_t)locals_end;
+		locals_end += 8;
+	}
+
+	// RSP is 16 bytes aligned before the call of the function, so it is 8 bytes off once the return address and the
+	// registers are pushed. The alignment is only needed for calls, saves of XMM registers and the vector scratch slot.
+	// In the red zone the frame keeps the same offset from the aligned RSP of the caller, so it stays aligned.
+	uint32_t pushed_size = 8 + 8 * generator.nb_pushed_registers;
+
+	generator.frame_size = locals_end;
+	if (has_calls || nb_saved_xmm_registers || needs_vector_scratch_slot) {
+		generator.frame_size = align(locals_end + pushed_size, 16) - pushed_size;
+	}
+
+	// Nothing can overwrite the red zone of a leaf function, so its frame doesn't have to be allocated. Pushes done
+	// in the body of the function would overwrite it.
+	generator.is_in_red_zone = generator.use_red_zone && has_calls == false && has_pushes == false && generator.frame_size && generator.frame_size <= red_zone_size;
+	if (generator.is_in_red_zone) {
+		generator.first_saved_xmm_offset -= (int32_t)generator.frame_size;
+		generator.first_stack_slot_offset -= (int32_t)generator.frame_size;
+		generator.scratch_slot_offset -= (int32_t)generator.frame_size;
+		generator.frame_size = 0;
+	}
+
+	generator.incoming_arguments_offset = (int32_t)(generator.frame_size + pushed_size);
+}
+
+inline void add_unwind_code(Generator& generator, Unwind_Operation operation, uint8_t operation_info)
+{
+	uint8_t code_offset = (uint8_t)memory::get_array_size(generator.assembler.code);	// End of the instruction
+
+	memory::array_push_back(generator.unwind_codes, (uint16_t)(code_offset | ((uint8_t)operation << 8) | (operation_info << 12)));
+}
+
+inline void add_unwind_slot(Generator& generator, uint16_t value)
+{
+	memory::array_push_back(generator.unwind_codes, value);
+}
+
+// The unwind codes of an instruction are pushed after it, they are reversed when UNWIND_INFO is written
+static void emit_prologue(Generator& generator)
+{
+	int32_t saved_xmm_offset = generator.first_saved_xmm_offset;
+
+	for (Physical_Register physical_register : non_volatile_registers) {
+		if (is_xmm_register(physical_register) || (generator.allocation->used_registers & get_register_mask(physical_register)) == 0) {
+			continue;
+		}
+
+		emit(generator, Mnemonic::PUSH, make_register(physical_register));
+		add_unwind_code(generator, Unwind_Operation::PUSH_NONVOL, get_register_encoding(physical_register));
+	}
+
+	if (generator.frame_size) {
+		emit(generator, Mnemonic::SUB, make_register(Physical_Register::RSP), make_immediate(generator.frame_size));
+		if (generator.frame_size <= max_small_allocation) {
+			add_unwind_code(generator, Unwind_Operation::ALLOC_SMALL, (uint8_t)(generator.frame_size / 8 - 1));
+		}
+		else if (generator.frame_size <= max_large_allocation) {
+			add_unwind_slot(generator, (uint16_t)(generator.frame_size / 8));
+			add_unwind_code(generator, Unwind_Operation::ALLOC_LARGE, 0);
+		}
+		else {
+			add_unwind_slot(generator, (uint16_t)(generator.frame_size >> 16));
+			add_unwind_slot(generator, (uint16_t)generator.frame_size);
+			add_unwind_code(generator, Unwind_Operation::ALLOC_LARGE, 1);
+		}
+	}
+
+	for (Physical_Register physical_register : non_volatile_registers) {
+		if (is_xmm_register(physical_register) == false || (generator.allocation->used_registers & get_register_mask(physical_register)) == 0) {
+			continue;
+		}
+
+		emit(generator, Mnemonic::MOVAPS, make_memory(Physical_Register::RSP, saved_xmm_offset, 16), make_register(physical_register));
+		if (saved_xmm_offset / 16 <= 0xffff) {
+			add_unwind_slot(generator, (uint16_t)(saved_xmm_offset / 16));
+			add_unwind_code(generator, Unwind_Operation::SAVE_XMM128, get_register_encoding(physical_register));
+		}
+		else {
+			add_unwind_slot(generator, (uint16_t)(saved_xmm_offset >> 16));
+			add_unwind_slot(generator, (uint16_t)saved_xmm_offset);
+			add_unwind_code(generator, Unwind_Operation::SAVE_XMM128_FAR, get_register_encoding(physical_register));
+		}
+		saved_xmm_offset += 16;
+	}
+
+	generator.prologue_size = (uint8_t)memory::get_array_size(generator.assembler.code);
+}
+
+// The epilogue is add rsp then pops, it is what the unwinder of Windows expects
+static void emit_epilogue(Generator& generator)
+{
+	int32_t saved_xmm_offset = generator.first_saved_xmm_offset;
+
+	for (Physical_Register physical_register : non_volatile_registers) {
+		if (is_xmm_register(physical_register) == false || (generator.allocation->used_registers & get_register_mask(physical_register)) == 0) {
+			continue;
+		}
+
+		emit(generator, Mnemonic::MOVAPS, make_register(physical_register), make_memory(Physical_Register::RSP, saved_xmm_offset, 16));
+		saved_xmm_offset += 16;
+	}
+
+	if (generator.frame_size) {
+		emit(generator, Mnemonic::ADD, make_register(Physical_Register::RSP), make_immediate(generator.frame_size));
+	}
+
+	for (size_t i = sizeof(non_volatile_registers) / sizeof(non_volatile_registers[0]); i > 0; i--) {
+		Physical_Register physical_register = non_volatile_registers[i - 1];
+
+		if (is_xmm_register(physical_register) || (generator.allocation->used_registers & get_register_mask(physical_register)) == 0) {
+			continue;
+		}
+
+		emit(generator, Mnemonic::POP, make_register(physical_register));
+	}
+	emit(generator, Mnemonic::RET);
+}
+
+// UNWIND_INFO, unwind codes are in the reverse order of the prologue. Code that isn't after the prologue has a
+// prologue_size of 0, all codes are unwound.
+static void write_unwind_info(const Generator& generator, Function_Code& function_code, uint32_t function_start, uint32_t function_end, uint8_t prologue_size)
+{
+	size_t		nb_codes = memory::get_array_size(generator.unwind_codes);
+	uint32_t	unwind_info_offset = (uint32_t)memory::get_array_size(function_code.unwind_info);
+	uint8_t		header[4];
+
+	header[0] = unwind_info_version;	// No flags, there isn't any exception handler
+	header[1] = prologue_size;
+	header[2] = (uint8_t)nb_codes;
+	header[3] = 0;						// No frame register
+
+	memory::array_copy(function_code.unwind_info, unwind_info_offset, header, sizeof(header));
+	for (size_t i = nb_codes; i > 0; i--) {
+		uint16_t code = generator.unwind_codes[i - 1];
+
+		memory::array_push_back(function_code.unwind_info, (uint8_t)code);
+		memory::array_push_back(function_code.unwind_info, (uint8_t)(code >> 8));
+	}
+	// The array of codes has an even number of slots
+	while (memory::get_array_size(function_code.unwind_info) % 4) {
+		memory::array_push_back(function_code.unwind_info, (uint8_t)0);
+	}
+
+	Unwind_Entry unwind_entry;
+
+	unwind_entry.function_start = function_start;
+	unwind_entry.function_end = function_end;
+	unwind_entry.unwind_info_offset = unwind_info_offset;
+	memory::array_push_back(function_code.unwind_entries, unwind_entry);
+}
+
+//=============================================================================
+// Instructions
+
+// Bits of a lane repeated to fill 64 bits
+static uint64_t get_lane_pattern(Register::Type lane_type, IR_Immediate value)
+{
+	uint8_t		size = (uint8_t)get_register_size(lane_type);
+	uint64_t	bits = (uint64_t)value.integer;
+
+	if (has_flag(lane_type, Register::Type::FLOAT)) {
+		float real = (float)value.real; // FLOAT constants are stored as double
+		uint32_t real_bits;
+
+		system::memory_copy(&real_bits, &real, sizeof(real));
+		bits = real_bits;
+	}
+
+	for (; size < 8; size *= 2) {
+		bits &= ((uint64_t)1 << (8 * size)) - 1;
+		bits |= bits << (8 * size);
+	}
+	return bits;
+}
+
+static void emit_constant(Generator& generator, const IR_Instruction& instruction, const Location& destination)
+{
+	if (is_vector(instruction.type)) {
+		uint64_t bits = get_lane_pattern(get_lane_type(instruction.type), instruction.immediate);
+
+		if (destination.kind == Location::Kind::REGISTER && bits == 0) {
+			emit(generator, Mnemonic::XORPS, make_register(destination.physical_register), make_register(destination.physical_register));
+			return;
+		}
+
+		emit(generator, Mnemonic::MOV, make_register(scratch_register), make_immediate((int64_t)bits));
+		if (destination.kind == Location::Kind::REGISTER) {
+			emit(generator, Mnemonic::MOVQ, make_register(destination.physical_register), make_register(scratch_register));
+			emit(generator, Mnemonic::PUNPCKLQDQ, make_register(destination.physical_register), make_register(destination.physical_register));
+		}
+		else {
+			for (int32_t offset = 0; offset < 16; offset += 8) {
+				Operand half = get_operand(generator, destination, 8);
+
+				half.displacement += offset;
+				emit(generator, Mnemonic::MOV, half, make_register(scratch_register));
+			}
+		}
+		return;
+	}
+
+	if (is_floating_point(instruction.type)) {
+		uint8_t		size = (uint8_t)get_register_size(instruction.type);
+		uint64_t	bits = 0;
+
+		if (size == 4) {
+			float value = (float)instruction.immediate.real; // FLOAT constants are stored as double
+
+			system::memory_copy(&bits, &value, sizeof(value));
+		}
+		else {
+			system::memory_copy(&bits, &instruction.immediate.real, sizeof(bits));
+		}
+
+		if (destination.kind == Location::Kind::REGISTER && bits == 0) {
+			emit(generator, Mnemonic::XORPS, make_register(destination.physical_register), make_register(destination.physical_register));
+			return;
+		}
+
+		emit(generator, Mnemonic::MOV, make_register(scratch_register, size), make_immediate((int64_t)bits));
+		if (destination.kind == Location::Kind::REGISTER) {
+			emit(generator, size == 4 ? Mnemonic::MOVD : Mnemonic::MOVQ, make_register(destination.physical_register), make_register(scratch_register, size));
+		}
+		else {
+			emit(generator, Mnemonic::MOV, get_operand(generator, destination, size), make_register(scratch_register, size));
+		}
+		return;
+	}
+
+	uint8_t	size = get_operation_size(instruction.type);
+	int64_t	value = instruction.immediate.integer;
+	bool	fits_in_32_bits = size == 4 || (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max());
+
+	if (destination.kind == Location::Kind::REGISTER) {
+		if (value == 0) {
+			emit(generator, Mnemonic::XOR, make_register(destination.physical_register, 4), make_register(destination.physical_register, 4));
+		}
+		else if (size == 8 && value > 0 && value <= std::numeric_limits<uint32_t>::max()) {
+			emit(generator, Mnemonic::MOV, make_register(destination.physical_register, 4), make_immediate(value)); // Zero extended
+		}
+		else {
+			emit(generator, Mnemonic::MOV, make_register(destination.physical_register, size), make_immediate(value));
+		}
+	}
+	else if (fits_in_32_bits) {
+		emit(generator, Mnemonic::MOV, get_operand(generator, destination, size), make_immediate(value));
+	}
+	else {
+		emit(generator, Mnemonic::MOV, make_register(scratch_register), make_immediate(value));
+		emit(generator, Mnemonic::MOV, get_operand(generator, destination, 8), make_register(scratch_register));
+	}
+}
+
+// The scalar is put in all lanes of the vector, it already has the type of lanes
+static void emit_broadcast(Generator& generator, Physical_Register source, Register::Type source_type, Physical_Register destination, Register::Type vector_type)
+{
+	Register::Type lane_type = get_lane_type(vector_type);
+
+	if (source_type != lane_type) {
+		report_error(Compiler_Error::internal_error, "x64 code generator: a scalar is converted to a vector that doesn't have lanes of its type.");
+	}
+
+	Operand vector = make_register(destination);
+
+	if (has_flag(lane_type, Register::Type::FLOAT)) {
+		if (source != destination) {
+			emit(generator, Mnemonic::MOVAPS, vector, make_register(source));
+		}
+		emit(generator, Mnemonic::SHUFPS, vector, vector, make_immediate(0));
+		return;
+	}
+	else if (has_flag(lane_type, Register::Type::DOUBLE)) {
+		if (source != destination) {
+			emit(generator, Mnemonic::MOVAPS, vector, make_register(source));
+		}
+		emit(generator, Mnemonic::SHUFPD, vector, vector, make_immediate(0));
+		return;
+	}
+
+	switch (get_register_size(lane_type))
+	{
+	case 8:
+		emit(generator, Mnemonic::MOVQ, vector, make_register(source));
+		emit(generator, Mnemonic::PUNPCKLQDQ, vector, vector);
+		break;
+	case 4:
+		emit(generator, Mnemonic::MOVD, vector, make_register(source, 4));
+		emit(generator, Mnemonic::PSHUFD, vector, vector, make_immediate(0));
+		break;
+	case 2:
+		emit(generator, Mnemonic::MOVD, vector, make_register(source, 4));
+		emit(generator, Mnemonic::PSHUFLW, vector, vector, make_immediate(0));
+		emit(generator, Mnemonic::PSHUFD, vector, vector, make_immediate(0));
+		break;
+	default:
+		// The byte is repeated in a DWORD by the multiplication
+		emit(generator, Mnemonic::MOVZX, make_register(scratch_register, 4), make_register(source, 1));
+		emit(generator, Mnemonic::IMUL, make_register(scratch_register, 4), make_register(scratch_register, 4), make_immediate(0x01010101));
+		emit(generator, Mnemonic::MOVD, vector, make_register(scratch_register, 4));
+		emit(generator, Mnemonic::PSHUFD, vector, vector, make_immediate(0));
+		break;
+	}
+}
+
+static void emit_conversion(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	const IR_Function&	function = *generator.function;
+	Register::Type		source_type = function.registers[instruction.operands[0]];
+	Register::Type		destination_type = instruction.type;
+	uint8_t				source_size = (uint8_t)get_register_size(source_type);
+	uint8_t				destination_size = (uint8_t)get_register_size(destination_type);
+	bool				unsigned_source = has_flag(source_type, Register::Type::UNSIGNED);
+	Physical_Register	source = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+
+	if (is_vector(destination_type)) {
+		emit_broadcast(generator, source, source_type, destination, destination_type);
+	}
+	else if (is_floating_point(source_type) && is_floating_point(destination_type)) {
+		if (source_size == destination_size) {
+			if (source != destination) {
+				emit(generator, Mnemonic::MOVAPS, make_register(destination), make_register(source));
+			}
+		}
+		else {
+			emit(generator, source_size == 4 ? Mnemonic::CVTSS2SD : Mnemonic::CVTSD2SS, make_register(destination), make_register(source));
+		}
+	}
+	else if (is_floating_point(destination_type)) {
+		Mnemonic mnemonic = destination_size == 4 ? Mnemonic::CVTSI2SS : Mnemonic::CVTSI2SD;
+
+		if (source_size < 4) {
+			emit(generator, unsigned_source ? Mnemonic::MOVZX : Mnemonic::MOVSX, make_register(scratch_register, 4), make_register(source, source_size));
+			emit(generator, mnemonic, make_register(destination), make_register(scratch_register, 4));
+		}
+		else if (source_size == 4 && unsigned_source) {
+			// Zero extended to 64 bits, so the conversion is signed without overflow
+			emit(generator, Mnemonic::MOV, make_register(scratch_register, 4), make_register(source, 4));
+			emit(generator, mnemonic, make_register(destination), make_register(scratch_register));
+		}
+		else if (unsigned_source) {
+			// Values greater than the max of int64 are halved to be converted, then doubled. The lowest bit is kept in
+			// the halved value, else the rounding of values that are just above the middle of two floats is wrong:
+			// scratch = (source | (source & 1) << 1) >> 1
+			uint32_t	large_value = create_label(generator.assembler);
+			uint32_t	end = create_label(generator.assembler);
+
+			emit(generator, Mnemonic::TEST, make_register(source), make_register(source));
+			emit_branch(generator.assembler, Mnemonic::JCC, Condition_Code::S, large_value);
+			emit(generator, mnemonic, make_register(destination), make_register(source));
+			emit_branch(generator.assembler, Mnemonic::JMP, end);
+			bind_label(generator.assembler, large_value);
+			emit(generator, Mnemonic::MOV, make_register(scratch_register, 4), make_register(source, 4));
+			emit(generator, Mnemonic::AND, make_register(scratch_register, 4), make_immediate(1));
+			emit(generator, Mnemonic::ADD, make_register(scratch_register), make_register(scratch_register));
+			emit(generator, Mnemonic::OR, make_register(scratch_register), make_register(source));
+			emit(generator, Mnemonic::SHR, make_register(scratch_register), make_immediate(1));
+			emit(generator, mnemonic, make_register(destination), make_register(scratch_register));
+			emit(generator, destination_size == 4 ? Mnemonic::ADDSS : Mnemonic::ADDSD, make_register(destination), make_register(destination));
+			bind_label(generator.assembler, end);
+		}
+		else {
+			emit(generator, mnemonic, make_register(destination), make_register(source, source_size));
+		}
+	}
+	else if (is_floating_point(source_type) && destination_size == 8 && has_flag(destination_type, Register::Type::UNSIGNED)) {
+		// Values from 2^63 don't fit in int64, 2^63 is subtracted before the conversion and its bit is set back after.
+		// The source register is restored by adding 2^63 again, both operations are exact in this range.
+		Mnemonic	conversion = source_size == 4 ? Mnemonic::CVTTSS2SI : Mnemonic::CVTTSD2SI;
+		Operand		two_power_63 = make_memory(Physical_Register::RSP, generator.scratch_slot_offset, source_size);
+		uint32_t	large_value = create_label(generator.assembler);
+		uint32_t	end = create_label(generator.assembler);
+
+		if (source_size == 4) {
+			emit(generator, Mnemonic::MOV, two_power_63, make_immediate(0x5f000000));
+		}
+		else {
+			emit(generator, Mnemonic::MOV, make_register(scratch_register), make_immediate(0x43e0000000000000));
+			emit(generator, Mnemonic::MOV, two_power_63, make_register(scratch_register));
+		}
+		emit(generator, source_size == 4 ? Mnemonic::UCOMISS : Mnemonic::UCOMISD, make_register(source), two_power_63);
+		emit_branch(generator.assembler, Mnemonic::JCC, Condition_Code::AE, large_value);
+		emit(generator, conversion, make_register(destination), make_register(source));
+		emit_branch(generator.assembler, Mnemonic::JMP, end);
+		bind_label(generator.assembler, large_value);
+		emit(generator, source_size == 4 ? Mnemonic::SUBSS : Mnemonic::SUBSD, make_register(source), two_power_63);
+		emit(generator, conversion, make_register(destination), make_register(source));
+		emit(generator, source_size == 4 ? Mnemonic::ADDSS : Mnemonic::ADDSD, make_register(source), two_power_63);
+		emit(generator, Mnemonic::BTC, make_register(destination), make_immediate(63));
+		bind_label(generator.assembler, end);
+	}
+	else if (is_floating_point(source_type)) {
+		Mnemonic	mnemonic = source_size == 4 ? Mnemonic::CVTTSS2SI : Mnemonic::CVTTSD2SI;
+		bool		unsigned_destination = has_flag(destination_type, Register::Type::UNSIGNED);
+
+		// Unsigned DWORD values are the low part of the 64 bits conversion
+		emit(generator, mnemonic, make_register(destination, destination_size == 8 || (destination_size == 4 && unsigned_destination) ? 8 : 4), make_register(source));
+	}
+	else if (destination_size <= source_size) {
+		// Truncation, upper bits are ignored by users of the value
+		if (source != destination) {
+			emit(generator, Mnemonic::MOV, make_register(destination, get_operation_size(destination_type)), make_register(source, get_operation_size(destination_type)));
+		}
+	}
+	else if (unsigned_source) {
+		if (source_size < 4) {
+			emit(generator, Mnemonic::MOVZX, make_register(destination, 4), make_register(source, source_size));
+		}
+		else {
+			emit(generator, Mnemonic::MOV, make_register(destination, 4), make_register(source, 4)); // Zero extended
+		}
+	}
+	else {
+		if (source_size < 4) {
+			emit(generator, Mnemonic::MOVSX, make_register(destination, get_operation_size(destination_type)), make_register(source, source_size));
+		}
+		else {
+			emit(generator, Mnemonic::MOVSXD, make_register(destination), make_register(source, 4));
+		}
+	}
+}
+
+static void emit_binary_operation(Generator& generator, const IR_Instruction& instruction, uint32_t index, Mnemonic mnemonic, bool is_commutative)
+{
+	bool				floating_point = uses_xmm_register(instruction.type);
+	uint8_t				size = floating_point ? 8 : get_operation_size(instruction.type);
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	b = get_register(get_operand_location(generator, instruction.operands[1], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Mnemonic			move = floating_point ? Mnemonic::MOVAPS : Mnemonic::MOV;
+
+	if (destination == a) {
+		emit(generator, mnemonic, make_register(destination, size), make_register(b, size));
+	}
+	else if (destination == b && is_commutative) {
+		emit(generator, mnemonic, make_register(destination, size), make_register(a, size));
+	}
+	else if (destination == b && floating_point == false) {
+		emit(generator, Mnemonic::MOV, make_register(scratch_register, size), make_register(a, size));
+		emit(generator, mnemonic, make_register(scratch_register, size), make_register(b, size));
+		emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(scratch_register, size));
+	}
+	else if (destination == b) {
+		uint8_t		memory_size = (uint8_t)get_register_size(instruction.type);
+		Operand		scratch_slot = make_memory(Physical_Register::RSP, generator.scratch_slot_offset, memory_size);
+
+		emit(generator, memory_size == 16 ? Mnemonic::MOVAPS : memory_size == 4 ? Mnemonic::MOVSS : Mnemonic::MOVSD, scratch_slot, make_register(b));
+		emit(generator, Mnemonic::MOVAPS, make_register(destination), make_register(a));
+		emit(generator, mnemonic, make_register(destination), scratch_slot);
+	}
+	else {
+		emit(generator, move, make_register(destination, size), make_register(a, size));
+		emit(generator, mnemonic, make_register(destination, size), make_register(b, size));
+	}
+}
+
+// The dividend is in RDX:RAX, the quotient is written in RAX and the remainder in RDX. Values of RAX and RDX are
+// saved on the stack as the allocator doesn't know about them.
+static void emit_division(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	uint8_t				value_size = (uint8_t)get_register_size(instruction.type);
+	uint8_t				size = get_operation_size(instruction.type);
+	bool				is_unsigned = has_flag(instruction.type, Register::Type::UNSIGNED);
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	divisor = get_register(get_operand_location(generator, instruction.operands[1], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Physical_Register	result = instruction.opcode == IR_Opcode::DIV ? Physical_Register::RAX : Physical_Register::RDX;
+	Mnemonic			extension = is_unsigned ? Mnemonic::MOVZX : Mnemonic::MOVSX;
+
+	if (value_size < 4) {
+		emit(generator, extension, make_register(scratch_register, 4), make_register(divisor, value_size));
+		divisor = scratch_register;
+	}
+	else if (divisor == Physical_Register::RAX || divisor == Physical_Register::RDX) {
+		emit(generator, Mnemonic::MOV, make_register(scratch_register), make_register(divisor));
+		divisor = scratch_register;
+	}
+
+	if (destination != Physical_Register::RAX) {
+		emit(generator, Mnemonic::PUSH, make_register(Physical_Register::RAX));
+	}
+	if (destination != Physical_Register::RDX) {
+		emit(generator, Mnemonic::PUSH, make_register(Physical_Register::RDX));
+	}
+
+	if (value_size < 4) {
+		emit(generator, extension, make_register(Physical_Register::RAX, 4), make_register(a, value_size));
+	}
+	else if (a != Physical_Register::RAX) {
+		emit(generator, Mnemonic::MOV, make_register(Physical_Register::RAX, size), make_register(a, size));
+	}
+
+	if (is_unsigned) {
+		emit(generator, Mnemonic::XOR, make_register(Physical_Register::RDX, 4), make_register(Physical_Register::RDX, 4));
+		emit(generator, Mnemonic::DIV, make_register(divisor, size));
+	}
+	else {
+		emit(generator, size == 8 ? Mnemonic::CQO : Mnemonic::CDQ);
+		emit(generator, Mnemonic::IDIV, make_register(divisor, size));
+	}
+
+	if (destination != result) {
+		emit(generator, Mnemonic::MOV, make_register(destination), make_register(result));
+	}
+
+	if (destination != Physical_Register::RDX) {
+		emit(generator, Mnemonic::POP, make_register(Physical_Register::RDX));
+	}
+	if (destination != Physical_Register::RAX) {
+		emit(generator, Mnemonic::POP, make_register(Physical_Register::RAX));
+	}
+}
+
+// Return false if the value isn't a constant known at compile time
+static bool get_constant(const Generator& generator, uint32_t virtual_register, int64_t& value)
+{
+	uint32_t definition = generator.constant_definitions[virtual_register];
+
+	if (definition == invalid_register) {
+		return false;
+	}
+	value = generator.function->instructions[definition].immediate.integer;
+	return true;
+}
+
+inline bool is_power_of_two(uint64_t value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+inline uint8_t get_log2(uint64_t power_of_two)
+{
+	uint8_t result = 0;
+
+	while (power_of_two >>= 1) {
+		result++;
+	}
+	return result;
+}
+
+// Magic numbers of divisions by constants (Granlund and Montgomery: "Division by Invariant Integers using
+// Multiplication", algorithms of Hacker's Delight). The quotient is the high part of the product of the dividend
+// by the multiplier, shifted. Divisors of unsigned values may need a 33 (or 65) bits multiplier, the extra bit is
+// handled by an addition (is_add).
+struct Division_Magic
+{
+	uint64_t	multiplier;
+	uint8_t		shift;
+	bool		is_add;
+};
+
+// divisor is not 0, 1 or a power of two
+template<typename Unsigned>
+static Division_Magic compute_unsigned_magic(Unsigned divisor)
+{
+	constexpr uint32_t	nb_bits = 8 * sizeof(Unsigned);
+	constexpr Unsigned	max_signed = (Unsigned)(((Unsigned)1 << (nb_bits - 1)) - 1);
+	Division_Magic		magic;
+	uint32_t			p = nb_bits - 1;
+	Unsigned			q = max_signed / divisor;
+	Unsigned			r = max_signed - q * divisor;
+	Unsigned			power = 0;	// 2^(p - nb_bits)
+	Unsigned			delta;
+
+	magic.is_add = false;
+	do {
+		p++;
+		power = p == nb_bits ? 1 : 2 * power;
+		if (r + 1 >= divisor - r) {
+			if (q >= max_signed) {
+				magic.is_add = true;
+			}
+			q = 2 * q + 1;
+			r = 2 * r + 1 - divisor;
+		}
+		else {
+			if (q >= max_signed + 1) {
+				magic.is_add = true;
+			}
+			q = 2 * q;
+			r = 2 * r + 1;
+		}
+		delta = divisor - 1 - r;
+	} while (p < 2 * nb_bits && power < delta);
+
+	magic.multiplier = (Unsigned)(q + 1);
+	magic.shift = (uint8_t)(p - nb_bits);
+	return magic;
+}
+
+// The absolute value of divisor is not 0, 1 or a power of two, the multiplier is signed
+template<typename Unsigned>
+static Division_Magic compute_signed_magic(Unsigned divisor)
+{
+	constexpr uint32_t	nb_bits = 8 * sizeof(Unsigned);
+	constexpr Unsigned	min_signed = (Unsigned)1 << (nb_bits - 1);
+	bool				is_negative = (divisor & min_signed) != 0;
+	Unsigned			absolute_divisor = is_negative ? (Unsigned)(0 - divisor) : divisor;
+	Unsigned			t = min_signed + (is_negative ? 1 : 0);
+	Unsigned			absolute_nc = t - 1 - t % absolute_divisor;
+	uint32_t			p = nb_bits - 1;
+	Unsigned			q1 = min_signed / absolute_nc;
+	Unsigned			r1 = min_signed - q1 * absolute_nc;
+	Unsigned			q2 = min_signed / absolute_divisor;
+	Unsigned			r2 = min_signed - q2 * absolute_divisor;
+	Unsigned			delta;
+	Division_Magic		magic;
+
+	do {
+		p++;
+		q1 = 2 * q1;
+		r1 = 2 * r1;
+		if (r1 >= absolute_nc) {
+			q1++;
+			r1 -= absolute_nc;
+		}
+		q2 = 2 * q2;
+		r2 = 2 * r2;
+		if (r2 >= absolute_divisor) {
+			q2++;
+			r2 -= absolute_divisor;
+		}
+		delta = absolute_divisor - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	Unsigned multiplier = q2 + 1;
+
+	magic.multiplier = is_negative ? (Unsigned)(0 - multiplier) : multiplier;
+	magic.shift = (uint8_t)(p - nb_bits);
+	magic.is_add = false;
+	return magic;
+}
+
+// x / 2^k is a shift, signed values are biased by 2^k - 1 when they are negative to round toward zero
+static void emit_division_by_power_of_two(Generator& generator, const IR_Instruction& instruction, uint32_t index, uint8_t k, bool is_negative)
+{
+	uint8_t				value_size = (uint8_t)get_register_size(instruction.type);
+	uint8_t				size = get_operation_size(instruction.type);
+	uint8_t				nb_bits = 8 * size;
+	bool				is_unsigned = has_flag(instruction.type, Register::Type::UNSIGNED);
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+
+	// Upper bits of BYTE and WORD values are undefined
+	if (value_size < 4) {
+		emit(generator, is_unsigned ? Mnemonic::MOVZX : Mnemonic::MOVSX, make_register(destination, 4), make_register(a, value_size));
+		a = destination;
+	}
+
+	if (is_unsigned) {
+		if (destination != a) {
+			emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(a, size));
+		}
+
+		if (instruction.opcode == IR_Opcode::DIV) {
+			if (k) {
+				emit(generator, Mnemonic::SHR, make_register(destination, size), make_immediate(k));
+			}
+		}
+		else if (k < 32) {
+			emit(generator, Mnemonic::AND, make_register(destination, size), make_immediate(((int64_t)1 << k) - 1));
+		}
+		else {
+			emit(generator, Mnemonic::MOV, make_register(scratch_register), make_immediate(((int64_t)1 << k) - 1));
+			emit(generator, Mnemonic::AND, make_register(destination), make_register(scratch_register));
+		}
+		return;
+	}
+
+	if (k == 0) {
+		if (instruction.opcode == IR_Opcode::REM) {
+			emit(generator, Mnemonic::XOR, make_register(destination, 4), make_register(destination, 4));
+			return;
+		}
+
+		if (destination != a) {
+			emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(a, size));
+		}
+		if (is_negative) {
+			emit(generator, Mnemonic::NEG, make_register(destination, size));
+		}
+		return;
+	}
+
+	// scratch = x + (x < 0 ? 2^k - 1 : 0)
+	emit(generator, Mnemonic::MOV, make_register(scratch_register, size), make_register(a, size));
+	if (k > 1) {
+		emit(generator, Mnemonic::SAR, make_register(scratch_register, size), make_immediate(nb_bits - 1));
+	}
+	emit(generator, Mnemonic::SHR, make_register(scratch_register, size), make_immediate(nb_bits - k));
+	emit(generator, Mnemonic::ADD, make_register(scratch_register, size), make_register(a, size));
+
+	if (instruction.opcode == IR_Opcode::DIV) {
+		emit(generator, Mnemonic::SAR, make_register(scratch_register, size), make_immediate(k));
+		emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(scratch_register, size));
+		if (is_negative) {
+			emit(generator, Mnemonic::NEG, make_register(destination, size));
+		}
+		return;
+	}
+
+	// The remainder has the sign of the dividend, x % -2^k == x % 2^k
+	if (k < 32) {
+		emit(generator, Mnemonic::AND, make_register(scratch_register, size), make_immediate(-((int64_t)1 << k)));
+	}
+	else {
+		emit(generator, Mnemonic::SAR, make_register(scratch_register, size), make_immediate(k));
+		emit(generator, Mnemonic::SHL, make_register(scratch_register, size), make_immediate(k));
+	}
+	if (destination != a) {
+		emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(a, size));
+	}
+	emit(generator, Mnemonic::SUB, make_register(destination, size), make_register(scratch_register, size));
+}
+
+// The dividend is kept in the scratch register for the remainder (x - q * divisor), RAX and RDX are used for the
+// product and are saved on the stack as in emit_division. BYTE and WORD values are divided as DWORD values.
+static void emit_division_by_constant(Generator& generator, const IR_Instruction& instruction, uint32_t index, uint64_t divisor)
+{
+	uint8_t				value_size = (uint8_t)get_register_size(instruction.type);
+	uint8_t				size = get_operation_size(instruction.type);
+	bool				is_unsigned = has_flag(instruction.type, Register::Type::UNSIGNED);
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Operand				rax = make_register(Physical_Register::RAX, size);
+	Operand				rdx = make_register(Physical_Register::RDX, size);
+	Operand				scratch = make_register(scratch_register, size);
+	bool				is_negative = !is_unsigned && (int64_t)divisor < 0;
+	Division_Magic		magic;
+
+	if (size == 8) {
+		magic = is_unsigned ? compute_unsigned_magic<uint64_t>(divisor) : compute_signed_magic<uint64_t>(divisor);
+	}
+	else {
+		magic = is_unsigned ? compute_unsigned_magic<uint32_t>((uint32_t)divisor) : compute_signed_magic<uint32_t>((uint32_t)divisor);
+	}
+
+	// Dividends of the 32 bits version are extended to 64 bits, the high part of the product is computed with a
+	// 64 bits imul. The 64 bits version uses mul or imul that write the high part in RDX.
+	if (value_size < 4) {
+		emit(generator, is_unsigned ? Mnemonic::MOVZX : Mnemonic::MOVSX, make_register(scratch_register), make_register(a, value_size));
+	}
+	else if (value_size == 4) {
+		emit(generator, is_unsigned ? Mnemonic::MOV : Mnemonic::MOVSXD, make_register(scratch_register, is_unsigned ? 4 : 8), make_register(a, 4));
+	}
+	else {
+		emit(generator, Mnemonic::MOV, make_register(scratch_register), make_register(a));
+	}
+
+	if (destination != Physical_Register::RAX) {
+		emit(generator, Mnemonic::PUSH, make_register(Physical_Register::RAX));
+	}
+	if (destination != Physical_Register::RDX) {
+		emit(generator, Mnemonic::PUSH, make_register(Physical_Register::RDX));
+	}
+
+	// The quotient is computed in RAX
+	bool has_correction = !is_unsigned && (is_negative != (magic.multiplier >> (8 * size - 1) != 0));
+
+	if (size == 4) {
+		// Unsigned multipliers are zero extended by the mov of 32 bits, signed ones are sign extended
+		if (is_unsigned) {
+			emit(generator, Mnemonic::MOV, make_register(Physical_Register::RAX, 4), make_immediate((int64_t)(uint32_t)magic.multiplier));
+		}
+		else {
+			emit(generator, Mnemonic::MOV, make_register(Physical_Register::RAX), make_immediate((int64_t)(int32_t)magic.multiplier));
+		}
+		emit(generator, Mnemonic::IMUL, make_register(Physical_Register::RAX), make_register(scratch_register));
+		if (is_unsigned && magic.is_add) {
+			emit(generator, Mnemonic::SHR, make_register(Physical_Register::RAX), make_immediate(32));
+		}
+		else if (!has_correction) {
+			emit(generator, is_unsigned ? Mnemonic::SHR : Mnemonic::SAR, make_register(Physical_Register::RAX), make_immediate(32 + magic.shift));
+		}
+		else {
+			emit(generator, Mnemonic::SAR, make_register(Physical_Register::RAX), make_immediate(32));
+		}
+	}
+	else {
+		emit(generator, Mnemonic::MOV, make_register(Physical_Register::RAX), make_immediate((int64_t)magic.multiplier));
+		emit(generator, is_unsigned ? Mnemonic::MUL : Mnemonic::IMUL, make_register(scratch_register));
+		if (!(is_unsigned && magic.is_add) && !has_correction && magic.shift) {
+			emit(generator, is_unsigned ? Mnemonic::SHR : Mnemonic::SAR, rdx, make_immediate(magic.shift));
+		}
+		emit(generator, Mnemonic::MOV, rax, rdx);
+	}
+
+	// From there RAX holds the high part of the product, shifted if no correction is needed
+	if (is_unsigned && magic.is_add) {
+		// q = (t + ((x - t) >> 1)) >> (shift - 1)
+		emit(generator, Mnemonic::MOV, rdx, scratch);
+		emit(generator, Mnemonic::SUB, rdx, rax);
+		emit(generator, Mnemonic::SHR, rdx, make_immediate(1));
+		emit(generator, Mnemonic::ADD, rax, rdx);
+		if (magic.shift > 1) {
+			emit(generator, Mnemonic::SHR, rax, make_immediate(magic.shift - 1));
+		}
+	}
+	else if (!is_unsigned) {
+		if (has_correction) {
+			emit(generator, is_negative ? Mnemonic::SUB : Mnemonic::ADD, rax, scratch);
+			if (magic.shift) {
+				emit(generator, Mnemonic::SAR, rax, make_immediate(magic.shift));
+			}
+		}
+		// Rounded toward zero, the sign bit of the quotient is added
+		emit(generator, Mnemonic::MOV, rdx, rax);
+		emit(generator, Mnemonic::SHR, rdx, make_immediate(8 * size - 1));
+		emit(generator, Mnemonic::ADD, rax, rdx);
+	}
+
+	Physical_Register result = Physical_Register::RAX;
+
+	if (instruction.opcode == IR_Opcode::REM) {
+		emit(generator, Mnemonic::MOV, rdx, make_immediate(size == 4 ? (int64_t)(int32_t)divisor : (int64_t)divisor));
+		emit(generator, Mnemonic::IMUL, rax, rdx);
+		emit(generator, Mnemonic::SUB, scratch, rax);
+		result = scratch_register;
+	}
+
+	if (destination != result) {
+		emit(generator, Mnemonic::MOV, make_register(destination), make_register(result));
+	}
+
+	if (destination != Physical_Register::RDX) {
+		emit(generator, Mnemonic::POP, make_register(Physical_Register::RDX));
+	}
+	if (destination != Physical_Register::RAX) {
+		emit(generator, Mnemonic::POP, make_register(Physical_Register::RAX));
+	}
+}
+
+// Divisions by constants are replaced by shifts (powers of two) or multiplications, others use div and idiv
+// @SpeedUp the divisor is still loaded in a register, the register allocator doesn't know that it isn't read
+static void emit_integer_division(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	uint8_t		value_size = (uint8_t)get_register_size(instruction.type);
+	bool		is_unsigned = has_flag(instruction.type, Register::Type::UNSIGNED);
+	int64_t		value;
+
+	if (get_constant(generator, instruction.operands[1], value) == false) {
+		emit_division(generator, instruction, index);
+		return;
+	}
+
+	// The divisor is truncated to the size of the type, then extended to 64 bits (32 bits for the sign of DWORD
+	// values, as the operation is done on 32 bits)
+	uint32_t	unused_bits = 64 - 8 * value_size;
+	uint64_t	divisor = is_unsigned ? ((uint64_t)value << unused_bits) >> unused_bits : (uint64_t)(((int64_t)((uint64_t)value << unused_bits)) >> unused_bits);
+	bool		is_negative = !is_unsigned && (int64_t)divisor < 0;
+	uint64_t	absolute_divisor = is_negative ? 0 - divisor : divisor;
+
+	if (absolute_divisor == 0) {
+		emit_division(generator, instruction, index); // Raises the division error of the processor
+	}
+	else if (is_power_of_two(absolute_divisor)) {
+		emit_division_by_power_of_two(generator, instruction, index, get_log2(absolute_divisor), is_negative);
+	}
+	else {
+		emit_division_by_constant(generator, instruction, index, divisor);
+	}
+}
+
+// Multiplications by powers of two are shifts, the low part of the product doesn't depend on the sign
+static bool emit_multiplication_by_power_of_two(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	uint8_t	size = get_operation_size(instruction.type);
+	int64_t	value;
+	uint8_t	operand;
+
+	for (operand = 0; operand < 2; operand++) {
+		if (get_constant(generator, instruction.operands[1 - operand], value)
+			&& is_power_of_two(size == 8 ? (uint64_t)value : (uint32_t)value)) {
+			break;
+		}
+	}
+	if (operand == 2) {
+		return false;
+	}
+
+	uint8_t				k = get_log2(size == 8 ? (uint64_t)value : (uint32_t)value);
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[operand], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+
+	if (destination != a) {
+		emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(a, size));
+	}
+	if (k) {
+		emit(generator, Mnemonic::SHL, make_register(destination, size), make_immediate(k));
+	}
+	return true;
+}
+
+// Vectors are in XMM registers, lanes are processed by a single SSE instruction. There is no SSE instruction to
+// multiply lanes of BYTE and QWORD, or to divide integers.
+static Mnemonic get_vector_mnemonic(IR_Opcode opcode, Register::Type type)
+{
+	struct Vector_Mnemonics
+	{
+		Mnemonic	add;
+		Mnemonic	sub;
+		Mnemonic	mul;
+		Mnemonic	div;
+	};
+
+	static const Vector_Mnemonics float_mnemonics = { Mnemonic::ADDPS, Mnemonic::SUBPS, Mnemonic::MULPS, Mnemonic::DIVPS };
+	static const Vector_Mnemonics double_mnemonics = { Mnemonic::ADDPD, Mnemonic::SUBPD, Mnemonic::MULPD, Mnemonic::DIVPD };
+	static const Vector_Mnemonics integer_mnemonics[] = { // By log2 of the size of lanes
+		{ Mnemonic::PADDB, Mnemonic::PSUBB, Mnemonic::COUNT, Mnemonic::COUNT },
+		{ Mnemonic::PADDW, Mnemonic::PSUBW, Mnemonic::PMULLW, Mnemonic::COUNT },
+		{ Mnemonic::PADDD, Mnemonic::PSUBD, Mnemonic::PMULLD, Mnemonic::COUNT },
+		{ Mnemonic::PADDQ, Mnemonic::PSUBQ, Mnemonic::COUNT, Mnemonic::COUNT },
+	};
+
+	Register::Type			lane_type = get_lane_type(type);
+	const Vector_Mnemonics&	mnemonics = has_flag(lane_type, Register::Type::FLOAT) ? float_mnemonics
+		: has_flag(lane_type, Register::Type::DOUBLE) ? double_mnemonics
+		: integer_mnemonics[get_log2(get_register_size(lane_type))];
+	Mnemonic				mnemonic = Mnemonic::COUNT;
+
+	switch (opcode)
+	{
+	case IR_Opcode::ADD:	mnemonic = mnemonics.add; break;
+	case IR_Opcode::SUB:	mnemonic = mnemonics.sub; break;
+	case IR_Opcode::MUL:	mnemonic = mnemonics.mul; break;
+	case IR_Opcode::DIV:	mnemonic = mnemonics.div; break;
+	default:				break;
+	}
+
+	if (mnemonic == Mnemonic::COUNT) {
+		report_error(Compiler_Error::internal_error, "x64 code generator: this operation isn't supported on vectors of this type.");
+	}
+	return mnemonic;
+}
+
+// Floating points have their sign bits flipped, integers are substracted from 0
+static void emit_vector_negation(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Register::Type		lane_type = get_lane_type(instruction.type);
+	Operand				scratch_slot = make_memory(Physical_Register::RSP, generator.scratch_slot_offset, 16);
+
+	if (is_floating_point(lane_type)) {
+		IR_Immediate sign;
+
+		if (has_flag(lane_type, Register::Type::FLOAT)) {
+			sign.real = -0.0;
+		}
+		else {
+			sign.integer = std::numeric_limits<int64_t>::min();
+		}
+
+		emit(generator, Mnemonic::MOV, make_register(scratch_register), make_immediate((int64_t)get_lane_pattern(lane_type, sign)));
+		for (int32_t offset = 0; offset < 16; offset += 8) {
+			Operand half = make_memory(Physical_Register::RSP, generator.scratch_slot_offset + offset, 8);
+
+			emit(generator, Mnemonic::MOV, half, make_register(scratch_register));
+		}
+		if (destination != a) {
+			emit(generator, Mnemonic::MOVAPS, make_register(destination), make_register(a));
+		}
+		emit(generator, Mnemonic::XORPS, make_register(destination), scratch_slot);
+		return;
+	}
+
+	Mnemonic sub = get_vector_mnemonic(IR_Opcode::SUB, instruction.type);
+
+	if (destination != a) {
+		emit(generator, Mnemonic::PXOR, make_register(destination), make_register(destination));
+		emit(generator, sub, make_register(destination), make_register(a));
+	}
+	else {
+		emit(generator, Mnemonic::MOVAPS, scratch_slot, make_register(a));
+		emit(generator, Mnemonic::PXOR, make_register(destination), make_register(destination));
+		emit(generator, sub, make_register(destination), scratch_slot);
+	}
+}
+
+static void emit_insertion(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	b = get_register(get_operand_location(generator, instruction.operands[1], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Register::Type		lane_type = get_lane_type(instruction.type);
+	uint32_t			lane = instruction.immediate.index;
+	Operand				vector = make_register(destination);
+
+	if (has_flag(lane_type, Register::Type::DOUBLE)) {
+		// SHUFPD takes the low lane from the destination and the high one from the source
+		if (destination == b && lane == 0) {
+			emit(generator, Mnemonic::SHUFPD, vector, make_register(a), make_immediate(2));
+		}
+		else if (destination == b) {
+			emit(generator, Mnemonic::SHUFPD, vector, vector, make_immediate(0));
+			emit(generator, Mnemonic::MOVSD, vector, make_register(a));
+		}
+		else {
+			if (destination != a) {
+				emit(generator, Mnemonic::MOVAPS, vector, make_register(a));
+			}
+			if (lane == 0) {
+				emit(generator, Mnemonic::MOVSD, vector, make_register(b));
+			}
+			else {
+				emit(generator, Mnemonic::SHUFPD, vector, make_register(b), make_immediate(0));
+			}
+		}
+		return;
+	}
+
+	Operand scalar = make_register(b, get_register_size(lane_type) == 8 ? 8 : 4);
+
+	// The scalar would be overwritten by the copy of the vector
+	if (destination == b && destination != a) {
+		Operand scratch_slot = make_memory(Physical_Register::RSP, generator.scratch_slot_offset, 16);
+
+		emit(generator, Mnemonic::MOVAPS, scratch_slot, make_register(b));
+		scalar = make_memory(Physical_Register::RSP, generator.scratch_slot_offset, 4);
+	}
+	if (destination != a) {
+		emit(generator, Mnemonic::MOVAPS, vector, make_register(a));
+	}
+
+	if (has_flag(lane_type, Register::Type::FLOAT)) {
+		emit(generator, Mnemonic::INSERTPS, vector, scalar, make_immediate(lane << 4)); // The lane of the destination is in bits 4 and 5
+		return;
+	}
+
+	static const Mnemonic insertions[] = { Mnemonic::PINSRB, Mnemonic::PINSRW, Mnemonic::PINSRD, Mnemonic::PINSRQ }; // By log2 of the size of lanes
+
+	emit(generator, insertions[get_log2(get_register_size(lane_type))], vector, scalar, make_immediate(lane));
+}
+
+static void emit_extraction(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	Register::Type		lane_type = get_lane_type(instruction.type);
+	uint32_t			lane = instruction.immediate.index;
+	uint8_t				size = (uint8_t)get_register_size(lane_type);
+
+	if (is_floating_point(lane_type)) {
+		// Upper lanes of a scalar in a XMM register are ignored
+		if (lane == 0 && destination != a) {
+			emit(generator, Mnemonic::MOVAPS, make_register(destination), make_register(a));
+		}
+		else if (lane != 0) {
+			uint8_t dwords = size == 4 ? (uint8_t)lane : 0xee; // The high QWORD is moved to the low one
+			emit(generator, Mnemonic::PSHUFD, make_register(destination), make_register(a), make_immediate(dwords));
+		}
+	}
+	else if (lane == 0 && size >= 4) {
+		emit(generator, size == 8 ? Mnemonic::MOVQ : Mnemonic::MOVD, make_register(destination, size), make_register(a));
+	}
+	else {
+		static const Mnemonic extractions[] = { Mnemonic::PEXTRB, Mnemonic::PEXTRW, Mnemonic::PEXTRD, Mnemonic::PEXTRQ }; // By log2 of the size of lanes
+
+		emit(generator, extractions[get_log2(size)], make_register(destination, size == 8 ? 8 : 4), make_register(a), make_immediate(lane));
+	}
+}
+
+// PSHUFD moves DWORDs, lanes of QWORDs are moved as pairs of DWORDs
+static void emit_shuffle(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	uint32_t			nb_lanes = get_nb_lanes(instruction.type);
+	int64_t				dwords = 0;
+
+	if (nb_lanes > 4) {
+		report_error(Compiler_Error::internal_error, "x64 code generator: only vectors of 2 or 4 lanes can be shuffled.");
+	}
+
+	for (uint32_t i = 0; i < nb_lanes; i++) {
+		int64_t lane = (instruction.immediate.integer >> (4 * i)) & 0xf;
+
+		if (nb_lanes == 4) {
+			dwords |= lane << (2 * i);
+		}
+		else {
+			dwords |= (2 * lane) << (4 * i) | (2 * lane + 1) << (4 * i + 2);
+		}
+	}
+	emit(generator, Mnemonic::PSHUFD, make_register(destination), make_register(a), make_immediate(dwords));
+}
+
+static void emit_negation(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+
+	if (is_vector(instruction.type)) {
+		emit_vector_negation(generator, instruction, index);
+		return;
+	}
+	if (is_floating_point(instruction.type)) {
+		uint8_t		size = (uint8_t)get_register_size(instruction.type);
+		Mnemonic	move = size == 4 ? Mnemonic::MOVD : Mnemonic::MOVQ;
+
+		// The sign bit is flipped
+		emit(generator, move, make_register(scratch_register, size), make_register(a));
+		emit(generator, Mnemonic::BTC, make_register(scratch_register, size), make_immediate(8 * size - 1));
+		emit(generator, move, make_register(destination), make_register(scratch_register, size));
+		return;
+	}
+
+	uint8_t size = get_operation_size(instruction.type);
+
+	if (destination != a) {
+		emit(generator, Mnemonic::MOV, make_register(destination, size), make_register(a, size));
+	}
+	emit(generator, Mnemonic::NEG, make_register(destination, size));
+}
+
+static void emit_comparison(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	Physical_Register	a = get_register(get_operand_location(generator, instruction.operands[0], index));
+	Physical_Register	b = get_register(get_operand_location(generator, instruction.operands[1], index));
+	Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+	uint8_t				size = (uint8_t)get_register_size(instruction.type);
+
+	if (is_floating_point(instruction.type)) {
+		Mnemonic compare = size == 4 ? Mnemonic::UCOMISS : Mnemonic::UCOMISD;
+
+		// Unordered operands (NaN) set ZF, PF and CF, so only conditions that are false when CF is set are used.
+		// Less comparisons are done with swapped operands.
+		switch (instruction.opcode)
+		{
+		case IR_Opcode::EQUAL:
+			emit(generator, compare, make_register(a), make_register(b));
+			emit(generator, Mnemonic::SETCC, Condition_Code::E, make_register(destination, 1));
+			emit(generator, Mnemonic::SETCC, Condition_Code::NP, make_register(scratch_register, 1));
+			emit(generator, Mnemonic::AND, make_register(destination, 1), make_register(scratch_register, 1));
+			break;
+		case IR_Opcode::NOT_EQUAL:
+			emit(generator, compare, make_register(a), make_register(b));
+			emit(generator, Mnemonic::SETCC, Condition_Code::NE, make_register(destination, 1));
+			emit(generator, Mnemonic::SETCC, Condition_Code::P, make_register(scratch_register, 1));
+			emit(generator, Mnemonic::OR, make_register(destination, 1), make_register(scratch_register, 1));
+			break;
+		case IR_Opcode::LESS:
+			emit(generator, compare, make_register(b), make_register(a));
+			emit(generator, Mnemonic::SETCC, Condition_Code::A, make_register(destination, 1));
+			break;
+		case IR_Opcode::LESS_EQUAL:
+			emit(generator, compare, make_register(b), make_register(a));
+			emit(generator, Mnemonic::SETCC, Condition_Code::AE, make_register(destination, 1));
+			break;
+		case IR_Opcode::GREATER:
+			emit(generator, compare, make_register(a), make_register(b));
+			emit(generator, Mnemonic::SETCC, Condition_Code::A, make_register(destination, 1));
+			break;
+		default:
+			emit(generator, compare, make_register(a), make_register(b));
+			emit(generator, Mnemonic::SETCC, Condition_Code::AE, make_register(destination, 1));
+			break;
+		}
+		return;
+	}
+
+	bool			is_unsigned = has_flag(instruction.type, Register::Type::UNSIGNED) || has_flag(instruction.type, Register::Type::POINTER);
+	Condition_Code	condition;
+
+	switch (instruction.opcode)
+	{
+	case IR_Opcode::EQUAL:			condition = Condition_Code::E; break;
+	case IR_Opcode::NOT_EQUAL:		condition = Condition_Code::NE; break;
+	case IR_Opcode::LESS:			condition = is_unsigned ? Condition_Code::B : Condition_Code::L; break;
+	case IR_Opcode::LESS_EQUAL:		condition = is_unsigned ? Condition_Code::BE : Condition_Code::LE; break;
+	case IR_Opcode::GREATER:		condition = is_unsigned ? Condition_Code::A : Condition_Code::G; break;
+	default:						condition = is_unsigned ? Condition_Code::AE : Condition_Code::GE; break;
+	}
+
+	// Compared with their exact size as upper bits are undefined
+	emit(generator, Mnemonic::CMP, make_register(a, size), make_register(b, size));
+	emit(generator, Mnemonic::SETCC, condition, make_register(destination, 1));
+}
+
+static void emit_call(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	const IR_Function&	callee = generator.ir->functions[instruction.immediate.index];
+	uint32_t			instruction_start = (uint32_t)memory::get_array_size(generator.assembler.code);
+	Encoded_Instruction	encoded_instruction;
+
+	if (instruction.opcode == IR_Opcode::CALL_INDIRECT) {
+		// The address is in a non volatile register or in a stack slot
+		uint32_t address = generator.function->operand_lists[instruction.operands[0]];
+
+		emit(generator, Mnemonic::CALL, get_operand(generator, get_operand_location(generator, address, index), 8));
+	}
+	else if (callee.imported_function) {
+		encoded_instruction = emit(generator, Mnemonic::CALL, make_rip_relative(0));
+		add_fixup(generator, Code_Fixup::Kind::IMPORTED_FUNCTION, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, instruction.immediate.index);
+	}
+	else {
+		encoded_instruction = emit(generator, Mnemonic::CALL, make_relative(0, 4));
+		add_fixup(generator, Code_Fixup::Kind::FUNCTION, instruction_start, encoded_instruction.immediate_offset, encoded_instruction.size, instruction.immediate.index);
+	}
+}
+
+// Scalar ADD, SUB, MUL and DIV
+static void emit_scalar_arithmetic(Generator& generator, const IR_Instruction& instruction, uint32_t index)
+{
+	switch (instruction.opcode)
+	{
+	case IR_Opcode::ADD:
+		emit_binary_operation(generator, instruction, index, is_floating_point(instruction.type)
+			? (get_register_size(instruction.type) == 4 ? Mnemonic::ADDSS : Mnemonic::ADDSD) : Mnemonic::ADD, true);
+		break;
+	case IR_Opcode::SUB:
+		emit_binary_operation(generator, instruction, index, is_floating_point(instruction.type)
+			? (get_register_size(instruction.type) == 4 ? Mnemonic::SUBSS : Mnemonic::SUBSD) : Mnemonic::SUB, false);
+		break;
+	case IR_Opcode::MUL:
+		// The low part of the product is the same for signed and unsigned values
+		if (is_floating_point(instruction.type) || !emit_multiplication_by_power_of_two(generator, instruction, index)) {
+			emit_binary_operation(generator, instruction, index, is_floating_point(instruction.type)
+				? (get_register_size(instruction.type) == 4 ? Mnemonic::MULSS : Mnemonic::MULSD) : Mnemonic::IMUL, true);
+		}
+		break;
+	case IR_Opcode::DIV:
+		if (is_floating_point(instruction.type)) {
+			emit_binary_operation(generator, instruction, index, get_register_size(instruction.type) == 4 ? Mnemonic::DIVSS : Mnemonic::DIVSD, false);
+		}
+		else {
+			emit_integer_division(generator, instruction, index);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+// next_block is the block emitted after the block of the instruction, nb_blocks for the epilogue and invalid_block at
+// the end of the code
+static void emit_instruction(Generator& generator, const IR_Instruction& instruction, uint32_t index, uint32_t next_block)
+{
+	const IR_Function&	function = *generator.function;
+	uint32_t			nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+
+	// Values that are never read aren't computed (only calls have side effects)
+	if (instruction.destination != invalid_register && !is_call(instruction.opcode)
+		&& get_destination_location(generator, instruction.destination, index).kind == Location::Kind::NONE) {
+		return;
+	}
+
+	switch (instruction.opcode)
+	{
+	case IR_Opcode::NOP:
+	case IR_Opcode::PHI:	// Resolved by moves on control flow edges
+		break;
+	case IR_Opcode::CONSTANT:
+		emit_constant(generator, instruction, get_destination_location(generator, instruction.destination, index));
+		break;
+	case IR_Opcode::ADDRESS:
+	{
+		Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+		uint32_t			instruction_start = (uint32_t)memory::get_array_size(generator.assembler.code);
+		Encoded_Instruction	encoded_instruction = emit(generator, Mnemonic::LEA, make_register(destination), make_rip_relative(0, 0));
+
+		add_fixup(generator, Code_Fixup::Kind::LITERAL, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, instruction.immediate.index);
+		break;
+	}
+	case IR_Opcode::FUNCTION_ADDRESS:
+	{
+		Physical_Register	destination = get_register(get_destination_location(generator, instruction.destination, index));
+		uint32_t			instruction_start = (uint32_t)memory::get_array_size(generator.assembler.code);
+		Encoded_Instruction	encoded_instruction;
+
+		if (generator.ir->functions[instruction.immediate.index].imported_function) {
+			encoded_instruction = emit(generator, Mnemonic::MOV, make_register(destination), make_rip_relative(0));
+			add_fixup(generator, Code_Fixup::Kind::IMPORTED_FUNCTION, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, instruction.immediate.index);
+		}
+		else {
+			encoded_instruction = emit(generator, Mnemonic::LEA, make_register(destination), make_rip_relative(0, 0));
+			add_fixup(generator, Code_Fixup::Kind::FUNCTION, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, instruction.immediate.index);
+		}
+		break;
+	}
+	case IR_Opcode::COUNTER:
+	{
+		uint32_t			instruction_start = (uint32_t)memory::get_array_size(generator.assembler.code);
+		Encoded_Instruction	encoded_instruction = emit(generator, Mnemonic::ADD, make_rip_relative(0), make_immediate(1));
+
+		add_fixup(generator, Code_Fixup::Kind::PROFILE_COUNTER, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, instruction.immediate.index);
+		break;
+	}
+	case IR_Opcode::COPY:
+		emit_move(generator, get_operand_location(generator, instruction.operands[0], index),
+			get_destination_location(generator, instruction.destination, index), function.registers[instruction.destination]);
+		break;
+	case IR_Opcode::CONVERT:
+		emit_conversion(generator, instruction, index);
+		break;
+	case IR_Opcode::ADD:
+	case IR_Opcode::SUB:
+	case IR_Opcode::MUL:
+	case IR_Opcode::DIV:
+		if (is_vector(instruction.type)) {
+			emit_binary_operation(generator, instruction, index, get_vector_mnemonic(instruction.opcode, instruction.type),
+				instruction.opcode == IR_Opcode::ADD || instruction.opcode == IR_Opcode::MUL);
+			break;
+		}
+		emit_scalar_arithmetic(generator, instruction, index);
+		break;
+	case IR_Opcode::REM:
+		if (is_floating_point(instruction.type)) {
+			report_error(Compiler_Error::internal_error, "x64 code generator: the remainder of floating points isn't supported.");
+		}
+		emit_integer_division(generator, instruction, index);
+		break;
+	case IR_Opcode::NEG:
+		emit_negation(generator, instruction, index);
+		break;
+	case IR_Opcode::EQUAL:
+	case IR_Opcode::NOT_EQUAL:
+	case IR_Opcode::LESS:
+	case IR_Opcode::LESS_EQUAL:
+	case IR_Opcode::GREATER:
+	case IR_Opcode::GREATER_EQUAL:
+		emit_comparison(generator, instruction, index);
+		break;
+	case IR_Opcode::INSERT:
+		emit_insertion(generator, instruction, index);
+		break;
+	case IR_Opcode::EXTRACT:
+		emit_extraction(generator, instruction, index);
+		break;
+	case IR_Opcode::SHUFFLE:
+		emit_shuffle(generator, instruction, index);
+		break;
+	case IR_Opcode::CALL:
+	case IR_Opcode::CALL_INDIRECT:
+		emit_call(generator, instruction, index);
+		break;
+	case IR_Opcode::JUMP:
+		if (instruction.immediate.targets[0] != next_block) {
+			emit_branch(generator.assembler, Mnemonic::JMP, generator.block_labels[instruction.immediate.targets[0]]);
+		}
+		break;
+	case IR_Opcode::BRANCH:
+	{
+		Physical_Register	condition = get_register(get_operand_location(generator, instruction.operands[0], index));
+		uint8_t				size = (uint8_t)get_register_size(function.registers[instruction.operands[0]]);
+		uint32_t			taken = instruction.immediate.targets[0];
+		uint32_t			not_taken = instruction.immediate.targets[1];
+
+		emit(generator, Mnemonic::TEST, make_register(condition, size), make_register(condition, size));
+		if (not_taken == next_block) {
+			emit_branch(generator.assembler, Mnemonic::JCC, Condition_Code::NE, generator.block_labels[taken]);
+		}
+		else if (taken == next_block) {
+			emit_branch(generator.assembler, Mnemonic::JCC, Condition_Code::E, generator.block_labels[not_taken]);
+		}
+		else {
+			emit_branch(generator.assembler, Mnemonic::JCC, Condition_Code::NE, generator.block_labels[taken]);
+			emit_branch(generator.assembler, Mnemonic::JMP, generator.block_labels[not_taken]);
+		}
+		break;
+	}
+	case IR_Opcode::SWITCH:
+	{
+		// lea r11, [rip + table], add r11, [r11 + index * 8], jmp r11
+		Physical_Register	table_index = get_register(get_operand_location(generator, instruction.operands[0], index));
+		const uint32_t*		successors = memory::get_array_element(function.operand_lists, instruction.immediate.targets[0]);
+		const uint32_t*		table = successors + instruction.immediate.targets[1];
+		uint32_t			first_entry = (uint32_t)memory::get_array_size(generator.jump_table_entries);
+		uint32_t			instruction_start = (uint32_t)memory::get_array_size(generator.assembler.code);
+
+		for (uint32_t i = 0; i < table[0]; i++) {
+			memory::array_push_back(generator.jump_table_entries, Jump_Table_Entry{ first_entry, generator.block_labels[successors[table[1 + i]]] });
+		}
+
+		Encoded_Instruction encoded_instruction = emit(generator, Mnemonic::LEA, make_register(scratch_register), make_rip_relative(0, 0));
+
+		add_fixup(generator, Code_Fixup::Kind::JUMP_TABLE, instruction_start, encoded_instruction.displacement_offset, encoded_instruction.size, first_entry);
+		emit(generator, Mnemonic::ADD, make_register(scratch_register), make_memory(scratch_register, table_index, 8, 0));
+		emit(generator, Mnemonic::JMP, make_register(scratch_register));
+		break;
+	}
+	case IR_Opcode::RETURN:
+		// The value is already in RAX or XMM0, the epilogue follows the last hot block
+		if (next_block != nb_blocks) {
+			emit_branch(generator.assembler, Mnemonic::JMP, generator.epilogue_label);
+		}
+		break;
+	default:
+		report_error(Compiler_Error::internal_error, "x64 code generator: unsupported IR instruction.");
+	}
+}
+
+static void emit_block(Generator& generator, uint32_t block_index, uint32_t next_block)
+{
+	const IR_Function&			function = *generator.function;
+	const Register_Allocation&	allocation = *generator.allocation;
+	const IR_Basic_Block&		block = function.blocks[block_index];
+	bool						entry_moves_emitted = false;
+
+	bind_label(generator.assembler, generator.block_labels[block_index]);
+
+	for (uint32_t j = 0; j < block.nb_instructions; j++) {
+		uint32_t				index = block.first_instruction + j;
+		const IR_Instruction&	instruction = function.instructions[index];
+
+		if (instruction.opcode != IR_Opcode::PHI && entry_moves_emitted == false) {
+			emit_moves(generator, allocation.block_entry[block_index]);
+			entry_moves_emitted = true;
+		}
+
+		emit_moves(generator, allocation.before_instruction[index]);
+		if (is_terminator(instruction.opcode)) {
+			emit_moves(generator, allocation.block_exit[block_index]);
+		}
+		emit_instruction(generator, instruction, index, next_block);
+		emit_moves(generator, allocation.after_instruction[index]);
+	}
+}
+
+//=============================================================================
+
+void f::x64::generate_function_code(const IR& ir, const IR_Function& function, const Register_Allocation& allocation, Function_Code& function_code, bool use_red_zone)
+{
+	ZoneScopedN("f::x64::generate_function_code");
+
+	Generator generator;
+
+	defer {
+		release(generator.assembler);
+		memory::release(generator.fixups);
+		memory::release(generator.block_labels);
+		memory::release(generator.jump_table_entries);
+		memory::release(generator.unwind_codes);
+		memory::release(generator.constant_definitions);
+	};
+
+	generator.ir = &ir;
+	generator.function = &function;
+	generator.allocation = &allocation;
+	generator.use_red_zone = use_red_zone;
+
+	// Functions may not be in SSA form, registers written more than once aren't constants. Arguments are defined
+	// by the caller.
+	constexpr uint32_t not_a_constant = invalid_register - 1;
+
+	memory::resize_array(generator.constant_definitions, memory::get_array_size(function.registers));
+	for (size_t i = 0; i < memory::get_array_size(function.registers); i++) {
+		generator.constant_definitions[i] = invalid_register;
+	}
+	for (size_t i = 0; i < memory::get_array_size(function.instructions); i++) {
+		const IR_Instruction& instruction = function.instructions[i];
+
+		if (instruction.destination == invalid_register || instruction.opcode == IR_Opcode::NOP) {
+			continue;
+		}
+
+		uint32_t& definition = generator.constant_definitions[instruction.destination];
+
+		if (instruction.destination < function.nb_arguments || definition != invalid_register || instruction.opcode != IR_Opcode::CONSTANT
+			|| uses_xmm_register(instruction.type)) {
+			definition = not_a_constant;
+		}
+		else {
+			definition = (uint32_t)i;
+		}
+	}
+	for (size_t i = 0; i < memory::get_array_size(function.registers); i++) {
+		if (generator.constant_definitions[i] == not_a_constant) {
+			generator.constant_definitions[i] = invalid_register;
+		}
+	}
+
+	uint32_t nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+
+	memory::resize_array(generator.block_labels, nb_blocks);
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		generator.block_labels[i] = create_label(generator.assembler);
+	}
+	generator.epilogue_label = create_label(generator.assembler);
+
+	// The code of functions that are unlikely to be called is entirely cold
+	bool is_cold_function = function.is_no_return || function.is_cold;
+
+	if (is_cold_function) {
+		begin_cold_part(generator.assembler);
+	}
+
+	compute_frame(generator);
+	emit_prologue(generator);
+
+	// Blocks are in the order of the arena, so most jumps fall through. Hot blocks are followed by the epilogue, then
+	// by cold blocks (the entry block is never cold).
+	uint32_t previous_block = invalid_block;
+
+	core::Assert(function.blocks[0].is_cold == false);
+
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		if (function.blocks[i].is_cold == false) {
+			if (previous_block != invalid_block) {
+				emit_block(generator, previous_block, i);
+			}
+			previous_block = i;
+		}
+	}
+	emit_block(generator, previous_block, nb_blocks);
+
+	bind_label(generator.assembler, generator.epilogue_label);
+	emit_epilogue(generator);
+
+	previous_block = invalid_block;
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		if (function.blocks[i].is_cold) {
+			if (previous_block == invalid_block) {
+				if (is_cold_function == false) {
+					begin_cold_part(generator.assembler);
+				}
+			}
+			else {
+				emit_block(generator, previous_block, i);
+			}
+			previous_block = i;
+		}
+	}
+	if (previous_block != invalid_block) {
+		emit_block(generator, previous_block, invalid_block);
+	}
+
+	// Offsets of fixups are moved by branches inserted before them
+	uint32_t code_start = (uint32_t)memory::get_array_size(function_code.code);
+	uint32_t first_jump_table_entry = (uint32_t)memory::get_array_size(function_code.jump_table_entries);
+
+	relax_branches(generator.assembler, function_code.code);
+
+	uint32_t code_end = (uint32_t)memory::get_array_size(function_code.code);
+	uint32_t cold_part_offset = get_relaxed_cold_part_offset(generator.assembler);
+
+	function_code.cold_part_start = cold_part_offset == unbound_label ? code_end : code_start + cold_part_offset;
+
+	for (size_t i = 0; i < memory::get_array_size(generator.fixups); i++) {
+		Code_Fixup	fixup = generator.fixups[i];
+		uint32_t	displacement_to_end = fixup.instruction_end - fixup.displacement_offset;
+
+		// Branches are never inserted inside an instruction, so its displacement and its end move together
+		fixup.displacement_offset = code_start + get_relaxed_offset(generator.assembler, fixup.displacement_offset);
+		fixup.instruction_end = fixup.displacement_offset + displacement_to_end;
+		if (fixup.kind == Code_Fixup::Kind::JUMP_TABLE) {
+			fixup.index += first_jump_table_entry;
+		}
+		memory::array_push_back(function_code.fixups, fixup);
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(generator.jump_table_entries); i++) {
+		Jump_Table_Entry entry = generator.jump_table_entries[i];
+
+		entry.first_entry += first_jump_table_entry;
+		entry.target = code_start + get_relaxed_label_offset(generator.assembler, entry.target);
+		memory::array_push_back(function_code.jump_table_entries, entry);
+	}
+
+	// Branches between the parts are rel32, their displacement is the last 4 bytes of the instruction
+	for (uint32_t i = 0; i < (uint32_t)memory::get_array_size(generator.assembler.branches); i++) {
+		if (crosses_parts(generator.assembler, i) == false) {
+			continue;
+		}
+
+		const Label_Reference&	branch = generator.assembler.branches[i];
+		Code_Fixup				fixup;
+
+		fixup.kind = Code_Fixup::Kind::SPLIT_BRANCH;
+		fixup.instruction_end = code_start + branch.relaxed_offset + branch.instruction_size;
+		fixup.displacement_offset = fixup.instruction_end - sizeof(int32_t);
+		fixup.index = code_start + get_relaxed_label_offset(generator.assembler, branch.label);
+		memory::array_push_back(function_code.fixups, fixup);
+	}
+
+	// Functions without prologue are leaf functions for the unwinder, the return address is at [rsp]
+	if (generator.prologue_size && generator.is_in_red_zone == false) {
+		if (function_code.cold_part_start > code_start) {
+			write_unwind_info(generator, function_code, code_start, function_code.cold_part_start, generator.prologue_size);
+		}
+		if (function_code.cold_part_start < code_end) {
+			write_unwind_info(generator, function_code, function_code.cold_part_start, code_end, is_cold_function ? generator.prologue_size : 0);
+		}
+	}
+}
+
+// Functions are distributed to workers one by one (their sizes are too different to split them in ranges), each one
+// has its own code buffer, so the merge doesn't depend on which thread generated a function.
+struct Code_Generation_Job
+{
+	IR*								ir;
+	memory::Array<Function_Code>	functions_code;	// Per function of the IR
+	system::Mutex					mutex;
+	uint32_t						next_function;	// Protected by the mutex
+	bool							use_red_zone;
+};
+
+static bool has_code(const IR_Function& function)
+{
+	return function.imported_function == nullptr && memory::is_array_empty(function.blocks) == false;
+}
+
+// Only the function being generated is modified by the register allocation, other functions are only read to
+// know if a call targets an imported function.
+static void code_generation_worker(void* parameter)
+{
+	ZoneScopedN("code_generation_worker");
+
+	Code_Generation_Job&	job = *(Code_Generation_Job*)parameter;
+	uint32_t				nb_functions = (uint32_t)memory::get_array_size(job.ir->functions);
+	Register_Allocation		allocation;
+
+	defer {
+		release(allocation);
+	};
+
+	while (true) {
+		system::lock(job.mutex);
+		uint32_t index = job.next_function++;
+		system::unlock(job.mutex);
+
+		if (index >= nb_functions) {
+			break;
+		}
+
+		IR_Function& function = job.ir->functions[index];
+
+		if (has_code(function)) {
+			allocate_registers(function, allocation);
+			generate_function_code(*job.ir, function, allocation, job.functions_code[index], job.use_red_zone);
+		}
+	}
+}
+
+// Offset in the program of an offset in the code of a function
+static uint32_t get_program_offset(const Function_Code& function_code, uint32_t hot_part_offset, uint32_t cold_part_offset, uint32_t offset)
+{
+	if (offset < function_code.cold_part_start) {
+		return hot_part_offset + offset;
+	}
+	return cold_part_offset + (offset - function_code.cold_part_start);
+}
+
+// Copy a part of the code of a function in the program, with its fixups and unwind entries. Branches between the
+// parts are resolved, fixups of a part are in the part (instruction_end can be the end of the part).
+static void merge_code_part(Function_Code& program_code, const Function_Code& function_code, bool is_cold_part, uint32_t hot_part_offset, uint32_t cold_part_offset,
+	uint32_t unwind_info_offset, uint32_t first_jump_table_entry)
+{
+	uint32_t part_start = is_cold_part ? function_code.cold_part_start : 0;
+	uint32_t part_end = is_cold_part ? (uint32_t)memory::get_array_size(function_code.code) : function_code.cold_part_start;
+	uint32_t part_offset = is_cold_part ? cold_part_offset : hot_part_offset;
+
+	if (part_start == part_end) {
+		return;
+	}
+
+	system::memory_copy(memory::get_array_data(program_code.code) + part_offset, memory::get_array_data(function_code.code) + part_start, part_end - part_start);
+
+	for (size_t j = 0; j < memory::get_array_size(function_code.fixups); j++) {
+		Code_Fixup fixup = function_code.fixups[j];
+
+		if (fixup.displacement_offset < part_start || fixup.displacement_offset >= part_end) {
+			continue;
+		}
+
+		fixup.displacement_offset = part_offset + (fixup.displacement_offset - part_start);
+		fixup.instruction_end = part_offset + (fixup.instruction_end - part_start);
+
+		if (fixup.kind == Code_Fixup::Kind::SPLIT_BRANCH) {
+			int32_t displacement = (int32_t)get_program_offset(function_code, hot_part_offset, cold_part_offset, fixup.index) - (int32_t)fixup.instruction_end;
+			system::memory_copy(memory::get_array_data(program_code.code) + fixup.displacement_offset, &displacement, sizeof(displacement));
+			continue;
+		}
+		else if (fixup.kind == Code_Fixup::Kind::JUMP_TABLE) {
+			fixup.index += first_jump_table_entry;
+		}
+		memory::array_push_back(program_code.fixups, fixup);
+	}
+
+	for (size_t j = 0; j < memory::get_array_size(function_code.unwind_entries); j++) {
+		Unwind_Entry unwind_entry = function_code.unwind_entries[j];
+
+		if (unwind_entry.function_start < part_start || unwind_entry.function_start >= part_end) {
+			continue;
+		}
+
+		unwind_entry.function_start = part_offset + (unwind_entry.function_start - part_start);
+		unwind_entry.function_end = part_offset + (unwind_entry.function_end - part_start);
+		unwind_entry.unwind_info_offset += unwind_info_offset;
+		memory::array_push_back(program_code.unwind_entries, unwind_entry);
+	}
+}
+
+void f::x64::generate_program_code(IR& ir, Function_Code& program_code, memory::Array<uint32_t>& function_offsets, uint32_t nb_threads, bool use_red_zone)
+{
+	ZoneScopedN("f::x64::generate_program_code");
+
+	Code_Generation_Job				job;
+	memory::Array<system::Thread>	workers;
+	memory::Array<uint32_t>			cold_part_offsets;
+	memory::Array<uint32_t>			unwind_info_offsets;
+	memory::Array<uint32_t>			first_jump_table_entries;
+	uint32_t						nb_functions = (uint32_t)memory::get_array_size(ir.functions);
+
+	defer {
+		for (size_t i = 0; i < memory::get_array_size(job.functions_code); i++) {
+			release(job.functions_code[i]);
+		}
+		memory::release(job.functions_code);
+		memory::release(workers);
+		memory::release(cold_part_offsets);
+		memory::release(unwind_info_offsets);
+		memory::release(first_jump_table_entries);
+	};
+
+	job.ir = &ir;
+	job.next_function = 0;
+	job.use_red_zone = use_red_zone;
+	system::init(job.mutex);
+	memory::resize_array(job.functions_code, nb_functions);
+	for (uint32_t i = 0; i < nb_functions; i++) {
+		memory::init(job.functions_code[i].code);
+		memory::init(job.functions_code[i].fixups);
+		memory::init(job.functions_code[i].unwind_entries);
+		memory::init(job.functions_code[i].unwind_info);
+		memory::init(job.functions_code[i].jump_table_entries);
+	}
+
+	{
+		ZoneScopedN("Generate functions");
+
+		if (nb_threads == 0) {
+			nb_threads = system::get_nb_hardware_threads();
+		}
+
+		// The calling thread also generates functions
+		uint32_t nb_workers = nb_threads > 1 ? nb_threads - 1 : 0;
+
+		if (nb_workers > max_nb_code_generation_workers) {
+			nb_workers = max_nb_code_generation_workers;
+		}
+		if (nb_workers + 1 > nb_functions) {
+			nb_workers = nb_functions > 1 ? nb_functions - 1 : 0;
+		}
+
+		memory::resize_array(workers, nb_workers);
+		for (uint32_t i = 0; i < nb_workers; i++) {
+			system::create_thread(workers[i], &code_generation_worker, &job);
+		}
+
+		code_generation_worker(&job);
+
+		for (uint32_t i = 0; i < nb_workers; i++) {
+			system::join_thread(workers[i]);
+		}
+	}
+
+	{
+		ZoneScopedN("Merge functions");
+
+		// Functions are concatenated in the order of the IR (or IR::code_order), so the program doesn't depend on the
+		// number of threads. Hot parts are first, then cold parts in the same order.
+		size_t code_start = memory::get_array_size(program_code.code);
+		size_t code_end = code_start;
+		size_t fixups_start = memory::get_array_size(program_code.fixups);
+		size_t nb_fixups = fixups_start;
+		bool is_ordered = !memory::is_array_empty(ir.code_order);
+
+		core::Assert(!is_ordered || memory::get_array_size(ir.code_order) == nb_functions);
+
+		memory::resize_array(function_offsets, nb_functions);
+		memory::resize_array(cold_part_offsets, nb_functions);
+		memory::resize_array(unwind_info_offsets, nb_functions);
+		for (uint32_t k = 0; k < nb_functions; k++) {
+			uint32_t i = is_ordered ? ir.code_order[k] : k;
+
+			function_offsets[i] = invalid_code_offset;
+			if (has_code(ir.functions[i]) == false) {
+				continue;
+			}
+
+			const Function_Code& function_code = job.functions_code[i];
+
+			if (function_code.cold_part_start > 0) {
+				code_end = align((uint32_t)code_end, function_alignment);
+				function_offsets[i] = (uint32_t)code_end;
+				code_end += function_code.cold_part_start;
+			}
+			nb_fixups += memory::get_array_size(function_code.fixups);
+		}
+
+		program_code.cold_part_start = (uint32_t)code_end;
+
+		for (uint32_t k = 0; k < nb_functions; k++) {
+			uint32_t i = is_ordered ? ir.code_order[k] : k;
+
+			if (has_code(ir.functions[i]) == false) {
+				continue;
+			}
+
+			const Function_Code& function_code = job.functions_code[i];
+
+			// Cold functions begin in the cold part, it is aligned as the other functions
+			if (function_code.cold_part_start == 0) {
+				code_end = align((uint32_t)code_end, function_alignment);
+				function_offsets[i] = (uint32_t)code_end;
+			}
+			cold_part_offsets[i] = (uint32_t)code_end;
+			code_end += memory::get_array_size(function_code.code) - function_code.cold_part_start;
+		}
+
+		memory::resize_array(program_code.code, code_end);
+		memory::reserve_array(program_code.fixups, nb_fixups);
+		system::fill_memory(memory::get_array_data(program_code.code) + code_start, code_end - code_start, padding_byte);
+
+		// UNWIND_INFO structures are 4 bytes aligned, so they stay aligned once concatenated. Jump tables are in the
+		// order of functions.
+		memory::resize_array(first_jump_table_entries, nb_functions);
+		for (uint32_t k = 0; k < nb_functions; k++) {
+			uint32_t i = is_ordered ? ir.code_order[k] : k;
+
+			if (has_code(ir.functions[i])) {
+				const Function_Code& function_code = job.functions_code[i];
+
+				unwind_info_offsets[i] = (uint32_t)memory::get_array_size(program_code.unwind_info);
+				memory::array_copy(program_code.unwind_info, unwind_info_offsets[i], function_code.unwind_info);
+
+				first_jump_table_entries[i] = (uint32_t)memory::get_array_size(program_code.jump_table_entries);
+				for (size_t j = 0; j < memory::get_array_size(function_code.jump_table_entries); j++) {
+					Jump_Table_Entry entry = function_code.jump_table_entries[j];
+
+					entry.first_entry += first_jump_table_entries[i];
+					entry.target = get_program_offset(function_code, function_offsets[i], cold_part_offsets[i], entry.target);
+					memory::array_push_back(program_code.jump_table_entries, entry);
+				}
+			}
+		}
+
+		// Unwind entries stay sorted, as the parts
+		for (uint32_t part = 0; part < 2; part++) {
+			for (uint32_t k = 0; k < nb_functions; k++) {
+				uint32_t i = is_ordered ? ir.code_order[k] : k;
+
+				if (has_code(ir.functions[i])) {
+					merge_code_part(program_code, job.functions_code[i], part == 1, function_offsets[i], cold_part_offsets[i], unwind_info_offsets[i], first_jump_table_entries[i]);
+				}
+			}
+		}
+
+		// Calls between functions of the program are resolved, other fixups are kept for the backend
+		nb_fixups = fixups_start;
+
+		for (size_t i = fixups_start; i < memory::get_array_size(program_code.fixups); i++) {
+			const Code_Fixup& fixup = program_code.fixups[i];
+
+			if (fixup.kind != Code_Fixup::Kind::FUNCTION) {
+				program_code.fixups[nb_fixups++] = fixup;
+				continue;
+			}
+
+			if (function_offsets[fixup.index] == invalid_code_offset) {
+				report_error(Compiler_Error::internal_error, "x64 code generator: call of a function that doesn't have code.");
+			}
+
+			int32_t displacement = (int32_t)function_offsets[fixup.index] - (int32_t)fixup.instruction_end;
+			system::memory_copy(memory::get_array_data(program_code.code) + fixup.displacement_offset, &displacement, sizeof(displacement));
+		}
+		memory::resize_array(program_code.fixups, nb_fixups);
+	}
+}
+
+void f::x64::release(Function_Code& function_code)
+{
+	memory::release(function_code.code);
+	memory::release(function_code.fixups);
+	memory::release(function_code.unwind_entries);
+	memory::release(function_code.unwind_info);
+	memory::release(function_code.jump_table_entries);
+}
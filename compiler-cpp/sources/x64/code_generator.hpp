@@ -0,0 +1,100 @@
+#pragma once
+
+#include "assembler.hpp"
+
+// Instruction selection of IR functions
+//
+// Each IR instruction is lowered to a few x64 instructions with the locations given by the register allocation,
+// moves of the allocation are emitted around them. Functions don't have a frame pointer (RBP is allocated as any
+// other non volatile register), the frame is addressed from RSP once the prologue is done:
+//   [rsp + ...]		incoming argument i (the 4 first ones are the shadow space of arguments passed in registers)
+//   [rsp + ...]		return address, then saved non volatile general purpose registers (pushed)
+//   [rsp + ...]		scratch slot, then stack slots
+//   [rsp + ...]		saved XMM registers (16 bytes aligned)
+//   [rsp + 8i]			outgoing argument i, the 4 first ones are the shadow space of the callee
+// Leaf functions that don't need any of them don't have a prologue. With the red zone, the frame of leaf functions
+// is below RSP (only registers are pushed).
+//
+// Addresses that are only known once the program is laid out (other functions, imported functions and literals)
+// are left as fixups, the displacement is always 32 bits and relative to the end of the instruction:
+//   - call rel32				for functions of the program,
+//   - call [rip + disp32]		for imported functions, the displacement targets the slot of the function address (IAT),
+//   - lea reg, [rip + disp32]	for literals and addresses of functions of the program,
+//   - mov reg, [rip + disp32]	for addresses of imported functions (hoisted out of loops, then called with call reg),
+//   - add [rip + disp32], 1	for profile counters,
+//   - lea r11, [rip + disp32]	for jump tables, the backend places them after the literals (8 bytes aligned).
+//
+// A SWITCH adds the entry of its jump table to the address of the table, then jumps to the sum. Entries are 64 bits
+// offsets of the targets from the beginning of the table, so the table doesn't need relocations.
+//
+// Cold blocks (IR_Basic_Block::is_cold) are emitted after the epilogue, in the cold part of the function, the whole
+// function is cold with the no_return or cold modifier. generate_program_code places the cold parts of all functions
+// after the hot code of all functions, branches between the parts of a function are jmp/jcc rel32. The cold part has
+// its own unwind entry, it only runs once the prologue is done.
+
+namespace f
+{
+	namespace x64
+	{
+		struct Code_Fixup
+		{
+			enum class Kind : uint8_t
+			{
+				FUNCTION,			// index is the function in IR::functions
+				IMPORTED_FUNCTION,	// index is the function in IR::functions
+				LITERAL,			// index is the literal in ReadOnlyData::literals
+				PROFILE_COUNTER,	// index is the counter, 64 bits counters are in writable memory (-profile-generate)
+				SPLIT_BRANCH,		// index is the target in the code of the function, resolved when its parts are placed
+				JUMP_TABLE,			// index is the first entry of the table in Function_Code::jump_table_entries
+			};
+
+			Kind		kind;
+			uint32_t	displacement_offset;	// In the code
+			uint32_t	instruction_end;		// Value of RIP when the instruction is executed
+			uint32_t	index;
+		};
+
+		// RUNTIME_FUNCTION of the Windows x64 exception handling (.pdata), functions without prologue don't have one
+		struct Unwind_Entry
+		{
+			uint32_t	function_start;		// In the code
+			uint32_t	function_end;
+			uint32_t	unwind_info_offset;	// In Function_Code::unwind_info
+		};
+
+		// Tables are contiguous ranges of entries, the backend writes target - (address of the table)
+		struct Jump_Table_Entry
+		{
+			uint32_t	first_entry;	// Of the table of the entry
+			uint32_t	target;			// In the code
+		};
+
+		struct Function_Code
+		{
+			fstd::memory::Array<uint8_t>			code;
+			fstd::memory::Array<Code_Fixup>			fixups;
+			fstd::memory::Array<Unwind_Entry>		unwind_entries;	// Sorted by function_start
+			fstd::memory::Array<uint8_t>			unwind_info;	// UNWIND_INFO structures (.xdata), 4 bytes aligned
+			fstd::memory::Array<Jump_Table_Entry>	jump_table_entries;
+			uint32_t								cold_part_start;	// In the code, the code after it is cold (the end of the code if there isn't cold code)
+		};
+
+		static constexpr uint32_t	invalid_code_offset = 0xffffffff;
+
+		// Registers of the function have to be allocated, the code is appended to function_code.
+		// use_red_zone is for systems that keep the 128 bytes below RSP (System V ABI), Windows doesn't. Unwind
+		// information isn't generated for frames in the red zone.
+		void generate_function_code(const IR& ir, const IR_Function& function, const Register_Allocation& allocation, Function_Code& function_code, bool use_red_zone = false);
+
+		// Allocate registers and generate the code of all functions of the program (imported ones excepted), functions
+		// are 16 bytes aligned in program_code, in the order of IR::code_order if it isn't empty. Their cold parts follow
+		// in the same order. Calls between functions and branches between parts are resolved, fixups of imported
+		// functions, literals and jump tables are left to the backend.
+		// function_offsets[i] is the offset of the function i, invalid_code_offset if the function isn't in the code.
+		// Functions are generated in parallel by nb_threads threads (0 for the number of hardware threads), the code is
+		// the same whatever the number of threads.
+		void generate_program_code(IR& ir, Function_Code& program_code, fstd::memory::Array<uint32_t>& function_offsets, uint32_t nb_threads = 0, bool use_red_zone = false);
+
+		void release(Function_Code& function_code);
+	}
+}
@@ -0,0 +1,481 @@
+#include "encoder.hpp"
+
+#include "../globals.hpp"
+#include "../instruction_db_loader.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/string_view.hpp>
+
+#include <fstd/system/allocator.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <limits>
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::x64;
+
+using x86_DB::Instruction;
+
+// Names of the instructions in the database
+static const char* mnemonic_names[] = {
+	"ADD",
+	"SUB",
+	"IMUL",
+	"MUL",
+	"IDIV",
+	"DIV",
+	"NEG",
+	"NOT",
+	"AND",
+	"OR",
+	"XOR",
+	"CMP",
+	"TEST",
+	"SHL",
+	"SHR",
+	"SAR",
+	"BTC",
+	"MOV",
+	"MOVZX",
+	"MOVSX",
+	"MOVSXD",
+	"LEA",
+	"PUSH",
+	"POP",
+	"CALL",
+	"JMP",
+	"Jcc",
+	"SETcc",
+	"CMOVcc",
+	"RET",
+	"CDQ",
+	"CQO",
+	"NOP",
+	"INT3",
+	"SYSCALL",
+
+	"MOVSS",
+	"MOVSD",
+	"MOVD",
+	"MOVQ",
+	"MOVAPS",
+	"ADDSS",
+	"ADDSD",
+	"SUBSS",
+	"SUBSD",
+	"MULSS",
+	"MULSD",
+	"DIVSS",
+	"DIVSD",
+	"UCOMISS",
+	"UCOMISD",
+	"XORPS",
+	"XORPD",
+	"CVTSI2SS",
+	"CVTSI2SD",
+	"CVTTSS2SI",
+	"CVTTSD2SI",
+	"CVTSS2SD",
+	"CVTSD2SS",
+
+	"MOVUPS",
+	"ADDPS",
+	"ADDPD",
+	"SUBPS",
+	"SUBPD",
+	"MULPS",
+	"MULPD",
+	"DIVPS",
+	"DIVPD",
+	"PADDB",
+	"PADDW",
+	"PADDD",
+	"PADDQ",
+	"PSUBB",
+	"PSUBW",
+	"PSUBD",
+	"PSUBQ",
+	"PMULLW",
+	"PMULLD",
+	"PXOR",
+	"PUNPCKLQDQ",
+	"PSHUFD",
+	"PSHUFLW",
+	"SHUFPS",
+	"SHUFPD",
+	"INSERTPS",
+	"PINSRB",
+	"PINSRW",
+	"PINSRD",
+	"PINSRQ",
+	"PEXTRB",
+	"PEXTRW",
+	"PEXTRD",
+	"PEXTRQ",
+};
+
+static_assert(sizeof(mnemonic_names) / sizeof(mnemonic_names[0]) == (size_t)Mnemonic::COUNT, "A name is missing for a mnemonic");
+
+struct Form_Range
+{
+	uint32_t	first;	// In forms
+	uint32_t	count;
+};
+
+// Filled by initialize_encoder, then only read
+static memory::Array<Instruction>	forms;	// Grouped by mnemonic, in the order of the database
+static Form_Range					form_ranges[(size_t)Mnemonic::COUNT];
+
+struct Encoding
+{
+	uint8_t				bytes[15];	// Maximum size of an instruction
+	Encoded_Instruction	info;
+};
+
+void f::x64::initialize_encoder()
+{
+	ZoneScopedN("f::x64::initialize_encoder");
+
+	x86_DB::load_x86_instruction_DB();
+
+	memory::Array<Instruction>& instructions = globals.x86_db_data.instructions;
+
+	// @SpeedUp forms of a mnemonic are found with string comparisons, the loader could sort instructions by name
+	for (size_t mnemonic = 0; mnemonic < (size_t)Mnemonic::COUNT; mnemonic++) {
+		language::string_view name;
+
+		language::assign(name, (uint8_t*)mnemonic_names[mnemonic]);
+
+		form_ranges[mnemonic].first = (uint32_t)memory::get_array_size(forms);
+		for (size_t i = 0; i < memory::get_array_size(instructions); i++) {
+			if (language::are_equals(instructions[i].name, name)) {
+				memory::array_push_back(forms, instructions[i]);
+			}
+		}
+		form_ranges[mnemonic].count = (uint32_t)memory::get_array_size(forms) - form_ranges[mnemonic].first;
+
+		if (form_ranges[mnemonic].count == 0) {
+			report_error(Compiler_Error::internal_error, "x64 encoder: an instruction is missing from the instruction database.");
+		}
+	}
+}
+
+inline bool is_xmm(Physical_Register physical_register)
+{
+	return physical_register >= Physical_Register::XMM0 && physical_register < Physical_Register::COUNT;
+}
+
+static bool match_operand(const Instruction& form, uint8_t operand_index, const Operand& operand)
+{
+	using Type = Instruction::Operand::Type;
+	using Register_Class = Instruction::Operand::Register_Class;
+
+	const Instruction::Operand&	type = form.operands[operand_index];
+	uint8_t						type_flags = (uint8_t)type.type;
+	bool						is_relative = form.translation_instructions.immediate_kind == Instruction::Immediate_Kind::RELATIVE;
+
+	switch (operand.kind)
+	{
+	case Operand::Kind::REGISTER:
+		if ((type_flags & (uint8_t)Type::REGISTER) == 0) {
+			return false;
+		}
+		if (is_xmm(operand.base)) {
+			if (type.register_class != Register_Class::XMM) {
+				return false;
+			}
+		}
+		else if (type.register_class != Register_Class::GENERAL_PURPOSE || type.size != operand.size) {
+			return false;
+		}
+		return type.fixed_register == Instruction::any_register || type.fixed_register == get_register_encoding(operand.base);
+	case Operand::Kind::MEMORY:
+		if ((type_flags & (uint8_t)Type::MEMORY_ADDRESS) == 0) {
+			return false;
+		}
+		return type.size == 0 || operand.size == 0 || type.size == operand.size;
+	case Operand::Kind::IMMEDIATE:
+		if (type.type == Type::UNITY) {
+			return operand.value == 1;
+		}
+		return type.type == Type::IMMEDIATE_VALUE && is_relative == false;
+	case Operand::Kind::RELATIVE:
+		return type.type == Type::IMMEDIATE_VALUE && is_relative
+			&& (operand.size == 0 || operand.size == form.translation_instructions.immediate_size);
+	default:
+		return false;
+	}
+}
+
+// Value computed by the processor, immediate values are truncated to the operation size
+static int64_t truncate_to_operation_size(int64_t value, uint8_t operation_size)
+{
+	switch (operation_size)
+	{
+	case 1:
+		return (int8_t)value;
+	case 2:
+		return (int16_t)value;
+	case 4:
+		return (int32_t)value;
+	default:
+		return value;
+	}
+}
+
+static bool immediate_fits(int64_t value, uint8_t size, Instruction::Immediate_Kind kind, uint8_t operation_size, bool rex_w)
+{
+	switch (size)
+	{
+	case 1:
+		if (kind == Instruction::Immediate_Kind::SIGNED) {
+			return value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max();
+		}
+		if (kind == Instruction::Immediate_Kind::UNSIGNED) {
+			return value >= 0 && value <= std::numeric_limits<uint8_t>::max();
+		}
+		return value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<uint8_t>::max();
+	case 2:
+		if (kind == Instruction::Immediate_Kind::SIGNED) {
+			return value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<int16_t>::max();
+		}
+		if (kind == Instruction::Immediate_Kind::UNSIGNED) {
+			return value >= 0 && value <= std::numeric_limits<uint16_t>::max();
+		}
+		return value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<uint16_t>::max();
+	case 4:
+		if (operation_size < 8) {
+			return true;
+		}
+		// 64 bit operations sign extend their 32 bit immediate values, except mov r32, imm32 that is zero extended
+		if (kind == Instruction::Immediate_Kind::SIGNED || rex_w) {
+			return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+		}
+		return value >= 0 && value <= std::numeric_limits<uint32_t>::max();
+	default:
+		return true;
+	}
+}
+
+static inline void write_value(Encoding& encoding, int64_t value, uint8_t size)
+{
+	for (uint8_t i = 0; i < size; i++) {
+		encoding.bytes[encoding.info.size++] = (uint8_t)((uint64_t)value >> (8 * i));
+	}
+}
+
+// Return false if an immediate value or a relative distance doesn't fit in the form
+static bool encode_form(const Instruction& form, Condition_Code condition, const Operand* operands, uint8_t nb_operands, Encoding& encoding)
+{
+	const Instruction::Translation_Instructions& translation = form.translation_instructions;
+
+	const Operand*	register_operand = nullptr;		// In the reg field of ModR/M or in the opcode
+	const Operand*	rm_operand = nullptr;
+	const Operand*	immediate_operand = nullptr;
+	uint8_t			operation_size = 8;
+	bool			force_rex = false;
+
+	for (uint8_t i = 0; i < nb_operands; i++) {
+		uint8_t role = translation.operand_roles[i];
+
+		if ((role & Instruction::ROLE_REGISTER) && register_operand == nullptr) {
+			register_operand = &operands[i];
+		}
+		if ((role & Instruction::ROLE_RM) && rm_operand == nullptr) {
+			rm_operand = &operands[i];
+		}
+		if (role & Instruction::ROLE_IMMEDIATE) {
+			immediate_operand = &operands[i];
+		}
+
+		// spl, bpl, sil and dil need a REX prefix, they are ah, ch, dh and bh without it
+		if (operands[i].kind == Operand::Kind::REGISTER && operands[i].size == 1 && is_xmm(operands[i].base) == false
+			&& get_register_encoding(operands[i].base) >= 4 && get_register_encoding(operands[i].base) < 8) {
+			force_rex = true;
+		}
+	}
+
+	if (nb_operands > 0 && operands[0].size != 0
+		&& ((operands[0].kind == Operand::Kind::REGISTER && is_xmm(operands[0].base) == false) || operands[0].kind == Operand::Kind::MEMORY)) {
+		operation_size = operands[0].size;
+	}
+
+	// Operands of push imm, ret imm,... don't give the operation size, it isn't 16 bits
+	if (translation.operand_size_prefix && operation_size != 2) {
+		return false;
+	}
+
+	encoding.info = {};
+
+	// Prefixes
+	if (translation.operand_size_prefix) {
+		encoding.bytes[encoding.info.size++] = 0x66;
+	}
+	for (uint8_t i = 0; i < translation.nb_prefixes; i++) {
+		encoding.bytes[encoding.info.size++] = translation.prefixes[i];
+	}
+
+	uint8_t rex = translation.rex_w ? 0x08 : 0x00;
+	if (register_operand && (get_register_encoding(register_operand->base) & 0x08)) {
+		rex |= translation.register_in_opcode ? 0x01 : 0x04; // B or R
+	}
+	if (rm_operand) {
+		if (rm_operand->kind == Operand::Kind::REGISTER) {
+			if (get_register_encoding(rm_operand->base) & 0x08) {
+				rex |= 0x01; // B
+			}
+		}
+		else if (rm_operand->rip_relative == false) {
+			if (rm_operand->base != Physical_Register::COUNT && (get_register_encoding(rm_operand->base) & 0x08)) {
+				rex |= 0x01; // B
+			}
+			if (rm_operand->index != Physical_Register::COUNT && (get_register_encoding(rm_operand->index) & 0x08)) {
+				rex |= 0x02; // X
+			}
+		}
+	}
+	if (rex || force_rex) {
+		encoding.bytes[encoding.info.size++] = 0x40 | rex;
+	}
+
+	// Opcode
+	for (uint8_t i = 0; i < translation.opcode_size; i++) {
+		encoding.bytes[encoding.info.size++] = translation.opcode[i];
+	}
+	if (translation.register_in_opcode) {
+		encoding.bytes[encoding.info.size - 1] += get_register_encoding(register_operand->base) & 0x07;
+	}
+	if (translation.condition_in_opcode) {
+		encoding.bytes[encoding.info.size - 1] += (uint8_t)condition;
+	}
+
+	// ModR/M, SIB and displacement
+	if (translation.extra_data != Instruction::no_modrm) {
+		uint8_t reg = translation.extra_data == Instruction::modrm_register ? get_register_encoding(register_operand->base) & 0x07 : translation.extra_data;
+
+		if (rm_operand->kind == Operand::Kind::REGISTER) {
+			encoding.bytes[encoding.info.size++] = 0xc0 | (reg << 3) | (get_register_encoding(rm_operand->base) & 0x07);
+		}
+		else {
+			uint8_t scale_bits = rm_operand->scale == 8 ? 3 : rm_operand->scale == 4 ? 2 : rm_operand->scale == 2 ? 1 : 0;
+			uint8_t index_bits = 0x04; // No index
+
+			core::Assert(rm_operand->scale == 1 || rm_operand->scale == 2 || rm_operand->scale == 4 || rm_operand->scale == 8);
+			if (rm_operand->index != Physical_Register::COUNT) {
+				core::Assert(rm_operand->index != Physical_Register::RSP);
+				index_bits = get_register_encoding(rm_operand->index) & 0x07;
+			}
+
+			if (rm_operand->rip_relative) {
+				encoding.bytes[encoding.info.size++] = (reg << 3) | 0x05;
+				encoding.info.displacement_size = 4;
+			}
+			else if (rm_operand->base == Physical_Register::COUNT) {
+				encoding.bytes[encoding.info.size++] = (reg << 3) | 0x04;
+				encoding.bytes[encoding.info.size++] = (scale_bits << 6) | (index_bits << 3) | 0x05; // No base, disp32
+				encoding.info.displacement_size = 4;
+			}
+			else {
+				uint8_t base_bits = get_register_encoding(rm_operand->base) & 0x07;
+				bool	need_sib = rm_operand->index != Physical_Register::COUNT || base_bits == 0x04;	// rsp and r12 are only possible with a SIB
+				uint8_t mod;
+
+				if (rm_operand->displacement == 0 && base_bits != 0x05) { // rbp and r13 without displacement mean rip or disp32
+					mod = 0;
+				}
+				else if (rm_operand->displacement >= std::numeric_limits<int8_t>::min() && rm_operand->displacement <= std::numeric_limits<int8_t>::max()) {
+					mod = 1;
+					encoding.info.displacement_size = 1;
+				}
+				else {
+					mod = 2;
+					encoding.info.displacement_size = 4;
+				}
+
+				encoding.bytes[encoding.info.size++] = (mod << 6) | (reg << 3) | (need_sib ? 0x04 : base_bits);
+				if (need_sib) {
+					encoding.bytes[encoding.info.size++] = (scale_bits << 6) | (index_bits << 3) | base_bits;
+				}
+			}
+
+			if (encoding.info.displacement_size) {
+				encoding.info.displacement_offset = encoding.info.size;
+				write_value(encoding, rm_operand->displacement, encoding.info.displacement_size);
+			}
+		}
+	}
+
+	// Immediate value
+	if (translation.immediate_size) {
+		encoding.info.immediate_offset = encoding.info.size;
+		encoding.info.immediate_size = translation.immediate_size;
+
+		if (translation.immediate_kind == Instruction::Immediate_Kind::RELATIVE) {
+			// The distance is from the end of the instruction, and the immediate value is the last thing encoded
+			int64_t distance = immediate_operand->value - (encoding.info.size + translation.immediate_size);
+
+			if (translation.immediate_size == 1
+				? distance < std::numeric_limits<int8_t>::min() || distance > std::numeric_limits<int8_t>::max()
+				: distance < std::numeric_limits<int32_t>::min() || distance > std::numeric_limits<int32_t>::max()) {
+				return false;
+			}
+			write_value(encoding, distance, translation.immediate_size);
+		}
+		else {
+			int64_t value = immediate_operand->value;
+
+			if (translation.immediate_kind != Instruction::Immediate_Kind::UNSIGNED) {
+				value = truncate_to_operation_size(value, operation_size);
+			}
+			if (immediate_fits(value, translation.immediate_size, translation.immediate_kind, operation_size, translation.rex_w) == false) {
+				return false;
+			}
+			write_value(encoding, value, translation.immediate_size);
+		}
+	}
+
+	return true;
+}
+
+Encoded_Instruction f::x64::encode_instruction(memory::Array<uint8_t>& code, Mnemonic mnemonic, Condition_Code condition, const Operand* operands, uint8_t nb_operands)
+{
+	ZoneScopedN("f::x64::encode_instruction");
+
+	const Form_Range&	range = form_ranges[(size_t)mnemonic];
+	Encoding			best;
+	Encoding			candidate;
+
+	core::Assert(range.count > 0); // initialize_encoder wasn't called
+
+	best.info = {};
+
+	// @SpeedUp every form that matches is encoded to find the shortest one, forms could be sorted by size
+	for (uint32_t i = 0; i < range.count; i++) {
+		const Instruction&	form = forms[range.first + i];
+		bool				matches = form.nb_operands == nb_operands;
+
+		for (uint8_t operand_index = 0; operand_index < nb_operands && matches; operand_index++) {
+			matches = match_operand(form, operand_index, operands[operand_index]);
+		}
+
+		if (matches
+			&& encode_form(form, condition, operands, nb_operands, candidate)
+			&& (best.info.size == 0 || candidate.info.size < best.info.size)) {
+			best = candidate;
+		}
+	}
+
+	if (best.info.size == 0) {
+		report_error(Compiler_Error::internal_error, "x64 encoder: no encoding form matches the operands of the instruction.");
+		return best.info;
+	}
+
+	size_t offset = memory::get_array_size(code);
+	memory::resize_array(code, offset + best.info.size);
+	system::memory_copy(memory::get_array_data(code) + offset, best.bytes, best.info.size);
+	return best.info;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "register_allocator.hpp"
+
+#include <fstd/memory/array.hpp>
+
+// Table driven x64 instruction encoder
+//
+// Encoding forms come from the instruction database of nasm (see instruction_db_loader.hpp), every form that
+// matches the operands is encoded and the shortest one is kept. So immediate values and displacements use their
+// 8 bit versions when they fit, implicit register forms (add eax, imm32) are taken when they are shorter,...
+//
+// Prefixes are written in this order: operand size prefix, mandatory prefixes (66, f2, f3), REX, then the opcode,
+// ModR/M, SIB, displacement and immediate value.
+
+namespace f
+{
+	namespace x64
+	{
+		enum class Mnemonic : uint8_t
+		{
+			ADD,
+			SUB,
+			IMUL,
+			MUL,
+			IDIV,
+			DIV,
+			NEG,
+			NOT,
+			AND,
+			OR,
+			XOR,
+			CMP,
+			TEST,
+			SHL,
+			SHR,
+			SAR,
+			BTC,
+			MOV,
+			MOVZX,
+			MOVSX,
+			MOVSXD,
+			LEA,
+			PUSH,
+			POP,
+			CALL,
+			JMP,
+			JCC,
+			SETCC,
+			CMOVCC,
+			RET,
+			CDQ,
+			CQO,
+			NOP,
+			INT3,
+			SYSCALL,
+
+			MOVSS,
+			MOVSD,
+			MOVD,
+			MOVQ,
+			MOVAPS,
+			ADDSS,
+			ADDSD,
+			SUBSS,
+			SUBSD,
+			MULSS,
+			MULSD,
+			DIVSS,
+			DIVSD,
+			UCOMISS,
+			UCOMISD,
+			XORPS,
+			XORPD,
+			CVTSI2SS,
+			CVTSI2SD,
+			CVTTSS2SI,
+			CVTTSD2SI,
+			CVTSS2SD,
+			CVTSD2SS,
+
+			// Vectors (SSE2, SSE4.1 for PMULLD, INSERTPS, PINSRB/D/Q and PEXTRB/D/Q)
+			MOVUPS,
+			ADDPS,
+			ADDPD,
+			SUBPS,
+			SUBPD,
+			MULPS,
+			MULPD,
+			DIVPS,
+			DIVPD,
+			PADDB,
+			PADDW,
+			PADDD,
+			PADDQ,
+			PSUBB,
+			PSUBW,
+			PSUBD,
+			PSUBQ,
+			PMULLW,
+			PMULLD,
+			PXOR,
+			PUNPCKLQDQ,
+			PSHUFD,
+			PSHUFLW,
+			SHUFPS,
+			SHUFPD,
+			INSERTPS,
+			PINSRB,
+			PINSRW,
+			PINSRD,
+			PINSRQ,
+			PEXTRB,
+			PEXTRW,
+			PEXTRD,
+			PEXTRQ,
+
+			COUNT
+		};
+
+		// Values are the encoding of the condition in Jcc, SETcc and CMOVcc
+		enum class Condition_Code : uint8_t
+		{
+			O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G,
+		};
+
+		struct Operand
+		{
+			enum class Kind : uint8_t
+			{
+				NONE,
+				REGISTER,
+				MEMORY,
+				IMMEDIATE,
+				RELATIVE,	// Jumps and calls, value is the distance from the start of the instruction to the target
+			};
+
+			Kind				kind;
+			uint8_t				size;			// In bytes, 0 for memory operands of any size (lea), 1 or 4 to force the size of relative ones
+			Physical_Register	base;			// The register of REGISTER operands, COUNT if there is no base
+			Physical_Register	index;			// COUNT if there is no index
+			uint8_t				scale;			// 1, 2, 4 or 8
+			bool				rip_relative;
+			int32_t				displacement;
+			int64_t				value;			// Immediate value or distance of relative operands
+		};
+
+		inline Operand make_register(Physical_Register physical_register, uint8_t size = 8) {
+			return { Operand::Kind::REGISTER, size, physical_register, Physical_Register::COUNT, 1, false, 0, 0 };
+		}
+
+		inline Operand make_memory(Physical_Register base, int32_t displacement, uint8_t size = 8) {
+			return { Operand::Kind::MEMORY, size, base, Physical_Register::COUNT, 1, false, displacement, 0 };
+		}
+
+		inline Operand make_memory(Physical_Register base, Physical_Register index, uint8_t scale, int32_t displacement, uint8_t size = 8) {
+			return { Operand::Kind::MEMORY, size, base, index, scale, false, displacement, 0 };
+		}
+
+		// displacement is relative to the end of the instruction, it is usually patched once addresses are known
+		inline Operand make_rip_relative(int32_t displacement, uint8_t size = 8) {
+			return { Operand::Kind::MEMORY, size, Physical_Register::COUNT, Physical_Register::COUNT, 1, true, displacement, 0 };
+		}
+
+		inline Operand make_immediate(int64_t value) {
+			return { Operand::Kind::IMMEDIATE, 0, Physical_Register::COUNT, Physical_Register::COUNT, 1, false, 0, value };
+		}
+
+		inline Operand make_relative(int64_t distance, uint8_t size = 0) {
+			return { Operand::Kind::RELATIVE, size, Physical_Register::COUNT, Physical_Register::COUNT, 1, false, 0, distance };
+		}
+
+		struct Encoded_Instruction
+		{
+			uint8_t	size;
+			uint8_t	displacement_offset;	// From the start of the instruction, 0 if there is no displacement
+			uint8_t	displacement_size;
+			uint8_t	immediate_offset;		// Also for relative operands, 0 if there is no immediate value
+			uint8_t	immediate_size;
+		};
+
+		// Load the instruction database, has to be called before encoding any instruction. Tables are read only
+		// after that, so instructions can be encoded from any thread.
+		void initialize_encoder();
+
+		// Append the shortest encoding of the instruction to code, report an internal error if no form matches
+		Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, Condition_Code condition, const Operand* operands, uint8_t nb_operands);
+
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic) {
+			return encode_instruction(code, mnemonic, Condition_Code::O, nullptr, 0);
+		}
+
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, const Operand& a) {
+			return encode_instruction(code, mnemonic, Condition_Code::O, &a, 1);
+		}
+
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, const Operand& a, const Operand& b) {
+			Operand operands[] = { a, b };
+			return encode_instruction(code, mnemonic, Condition_Code::O, operands, 2);
+		}
+
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, const Operand& a, const Operand& b, const Operand& c) {
+			Operand operands[] = { a, b, c };
+			return encode_instruction(code, mnemonic, Condition_Code::O, operands, 3);
+		}
+
+		// Jcc, SETcc and CMOVcc
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, Condition_Code condition, const Operand& a) {
+			return encode_instruction(code, mnemonic, condition, &a, 1);
+		}
+
+		inline Encoded_Instruction encode_instruction(fstd::memory::Array<uint8_t>& code, Mnemonic mnemonic, Condition_Code condition, const Operand& a, const Operand& b) {
+			Operand operands[] = { a, b };
+			return encode_instruction(code, mnemonic, condition, operands, 2);
+		}
+	}
+}
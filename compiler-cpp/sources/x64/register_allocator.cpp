@@ -0,0 +1,1453 @@
+#include "register_allocator.hpp"
+
+#include "../optimizer/optimizer.hpp"
+
+#include <fstd/core/assert.hpp>
+
+#include <fstd/language/defer.hpp>
+
+#include <tracy/Tracy.hpp>
+
+// Intervals are split at the start of instructions (multiple of 4) so moves can be inserted before them. The only
+// exception is when a register is freed for a destination: the evicted interval is stored before the instruction
+// and its part in memory starts at the definition.
+//
+// Splits at the start of a block are resolved on the control flow edges, the other ones by a move before the
+// instruction where the new part starts.
+
+using namespace fstd;
+
+using namespace f;
+using namespace f::x64;
+
+static constexpr uint32_t	invalid_position = 0xffffffff;
+static constexpr uint32_t	invalid_interval = 0xffffffff;
+static constexpr uint32_t	invalid_stack_slot = 0xffffffff;
+
+// Volatile registers are first, so intervals that don't cross calls don't use registers that have to be saved
+static const Physical_Register general_purpose_registers[] = {
+	Physical_Register::RAX, Physical_Register::RCX, Physical_Register::RDX, Physical_Register::R8,
+	Physical_Register::R9, Physical_Register::R10, Physical_Register::RBX, Physical_Register::RSI,
+	Physical_Register::RDI, Physical_Register::R12, Physical_Register::R13, Physical_Register::R14,
+	Physical_Register::R15, Physical_Register::RBP,
+};
+
+static const Physical_Register xmm_registers[] = {
+	Physical_Register::XMM0, Physical_Register::XMM1, Physical_Register::XMM2, Physical_Register::XMM3,
+	Physical_Register::XMM4, Physical_Register::XMM5, Physical_Register::XMM6, Physical_Register::XMM7,
+	Physical_Register::XMM8, Physical_Register::XMM9, Physical_Register::XMM10, Physical_Register::XMM11,
+	Physical_Register::XMM12, Physical_Register::XMM13, Physical_Register::XMM14, Physical_Register::XMM15,
+};
+
+static const Physical_Register integer_argument_registers[] = {
+	Physical_Register::RCX, Physical_Register::RDX, Physical_Register::R8, Physical_Register::R9,
+};
+
+static const uint32_t nb_register_arguments = 4;
+
+static const uint32_t volatile_registers =
+	get_register_mask(Physical_Register::RAX) | get_register_mask(Physical_Register::RCX) | get_register_mask(Physical_Register::RDX)
+	| get_register_mask(Physical_Register::R8) | get_register_mask(Physical_Register::R9) | get_register_mask(Physical_Register::R10)
+	| get_register_mask(Physical_Register::R11) | get_register_mask(Physical_Register::XMM0) | get_register_mask(Physical_Register::XMM1)
+	| get_register_mask(Physical_Register::XMM2) | get_register_mask(Physical_Register::XMM3) | get_register_mask(Physical_Register::XMM4)
+	| get_register_mask(Physical_Register::XMM5);
+
+struct Raw_Range
+{
+	uint32_t	virtual_register;
+	Live_Range	range;
+};
+
+struct Raw_Use
+{
+	uint32_t		virtual_register;
+	Use_Position	use;
+};
+
+struct Pending_Move
+{
+	uint32_t	group;	// See get_move_group
+	Move		move;
+};
+
+struct Allocator
+{
+	IR_Function*					function;
+	Register_Allocation*			allocation;
+	uint32_t						nb_words;				// Per live set
+	memory::Array<uint64_t>			live_in;				// nb_words per block
+	memory::Array<uint32_t>			instruction_block;
+	memory::Array<uint32_t>			loop_header;			// Innermost loop of each block, invalid_block outside of loops
+	memory::Array<uint32_t>			parent_loop_header;		// For headers, the header of the enclosing loop
+	memory::Array<uint32_t>			register_end;			// End of the lifetime of each virtual register
+	memory::Array<uint32_t>			call_positions;			// Positions where volatile registers are clobbered, sorted
+	memory::Array<uint32_t>			unhandled;				// Sorted by decreasing start
+	memory::Array<uint32_t>			active;					// Have a register and are alive at the current position
+	memory::Array<uint32_t>			inactive;				// Have a register and are in a lifetime hole
+	memory::Array<uint32_t>			stack_slot_of_register;
+	memory::Array<uint32_t>			stack_slot_end;			// Position where each slot becomes free
+	uint32_t						scratch_stack_slot;		// Used to break cycles of moves
+	memory::Array<Pending_Move>		pending_moves;
+};
+
+//=============================================================================
+// Intervals
+
+inline uint32_t get_start(const Register_Allocation& allocation, uint32_t interval)
+{
+	return allocation.ranges[allocation.intervals[interval].first_range].start;
+}
+
+inline uint32_t get_end(const Register_Allocation& allocation, uint32_t interval)
+{
+	const Live_Interval& live_interval = allocation.intervals[interval];
+	return allocation.ranges[live_interval.first_range + live_interval.nb_ranges - 1].end;
+}
+
+inline uint32_t get_instruction_start(uint32_t position)
+{
+	return position & ~3u;
+}
+
+static bool covers(const Register_Allocation& allocation, uint32_t interval, uint32_t position)
+{
+	const Live_Interval& live_interval = allocation.intervals[interval];
+
+	for (uint32_t i = 0; i < live_interval.nb_ranges; i++) {
+		const Live_Range& range = allocation.ranges[live_interval.first_range + i];
+
+		if (position < range.start) {
+			return false;
+		}
+		else if (position < range.end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// First position alive in both intervals
+static uint32_t get_next_intersection(const Register_Allocation& allocation, uint32_t a, uint32_t b)
+{
+	const Live_Interval&	interval_a = allocation.intervals[a];
+	const Live_Interval&	interval_b = allocation.intervals[b];
+	uint32_t				i = 0;
+	uint32_t				j = 0;
+
+	while (i < interval_a.nb_ranges && j < interval_b.nb_ranges) {
+		const Live_Range& range_a = allocation.ranges[interval_a.first_range + i];
+		const Live_Range& range_b = allocation.ranges[interval_b.first_range + j];
+
+		if (range_a.end <= range_b.start) {
+			i++;
+		}
+		else if (range_b.end <= range_a.start) {
+			j++;
+		}
+		else {
+			return range_a.start > range_b.start ? range_a.start : range_b.start;
+		}
+	}
+	return invalid_position;
+}
+
+static uint32_t get_next_use(const Register_Allocation& allocation, uint32_t interval, uint32_t position, bool requires_register)
+{
+	const Live_Interval& live_interval = allocation.intervals[interval];
+
+	for (uint32_t i = 0; i < live_interval.nb_uses; i++) {
+		const Use_Position& use = allocation.uses[live_interval.first_use + i];
+
+		if (use.position >= position && (use.requires_register || !requires_register)) {
+			return use.position;
+		}
+	}
+	return invalid_position;
+}
+
+// The new part starts at position and is linked after the interval
+static uint32_t split_interval(Register_Allocation& allocation, uint32_t interval, uint32_t position)
+{
+	core::Assert(get_start(allocation, interval) < position && position < get_end(allocation, interval));
+
+	Live_Interval	child = allocation.intervals[interval];
+	uint32_t		child_index = (uint32_t)memory::get_array_size(allocation.intervals);
+	uint32_t		nb_parent_ranges = 0;
+
+	while (allocation.ranges[child.first_range + nb_parent_ranges].end <= position) {
+		nb_parent_ranges++;
+	}
+
+	// Ranges of the new part are copied at the end, the range that contains the position is cut
+	uint32_t first_child_range = (uint32_t)memory::get_array_size(allocation.ranges);
+	for (uint32_t i = nb_parent_ranges; i < child.nb_ranges; i++) {
+		Live_Range range = allocation.ranges[child.first_range + i];
+
+		if (range.start < position) {
+			range.start = position;
+		}
+		memory::array_push_back(allocation.ranges, range);
+	}
+
+	Live_Range& cut_range = allocation.ranges[child.first_range + nb_parent_ranges];
+	if (cut_range.start < position) {
+		cut_range.end = position;
+		nb_parent_ranges++;
+	}
+
+	uint32_t nb_parent_uses = 0;
+	while (nb_parent_uses < child.nb_uses && allocation.uses[child.first_use + nb_parent_uses].position < position) {
+		nb_parent_uses++;
+	}
+
+	child.nb_ranges = (uint32_t)memory::get_array_size(allocation.ranges) - first_child_range;
+	child.first_range = first_child_range;
+	child.first_use += nb_parent_uses;
+	child.nb_uses -= nb_parent_uses;
+	child.location.kind = Location::Kind::NONE;
+
+	Live_Interval& parent = allocation.intervals[interval];
+	parent.nb_ranges = nb_parent_ranges;
+	parent.nb_uses = nb_parent_uses;
+	parent.next_split = child_index;
+
+	memory::array_push_back(allocation.intervals, child);
+	return child_index;
+}
+
+static void add_unhandled(Allocator& allocator, uint32_t interval)
+{
+	Register_Allocation&	allocation = *allocator.allocation;
+	uint32_t				start = get_start(allocation, interval);
+	size_t					index = memory::get_array_size(allocator.unhandled);
+
+	memory::array_push_back(allocator.unhandled, interval);
+	while (index > 0 && get_start(allocation, allocator.unhandled[index - 1]) < start) {
+		allocator.unhandled[index] = allocator.unhandled[index - 1];
+		index--;
+	}
+	allocator.unhandled[index] = interval;
+}
+
+static void remove_at(memory::Array<uint32_t>& array, size_t index)
+{
+	array[index] = *memory::get_array_last_element(array);
+	memory::resize_array(array, memory::get_array_size(array) - 1);
+}
+
+//=============================================================================
+// Analysis
+
+static void split_critical_edges(IR_Function& function)
+{
+	size_t	nb_blocks = memory::get_array_size(function.blocks);
+	bool	modified = false;
+
+	for (size_t i = 0; i < nb_blocks; i++) {
+		uint32_t	terminator_index = function.blocks[i].first_instruction + function.blocks[i].nb_instructions - 1;
+		uint32_t*	targets;
+		uint32_t	nb_targets = get_targets(function, function.instructions[terminator_index], targets);
+
+		if (nb_targets < 2) {
+			continue;
+		}
+
+		for (uint32_t j = 0; j < nb_targets; j++) {
+			// Targets of a branch are in the instruction, they move when a jump is added
+			get_targets(function, function.instructions[terminator_index], targets);
+
+			uint32_t target = targets[j];
+
+			if (function.blocks[target].nb_predecessors < 2) {
+				continue;
+			}
+
+			IR_Basic_Block	block = {};
+			IR_Instruction	jump = function.instructions[terminator_index];
+			uint32_t		block_index = (uint32_t)memory::get_array_size(function.blocks);
+
+			block.first_instruction = (uint32_t)memory::get_array_size(function.instructions);
+			block.nb_instructions = 1;
+			block.immediate_dominator = invalid_block;
+			block.first_dominated = invalid_block;
+			block.next_dominated = invalid_block;
+			block.is_cold = function.blocks[i].is_cold || function.blocks[target].is_cold;
+
+			jump.opcode = IR_Opcode::JUMP;
+			jump.operands[0] = invalid_register;
+			jump.immediate.targets[0] = target;
+			jump.immediate.targets[1] = 0;
+
+			memory::array_push_back(function.instructions, jump);
+			memory::array_push_back(function.blocks, block);
+			get_targets(function, function.instructions[terminator_index], targets);
+			targets[j] = block_index;
+
+			// The value of phis now comes from the new block (only one pair if both targets are the same block)
+			IR_Basic_Block& target_block = function.blocks[target];
+			for (uint32_t k = 0; k < target_block.nb_instructions; k++) {
+				IR_Instruction& phi = function.instructions[target_block.first_instruction + k];
+
+				if (phi.opcode != IR_Opcode::PHI) {
+					break;
+				}
+
+				for (uint32_t l = 0; l < phi.operands[1]; l++) {
+					if (function.operand_lists[phi.operands[0] + 2 * l] == i) {
+						function.operand_lists[phi.operands[0] + 2 * l] = block_index;
+						break;
+					}
+				}
+			}
+			modified = true;
+		}
+	}
+
+	if (modified) {
+		compute_control_flow(function);
+	}
+}
+
+static bool is_in_loop(Allocator& allocator, uint32_t block, uint32_t header)
+{
+	for (uint32_t loop = allocator.loop_header[block]; loop != invalid_block; loop = allocator.parent_loop_header[loop]) {
+		if (loop == header) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline uint64_t* get_live_set(Allocator& allocator, memory::Array<uint64_t>& sets, uint32_t block)
+{
+	return memory::get_array_element(sets, (size_t)block * allocator.nb_words);
+}
+
+inline void set_live(uint64_t* set, uint32_t register_id)
+{
+	set[register_id / 64] |= 1ull << (register_id % 64);
+}
+
+inline void clear_live(uint64_t* set, uint32_t register_id)
+{
+	set[register_id / 64] &= ~(1ull << (register_id % 64));
+}
+
+inline bool is_live(const uint64_t* set, uint32_t register_id)
+{
+	return (set[register_id / 64] >> (register_id % 64)) & 1;
+}
+
+// Live in sets of successors, plus values of their phis coming from the block
+static void compute_live_out(Allocator& allocator, uint32_t block_index, uint64_t* live_out)
+{
+	IR_Function&	function = *allocator.function;
+	const uint32_t*	successors;
+	uint32_t		nb_successors = get_successors(function, function.blocks[block_index], successors);
+
+	for (uint32_t i = 0; i < allocator.nb_words; i++) {
+		live_out[i] = 0;
+	}
+
+	for (uint32_t i = 0; i < nb_successors; i++) {
+		IR_Basic_Block&	successor = function.blocks[successors[i]];
+		uint64_t*		successor_live_in = get_live_set(allocator, allocator.live_in, successors[i]);
+
+		for (uint32_t j = 0; j < allocator.nb_words; j++) {
+			live_out[j] |= successor_live_in[j];
+		}
+
+		for (uint32_t j = 0; j < successor.nb_instructions; j++) {
+			IR_Instruction& phi = function.instructions[successor.first_instruction + j];
+
+			if (phi.opcode != IR_Opcode::PHI) {
+				break;
+			}
+
+			for (uint32_t k = 0; k < phi.operands[1]; k++) {
+				if (function.operand_lists[phi.operands[0] + 2 * k] == block_index) {
+					set_live(live_out, function.operand_lists[phi.operands[0] + 2 * k + 1]);
+				}
+			}
+		}
+	}
+}
+
+static void compute_liveness(Allocator& allocator)
+{
+	ZoneScopedN("compute_liveness");
+
+	IR_Function&			function = *allocator.function;
+	uint32_t				nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<uint64_t>	gen;	// Used before being defined in the block
+	memory::Array<uint64_t>	kill;	// Defined in the block
+	memory::Array<uint64_t>	live_out;
+
+	defer{
+		memory::release(gen);
+		memory::release(kill);
+		memory::release(live_out);
+	};
+
+	memory::resize_array(allocator.live_in, (size_t)nb_blocks * allocator.nb_words);
+	memory::resize_array(gen, (size_t)nb_blocks * allocator.nb_words);
+	memory::resize_array(kill, (size_t)nb_blocks * allocator.nb_words);
+	memory::resize_array(live_out, allocator.nb_words);
+	for (size_t i = 0; i < (size_t)nb_blocks * allocator.nb_words; i++) {
+		allocator.live_in[i] = 0;
+		gen[i] = 0;
+		kill[i] = 0;
+	}
+
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		IR_Basic_Block&	block = function.blocks[i];
+		uint64_t*		block_gen = get_live_set(allocator, gen, i);
+		uint64_t*		block_kill = get_live_set(allocator, kill, i);
+
+		for (uint32_t j = 0; j < block.nb_instructions; j++) {
+			IR_Instruction& instruction = function.instructions[block.first_instruction + j];
+
+			if (instruction.opcode != IR_Opcode::PHI) { // Values of phis are alive at the end of predecessors
+				for_each_use(function, instruction, [&](uint32_t& register_id) {
+					if (!is_live(block_kill, register_id)) {
+						set_live(block_gen, register_id);
+					}
+				});
+			}
+
+			if (instruction.destination != invalid_register) {
+				set_live(block_kill, instruction.destination);
+			}
+		}
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+
+		for (uint32_t i = nb_blocks; i-- > 0;) {
+			uint64_t* block_live_in = get_live_set(allocator, allocator.live_in, i);
+			uint64_t* block_gen = get_live_set(allocator, gen, i);
+			uint64_t* block_kill = get_live_set(allocator, kill, i);
+
+			compute_live_out(allocator, i, memory::get_array_data(live_out));
+			for (uint32_t j = 0; j < allocator.nb_words; j++) {
+				uint64_t value = block_gen[j] | (live_out[j] & ~block_kill[j]);
+
+				if (value != block_live_in[j]) {
+					block_live_in[j] = value;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+inline Physical_Register get_argument_register(uint32_t argument_index, bool is_in_xmm_register)
+{
+	if (argument_index >= nb_register_arguments) {
+		return Physical_Register::COUNT;
+	}
+	return is_in_xmm_register ? (Physical_Register)((uint32_t)Physical_Register::XMM0 + argument_index) : integer_argument_registers[argument_index];
+}
+
+inline Physical_Register get_return_register(bool is_in_xmm_register)
+{
+	return is_in_xmm_register ? Physical_Register::XMM0 : Physical_Register::RAX;
+}
+
+// The address of an indirect call can be read from memory
+static bool operands_require_register(IR_Opcode opcode)
+{
+	return opcode != IR_Opcode::COPY && !is_call(opcode) && opcode != IR_Opcode::RETURN && opcode != IR_Opcode::PHI;
+}
+
+static bool destination_requires_register(IR_Opcode opcode)
+{
+	return opcode != IR_Opcode::COPY && opcode != IR_Opcode::CONSTANT && !is_call(opcode) && opcode != IR_Opcode::PHI;
+}
+
+// Ranges of a block are built backward from its live out set (Wimmer and Franz), then ranges and uses of each
+// virtual register are sorted by a counting sort.
+static void build_intervals(Allocator& allocator)
+{
+	ZoneScopedN("build_intervals");
+
+	IR_Function&				function = *allocator.function;
+	Register_Allocation&		allocation = *allocator.allocation;
+	uint32_t					nb_registers = (uint32_t)memory::get_array_size(function.registers);
+	uint32_t					nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<Raw_Range>	raw_ranges;
+	memory::Array<Raw_Use>		raw_uses;
+	memory::Array<uint32_t>		open_range;		// Range of the current block for live registers
+	memory::Array<uint64_t>		live;
+	memory::Array<uint32_t>		counts;
+
+	defer{
+		memory::release(raw_ranges);
+		memory::release(raw_uses);
+		memory::release(open_range);
+		memory::release(live);
+		memory::release(counts);
+	};
+
+	memory::resize_array(allocation.intervals, nb_registers);
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		Live_Interval& interval = allocation.intervals[i];
+
+		interval.virtual_register = i;
+		interval.first_range = 0;
+		interval.nb_ranges = 0;
+		interval.first_use = 0;
+		interval.nb_uses = 0;
+		interval.next_split = invalid_interval;
+		interval.location.kind = Location::Kind::NONE;
+		interval.location.physical_register = Physical_Register::COUNT;
+		interval.location.index = 0;
+		interval.hint = i < function.nb_arguments ? get_argument_register(i, uses_xmm_register(function.registers[i])) : Physical_Register::COUNT;
+		interval.is_in_xmm_register = uses_xmm_register(function.registers[i]);
+	}
+
+	memory::resize_array(open_range, nb_registers);
+	memory::resize_array(live, allocator.nb_words);
+	memory::resize_array(allocator.call_positions, 0);
+
+	auto add_range = [&](uint32_t register_id, uint32_t start, uint32_t end) {
+		Raw_Range raw_range;
+		raw_range.virtual_register = register_id;
+		raw_range.range.start = start;
+		raw_range.range.end = end;
+		open_range[register_id] = (uint32_t)memory::get_array_size(raw_ranges);
+		memory::array_push_back(raw_ranges, raw_range);
+	};
+
+	auto add_use = [&](uint32_t register_id, uint32_t position, bool requires_register) {
+		Raw_Use raw_use;
+		raw_use.virtual_register = register_id;
+		raw_use.use.position = position;
+		raw_use.use.requires_register = requires_register;
+		memory::array_push_back(raw_uses, raw_use);
+	};
+
+	auto set_hint = [&](uint32_t register_id, Physical_Register hint) {
+		if (allocation.intervals[register_id].hint == Physical_Register::COUNT) {
+			allocation.intervals[register_id].hint = hint;
+		}
+	};
+
+	for (uint32_t block_index = nb_blocks; block_index-- > 0;) {
+		IR_Basic_Block&	block = function.blocks[block_index];
+		uint32_t		block_start = 4 * block.first_instruction;
+		uint32_t		block_end = 4 * (block.first_instruction + block.nb_instructions);
+
+		compute_live_out(allocator, block_index, memory::get_array_data(live));
+		for (uint32_t i = 0; i < nb_registers; i++) {
+			if (is_live(memory::get_array_data(live), i)) {
+				add_range(i, block_start, block_end);
+			}
+		}
+
+		for (uint32_t i = block.nb_instructions; i-- > 0;) {
+			uint32_t		instruction_index = block.first_instruction + i;
+			IR_Instruction&	instruction = function.instructions[instruction_index];
+			bool			is_call = f::is_call(instruction.opcode);
+
+			if (instruction.destination != invalid_register) {
+				uint32_t position = instruction.opcode == IR_Opcode::PHI ? block_start : get_definition_position(instruction_index);
+
+				if (is_live(memory::get_array_data(live), instruction.destination)) {
+					raw_ranges[open_range[instruction.destination]].range.start = position;
+					clear_live(memory::get_array_data(live), instruction.destination);
+				}
+				else {
+					add_range(instruction.destination, position, position + 1); // Never used
+				}
+
+				if (instruction.opcode != IR_Opcode::PHI) {
+					add_use(instruction.destination, position, destination_requires_register(instruction.opcode));
+				}
+				if (is_call) {
+					set_hint(instruction.destination, get_return_register(uses_xmm_register(instruction.type)));
+				}
+			}
+
+			if (instruction.opcode == IR_Opcode::PHI) {
+				continue;
+			}
+
+			if (is_call) {
+				memory::array_push_back(allocator.call_positions, get_use_position(instruction_index) + 1);
+			}
+
+			// The address of an indirect call is read after the moves of arguments, it is alive during the call so it
+			// never gets a volatile register
+			uint32_t operand_index = 0;
+			uint32_t first_argument = instruction.opcode == IR_Opcode::CALL_INDIRECT ? 1 : 0;
+			for_each_use(function, instruction, [&](uint32_t& register_id) {
+				bool		is_argument = is_call && operand_index++ >= first_argument;
+				uint32_t	use_position = is_argument ? get_use_position(instruction_index) : get_use_position(instruction_index) + 1;
+
+				if (!is_live(memory::get_array_data(live), register_id)) {
+					add_range(register_id, block_start, use_position + 1);
+					set_live(memory::get_array_data(live), register_id);
+				}
+				add_use(register_id, use_position, operands_require_register(instruction.opcode));
+
+				if (is_argument) {
+					set_hint(register_id, get_argument_register(operand_index - 1 - first_argument, allocation.intervals[register_id].is_in_xmm_register));
+				}
+				else if (instruction.opcode == IR_Opcode::RETURN) {
+					set_hint(register_id, get_return_register(allocation.intervals[register_id].is_in_xmm_register));
+				}
+			});
+		}
+	}
+
+	// Calls were found backward
+	size_t nb_calls = memory::get_array_size(allocator.call_positions);
+	for (size_t i = 0; i < nb_calls / 2; i++) {
+		uint32_t position = allocator.call_positions[i];
+		allocator.call_positions[i] = allocator.call_positions[nb_calls - 1 - i];
+		allocator.call_positions[nb_calls - 1 - i] = position;
+	}
+
+	// Raw ranges and uses of a register are in decreasing order, they are placed from the end of their segment
+	memory::resize_array(counts, nb_registers);
+
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		counts[i] = 0;
+	}
+	for (size_t i = 0; i < memory::get_array_size(raw_ranges); i++) {
+		counts[raw_ranges[i].virtual_register]++;
+	}
+	uint32_t first_range = 0;
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		allocation.intervals[i].first_range = first_range;
+		first_range += counts[i];
+		counts[i] = first_range; // Insertion position, decremented
+	}
+	memory::resize_array(allocation.ranges, memory::get_array_size(raw_ranges));
+	for (size_t i = 0; i < memory::get_array_size(raw_ranges); i++) {
+		allocation.ranges[--counts[raw_ranges[i].virtual_register]] = raw_ranges[i].range;
+	}
+
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		counts[i] = 0;
+	}
+	for (size_t i = 0; i < memory::get_array_size(raw_uses); i++) {
+		counts[raw_uses[i].virtual_register]++;
+	}
+	uint32_t first_use = 0;
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		allocation.intervals[i].first_use = first_use;
+		allocation.intervals[i].nb_uses = counts[i];
+		first_use += counts[i];
+		counts[i] = first_use;
+	}
+	memory::resize_array(allocation.uses, memory::get_array_size(raw_uses));
+	for (size_t i = 0; i < memory::get_array_size(raw_uses); i++) {
+		allocation.uses[--counts[raw_uses[i].virtual_register]] = raw_uses[i].use;
+	}
+
+	// Merge ranges of consecutive blocks, the array is compacted in place
+	uint32_t nb_ranges = 0;
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		Live_Interval&	interval = allocation.intervals[i];
+		uint32_t		end = i + 1 < nb_registers ? allocation.intervals[i + 1].first_range : (uint32_t)memory::get_array_size(allocation.ranges);
+		uint32_t		first = nb_ranges;
+
+		for (uint32_t j = interval.first_range; j < end; j++) {
+			if (nb_ranges > first && allocation.ranges[nb_ranges - 1].end >= allocation.ranges[j].start) {
+				if (allocation.ranges[j].end > allocation.ranges[nb_ranges - 1].end) {
+					allocation.ranges[nb_ranges - 1].end = allocation.ranges[j].end;
+				}
+			}
+			else {
+				allocation.ranges[nb_ranges++] = allocation.ranges[j];
+			}
+		}
+		interval.first_range = first;
+		interval.nb_ranges = nb_ranges - first;
+	}
+	memory::resize_array(allocation.ranges, nb_ranges);
+
+	memory::resize_array(allocator.register_end, nb_registers);
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		allocator.register_end[i] = allocation.intervals[i].nb_ranges ? get_end(allocation, i) : 0;
+	}
+}
+
+//=============================================================================
+// Linear scan
+
+static uint32_t get_first_clobber(Allocator& allocator, uint32_t interval)
+{
+	Register_Allocation&	allocation = *allocator.allocation;
+	uint32_t				start = get_start(allocation, interval);
+	uint32_t				end = get_end(allocation, interval);
+	size_t					low = 0;
+	size_t					high = memory::get_array_size(allocator.call_positions);
+
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+
+		if (allocator.call_positions[middle] < start) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	for (size_t i = low; i < memory::get_array_size(allocator.call_positions) && allocator.call_positions[i] < end; i++) {
+		if (covers(allocation, interval, allocator.call_positions[i])) {
+			return allocator.call_positions[i];
+		}
+	}
+	return invalid_position;
+}
+
+inline void get_candidates(bool is_in_xmm_register, const Physical_Register*& candidates, uint32_t& nb_candidates)
+{
+	if (is_in_xmm_register) {
+		candidates = xmm_registers;
+		nb_candidates = sizeof(xmm_registers) / sizeof(Physical_Register);
+	}
+	else {
+		candidates = general_purpose_registers;
+		nb_candidates = sizeof(general_purpose_registers) / sizeof(Physical_Register);
+	}
+}
+
+static void assign_register(Allocator& allocator, uint32_t interval, Physical_Register physical_register)
+{
+	Live_Interval& live_interval = allocator.allocation->intervals[interval];
+
+	live_interval.location.kind = Location::Kind::REGISTER;
+	live_interval.location.physical_register = physical_register;
+	live_interval.location.index = 0;
+	allocator.allocation->used_registers |= get_register_mask(physical_register);
+}
+
+static void assign_stack_slot(Allocator& allocator, uint32_t interval)
+{
+	Register_Allocation&	allocation = *allocator.allocation;
+	uint32_t				register_id = allocation.intervals[interval].virtual_register;
+	uint32_t				slot = allocator.stack_slot_of_register[register_id];
+
+	if (slot == invalid_stack_slot) {
+		// The store can happen before the instruction where the part starts
+		uint32_t start = get_instruction_start(get_start(allocation, interval));
+		uint32_t nb_slots = is_vector(allocator.function->registers[register_id]) ? 2 : 1;
+		uint32_t nb_free_slots = 0;
+
+		for (uint32_t i = 0; i < memory::get_array_size(allocator.stack_slot_end) && slot == invalid_stack_slot; i++) {
+			nb_free_slots = allocator.stack_slot_end[i] <= start ? nb_free_slots + 1 : 0;
+			if (nb_free_slots == nb_slots) {
+				slot = i + 1 - nb_slots;
+			}
+		}
+		if (slot == invalid_stack_slot) {
+			slot = (uint32_t)memory::get_array_size(allocator.stack_slot_end);
+			for (uint32_t i = 0; i < nb_slots; i++) {
+				memory::array_push_back(allocator.stack_slot_end, 0u);
+			}
+		}
+
+		for (uint32_t i = 0; i < nb_slots; i++) {
+			allocator.stack_slot_end[slot + i] = allocator.register_end[register_id];
+		}
+		allocator.stack_slot_of_register[register_id] = slot;
+	}
+
+	Live_Interval& live_interval = allocation.intervals[interval];
+	live_interval.location.kind = Location::Kind::STACK_SLOT;
+	live_interval.location.physical_register = Physical_Register::COUNT;
+	live_interval.location.index = slot;
+}
+
+// Position of the reload before the use, moved to the entry of loops that don't contain the spill
+static uint32_t get_reload_position(Allocator& allocator, uint32_t spill_position, uint32_t use_position)
+{
+	IR_Function&	function = *allocator.function;
+	uint32_t		position = get_instruction_start(use_position);
+	uint32_t		spill_block = allocator.instruction_block[spill_position / 4];
+
+	for (uint32_t loop = allocator.loop_header[allocator.instruction_block[use_position / 4]];
+		loop != invalid_block && !is_in_loop(allocator, spill_block, loop);
+		loop = allocator.parent_loop_header[loop])
+	{
+		uint32_t loop_start = 4 * function.blocks[loop].first_instruction;
+
+		if (loop_start > spill_position && loop_start < position) {
+			position = loop_start;
+		}
+	}
+	return position;
+}
+
+// The interval goes in memory, it is split again before its next use that needs a register
+static void spill_interval(Allocator& allocator, uint32_t interval)
+{
+	Register_Allocation& allocation = *allocator.allocation;
+
+	assign_stack_slot(allocator, interval);
+
+	uint32_t start = get_start(allocation, interval);
+	uint32_t next_use = get_next_use(allocation, interval, start, true);
+
+	if (next_use != invalid_position) {
+		uint32_t reload_position = get_reload_position(allocator, start, next_use);
+
+		if (reload_position > start) {
+			add_unhandled(allocator, split_interval(allocation, interval, reload_position));
+		}
+	}
+}
+
+static bool try_allocate_free_register(Allocator& allocator, uint32_t current)
+{
+	Register_Allocation&		allocation = *allocator.allocation;
+	Live_Interval&				interval = allocation.intervals[current];
+	uint32_t					start = get_start(allocation, current);
+	uint32_t					end = get_end(allocation, current);
+	uint32_t					free_until[(size_t)Physical_Register::COUNT];
+	const Physical_Register*	candidates;
+	uint32_t					nb_candidates;
+
+	get_candidates(interval.is_in_xmm_register, candidates, nb_candidates);
+	for (uint32_t i = 0; i < (uint32_t)Physical_Register::COUNT; i++) {
+		free_until[i] = invalid_position;
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(allocator.active); i++) {
+		free_until[(size_t)allocation.intervals[allocator.active[i]].location.physical_register] = 0;
+	}
+	for (size_t i = 0; i < memory::get_array_size(allocator.inactive); i++) {
+		uint32_t			inactive = allocator.inactive[i];
+		Physical_Register	physical_register = allocation.intervals[inactive].location.physical_register;
+		uint32_t			intersection = get_next_intersection(allocation, inactive, current);
+
+		if (intersection < free_until[(size_t)physical_register]) {
+			free_until[(size_t)physical_register] = intersection;
+		}
+	}
+
+	uint32_t clobber = get_first_clobber(allocator, current);
+	if (clobber != invalid_position) {
+		for (uint32_t i = 0; i < nb_candidates; i++) {
+			if ((volatile_registers & get_register_mask(candidates[i])) && clobber < free_until[(size_t)candidates[i]]) {
+				free_until[(size_t)candidates[i]] = clobber;
+			}
+		}
+	}
+
+	// The hint, then the first register free for the whole interval, else the one that stays free the longest
+	Physical_Register best = candidates[0];
+	if (interval.hint != Physical_Register::COUNT && free_until[(size_t)interval.hint] >= end) {
+		best = interval.hint;
+	}
+	else {
+		for (uint32_t i = 0; i < nb_candidates; i++) {
+			if (free_until[(size_t)candidates[i]] >= end) {
+				best = candidates[i];
+				break;
+			}
+			else if (free_until[(size_t)candidates[i]] > free_until[(size_t)best]) {
+				best = candidates[i];
+			}
+		}
+	}
+
+	if (free_until[(size_t)best] >= end) {
+		assign_register(allocator, current, best);
+		return true;
+	}
+
+	// The register is free for the first part of the interval
+	uint32_t split_position = get_instruction_start(free_until[(size_t)best]);
+	if (split_position <= start) {
+		return false;
+	}
+
+	assign_register(allocator, current, best);
+	add_unhandled(allocator, split_interval(allocation, current, split_position));
+	return true;
+}
+
+static void allocate_blocked_register(Allocator& allocator, uint32_t current)
+{
+	Register_Allocation&		allocation = *allocator.allocation;
+	uint32_t					start = get_start(allocation, current);
+	uint32_t					end = get_end(allocation, current);
+	uint32_t					use_position[(size_t)Physical_Register::COUNT];
+	uint32_t					block_position[(size_t)Physical_Register::COUNT];	// Can't be spilled (calls)
+	const Physical_Register*	candidates;
+	uint32_t					nb_candidates;
+
+	get_candidates(allocation.intervals[current].is_in_xmm_register, candidates, nb_candidates);
+	for (uint32_t i = 0; i < (uint32_t)Physical_Register::COUNT; i++) {
+		use_position[i] = invalid_position;
+		block_position[i] = invalid_position;
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(allocator.active); i++) {
+		uint32_t			active = allocator.active[i];
+		Physical_Register	physical_register = allocation.intervals[active].location.physical_register;
+		uint32_t			next_use = get_next_use(allocation, active, start, true);
+
+		if (next_use < use_position[(size_t)physical_register]) {
+			use_position[(size_t)physical_register] = next_use;
+		}
+	}
+	for (size_t i = 0; i < memory::get_array_size(allocator.inactive); i++) {
+		uint32_t			inactive = allocator.inactive[i];
+		Physical_Register	physical_register = allocation.intervals[inactive].location.physical_register;
+
+		if (get_next_intersection(allocation, inactive, current) != invalid_position) {
+			uint32_t next_use = get_next_use(allocation, inactive, start, true);
+
+			if (next_use < use_position[(size_t)physical_register]) {
+				use_position[(size_t)physical_register] = next_use;
+			}
+		}
+	}
+
+	uint32_t clobber = get_first_clobber(allocator, current);
+	if (clobber != invalid_position) {
+		for (uint32_t i = 0; i < nb_candidates; i++) {
+			if (volatile_registers & get_register_mask(candidates[i])) {
+				block_position[(size_t)candidates[i]] = clobber;
+				if (clobber < use_position[(size_t)candidates[i]]) {
+					use_position[(size_t)candidates[i]] = clobber;
+				}
+			}
+		}
+	}
+
+	Physical_Register best = candidates[0];
+	for (uint32_t i = 1; i < nb_candidates; i++) {
+		if (use_position[(size_t)candidates[i]] > use_position[(size_t)best]) {
+			best = candidates[i];
+		}
+	}
+
+	// Other intervals need their register before the current one, it is spilled until its first use
+	uint32_t first_use = get_next_use(allocation, current, start, true);
+	if (first_use == invalid_position || use_position[(size_t)best] < first_use) {
+		spill_interval(allocator, current);
+		return;
+	}
+
+	if (block_position[(size_t)best] < end) {
+		uint32_t split_position = get_instruction_start(block_position[(size_t)best]);
+
+		if (split_position <= start) {
+			spill_interval(allocator, current);
+			return;
+		}
+		add_unhandled(allocator, split_interval(allocation, current, split_position));
+	}
+
+	assign_register(allocator, current, best);
+
+	// Intervals that use the register are split, the active one is spilled from the current position (its store
+	// happens before the instruction so it can start at a definition)
+	for (size_t i = 0; i < memory::get_array_size(allocator.active); i++) {
+		uint32_t active = allocator.active[i];
+
+		if (allocation.intervals[active].location.physical_register != best) {
+			continue;
+		}
+
+		remove_at(allocator.active, i);
+		if (get_start(allocation, active) >= start) {
+			spill_interval(allocator, active);
+		}
+		else {
+			spill_interval(allocator, split_interval(allocation, active, start));
+		}
+		break;
+	}
+
+	for (size_t i = 0; i < memory::get_array_size(allocator.inactive);) {
+		uint32_t inactive = allocator.inactive[i];
+
+		if (allocation.intervals[inactive].location.physical_register == best) {
+			uint32_t intersection = get_next_intersection(allocation, inactive, current);
+
+			if (intersection != invalid_position) {
+				uint32_t split_position = get_instruction_start(intersection);
+
+				core::Assert(split_position > get_start(allocation, inactive));
+				add_unhandled(allocator, split_interval(allocation, inactive, split_position));
+			}
+		}
+		i++;
+	}
+}
+
+static void linear_scan(Allocator& allocator)
+{
+	ZoneScopedN("linear_scan");
+
+	Register_Allocation& allocation = *allocator.allocation;
+
+	for (uint32_t i = 0; i < memory::get_array_size(allocation.intervals); i++) {
+		if (allocation.intervals[i].nb_ranges) {
+			add_unhandled(allocator, i);
+		}
+	}
+
+	while (!memory::is_array_empty(allocator.unhandled)) {
+		uint32_t current = *memory::get_array_last_element(allocator.unhandled);
+		uint32_t position = get_start(allocation, current);
+
+		memory::resize_array(allocator.unhandled, memory::get_array_size(allocator.unhandled) - 1);
+
+		for (size_t i = 0; i < memory::get_array_size(allocator.active);) {
+			uint32_t interval = allocator.active[i];
+
+			if (get_end(allocation, interval) <= position) {
+				remove_at(allocator.active, i);
+			}
+			else if (!covers(allocation, interval, position)) {
+				remove_at(allocator.active, i);
+				memory::array_push_back(allocator.inactive, interval);
+			}
+			else {
+				i++;
+			}
+		}
+
+		for (size_t i = 0; i < memory::get_array_size(allocator.inactive);) {
+			uint32_t interval = allocator.inactive[i];
+
+			if (get_end(allocation, interval) <= position) {
+				remove_at(allocator.inactive, i);
+			}
+			else if (covers(allocation, interval, position)) {
+				remove_at(allocator.inactive, i);
+				memory::array_push_back(allocator.active, interval);
+			}
+			else {
+				i++;
+			}
+		}
+
+		// General purpose and XMM registers are disjoint, so intervals of the other class never compete for a register
+		if (!try_allocate_free_register(allocator, current)) {
+			allocate_blocked_register(allocator, current);
+		}
+
+		if (allocation.intervals[current].location.kind == Location::Kind::REGISTER) {
+			memory::array_push_back(allocator.active, current);
+		}
+	}
+}
+
+//=============================================================================
+// Resolution
+
+Location f::x64::get_location(const Register_Allocation& allocation, uint32_t virtual_register, uint32_t position)
+{
+	for (uint32_t interval = virtual_register; interval != invalid_interval; interval = allocation.intervals[interval].next_split) {
+		const Live_Interval& live_interval = allocation.intervals[interval];
+
+		if (live_interval.nb_ranges == 0) {
+			break;
+		}
+		if (position < get_end(allocation, interval)) {
+			return position >= get_start(allocation, interval) ? live_interval.location : Location{};
+		}
+	}
+	return Location{};
+}
+
+// Moves before an instruction are parallel, so their sources are read before the moves of splits at the same position
+static Location get_source_location(Allocator& allocator, uint32_t virtual_register, uint32_t instruction_index)
+{
+	Register_Allocation&	allocation = *allocator.allocation;
+	IR_Function&			function = *allocator.function;
+	uint32_t				position = get_use_position(instruction_index);
+	uint32_t				previous = invalid_interval;
+
+	if (function.blocks[allocator.instruction_block[instruction_index]].first_instruction != instruction_index) {
+		for (uint32_t interval = virtual_register; interval != invalid_interval; interval = allocation.intervals[interval].next_split) {
+			if (get_start(allocation, interval) == position && previous != invalid_interval && get_end(allocation, previous) == position) {
+				return allocation.intervals[previous].location;
+			}
+			previous = interval;
+		}
+	}
+	return get_location(allocation, virtual_register, position);
+}
+
+enum class Move_Group_Kind
+{
+	BEFORE_INSTRUCTION,
+	AFTER_INSTRUCTION,
+	BLOCK_ENTRY,
+	BLOCK_EXIT,
+};
+
+inline uint32_t get_move_group(Allocator& allocator, Move_Group_Kind kind, uint32_t index)
+{
+	uint32_t nb_instructions = (uint32_t)memory::get_array_size(allocator.function->instructions);
+	uint32_t nb_blocks = (uint32_t)memory::get_array_size(allocator.function->blocks);
+
+	switch (kind)
+	{
+	case Move_Group_Kind::BEFORE_INSTRUCTION:	return index;
+	case Move_Group_Kind::AFTER_INSTRUCTION:	return nb_instructions + index;
+	case Move_Group_Kind::BLOCK_ENTRY:			return 2 * nb_instructions + index;
+	default:									return 2 * nb_instructions + nb_blocks + index;
+	}
+}
+
+static void add_move(Allocator& allocator, Move_Group_Kind kind, uint32_t index, Location source, Location destination, Register::Type type)
+{
+	if (source == destination || destination.kind == Location::Kind::NONE) {
+		return;
+	}
+	core::Assert(source.kind != Location::Kind::NONE);
+
+	Pending_Move pending_move;
+	pending_move.group = get_move_group(allocator, kind, index);
+	pending_move.move.source = source;
+	pending_move.move.destination = destination;
+	pending_move.move.type = type;
+	memory::array_push_back(allocator.pending_moves, pending_move);
+}
+
+inline Location get_register_location(Physical_Register physical_register)
+{
+	Location location;
+	location.kind = Location::Kind::REGISTER;
+	location.physical_register = physical_register;
+	location.index = 0;
+	return location;
+}
+
+inline Location get_argument_location(Location::Kind kind, uint32_t argument_index, bool is_in_xmm_register)
+{
+	Physical_Register physical_register = get_argument_register(argument_index, is_in_xmm_register);
+
+	if (physical_register != Physical_Register::COUNT) {
+		return get_register_location(physical_register);
+	}
+
+	Location location;
+	location.kind = kind;
+	location.physical_register = Physical_Register::COUNT;
+	location.index = argument_index;
+	return location;
+}
+
+// Parallel moves to sequential ones, a move is emitted once no other move reads its destination. Cycles are broken
+// by saving a destination in the scratch stack slot.
+static void sequentialize_moves(Allocator& allocator, Move* parallel_moves, uint32_t nb_moves)
+{
+	Register_Allocation& allocation = *allocator.allocation;
+
+	// Duplicates come from splits and argument moves of the same value
+	for (uint32_t i = 0; i < nb_moves; i++) {
+		for (uint32_t j = i + 1; j < nb_moves; j++) {
+			if (parallel_moves[j].destination == parallel_moves[i].destination) {
+				core::Assert(parallel_moves[j].source == parallel_moves[i].source);
+				parallel_moves[j--] = parallel_moves[--nb_moves];
+			}
+		}
+	}
+
+	while (nb_moves) {
+		bool emitted = false;
+
+		for (uint32_t i = 0; i < nb_moves; i++) {
+			bool is_read = false;
+
+			for (uint32_t j = 0; j < nb_moves && !is_read; j++) {
+				is_read = j != i && parallel_moves[j].source == parallel_moves[i].destination;
+			}
+
+			if (!is_read) {
+				memory::array_push_back(allocation.moves, parallel_moves[i]);
+				parallel_moves[i] = parallel_moves[--nb_moves];
+				emitted = true;
+				break;
+			}
+		}
+
+		if (!emitted) {
+			Move		save;
+			Location	destination = parallel_moves[0].destination;
+
+			// Two slots, so vectors can be saved in it
+			if (allocator.scratch_stack_slot == invalid_stack_slot) {
+				allocator.scratch_stack_slot = (uint32_t)memory::get_array_size(allocator.stack_slot_end);
+				memory::array_push_back(allocator.stack_slot_end, invalid_position);
+				memory::array_push_back(allocator.stack_slot_end, invalid_position);
+			}
+
+			save.source = destination;
+			save.destination.kind = Location::Kind::STACK_SLOT;
+			save.destination.physical_register = Physical_Register::COUNT;
+			save.destination.index = allocator.scratch_stack_slot;
+			save.type = parallel_moves[0].type;
+
+			for (uint32_t i = 1; i < nb_moves; i++) {
+				if (parallel_moves[i].source == destination) {
+					parallel_moves[i].source = save.destination;
+					save.type = parallel_moves[i].type;
+				}
+			}
+			memory::array_push_back(allocation.moves, save);
+		}
+	}
+}
+
+static void resolve_data_flow(Allocator& allocator)
+{
+	ZoneScopedN("resolve_data_flow");
+
+	IR_Function&			function = *allocator.function;
+	Register_Allocation&	allocation = *allocator.allocation;
+	uint32_t				nb_registers = (uint32_t)memory::get_array_size(function.registers);
+	uint32_t				nb_instructions = (uint32_t)memory::get_array_size(function.instructions);
+	uint32_t				nb_blocks = (uint32_t)memory::get_array_size(function.blocks);
+	memory::Array<uint32_t>	group_first;
+	memory::Array<Move>		sorted_moves;
+
+	defer{
+		memory::release(group_first);
+		memory::release(sorted_moves);
+	};
+
+	// Splits inside blocks
+	for (uint32_t i = 0; i < nb_registers; i++) {
+		for (uint32_t interval = i; interval != invalid_interval && allocation.intervals[interval].next_split != invalid_interval;
+			interval = allocation.intervals[interval].next_split)
+		{
+			uint32_t child = allocation.intervals[interval].next_split;
+			uint32_t start = get_start(allocation, child);
+			uint32_t instruction_index = start / 4;
+
+			if (get_end(allocation, interval) != start
+				|| start == 4 * function.blocks[allocator.instruction_block[instruction_index]].first_instruction) {
+				continue; // In a lifetime hole or resolved on edges
+			}
+
+			add_move(allocator, Move_Group_Kind::BEFORE_INSTRUCTION, instruction_index,
+				allocation.intervals[interval].location, allocation.intervals[child].location, function.registers[i]);
+		}
+	}
+
+	// Arguments of the function
+	for (uint32_t i = 0; i < function.nb_arguments; i++) {
+		bool is_in_xmm_register = allocation.intervals[i].is_in_xmm_register;
+
+		add_move(allocator, Move_Group_Kind::BLOCK_ENTRY, 0,
+			get_argument_location(Location::Kind::INCOMING_ARGUMENT, i, is_in_xmm_register), get_location(allocation, i, 0), function.registers[i]);
+	}
+
+	// Calling convention
+	for (uint32_t i = 0; i < nb_instructions; i++) {
+		IR_Instruction& instruction = function.instructions[i];
+
+		if (is_call(instruction.opcode)) {
+			uint32_t first_argument = instruction.opcode == IR_Opcode::CALL_INDIRECT ? 1 : 0; // After the address
+
+			for (uint32_t j = first_argument; j < instruction.operands[1]; j++) {
+				uint32_t	argument = function.operand_lists[instruction.operands[0] + j];
+				bool		is_in_xmm_register = allocation.intervals[argument].is_in_xmm_register;
+
+				add_move(allocator, Move_Group_Kind::BEFORE_INSTRUCTION, i, get_source_location(allocator, argument, i),
+					get_argument_location(Location::Kind::OUTGOING_ARGUMENT, j - first_argument, is_in_xmm_register), function.registers[argument]);
+			}
+
+			if (instruction.destination != invalid_register) {
+				add_move(allocator, Move_Group_Kind::AFTER_INSTRUCTION, i,
+					get_register_location(get_return_register(allocation.intervals[instruction.destination].is_in_xmm_register)),
+					get_location(allocation, instruction.destination, get_definition_position(i)), function.registers[instruction.destination]);
+			}
+		}
+		else if (instruction.opcode == IR_Opcode::RETURN && instruction.operands[0] != invalid_register) {
+			uint32_t value = instruction.operands[0];
+
+			add_move(allocator, Move_Group_Kind::BEFORE_INSTRUCTION, i, get_source_location(allocator, value, i),
+				get_register_location(get_return_register(allocation.intervals[value].is_in_xmm_register)), function.registers[value]);
+		}
+	}
+
+	// Control flow edges, moves go at the end of the predecessor if it has only one successor, else at the beginning
+	// of the successor (critical edges are split)
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		IR_Basic_Block&	block = function.blocks[i];
+		const uint32_t*	successors;
+		uint32_t		nb_successors = get_successors(function, block, successors);
+		uint32_t		end_position = 4 * (block.first_instruction + block.nb_instructions) - 1;
+
+		for (uint32_t j = 0; j < nb_successors; j++) {
+			IR_Basic_Block&	successor = function.blocks[successors[j]];
+			uint64_t*		successor_live_in = get_live_set(allocator, allocator.live_in, successors[j]);
+			uint32_t		start_position = 4 * successor.first_instruction;
+			Move_Group_Kind	kind = nb_successors == 1 ? Move_Group_Kind::BLOCK_EXIT : Move_Group_Kind::BLOCK_ENTRY;
+			uint32_t		group_index = nb_successors == 1 ? i : successors[j];
+
+			core::Assert(nb_successors == 1 || successor.nb_predecessors == 1);
+
+			// @SpeedUp iterate over set bits only
+			for (uint32_t k = 0; k < nb_registers; k++) {
+				if (is_live(successor_live_in, k)) {
+					add_move(allocator, kind, group_index, get_location(allocation, k, end_position),
+						get_location(allocation, k, start_position), function.registers[k]);
+				}
+			}
+
+			for (uint32_t k = 0; k < successor.nb_instructions; k++) {
+				IR_Instruction& phi = function.instructions[successor.first_instruction + k];
+
+				if (phi.opcode != IR_Opcode::PHI) {
+					break;
+				}
+
+				for (uint32_t l = 0; l < phi.operands[1]; l++) {
+					if (function.operand_lists[phi.operands[0] + 2 * l] == i) {
+						uint32_t value = function.operand_lists[phi.operands[0] + 2 * l + 1];
+
+						add_move(allocator, kind, group_index, get_location(allocation, value, end_position),
+							get_location(allocation, phi.destination, start_position), function.registers[phi.destination]);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// Moves are sorted by group with a counting sort, then each group is sequentialized
+	uint32_t nb_groups = 2 * nb_instructions + 2 * nb_blocks;
+
+	memory::resize_array(group_first, nb_groups + 1);
+	for (uint32_t i = 0; i <= nb_groups; i++) {
+		group_first[i] = 0;
+	}
+	for (size_t i = 0; i < memory::get_array_size(allocator.pending_moves); i++) {
+		group_first[allocator.pending_moves[i].group + 1]++;
+	}
+	for (uint32_t i = 0; i < nb_groups; i++) {
+		group_first[i + 1] += group_first[i];
+	}
+	memory::resize_array(sorted_moves, memory::get_array_size(allocator.pending_moves));
+	for (size_t i = 0; i < memory::get_array_size(allocator.pending_moves); i++) {
+		sorted_moves[group_first[allocator.pending_moves[i].group]++] = allocator.pending_moves[i].move;
+	}
+	for (uint32_t i = nb_groups; i > 0; i--) { // Restore the first index of groups
+		group_first[i] = group_first[i - 1];
+	}
+	group_first[0] = 0;
+
+	memory::resize_array(allocation.moves, 0);
+	memory::resize_array(allocation.before_instruction, nb_instructions);
+	memory::resize_array(allocation.after_instruction, nb_instructions);
+	memory::resize_array(allocation.block_entry, nb_blocks);
+	memory::resize_array(allocation.block_exit, nb_blocks);
+
+	for (uint32_t i = 0; i < nb_groups; i++) {
+		Move_Range range;
+
+		range.first = (uint32_t)memory::get_array_size(allocation.moves);
+		sequentialize_moves(allocator, memory::get_array_data(sorted_moves) + group_first[i], group_first[i + 1] - group_first[i]);
+		range.count = (uint32_t)memory::get_array_size(allocation.moves) - range.first;
+
+		if (i < nb_instructions) {
+			allocation.before_instruction[i] = range;
+		}
+		else if (i < 2 * nb_instructions) {
+			allocation.after_instruction[i - nb_instructions] = range;
+		}
+		else if (i < 2 * nb_instructions + nb_blocks) {
+			allocation.block_entry[i - 2 * nb_instructions] = range;
+		}
+		else {
+			allocation.block_exit[i - 2 * nb_instructions - nb_blocks] = range;
+		}
+	}
+}
+
+//=============================================================================
+
+void f::x64::allocate_registers(IR_Function& function, Register_Allocation& allocation)
+{
+	ZoneScopedN("f::x64::allocate_registers");
+
+	Allocator				allocator;
+	memory::Array<uint32_t>	reverse_post_order;
+
+	defer{
+		memory::release(allocator.live_in);
+		memory::release(allocator.instruction_block);
+		memory::release(allocator.loop_header);
+		memory::release(allocator.parent_loop_header);
+		memory::release(allocator.register_end);
+		memory::release(allocator.call_positions);
+		memory::release(allocator.unhandled);
+		memory::release(allocator.active);
+		memory::release(allocator.inactive);
+		memory::release(allocator.stack_slot_of_register);
+		memory::release(allocator.stack_slot_end);
+		memory::release(allocator.pending_moves);
+		memory::release(reverse_post_order);
+	};
+
+	compute_control_flow(function);
+	split_critical_edges(function);
+	compute_control_flow(function, &reverse_post_order);
+
+	allocator.function = &function;
+	allocator.allocation = &allocation;
+	allocator.nb_words = (uint32_t)(memory::get_array_size(function.registers) + 63) / 64;
+	allocator.scratch_stack_slot = invalid_stack_slot;
+
+	allocation.nb_stack_slots = 0;
+	allocation.used_registers = 0;
+	memory::resize_array(allocation.intervals, 0);
+	memory::resize_array(allocation.ranges, 0);
+	memory::resize_array(allocation.uses, 0);
+
+	// Blocks are numbered in the order of the arena
+	memory::resize_array(allocator.instruction_block, memory::get_array_size(function.instructions));
+	for (uint32_t i = 0; i < memory::get_array_size(function.blocks); i++) {
+		IR_Basic_Block& block = function.blocks[i];
+
+		core::Assert(i == 0 || block.first_instruction == function.blocks[i - 1].first_instruction + function.blocks[i - 1].nb_instructions);
+		for (uint32_t j = 0; j < block.nb_instructions; j++) {
+			allocator.instruction_block[block.first_instruction + j] = i;
+		}
+	}
+
+	find_loops(function, reverse_post_order, allocator.loop_header, allocator.parent_loop_header);
+	compute_liveness(allocator);
+	build_intervals(allocator);
+
+	memory::resize_array(allocator.stack_slot_of_register, memory::get_array_size(function.registers));
+	for (size_t i = 0; i < memory::get_array_size(function.registers); i++) {
+		allocator.stack_slot_of_register[i] = invalid_stack_slot;
+	}
+
+	linear_scan(allocator);
+	resolve_data_flow(allocator);
+
+	allocation.nb_stack_slots = (uint32_t)memory::get_array_size(allocator.stack_slot_end);
+}
+
+void f::x64::release(Register_Allocation& allocation)
+{
+	memory::release(allocation.intervals);
+	memory::release(allocation.ranges);
+	memory::release(allocation.uses);
+	memory::release(allocation.moves);
+	memory::release(allocation.before_instruction);
+	memory::release(allocation.after_instruction);
+	memory::release(allocation.block_entry);
+	memory::release(allocation.block_exit);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../IR_generator.hpp"
+
+// Linear scan register allocation (Wimmer and Franz: "Linear Scan Register Allocation on SSA Form",
+// Wimmer and Mossenbock: "Optimized Interval Splitting in a Linear Scan Register Allocator")
+//
+// Virtual registers of an IR function are mapped to the x64 general purpose and XMM registers. The lifetime of
+// a virtual register is an interval made of ranges of positions (with holes where the value isn't alive). When
+// no register is free for the whole interval it is split, parts that don't get a register live in a stack slot.
+// A stack slot is reused once every part of the virtual register it holds is dead.
+//
+// Reloads of a value used in a loop are moved to the entry of the outermost loop that doesn't contain the spill,
+// so values used in loops stay in registers.
+//
+// The calling convention is the Windows x64 one: arguments in RCX, RDX, R8, R9 (XMM0 to XMM3 for floating points)
+// then on the stack, the return value in RAX or XMM0. Volatile registers aren't given to intervals alive during a
+// call, so nothing has to be saved around calls, but the backend has to save the non volatile registers of
+// used_registers in the prologue.
+//
+// RSP isn't allocated (there is no frame pointer, RBP is a non volatile register as the others), R11 is kept as a
+// scratch register for the backend (moves between stack slots, operands that didn't get a register,...).
+
+namespace f
+{
+	namespace x64
+	{
+		// Values are the encoding of registers in instructions (with the REX bit)
+		enum class Physical_Register : uint8_t
+		{
+			RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+			R8, R9, R10, R11, R12, R13, R14, R15,
+			XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+			XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+
+			COUNT
+		};
+
+		inline uint32_t get_register_mask(Physical_Register physical_register) {
+			return 1u << (uint32_t)physical_register;
+		}
+
+		inline uint8_t get_register_encoding(Physical_Register physical_register) {
+			return (uint8_t)physical_register & 0x0f;
+		}
+
+		// Floating points and vectors are in XMM registers, vectors are passed and returned like floating points
+		inline bool uses_xmm_register(Register::Type type) {
+			return is_floating_point(type) || is_vector(type);
+		}
+
+		struct Location
+		{
+			enum class Kind : uint8_t
+			{
+				NONE,
+				REGISTER,
+				STACK_SLOT,			// index is the slot, slots are 8 bytes (vectors use two consecutive slots)
+				INCOMING_ARGUMENT,	// index is the argument, for arguments passed on the stack by the caller
+				OUTGOING_ARGUMENT,	// index is the argument, for arguments of calls passed on the stack
+			};
+
+			Kind				kind;
+			Physical_Register	physical_register;
+			uint32_t			index;
+		};
+
+		inline bool operator==(const Location& a, const Location& b) {
+			if (a.kind != b.kind) {
+				return false;
+			}
+			return a.kind == Location::Kind::REGISTER ? a.physical_register == b.physical_register : a.index == b.index;
+		}
+
+		inline bool operator!=(const Location& a, const Location& b) {
+			return !(a == b);
+		}
+
+		// Positions, instruction i covers [4i, 4i + 4[
+		//   4i		arguments of calls are read, moves inserted before the instruction happen here
+		//   4i + 1	other operands are read, volatile registers are clobbered by calls
+		//   4i + 2	the destination is written
+		// Ranges are half open, so a destination can reuse the register of an operand that dies in the instruction.
+		// Phis define their destination at the start of their block.
+		inline uint32_t get_use_position(uint32_t instruction_index) {
+			return 4 * instruction_index;
+		}
+
+		inline uint32_t get_definition_position(uint32_t instruction_index) {
+			return 4 * instruction_index + 2;
+		}
+
+		struct Live_Range
+		{
+			uint32_t	start;
+			uint32_t	end;	// Excluded
+		};
+
+		struct Use_Position
+		{
+			uint32_t	position;
+			bool		requires_register;	// Hint for the spilling, the backend can still find the operand in memory
+		};
+
+		struct Live_Interval
+		{
+			uint32_t			virtual_register;
+			uint32_t			first_range;	// In Register_Allocation::ranges, sorted by position
+			uint32_t			nb_ranges;		// 0 for virtual registers that are never alive
+			uint32_t			first_use;		// In Register_Allocation::uses, sorted by position
+			uint32_t			nb_uses;
+			uint32_t			next_split;		// Next part of the same virtual register
+			Location			location;
+			Physical_Register	hint;			// COUNT if there is no preferred register
+			bool				is_in_xmm_register;	// Floating points and vectors
+		};
+
+		struct Move
+		{
+			Location		source;
+			Location		destination;
+			Register::Type	type;
+		};
+
+		struct Move_Range
+		{
+			uint32_t	first;	// In Register_Allocation::moves
+			uint32_t	count;
+		};
+
+		struct Register_Allocation
+		{
+			// The interval of the virtual register i is intervals[i], other parts are linked with next_split
+			fstd::memory::Array<Live_Interval>	intervals;
+			fstd::memory::Array<Live_Range>		ranges;
+			fstd::memory::Array<Use_Position>	uses;
+
+			// Moves are sequential (cycles are broken with the scratch stack slot), they are executed in order:
+			//   - block_entry at the beginning of the block (before its first instruction that isn't a phi)
+			//   - before_instruction, then the instruction, then after_instruction
+			//   - block_exit just before the terminator of the block (after its before_instruction moves)
+			fstd::memory::Array<Move>			moves;
+			fstd::memory::Array<Move_Range>		before_instruction;
+			fstd::memory::Array<Move_Range>		after_instruction;
+			fstd::memory::Array<Move_Range>		block_entry;
+			fstd::memory::Array<Move_Range>		block_exit;
+
+			uint32_t							nb_stack_slots;
+			uint32_t							used_registers;	// Mask of get_register_mask
+		};
+
+		// Critical edges of the function are split (new blocks are appended), so moves of an edge always have a place
+		// in one of its blocks. Functions can be in SSA form or not.
+		void allocate_registers(IR_Function& function, Register_Allocation& allocation);
+
+		// Location of the virtual register at the position, kind is NONE if the register isn't alive
+		Location get_location(const Register_Allocation& allocation, uint32_t virtual_register, uint32_t position);
+
+		void release(Register_Allocation& allocation);
+	}
+}
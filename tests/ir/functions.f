@@ -0,0 +1,16 @@
+﻿add :: (a : i32, b : i32) -> i32
+{
+    return a + b;
+}
+
+average :: (a : f64, b : i32) -> f64
+{
+    sum : f64 = a + b;
+    return sum / 2;
+}
+
+main :: () -> i32
+{
+    value : i32 = add(1, 2);
+    return add(value, 3);
+}
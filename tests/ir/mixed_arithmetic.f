@@ -0,0 +1,8 @@
+﻿folded : f64 = 16777216f + 1;
+
+main :: () -> i32
+{
+    x : f32 = 16777216f;
+    wide : f64 = x + 1;
+    return wide - 16777216;
+}
@@ -0,0 +1,20 @@
+﻿pressure :: (x : i32) -> i32
+{
+    a : i32 = x + 1;
+    b : i32 = x + 2;
+    c : i32 = x + 3;
+    d : i32 = x + 4;
+    e : i32 = x + 5;
+    f : i32 = x + 6;
+    g : i32 = x + 7;
+    h : i32 = x + 8;
+    i : i32 = x + 9;
+    j : i32 = x + 10;
+    k : i32 = x + 11;
+    l : i32 = x + 12;
+    m : i32 = x + 13;
+    n : i32 = x + 14;
+    o : i32 = x + 15;
+    p : i32 = x + 16;
+    return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p;
+}
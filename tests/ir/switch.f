@@ -0,0 +1,32 @@
+﻿// Consecutive values are dispatched by a jump table
+dense :: (x : i32) -> i32 : no_inline
+{
+    switch x {
+        case 0 { return 10; }
+        case 1, 2 { return 20; }
+        case 3 { return 30; }
+        case 5 { return 50; }
+        case 6 { return 60; }
+        default { return -1; }
+    }
+}
+
+// Values too far apart are dispatched by a decision tree
+sparse :: (x : i64) -> i64 : no_inline
+{
+    switch x {
+        case -1000 { return 1; }
+        case 10 { return 2; }
+        case 77 { return 3; }
+        case 5000 { return 4; }
+        case 1000000 { return 5; }
+    }
+    return 0;
+}
+
+main :: () -> i32
+{
+    a : i32 = dense(0) + dense(1) + dense(2) + dense(3) + dense(4) + dense(5) + dense(6) + dense(7) + dense(-3);
+    b : i64 = sparse(-1000) + sparse(10) * 10 + sparse(77) * 100 + sparse(5000) * 1000 + sparse(1000000) * 10000 + sparse(11) * 100000;
+    return a + b;
+}
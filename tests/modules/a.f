@@ -0,0 +1,8 @@
+﻿import common;
+
+origin : Vector2;
+
+scale :: (value : i32) -> i32
+{
+    return value * 2;
+}
@@ -0,0 +1,6 @@
+﻿import common;
+
+offset :: (value : i32) -> i32
+{
+    return value + 1;
+}
@@ -0,0 +1,5 @@
+﻿Vector2 :: struct
+{
+    x : f32;
+    y : f32;
+}
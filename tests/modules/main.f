@@ -0,0 +1,6 @@
+﻿import a;
+import b;
+import common;
+
+position : Vector2;
+x : i32 = #run scale(20) + #run offset(1);
@@ -0,0 +1,7 @@
+﻿a: i32 = 5 * 3 + 4;
+b: i32 = 2 - 7;
+c: f64 = 1.5 * 2.0;
+d: i64 = 3000000000 * 2;
+e: i64 = 2147483647 + 1;
+f: ui32 = 10u / 3;
+g: [2 * 8] ui8;
\ No newline at end of file
@@ -1,3 +1,8 @@
 ﻿x: i32 = 5 * 3 + 4;
 y: i32 = 4 + 5 * 3;
 z: i32 = 5 * (3 + 4);
+chain: i32 = 1 + 2 * 3 + 4 * 5 + 6;
+grouped: i32 = (1 + 2) * 3 + 4;
+grouped_right: i32 = 5 * (3 + 4) + 1;
+negative: i32 = -2 + 3;
+substractions: i32 = 10 - 4 - 3 - 2;
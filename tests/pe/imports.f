@@ -0,0 +1,13 @@
+﻿// Declared in an order that isn't the one of names, libraries and functions are sorted in the import directory
+MessageBeep :: (uType : ui32) -> i32 : win32, dll_import("user32.dll");
+GetTickCount :: () -> ui32 : win32, dll_import("kernel32.dll");
+Beep :: (dwFreq : ui32, dwDuration : ui32) -> i32 : win32, dll_import("kernel32.dll");
+ExitProcess :: (uExitCode : ui32) -> void : win32, dll_import("kernel32.dll");
+GetCurrentProcessId :: () -> ui32 : win32, dll_import("kernel32.dll");
+
+main :: () -> i32
+{
+    beeped : i32 = MessageBeep(0) + Beep(440, 10);
+    ExitProcess(GetTickCount() - GetCurrentProcessId());
+    return beeped;
+}
@@ -0,0 +1,26 @@
+﻿Vector3 :: struct
+{
+    x : f32;
+    y : f32;
+    z : f32;
+}
+
+Node :: struct
+{
+    id : ui8;
+    next : §Node;
+    value : i32;
+    name : string;
+}
+
+Value :: union
+{
+    integer : i64;
+    bytes : [4] ui8;
+}
+
+a : Vector3;
+b : Node;
+c : [3] Node;
+d : §Vector3;
+e : §Vector3;
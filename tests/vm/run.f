@@ -0,0 +1,46 @@
+﻿square :: (value : i32) -> i32
+{
+    return value * value;
+}
+
+sum_of_squares :: (a : i32, b : i32) -> i32
+{
+    a2 : i32 = square(a);
+    return a2 + square(b);
+}
+
+half :: (value : f64) -> f64
+{
+    return value / 2;
+}
+
+wrap_i8 :: (a : i8) -> i32
+{
+    b : i8 = a + a;
+    return b / 2;
+}
+
+unsigned_third :: (a : ui32) -> ui32
+{
+    b : ui32 = a - 1;
+    return b / 3;
+}
+
+f32_sum :: (a : f32, b : f32) -> f32
+{
+    return a + b + b;
+}
+
+f32_plus_one :: (a : f32) -> f64
+{
+    wide : f64 = a + 1;
+    return wide;
+}
+
+x : i32 = #run sum_of_squares(3, 4);
+y : f64 = #run half(5.0);
+z : i64 = #run sum_of_squares(2 + 1, -(1 + 1)) * 2;
+w : i32 = #run wrap_i8(100);
+u : ui32 = #run unsigned_third(0);
+v : f32 = #run f32_sum(16777216.0, 1.0);
+t : f64 = #run f32_plus_one(16777216.0);